@@ -36,6 +36,7 @@ ir_functions = [
   ["HASH_JOIN_PROCESS_BUILD_BATCH", "ProcessBuildBatch"],
   ["HASH_JOIN_PROCESS_PROBE_BATCH", "ProcessProbeBatch"],
   ["HDFS_SCANNER_WRITE_ALIGNED_TUPLES", "WriteAlignedTuples"],
+  ["IN_PREDICATE_SET_CONTAINS", "IrInPredicateSetContains"],
   ["STRING_VALUE_EQ", "StringValueEQ"],
   ["STRING_VALUE_NE", "StringValueNE"],
   ["STRING_VALUE_GE", "StringValueGE"],
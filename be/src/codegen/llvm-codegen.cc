@@ -98,22 +98,41 @@ LlvmCodeGen::LlvmCodeGen(ObjectPool* pool, const string& name) :
   loaded_functions_.resize(IRFunction::FN_END);
 }
 
+// Contents of the module files loaded with 'cache_file', by file name.  The impala
+// IR module doesn't change while the process runs, so it is only read from disk by
+// the first fragment that uses codegen.
+static mutex module_files_lock;
+static map<string, MemoryBuffer*> module_files;
+
 Status LlvmCodeGen::LoadFromFile(ObjectPool* pool,
-    const string& file, scoped_ptr<LlvmCodeGen>* codegen) {
+    const string& file, scoped_ptr<LlvmCodeGen>* codegen, bool cache_file) {
   codegen->reset(new LlvmCodeGen(pool, ""));
   SCOPED_TIMER((*codegen)->profile_.total_time_counter());
   SCOPED_TIMER((*codegen)->load_module_timer_);
   OwningPtr<MemoryBuffer> file_buffer;
-  llvm::error_code err = MemoryBuffer::getFile(file, file_buffer);
-  if (err.value() != 0) {
-    stringstream ss;
-    ss << "Could not load module " << file << ": " << err.message();
-    return Status(ss.str());
+  MemoryBuffer* buffer = NULL;
+  unique_lock<mutex> l(module_files_lock, defer_lock);
+  if (cache_file) {
+    l.lock();
+    map<string, MemoryBuffer*>::iterator it = module_files.find(file);
+    if (it != module_files.end()) buffer = it->second;
+  }
+  if (buffer == NULL) {
+    llvm::error_code err = MemoryBuffer::getFile(file, file_buffer);
+    if (err.value() != 0) {
+      stringstream ss;
+      ss << "Could not load module " << file << ": " << err.message();
+      return Status(ss.str());
+    }
+    buffer = file_buffer.get();
+    if (cache_file) module_files[file] = file_buffer.take();
   }
+  // Parsing doesn't modify the buffer, so fragments can share the cached one
+  if (cache_file) l.unlock();
 
-  COUNTER_UPDATE((*codegen)->module_file_size_, file_buffer->getBufferSize());
+  COUNTER_UPDATE((*codegen)->module_file_size_, buffer->getBufferSize());
   string error;
-  Module* loaded_module = ParseBitcodeFile(file_buffer.get(),
+  Module* loaded_module = ParseBitcodeFile(buffer,
       (*codegen)->context(), &error);
 
   if (loaded_module == NULL) {
@@ -136,7 +155,7 @@ Status LlvmCodeGen::LoadImpalaIR(ObjectPool* pool, scoped_ptr<LlvmCodeGen>* code
   } else {
     PathBuilder::GetFullPath("llvm-ir/impala-no-sse.ll", &module_file);
   }
-  RETURN_IF_ERROR(LoadFromFile(pool, module_file, codegen_ret));
+  RETURN_IF_ERROR(LoadFromFile(pool, module_file, codegen_ret, true));
   LlvmCodeGen* codegen = codegen_ret->get();
 
   // Parse module for cross compiled functions and types
@@ -550,6 +569,11 @@ void* LlvmCodeGen::JitFunction(Function* function, int* scratch_size) {
   return jitted_function;
 }
 
+int LlvmCodeGen::num_jitted_functions() {
+  lock_guard<mutex> l(jitted_functions_lock_);
+  return jitted_functions_.size();
+}
+
 int LlvmCodeGen::GetScratchBuffer(int byte_size) {
   // TODO: this is not yet implemented/tested
   DCHECK(false);
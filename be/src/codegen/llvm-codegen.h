@@ -280,6 +280,10 @@ class LlvmCodeGen {
   // This function is thread safe.
   void* JitFunction(llvm::Function* function, int* scratch_size = NULL);
 
+  // Returns the number of functions that have been jit compiled.
+  // This function is thread safe.
+  int num_jitted_functions();
+
   // Verfies the function if the verfier is enabled.  Returns false if function
   // is invalid.
   bool VerifyFunction(llvm::Function* function);
@@ -383,8 +387,10 @@ class LlvmCodeGen {
   // Load a pre-compiled IR module from 'file'.  This creates a top level
   // codegen object.  This is used by tests to load custom modules.
   // codegen will contain the created object on success.  
+  // If 'cache_file', the contents of the file are kept in memory and later loads of
+  // the same file don't read it again.
   static Status LoadFromFile(ObjectPool*, const std::string& file, 
-      boost::scoped_ptr<LlvmCodeGen>* codegen);
+      boost::scoped_ptr<LlvmCodeGen>* codegen, bool cache_file = false);
 
   // Load the intrinsics impala needs.  This is a one time initialization.
   // Values are stored in 'llvm_intrinsics_'
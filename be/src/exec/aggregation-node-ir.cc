@@ -32,10 +32,14 @@ void AggregationNode::ProcessRowBatchNoGrouping(RowBatch* batch) {
 }
 
 void AggregationNode::ProcessRowBatchWithGrouping(RowBatch* batch) {
+  // Hash the whole batch up front so the hash table lookups overlap
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    hash_tbl_->PrefetchProbeRow(i, batch->GetRow(i));
+  }
   for (int i = 0; i < batch->num_rows(); ++i) {
     TupleRow* row = batch->GetRow(i);
     AggregationTuple* agg_tuple = NULL; 
-    HashTable::Iterator entry = hash_tbl_->Find(row);
+    HashTable::Iterator entry = hash_tbl_->FindPrefetched(i);
     if (!entry.HasNext()) {
       agg_tuple = ConstructAggTuple();
       hash_tbl_->Insert(reinterpret_cast<TupleRow*>(&agg_tuple));
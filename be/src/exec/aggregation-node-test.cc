@@ -0,0 +1,168 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "exec/aggregation-node.h"
+#include "exec/exec-node-test-util.h"
+#include "runtime/exec-env.h"
+#include "runtime/runtime-state.h"
+#include "util/runtime-profile.h"
+
+DECLARE_bool(enable_streaming_preaggregation);
+DECLARE_int64(streaming_preaggregation_min_rows);
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Slots of the aggregation tuple: the grouping value, COUNT(*) and SUM(value)
+static const int NUM_AGG_SLOTS = 3;
+
+class AggregationNodeTest : public testing::Test {
+ protected:
+  // (COUNT(*), SUM(value)) of each group by grouping value
+  typedef map<int64_t, pair<int64_t, int64_t> > GroupMap;
+
+  ObjectPool pool_;
+  ExecEnv exec_env_;
+  DescriptorTbl* desc_tbl_;
+
+  // Tuple 0 is the input tuple with a single BIGINT slot, tuple 1 the aggregation
+  // tuple.
+  virtual void SetUp() {
+    vector<vector<TPrimitiveType::type> > tuple_slot_types(2);
+    tuple_slot_types[0].push_back(TPrimitiveType::BIGINT);
+    tuple_slot_types[1].assign(NUM_AGG_SLOTS, TPrimitiveType::BIGINT);
+    CreateDescTbl(&pool_, tuple_slot_types, false, &desc_tbl_);
+  }
+
+  // Returns an aggregate expr; SUM is over the input slot.
+  static TExpr CreateAggExpr(TAggregationOp::type op, bool is_star) {
+    TExprNode node;
+    node.node_type = TExprNodeType::AGG_EXPR;
+    node.type = TPrimitiveType::BIGINT;
+    node.num_children = is_star ? 0 : 1;
+    TAggregateExpr agg_expr;
+    agg_expr.is_star = is_star;
+    agg_expr.is_distinct = false;
+    agg_expr.op = op;
+    node.__set_agg_expr(agg_expr);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    if (!is_star) expr.nodes.push_back(CreateSlotRefExpr(0).nodes[0]);
+    return expr;
+  }
+
+  // Runs "SELECT value, COUNT(*), SUM(value) ... GROUP BY value" over 'values' as the
+  // pre-aggregation of a 2-phase aggregation.  Merges the returned rows into '*groups'
+  // like the merge aggregation would, and returns the number of rows the node
+  // returned and passed through.
+  void RunPreaggregation(const vector<int64_t>& values, GroupMap* groups,
+      int64_t* num_rows, int64_t* num_passed_through) {
+    scoped_ptr<RuntimeState> state(
+        CreateRuntimeState(&exec_env_, desc_tbl_, TUniqueId(), -1));
+    // The nodes' mem trackers are children of the state's, so the nodes go first
+    ObjectPool pool;
+
+    TPlanNode tnode =
+        CreatePlanNode(0, TPlanNodeType::AGGREGATION_NODE, vector<TTupleId>(1, 1));
+    tnode.agg_node.__set_grouping_exprs(vector<TExpr>(1, CreateSlotRefExpr(0)));
+    tnode.agg_node.aggregate_exprs.push_back(
+        CreateAggExpr(TAggregationOp::COUNT, true));
+    tnode.agg_node.aggregate_exprs.push_back(
+        CreateAggExpr(TAggregationOp::SUM, false));
+    tnode.agg_node.agg_tuple_id = 1;
+    tnode.agg_node.need_finalize = false;
+    tnode.agg_node.__set_is_preaggregation(true);
+    tnode.__isset.agg_node = true;
+    TestNode<AggregationNode>* agg_node =
+        pool.Add(new TestNode<AggregationNode>(&pool, tnode, *desc_tbl_));
+    agg_node->AddChild(pool.Add(new RowSourceNode(&pool, 1, 0, *desc_tbl_, values)));
+
+    vector<RowBatch*> batches;
+    Status status = GetAllRows(state.get(), agg_node, &pool, &batches);
+    ASSERT_TRUE(status.ok()) << status.GetErrorMsg();
+    groups->clear();
+    *num_rows = 0;
+    for (int i = 0; i < batches.size(); ++i) {
+      for (int j = 0; j < batches[i]->num_rows(); ++j) {
+        int64_t* slots =
+            reinterpret_cast<int64_t*>(batches[i]->GetRow(j)->GetTuple(0));
+        pair<int64_t, int64_t>& group = (*groups)[slots[0]];
+        group.first += slots[1];
+        group.second += slots[2];
+        ++*num_rows;
+      }
+    }
+    *num_passed_through =
+        agg_node->runtime_profile()->GetCounter("RowsPassedThrough")->value();
+    ASSERT_TRUE(agg_node->Close(state.get()).ok());
+  }
+};
+
+// Once the pre-aggregation finds that its input is nearly unique, it passes the rest
+// of the input through.  After merging, the result is the same as if it had
+// aggregated the entire input.
+TEST_F(AggregationNodeTest, StreamingPreaggregation) {
+  google::FlagSaver flag_saver;
+  const int num_groups = 150000;
+  const int num_input_rows = 200000;
+  // Groups [0, 50000) appear twice, the others once, in a scrambled order
+  vector<int64_t> values;
+  for (int i = 0; i < num_input_rows; ++i) {
+    values.push_back(i % num_groups);
+  }
+  for (int i = 0; i < values.size(); ++i) {
+    swap(values[i], values[(i * 7919) % values.size()]);
+  }
+  FLAGS_streaming_preaggregation_min_rows = 10000;
+
+  FLAGS_enable_streaming_preaggregation = false;
+  GroupMap aggregated_groups;
+  int64_t num_rows;
+  int64_t num_passed_through;
+  RunPreaggregation(values, &aggregated_groups, &num_rows, &num_passed_through);
+  EXPECT_EQ(num_passed_through, 0);
+  EXPECT_EQ(num_rows, num_groups);
+  ASSERT_EQ(aggregated_groups.size(), num_groups);
+  for (GroupMap::iterator it = aggregated_groups.begin();
+      it != aggregated_groups.end(); ++it) {
+    int64_t expected_count = it->first < num_input_rows - num_groups ? 2 : 1;
+    EXPECT_EQ(it->second.first, expected_count);
+    EXPECT_EQ(it->second.second, expected_count * it->first);
+  }
+
+  FLAGS_enable_streaming_preaggregation = true;
+  GroupMap streamed_groups;
+  RunPreaggregation(values, &streamed_groups, &num_rows, &num_passed_through);
+  EXPECT_GT(num_passed_through, 0);
+  // Some groups are returned more than once
+  EXPECT_GT(num_rows, num_groups);
+  EXPECT_TRUE(streamed_groups == aggregated_groups);
+}
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitExecNodeTest(&argc, &argv);
+  return RUN_ALL_TESTS();
+}
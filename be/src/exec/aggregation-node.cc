@@ -17,6 +17,7 @@
 #include <math.h>
 #include <sstream>
 #include <boost/functional/hash.hpp>
+#include <gflags/gflags.h>
 
 #include <x86intrin.h>
 
@@ -25,14 +26,17 @@
 #include "exprs/agg-expr.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/mem-pool.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/spill-file.h"
 #include "runtime/string-value.inline.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "util/debug-util.h"
+#include "util/hash-util.h"
 #include "util/runtime-profile.h"
 
 #include "gen-cpp/Exprs_types.h"
@@ -43,6 +47,19 @@ using namespace std;
 using namespace boost;
 using namespace llvm;
 
+DEFINE_bool(enable_aggregation_spilling, true, "If true, grouping aggregations whose "
+    "hash table exceeds the memory limit are partitioned and spilled to the "
+    "--scratch_dirs.");
+DEFINE_bool(aggregation_open_addressing, false, "If true, grouping aggregations use an "
+    "open addressing hash table instead of a chained one.");
+DEFINE_bool(enable_streaming_preaggregation, true, "If true, the first phase of a "
+    "2-phase aggregation passes its input rows through unaggregated once aggregating "
+    "them turns out not to reduce the number of rows enough.");
+DEFINE_double(streaming_preaggregation_min_reduction, 2.0, "A pre-aggregation switches "
+    "to streaming if the ratio of input rows to groups is below this value.");
+DEFINE_int64(streaming_preaggregation_min_rows, 100000, "Number of input rows a "
+    "pre-aggregation consumes before it checks its reduction ratio.");
+
 // This object appends n-int32s to the end of a normal tuple object to maintain the
 // lengths of the string buffers in the tuple.
 namespace impala {
@@ -95,9 +112,18 @@ AggregationNode::AggregationNode(ObjectPool* pool, const TPlanNode& tnode,
     codegen_process_row_batch_fn_(NULL),
     process_row_batch_fn_(NULL),
     needs_finalize_(tnode.agg_node.need_finalize),
+    is_preaggregation_(tnode.agg_node.__isset.is_preaggregation &&
+        tnode.agg_node.is_preaggregation),
+    streaming_(false),
+    child_batch_idx_(0),
+    child_eos_(false),
     build_timer_(NULL),
     get_results_timer_(NULL),
-    hash_table_buckets_counter_(NULL) {
+    hash_table_buckets_counter_(NULL),
+    spilled_bytes_counter_(NULL),
+    spilled_partitions_counter_(NULL),
+    max_partition_depth_counter_(NULL),
+    rows_passed_through_counter_(NULL) {
   // ignore return status for now
   Expr::CreateExprTrees(pool, tnode.agg_node.grouping_exprs, &probe_exprs_);
   Expr::CreateExprTrees(pool, tnode.agg_node.aggregate_exprs, &aggregate_exprs_);
@@ -112,6 +138,14 @@ Status AggregationNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "BuildBuckets", TCounterType::UNIT);
   hash_table_load_factor_counter_ = 
       ADD_COUNTER(runtime_profile(), "LoadFactor", TCounterType::DOUBLE_VALUE);
+  spilled_bytes_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledBytes", TCounterType::BYTES);
+  spilled_partitions_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledPartitions", TCounterType::UNIT);
+  max_partition_depth_counter_ =
+      ADD_COUNTER(runtime_profile(), "MaxPartitionDepth", TCounterType::UNIT);
+  rows_passed_through_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsPassedThrough", TCounterType::UNIT);
 
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   
@@ -128,11 +162,12 @@ Status AggregationNode::Prepare(RuntimeState* state) {
   }
   RETURN_IF_ERROR(Expr::Prepare(build_exprs_, state, row_desc(), false));
 
-  tuple_pool_->set_limits(*state->mem_limits());
+  tuple_pool_->set_limits(mem_trackers_);
 
   // TODO: how many buckets?
   hash_tbl_.reset(new HashTable(build_exprs_, probe_exprs_, 1, true, 
-      id(), *state->mem_limits()));
+      id(), mem_trackers_, 1024, FLAGS_aggregation_open_addressing));
+  if (hash_tbl_->open_addressing()) AddRuntimeExecOption("Open Addressing Hash Table");
   
   // Determine the number of string slots in the output
   for (vector<Expr*>::const_iterator expr = aggregate_exprs_.begin();
@@ -187,22 +222,37 @@ Status AggregationNode::Open(RuntimeState* state) {
         VLOG_ROW << "input row: " << PrintRow(row, children_[0]->row_desc());
       }
     }
-    int64_t agg_rows_before = hash_tbl_->size();
-    if (process_row_batch_fn_ != NULL) {
-      process_row_batch_fn_(this, &batch);
-    } else if (singleton_output_tuple_ != NULL) {
-      ProcessRowBatchNoGrouping(&batch);
-    } else {
-      ProcessRowBatchWithGrouping(&batch);
+    num_input_rows += batch.num_rows();
+    if (!spilling_partitions_.empty()) {
+      RETURN_IF_ERROR(SpillInputBatch(&batch));
+      batch.Reset();
+      if (eos) break;
+      continue;
     }
-    RETURN_IF_LIMIT_EXCEEDED(state);
+
+    int64_t agg_rows_before = hash_tbl_->size();
+    ProcessRowBatch(&batch);
+    if (!CanSpill() && !CanStream()) RETURN_IF_LIMIT_EXCEEDED(state);
     COUNTER_SET(hash_table_buckets_counter_, hash_tbl_->num_buckets());
     COUNTER_SET(memory_used_counter(), 
         tuple_pool_->peak_allocated_bytes() + hash_tbl_->byte_size());
     COUNTER_SET(hash_table_load_factor_counter_, hash_tbl_->load_factor());
     num_agg_rows += (hash_tbl_->size() - agg_rows_before);
-    num_input_rows += batch.num_rows();
 
+    if (ShouldStream(state, num_input_rows)) {
+      // Pass the rest of the input through in GetNext(), after the groups aggregated
+      // so far have been returned.
+      streaming_ = true;
+      child_eos_ = eos;
+      child_batch_.reset(new RowBatch(children_[0]->row_desc(), state->batch_size()));
+      child_batch_idx_ = 0;
+      AddRuntimeExecOption("Streaming Preaggregation");
+      break;
+    }
+    if (CanSpill() && (hash_tbl_->exceeded_limit() ||
+        MemTracker::LimitExceeded(mem_trackers_))) {
+      RETURN_IF_ERROR(SpillHashTable(state, 0));
+    }
     batch.Reset();
     if (eos) break;
   }
@@ -211,8 +261,18 @@ Status AggregationNode::Open(RuntimeState* state) {
     hash_tbl_->Insert(reinterpret_cast<TupleRow*>(&singleton_output_tuple_));
     ++num_agg_rows;
   }
-  VLOG_FILE << "aggregated " << num_input_rows << " input rows into "
-            << num_agg_rows << " output rows";
+  if (streaming_) {
+    VLOG_FILE << "aggregated " << num_input_rows << " input rows into "
+              << num_agg_rows << " output rows, passing through the remaining rows";
+  } else if (!spilling_partitions_.empty()) {
+    VLOG_FILE << "aggregated " << num_input_rows << " input rows, spilled to "
+              << spilled_partitions_counter_->value() << " partitions";
+    RETURN_IF_ERROR(FinishSpilling());
+    RETURN_IF_ERROR(NextSpilledPartition(state));
+  } else {
+    VLOG_FILE << "aggregated " << num_input_rows << " input rows into "
+              << num_agg_rows << " output rows";
+  }
   output_iterator_ = hash_tbl_->Begin();
   return Status::OK;
 }
@@ -246,6 +306,30 @@ Status AggregationNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool*
     }
     output_iterator_.Next<false>();
   }
+
+  if (streaming_) {
+    if (!output_iterator_.HasNext() && hash_tbl_->size() > 0) {
+      // All groups have been returned, the rows reference their tuples
+      row_batch->tuple_data_pool()->AcquireData(tuple_pool_.get(), false);
+      string_buffer_free_list_.Reset();
+      hash_tbl_->Clear();
+    }
+    if (!output_iterator_.HasNext() && !ReachedLimit()) {
+      RETURN_IF_ERROR(PassThroughRows(state, row_batch));
+    }
+    *eos = ReachedLimit() || (!output_iterator_.HasNext() && child_eos_ &&
+        child_batch_idx_ == child_batch_->num_rows());
+    COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+    return Status::OK;
+  }
+
+  if (!output_iterator_.HasNext() && !spilled_partitions_.empty() && !ReachedLimit()) {
+    // The returned rows reference the tuples of the current partition
+    row_batch->tuple_data_pool()->AcquireData(tuple_pool_.get(), false);
+    SCOPED_TIMER(build_timer_);
+    RETURN_IF_ERROR(NextSpilledPartition(state));
+    output_iterator_ = hash_tbl_->Begin();
+  }
   *eos = !output_iterator_.HasNext() || ReachedLimit();
   COUNTER_SET(rows_returned_counter_, num_rows_returned_);
   return Status::OK;
@@ -259,9 +343,271 @@ Status AggregationNode::Close(RuntimeState* state) {
         tuple_pool_->peak_allocated_bytes() + hash_tbl_->byte_size());
     COUNTER_SET(hash_table_buckets_counter_, hash_tbl_->num_buckets());
   }
+  for (int i = 0; i < all_partitions_.size(); ++i) {
+    ClosePartition(all_partitions_[i]);
+  }
+  child_batch_.reset(NULL);
   return ExecNode::Close(state);
 }
 
+void AggregationNode::ProcessRowBatch(RowBatch* batch) {
+  if (process_row_batch_fn_ != NULL) {
+    process_row_batch_fn_(this, batch);
+  } else if (singleton_output_tuple_ != NULL) {
+    ProcessRowBatchNoGrouping(batch);
+  } else {
+    ProcessRowBatchWithGrouping(batch);
+  }
+}
+
+bool AggregationNode::CanSpill() const {
+  // Without grouping there is only a single output tuple
+  return FLAGS_enable_aggregation_spilling && singleton_output_tuple_ == NULL;
+}
+
+bool AggregationNode::CanStream() const {
+  // Without grouping there is only a single output tuple
+  return FLAGS_enable_streaming_preaggregation && is_preaggregation_ &&
+      singleton_output_tuple_ == NULL;
+}
+
+bool AggregationNode::ShouldStream(RuntimeState* state, int64_t num_input_rows) {
+  if (!CanStream()) return false;
+  DCHECK(spilling_partitions_.empty());
+  // Streaming needs less memory than spilling
+  if (hash_tbl_->exceeded_limit() || MemTracker::LimitExceeded(mem_trackers_)) {
+    return true;
+  }
+  if (num_input_rows < FLAGS_streaming_preaggregation_min_rows) return false;
+  return num_input_rows <
+      FLAGS_streaming_preaggregation_min_reduction * hash_tbl_->size();
+}
+
+Status AggregationNode::PassThroughRows(RuntimeState* state, RowBatch* row_batch) {
+  DCHECK(streaming_);
+  DCHECK(!needs_finalize_);
+  Expr** conjuncts = &conjuncts_[0];
+  int num_conjuncts = conjuncts_.size();
+  int64_t num_passed_through = 0;
+  while (!row_batch->IsFull() && !ReachedLimit()) {
+    if (child_batch_idx_ == child_batch_->num_rows()) {
+      if (child_eos_) break;
+      // The rows passed through so far are deep copies, the child's data can go
+      child_batch_->Reset();
+      child_batch_idx_ = 0;
+      RETURN_IF_CANCELLED(state);
+      RETURN_IF_ERROR(children_[0]->GetNext(state, child_batch_.get(), &child_eos_));
+      continue;
+    }
+    TupleRow* input_row = child_batch_->GetRow(child_batch_idx_++);
+    ++num_passed_through;
+    // ConstructAggTuple() copies the grouping values from the hash table's expr buffer
+    hash_tbl_->EvalAndCacheProbeRow(input_row);
+    AggregationTuple* agg_tuple = ConstructAggTuple();
+    UpdateAggTuple(agg_tuple, input_row);
+
+    int row_idx = row_batch->AddRow();
+    TupleRow* row = row_batch->GetRow(row_idx);
+    row->SetTuple(0, agg_tuple->tuple());
+    if (ExecNode::EvalConjuncts(conjuncts, num_conjuncts, row)) {
+      VLOG_ROW << "output row: " << PrintRow(row, row_desc());
+      row_batch->CommitLastRow();
+      ++num_rows_returned_;
+    }
+  }
+  // The tuples are only referenced by the returned rows
+  row_batch->tuple_data_pool()->AcquireData(tuple_pool_.get(), false);
+  string_buffer_free_list_.Reset();
+  COUNTER_UPDATE(rows_passed_through_counter_, num_passed_through);
+  return Status::OK;
+}
+
+int AggregationNode::PartitionIdx(uint32_t hash, int level) {
+  // Rehash with a different seed per level so that rows that ended up in the same
+  // partition are spread out when the partition is repartitioned.
+  return HashUtil::Hash(&hash, sizeof(hash), level) % NUM_PARTITIONS;
+}
+
+AggregationNode::Partition* AggregationNode::CreatePartition(RuntimeState* state,
+    int level) {
+  Partition* partition = pool_->Add(new Partition());
+  partition->level = level;
+  partition->agg_file.reset(new SpillFile(state, row_desc(), spilled_bytes_counter_));
+  partition->input_file.reset(
+      new SpillFile(state, child(0)->row_desc(), spilled_bytes_counter_));
+  partition->agg_batch.reset(new RowBatch(row_desc(), state->batch_size()));
+  partition->input_batch.reset(new RowBatch(child(0)->row_desc(), state->batch_size()));
+  all_partitions_.push_back(partition);
+  return partition;
+}
+
+Status AggregationNode::SpillHashTable(RuntimeState* state, int level) {
+  DCHECK(spilling_partitions_.empty());
+  if (level > MAX_PARTITION_DEPTH) {
+    stringstream ss;
+    ss << "Aggregation (id=" << id() << ") could not partition its input to fit in "
+       << "the memory limit after " << MAX_PARTITION_DEPTH << " repartitions.";
+    return Status(TStatusCode::MEM_LIMIT_EXCEEDED, ss.str());
+  }
+  if (level == 0) AddRuntimeExecOption("Spilled");
+  if (max_partition_depth_counter_->value() < level) {
+    COUNTER_SET(max_partition_depth_counter_, static_cast<int64_t>(level));
+  }
+  VLOG_QUERY << "Aggregation (id=" << id() << ") exceeded the memory limit with "
+             << hash_tbl_->size() << " groups, spilling at level " << level;
+
+  for (int i = 0; i < NUM_PARTITIONS; ++i) {
+    spilling_partitions_.push_back(CreatePartition(state, level));
+  }
+  for (HashTable::Iterator it = hash_tbl_->Begin(); it.HasNext(); it.Next<false>()) {
+    TupleRow* row = it.GetRow();
+    uint32_t hash;
+    bool has_hash = hash_tbl_->HashBuildRow(row, &hash);
+    DCHECK(has_hash);
+    Partition* partition = spilling_partitions_[PartitionIdx(hash, level)];
+    RETURN_IF_ERROR(partition->agg_file->AddRow(partition->agg_batch.get(), row));
+  }
+  hash_tbl_->Clear();
+  ResetTuplePool(state);
+  return Status::OK;
+}
+
+Status AggregationNode::SpillInputBatch(RowBatch* batch) {
+  DCHECK(!spilling_partitions_.empty());
+  int level = spilling_partitions_[0]->level;
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    TupleRow* row = batch->GetRow(i);
+    uint32_t hash;
+    bool has_hash = hash_tbl_->HashProbeRow(row, &hash);
+    DCHECK(has_hash);
+    Partition* partition = spilling_partitions_[PartitionIdx(hash, level)];
+    RETURN_IF_ERROR(partition->input_file->AddRow(partition->input_batch.get(), row));
+  }
+  return Status::OK;
+}
+
+Status AggregationNode::SpillAggBatch(RowBatch* batch) {
+  DCHECK(!spilling_partitions_.empty());
+  int level = spilling_partitions_[0]->level;
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    TupleRow* row = batch->GetRow(i);
+    uint32_t hash;
+    bool has_hash = hash_tbl_->HashBuildRow(row, &hash);
+    DCHECK(has_hash);
+    Partition* partition = spilling_partitions_[PartitionIdx(hash, level)];
+    RETURN_IF_ERROR(partition->agg_file->AddRow(partition->agg_batch.get(), row));
+  }
+  return Status::OK;
+}
+
+Status AggregationNode::FinishSpilling() {
+  for (int i = spilling_partitions_.size() - 1; i >= 0; --i) {
+    Partition* partition = spilling_partitions_[i];
+    RETURN_IF_ERROR(partition->agg_file->AddBatch(partition->agg_batch.get()));
+    RETURN_IF_ERROR(partition->input_file->AddBatch(partition->input_batch.get()));
+    partition->agg_batch->Reset();
+    partition->input_batch->Reset();
+    RETURN_IF_ERROR(partition->agg_file->PrepareForRead());
+    RETURN_IF_ERROR(partition->input_file->PrepareForRead());
+    spilled_partitions_.push_front(partition);
+  }
+  COUNTER_UPDATE(spilled_partitions_counter_, spilling_partitions_.size());
+  spilling_partitions_.clear();
+  return Status::OK;
+}
+
+Status AggregationNode::NextSpilledPartition(RuntimeState* state) {
+  hash_tbl_->Clear();
+  ResetTuplePool(state);
+  while (!spilled_partitions_.empty()) {
+    RETURN_IF_CANCELLED(state);
+    Partition* partition = spilled_partitions_.front();
+    spilled_partitions_.pop_front();
+    RETURN_IF_ERROR(AggregatePartition(state, partition));
+    ClosePartition(partition);
+    if (!spilling_partitions_.empty()) {
+      // The partition did not fit and was split up
+      RETURN_IF_ERROR(FinishSpilling());
+      continue;
+    }
+    if (hash_tbl_->size() > 0) break;
+  }
+  COUNTER_SET(hash_table_buckets_counter_, hash_tbl_->num_buckets());
+  COUNTER_SET(hash_table_load_factor_counter_, hash_tbl_->load_factor());
+  return Status::OK;
+}
+
+Status AggregationNode::AggregatePartition(RuntimeState* state, Partition* partition) {
+  DCHECK(spilling_partitions_.empty());
+  DCHECK_EQ(hash_tbl_->size(), 0);
+  VLOG_FILE << "Aggregation (id=" << id() << ") aggregating spilled partition with "
+            << partition->agg_file->num_rows() << " partially aggregated rows and "
+            << partition->input_file->num_rows() << " input rows";
+
+  // Merge the partially aggregated tuples first, then aggregate the input rows
+  RETURN_IF_ERROR(partition->agg_file->PrepareForRead());
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RowBatch* batch;
+    RETURN_IF_ERROR(partition->agg_file->GetNext(&batch));
+    if (batch == NULL) break;
+    scoped_ptr<RowBatch> agg_batch(batch);
+    if (!spilling_partitions_.empty()) {
+      RETURN_IF_ERROR(SpillAggBatch(agg_batch.get()));
+      continue;
+    }
+    MergeAggBatch(agg_batch.get());
+    if (hash_tbl_->exceeded_limit() || MemTracker::LimitExceeded(mem_trackers_)) {
+      RETURN_IF_ERROR(SpillHashTable(state, partition->level + 1));
+    }
+  }
+
+  RETURN_IF_ERROR(partition->input_file->PrepareForRead());
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RowBatch* batch;
+    RETURN_IF_ERROR(partition->input_file->GetNext(&batch));
+    if (batch == NULL) break;
+    scoped_ptr<RowBatch> input_batch(batch);
+    if (!spilling_partitions_.empty()) {
+      RETURN_IF_ERROR(SpillInputBatch(input_batch.get()));
+      continue;
+    }
+    ProcessRowBatch(input_batch.get());
+    if (hash_tbl_->exceeded_limit() || MemTracker::LimitExceeded(mem_trackers_)) {
+      RETURN_IF_ERROR(SpillHashTable(state, partition->level + 1));
+    }
+  }
+  return Status::OK;
+}
+
+void AggregationNode::MergeAggBatch(RowBatch* batch) {
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    TupleRow* row = batch->GetRow(i);
+    HashTable::Iterator entry = hash_tbl_->FindBuildRow(row);
+    if (!entry.HasNext()) {
+      AggregationTuple* agg_tuple = CopyAggTuple(row->GetTuple(0));
+      hash_tbl_->Insert(reinterpret_cast<TupleRow*>(&agg_tuple));
+    } else {
+      MergeAggTuple(reinterpret_cast<AggregationTuple*>(entry.GetRow()->GetTuple(0)),
+          row->GetTuple(0));
+    }
+  }
+}
+
+void AggregationNode::ClosePartition(Partition* partition) {
+  partition->agg_batch.reset(NULL);
+  partition->input_batch.reset(NULL);
+  if (partition->agg_file.get() != NULL) partition->agg_file->Close();
+  if (partition->input_file.get() != NULL) partition->input_file->Close();
+}
+
+void AggregationNode::ResetTuplePool(RuntimeState* state) {
+  string_buffer_free_list_.Reset();
+  tuple_pool_.reset(new MemPool());
+  tuple_pool_->set_limits(mem_trackers_);
+}
+
 AggregationTuple* AggregationNode::ConstructAggTuple() {
   AggregationTuple* agg_out_tuple = 
       AggregationTuple::Create(agg_tuple_desc_->byte_size(), 
@@ -334,6 +680,47 @@ AggregationTuple* AggregationNode::ConstructAggTuple() {
   return agg_out_tuple;
 }
 
+AggregationTuple* AggregationNode::CopyAggTuple(Tuple* src) {
+  AggregationTuple* agg_out_tuple =
+      AggregationTuple::Create(agg_tuple_desc_->byte_size(),
+          num_string_slots_, tuple_pool_.get());
+  Tuple* agg_tuple = agg_out_tuple->tuple();
+  memcpy(agg_tuple, src, agg_tuple_desc_->byte_size());
+
+  // The string data of 'src' is not owned by this node, copy it.
+  vector<SlotDescriptor*>::const_iterator slot_desc = agg_tuple_desc_->slots().begin();
+  for (int i = 0; i < probe_exprs_.size(); ++i, ++slot_desc) {
+    if ((*slot_desc)->type() != TYPE_STRING) continue;
+    if (agg_tuple->IsNull((*slot_desc)->null_indicator_offset())) continue;
+    void* slot = agg_tuple->GetSlot((*slot_desc)->tuple_offset());
+    RawValue::Write(src->GetSlot((*slot_desc)->tuple_offset()), slot, TYPE_STRING,
+        tuple_pool_.get());
+  }
+
+  // Aggregate string slots get buffers that UpdateStringSlot() can reuse.
+  int32_t* string_buffer_lengths =
+      agg_out_tuple->BufferLengths(agg_tuple_desc_->byte_size());
+  int string_slot_idx = -1;
+  for (int i = 0; i < aggregate_exprs_.size(); ++i, ++slot_desc) {
+    if (aggregate_exprs_[i]->type() != TYPE_STRING) continue;
+    ++string_slot_idx;
+    StringValue* dst = reinterpret_cast<StringValue*>(
+        agg_tuple->GetSlot((*slot_desc)->tuple_offset()));
+    if (agg_tuple->IsNull((*slot_desc)->null_indicator_offset())) {
+      dst->ptr = NULL;
+      dst->len = 0;
+      continue;
+    }
+    const StringValue* src_value = reinterpret_cast<const StringValue*>(
+        src->GetSlot((*slot_desc)->tuple_offset()));
+    dst->ptr = AllocateStringBuffer(src_value->len,
+        &string_buffer_lengths[string_slot_idx]);
+    memcpy(dst->ptr, src_value->ptr, src_value->len);
+    dst->len = src_value->len;
+  }
+  return agg_out_tuple;
+}
+
 char* AggregationNode::AllocateStringBuffer(int new_size, int* allocated_size) {
   new_size = ::max(new_size, FreeList::MinSize());
   char* buffer = reinterpret_cast<char*>(
@@ -459,129 +846,164 @@ void AggregationNode::UpdateAggTuple(AggregationTuple* agg_out_tuple, TupleRow*
       continue;
     }
 
-    switch (agg_expr->agg_op()) {
-      case TAggregationOp::COUNT:
-        ++*reinterpret_cast<int64_t*>(slot);
-        break;
+    UpdateSlot(agg_out_tuple, agg_expr->agg_op(), agg_expr->type(),
+        agg_expr->GetChild(0)->type(), (*slot_desc)->null_indicator_offset(),
+        string_slot_idx, slot, value);
+  }
+}
 
-      case TAggregationOp::MIN:
-        switch (agg_expr->type()) {
-          case TYPE_BOOLEAN:
-            UpdateMinSlot<bool>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_TINYINT:
-            UpdateMinSlot<int8_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_SMALLINT:
-            UpdateMinSlot<int16_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_INT:
-            UpdateMinSlot<int32_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_BIGINT:
-            UpdateMinSlot<int64_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_FLOAT:
-            UpdateMinSlot<float>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_DOUBLE:
-            UpdateMinSlot<double>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_TIMESTAMP:
-            UpdateMinSlot<TimestampValue>(tuple, (*slot_desc)->null_indicator_offset(),
-                slot, value);
-            break;
-          case TYPE_STRING:
-            UpdateMinStringSlot(agg_out_tuple, (*slot_desc)->null_indicator_offset(),
-                string_slot_idx, slot, value);
-            break;
-          default:
-            DCHECK(false) << "invalid type: " << TypeToString(agg_expr->type());
-        };
-        break;
+void AggregationNode::UpdateSlot(AggregationTuple* agg_out_tuple,
+    TAggregationOp::type agg_op, PrimitiveType type, PrimitiveType input_type,
+    const NullIndicatorOffset& null_indicator_offset, int string_slot_idx,
+    void* slot, void* value) {
+  Tuple* tuple = agg_out_tuple->tuple();
+  switch (agg_op) {
+    case TAggregationOp::COUNT:
+      ++*reinterpret_cast<int64_t*>(slot);
+      break;
 
-      case TAggregationOp::MAX:
-        switch (agg_expr->type()) {
-          case TYPE_BOOLEAN:
-            UpdateMaxSlot<bool>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_TINYINT:
-            UpdateMaxSlot<int8_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_SMALLINT:
-            UpdateMaxSlot<int16_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_INT:
-            UpdateMaxSlot<int32_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_BIGINT:
-            UpdateMaxSlot<int64_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_FLOAT:
-            UpdateMaxSlot<float>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_DOUBLE:
-            UpdateMaxSlot<double>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_TIMESTAMP:
-            UpdateMaxSlot<TimestampValue>(tuple, (*slot_desc)->null_indicator_offset(),
-                slot, value);
-            break;
-          case TYPE_STRING:
-            UpdateMaxStringSlot(agg_out_tuple, (*slot_desc)->null_indicator_offset(),
-                string_slot_idx, slot, value);
-            break;
-          default:
-            DCHECK(false) << "invalid type: " << TypeToString(agg_expr->type());
-        };
-        break;
+    case TAggregationOp::MIN:
+      switch (type) {
+        case TYPE_BOOLEAN:
+          UpdateMinSlot<bool>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_TINYINT:
+          UpdateMinSlot<int8_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_SMALLINT:
+          UpdateMinSlot<int16_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_INT:
+          UpdateMinSlot<int32_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_BIGINT:
+          UpdateMinSlot<int64_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_FLOAT:
+          UpdateMinSlot<float>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_DOUBLE:
+          UpdateMinSlot<double>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_TIMESTAMP:
+          UpdateMinSlot<TimestampValue>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_STRING:
+          UpdateMinStringSlot(agg_out_tuple, null_indicator_offset,
+              string_slot_idx, slot, value);
+          break;
+        default:
+          DCHECK(false) << "invalid type: " << TypeToString(type);
+      };
+      break;
 
-      case TAggregationOp::SUM:
-        switch (agg_expr->type()) {
-          case TYPE_BIGINT:
-            UpdateSumSlot<int64_t>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          case TYPE_DOUBLE:
-            UpdateSumSlot<double>(tuple, (*slot_desc)->null_indicator_offset(), slot,
-                value);
-            break;
-          default:
-            DCHECK(false) << "invalid type: " << TypeToString(agg_expr->type());
-        };
-        break;
+    case TAggregationOp::MAX:
+      switch (type) {
+        case TYPE_BOOLEAN:
+          UpdateMaxSlot<bool>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_TINYINT:
+          UpdateMaxSlot<int8_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_SMALLINT:
+          UpdateMaxSlot<int16_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_INT:
+          UpdateMaxSlot<int32_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_BIGINT:
+          UpdateMaxSlot<int64_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_FLOAT:
+          UpdateMaxSlot<float>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_DOUBLE:
+          UpdateMaxSlot<double>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_TIMESTAMP:
+          UpdateMaxSlot<TimestampValue>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_STRING:
+          UpdateMaxStringSlot(agg_out_tuple, null_indicator_offset,
+              string_slot_idx, slot, value);
+          break;
+        default:
+          DCHECK(false) << "invalid type: " << TypeToString(type);
+      };
+      break;
+
+    case TAggregationOp::SUM:
+      switch (type) {
+        case TYPE_BIGINT:
+          UpdateSumSlot<int64_t>(tuple, null_indicator_offset, slot, value);
+          break;
+        case TYPE_DOUBLE:
+          UpdateSumSlot<double>(tuple, null_indicator_offset, slot, value);
+          break;
+        default:
+          DCHECK(false) << "invalid type: " << TypeToString(type);
+      };
+      break;
+
+    case TAggregationOp::DISTINCT_PC:
+      UpdateDistinctEstimateSlot(slot, value, input_type);
+      break;
+
+    case TAggregationOp::DISTINCT_PCSA:
+      UpdateDistinctEstimatePCSASlot(slot, value, input_type);
+      break;
+
+    case TAggregationOp::MERGE_PCSA:
+    case TAggregationOp::MERGE_PC:
+      DCHECK_EQ(input_type, TYPE_STRING);
+      UpdateMergeEstimateSlot(agg_out_tuple, string_slot_idx, slot, value);
+      break;
 
+    default:
+      DCHECK(false) << "bad aggregate operator: " << agg_op;
+  }
+}
+
+void AggregationNode::MergeAggTuple(AggregationTuple* agg_out_tuple, Tuple* src) {
+  DCHECK(agg_out_tuple != NULL);
+  int string_slot_idx = -1;
+  vector<SlotDescriptor*>::const_iterator slot_desc =
+      agg_tuple_desc_->slots().begin() + probe_exprs_.size();
+  for (vector<Expr*>::const_iterator expr = aggregate_exprs_.begin();
+      expr != aggregate_exprs_.end(); ++expr, ++slot_desc) {
+    AggregateExpr* agg_expr = static_cast<AggregateExpr*>(*expr);
+    if (agg_expr->type() == TYPE_STRING) ++string_slot_idx;
+
+    // NULL if no value has been aggregated into 'src' yet
+    if (src->IsNull((*slot_desc)->null_indicator_offset())) continue;
+    void* slot = agg_out_tuple->tuple()->GetSlot((*slot_desc)->tuple_offset());
+    void* value = src->GetSlot((*slot_desc)->tuple_offset());
+
+    // Partial counts are summed up and distinct estimate bitmaps are or'ed together,
+    // all other aggregates combine partial results the same way as input values.
+    TAggregationOp::type agg_op = agg_expr->agg_op();
+    PrimitiveType type = agg_expr->type();
+    PrimitiveType input_type = type;
+    switch (agg_op) {
+      case TAggregationOp::COUNT:
+        agg_op = TAggregationOp::SUM;
+        DCHECK_EQ(type, TYPE_BIGINT);
+        break;
       case TAggregationOp::DISTINCT_PC:
-        UpdateDistinctEstimateSlot(slot, value, agg_expr->GetChild(0)->type());
+      case TAggregationOp::MERGE_PC:
+        agg_op = TAggregationOp::MERGE_PC;
+        input_type = TYPE_STRING;
         break;
-
       case TAggregationOp::DISTINCT_PCSA:
-        UpdateDistinctEstimatePCSASlot(slot, value, agg_expr->GetChild(0)->type());
-        break;
-
       case TAggregationOp::MERGE_PCSA:
-      case TAggregationOp::MERGE_PC:
-        DCHECK_EQ(agg_expr->GetChild(0)->type(), TYPE_STRING);
-        UpdateMergeEstimateSlot(agg_out_tuple, string_slot_idx, slot, value);
+        agg_op = TAggregationOp::MERGE_PCSA;
+        input_type = TYPE_STRING;
         break;
-
       default:
-        DCHECK(false) << "bad aggregate operator: " << agg_expr->agg_op();
+        break;
     }
+    UpdateSlot(agg_out_tuple, agg_op, type, input_type,
+        (*slot_desc)->null_indicator_offset(), string_slot_idx, slot, value);
   }
 }
 
@@ -620,7 +1042,8 @@ void AggregationNode::DebugString(int indentation_level, stringstream* out) cons
   *out << string(indentation_level * 2, ' ');
   *out << "AggregationNode(tuple_id=" << agg_tuple_id_
        << " probe_exprs=" << Expr::DebugString(probe_exprs_)
-       << " agg_exprs=" << Expr::DebugString(aggregate_exprs_);
+       << " agg_exprs=" << Expr::DebugString(aggregate_exprs_)
+       << " is_preaggregation=" << is_preaggregation_;
   ExecNode::DebugString(indentation_level, out);
   *out << ")";
 }
@@ -899,7 +1322,7 @@ Function* AggregationNode::CodegenProcessRowBatch(
     
     process_batch_fn = codegen->ReplaceCallSites(process_batch_fn, false,
         eval_probe_row_fn, "EvalProbeRow", &replaced);
-    DCHECK_EQ(replaced, 1);
+    DCHECK_EQ(replaced, 2);
 
     process_batch_fn = codegen->ReplaceCallSites(process_batch_fn, false,
         hash_fn, "HashCurrentRow", &replaced);
@@ -17,6 +17,7 @@
 #define IMPALA_EXEC_AGGREGATION_NODE_H
 
 #include <functional>
+#include <list>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/exec-node.h"
@@ -36,11 +37,12 @@ class AggregationTuple;
 class LlvmCodeGen;
 class RowBatch;
 class RuntimeState;
+class SpillFile;
 struct StringValue;
 class Tuple;
 class TupleDescriptor;
 
-// Node for in-memory hash aggregation.
+// Node for hash aggregation.
 // The node creates a hash set of aggregation output tuples, which
 // contain slots for all grouping and aggregation exprs (the grouping
 // slots precede the aggregation expr slots in the output tuple descriptor).
@@ -51,6 +53,29 @@ class TupleDescriptor;
 // will be appended to the end of the normal tuple data that stores the size of buffer 
 // for that string slot.  This also results in the correct alignment because StringValue 
 // slots are 8-byte aligned and form the tail end of the tuple.
+//
+// Spilling:
+// If the hash table of a grouping aggregation exceeds the memory limit, the partially
+// aggregated tuples are split into NUM_PARTITIONS partitions by the hash of their
+// grouping values and written to scratch files (see SpillFile), and the hash table is
+// emptied.  All remaining input rows are written to the scratch file of their
+// partition.  Once the input is exhausted, each partition is aggregated on its own:
+// its partially aggregated tuples are merged into the hash table, then its input rows
+// are aggregated with the same (codegen'd) ProcessRowBatch loop as the in-memory
+// case.  A partition that doesn't fit either is repartitioned the same way, with a
+// different hash seed, up to MAX_PARTITION_DEPTH times.
+//
+// Streaming pre-aggregation:
+// The first phase of a 2-phase aggregation only needs to reduce the number of rows
+// sent to the merge aggregation, its output doesn't need to be fully aggregated.  If
+// the input rows are (nearly) unique on the grouping values, building the hash table
+// doesn't pay off: it only costs memory and delays the first output row until the
+// whole input has been consumed.  A pre-aggregation therefore checks the ratio of input
+// rows to groups after every batch.  Once that falls below
+// --streaming_preaggregation_min_reduction (or the hash table exceeds the memory
+// limit), Open() returns, GetNext() flushes the groups aggregated so far and then
+// passes the remaining input rows through, each converted into an aggregation tuple
+// of its own.  Pre-aggregations never spill.
 class AggregationNode : public ExecNode {
  public:
   AggregationNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -96,6 +121,20 @@ class AggregationNode : public ExecNode {
   // a finalize step.
   bool needs_finalize_;
 
+  // True if this is the first phase of a 2-phase aggregation (see
+  // TAggregationNode.is_preaggregation)
+  bool is_preaggregation_;
+
+  // True once the pre-aggregation has stopped aggregating and passes input rows
+  // through.  Set in Open().
+  bool streaming_;
+
+  // Child batch that is currently being passed through and the index of the next row
+  // in it.  Only used when streaming_ is true.
+  boost::scoped_ptr<RowBatch> child_batch_;
+  int child_batch_idx_;
+  bool child_eos_;
+
   // Time spent processing the child rows
   RuntimeProfile::Counter* build_timer_;
   // Time spent returning the aggregated rows
@@ -104,6 +143,48 @@ class AggregationNode : public ExecNode {
   RuntimeProfile::Counter* hash_table_buckets_counter_;   
   // Load factor in hash table
   RuntimeProfile::Counter* hash_table_load_factor_counter_;   
+  // Bytes written to scratch files
+  RuntimeProfile::Counter* spilled_bytes_counter_;
+  // Number of partitions written to scratch files
+  RuntimeProfile::Counter* spilled_partitions_counter_;
+  // Deepest repartitioning level
+  RuntimeProfile::Counter* max_partition_depth_counter_;
+  // Number of input rows passed through unaggregated by a streaming pre-aggregation
+  RuntimeProfile::Counter* rows_passed_through_counter_;
+
+  // Number of partitions the rows are split into, each time they are (re)partitioned
+  static const int NUM_PARTITIONS = 16;
+
+  // Max number of times a partition is repartitioned before giving up
+  static const int MAX_PARTITION_DEPTH = 4;
+
+  // Spilled rows of one hash partition.  Partitions are owned by pool_.
+  struct Partition {
+    // 0 for the initial partitioning, +1 for each repartitioning
+    int level;
+
+    // Partially aggregated tuples (in row_desc()'s layout) and input rows (in
+    // child(0)'s layout) that belong to this partition
+    boost::scoped_ptr<SpillFile> agg_file;
+    boost::scoped_ptr<SpillFile> input_file;
+
+    // Rows are deep copied into these batches, which are appended to the files
+    // when they fill up.
+    boost::scoped_ptr<RowBatch> agg_batch;
+    boost::scoped_ptr<RowBatch> input_batch;
+
+    Partition() : level(0) { }
+  };
+
+  // Partitions that rows are currently being spilled to, indexed by PartitionIdx().
+  // Empty if rows are aggregated in memory.
+  std::vector<Partition*> spilling_partitions_;
+
+  // Spilled partitions that still need to be aggregated
+  std::list<Partition*> spilled_partitions_;
+
+  // All partitions created so far, for cleaning up in Close()
+  std::vector<Partition*> all_partitions_;
 
   // Constructs a new aggregation output tuple (allocated from tuple_pool_),
   // initialized to grouping values computed over 'current_row_'.
@@ -136,10 +217,84 @@ class AggregationNode : public ExecNode {
   // computed over 'row'.
   void UpdateAggTuple(AggregationTuple* tuple, TupleRow* row);
 
+  // Updates 'slot' of 'tuple' with 'value' for the aggregate function 'agg_op'.
+  //  type: type of the aggregate (and 'slot')
+  //  input_type: type of 'value'
+  //  string_slot_idx: index of 'slot' in the string buffer lengths, if it's a string
+  void UpdateSlot(AggregationTuple* tuple, TAggregationOp::type agg_op,
+      PrimitiveType type, PrimitiveType input_type,
+      const NullIndicatorOffset& null_indicator_offset, int string_slot_idx,
+      void* slot, void* value);
+
+  // Merges the aggregation values of 'src', a partially aggregated tuple read back
+  // from a scratch file, into 'tuple'.  'src' must have the same grouping values.
+  void MergeAggTuple(AggregationTuple* tuple, Tuple* src);
+
+  // Returns a new aggregation output tuple (allocated from tuple_pool_) that is a
+  // copy of 'src', a partially aggregated tuple read back from a scratch file.
+  AggregationTuple* CopyAggTuple(Tuple* src);
+
   // Called when all rows have been aggregated for the aggregation tuple to compute final
   // aggregate values
   void FinalizeAggTuple(AggregationTuple* tuple);
 
+  // Returns true if this node can spill when it runs out of memory
+  bool CanSpill() const;
+
+  // Returns true if this node may stop aggregating and pass rows through
+  bool CanStream() const;
+
+  // Returns true if a pre-aggregation that consumed 'num_input_rows' so far should
+  // switch to streaming, either because the hash table doesn't reduce the number of
+  // rows enough or because it exceeded the memory limit.
+  bool ShouldStream(RuntimeState* state, int64_t num_input_rows);
+
+  // Converts rows of child_batch_, fetching more from the child as needed, into
+  // single-row aggregation tuples and adds them to 'row_batch' until it is full or
+  // the input is exhausted.
+  Status PassThroughRows(RuntimeState* state, RowBatch* row_batch);
+
+  // Returns the partition (at 'level') that a row with 'hash' belongs to
+  static int PartitionIdx(uint32_t hash, int level);
+
+  // Creates a new, empty partition at 'level'
+  Partition* CreatePartition(RuntimeState* state, int level);
+
+  // Creates NUM_PARTITIONS partitions at 'level', moves all tuples from hash_tbl_
+  // into them and empties hash_tbl_ and tuple_pool_.  Rows are spilled to the
+  // partitions until FinishSpilling() is called.
+  Status SpillHashTable(RuntimeState* state, int level);
+
+  // Adds the input rows in 'batch' to their spilling_partitions_.
+  Status SpillInputBatch(RowBatch* batch);
+
+  // Adds the partially aggregated tuples in 'batch' to their spilling_partitions_.
+  Status SpillAggBatch(RowBatch* batch);
+
+  // Flushes spilling_partitions_ and queues them in front of spilled_partitions_
+  Status FinishSpilling();
+
+  // Aggregates the next spilled partition into hash_tbl_, repartitioning partitions
+  // that don't fit.  Leaves hash_tbl_ empty if there are none left.  The tuple data
+  // of the previous partition is freed, it must have been transferred if necessary.
+  Status NextSpilledPartition(RuntimeState* state);
+
+  // Reads 'partition' back and aggregates it into hash_tbl_, starts spilling to
+  // the next level if the memory limit is exceeded.
+  Status AggregatePartition(RuntimeState* state, Partition* partition);
+
+  // Merges the partially aggregated tuples in 'batch' into hash_tbl_
+  void MergeAggBatch(RowBatch* batch);
+
+  // Aggregates 'batch' with the codegen'd function, if available
+  void ProcessRowBatch(RowBatch* batch);
+
+  // Frees the partition's staging batches and deletes its files
+  void ClosePartition(Partition* partition);
+
+  // Frees all tuples and string buffers
+  void ResetTuplePool(RuntimeState* state);
+
   // Do the aggregation for all tuple rows in the batch
   void ProcessRowBatchNoGrouping(RowBatch* batch);
   void ProcessRowBatchWithGrouping(RowBatch* batch);
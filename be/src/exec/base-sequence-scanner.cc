@@ -52,7 +52,7 @@ BaseSequenceScanner::BaseSequenceScanner(HdfsScanNode* node, RuntimeState* state
     block_start_(0),
     data_buffer_pool_(new MemPool()),
     marker_precedes_sync_(marker_precedes_sync) {
-  data_buffer_pool_->set_limits(*state->mem_limits());
+  data_buffer_pool_->set_limits(*state->mem_trackers());
 }
 
 BaseSequenceScanner::~BaseSequenceScanner() {
@@ -53,7 +53,7 @@ Status ExchangeNode::Prepare(RuntimeState* state) {
   // TODO: figure out appropriate buffer size
   DCHECK_GT(num_senders_, 0);
   stream_recvr_ = state->CreateRecvr(input_row_desc_, id_, num_senders_,
-      FLAGS_exchg_node_buffer_size_bytes, runtime_profile());
+      FLAGS_exchg_node_buffer_size_bytes, runtime_profile(), mem_tracker());
   return Status::OK;
 }
 
@@ -0,0 +1,245 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXEC_EXEC_NODE_TEST_UTIL_H
+#define IMPALA_EXEC_EXEC_NODE_TEST_UTIL_H
+
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "common/object-pool.h"
+#include "exec/exec-node.h"
+#include "runtime/descriptors.h"
+#include "runtime/primitive-type.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple.h"
+#include "runtime/tuple-row.h"
+#include "util/cpu-info.h"
+#include "util/disk-info.h"
+#include "util/mem-info.h"
+#include "gen-cpp/Data_types.h"
+#include "gen-cpp/Descriptors_types.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+
+// Helpers for tests that run exec nodes over rows generated in memory.  Unless a test
+// creates its own descriptor table, all tuples have a single, non-nullable BIGINT slot:
+// tuple i holds slot i.
+
+namespace impala {
+
+// Creates a descriptor table with one tuple per element of 'tuple_slot_types': tuple i
+// holds a slot of each type of tuple_slot_types[i], in order.  Slot ids are assigned
+// in order of the tuples.  Each slot is 8-byte aligned and follows the null indicator
+// bytes, which hold one bit per slot if 'nullable' is true.
+inline void CreateDescTbl(ObjectPool* pool,
+    const std::vector<std::vector<TPrimitiveType::type> >& tuple_slot_types,
+    bool nullable, DescriptorTbl** tbl) {
+  TDescriptorTable thrift_desc_tbl;
+  for (int i = 0; i < tuple_slot_types.size(); ++i) {
+    const std::vector<TPrimitiveType::type>& slot_types = tuple_slot_types[i];
+    int num_null_bytes = nullable ? (slot_types.size() + 7) / 8 : 0;
+    int offset = (num_null_bytes + 7) / 8 * 8;
+    for (int j = 0; j < slot_types.size(); ++j) {
+      TSlotDescriptor slot_desc;
+      slot_desc.__set_id(thrift_desc_tbl.slotDescriptors.size());
+      slot_desc.__set_parent(i);
+      slot_desc.__set_slotType(slot_types[j]);
+      slot_desc.__set_columnPos(slot_desc.id);
+      slot_desc.__set_byteOffset(offset);
+      slot_desc.__set_nullIndicatorByte(nullable ? j / 8 : 0);
+      slot_desc.__set_nullIndicatorBit(nullable ? j % 8 : -1);
+      slot_desc.__set_slotIdx(j);
+      slot_desc.__set_isMaterialized(true);
+      thrift_desc_tbl.slotDescriptors.push_back(slot_desc);
+      int byte_size = slot_types[j] == TPrimitiveType::STRING ?
+          sizeof(StringValue) : GetByteSize(ThriftToType(slot_types[j]));
+      offset += (byte_size + 7) / 8 * 8;
+    }
+    TTupleDescriptor tuple_desc;
+    tuple_desc.__set_id(i);
+    tuple_desc.__set_byteSize(offset);
+    tuple_desc.__set_numNullBytes(num_null_bytes);
+    thrift_desc_tbl.tupleDescriptors.push_back(tuple_desc);
+  }
+  Status status = DescriptorTbl::Create(pool, thrift_desc_tbl, tbl);
+  DCHECK(status.ok()) << status.GetErrorMsg();
+}
+
+// Creates a descriptor table with 'num_tuples' tuples with a single, non-nullable slot
+// of type 'slot_type'.
+inline void CreateDescTbl(ObjectPool* pool, int num_tuples, DescriptorTbl** tbl,
+    TPrimitiveType::type slot_type = TPrimitiveType::BIGINT) {
+  std::vector<std::vector<TPrimitiveType::type> > tuple_slot_types(
+      num_tuples, std::vector<TPrimitiveType::type>(1, slot_type));
+  CreateDescTbl(pool, tuple_slot_types, false, tbl);
+}
+
+// Returns a runtime state for running exec nodes over 'desc_tbl', with codegen
+// disabled and a memory limit of 'mem_limit' bytes (-1: no limit).  The nodes'
+// mem trackers are children of the state's, so the state must outlive the nodes.
+inline RuntimeState* CreateRuntimeState(ExecEnv* exec_env, DescriptorTbl* desc_tbl,
+    const TUniqueId& query_id, int64_t mem_limit) {
+  TQueryOptions query_options;
+  query_options.disable_codegen = true;
+  RuntimeState* state = new RuntimeState(query_id, query_options, "", exec_env);
+  state->set_desc_tbl(desc_tbl);
+  state->InitMemTrackers(query_id, mem_limit);
+  return state;
+}
+
+// Returns a SlotRef expr over the slot of tuple 'slot_id'.
+inline TExpr CreateSlotRefExpr(int slot_id) {
+  TExprNode node;
+  node.node_type = TExprNodeType::SLOT_REF;
+  node.type = TPrimitiveType::BIGINT;
+  node.num_children = 0;
+  TSlotRef slot_ref;
+  slot_ref.slot_id = slot_id;
+  node.__set_slot_ref(slot_ref);
+  TExpr expr;
+  expr.nodes.push_back(node);
+  return expr;
+}
+
+// Returns a plan node without a limit whose rows consist of 'tuple_ids'.
+inline TPlanNode CreatePlanNode(int node_id, TPlanNodeType::type type,
+    const std::vector<TTupleId>& tuple_ids) {
+  TPlanNode tnode;
+  tnode.node_id = node_id;
+  tnode.node_type = type;
+  tnode.num_children = 0;
+  tnode.limit = -1;
+  tnode.row_tuples = tuple_ids;
+  tnode.nullable_tuples.assign(tuple_ids.size(), false);
+  tnode.compact_data = false;
+  return tnode;
+}
+
+// Exec node that returns one row per value of 'values', in order, in batches of at
+// most 'max_batch_rows' rows.  The rows consist of a single tuple.  It poses as an
+// exchange node, whose rows also come from outside of the fragment.  If 'serialize' is
+// true, each batch is serialized and deserialized like the batches of an exchange node,
+// so that its tuple data is deserialized data (see RowBatch(const RowDescriptor&,
+// TRowBatch*)).
+class RowSourceNode : public ExecNode {
+ public:
+  RowSourceNode(ObjectPool* pool, int node_id, TTupleId tuple_id,
+      const DescriptorTbl& descs, const std::vector<int64_t>& values,
+      int max_batch_rows = 1024, bool serialize = false)
+    : ExecNode(pool, CreatePlanNode(node_id, TPlanNodeType::EXCHANGE_NODE,
+          std::vector<TTupleId>(1, tuple_id)), descs),
+      values_(values),
+      max_batch_rows_(max_batch_rows),
+      serialize_(serialize),
+      next_idx_(0) {
+  }
+
+  virtual Status Open(RuntimeState* state) {
+    next_idx_ = 0;
+    return Status::OK;
+  }
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* batch, bool* eos) {
+    if (!serialize_) return AddRows(batch, eos);
+    RowBatch src_batch(row_desc(), batch->capacity() - batch->num_rows());
+    RETURN_IF_ERROR(AddRows(&src_batch, eos));
+    TRowBatch thrift_batch;
+    src_batch.Serialize(&thrift_batch);
+    RowBatch deserialized_batch(row_desc(), &thrift_batch);
+    for (int i = 0; i < deserialized_batch.num_rows(); ++i) {
+      int row_idx = batch->AddRow();
+      batch->CopyRow(deserialized_batch.GetRow(i), batch->GetRow(row_idx));
+      batch->CommitLastRow();
+    }
+    deserialized_batch.TransferResourceOwnership(batch);
+    return Status::OK;
+  }
+
+ private:
+  // Adds the next rows to 'batch'
+  Status AddRows(RowBatch* batch, bool* eos) {
+    int num_rows = 0;
+    while (!batch->IsFull() && num_rows < max_batch_rows_ &&
+        next_idx_ < values_.size()) {
+      int row_idx = batch->AddRow();
+      Tuple* tuple = Tuple::Create(sizeof(int64_t), batch->tuple_data_pool());
+      *reinterpret_cast<int64_t*>(tuple->GetSlot(0)) = values_[next_idx_++];
+      batch->GetRow(row_idx)->SetTuple(0, tuple);
+      batch->CommitLastRow();
+      ++num_rows;
+    }
+    num_rows_returned_ += num_rows;
+    *eos = next_idx_ == values_.size();
+    return Status::OK;
+  }
+
+  std::vector<int64_t> values_;
+  int max_batch_rows_;
+  bool serialize_;
+  int next_idx_;
+};
+
+// Exec node of type Node whose children are added by the test instead of being
+// created from a TPlan.
+template <class Node>
+class TestNode : public Node {
+ public:
+  TestNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
+    : Node(pool, tnode, descs) {
+  }
+
+  void AddChild(ExecNode* child) { this->children_.push_back(child); }
+};
+
+// Returns the value of the single slot of tuple 'tuple_idx' of 'row'.
+inline int64_t GetBigIntValue(TupleRow* row, int tuple_idx) {
+  return *reinterpret_cast<int64_t*>(row->GetTuple(tuple_idx)->GetSlot(0));
+}
+
+// Prepares and opens 'node' and returns all of its rows in '*batches', one batch per
+// GetNext() call.  The batches are added to 'pool'; their rows stay valid until the
+// node is closed, which is left to the caller.
+inline Status GetAllRows(RuntimeState* state, ExecNode* node, ObjectPool* pool,
+    std::vector<RowBatch*>* batches) {
+  RETURN_IF_ERROR(node->Prepare(state));
+  RETURN_IF_ERROR(node->Open(state));
+  batches->clear();
+  bool eos = false;
+  while (!eos) {
+    RowBatch* batch = pool->Add(new RowBatch(node->row_desc(), state->batch_size()));
+    RETURN_IF_ERROR(node->GetNext(state, batch, &eos));
+    batches->push_back(batch);
+  }
+  return Status::OK;
+}
+
+// Initializes flags, logging, gtest and the system info that exec nodes depend on.
+// Called by the main() of the exec node tests.
+inline void InitExecNodeTest(int* argc, char*** argv) {
+  google::ParseCommandLineFlags(argc, argv, true);
+  google::InitGoogleLogging((*argv)[0]);
+  ::testing::InitGoogleTest(argc, *argv);
+  CpuInfo::Init();
+  DiskInfo::Init();
+  MemInfo::Init();
+}
+
+}
+
+#endif
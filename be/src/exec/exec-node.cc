@@ -29,6 +29,7 @@
 #include "exec/merge-node.h"
 #include "exec/topn-node.h"
 #include "exec/select-node.h"
+#include "exec/sort-node.h"
 #include "runtime/descriptors.h"
 #include "runtime/mem-pool.h"
 #include "runtime/row-batch.h"
@@ -75,6 +76,11 @@ Status ExecNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile_, "RowsReturned", TCounterType::UNIT);
   memory_used_counter_ =
       ADD_COUNTER(runtime_profile_, "MemoryUsed", TCounterType::BYTES);
+  mem_tracker_.reset(new MemTracker(-1, runtime_profile_->name(),
+      state->instance_mem_tracker()));
+  mem_trackers_.push_back(mem_tracker_.get());
+  runtime_profile_->AddDerivedCounter("PeakMemoryUsage", TCounterType::BYTES,
+      bind<int64_t>(&MemTracker::peak_consumption, mem_tracker_.get()));
   rows_returned_rate_ = runtime_profile()->AddDerivedCounter(
       ROW_THROUGHPUT_COUNTER, TCounterType::UNIT_PER_SECOND,
       bind<int64_t>(&RuntimeProfile::UnitsPerSecond, rows_returned_counter_,
@@ -196,10 +202,7 @@ Status ExecNode::CreateNode(ObjectPool* pool, const TPlanNode& tnode,
       if (tnode.sort_node.use_top_n) {
         *node = pool->Add(new TopNNode(pool, tnode, descs));
       } else {
-      // TODO: Need Sort Node
-      //  *node = pool->Add(new SortNode(pool, tnode, descs));
-        error_msg << "ORDER BY with no LIMIT not implemented";
-        return Status(error_msg.str());
+        *node = pool->Add(new SortNode(pool, tnode, descs));
       }
       return Status::OK;
     case TPlanNodeType::MERGE_NODE:
@@ -261,6 +264,24 @@ bool ExecNode::EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* row) {
   return true;
 }
 
+int ExecNode::EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* const* rows,
+    int* sel, int num_rows) {
+  for (int i = 0; i < num_exprs && num_rows > 0; ++i) {
+    exprs[i]->EvalBatch(rows, sel, num_rows);
+    const bool* values = exprs[i]->batch_values<bool>();
+    const uint8_t* nulls = exprs[i]->batch_nulls();
+    // Branch free compaction of the selection
+    int num_selected = 0;
+    for (int j = 0; j < num_rows; ++j) {
+      int row_idx = sel[j];
+      sel[num_selected] = row_idx;
+      num_selected += !nulls[row_idx] & values[row_idx];
+    }
+    num_rows = num_selected;
+  }
+  return num_rows;
+}
+
 // Codegen for EvalConjuncts.  The generated signature is
 // For a node with two conjunct predicates
 // define i1 @EvalConjuncts(%"class.impala::Expr"** %exprs, i32 %num_exprs,
@@ -21,7 +21,7 @@
 
 #include "common/status.h"
 #include "runtime/descriptors.h"  // for RowDescriptor
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "util/runtime-profile.h"
 #include "gen-cpp/PlanNodes_types.h"
 
@@ -110,6 +110,12 @@ class ExecNode {
   // out how to deal with declaring a templated std:vector type in IR
   static bool EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* row);
 
+  // Evaluates exprs over the rows rows[sel[0]], ..., rows[sel[num_rows - 1]] a batch
+  // at a time (see Expr::EvalBatch()).  The rows for which not all exprs return true
+  // are removed from 'sel'.  Returns the number of rows left in 'sel'.
+  static int EvalConjuncts(Expr* const* exprs, int num_exprs, TupleRow* const* rows,
+      int* sel, int num_rows);
+
   // Codegen function to evaluate the conjuncts.  Returns NULL if codegen was
   // not supported for the conjunct exprs.
   // Codegen'd signature is bool EvalConjuncts(Expr** exprs, int num_exprs, TupleRow*);
@@ -141,6 +147,12 @@ class ExecNode {
   RuntimeProfile* runtime_profile() { return runtime_profile_.get(); }
   RuntimeProfile::Counter* memory_used_counter() const { return memory_used_counter_; }
 
+  // Tracks the memory of this node; a child of the fragment instance's tracker.
+  // Set in Prepare().
+  MemTracker* mem_tracker() { return mem_tracker_.get(); }
+  // Contains mem_tracker(), for MemPools and HashTables of this node
+  std::vector<MemTracker*>* mem_trackers() { return &mem_trackers_; }
+
   // Extract node id from p->name().
   static int GetNodeIdFromProfile(RuntimeProfile* p);
 
@@ -178,6 +190,9 @@ class ExecNode {
   // Account for peak memory used by this node
   RuntimeProfile::Counter* memory_used_counter_;
 
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+  std::vector<MemTracker*> mem_trackers_;
+
   // Execution options that are determined at runtime.  This is added to the
   // runtime profile at Close().  Examples for options logged here would be
   // "Codegen Enabled"
@@ -209,7 +224,7 @@ class ExecNode {
 
 #define RETURN_IF_LIMIT_EXCEEDED(state) \
   do { \
-    if (UNLIKELY(MemLimit::LimitExceeded(*(state)->mem_limits()))) { \
+    if (UNLIKELY(MemTracker::LimitExceeded(*(state)->mem_trackers()))) { \
       return Status::MEM_LIMIT_EXCEEDED; \
     } \
   } while (false)
@@ -100,8 +100,16 @@ int HashJoinNode::ProcessProbeBatch(RowBatch* out_batch, RowBatch* probe_batch,
     if (!hash_tbl_iterator_.HasNext()) {
       // Advance to the next probe row
       if (UNLIKELY(probe_batch_pos_ == probe_rows)) goto end;
-      current_probe_row_ = probe_batch->GetRow(probe_batch_pos_++);
-      hash_tbl_iterator_ = hash_tbl_->Find(current_probe_row_);
+      if (UNLIKELY(!probe_batch_prefetched_)) {
+        // Hash the rest of the batch up front so the hash table lookups overlap
+        for (int i = probe_batch_pos_; i < probe_rows; ++i) {
+          hash_tbl_->PrefetchProbeRow(i, probe_batch->GetRow(i));
+        }
+        probe_batch_prefetched_ = true;
+      }
+      current_probe_row_ = probe_batch->GetRow(probe_batch_pos_);
+      hash_tbl_iterator_ = hash_tbl_->FindPrefetched(probe_batch_pos_);
+      ++probe_batch_pos_;
       matched_probe_ = false;
     }
   }
@@ -0,0 +1,181 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "exec/exec-node-test-util.h"
+#include "exec/hash-join-node.h"
+#include "runtime/exec-env.h"
+#include "runtime/runtime-state.h"
+#include "util/runtime-profile.h"
+
+DECLARE_bool(compress_rowbatches);
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+class HashJoinNodeTest : public testing::Test {
+ protected:
+  static const int NUM_BUILD_ROWS = 200000;
+  static const int NUM_PROBE_ROWS = 2 * NUM_BUILD_ROWS;
+
+  ObjectPool pool_;
+  ExecEnv exec_env_;
+  DescriptorTbl* desc_tbl_;
+
+  virtual void SetUp() {
+    // Tuple 0 is the probe tuple, tuple 1 the build tuple
+    CreateDescTbl(&pool_, 2, &desc_tbl_);
+  }
+
+  // Runs "probe join build on probe.slot = build.slot" within 'mem_limit' bytes and
+  // returns the number of result rows and the sum of their probe values.  Sets
+  // '*num_spilled_partitions' to the number of partitions the join spilled.  If
+  // 'serialize_build' is true, the build rows are serialized and deserialized like
+  // the rows of an exchange node.
+  void RunJoin(TJoinOp::type join_op, int64_t mem_limit,
+      const vector<int64_t>& probe_values, const vector<int64_t>& build_values,
+      int64_t* num_rows, int64_t* sum, int64_t* num_spilled_partitions,
+      bool serialize_build = false) {
+    TUniqueId query_id;
+    query_id.lo = mem_limit;
+    scoped_ptr<RuntimeState> state(
+        CreateRuntimeState(&exec_env_, desc_tbl_, query_id, mem_limit));
+    // The nodes' mem trackers are children of the state's, so the nodes go first
+    ObjectPool pool;
+
+    vector<TTupleId> tuple_ids;
+    tuple_ids.push_back(0);
+    tuple_ids.push_back(1);
+    TPlanNode tnode = CreatePlanNode(0, TPlanNodeType::HASH_JOIN_NODE, tuple_ids);
+    TEqJoinCondition eq_join_conjunct;
+    eq_join_conjunct.left = CreateSlotRefExpr(0);
+    eq_join_conjunct.right = CreateSlotRefExpr(1);
+    tnode.hash_join_node.join_op = join_op;
+    tnode.hash_join_node.eq_join_conjuncts.push_back(eq_join_conjunct);
+    tnode.__isset.hash_join_node = true;
+    TestNode<HashJoinNode>* join_node =
+        pool.Add(new TestNode<HashJoinNode>(&pool, tnode, *desc_tbl_));
+    join_node->AddChild(pool.Add(new RowSourceNode(&pool, 1, 0, *desc_tbl_,
+        probe_values)));
+    join_node->AddChild(pool.Add(new RowSourceNode(&pool, 2, 1, *desc_tbl_,
+        build_values, 1024, serialize_build)));
+
+    vector<RowBatch*> batches;
+    Status status = GetAllRows(state.get(), join_node, &pool, &batches);
+    ASSERT_TRUE(status.ok()) << status.GetErrorMsg();
+    *num_rows = 0;
+    *sum = 0;
+    for (int i = 0; i < batches.size(); ++i) {
+      for (int j = 0; j < batches[i]->num_rows(); ++j) {
+        TupleRow* row = batches[i]->GetRow(j);
+        ++*num_rows;
+        *sum += GetBigIntValue(row, 0);
+        // Unmatched probe rows of outer joins have no build tuple
+        if (row->GetTuple(1) != NULL) {
+          EXPECT_EQ(GetBigIntValue(row, 1), GetBigIntValue(row, 0));
+        }
+      }
+    }
+    *num_spilled_partitions =
+        join_node->runtime_profile()->GetCounter("SpilledPartitions")->value();
+    ASSERT_TRUE(join_node->Close(state.get()).ok());
+  }
+};
+
+// Joins the keys [0, NUM_PROBE_ROWS) with [0, NUM_BUILD_ROWS) with a memory limit that
+// is too small for the build side, so that some partitions stay resident and the
+// others are spilled.
+TEST_F(HashJoinNodeTest, Spill) {
+  vector<int64_t> probe_values;
+  for (int i = 0; i < NUM_PROBE_ROWS; ++i) {
+    probe_values.push_back(i);
+  }
+  vector<int64_t> build_values;
+  for (int i = 0; i < NUM_BUILD_ROWS; ++i) {
+    build_values.push_back(i);
+  }
+  int64_t expected_sum =
+      static_cast<int64_t>(NUM_BUILD_ROWS) * (NUM_BUILD_ROWS - 1) / 2;
+
+  // The same join in memory
+  int64_t num_rows;
+  int64_t sum;
+  int64_t num_spilled_partitions;
+  RunJoin(TJoinOp::INNER_JOIN, -1, probe_values, build_values, &num_rows, &sum,
+      &num_spilled_partitions);
+  EXPECT_EQ(num_spilled_partitions, 0);
+  EXPECT_EQ(num_rows, NUM_BUILD_ROWS);
+  EXPECT_EQ(sum, expected_sum);
+
+  RunJoin(TJoinOp::INNER_JOIN, 2 * 1024 * 1024, probe_values, build_values, &num_rows,
+      &sum, &num_spilled_partitions);
+  EXPECT_GT(num_spilled_partitions, 0);
+  EXPECT_EQ(num_rows, NUM_BUILD_ROWS);
+  EXPECT_EQ(sum, expected_sum);
+
+  // Unmatched probe rows of spilled partitions are returned as well
+  int64_t all_probe_sum =
+      static_cast<int64_t>(NUM_PROBE_ROWS) * (NUM_PROBE_ROWS - 1) / 2;
+  RunJoin(TJoinOp::LEFT_OUTER_JOIN, 2 * 1024 * 1024, probe_values, build_values,
+      &num_rows, &sum, &num_spilled_partitions);
+  EXPECT_GT(num_spilled_partitions, 0);
+  EXPECT_EQ(num_rows, NUM_PROBE_ROWS);
+  EXPECT_EQ(sum, all_probe_sum);
+}
+
+// Uncompressed deserialized build batches keep their tuple data outside of their tuple
+// pool.  The hash table must keep referencing it after the batches are reset, both
+// when the join is built in memory and when spilled partitions are reloaded.
+TEST_F(HashJoinNodeTest, UncompressedBuildBatches) {
+  google::FlagSaver flag_saver;
+  FLAGS_compress_rowbatches = false;
+  vector<int64_t> probe_values;
+  for (int i = 0; i < NUM_PROBE_ROWS; ++i) {
+    probe_values.push_back(i);
+  }
+  vector<int64_t> build_values;
+  for (int i = 0; i < NUM_BUILD_ROWS; ++i) {
+    build_values.push_back(i);
+  }
+  int64_t expected_sum =
+      static_cast<int64_t>(NUM_BUILD_ROWS) * (NUM_BUILD_ROWS - 1) / 2;
+
+  int64_t num_rows;
+  int64_t sum;
+  int64_t num_spilled_partitions;
+  RunJoin(TJoinOp::INNER_JOIN, -1, probe_values, build_values, &num_rows, &sum,
+      &num_spilled_partitions, true);
+  EXPECT_EQ(num_spilled_partitions, 0);
+  EXPECT_EQ(num_rows, NUM_BUILD_ROWS);
+  EXPECT_EQ(sum, expected_sum);
+
+  RunJoin(TJoinOp::INNER_JOIN, 2 * 1024 * 1024, probe_values, build_values, &num_rows,
+      &sum, &num_spilled_partitions, true);
+  EXPECT_GT(num_spilled_partitions, 0);
+  EXPECT_EQ(num_rows, NUM_BUILD_ROWS);
+  EXPECT_EQ(sum, expected_sum);
+}
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitExecNodeTest(&argc, &argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,17 +15,32 @@
 #include "exec/hash-join-node.h"
 
 #include <sstream>
+#include <gflags/gflags.h>
 
 #include "codegen/llvm-codegen.h"
 #include "exec/hash-table.inline.h"
+#include "exec/hdfs-scan-node.h"
+#include "exec/runtime-filter.h"
 #include "exprs/expr.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/spill-file.h"
 #include "util/debug-util.h"
+#include "util/hash-util.h"
 #include "util/runtime-profile.h"
 
 #include "gen-cpp/PlanNodes_types.h"
 
+DEFINE_bool(enable_hash_join_spilling, true, "If true, hash joins whose build side "
+    "exceeds the memory limit are partitioned and spilled to the --scratch_dirs.");
+DEFINE_bool(hash_join_open_addressing, false, "If true, hash joins use an open "
+    "addressing hash table instead of a chained one.");
+DEFINE_bool(enable_runtime_filters, true, "If true, hash joins build filters over their "
+    "build side join keys and push them into the scans on their probe side.");
+DEFINE_int64(runtime_filter_max_build_rows, 1024 * 1024, "Hash joins with more build "
+    "rows than this do not build runtime filters.");
+
 using namespace boost;
 using namespace impala;
 using namespace llvm;
@@ -41,7 +56,12 @@ HashJoinNode::HashJoinNode(
     codegen_process_build_batch_fn_(NULL),
     process_build_batch_fn_(NULL),
     codegen_process_probe_batch_fn_(NULL),
-    process_probe_batch_fn_(NULL) {
+    process_probe_batch_fn_(NULL),
+    probe_batch_prefetched_(false),
+    spilled_(false),
+    current_partition_(NULL),
+    child_probe_eos_(false),
+    runtime_filters_counter_(NULL) {
   // TODO: log errors in runtime state
   Status status = Init(pool, tnode);
   DCHECK(status.ok())
@@ -92,6 +112,14 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "ProbeRows", TCounterType::UNIT);
   hash_tbl_load_factor_counter_ =
       ADD_COUNTER(runtime_profile(), "LoadFactor", TCounterType::DOUBLE_VALUE);
+  spilled_bytes_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledBytes", TCounterType::BYTES);
+  spilled_partitions_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledPartitions", TCounterType::UNIT);
+  max_partition_depth_counter_ =
+      ADD_COUNTER(runtime_profile(), "MaxPartitionDepth", TCounterType::UNIT);
+  runtime_filters_counter_ =
+      ADD_COUNTER(runtime_profile(), "RuntimeFilters", TCounterType::UNIT);
 
   // build and probe exprs are evaluated in the context of the rows produced by our
   // right and left children, respectively
@@ -111,14 +139,18 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
     build_tuple_idx_.push_back(row_descriptor_.GetTupleIdx(build_tuple_desc->id()));
   }
 
-  build_pool_->set_limits(*state->mem_limits());
+  build_pool_->set_limits(mem_trackers_);
+  build_buffers_.set_limits(mem_trackers_);
 
   // TODO: default buckets
   hash_tbl_.reset(new HashTable(build_exprs_, probe_exprs_, build_tuple_size_, 
-      false, id(), *state->mem_limits()));
+      false, id(), mem_trackers_, 1024, FLAGS_hash_join_open_addressing));
+  if (hash_tbl_->open_addressing()) AddRuntimeExecOption("Open Addressing Hash Table");
 
   probe_batch_.reset(new RowBatch(row_descriptor_, state->batch_size()));
 
+  FindRuntimeFilterTargets(state);
+
   LlvmCodeGen* codegen = state->llvm_codegen();
   if (codegen != NULL) {
     // Codegen for hashing rows
@@ -140,6 +172,9 @@ Status HashJoinNode::Close(RuntimeState* state) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::CLOSE));
   // Must reset probe_batch_ in Close() to release resources
   probe_batch_.reset(NULL);
+  for (int i = 0; i < all_partitions_.size(); ++i) {
+    ClosePartition(all_partitions_[i]);
+  }
   if (memory_used_counter_ != NULL && hash_tbl_.get() != NULL) {
     COUNTER_UPDATE(memory_used_counter_, build_pool_->peak_allocated_bytes());
     COUNTER_UPDATE(memory_used_counter_, hash_tbl_->byte_size());
@@ -147,12 +182,15 @@ Status HashJoinNode::Close(RuntimeState* state) {
   return ExecNode::Close(state);
 }
 
-void HashJoinNode::BuildSideThread(RuntimeState* state, promise<Status>* status) {
-  status->set_value(ConstructHashTable(state));
+void HashJoinNode::BuildSideThread(RuntimeState* state,
+    ThreadResourceMgr::ResourcePool* pool, promise<Status>* status) {
+  Status build_status = ConstructHashTable(state);
   // Release the thread token as soon as possible (before the main thread joins
   // on it).  This way, if we had a chain of 10 joins using 1 additional thread,
-  // we'd keep the additional thread busy the whole time.
-  state->resource_pool()->ReleaseThreadToken(false);
+  // we'd keep the additional thread busy the whole time.  The main thread
+  // unregisters 'pool' once the status is set, so release the token before that.
+  pool->ReleaseThreadToken(false);
+  status->set_value(build_status);
 }
 
 Status HashJoinNode::ConstructHashTable(RuntimeState* state) {
@@ -167,9 +205,17 @@ Status HashJoinNode::ConstructHashTable(RuntimeState* state) {
     bool eos;
     RETURN_IF_ERROR(child(1)->GetNext(state, &build_batch, &eos));
     SCOPED_TIMER(build_timer_);
+    if (spilled_) {
+      // The rows are deep copied, build_batch keeps its tuple data
+      RETURN_IF_ERROR(PartitionBuildBatch(&build_batch));
+      build_batch.Reset();
+      if (eos) break;
+      continue;
+    }
+
     // take ownership of tuple data of build_batch
-    build_pool_->AcquireData(build_batch.tuple_data_pool(), false);
-    RETURN_IF_LIMIT_EXCEEDED(state);
+    build_batch.TransferTupleData(build_pool_.get(), &build_buffers_);
+    if (!CanSpill()) RETURN_IF_LIMIT_EXCEEDED(state);
 
     // Call codegen version if possible
     if (process_build_batch_fn_ == NULL) {
@@ -183,11 +229,449 @@ Status HashJoinNode::ConstructHashTable(RuntimeState* state) {
     COUNTER_SET(build_buckets_counter_, hash_tbl_->num_buckets());
     COUNTER_SET(hash_tbl_load_factor_counter_, hash_tbl_->load_factor());
     build_batch.Reset();
+
+    if (CanSpill() && (hash_tbl_->exceeded_limit() ||
+        MemTracker::LimitExceeded(mem_trackers_))) {
+      RETURN_IF_ERROR(InitSpilling(state));
+    }
     if (eos) break;
   }
+  if (spilled_) {
+    // The build side is too large for a selective filter
+    RETURN_IF_ERROR(LoadResidentPartitions(state));
+  } else {
+    SCOPED_TIMER(build_timer_);
+    PublishRuntimeFilters();
+  }
+  return Status::OK;
+}
+
+void HashJoinNode::FindRuntimeFilterTargets(RuntimeState* state) {
+  // Probe rows that don't match are part of the result of left and full outer joins
+  if (!FLAGS_enable_runtime_filters || match_all_probe_) return;
+  for (int i = 0; i < probe_exprs_.size(); ++i) {
+    SlotRef* slot_ref = dynamic_cast<SlotRef*>(probe_exprs_[i]);
+    if (slot_ref == NULL) continue;
+    const SlotDescriptor* slot = state->desc_tbl().GetSlotDescriptor(slot_ref->slot_id());
+    // The filter hashes the build values as values of the slot type
+    if (slot == NULL || slot->type() != build_exprs_[i]->type()) continue;
+    HdfsScanNode* scan_node = FindProbeScanNode(slot->parent());
+    if (scan_node == NULL) continue;
+    RuntimeFilterTarget target;
+    target.expr_idx = i;
+    target.scan_node = scan_node;
+    target.slot = slot;
+    runtime_filter_targets_.push_back(target);
+  }
+}
+
+HdfsScanNode* HashJoinNode::FindProbeScanNode(TupleId tuple_id) {
+  // Dropping a row at the scan must have the same effect as this join not matching
+  // it, so only nodes that return (a subset of) the unmodified rows of their first
+  // child are followed, and nodes with a limit end the search.  Probe rows of other
+  // joins that are dropped can only cause rows with a NULL probe tuple, which don't
+  // match here either.
+  ExecNode* node = child(0);
+  while (node->limit() == -1) {
+    switch (node->type()) {
+      case TPlanNodeType::HDFS_SCAN_NODE: {
+        HdfsScanNode* scan_node = static_cast<HdfsScanNode*>(node);
+        return scan_node->tuple_id() == tuple_id ? scan_node : NULL;
+      }
+      case TPlanNodeType::SELECT_NODE:
+      case TPlanNodeType::HASH_JOIN_NODE:
+        node = node->child(0);
+        break;
+      default:
+        return NULL;
+    }
+  }
+  return NULL;
+}
+
+void HashJoinNode::PublishRuntimeFilters() {
+  if (runtime_filter_targets_.empty()) return;
+  if (hash_tbl_->size() > FLAGS_runtime_filter_max_build_rows) {
+    VLOG_QUERY << "Hash join (id=" << id() << ") not building runtime filters for "
+               << hash_tbl_->size() << " build rows";
+    return;
+  }
+  vector<RuntimeFilter*> filters;
+  for (int i = 0; i < runtime_filter_targets_.size(); ++i) {
+    filters.push_back(pool_->Add(
+        new RuntimeFilter(id(), runtime_filter_targets_[i].slot, hash_tbl_->size())));
+  }
+  for (HashTable::Iterator it = hash_tbl_->Begin(); it.HasNext(); it.Next<false>()) {
+    TupleRow* row = it.GetRow();
+    for (int i = 0; i < filters.size(); ++i) {
+      Expr* build_expr = build_exprs_[runtime_filter_targets_[i].expr_idx];
+      filters[i]->Insert(build_expr->GetValue(row));
+    }
+  }
+  for (int i = 0; i < filters.size(); ++i) {
+    runtime_filter_targets_[i].scan_node->AddRuntimeFilter(filters[i]);
+  }
+  COUNTER_SET(runtime_filters_counter_, static_cast<int64_t>(filters.size()));
+}
+
+bool HashJoinNode::CanSpill() const {
+  return FLAGS_enable_hash_join_spilling && !match_all_build_;
+}
+
+int HashJoinNode::PartitionIdx(uint32_t hash, int level) {
+  // Rehash with a different seed per level so that rows that ended up in the same
+  // partition are spread out when the partition is repartitioned.  This is also
+  // independent of the bucket the row falls into in hash_tbl_.
+  return HashUtil::Hash(&hash, sizeof(hash), level) % NUM_PARTITIONS;
+}
+
+HashJoinNode::Partition* HashJoinNode::CreatePartition(RuntimeState* state, int level) {
+  Partition* partition = pool_->Add(new Partition());
+  partition->level = level;
+  partition->build_file.reset(
+      new SpillFile(state, child(1)->row_desc(), spilled_bytes_counter_));
+  partition->probe_file.reset(
+      new SpillFile(state, child(0)->row_desc(), spilled_bytes_counter_));
+  partition->build_batch.reset(new RowBatch(child(1)->row_desc(), state->batch_size()));
+  partition->probe_batch.reset(new RowBatch(child(0)->row_desc(), state->batch_size()));
+  all_partitions_.push_back(partition);
+  return partition;
+}
+
+Status HashJoinNode::InitSpilling(RuntimeState* state) {
+  DCHECK(!spilled_);
+  DCHECK(partitions_.empty());
+  spilled_ = true;
+  AddRuntimeExecOption("Spilled");
+  VLOG_QUERY << "Hash join (id=" << id() << ") exceeded the memory limit with "
+             << hash_tbl_->size() << " build rows, spilling";
+  for (int i = 0; i < NUM_PARTITIONS; ++i) {
+    partitions_.push_back(CreatePartition(state, 0));
+  }
+
+  for (HashTable::Iterator it = hash_tbl_->Begin(); it.HasNext(); it.Next<false>()) {
+    TupleRow* row = it.GetRow();
+    uint32_t hash;
+    bool has_key = hash_tbl_->HashBuildRow(row, &hash);
+    DCHECK(has_key);
+    Partition* partition = partitions_[PartitionIdx(hash, 0)];
+    RETURN_IF_ERROR(partition->build_file->AddRow(partition->build_batch.get(), row));
+  }
+  hash_tbl_->Clear();
+  ResetBuildPool(state);
+  return Status::OK;
+}
+
+Status HashJoinNode::PartitionBuildBatch(RowBatch* build_batch) {
+  for (int i = 0; i < build_batch->num_rows(); ++i) {
+    TupleRow* row = build_batch->GetRow(i);
+    uint32_t hash;
+    // Rows with NULL keys never match
+    if (!hash_tbl_->HashBuildRow(row, &hash)) continue;
+    Partition* partition = partitions_[PartitionIdx(hash, 0)];
+    RETURN_IF_ERROR(partition->build_file->AddRow(partition->build_batch.get(), row));
+  }
+  COUNTER_UPDATE(build_row_counter_, build_batch->num_rows());
+  return Status::OK;
+}
+
+Status HashJoinNode::LoadResidentPartitions(RuntimeState* state) {
+  DCHECK_EQ(hash_tbl_->size(), 0);
+  for (int i = 0; i < partitions_.size(); ++i) {
+    Partition* partition = partitions_[i];
+    RETURN_IF_ERROR(partition->build_file->AddBatch(partition->build_batch.get()));
+    partition->build_batch->Reset();
+    RETURN_IF_ERROR(partition->build_file->PrepareForRead());
+  }
+
+  // Load partitions in order while they are estimated to fit.  Empty partitions are
+  // always resident, their probe rows can be processed right away.
+  bool limit_exceeded = false;
+  for (int i = 0; i < partitions_.size(); ++i) {
+    Partition* partition = partitions_[i];
+    SpillFile* build_file = partition->build_file.get();
+    if (build_file->num_rows() == 0) {
+      partition->is_resident = true;
+      continue;
+    }
+    if (limit_exceeded) continue;
+    int64_t needed_bytes = build_file->uncompressed_bytes() +
+        hash_tbl_->EstimatedByteSize(build_file->num_rows());
+    if (needed_bytes >= MemTracker::SpareCapacity(mem_trackers_)) continue;
+
+    bool fits;
+    RETURN_IF_ERROR(LoadBuildPartition(state, partition, &fits));
+    if (fits) {
+      partition->is_resident = true;
+    } else {
+      // The estimate was off.  Rows of this partition are mixed with the resident
+      // ones, so unload all of them and join every partition from disk.
+      limit_exceeded = true;
+      hash_tbl_->Clear();
+      ResetBuildPool(state);
+      for (int j = 0; j < partitions_.size(); ++j) {
+        if (partitions_[j]->build_file->num_rows() > 0) {
+          partitions_[j]->is_resident = false;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < partitions_.size(); ++i) {
+    if (partitions_[i]->is_resident) {
+      // The build rows are in hash_tbl_, the file isn't needed anymore
+      partitions_[i]->build_file->Close();
+    } else {
+      spilled_partitions_.push_back(partitions_[i]);
+    }
+  }
+  COUNTER_UPDATE(spilled_partitions_counter_, spilled_partitions_.size());
+  COUNTER_SET(build_buckets_counter_, hash_tbl_->num_buckets());
+  COUNTER_SET(hash_tbl_load_factor_counter_, hash_tbl_->load_factor());
+  return Status::OK;
+}
+
+Status HashJoinNode::LoadBuildPartition(RuntimeState* state, Partition* partition,
+    bool* fits) {
+  RETURN_IF_ERROR(partition->build_file->PrepareForRead());
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RowBatch* batch;
+    RETURN_IF_ERROR(partition->build_file->GetNext(&batch));
+    if (batch == NULL) break;
+    scoped_ptr<RowBatch> build_batch(batch);
+    build_batch->TransferTupleData(build_pool_.get(), &build_buffers_);
+    if (process_build_batch_fn_ == NULL) {
+      ProcessBuildBatch(build_batch.get());
+    } else {
+      process_build_batch_fn_(this, build_batch.get());
+    }
+    if (hash_tbl_->exceeded_limit() || MemTracker::LimitExceeded(mem_trackers_)) {
+      *fits = false;
+      return Status::OK;
+    }
+  }
+  *fits = true;
+  return Status::OK;
+}
+
+Status HashJoinNode::PartitionProbeBatch(RowBatch* probe_batch) {
+  // Resident rows are compacted to the front of the batch
+  int num_resident_rows = 0;
+  for (int i = 0; i < probe_batch->num_rows(); ++i) {
+    TupleRow* row = probe_batch->GetRow(i);
+    uint32_t hash;
+    int partition_idx;
+    if (hash_tbl_->HashProbeRow(row, &hash)) {
+      partition_idx = PartitionIdx(hash, 0);
+    } else {
+      // Rows with NULL keys never match.  They are only needed for outer joins and
+      // are returned unmatched by whichever partition they are in.
+      if (!match_all_probe_) continue;
+      partition_idx = 0;
+    }
+    Partition* partition = partitions_[partition_idx];
+    if (partition->is_resident) {
+      probe_batch->CopyRow(row, probe_batch->GetRow(num_resident_rows++));
+    } else {
+      RETURN_IF_ERROR(partition->probe_file->AddRow(partition->probe_batch.get(), row));
+    }
+  }
+  probe_batch->set_num_rows(num_resident_rows);
+  return Status::OK;
+}
+
+Status HashJoinNode::GetNextProbeBatch(RuntimeState* state, RowBatch* out_batch) {
+  probe_batch_prefetched_ = false;
+  if (!spilled_) {
+    RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_eos_));
+    COUNTER_UPDATE(probe_row_counter_, probe_batch_->num_rows());
+    return Status::OK;
+  }
+
+  if (!child_probe_eos_) {
+    RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &child_probe_eos_));
+    COUNTER_UPDATE(probe_row_counter_, probe_batch_->num_rows());
+    RETURN_IF_ERROR(PartitionProbeBatch(probe_batch_.get()));
+    if (!child_probe_eos_) return Status::OK;
+    // The build files of these partitions were finished in LoadResidentPartitions(),
+    // only their probe rows are still staged
+    for (list<Partition*>::iterator it = spilled_partitions_.begin();
+         it != spilled_partitions_.end(); ++it) {
+      Partition* partition = *it;
+      RETURN_IF_ERROR(partition->probe_file->AddBatch(partition->probe_batch.get()));
+      partition->probe_batch->Reset();
+    }
+    // The remaining rows still need the resident partitions
+    if (probe_batch_->num_rows() > 0) return Status::OK;
+  }
+
+  DCHECK_EQ(probe_batch_->num_rows(), 0);
+  while (true) {
+    if (current_partition_ != NULL) {
+      RowBatch* batch;
+      RETURN_IF_ERROR(current_partition_->probe_file->GetNext(&batch));
+      if (batch != NULL) {
+        scoped_ptr<RowBatch> spilled_batch(batch);
+        CopyToProbeBatch(spilled_batch.get());
+        return Status::OK;
+      }
+    }
+    bool found;
+    RETURN_IF_ERROR(NextSpilledPartition(state, out_batch, &found));
+    if (!found) {
+      probe_eos_ = true;
+      return Status::OK;
+    }
+  }
+}
+
+Status HashJoinNode::NextSpilledPartition(RuntimeState* state, RowBatch* out_batch,
+    bool* found) {
+  // Rows that were already returned may still reference the current build rows
+  if (out_batch != NULL) {
+    out_batch->tuple_data_pool()->AcquireData(build_pool_.get(), false);
+    build_buffers_.TransferTo(out_batch->tuple_data_buffers());
+  }
+  ResetBuildPool(state);
+  hash_tbl_->Clear();
+  if (current_partition_ != NULL) {
+    ClosePartition(current_partition_);
+    current_partition_ = NULL;
+  }
+
+  *found = false;
+  while (!spilled_partitions_.empty()) {
+    RETURN_IF_CANCELLED(state);
+    Partition* partition = spilled_partitions_.front();
+    spilled_partitions_.pop_front();
+    if (partition->probe_file->num_rows() == 0 ||
+        (partition->build_file->num_rows() == 0 && !match_all_probe_)) {
+      // Nothing can match
+      ClosePartition(partition);
+      continue;
+    }
+
+    bool fits;
+    {
+      SCOPED_TIMER(build_timer_);
+      RETURN_IF_ERROR(LoadBuildPartition(state, partition, &fits));
+    }
+    if (!fits) {
+      hash_tbl_->Clear();
+      ResetBuildPool(state);
+      RETURN_IF_ERROR(Repartition(state, partition));
+      continue;
+    }
+    VLOG_FILE << "Hash join (id=" << id() << ") joining spilled partition with "
+              << partition->build_file->num_rows() << " build rows and "
+              << partition->probe_file->num_rows() << " probe rows";
+    RETURN_IF_ERROR(partition->probe_file->PrepareForRead());
+    current_partition_ = partition;
+    *found = true;
+    return Status::OK;
+  }
+  return Status::OK;
+}
+
+Status HashJoinNode::Repartition(RuntimeState* state, Partition* partition) {
+  int level = partition->level + 1;
+  if (level > MAX_PARTITION_DEPTH) {
+    stringstream ss;
+    ss << "Hash join (id=" << id() << ") could not partition its build side to fit in "
+       << "the memory limit after " << MAX_PARTITION_DEPTH << " repartitions. The join "
+       << "key may have too many duplicate values.";
+    return Status(TStatusCode::MEM_LIMIT_EXCEEDED, ss.str());
+  }
+  if (max_partition_depth_counter_->value() < level) {
+    COUNTER_SET(max_partition_depth_counter_, static_cast<int64_t>(level));
+  }
+
+  vector<Partition*> children;
+  for (int i = 0; i < NUM_PARTITIONS; ++i) {
+    children.push_back(CreatePartition(state, level));
+  }
+
+  RETURN_IF_ERROR(partition->build_file->PrepareForRead());
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RowBatch* batch;
+    RETURN_IF_ERROR(partition->build_file->GetNext(&batch));
+    if (batch == NULL) break;
+    scoped_ptr<RowBatch> build_batch(batch);
+    for (int i = 0; i < build_batch->num_rows(); ++i) {
+      TupleRow* row = build_batch->GetRow(i);
+      uint32_t hash;
+      if (!hash_tbl_->HashBuildRow(row, &hash)) continue;
+      Partition* child = children[PartitionIdx(hash, level)];
+      RETURN_IF_ERROR(child->build_file->AddRow(child->build_batch.get(), row));
+    }
+  }
+
+  RETURN_IF_ERROR(partition->probe_file->PrepareForRead());
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RowBatch* batch;
+    RETURN_IF_ERROR(partition->probe_file->GetNext(&batch));
+    if (batch == NULL) break;
+    scoped_ptr<RowBatch> probe_batch(batch);
+    for (int i = 0; i < probe_batch->num_rows(); ++i) {
+      TupleRow* row = probe_batch->GetRow(i);
+      uint32_t hash;
+      int partition_idx = 0;
+      if (hash_tbl_->HashProbeRow(row, &hash)) partition_idx = PartitionIdx(hash, level);
+      Partition* child = children[partition_idx];
+      RETURN_IF_ERROR(child->probe_file->AddRow(child->probe_batch.get(), row));
+    }
+  }
+  ClosePartition(partition);
+
+  for (int i = children.size() - 1; i >= 0; --i) {
+    RETURN_IF_ERROR(FlushPartition(children[i]));
+    spilled_partitions_.push_front(children[i]);
+  }
+  COUNTER_UPDATE(spilled_partitions_counter_, children.size());
+  return Status::OK;
+}
+
+void HashJoinNode::CopyToProbeBatch(RowBatch* spilled_batch) {
+  DCHECK_EQ(probe_batch_->num_rows(), 0);
+  DCHECK_LE(spilled_batch->num_rows(), probe_batch_->capacity());
+  int num_probe_tuples = child(0)->row_desc().tuple_descriptors().size();
+  for (int i = 0; i < spilled_batch->num_rows(); ++i) {
+    TupleRow* src = spilled_batch->GetRow(i);
+    TupleRow* dst = probe_batch_->GetRow(probe_batch_->AddRow());
+    for (int j = 0; j < num_probe_tuples; ++j) {
+      dst->SetTuple(j, src->GetTuple(j));
+    }
+    probe_batch_->CommitLastRow();
+  }
+  spilled_batch->TransferResourceOwnership(probe_batch_.get());
+}
+
+Status HashJoinNode::FlushPartition(Partition* partition) {
+  RETURN_IF_ERROR(partition->build_file->AddBatch(partition->build_batch.get()));
+  RETURN_IF_ERROR(partition->probe_file->AddBatch(partition->probe_batch.get()));
+  partition->build_batch->Reset();
+  partition->probe_batch->Reset();
+  RETURN_IF_ERROR(partition->build_file->PrepareForRead());
+  RETURN_IF_ERROR(partition->probe_file->PrepareForRead());
   return Status::OK;
 }
 
+void HashJoinNode::ClosePartition(Partition* partition) {
+  partition->build_batch.reset(NULL);
+  partition->probe_batch.reset(NULL);
+  if (partition->build_file.get() != NULL) partition->build_file->Close();
+  if (partition->probe_file.get() != NULL) partition->probe_file->Close();
+}
+
+void HashJoinNode::ResetBuildPool(RuntimeState* state) {
+  build_pool_.reset(new MemPool());
+  build_pool_->set_limits(mem_trackers_);
+  build_buffers_.Clear();
+}
+
 Status HashJoinNode::Open(RuntimeState* state) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::OPEN));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
@@ -217,11 +701,16 @@ Status HashJoinNode::Open(RuntimeState* state) {
   // Kick-off the construction of the build-side table in a separate
   // thread, so that the left child can do any initialisation in parallel.
   // Only do this if we can get a thread token.  Otherwise, do this in the
-  // main thread
+  // main thread.  The token comes from a sub pool of the fragment's pool, so the
+  // build side gets a thread even if the fragment's scanners use up the rest.
+  ThreadResourceMgr* thread_mgr = state->exec_env()->thread_mgr();
+  ThreadResourceMgr::ResourcePool* build_pool = thread_mgr->RegisterPool(
+      ThreadResourceMgr::HASH_JOIN_BUILD_POOL_WEIGHT, state->resource_pool());
   promise<Status> thread_status;
-  if (state->resource_pool()->TryAcquireThreadToken()) {
+  if (build_pool->TryAcquireThreadToken()) {
     AddRuntimeExecOption("Hash Table Built Asynchronously");
-    thread(bind(&HashJoinNode::BuildSideThread, this, state, &thread_status));
+    thread(bind(&HashJoinNode::BuildSideThread, this, state, build_pool,
+        &thread_status));
   } else {
     thread_status.set_value(ConstructHashTable(state));
   }
@@ -234,15 +723,16 @@ Status HashJoinNode::Open(RuntimeState* state) {
   // Blocks until ConstructHashTable has returned, after which
   // the hash table is fully constructed and we can start the probe
   // phase.
-  RETURN_IF_ERROR(thread_status.get_future().get());
+  Status build_status = thread_status.get_future().get();
+  thread_mgr->UnregisterPool(build_pool);
+  RETURN_IF_ERROR(build_status);
 
   VLOG_ROW << hash_tbl_->DebugString(true, &child(1)->row_desc());
   RETURN_IF_ERROR(open_status);
 
   // seed probe batch and current_probe_row_, etc.
   while (true) {
-    RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_eos_));
-    COUNTER_UPDATE(probe_row_counter_, probe_batch_->num_rows());
+    RETURN_IF_ERROR(GetNextProbeBatch(state, NULL));
     probe_batch_pos_ = 0;
     if (probe_batch_->num_rows() == 0) {
       if (probe_eos_) {
@@ -353,7 +843,7 @@ Status HashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch, bool* eos
       if (!probe_eos_) {
         while (true) {
           probe_timer.Stop();
-          RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_eos_));
+          RETURN_IF_ERROR(GetNextProbeBatch(state, out_batch));
           probe_timer.Start();
           if (probe_batch_->num_rows() == 0) {
             // Empty batches can still contain IO buffers, which need to be passed up to
@@ -366,7 +856,6 @@ Status HashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch, bool* eos
             if (out_batch->IsFull() || out_batch->AtResourceLimit()) return Status::OK;
             continue;
           } else {
-            COUNTER_UPDATE(probe_row_counter_, probe_batch_->num_rows());
             break;
           }
         }
@@ -455,9 +944,8 @@ Status HashJoinNode::LeftJoinGetNext(RuntimeState* state,
         break;
       } else {
         probe_timer.Stop();
-        RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_eos_));
+        RETURN_IF_ERROR(GetNextProbeBatch(state, out_batch));
         probe_timer.Start();
-        COUNTER_UPDATE(probe_row_counter_, probe_batch_->num_rows());
       }
     }
   }
@@ -672,7 +1160,7 @@ Function* HashJoinNode::CodegenProcessProbeBatch(LlvmCodeGen* codegen,
 
   process_probe_batch_fn = codegen->ReplaceCallSites(process_probe_batch_fn, false,
       eval_row_fn, "EvalProbeRow", &replaced);
-  DCHECK_EQ(replaced, 1);
+  DCHECK_EQ(replaced, 2);
 
   process_probe_batch_fn = codegen->ReplaceCallSites(process_probe_batch_fn, false,
       create_output_row_fn, "CreateOutputRow", &replaced);
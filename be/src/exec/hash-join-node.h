@@ -19,20 +19,27 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/thread.hpp>
+#include <list>
 #include <string>
 
 #include "exec/exec-node.h"
 #include "exec/hash-table.h"
+#include "runtime/row-batch.h"
+#include "runtime/thread-resource-mgr.h"
 
 #include "gen-cpp/PlanNodes_types.h"  // for TJoinOp
 
 namespace impala {
 
+class HdfsScanNode;
 class MemPool;
 class RowBatch;
+class RuntimeFilter;
+class SlotDescriptor;
+class SpillFile;
 class TupleRow;
 
-// Node for in-memory hash joins:
+// Node for hash joins:
 // - builds up a hash table with the rows produced by our right input
 //   (child(1)); build exprs are the rhs exprs of our equi-join predicates
 // - for each row from our left input, probes the hash table to retrieve
@@ -44,6 +51,28 @@ class TupleRow;
 //   multiple rows per left input row
 // - TODO: fix this, so in the case of 1x1/nx1 joins (for instance, fact to dimension tbl)
 //   we don't do these extra copies
+//
+// Spilling:
+// If the build side does not fit in the memory limit, the join switches to a hybrid
+// hash join (unless it is a right/full outer join, which still fails in that case):
+// - the build rows are split into NUM_PARTITIONS partitions by the hash of their
+//   join key.  All partitions are written to scratch files (see SpillFile) and as many
+//   partitions as fit in the remaining memory are loaded back into the hash table
+//   ("resident" partitions).
+// - probe rows that fall into a resident partition are joined right away; all other
+//   probe rows are written to the scratch file of their partition.
+// - after the probe input is exhausted, the spilled partitions are joined one at a
+//   time.  A spilled partition whose build side still does not fit is repartitioned
+//   with a different hash seed, up to MAX_PARTITION_DEPTH times.
+//
+// Runtime filters:
+// If a probe expr is a slot of a tuple that is produced by an HdfsScanNode in this
+// fragment, and the rows of that scan reach this node unchanged, the join builds a
+// RuntimeFilter over the build values of that expr once the hash table is complete
+// and hands it to the scan node.  The scanners then drop rows that cannot match
+// before they are passed up the plan, and parquet row groups whose column statistics
+// lie outside the range of the build values are not read at all.  This is only done
+// for joins that do not return unmatched probe rows.
 class HashJoinNode : public ExecNode {
  public:
   HashJoinNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -87,11 +116,17 @@ class HashJoinNode : public ExecNode {
   bool eos_;  // if true, nothing left to return in GetNext()
   boost::scoped_ptr<MemPool> build_pool_;  // holds everything referenced in hash_tbl_
 
+  // Deserialized tuple data of the build batches, which hash_tbl_ references as well
+  TupleDataBuffers build_buffers_;
+
   // probe_batch_ must be cleared before calling GetNext().  The child node
   // does not initialize all tuple ptrs in the row, only the ones that it
   // is responsible for.
   boost::scoped_ptr<RowBatch> probe_batch_;
   int probe_batch_pos_;  // current scan pos in probe_batch_
+  // true if the remaining rows of probe_batch_ were passed to
+  // HashTable::PrefetchProbeRow()
+  bool probe_batch_prefetched_;
   bool probe_eos_;  // if true, probe child has no more rows to process
   TupleRow* current_probe_row_;
 
@@ -125,13 +160,78 @@ class HashJoinNode : public ExecNode {
   RuntimeProfile::Counter* probe_row_counter_;   // num probe rows
   RuntimeProfile::Counter* build_buckets_counter_;   // num buckets in hash table
   RuntimeProfile::Counter* hash_tbl_load_factor_counter_;
+  RuntimeProfile::Counter* spilled_bytes_counter_;   // bytes written to scratch files
+  RuntimeProfile::Counter* spilled_partitions_counter_;  // num partitions spilled
+  RuntimeProfile::Counter* max_partition_depth_counter_;  // deepest repartitioning
+
+  // Number of partitions the input is split into, each time it is (re)partitioned
+  static const int NUM_PARTITIONS = 16;
+
+  // Max number of times a partition is repartitioned before giving up
+  static const int MAX_PARTITION_DEPTH = 4;
+
+  // Build and probe rows of one hash partition.  Partitions are owned by pool_.
+  struct Partition {
+    // 0 for the initial partitioning, +1 for each repartitioning
+    int level;
+
+    // true if the partition's build rows are in hash_tbl_; only level 0 partitions
+    // can be resident.
+    bool is_resident;
+
+    // Build rows in child(1)'s layout, probe rows in child(0)'s layout
+    boost::scoped_ptr<SpillFile> build_file;
+    boost::scoped_ptr<SpillFile> probe_file;
+
+    // Rows are deep copied into these batches, which are appended to the files
+    // when they fill up.
+    boost::scoped_ptr<RowBatch> build_batch;
+    boost::scoped_ptr<RowBatch> probe_batch;
+
+    Partition() : level(0), is_resident(false) { }
+  };
+
+  // true once the build side exceeded the memory limit and was partitioned
+  bool spilled_;
+
+  // The initial (level 0) partitions, indexed by PartitionIdx()
+  std::vector<Partition*> partitions_;
+
+  // Spilled partitions that still need to be joined
+  std::list<Partition*> spilled_partitions_;
+
+  // All partitions created so far, for cleaning up in Close()
+  std::vector<Partition*> all_partitions_;
+
+  // The spilled partition that is currently being joined.  NULL while joining the
+  // resident partitions.
+  Partition* current_partition_;
+
+  // true if child(0) has no more rows.  probe_eos_ is only set once all spilled
+  // partitions have been joined as well.
+  bool child_probe_eos_;
+
+  // A probe side scan node that a runtime filter over build_exprs_[expr_idx] is
+  // applied to, on 'slot'.
+  struct RuntimeFilterTarget {
+    int expr_idx;
+    HdfsScanNode* scan_node;
+    const SlotDescriptor* slot;
+  };
+
+  // Set in Prepare()
+  std::vector<RuntimeFilterTarget> runtime_filter_targets_;
+
+  RuntimeProfile::Counter* runtime_filters_counter_;  // num filters published
 
   // set up build_- and probe_exprs_
   Status Init(ObjectPool* pool, const TPlanNode& tnode);
 
   // Supervises ConstructHashTable in a separate thread, and
-  // returns its status in the promise parameter.
-  void BuildSideThread(RuntimeState* state, boost::promise<Status>* status);
+  // returns its status in the promise parameter.  Releases the thread's token
+  // back to 'pool'.
+  void BuildSideThread(RuntimeState* state, ThreadResourceMgr::ResourcePool* pool,
+      boost::promise<Status>* status);
 
   // We parallelise building the build-side with Open'ing the
   // probe-side. If, for example, the probe-side child is another
@@ -139,6 +239,78 @@ class HashJoinNode : public ExecNode {
   // same time.
   Status ConstructHashTable(RuntimeState* state);
 
+  // Populates runtime_filter_targets_.
+  void FindRuntimeFilterTargets(RuntimeState* state);
+
+  // Returns the HdfsScanNode producing 'tuple_id' if its rows are passed through to
+  // this node's probe side unmodified, otherwise NULL.
+  HdfsScanNode* FindProbeScanNode(TupleId tuple_id);
+
+  // Builds a RuntimeFilter for each of runtime_filter_targets_ from the rows in
+  // hash_tbl_ and adds it to the target's scan node.  Must be called after the hash
+  // table is complete.
+  void PublishRuntimeFilters();
+
+  // Returns true if this join can spill its build side when it runs out of memory.
+  // Right and full outer joins need all build rows in memory to produce the
+  // unmatched build rows.
+  bool CanSpill() const;
+
+  // Returns the partition (at 'level') that a row with 'hash' belongs to
+  static int PartitionIdx(uint32_t hash, int level);
+
+  // Creates a new, empty partition at 'level'
+  Partition* CreatePartition(RuntimeState* state, int level);
+
+  // Moves all rows from hash_tbl_ into new level 0 partitions and empties hash_tbl_
+  // and build_pool_.  Called when the build side first exceeds the memory limit.
+  Status InitSpilling(RuntimeState* state);
+
+  // Adds the rows of 'build_batch' to their level 0 partitions
+  Status PartitionBuildBatch(RowBatch* build_batch);
+
+  // Called after the build side has been partitioned: loads as many partitions into
+  // hash_tbl_ as fit in the memory limit and queues the rest in spilled_partitions_.
+  Status LoadResidentPartitions(RuntimeState* state);
+
+  // Inserts all build rows of 'partition' into hash_tbl_.  Stops and sets *fits to
+  // false if the memory limit is exceeded.
+  Status LoadBuildPartition(RuntimeState* state, Partition* partition, bool* fits);
+
+  // Removes the rows of non-resident partitions from 'probe_batch' and writes them
+  // to the probe files of their partitions.
+  Status PartitionProbeBatch(RowBatch* probe_batch);
+
+  // Gets the next batch of probe rows into probe_batch_ and updates probe_eos_.
+  // Without spilling, this is simply child(0)->GetNext().  After spilling, this
+  // returns the probe rows of the resident partitions followed by the probe rows
+  // of each spilled partition, switching hash_tbl_ to the next spilled partition as
+  // needed.  Tuple data of the previous partition is handed to 'out_batch', or freed
+  // if it is NULL.
+  Status GetNextProbeBatch(RuntimeState* state, RowBatch* out_batch);
+
+  // Loads the build side of the next spilled partition with probe rows into
+  // hash_tbl_, repartitioning partitions that don't fit.  Sets *found to false if
+  // there are no spilled partitions left.
+  Status NextSpilledPartition(RuntimeState* state, RowBatch* out_batch, bool* found);
+
+  // Splits 'partition' into NUM_PARTITIONS partitions at the next level and queues
+  // them at the front of spilled_partitions_.
+  Status Repartition(RuntimeState* state, Partition* partition);
+
+  // Copies the probe rows in 'spilled_batch' (child(0)'s layout) into probe_batch_
+  // and transfers the batch's resources to it.
+  void CopyToProbeBatch(RowBatch* spilled_batch);
+
+  // Writes the partition's staging batches to its files and prepares them for reading
+  Status FlushPartition(Partition* partition);
+
+  // Frees the partition's staging batches and deletes its files
+  void ClosePartition(Partition* partition);
+
+  // Frees all tuple data in build_pool_ and build_buffers_
+  void ResetBuildPool(RuntimeState* state);
+
   // GetNext helper function for the common join cases: Inner join, left semi and left
   // outer
   Status LeftJoinGetNext(RuntimeState* state, RowBatch* row_batch, bool* eos);
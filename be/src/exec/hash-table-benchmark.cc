@@ -0,0 +1,146 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+#include "common/object-pool.h"
+#include "exec/hash-table.inline.h"
+#include "exprs/expr.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/tuple-row.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+using namespace impala;
+using namespace std;
+
+// Benchmark for probing a large hash table (larger than the caches) with the chained
+// and open addressing layouts, each with Find() and the batched
+// PrefetchProbeRow()/FindPrefetched() lookups.  The build side has one row per key,
+// half of the probes find a match.  The rate is the number of probe batches of
+// PROBE_BATCH_SIZE rows per ms.
+
+// Number of build rows
+const int NUM_BUILD_ROWS = 4 * 1024 * 1024;
+
+// Number of probe rows per benchmark iteration, i.e. the size of a row batch
+const int PROBE_BATCH_SIZE = 1024;
+
+// Number of distinct probe batches that are cycled through
+const int NUM_PROBE_BATCHES = 64;
+
+struct TestData {
+  HashTable* table;
+  vector<TupleRow*> probe_rows;
+  int next_batch;
+  int64_t num_matches;
+};
+
+static TupleRow* CreateTupleRow(MemPool* pool, int32_t val) {
+  uint8_t* tuple_row_mem = pool->Allocate(sizeof(int32_t*));
+  uint8_t* tuple_mem = pool->Allocate(sizeof(int32_t));
+  *reinterpret_cast<int32_t*>(tuple_mem) = val;
+  TupleRow* row = reinterpret_cast<TupleRow*>(tuple_row_mem);
+  row->SetTuple(0, reinterpret_cast<Tuple*>(tuple_mem));
+  return row;
+}
+
+static TupleRow** NextProbeBatch(TestData* data) {
+  TupleRow** rows = &data->probe_rows[data->next_batch * PROBE_BATCH_SIZE];
+  data->next_batch = (data->next_batch + 1) % NUM_PROBE_BATCHES;
+  return rows;
+}
+
+void TestFind(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    TupleRow** rows = NextProbeBatch(data);
+    for (int j = 0; j < PROBE_BATCH_SIZE; ++j) {
+      HashTable::Iterator iter = data->table->Find(rows[j]);
+      while (iter.HasNext()) {
+        ++data->num_matches;
+        iter.Next<true>();
+      }
+    }
+  }
+}
+
+void TestFindPrefetched(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    TupleRow** rows = NextProbeBatch(data);
+    for (int j = 0; j < PROBE_BATCH_SIZE; ++j) {
+      data->table->PrefetchProbeRow(j, rows[j]);
+    }
+    for (int j = 0; j < PROBE_BATCH_SIZE; ++j) {
+      HashTable::Iterator iter = data->table->FindPrefetched(j, rows[j]);
+      while (iter.HasNext()) {
+        ++data->num_matches;
+        iter.Next<true>();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  ObjectPool obj_pool;
+  MemPool mem_pool;
+  RowDescriptor desc;
+  vector<Expr*> build_exprs;
+  vector<Expr*> probe_exprs;
+  build_exprs.push_back(obj_pool.Add(new SlotRef(TYPE_INT, 0)));
+  probe_exprs.push_back(obj_pool.Add(new SlotRef(TYPE_INT, 0)));
+  Status status = Expr::Prepare(build_exprs, NULL, desc);
+  if (status.ok()) status = Expr::Prepare(probe_exprs, NULL, desc);
+  if (!status.ok()) {
+    cerr << status.GetErrorMsg() << endl;
+    return 1;
+  }
+
+  HashTable chained_table(build_exprs, probe_exprs, 1, false, 0);
+  HashTable open_table(build_exprs, probe_exprs, 1, false, 0, vector<MemTracker*>(),
+      1024, true);
+  for (int i = 0; i < NUM_BUILD_ROWS; ++i) {
+    TupleRow* row = CreateTupleRow(&mem_pool, i);
+    chained_table.Insert(row);
+    open_table.Insert(row);
+  }
+
+  vector<TupleRow*> probe_rows;
+  srand(0);
+  for (int i = 0; i < PROBE_BATCH_SIZE * NUM_PROBE_BATCHES; ++i) {
+    probe_rows.push_back(CreateTupleRow(&mem_pool, rand() % (2 * NUM_BUILD_ROWS)));
+  }
+
+  TestData chained_data = { &chained_table, probe_rows, 0, 0 };
+  TestData chained_prefetch_data = { &chained_table, probe_rows, 0, 0 };
+  TestData open_data = { &open_table, probe_rows, 0, 0 };
+  TestData open_prefetch_data = { &open_table, probe_rows, 0, 0 };
+
+  Benchmark suite("Hash Table Probe");
+  suite.AddBenchmark("Chained", TestFind, &chained_data);
+  suite.AddBenchmark("Chained Prefetched", TestFindPrefetched, &chained_prefetch_data);
+  suite.AddBenchmark("Open Addressing", TestFind, &open_data);
+  suite.AddBenchmark("Open Addressing Prefetched", TestFindPrefetched,
+      &open_prefetch_data);
+  cout << suite.Measure() << endl;
+  return 0;
+}
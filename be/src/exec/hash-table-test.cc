@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -24,7 +25,7 @@
 #include "exprs/expr.h"
 #include "runtime/mem-pool.h"
 #include "runtime/string-value.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "util/cpu-info.h"
 #include "util/runtime-profile.h"
 
@@ -32,6 +33,26 @@ using namespace std;
 
 namespace impala {
 
+// Computed string expr over rows with a single INT tuple.  Like e.g. concat(), it
+// returns its result in its own buffer, which the next row overwrites.
+class IntToStringExpr : public Expr {
+ public:
+  IntToStringExpr() : Expr(TYPE_STRING) {}
+
+  virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
+    compute_fn_ = ComputeFn;
+    return Status::OK;
+  }
+
+  static void* ComputeFn(Expr* e, TupleRow* row) {
+    IntToStringExpr* expr = static_cast<IntToStringExpr*>(e);
+    stringstream ss;
+    ss << "key-" << *reinterpret_cast<int32_t*>(row->GetTuple(0));
+    expr->result_.SetStringVal(ss.str());
+    return &expr->result_.string_val;
+  }
+};
+
 class HashTableTest : public testing::Test {
  protected:
   ObjectPool pool_;
@@ -251,8 +272,8 @@ TEST_F(HashTableTest, GrowTableTest) {
   int build_row_val = 0;
   int num_to_add = 5;
   int expected_size = 0;
-  MemLimit mem_limit(1024 * 1024);
-  vector<MemLimit*> mem_limits;
+  MemTracker mem_limit(1024 * 1024);
+  vector<MemTracker*> mem_limits;
   mem_limits.push_back(&mem_limit);
   HashTable hash_table(
       build_expr_, probe_expr_, 1, false, 0, mem_limits, num_to_add);
@@ -282,6 +303,216 @@ TEST_F(HashTableTest, GrowTableTest) {
   }
 }
 
+
+// This test makes sure Clear() releases the memory and the table can be reused
+TEST_F(HashTableTest, ClearTest) {
+  MemTracker mem_limit(1024 * 1024 * 1024);
+  vector<MemTracker*> mem_limits;
+  mem_limits.push_back(&mem_limit);
+  HashTable hash_table(build_expr_, probe_expr_, 1, false, 0, mem_limits, 16);
+  int64_t initial_consumption = mem_limit.consumption();
+  EXPECT_EQ(initial_consumption, hash_table.byte_size());
+
+  for (int i = 0; i < 10000; ++i) {
+    hash_table.Insert(CreateTupleRow(i));
+  }
+  EXPECT_EQ(hash_table.size(), 10000);
+  EXPECT_GT(mem_limit.consumption(), initial_consumption);
+  EXPECT_EQ(mem_limit.consumption(), hash_table.byte_size());
+
+  // The hash used for partitioning must match what Insert() used
+  uint32_t build_hash = 0;
+  uint32_t probe_hash = 0;
+  EXPECT_TRUE(hash_table.HashBuildRow(CreateTupleRow(5), &build_hash));
+  EXPECT_TRUE(hash_table.HashProbeRow(CreateTupleRow(5), &probe_hash));
+  EXPECT_EQ(build_hash, probe_hash);
+
+  hash_table.Clear();
+  EXPECT_EQ(hash_table.size(), 0);
+  EXPECT_EQ(hash_table.num_buckets(), 16);
+  EXPECT_EQ(mem_limit.consumption(), initial_consumption);
+  EXPECT_TRUE(hash_table.Begin() == hash_table.End());
+  EXPECT_TRUE(hash_table.Find(CreateTupleRow(5)) == hash_table.End());
+
+  for (int i = 0; i < 100; ++i) {
+    hash_table.Insert(CreateTupleRow(i));
+  }
+  EXPECT_EQ(hash_table.size(), 100);
+  for (int i = 0; i < 200; ++i) {
+    TupleRow* probe_row = CreateTupleRow(i);
+    HashTable::Iterator iter = hash_table.Find(probe_row);
+    if (i < 100) {
+      EXPECT_TRUE(iter != hash_table.End());
+      ValidateMatch(probe_row, iter.GetRow());
+    } else {
+      EXPECT_TRUE(iter == hash_table.End());
+    }
+  }
+}
+
+// Same as BasicTest but for the open addressing layout.  The table can't be resized
+// to fewer buckets than rows.
+TEST_F(HashTableTest, OpenAddressingBasicTest) {
+  TupleRow* build_rows[5];
+  TupleRow* scan_rows[5] = {0};
+  for (int i = 0; i < 5; ++i) {
+    build_rows[i] = CreateTupleRow(i);
+  }
+
+  ProbeTestData probe_rows[10];
+  for (int i = 0; i < 10; ++i) {
+    probe_rows[i].probe_row = CreateTupleRow(i);
+    if (i < 5) {
+      probe_rows[i].expected_build_rows.push_back(build_rows[i]);
+    } 
+  }
+
+  HashTable hash_table(build_expr_, probe_expr_, 1, false, 0, vector<MemTracker*>(),
+      1024, true);
+  EXPECT_TRUE(hash_table.open_addressing());
+  for (int i = 0; i < 5; ++i) {
+    hash_table.Insert(build_rows[i]);
+  }
+  EXPECT_EQ(hash_table.size(), 5);
+  FullScan(&hash_table, 0, 5, true, scan_rows, build_rows);
+  ProbeTest(&hash_table, probe_rows, 10, false);
+
+  // Shrink the table until all rows collide into a single run of buckets
+  int64_t sizes[] = { 64, 7, 6 };
+  for (int i = 0; i < 3; ++i) {
+    ResizeTable(&hash_table, sizes[i]);
+    EXPECT_EQ(hash_table.num_buckets(), sizes[i]);
+    EXPECT_EQ(hash_table.size(), 5);
+    memset(scan_rows, 0, sizeof(scan_rows));
+    FullScan(&hash_table, 0, 5, true, scan_rows, build_rows);
+    ProbeTest(&hash_table, probe_rows, 10, false);
+  }
+}
+
+// Same as ScanTest but for the open addressing layout, i.e. duplicate keys are in
+// consecutive buckets instead of a chain.
+TEST_F(HashTableTest, OpenAddressingScanTest) {
+  HashTable hash_table(build_expr_, probe_expr_, 1, false, 0, vector<MemTracker*>(),
+      1024, true);
+  ProbeTestData probe_rows[15];
+  probe_rows[0].probe_row = CreateTupleRow(0);
+  for (int val = 1; val <= 10; ++val) {
+    probe_rows[val].probe_row = CreateTupleRow(val);
+    for (int i = 0; i < val; ++i) {
+      TupleRow* row = CreateTupleRow(val);
+      hash_table.Insert(row);
+      probe_rows[val].expected_build_rows.push_back(row);
+    }
+  }
+  for (int val = 11; val < 15; ++val) {
+    probe_rows[val].probe_row = CreateTupleRow(val);
+  }
+  EXPECT_EQ(hash_table.size(), 55);
+  ProbeTest(&hash_table, probe_rows, 15, true);
+
+  int64_t sizes[] = { 128, 60, 56 };
+  for (int i = 0; i < 3; ++i) {
+    ResizeTable(&hash_table, sizes[i]);
+    EXPECT_EQ(hash_table.num_buckets(), sizes[i]);
+    ProbeTest(&hash_table, probe_rows, 15, true);
+  }
+}
+
+// Tests growing an open addressing table, starting with a single bucket.
+TEST_F(HashTableTest, OpenAddressingGrowTableTest) {
+  HashTable hash_table(build_expr_, probe_expr_, 1, false, 0, vector<MemTracker*>(),
+      1, true);
+  for (int i = 0; i < 100000; ++i) {
+    hash_table.Insert(CreateTupleRow(i));
+    // There must always be an empty bucket
+    EXPECT_LT(hash_table.size(), hash_table.num_buckets());
+  }
+  EXPECT_EQ(hash_table.size(), 100000);
+  EXPECT_LE(hash_table.load_factor(), 0.75f);
+  for (int i = 0; i < 200000; i += 1000) {
+    TupleRow* probe_row = CreateTupleRow(i);
+    HashTable::Iterator iter = hash_table.Find(probe_row);
+    if (i < 100000) {
+      EXPECT_TRUE(iter != hash_table.End());
+      ValidateMatch(probe_row, iter.GetRow());
+    } else {
+      EXPECT_TRUE(iter == hash_table.End());
+    }
+  }
+}
+
+// Tests that the batched lookups return the same rows as Find() for both layouts.
+TEST_F(HashTableTest, PrefetchTest) {
+  for (int open_addressing = 0; open_addressing < 2; ++open_addressing) {
+    HashTable hash_table(build_expr_, probe_expr_, 1, false, 0, vector<MemTracker*>(),
+        16, open_addressing);
+    // Keys [0, 500) with key % 3 + 1 rows each
+    for (int i = 0; i < 500; ++i) {
+      for (int j = 0; j <= i % 3; ++j) {
+        hash_table.Insert(CreateTupleRow(i));
+      }
+    }
+
+    // Probe with two batches to test that the prefetched hashes are overwritten
+    for (int batch = 0; batch < 2; ++batch) {
+      vector<TupleRow*> probe_rows;
+      for (int i = 0; i < 256; ++i) {
+        probe_rows.push_back(CreateTupleRow(batch * 400 + i));
+      }
+      for (int i = 0; i < probe_rows.size(); ++i) {
+        hash_table.PrefetchProbeRow(i, probe_rows[i]);
+      }
+      for (int i = 0; i < probe_rows.size(); ++i) {
+        int key = batch * 400 + i;
+        int num_matches = 0;
+        HashTable::Iterator iter = hash_table.FindPrefetched(i);
+        while (iter != hash_table.End()) {
+          ValidateMatch(probe_rows[i], iter.GetRow());
+          ++num_matches;
+          iter.Next<true>();
+        }
+        EXPECT_EQ(num_matches, key < 500 ? key % 3 + 1 : 0) << key;
+        // Lookups of other rows in between (e.g. the inserts of the aggregation
+        // node) don't affect the prefetched rows
+        EXPECT_TRUE(hash_table.Find(CreateTupleRow(1000 + i)) == hash_table.End());
+      }
+    }
+  }
+}
+
+// Tests the batched lookups with a computed string key, whose values are overwritten
+// by the next row that is evaluated.
+TEST_F(HashTableTest, PrefetchComputedStringTest) {
+  RowDescriptor desc;
+  vector<Expr*> build_exprs;
+  build_exprs.push_back(pool_.Add(new IntToStringExpr()));
+  EXPECT_TRUE(Expr::Prepare(build_exprs, NULL, desc).ok());
+  vector<Expr*> probe_exprs;
+  probe_exprs.push_back(pool_.Add(new IntToStringExpr()));
+  EXPECT_TRUE(Expr::Prepare(probe_exprs, NULL, desc).ok());
+
+  HashTable hash_table(build_exprs, probe_exprs, 1, false, 0);
+  for (int i = 0; i < 100; ++i) {
+    hash_table.Insert(CreateTupleRow(i));
+  }
+  vector<TupleRow*> probe_rows;
+  for (int i = 0; i < 200; ++i) {
+    probe_rows.push_back(CreateTupleRow(i));
+  }
+  for (int i = 0; i < probe_rows.size(); ++i) {
+    hash_table.PrefetchProbeRow(i, probe_rows[i]);
+  }
+  for (int i = 0; i < probe_rows.size(); ++i) {
+    HashTable::Iterator iter = hash_table.FindPrefetched(i);
+    if (i < 100) {
+      ASSERT_TRUE(iter != hash_table.End()) << i;
+      EXPECT_EQ(*reinterpret_cast<int32_t*>(iter.GetRow()->GetTuple(0)), i);
+      iter.Next<true>();
+    }
+    EXPECT_TRUE(iter == hash_table.End()) << i;
+  }
+}
+
 }
 
 int main(int argc, char** argv) {
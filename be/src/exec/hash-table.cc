@@ -17,7 +17,7 @@
 #include "exprs/expr.h"
 #include "runtime/raw-value.h"
 #include "runtime/string-value.inline.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "util/debug-util.h"
 #include "util/impalad-metrics.h"
 
@@ -31,8 +31,9 @@ const float HashTable::MAX_BUCKET_OCCUPANCY_FRACTION = 0.75f;
 
 HashTable::HashTable(const vector<Expr*>& build_exprs, const vector<Expr*>& probe_exprs,
     int num_build_tuples, bool stores_nulls, int32_t initial_seed,
-    const vector<MemLimit*>& mem_limits, int64_t num_buckets)
-  : build_exprs_(build_exprs),
+    const vector<MemTracker*>& mem_limits, int64_t num_buckets, bool open_addressing)
+  : open_addressing_(open_addressing),
+    build_exprs_(build_exprs),
     probe_exprs_(probe_exprs),
     num_build_tuples_(num_build_tuples),
     stores_nulls_(stores_nulls),
@@ -42,11 +43,12 @@ HashTable::HashTable(const vector<Expr*>& build_exprs, const vector<Expr*>& prob
     nodes_(NULL),
     num_nodes_(0),
     mem_limits_(mem_limits),
-    exceeded_limit_(false) {
+    exceeded_limit_(false),
+    initial_num_buckets_(num_buckets) {
   DCHECK_EQ(build_exprs_.size(), probe_exprs_.size());
   buckets_.resize(num_buckets);
   num_buckets_ = num_buckets;
-  num_buckets_till_resize_ = MAX_BUCKET_OCCUPANCY_FRACTION * num_buckets_;
+  num_buckets_till_resize_ = ResizeThreshold(num_buckets_);
 
   // Compute the layout and buffer size to store the evaluated expr results
   results_buffer_size_ = Expr::ComputeResultsLayout(build_exprs_, 
@@ -54,17 +56,23 @@ HashTable::HashTable(const vector<Expr*>& build_exprs, const vector<Expr*>& prob
   expr_values_buffer_= new uint8_t[results_buffer_size_];
   memset(expr_values_buffer_, 0, sizeof(uint8_t) * results_buffer_size_);
   expr_value_null_bits_ = new uint8_t[build_exprs_.size()];
+  prefetched_values_size_ = results_buffer_size_ + build_exprs_.size();
+  for (int i = 0; i < probe_exprs_.size(); ++i) {
+    if (probe_exprs_[i]->type() == TYPE_STRING && !probe_exprs_[i]->is_slotref()) {
+      computed_string_exprs_.push_back(i);
+    }
+  }
 
-  nodes_capacity_ = 1024;
+  nodes_capacity_ = INITIAL_NODES_CAPACITY;
   nodes_ = reinterpret_cast<uint8_t*>(malloc(nodes_capacity_ * node_byte_size_));
   if (ImpaladMetrics::HASH_TABLE_TOTAL_BYTES != NULL) {
     ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(nodes_capacity_ * node_byte_size_);
   }
 
   // update mem_limits_
-  MemLimit::UpdateLimits(num_buckets * sizeof(Bucket), &mem_limits_);
-  MemLimit::UpdateLimits(nodes_capacity_ * node_byte_size_, &mem_limits_);
-  exceeded_limit_ = MemLimit::LimitExceeded(mem_limits_);
+  MemTracker::UpdateLimits(num_buckets * sizeof(Bucket), &mem_limits_);
+  MemTracker::UpdateLimits(nodes_capacity_ * node_byte_size_, &mem_limits_);
+  exceeded_limit_ = MemTracker::LimitExceeded(mem_limits_);
 }
 
 HashTable::~HashTable() {
@@ -75,8 +83,71 @@ HashTable::~HashTable() {
   if (ImpaladMetrics::HASH_TABLE_TOTAL_BYTES != NULL) {
     ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(-nodes_capacity_ * node_byte_size_);
   }
-  MemLimit::UpdateLimits(-1 * nodes_capacity_ * node_byte_size_, &mem_limits_);
-  MemLimit::UpdateLimits(-1 * buckets_.size() * sizeof(Bucket), &mem_limits_);
+  MemTracker::UpdateLimits(-1 * nodes_capacity_ * node_byte_size_, &mem_limits_);
+  MemTracker::UpdateLimits(-1 * buckets_.size() * sizeof(Bucket), &mem_limits_);
+}
+
+void HashTable::Clear() {
+  int64_t old_nodes_size = nodes_capacity_ * node_byte_size_;
+  int64_t old_buckets_size = buckets_.size() * sizeof(Bucket);
+  if (nodes_capacity_ != INITIAL_NODES_CAPACITY) {
+    nodes_capacity_ = INITIAL_NODES_CAPACITY;
+    nodes_ = reinterpret_cast<uint8_t*>(
+        realloc(nodes_, nodes_capacity_ * node_byte_size_));
+  }
+  num_nodes_ = 0;
+  num_filled_buckets_ = 0;
+
+  // Swap with a new vector to actually release the memory
+  vector<Bucket> new_buckets(initial_num_buckets_);
+  buckets_.swap(new_buckets);
+  num_buckets_ = buckets_.size();
+  num_buckets_till_resize_ = ResizeThreshold(num_buckets_);
+
+  int64_t delta_nodes = nodes_capacity_ * node_byte_size_ - old_nodes_size;
+  int64_t delta_buckets =
+      static_cast<int64_t>(buckets_.size() * sizeof(Bucket)) - old_buckets_size;
+  if (ImpaladMetrics::HASH_TABLE_TOTAL_BYTES != NULL) {
+    ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(delta_nodes);
+  }
+  MemTracker::UpdateLimits(delta_nodes + delta_buckets, &mem_limits_);
+  exceeded_limit_ = MemTracker::LimitExceeded(mem_limits_);
+}
+
+bool HashTable::HashBuildRow(TupleRow* row, uint32_t* hash) {
+  bool has_null = EvalBuildRow(row);
+  if (!stores_nulls_ && has_null) return false;
+  *hash = HashCurrentRow();
+  return true;
+}
+
+bool HashTable::HashProbeRow(TupleRow* row, uint32_t* hash) {
+  bool has_null = EvalProbeRow(row);
+  if (!stores_nulls_ && has_null) return false;
+  *hash = HashCurrentRow();
+  return true;
+}
+
+void HashTable::SavePrefetchedStrings(int idx) {
+  string* copies = &prefetched_strings_[idx * computed_string_exprs_.size()];
+  for (int i = 0; i < computed_string_exprs_.size(); ++i) {
+    int expr_idx = computed_string_exprs_[i];
+    if (expr_value_null_bits_[expr_idx]) continue;
+    StringValue* value = reinterpret_cast<StringValue*>(
+        expr_values_buffer_ + expr_values_buffer_offsets_[expr_idx]);
+    copies[i].assign(value->ptr, value->len);
+  }
+}
+
+void HashTable::RestorePrefetchedStrings(int idx) {
+  string* copies = &prefetched_strings_[idx * computed_string_exprs_.size()];
+  for (int i = 0; i < computed_string_exprs_.size(); ++i) {
+    int expr_idx = computed_string_exprs_[i];
+    if (expr_value_null_bits_[expr_idx]) continue;
+    StringValue* value = reinterpret_cast<StringValue*>(
+        expr_values_buffer_ + expr_values_buffer_offsets_[expr_idx]);
+    value->ptr = const_cast<char*>(copies[i].data());
+  }
 }
 
 bool HashTable::EvalRow(TupleRow* row, const vector<Expr*>& exprs) {
@@ -592,7 +663,15 @@ void HashTable::ResizeBuckets(int64_t num_buckets) {
   new_buckets.resize(num_buckets);
   num_filled_buckets_ = 0;
 
-  Iterator iter = Begin();
+  if (open_addressing_) {
+    DCHECK_GT(num_buckets, num_nodes_);
+    for (int64_t node_idx = 0; node_idx < num_nodes_; ++node_idx) {
+      AddToOpenBucket(&new_buckets, node_idx, GetNode(node_idx)->hash_);
+    }
+    num_filled_buckets_ = num_nodes_;
+  }
+
+  Iterator iter = open_addressing_ ? End() : Begin();
   while (iter.HasNext()) {
     int64_t node_idx = iter.node_idx_;
     // Advance to next node before modifying the node's next link
@@ -607,12 +686,12 @@ void HashTable::ResizeBuckets(int64_t num_buckets) {
   }
 
   int64_t delta_bytes = (new_buckets.size() - buckets_.size()) * sizeof(Bucket);
-  MemLimit::UpdateLimits(delta_bytes, &mem_limits_);
-  exceeded_limit_ = MemLimit::LimitExceeded(mem_limits_);
+  MemTracker::UpdateLimits(delta_bytes, &mem_limits_);
+  exceeded_limit_ = MemTracker::LimitExceeded(mem_limits_);
 
   buckets_.swap(new_buckets);
   num_buckets_ = buckets_.size();
-  num_buckets_till_resize_ = MAX_BUCKET_OCCUPANCY_FRACTION * num_buckets_;
+  num_buckets_till_resize_ = ResizeThreshold(num_buckets_);
 }
   
 void HashTable::GrowNodeArray() {
@@ -623,8 +702,8 @@ void HashTable::GrowNodeArray() {
   if (ImpaladMetrics::HASH_TABLE_TOTAL_BYTES != NULL) {
     ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(new_size - old_size);
   }
-  MemLimit::UpdateLimits(new_size - old_size, &mem_limits_);
-  exceeded_limit_ = MemLimit::LimitExceeded(mem_limits_);
+  MemTracker::UpdateLimits(new_size - old_size, &mem_limits_);
+  exceeded_limit_ = MemTracker::LimitExceeded(mem_limits_);
 }
 
 string HashTable::DebugString(bool skip_empty, const RowDescriptor* desc) {
@@ -634,6 +713,7 @@ string HashTable::DebugString(bool skip_empty, const RowDescriptor* desc) {
     int64_t node_idx = buckets_[i].node_idx_;
     bool first = true;
     if (skip_empty && node_idx == -1) continue;
+    if (node_idx != -1) node_idx = NodeIdx(node_idx);
     ss << i << ": ";
     while (node_idx != -1) {
       Node* node = GetNode(node_idx);
@@ -16,6 +16,8 @@
 #ifndef IMPALA_EXEC_HASH_TABLE_H
 #define IMPALA_EXEC_HASH_TABLE_H
 
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <boost/cstdint.hpp>
 #include "codegen/impala-ir.h"
@@ -33,7 +35,7 @@ class LlvmCodeGen;
 class RowDescriptor;
 class Tuple;
 class TupleRow;
-class MemLimit;
+class MemTracker;
 
 // Hash table implementation designed for hash aggregation and hash joins.  This is not
 // templatized and is tailored to the usage pattern for aggregation and joins.  The
@@ -59,6 +61,19 @@ class MemLimit;
 // For growing the hash table, new buckets are allocated but the node vector is modified
 // in place.
 //
+// Alternatively, the buckets can use open addressing with linear probing (see the
+// open_addressing c'tor argument).  Every node then occupies its own bucket and the
+// bucket stores the node index together with a tag made of the high bits of the node's
+// hash.  A lookup scans consecutive buckets (i.e. mostly a single cache line) and only
+// touches the nodes whose tag matches, instead of following the chain of nodes, which
+// is a dependent cache miss per node.  The chained layout is better for build sides
+// with many duplicate keys, since the duplicates form long runs of buckets that every
+// probe for a key in that region has to scan.
+//
+// The batched lookup API (PrefetchProbeRow()/FindPrefetched()) hashes the probe rows
+// of a whole batch and prefetches their buckets before any of them is compared, so
+// the cache misses of the batch overlap instead of being serialized.
+//
 // TODO: this is not a fancy hash table in terms of memory access patterns (cuckoo-hashing
 // or something that spills to disk). We will likely want to invest more time into this.
 // TODO: hash-join and aggregation have very different access patterns.  Joins insert
@@ -78,13 +93,19 @@ class HashTable {
   //  - mem_limits: if non-empty, all memory allocation for nodes and for buckets is
   //    tracked against those limits; the limits must be valid until the d'tor is called
   //  - initial_seed: Initial seed value to use when computing hashes for rows
+  //  - open_addressing: if true, buckets use open addressing instead of chaining
   HashTable(const std::vector<Expr*>& build_exprs, const std::vector<Expr*>& probe_exprs,
       int num_build_tuples, bool stores_nulls, int32_t initial_seed,
-      const std::vector<MemLimit*>& mem_limits = std::vector<MemLimit*>(),
-      int64_t num_buckets = 1024);
+      const std::vector<MemTracker*>& mem_limits = std::vector<MemTracker*>(),
+      int64_t num_buckets = 1024, bool open_addressing = false);
 
   ~HashTable();
 
+  // Removes all rows from the hash table and shrinks it back to its initial size,
+  // returning the memory to the mem limits.  The expr buffers are kept so functions
+  // codegen'd for this hash table remain valid.
+  void Clear();
+
   // Insert row into the hash table.  Row will be evaluated over build_exprs_
   // This will grow the hash table if necessary
   void IR_ALWAYS_INLINE Insert(TupleRow* row) {
@@ -105,6 +126,32 @@ class HashTable {
   // rows are evaluated lazily (i.e. computed as the Iterator is moved).   
   // Returns HashTable::End() if there is no match.
   Iterator Find(TupleRow* probe_row);
+
+  // Same as Find() but 'build_row' is evaluated with build_exprs_, i.e. this looks up
+  // a row with the same layout as the rows that are inserted.
+  Iterator FindBuildRow(TupleRow* build_row);
+
+  // Batched version of Find().  Callers first call PrefetchProbeRow() for all rows
+  // of a batch, passing the row's index in the batch as 'idx'.  This evaluates and
+  // hashes the row, saves its expr values and issues a prefetch for its bucket.
+  // FindPrefetched(idx) then returns the same result as Find() for the row, using
+  // the hash and expr values computed earlier.  The prefetched rows are overwritten
+  // by the next batch, i.e. by calls to PrefetchProbeRow() with the same 'idx'.  The
+  // probe rows must not be modified in between.  Computed string values point into
+  // the exprs' result buffers, which the next row overwrites, so they are copied.
+  void PrefetchProbeRow(int idx, TupleRow* probe_row);
+  Iterator FindPrefetched(int idx);
+
+  // Evaluates 'row' over the build (resp. probe) exprs and returns the hash that
+  // Insert() (resp. Find()) would use for it in *hash.  Returns false if the row
+  // would be ignored because it has a NULL key and the table does not store nulls.
+  // Used by callers that partition rows by hash value before inserting them.
+  bool HashBuildRow(TupleRow* row, uint32_t* hash);
+  bool HashProbeRow(TupleRow* row, uint32_t* hash);
+
+  // Evaluates 'row' over the probe exprs without hashing or looking it up, so that
+  // last_expr_value() returns its values.  Returns true if any of them is NULL.
+  bool EvalAndCacheProbeRow(TupleRow* row) { return EvalProbeRow(row); }
   
   // Returns number of elements in the hash table
   int64_t size() { return num_nodes_; }
@@ -112,7 +159,10 @@ class HashTable {
   // Returns the number of buckets
   int64_t num_buckets() { return buckets_.size(); }
 
-  // true if any of the MemLimits was exceeded
+  // Returns true if the buckets use open addressing
+  bool open_addressing() const { return open_addressing_; }
+
+  // true if any of the MemTrackers' limits was exceeded
   bool exceeded_limit() const { return exceeded_limit_; }
 
   // Returns the load factor (the number of non-empty buckets)
@@ -125,6 +175,12 @@ class HashTable {
     return node_byte_size_ * nodes_capacity_ + sizeof(Bucket) * buckets_.size();
   }
 
+  // Returns an estimate of the number of bytes needed to store 'num_rows' rows,
+  // excluding the tuple data the rows point to.
+  int64_t EstimatedByteSize(int64_t num_rows) const {
+    return num_rows * (node_byte_size_ + sizeof(Bucket) / MAX_BUCKET_OCCUPANCY_FRACTION);
+  }
+
   // Returns the results of the exprs at 'expr_idx' evaluated over the last row
   // processed by the HashTable.
   // This value is invalid if the expr evaluated to NULL.
@@ -225,7 +281,7 @@ class HashTable {
   // Header portion of a Node.  The node data (TupleRow) is right after the 
   // node memory to maximize cache hits.
   struct Node {
-    int64_t next_idx_;  // chain to next node for collisions
+    int64_t next_idx_;  // chain to next node for collisions, -1 for open addressing
     uint32_t hash_;     // Cache of the hash for data_
 
     TupleRow* data() {
@@ -235,6 +291,8 @@ class HashTable {
     }
   };
 
+  // For the open addressing layout, the high bits of node_idx_ contain the hash tag
+  // of the node (see HashTag()).  Use NodeIdx() to get the index of the node.
   struct Bucket {
     int64_t node_idx_;
 
@@ -243,6 +301,56 @@ class HashTable {
     }
   };
 
+  // Number of bits of Bucket::node_idx_ used for the node index with open addressing.
+  // The remaining bits (except for the sign bit, so an occupied bucket is never -1)
+  // store the hash tag.
+  static const int NODE_IDX_BITS = 40;
+  static const int NUM_TAG_BITS = 63 - NODE_IDX_BITS;
+  static const int64_t NODE_IDX_MASK = (1LL << NODE_IDX_BITS) - 1;
+
+  // Returns the node index stored in a (non-empty) bucket.  For the chained layout,
+  // the tag bits are always 0.
+  static int64_t NodeIdx(int64_t bucket_node_idx) {
+    return bucket_node_idx & NODE_IDX_MASK;
+  }
+
+  // Returns the tag of 'hash', shifted to its position in Bucket::node_idx_.  The tag
+  // uses the high bits of the hash since the low bits determine the bucket.
+  static int64_t HashTag(uint32_t hash) {
+    return static_cast<int64_t>(hash >> (32 - NUM_TAG_BITS)) << NODE_IDX_BITS;
+  }
+
+  // Looks up 'hash', comparing nodes with Equals().  The row to look up must have been
+  // evaluated into 'expr_values_buffer_'.
+  Iterator FindHash(uint32_t hash);
+
+  // Copies the computed string values in 'expr_values_buffer_' to the
+  // prefetched_strings_ of prefetched row 'idx'.
+  void SavePrefetchedStrings(int idx);
+
+  // Points the computed string values in 'expr_values_buffer_', which were restored
+  // for prefetched row 'idx', to its copies in prefetched_strings_.  The copies may
+  // have moved since they were made, when prefetched_strings_ grew.
+  void RestorePrefetchedStrings(int idx);
+
+  // Returns the first node that may match 'hash' in the bucket *bucket_idx and,
+  // for open addressing, the buckets after it.  Returns -1 if there is none.
+  // *bucket_idx is set to the bucket of the returned node.
+  int64_t FirstCandidate(int64_t* bucket_idx, uint32_t hash);
+
+  // Returns the node after 'node' (in bucket *bucket_idx) that may match 'hash', or
+  // -1 if there is none.  *bucket_idx is set to the bucket of the returned node.
+  int64_t NextCandidate(int64_t* bucket_idx, Node* node, uint32_t hash);
+
+  // Open addressing only: returns the node of the first bucket starting at
+  // *bucket_idx that has the tag of 'hash', or -1 if an empty bucket comes first.
+  int64_t ProbeBuckets(int64_t* bucket_idx, uint32_t hash);
+
+  // Open addressing only: stores the node in the first empty bucket of 'buckets',
+  // starting at the bucket for 'hash'.
+  static void AddToOpenBucket(std::vector<Bucket>* buckets, int64_t node_idx,
+      uint32_t hash);
+
   // Returns the next non-empty bucket and updates idx to be the index of that bucket.
   // If there are no more buckets, returns NULL and sets idx to -1
   Bucket* NextBucket(int64_t* bucket_idx);
@@ -257,6 +365,15 @@ class HashTable {
   // Resize the hash table to 'num_buckets'
   void ResizeBuckets(int64_t num_buckets);
 
+  // Returns the number of filled buckets that triggers growing a table with
+  // 'num_buckets' buckets.
+  int64_t ResizeThreshold(int64_t num_buckets) const {
+    int64_t threshold = MAX_BUCKET_OCCUPANCY_FRACTION * num_buckets;
+    // With open addressing, probes only terminate at an empty bucket.
+    if (open_addressing_) threshold = std::min(threshold, num_buckets - 2);
+    return threshold;
+  }
+
   // Insert row into the hash table
   void IR_ALWAYS_INLINE InsertImpl(TupleRow* row);
 
@@ -313,6 +430,12 @@ class HashTable {
   // defined as the number of non-empty buckets / total_buckets
   static const float MAX_BUCKET_OCCUPANCY_FRACTION;
 
+  // Initial capacity of the node array
+  static const int64_t INITIAL_NODES_CAPACITY = 1024;
+
+  // If true, the buckets use open addressing, otherwise nodes are chained.
+  const bool open_addressing_;
+
   const std::vector<Expr*>& build_exprs_;
   const std::vector<Expr*>& probe_exprs_;
 
@@ -337,10 +460,13 @@ class HashTable {
   // max number of nodes that can be stored in 'nodes_' before realloc
   int64_t nodes_capacity_;
 
-  std::vector<MemLimit*> mem_limits_;  // saved c'tor param
+  std::vector<MemTracker*> mem_limits_;  // saved c'tor param
   bool exceeded_limit_;   // true if any of mem_limits_[].LimitExceeded()
 
   std::vector<Bucket> buckets_;
+
+  // number of buckets the hash table was created with, restored by Clear()
+  const int64_t initial_num_buckets_;
   
   // equal to buckets_.size() but more efficient than the size function
   int64_t num_buckets_;
@@ -365,6 +491,23 @@ class HashTable {
   // Use bytes instead of bools to be compatible with llvm.  This address must
   // not change once allocated.
   uint8_t* expr_value_null_bits_;
+
+  // Hashes computed by PrefetchProbeRow(), indexed by row.  -1 if the row has a NULL
+  // key and the table does not store NULLs.
+  std::vector<int64_t> prefetched_hashes_;
+
+  // Expr values and null bits saved by PrefetchProbeRow(), prefetched_values_size_
+  // bytes per row (the size of 'expr_values_buffer_' plus one byte per expr).
+  int prefetched_values_size_;
+  std::vector<uint8_t> prefetched_values_;
+
+  // Indexes of the probe exprs with computed (i.e. not slot ref) string values, which
+  // are copied by PrefetchProbeRow()
+  std::vector<int> computed_string_exprs_;
+
+  // Copies of the computed string values of the prefetched rows,
+  // computed_string_exprs_.size() per row
+  std::vector<std::string> prefetched_strings_;
 };
 
 }
@@ -18,32 +18,106 @@
 
 #include "exec/hash-table.h"
 
+#include "common/compiler-util.h"
+
 namespace impala {
 
 inline HashTable::Iterator HashTable::Find(TupleRow* probe_row) {
   bool has_nulls = EvalProbeRow(probe_row);
   if (!stores_nulls_ && has_nulls) return End();
+  return FindHash(HashCurrentRow());
+}
+
+inline HashTable::Iterator HashTable::FindBuildRow(TupleRow* build_row) {
+  bool has_nulls = EvalBuildRow(build_row);
+  if (!stores_nulls_ && has_nulls) return End();
+  return FindHash(HashCurrentRow());
+}
+
+inline void HashTable::PrefetchProbeRow(int idx, TupleRow* probe_row) {
+  if (UNLIKELY(idx >= static_cast<int>(prefetched_hashes_.size()))) {
+    prefetched_hashes_.resize(idx + 1);
+    prefetched_values_.resize((idx + 1) * prefetched_values_size_);
+    prefetched_strings_.resize((idx + 1) * computed_string_exprs_.size());
+  }
+  bool has_nulls = EvalProbeRow(probe_row);
+  if (!stores_nulls_ && has_nulls) {
+    prefetched_hashes_[idx] = -1;
+    return;
+  }
   uint32_t hash = HashCurrentRow();
-  int64_t bucket_idx = hash % num_buckets_;
+  prefetched_hashes_[idx] = hash;
+  uint8_t* values = &prefetched_values_[idx * prefetched_values_size_];
+  memcpy(values, expr_values_buffer_, results_buffer_size_);
+  memcpy(values + results_buffer_size_, expr_value_null_bits_, probe_exprs_.size());
+  if (!computed_string_exprs_.empty()) SavePrefetchedStrings(idx);
+  PREFETCH(&buckets_[hash % num_buckets_]);
+}
 
-  Bucket* bucket = &buckets_[bucket_idx];
-  int64_t node_idx = bucket->node_idx_;
+inline HashTable::Iterator HashTable::FindPrefetched(int idx) {
+  DCHECK_LT(idx, prefetched_hashes_.size());
+  int64_t hash = prefetched_hashes_[idx];
+  if (hash == -1) return End();
+  // Equals() compares against the expr values of the current row, which are restored
+  // from the ones saved by PrefetchProbeRow() instead of evaluating the row again.
+  const uint8_t* values = &prefetched_values_[idx * prefetched_values_size_];
+  memcpy(expr_values_buffer_, values, results_buffer_size_);
+  memcpy(expr_value_null_bits_, values + results_buffer_size_, probe_exprs_.size());
+  if (!computed_string_exprs_.empty()) RestorePrefetchedStrings(idx);
+  return FindHash(hash);
+}
+
+inline HashTable::Iterator HashTable::FindHash(uint32_t hash) {
+  int64_t bucket_idx = hash % num_buckets_;
+  int64_t node_idx = FirstCandidate(&bucket_idx, hash);
   while (node_idx != -1) {
     Node* node = GetNode(node_idx);
     if (node->hash_ == hash && Equals(node->data())) {
       return Iterator(this, bucket_idx, node_idx, hash);
     }
-    node_idx = node->next_idx_;
+    node_idx = NextCandidate(&bucket_idx, node, hash);
   }
-
   return End();
 }
+
+inline int64_t HashTable::FirstCandidate(int64_t* bucket_idx, uint32_t hash) {
+  if (open_addressing_) return ProbeBuckets(bucket_idx, hash);
+  return buckets_[*bucket_idx].node_idx_;
+}
+
+inline int64_t HashTable::NextCandidate(int64_t* bucket_idx, Node* node,
+    uint32_t hash) {
+  if (!open_addressing_) return node->next_idx_;
+  if (++*bucket_idx == num_buckets_) *bucket_idx = 0;
+  return ProbeBuckets(bucket_idx, hash);
+}
+
+inline int64_t HashTable::ProbeBuckets(int64_t* bucket_idx, uint32_t hash) {
+  int64_t tag = HashTag(hash);
+  // There is always an empty bucket since the table is resized before it is full.
+  while (true) {
+    int64_t bucket_node_idx = buckets_[*bucket_idx].node_idx_;
+    if (bucket_node_idx == -1) return -1;
+    if ((bucket_node_idx & ~NODE_IDX_MASK) == tag) return NodeIdx(bucket_node_idx);
+    if (++*bucket_idx == num_buckets_) *bucket_idx = 0;
+  }
+}
+
+inline void HashTable::AddToOpenBucket(std::vector<Bucket>* buckets, int64_t node_idx,
+    uint32_t hash) {
+  int64_t num_buckets = buckets->size();
+  int64_t bucket_idx = hash % num_buckets;
+  while ((*buckets)[bucket_idx].node_idx_ != -1) {
+    if (++bucket_idx == num_buckets) bucket_idx = 0;
+  }
+  (*buckets)[bucket_idx].node_idx_ = HashTag(hash) | node_idx;
+}
   
 inline HashTable::Iterator HashTable::Begin() {
   int64_t bucket_idx = -1;
   Bucket* bucket = NextBucket(&bucket_idx);
   if (bucket != NULL) {
-    return Iterator(this, bucket_idx, bucket->node_idx_, 0);
+    return Iterator(this, bucket_idx, NodeIdx(bucket->node_idx_), 0);
   }
   return End();
 }
@@ -68,7 +142,13 @@ inline void HashTable::InsertImpl(TupleRow* row) {
   TupleRow* data = node->data();
   node->hash_ = hash;
   memcpy(data, row, sizeof(Tuple*) * num_build_tuples_);
-  AddToBucket(&buckets_[bucket_idx], num_nodes_, node);
+  if (open_addressing_) {
+    node->next_idx_ = -1;
+    AddToOpenBucket(&buckets_, num_nodes_, hash);
+    ++num_filled_buckets_;
+  } else {
+    AddToBucket(&buckets_[bucket_idx], num_nodes_, node);
+  }
   ++num_nodes_;
 }
 
@@ -85,18 +165,19 @@ inline void HashTable::Iterator::Next() {
   // TODO: this should prefetch the next tuplerow
   Node* node = table_->GetNode(node_idx_);
   // Iterator is not from a full table scan, evaluate equality now.  Only the current
-  // bucket needs to be scanned. 'expr_values_buffer_' contains the results
-  // for the current probe row.
+  // bucket (or run of buckets for open addressing) needs to be scanned.
+  // 'expr_values_buffer_' contains the results for the current probe row.
   if (check_match) {
-    // TODO: this should prefetch the next node
-    int64_t next_idx = node->next_idx_;
+    int64_t bucket_idx = bucket_idx_;
+    int64_t next_idx = table_->NextCandidate(&bucket_idx, node, scan_hash_);
     while (next_idx != -1) {
       node = table_->GetNode(next_idx);
       if (node->hash_ == scan_hash_ && table_->Equals(node->data())) {
+        bucket_idx_ = bucket_idx;
         node_idx_ = next_idx;
         return;
       } 
-      next_idx = node->next_idx_;
+      next_idx = table_->NextCandidate(&bucket_idx, node, scan_hash_);
     }
     *this = table_->End();
   } else {
@@ -112,7 +193,7 @@ inline void HashTable::Iterator::Next() {
       bucket_idx_ = -1;
       node_idx_ = -1;
     } else {
-      node_idx_ = bucket->node_idx_;
+      node_idx_ = NodeIdx(bucket->node_idx_);
     }
   }
 }
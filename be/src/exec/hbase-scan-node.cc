@@ -56,7 +56,7 @@ Status HBaseScanNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ScanNode::Prepare(state));
 
   hbase_scanner_.reset(new HBaseTableScanner(this, state->htable_factory(), state));
-  tuple_pool_->set_limits(*state->mem_limits());
+  tuple_pool_->set_limits(mem_trackers_);
 
   tuple_desc_ = state->desc_tbl().GetTupleDescriptor(tuple_id_);
   if (tuple_desc_ == NULL) {
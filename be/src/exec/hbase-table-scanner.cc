@@ -99,8 +99,8 @@ HBaseTableScanner::HBaseTableScanner(
     rows_cached_(DEFAULT_ROWS_CACHED),
     scan_setup_timer_(ADD_TIMER(scan_node_->runtime_profile(),
       "HBaseTableScanner.ScanSetup")) {
-  value_pool_->set_limits(*state->mem_limits());
-  buffer_pool_->set_limits(*state->mem_limits());
+  value_pool_->set_limits(*state->mem_trackers());
+  buffer_pool_->set_limits(*state->mem_trackers());
 }
 
 Status HBaseTableScanner::Init() {
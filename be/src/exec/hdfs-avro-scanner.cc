@@ -340,7 +340,8 @@ Status HdfsAvroScanner::ProcessRange() {
 Status HdfsAvroScanner::DecodeAvroData(int max_tuples, int64_t* num_records,
                                        MemPool* pool, uint8_t** data, int* data_len,
                                        Tuple* tuple, TupleRow* tuple_row) {
-  int num_to_commit = 0;
+  Tuple* first_tuple = tuple;
+  TupleRow* first_row = tuple_row;
   uint64_t n = min(*num_records, static_cast<int64_t>(max_tuples));
   for (int i = 0; i < n; ++i) {
     // Initialize tuple from the partition key template tuple before writing the
@@ -365,15 +366,11 @@ Status HdfsAvroScanner::DecodeAvroData(int max_tuples, int64_t* num_records,
     }
 
     tuple_row->SetTuple(scan_node_->tuple_idx(), tuple);
-
-    // Evaluate the conjuncts and add the row to the batch
-    if (ExecNode::EvalConjuncts(conjuncts_, num_conjuncts_, tuple_row)) {
-      ++num_to_commit;
-      tuple_row = context_->next_row(tuple_row);
-      tuple = context_->next_tuple(tuple);
-    }
+    tuple_row = context_->next_row(tuple_row);
+    tuple = context_->next_tuple(tuple);
   }
-  context_->CommitRows(num_to_commit);
+  // Evaluate the conjuncts and add the rows that passed to the batch
+  context_->CommitRows(EvalConjunctsBatch(first_tuple, first_row, n));
   (*num_records) -= n;
   COUNTER_UPDATE(scan_node_->rows_read_counter(), n);
 
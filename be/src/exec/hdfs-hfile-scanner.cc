@@ -9,6 +9,7 @@
 #include "exec/hdfs-scan-node.h"
 #include "exec/read-write-util.h"
 #include "exprs/expr.h"
+#include "exprs/in-predicate.h"
 #include "runtime/descriptors.h"
 #include "runtime/runtime-state.h"
 #include "runtime/mem-pool.h"
@@ -24,14 +25,25 @@
 #include "algorithm"
 #include "exec/hdfs-scan-node.h"
 #include "exec/hdfs-scanner.h"
+#include <set>
 #include <snappy.h>
+#include <sstream>
 #include "util/codec.h"
+#include "runtime/exec-env.h"
+#include "runtime/hfile-block-cache.h"
 #include <boost/scoped_ptr.hpp>
+#include <gflags/gflags.h>
 
 using namespace std;
 using namespace impala;
 using namespace hfile;
 
+DEFINE_bool(hfile_verify_checksums, true, "If true, the checksums of hfile blocks are "
+            "verified when the blocks are read.");
+DEFINE_int32(hfile_max_bloom_filter_rows, 1024, "Maximum number of rows allowed by the "
+             "predicates on the row key columns of an hfile that are looked up in its "
+             "bloom filter.");
+
 
 namespace
 {
@@ -457,7 +469,7 @@ class HdfsHFileScanner:: KeyValue
 {
 
 public:
-    KeyValue():key_deserializer_(),value_deserializer_()
+    KeyValue():key_deserializer_(),value_deserializer_(),timestamp_(0)
     {
     }
     void Set_Key_State(std::vector<PrimitiveType>& types,std::vector<SlotDescriptor*> & slot_desc,bool compact_data)
@@ -483,6 +495,11 @@ public:
         result &= value_deserializer_.Write_Tuple(pool,tuple,value_start_ptr,value_len);
         return result;
     }
+    //timestamp of the last KeyValue parsed
+    int64_t Get_Timestamp() const
+    {
+        return timestamp_;
+    }
     int Get_Key_Col_Num(uint8_t* data,PrimitiveType* types)
     {
         uint8_t* key_start_ptr;
@@ -508,17 +525,22 @@ private:
         //skip memstore timestamp
         int8_t vlong_len = **byte_buffer_ptr;
         *byte_buffer_ptr+=ReadWriteUtil::DecodeVIntSize(vlong_len);
+        //the key ends with the timestamp and the type byte
+        timestamp_ = ReadWriteUtil::GetLongInt(*key_start_ptr + *key_len - 9);
         //adjust key_start_ptr_ to point to row key start position.
         *key_len =   ReadWriteUtil::GetSmallInt(*key_start_ptr);
         *key_start_ptr+=2;
     }
     BinarySortableDeserializer key_deserializer_;
     LazyBinaryDeserializer value_deserializer_;
+    int64_t timestamp_;
 };
 
 impala::HdfsHFileScanner::HdfsHFileScanner(HdfsScanNode* scan_node, RuntimeState* state) :
-    HdfsScanner(scan_node, state),byte_buffer_ptr_(NULL),byte_buffer_end_(NULL),num_checksum_bytes_(0),num_key_cols_(-1),only_parsing_trailer_(false),
-    decompressed_data_pool_(new MemPool()),block_buffer_len_(0)
+    HdfsScanner(scan_node, state),byte_buffer_ptr_(NULL),byte_buffer_end_(NULL),num_key_cols_(-1),
+    file_metadata_(NULL),trailer_(NULL),range_type_(TRAILER_RANGE),
+    decompressed_data_pool_(new MemPool()),block_buffer_len_(0),block_cache_(NULL),
+    file_mtime_(0),min_timestamp_(0),max_timestamp_(-1),filter_timestamps_(false)
 {
 }
 
@@ -537,35 +559,47 @@ Status HdfsHFileScanner::ProcessSplit(ScannerContext* context)
 
     //each scanner object associated with a scanner thread in current context.
     //
-    //keep trailer_ in per file meta data in order to let another scan range get access to it.
-    trailer_ = reinterpret_cast<hfile::FixedFileTrailer*>(scan_node_->GetFileMetadata(
+    //keep the trailer in per file meta data in order to let another scan range get
+    //access to it.
+    file_metadata_ = reinterpret_cast<FileMetadata*>(scan_node_->GetFileMetadata(
                    stream_->filename()));
 
-    if (trailer_ == NULL)
+    if (file_metadata_ == NULL)
     {
         //this is the initial scan range just to parse the trailer
-        only_parsing_trailer_ = true;
+        range_type_ = TRAILER_RANGE;
 
-        trailer_ = state_->obj_pool()->Add(new hfile::FixedFileTrailer());
+        file_metadata_ = state_->obj_pool()->Add(new FileMetadata());
+        trailer_ = &file_metadata_->trailer_;
 
         RETURN_IF_ERROR(ProcessTrailer());
 
-        scan_node_->SetFileMetadata(stream_->filename(), trailer_);
+        scan_node_->SetFileMetadata(stream_->filename(), file_metadata_);
 
         //release scanner thread after done its work.
         //FIXME XXX
-//        scan_node_->runtime_state()->resource_pool()->ReleaseThreadToken(false);
+//        scan_node_->thread_resource_pool()->ReleaseThreadToken(false);
 
         //before this scan thread die, it will pass queued scan ranges to disk io manager.
-        return IssueFileRanges(stream_->filename());
+        return IssueIndexRange();
     }
 
-    only_parsing_trailer_ = false;
+    trailer_ = &file_metadata_->trailer_;
+    range_type_ = file_metadata_->range_type_;
+    file_mtime_ = file_desc->mtime;
+    THdfsCompression::type compression;
+    RETURN_IF_ERROR(GetCompression(&compression));
+    RETURN_IF_ERROR(Codec::CreateDecompressor(state_,
+                    decompressed_data_pool_.get(), stream_->compact_data(),
+                    compression, &decompressor_));
+
+    //this is the range of the load-on-open section, plan the data ranges.
+    if (range_type_ == INDEX_RANGE)
+        return ProcessLoadOnOpenSection();
+    if (range_type_ == BLOOM_RANGE)
+        return ProcessBloomChunk();
 
     kv_parser_.reset(new KeyValue());
-       RETURN_IF_ERROR(Codec::CreateDecompressor(state_,
-                    decompressed_data_pool_.get(), stream_->compact_data(),
-                    "SNAPPY", &decompressor_));
     RETURN_IF_ERROR(ProcessSplitInternal());
 
     return Status::OK;
@@ -619,6 +653,8 @@ Status HdfsHFileScanner::ProcessSplitInternal()
 
                     return parse_status_;
                 }
+                if(!InTimeRange())
+                    continue;
                 row->SetTuple(scan_node_->tuple_idx(), tuple);
                 if(ExecNode::EvalConjuncts(conjuncts_, num_conjuncts_, row))
                 {
@@ -639,7 +675,8 @@ Status HdfsHFileScanner::ProcessSplitInternal()
                         context_->CommitRows(num_to_commit);
                     return parse_status_;
                 }
-                num_to_commit++;
+                if(InTimeRange())
+                    num_to_commit++;
             }
             // for count(*), there is no materialized fields.
             num_to_commit =  WriteEmptyTuples(context_, row, num_to_commit);
@@ -659,7 +696,9 @@ Status HdfsHFileScanner::Close()
 {
     context_->Close();
     // not uniformly compressed.
-    if(!only_parsing_trailer_)
+    // The file counts as one range, which is complete when all its data ranges are.
+    if(range_type_ == DATA_RANGE &&
+       __sync_add_and_fetch(&file_metadata_->num_ranges_remaining_, -1) == 0)
         scan_node_->RangeComplete(THdfsFileFormat::HFILE, THdfsCompression::NONE);
 //  assemble_rows_timer_.UpdateCounter();
     return Status::OK;
@@ -673,24 +712,29 @@ Status HdfsHFileScanner::Prepare()
     col_types_ = hdfs_table->col_types();
     num_clustering_cols_ = hdfs_table->num_clustering_cols();
     scan_node_->IncNumScannersCodegenDisabled();
+    if(state_->exec_env() != NULL)
+        block_cache_ = state_->exec_env()->hfile_block_cache();
+    min_timestamp_ = state_->hfile_min_timestamp();
+    max_timestamp_ = state_->hfile_max_timestamp();
+    //hbase timestamps are not negative
+    filter_timestamps_ = min_timestamp_ > 0 || max_timestamp_ >= 0;
     return Status::OK;
 }
 
+bool HdfsHFileScanner::InTimeRange()
+{
+    if(!filter_timestamps_)
+        return true;
+    int64_t timestamp = kv_parser_->Get_Timestamp();
+    return timestamp >= min_timestamp_ &&
+           (max_timestamp_ < 0 || timestamp < max_timestamp_);
+}
+
 bool HdfsHFileScanner::WriteTuple(MemPool * pool, Tuple * tuple,bool skip)
 {
 
     if(byte_buffer_ptr_ == byte_buffer_end_)
     {
-        if(num_checksum_bytes_ > 0)
-        {
-            Status dumy_status;
-            if(!stream_->SkipBytes(num_checksum_bytes_, &dumy_status))
-            {
-                parse_status_ = dumy_status;
-                return false;
-            }
-            num_checksum_bytes_ = 0;
-        }
         Status s = ReadDataBlock();
         if(!s.ok()){
             parse_status_ = s;
@@ -764,114 +808,720 @@ Status HdfsHFileScanner::ReadDataBlock()
     //need to read in a loop to skip no-data-block-type block
     while(true)
     {
+        //data ranges end at a block boundary
+        if(stream_->eosr())
+            break;
 
-   if(!stream_->GetBytes(trailer_->header_size_, &buffer, &num_bytes, &eos, &status))
+        int64_t block_offset = stream_->file_offset();
+        if(!stream_->GetBytes(trailer_->header_size_, &buffer, &num_bytes, &eos, &status))
             return status;
         DCHECK_EQ(trailer_->header_size_, num_bytes);
-        if(stream_->file_offset() - num_bytes >  trailer_->last_data_block_offset_)
+        if(block_offset > static_cast<int64_t>(trailer_->last_data_block_offset_))
         {
             //has already read all data blocks
             break;
         }
 
-        uint8_t* block_type = buffer;
-        buffer += 8;
-        uint32_t on_disk_size_without_header = ReadWriteUtil::GetInt(buffer);
-        buffer += 4;
-        uint32_t uncompressed_size_without_header = ReadWriteUtil::GetInt(buffer);
-        buffer += 4;
-        //skip previous block offset field
-        buffer += 8;
-
-        uint8_t checksum_type;
-        uint32_t bytes_per_checksum;
-        uint32_t on_disk_data_size_with_header;
-
-        if(trailer_->minor_version_  >=  FixedFileTrailer::MINOR_VERSION_WITH_CHECKSUM)
-        {
-            checksum_type = *buffer;
-            buffer++;
-            bytes_per_checksum=ReadWriteUtil::GetInt(buffer);
-            buffer+=4;
-            on_disk_data_size_with_header=ReadWriteUtil::GetInt(buffer);
-            buffer+=4;
-        }
-        else
-        {
-            checksum_type=0;
-            bytes_per_checksum = 0;
-            on_disk_data_size_with_header = on_disk_size_without_header + FixedFileTrailer::HEADER_SIZE_NO_CHECKSUM;
-        }
-
-        uint32_t on_disk_data_size_without_header = on_disk_data_size_with_header -trailer_->header_size_;
-        uint32_t checksum_size = on_disk_size_without_header - on_disk_data_size_without_header;
+        //keep the header, the stream may reuse its buffer when the data is read.
+        uint8_t header_data[FixedFileTrailer::HEADER_SIZE_WITH_CHECKSUMS];
+        memcpy(header_data, buffer, num_bytes);
+        hfile::BlockHeader header;
+        RETURN_IF_ERROR(hfile::BlockHeader::Parse(header_data, *trailer_, &header));
 
         //it is suffice to  compare prefix to determine whether this block is a data block
-        if(memcmp(block_type,FixedFileTrailer::DATA_BLOCK_TYPE,7))
+        if(memcmp(header.block_type_,FixedFileTrailer::DATA_BLOCK_TYPE,7))
         {
             //this block is not a data block, skip this block and continue;
-            if(!stream_->SkipBytes(on_disk_size_without_header, &status))
+            if(!stream_->SkipBytes(header.on_disk_size_without_header_, &status))
                 return status;
             continue;
         }
-        DCHECK_EQ(block_type+num_bytes, buffer);
 
         //it's really a data block.
-        if(!stream_->ReadBytes(on_disk_data_size_without_header, &buffer, &status))
+        int uncompressed_len = header.uncompressed_size_without_header_;
+        if(block_cache_ != NULL)
         {
-            return status;
+            buffer = GetBlockBuffer(uncompressed_len);
+            if(block_cache_->Lookup(stream_->filename(), file_mtime_, block_offset,
+                                    uncompressed_len, buffer))
+            {
+                COUNTER_UPDATE(scan_node_->hfile_block_cache_hits_counter(), 1);
+                if(!stream_->SkipBytes(header.on_disk_size_without_header_, &status))
+                    return status;
+                byte_buffer_ptr_ = buffer;
+                byte_buffer_end_ = buffer + uncompressed_len;
+                break;
+            }
+            COUNTER_UPDATE(scan_node_->hfile_block_cache_misses_counter(), 1);
         }
-        //trailer_.compression_codec_ is ordinal value of compression enum.
-        // no compression
-        if(trailer_->compression_codec_ == 2)
+
+        RETURN_IF_ERROR(ReadBlockData(header, header_data, block_offset, &buffer));
+        RETURN_IF_ERROR(DecompressBlock(header, &buffer));
+        if(block_cache_ != NULL)
+            block_cache_->Insert(stream_->filename(), file_mtime_, block_offset, buffer,
+                                 uncompressed_len);
+
+        byte_buffer_ptr_ = buffer;
+        byte_buffer_end_ = buffer + uncompressed_len;
+        break;
+
+
+    }
+
+    return Status::OK;
+}
+
+Status HdfsHFileScanner::ReadBlockData(const hfile::BlockHeader& header,
+                                       const uint8_t* header_data, int64_t block_offset,
+                                       uint8_t** data)
+{
+    //read the checksums that follow the data along with it.
+    if(!stream_->ReadBytes(header.on_disk_size_without_header_, data, &parse_status_))
+        return parse_status_;
+    if(!FLAGS_hfile_verify_checksums)
+        return Status::OK;
+
+    Status status = header.VerifyChecksums(header_data, *data);
+    if(!status.ok())
+    {
+        stringstream ss;
+        ss << "Corrupt block at offset " << block_offset << " of HFile "
+           << stream_->filename();
+        status.AddErrorMsg(ss.str());
+    }
+    return status;
+}
+
+uint8_t* HdfsHFileScanner::GetBlockBuffer(int len)
+{
+    if(block_buffer_len_ < len)
+    {
+        block_buffer_ = decompressed_data_pool_->Allocate(len);
+        block_buffer_len_ = len;
+    }
+    return block_buffer_;
+}
+
+//ordinals of the Compression.Algorithm enum written in java
+enum CompressionAlgorithm
+{
+    COMPRESSION_LZO = 0,
+    COMPRESSION_GZ = 1,
+    COMPRESSION_NONE = 2,
+    COMPRESSION_SNAPPY = 3,
+    COMPRESSION_LZ4 = 4
+};
+
+Status HdfsHFileScanner::GetCompression(THdfsCompression::type* compression)
+{
+    switch(trailer_->compression_codec_)
+    {
+    case COMPRESSION_GZ:
+        *compression = THdfsCompression::GZIP;
+        return Status::OK;
+    case COMPRESSION_NONE:
+        *compression = THdfsCompression::NONE;
+        return Status::OK;
+    //hbase uses hadoop's codecs, which add their block framing to snappy and lz4.
+    case COMPRESSION_SNAPPY:
+        *compression = THdfsCompression::SNAPPY_BLOCKED;
+        return Status::OK;
+    case COMPRESSION_LZ4:
+        *compression = THdfsCompression::LZ4_BLOCKED;
+        return Status::OK;
+    default:
+    {
+        stringstream ss;
+        ss << "HFile " << stream_->filename()
+           << " uses an unsupported compression codec: " << trailer_->compression_codec_;
+        return Status(ss.str());
+    }
+    }
+}
+
+Status HdfsHFileScanner::DecompressBlock(const hfile::BlockHeader& header, uint8_t** data)
+{
+    // no compression
+    if(decompressor_ == NULL)
+    {
+        if(header.on_disk_data_size_ != header.uncompressed_size_without_header_)
         {
-            DCHECK_EQ(on_disk_size_without_header, uncompressed_size_without_header+checksum_size);
+            stringstream ss;
+            ss << "Invalid uncompressed HFile block of " << stream_->filename() << ": "
+               << header.on_disk_data_size_ << " bytes on disk, expected "
+               << header.uncompressed_size_without_header_;
+            return Status(ss.str());
         }
-        else if(trailer_->compression_codec_ == 3) //snappy compression.
+        return Status::OK;
+    }
+
+    //the header has the uncompressed size, so the block is decompressed into a buffer
+    //of the right size.
+    int uncompressed_len = header.uncompressed_size_without_header_;
+    uint8_t* buffer = GetBlockBuffer(uncompressed_len);
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(
+                        static_cast<int>(header.on_disk_data_size_), *data,
+                        &uncompressed_len, &buffer));
+    *data = buffer;
+    return Status::OK;
+}
+
+//put the range of the load-on-open section into queue, which will be issued to io
+//manager when scanner thread terminate.
+Status HdfsHFileScanner::IssueIndexRange()
+{
+    HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
+
+    ScanRangeMetadata* metadata =
+        reinterpret_cast<ScanRangeMetadata*>(file_desc->splits[0]->meta_data());
+
+    if(trailer_->major_version_ < 2)
+    {
+        stringstream ss;
+        ss << "HFile " << stream_->filename() << " has unsupported version "
+           << trailer_->major_version_;
+        return Status(ss.str());
+    }
+
+    //the load-on-open section spans from the root data index to the trailer.
+    int64_t trailer_offset = file_desc->file_length
+                             - FixedFileTrailer::GetTrailerSize(trailer_->major_version_);
+    DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(stream_->filename(),
+                                  trailer_offset - trailer_->load_on_open_data_offset_,
+                                  trailer_->load_on_open_data_offset_,
+                                  metadata->partition_id,
+                                  stream_->scan_range()->disk_id());
+    scan_node_->AddDiskIoRange(range);
+
+    return Status::OK;
+
+}
+
+Status HdfsHFileScanner::ProcessLoadOnOpenSection()
+{
+    //the section starts with the root data index and the meta index, followed by the
+    //file info and the meta blocks of the bloom filters.
+    vector<hfile::BlockIndexEntry> entries;
+    bool has_bloom_filter = false;
+    for(int block_idx = 0; !stream_->eosr(); block_idx++)
+    {
+        uint8_t* buffer;
+        int num_bytes;
+        bool eos;
+        int64_t block_offset = stream_->file_offset();
+        if(!stream_->GetBytes(trailer_->header_size_, &buffer, &num_bytes, &eos,
+                              &parse_status_))
+            return parse_status_;
+        if(num_bytes != trailer_->header_size_)
+            return Status("Invalid HFile: truncated load-on-open section");
+
+        uint8_t header_data[FixedFileTrailer::HEADER_SIZE_WITH_CHECKSUMS];
+        memcpy(header_data, buffer, num_bytes);
+        hfile::BlockHeader header;
+        RETURN_IF_ERROR(hfile::BlockHeader::Parse(header_data, *trailer_, &header));
+        bool is_root_index = block_idx == 0;
+        if(is_root_index &&
+           memcmp(header.block_type_, FixedFileTrailer::ROOT_INDEX_BLOCK_TYPE, 8))
         {
-            RETURN_IF_ERROR(decompressor_->ProcessBlock(static_cast<int>(on_disk_data_size_without_header),buffer,uncompressed_size_without_header,&block_buffer_));
-            buffer = block_buffer_;
+            stringstream ss;
+            ss << "Invalid HFile " << stream_->filename()
+               << ": expected root index block, got "
+               << string(reinterpret_cast<const char*>(header.block_type_), 8);
+            return Status(ss.str());
         }
-        else
+        bool is_file_info =
+            !memcmp(header.block_type_, FixedFileTrailer::FILE_INFO_BLOCK_TYPE, 8);
+        bool is_bloom_meta =
+            !memcmp(header.block_type_, FixedFileTrailer::BLOOM_META_BLOCK_TYPE, 8);
+        //the root index is only used if it can split the data section. The meta index
+        //and the delete family bloom filter are not used.
+        if(!(is_root_index && hfile::DataBlockIndex::CanSplit(*trailer_)) &&
+           !is_file_info && !is_bloom_meta)
         {
-            DCHECK(false);//currently only support snappy compression.
+            if(!stream_->SkipBytes(header.on_disk_size_without_header_, &parse_status_))
+                return parse_status_;
+            continue;
         }
 
-        byte_buffer_ptr_ = buffer;
-        byte_buffer_end_ = buffer + uncompressed_size_without_header;
-        num_checksum_bytes_ = 0;
-        if(checksum_type)
+        RETURN_IF_ERROR(ReadBlockData(header, header_data, block_offset, &buffer));
+        RETURN_IF_ERROR(DecompressBlock(header, &buffer));
+        int len = header.uncompressed_size_without_header_;
+        if(is_root_index)
         {
-            num_checksum_bytes_  = checksum_size;
+            RETURN_IF_ERROR(hfile::DataBlockIndex::ParseRootIndex(buffer, len,
+                            trailer_->data_index_count_, &entries));
+        }
+        else if(is_file_info)
+        {
+            RETURN_IF_ERROR(file_metadata_->file_info_.Parse(buffer, len));
         }
         else
         {
-            DCHECK_EQ(checksum_size, 0);
+            RETURN_IF_ERROR(file_metadata_->bloom_filter_.ParseMeta(buffer, len));
+            has_bloom_filter = true;
         }
-        break;
+    }
 
+    if(!FileInTimeRange())
+    {
+        SkipFile("its time range is outside of the query's");
+        return Status::OK;
+    }
 
+    vector<hfile::DataSegment>& segments = file_metadata_->segments_;
+    if(hfile::DataBlockIndex::CanSplit(*trailer_))
+    {
+        RETURN_IF_ERROR(
+            hfile::DataBlockIndex::GetDataSegments(*trailer_, entries, &segments));
     }
+    else
+    {
+        //read the whole data section with one range.
+        segments.resize(1);
+        segments[0].offset_ = trailer_->first_data_block_offset_;
+        segments[0].len_ =
+            trailer_->load_on_open_data_offset_ - trailer_->first_data_block_offset_;
+    }
+
+    GetRowKeyRange(&file_metadata_->key_range_);
+    if(!entries.empty())
+        GetRows(entries[0].first_key_, &file_metadata_->rows_);
 
+    //row blooms are built from the rows alone, so the rows can be looked up in them.
+    if(!file_metadata_->rows_.empty() && has_bloom_filter &&
+       file_metadata_->bloom_filter_.CanLookup() &&
+       file_metadata_->file_info_.GetBloomFilterType() == "ROW")
+    {
+        IssueBloomRanges();
+        return Status::OK;
+    }
+    IssueDataRanges();
     return Status::OK;
 }
 
+bool HdfsHFileScanner::FileInTimeRange()
+{
+    int64_t min_timestamp;
+    int64_t max_timestamp;
+    if(!filter_timestamps_ ||
+       !file_metadata_->file_info_.GetTimeRange(&min_timestamp, &max_timestamp))
+        return true;
+    //the time range of the file includes max_timestamp, the query's does not.
+    return max_timestamp >= min_timestamp_ &&
+           (max_timestamp_ < 0 || min_timestamp < max_timestamp_);
+}
+
+enum CompareOp
+{
+    COMPARE_NONE,
+    COMPARE_EQ,
+    COMPARE_LT,
+    COMPARE_LE,
+    COMPARE_GT,
+    COMPARE_GE
+};
+
+#define COMPARE_OP_CASES(OP) \
+    case TExprOpcode::OP##_CHAR_CHAR: \
+    case TExprOpcode::OP##_SHORT_SHORT: \
+    case TExprOpcode::OP##_INT_INT: \
+    case TExprOpcode::OP##_LONG_LONG: \
+    case TExprOpcode::OP##_STRINGVALUE_STRINGVALUE: \
+        return COMPARE_##OP;
+
+// Returns the comparison 'op' does if it is a comparison of integers or strings, the
+// types a row key range can be derived from.
+static CompareOp GetCompareOp(TExprOpcode::type op)
+{
+    switch(op)
+    {
+        COMPARE_OP_CASES(EQ)
+        COMPARE_OP_CASES(LT)
+        COMPARE_OP_CASES(LE)
+        COMPARE_OP_CASES(GT)
+        COMPARE_OP_CASES(GE)
+    default:
+        return COMPARE_NONE;
+    }
+}
+
+#undef COMPARE_OP_CASES
+
+// Encodes the non-null 'value' of a row key column of type 'type' like
+// BinarySortableSerDe. Returns false for types a key can't be derived from.
+static bool EncodeKey(PrimitiveType type, void* value, string* key)
+{
+    switch(type)
+    {
+    case TYPE_TINYINT:
+        return hfile::RowKeyRange::EncodeInt(type, *reinterpret_cast<int8_t*>(value),
+                                             key);
+    case TYPE_SMALLINT:
+        return hfile::RowKeyRange::EncodeInt(type, *reinterpret_cast<int16_t*>(value),
+                                             key);
+    case TYPE_INT:
+        return hfile::RowKeyRange::EncodeInt(type, *reinterpret_cast<int32_t*>(value),
+                                             key);
+    case TYPE_BIGINT:
+        return hfile::RowKeyRange::EncodeInt(type, *reinterpret_cast<int64_t*>(value),
+                                             key);
+    case TYPE_STRING:
+    {
+        StringValue* sv = reinterpret_cast<StringValue*>(value);
+        hfile::RowKeyRange::EncodeString(sv->ptr, sv->len, key);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void HdfsHFileScanner::GetRowKeyRange(hfile::RowKeyRange* range)
+{
+    //the first column after the partition keys is the first row key column.
+    int key_col = num_clustering_cols_;
+    if(key_col >= col_types_.size())
+        return;
+    int slot_idx = scan_node_->GetMaterializedSlotIdx(key_col);
+    if(slot_idx == HdfsScanNode::SKIP_COLUMN)
+        return;
+    SlotId key_slot_id = scan_node_->materialized_slots()[slot_idx]->id();
+    PrimitiveType key_type = col_types_[key_col];
+
+    for(int i = 0; i < num_conjuncts_; i++)
+    {
+        Expr* conjunct = conjuncts_[i];
+        CompareOp op = GetCompareOp(conjunct->op());
+        if(op == COMPARE_NONE || conjunct->children().size() != 2)
+            continue;
+        Expr* slot_expr = conjunct->GetChild(0);
+        Expr* value_expr = conjunct->GetChild(1);
+        if(dynamic_cast<SlotRef*>(slot_expr) == NULL)
+        {
+            //constant < key is key > constant
+            swap(slot_expr, value_expr);
+            if(op == COMPARE_LT) op = COMPARE_GT;
+            else if(op == COMPARE_LE) op = COMPARE_GE;
+            else if(op == COMPARE_GT) op = COMPARE_LT;
+            else if(op == COMPARE_GE) op = COMPARE_LE;
+        }
+        SlotRef* slot_ref = dynamic_cast<SlotRef*>(slot_expr);
+        if(slot_ref == NULL || slot_ref->slot_id() != key_slot_id ||
+           !value_expr->IsConstant() || value_expr->type() != key_type)
+            continue;
+
+        void* value = value_expr->GetValue(NULL);
+        if(value == NULL)
+            continue;
+        string key;
+        if(!EncodeKey(key_type, value, &key))
+            continue;
 
-//put scan range into queue, which will be issued to io manager when scanner thread terminate.
-Status HdfsHFileScanner::IssueFileRanges(const char* filename)
+        //the bounds hold the encoding of the first column only, so key > x and key < x
+        //are widened to key >= x and key <= x.
+        if(op == COMPARE_EQ || op == COMPARE_GT || op == COMPARE_GE)
+            range->SetLower(key);
+        if(op == COMPARE_EQ || op == COMPARE_LT || op == COMPARE_LE)
+            range->SetUpper(key);
+    }
+}
+
+void HdfsHFileScanner::GetRows(const string& first_key, vector<string>* rows)
 {
+    rows->clear();
+    string first_row;
+    if(!hfile::DataBlockIndex::GetRow(first_key, &first_row).ok() || first_row.empty())
+        return;
+    BinarySortableDeserializer deserializer;
+    int num_key_cols = deserializer.Get_Key_Col_Num(
+                           reinterpret_cast<uint8_t*>(&first_row[0]), first_row.size(),
+                           &col_types_[num_clustering_cols_]);
+
+    //the rows are the concatenations of the values of all key columns.
+    vector<string> partial_rows(1);
+    for(int col = num_clustering_cols_; col < num_clustering_cols_ + num_key_cols; col++)
+    {
+        vector<string> keys;
+        if(!GetKeyColumnValues(col, &keys) ||
+           partial_rows.size() * keys.size() >
+           static_cast<size_t>(FLAGS_hfile_max_bloom_filter_rows))
+            return;
+        vector<string> next_rows;
+        for(int i = 0; i < partial_rows.size(); i++)
+        {
+            for(int j = 0; j < keys.size(); j++)
+                next_rows.push_back(partial_rows[i] + keys[j]);
+        }
+        partial_rows.swap(next_rows);
+    }
+    rows->swap(partial_rows);
+}
 
-    HdfsFileDesc* file_desc = scan_node_->GetFileDesc(filename);
+bool HdfsHFileScanner::GetKeyColumnValues(int col, vector<string>* keys)
+{
+    int slot_idx = scan_node_->GetMaterializedSlotIdx(col);
+    if(slot_idx == HdfsScanNode::SKIP_COLUMN)
+        return false;
+    SlotId key_slot_id = scan_node_->materialized_slots()[slot_idx]->id();
+    PrimitiveType key_type = col_types_[col];
+
+    for(int i = 0; i < num_conjuncts_; i++)
+    {
+        Expr* conjunct = conjuncts_[i];
+        Expr* slot_expr;
+        vector<Expr*> value_exprs;
+        InPredicate* in_pred = dynamic_cast<InPredicate*>(conjunct);
+        if(in_pred != NULL && !in_pred->is_not_in())
+        {
+            slot_expr = in_pred->GetChild(0);
+            value_exprs.assign(in_pred->children().begin() + 1,
+                               in_pred->children().end());
+        }
+        else if(GetCompareOp(conjunct->op()) == COMPARE_EQ &&
+                conjunct->children().size() == 2)
+        {
+            slot_expr = conjunct->GetChild(0);
+            value_exprs.push_back(conjunct->GetChild(1));
+            if(dynamic_cast<SlotRef*>(slot_expr) == NULL)
+                swap(slot_expr, value_exprs[0]);
+        }
+        else
+        {
+            continue;
+        }
+        SlotRef* slot_ref = dynamic_cast<SlotRef*>(slot_expr);
+        if(slot_ref == NULL || slot_ref->slot_id() != key_slot_id)
+            continue;
+
+        keys->clear();
+        bool all_constant = true;
+        for(int j = 0; j < value_exprs.size(); j++)
+        {
+            Expr* value_expr = value_exprs[j];
+            if(!value_expr->IsConstant() || value_expr->type() != key_type)
+            {
+                all_constant = false;
+                break;
+            }
+            //a null value matches no row
+            void* value = value_expr->GetValue(NULL);
+            if(value == NULL)
+                continue;
+            string key;
+            if(!EncodeKey(key_type, value, &key))
+            {
+                all_constant = false;
+                break;
+            }
+            keys->push_back(key);
+        }
+        if(all_constant && !keys->empty())
+            return true;
+    }
+    keys->clear();
+    return false;
+}
+
+// Returns the index of the split of 'file_desc' containing 'offset', or -1.
+static int GetSplitIdx(const HdfsFileDesc* file_desc, int64_t offset)
+{
+    for(int i = 0; i < file_desc->splits.size(); i++)
+    {
+        const DiskIoMgr::ScanRange* split = file_desc->splits[i];
+        if(offset >= split->offset() && offset < split->offset() + split->len())
+            return i;
+    }
+    return -1;
+}
 
+void HdfsHFileScanner::IssueRange(int64_t offset, int64_t len)
+{
+    HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
     ScanRangeMetadata* metadata =
         reinterpret_cast<ScanRangeMetadata*>(file_desc->splits[0]->meta_data());
-
-    DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(filename, file_desc->file_length,
-                                  trailer_->first_data_block_offset_, metadata->partition_id, -1);
+    int split_idx = GetSplitIdx(file_desc, offset);
+    int disk_id = split_idx == -1 ? -1 : file_desc->splits[split_idx]->disk_id();
+    DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(stream_->filename(),
+                                  len, offset, metadata->partition_id, disk_id);
     scan_node_->AddDiskIoRange(range);
+}
+
+void HdfsHFileScanner::SkipFile(const char* reason)
+{
+    COUNTER_UPDATE(scan_node_->hfile_files_skipped_counter(), 1);
+    VLOG_FILE << "Skipping " << stream_->filename() << ": " << reason;
+    scan_node_->RangeComplete(THdfsFileFormat::HFILE, THdfsCompression::NONE);
+}
+
+void HdfsHFileScanner::IssueBloomRanges()
+{
+    const hfile::BloomFilter& bloom_filter = file_metadata_->bloom_filter_;
+    const vector<string>& rows = file_metadata_->rows_;
+    //rows before the first chunk are not in the file.
+    set<int> chunks;
+    file_metadata_->row_chunks_.resize(rows.size());
+    file_metadata_->rows_in_bloom_filter_.assign(rows.size(), 0);
+    for(int i = 0; i < rows.size(); i++)
+    {
+        int chunk_idx = bloom_filter.GetChunkIdx(rows[i]);
+        file_metadata_->row_chunks_[i] = chunk_idx;
+        if(chunk_idx >= 0)
+            chunks.insert(chunk_idx);
+    }
+    if(chunks.empty())
+    {
+        SkipFile("none of the rows is in its bloom filter");
+        return;
+    }
+
+    //set before any bloom range can complete
+    file_metadata_->num_bloom_ranges_remaining_ = chunks.size();
+    file_metadata_->range_type_ = BLOOM_RANGE;
+    for(set<int>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        const hfile::BlockIndexEntry& chunk = bloom_filter.chunks()[*it];
+        IssueRange(chunk.offset_, chunk.on_disk_size_);
+    }
+}
+
+Status HdfsHFileScanner::ReadBlock(const uint8_t* block_type, hfile::BlockHeader* header,
+                                   uint8_t** data)
+{
+    uint8_t* buffer;
+    int num_bytes;
+    bool eos;
+    int64_t block_offset = stream_->file_offset();
+    if(!stream_->GetBytes(trailer_->header_size_, &buffer, &num_bytes, &eos,
+                          &parse_status_))
+        return parse_status_;
+    if(num_bytes != trailer_->header_size_)
+        return Status("Invalid HFile: truncated block header");
+
+    uint8_t header_data[FixedFileTrailer::HEADER_SIZE_WITH_CHECKSUMS];
+    memcpy(header_data, buffer, num_bytes);
+    RETURN_IF_ERROR(hfile::BlockHeader::Parse(header_data, *trailer_, header));
+    if(memcmp(header->block_type_, block_type, 8))
+    {
+        stringstream ss;
+        ss << "Invalid HFile " << stream_->filename() << ": expected "
+           << string(reinterpret_cast<const char*>(block_type), 8) << " block at offset "
+           << block_offset << ", got "
+           << string(reinterpret_cast<const char*>(header->block_type_), 8);
+        return Status(ss.str());
+    }
+    //the header points into header_data
+    header->block_type_ = block_type;
+    RETURN_IF_ERROR(ReadBlockData(*header, header_data, block_offset, data));
+    return DecompressBlock(*header, data);
+}
+
+Status HdfsHFileScanner::ProcessBloomChunk()
+{
+    int64_t chunk_offset = stream_->file_offset();
+    hfile::BlockHeader header;
+    uint8_t* bits;
+    RETURN_IF_ERROR(ReadBlock(FixedFileTrailer::BLOOM_CHUNK_BLOCK_TYPE, &header, &bits));
+
+    //each range is a different chunk, so the ranges write different rows.
+    const hfile::BloomFilter& bloom_filter = file_metadata_->bloom_filter_;
+    const vector<string>& rows = file_metadata_->rows_;
+    for(int i = 0; i < rows.size(); i++)
+    {
+        int chunk_idx = file_metadata_->row_chunks_[i];
+        if(chunk_idx < 0 || bloom_filter.chunks()[chunk_idx].offset_ != chunk_offset)
+            continue;
+        file_metadata_->rows_in_bloom_filter_[i] = bloom_filter.ChunkContains(bits,
+                header.uncompressed_size_without_header_, rows[i]);
+    }
+    if(__sync_add_and_fetch(&file_metadata_->num_bloom_ranges_remaining_, -1) > 0)
+        return Status::OK;
 
+    //this is the last chunk, read the rows that passed.
+    vector<string> passed_rows;
+    for(int i = 0; i < rows.size(); i++)
+    {
+        if(file_metadata_->rows_in_bloom_filter_[i])
+            passed_rows.push_back(rows[i]);
+    }
+    if(passed_rows.empty())
+    {
+        SkipFile("none of the rows is in its bloom filter");
+        return Status::OK;
+    }
+    file_metadata_->rows_.swap(passed_rows);
+    IssueDataRanges();
     return Status::OK;
+}
+
+// Returns true if 'rows' is empty or one of them can be in the segment whose rows are
+// in [first_row, next_first_row], where 'next_first_row' is NULL for the last one.
+static bool SegmentMayContainRows(const vector<string>& rows, const string& first_row,
+                                  const string* next_first_row)
+{
+    if(rows.empty())
+        return true;
+    for(int i = 0; i < rows.size(); i++)
+    {
+        if(rows[i] >= first_row && (next_first_row == NULL || rows[i] <= *next_first_row))
+            return true;
+    }
+    return false;
+}
+
+void HdfsHFileScanner::IssueDataRanges()
+{
+    HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
+    const vector<hfile::DataSegment>& segments = file_metadata_->segments_;
+    const hfile::RowKeyRange& key_range = file_metadata_->key_range_;
+    const vector<string>& rows = file_metadata_->rows_;
+
+    //offset, length and split index of the ranges to issue
+    vector<int64_t> range_offsets;
+    vector<int64_t> range_lens;
+    vector<int> range_splits;
+    int num_skipped = 0;
+    bool extend_range = false;
+    for(int i = 0; i < segments.size(); i++)
+    {
+        const hfile::DataSegment& segment = segments[i];
+        const string* next_first_row = (i + 1 < segments.size()) ?
+                                       &segments[i + 1].first_row_ : NULL;
+        if(!key_range.MayContain(segment.first_row_, next_first_row) ||
+           !SegmentMayContainRows(rows, segment.first_row_, next_first_row))
+        {
+            ++num_skipped;
+            extend_range = false;
+            continue;
+        }
+        int split_idx = GetSplitIdx(file_desc, segment.offset_);
+        if(extend_range && range_splits.back() == split_idx &&
+           range_offsets.back() + range_lens.back() == segment.offset_)
+        {
+            range_lens.back() += segment.len_;
+            continue;
+        }
+        range_offsets.push_back(segment.offset_);
+        range_lens.push_back(segment.len_);
+        range_splits.push_back(split_idx);
+        extend_range = true;
+    }
+    COUNTER_UPDATE(scan_node_->hfile_index_entries_skipped_counter(), num_skipped);
+    VLOG_FILE << "Reading " << stream_->filename() << " with " << range_offsets.size()
+              << " ranges, skipped " << num_skipped << " of " << segments.size()
+              << " index entries outside of the row key range";
+
+    if(range_offsets.empty())
+    {
+        //nothing to read.
+        SkipFile("none of its rows is in the row key range");
+        return;
+    }
 
+    //set before any data range can complete
+    file_metadata_->num_ranges_remaining_ = range_offsets.size();
+    file_metadata_->range_type_ = DATA_RANGE;
+    for(int i = 0; i < range_offsets.size(); i++)
+        IssueRange(range_offsets[i], range_lens[i]);
 }
 
 void HdfsHFileScanner::IssueInitialRanges(HdfsScanNode* scan_node,
@@ -883,13 +1533,13 @@ void HdfsHFileScanner::IssueInitialRanges(HdfsScanNode* scan_node,
         {
             DiskIoMgr::ScanRange* split = files[i]->splits[j];
 
-            // Since hfile scanners always read entire files, only read a file if we're
-            // assigned the first split
+            // The ranges of a file are planned from its trailer and data block index,
+            // only read the trailer if we're assigned the first split
             //to avoid duplicate reading file many times.
             if (split->offset() != 0)
             {
-                // We assign the entire file to one scan range, so mark all but one split
-                // (i.e. the first split) as complete
+                // The file counts as one range that is complete when all its data
+                // ranges are, so mark all but one split (i.e. the first split) as complete
                 //FIXME
                 //add a new enum value for our hfile.
                 scan_node->RangeComplete(THdfsFileFormat::HFILE, THdfsCompression::NONE);
@@ -20,8 +20,16 @@ namespace impala
 class RuntimeState;
 class MemPool;
 class Status;
+class HFileBlockCache;
 
 //Scanner used to parse HFile file format.
+//The trailer and the load-on-open section (root data block index, file info and bloom
+//filter meta) are read first, then the data section is split along the index into
+//block-aligned ranges that are read by multiple scanner threads. Parts of the file
+//whose row keys are outside the range allowed by the predicates on the first row key
+//column are not read at all. Neither are files whose time range is outside the query's
+//or whose bloom filter has none of the rows allowed by equality and IN predicates on
+//all row key columns.
 
 class HdfsHFileScanner: public HdfsScanner
 {
@@ -41,10 +49,95 @@ public:
 
 private:
 
+	enum RangeType
+	{
+		TRAILER_RANGE,
+		INDEX_RANGE,
+		BLOOM_RANGE,
+		DATA_RANGE
+	};
+
+	//per file state, shared by the scan ranges of a file through the scan node's file
+	//metadata. A file is read in up to four passes: the trailer, the load-on-open
+	//section, the bloom filter chunks of the rows the predicates allow, and the data
+	//ranges planned from the index.
+	struct FileMetadata
+	{
+		hfile::FixedFileTrailer trailer_;
+		//type of the ranges issued last, set before they are issued
+		RangeType range_type_;
+		//number of data ranges of this file that are not complete yet
+		int num_ranges_remaining_;
+		//number of bloom filter chunk ranges that are not processed yet
+		int num_bloom_ranges_remaining_;
+
+		//read from the load-on-open section
+		hfile::FileInfo file_info_;
+		hfile::BloomFilter bloom_filter_;
+		std::vector<hfile::DataSegment> segments_;
+		//rows allowed by the predicates on the first row key column
+		hfile::RowKeyRange key_range_;
+		//encoded rows allowed by the predicates on all row key columns, empty if they
+		//allow any row.
+		std::vector<std::string> rows_;
+		//index of the bloom filter chunk of each row, and whether the chunk has it
+		std::vector<int> row_chunks_;
+		std::vector<uint8_t> rows_in_bloom_filter_;
+
+		FileMetadata(): range_type_(INDEX_RANGE), num_ranges_remaining_(0),
+			num_bloom_ranges_remaining_(0) {}
+	};
+
 	Status ProcessTrailer();
+	//issues the range of the load-on-open section.
+	Status IssueIndexRange();
+	//reads the root data index, the file info and the bloom filter meta, and issues
+	//the ranges of the bloom filter chunks to check, or the data ranges.
+	Status ProcessLoadOnOpenSection();
+	//returns false if the time range of the file is outside the query's.
+	bool FileInTimeRange();
+	//narrows 'range' with the conjuncts comparing the first row key column to a constant.
+	void GetRowKeyRange(hfile::RowKeyRange* range);
+	//sets 'rows' to the encoded rows allowed by the equality and IN conjuncts if there
+	//are such conjuncts on every row key column. 'first_key' is the first key of the
+	//file, which gives the number of row key columns.
+	void GetRows(const std::string& first_key, std::vector<std::string>* rows);
+	//returns the encoded constants the column 'col' is compared to by an equality or
+	//IN conjunct in 'keys'. Returns false if there is no such conjunct.
+	bool GetKeyColumnValues(int col, std::vector<std::string>* keys);
+	//issues the ranges of the bloom filter chunks that can have the rows in
+	//file_metadata_->rows_.
+	void IssueBloomRanges();
+	//checks the rows in the bloom filter chunk of the range. The last chunk of the file
+	//to be checked issues the data ranges for the rows that passed.
+	Status ProcessBloomChunk();
+	//issues the data ranges for the segments of the file, skipping those outside the
+	//key range or without any of the rows. Consecutive segments in the same hdfs split
+	//are read by one range.
+	void IssueDataRanges();
+	//marks the file as complete without reading its data.
+	void SkipFile(const char* reason);
+	//queues the range of 'len' bytes at 'offset' of the file.
+	void IssueRange(int64_t offset, int64_t len);
+	//reads the next block of the range and decompresses it, after checking that it
+	//has the block type 'block_type'.
+	Status ReadBlock(const uint8_t* block_type, hfile::BlockHeader* header,
+			uint8_t** data);
+	//reads the next data block of the range, from the block cache if it is there.
 	Status ReadDataBlock();
-	Status IssueFileRanges(const char* filename);
+	//reads the on-disk data of the block with 'header', which was read from
+	//'header_data' at 'block_offset', and verifies its checksums.
+	Status ReadBlockData(const hfile::BlockHeader& header, const uint8_t* header_data,
+			int64_t block_offset, uint8_t** data);
+	//maps the compression codec of the trailer to the codec that reads it.
+	Status GetCompression(THdfsCompression::type* compression);
+	//decompresses the data of the block with 'header' in place of '*data'.
+	Status DecompressBlock(const hfile::BlockHeader& header, uint8_t** data);
+	//returns block_buffer_ after growing it to at least 'len' bytes.
+	uint8_t* GetBlockBuffer(int len);
 	bool WriteTuple(MemPool* pool, Tuple* tuple,bool skip);
+	//returns true if the timestamp of the last KeyValue read is in the query's time range.
+	bool InTimeRange();
 	Status ProcessSplitInternal();
 
 
@@ -57,7 +150,6 @@ private:
 
 	uint8_t* byte_buffer_ptr_;
 	uint8_t* byte_buffer_end_;
-	uint32_t num_checksum_bytes_;
 
 	std::vector<PrimitiveType> col_types_;
 	std::vector<PrimitiveType>  key_col_types_;
@@ -68,8 +160,19 @@ private:
 	int num_clustering_cols_;
 	class KeyValue;
 	boost::scoped_ptr<KeyValue> kv_parser_;
+	FileMetadata* file_metadata_;
 	hfile::FixedFileTrailer* trailer_;
-	bool only_parsing_trailer_;
+	RangeType range_type_;
+	//process-wide cache of decompressed data blocks, NULL if disabled.
+	HFileBlockCache* block_cache_;
+	//modification time of the file, part of the block cache key.
+	int64_t file_mtime_;
+	//time range [min_timestamp_, max_timestamp_) of the cells to return. A negative
+	//max_timestamp_ means no upper bound.
+	int64_t min_timestamp_;
+	int64_t max_timestamp_;
+	//true if the cells have to be checked against the time range
+	bool filter_timestamps_;
 
 };
 
@@ -18,6 +18,7 @@
 #include "exec/hdfs-scan-node.h"
 #include "exec/scanner-context.inline.h"
 #include "exec/read-write-util.h"
+#include "exec/runtime-filter.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
 #include "runtime/runtime-state.h"
@@ -27,6 +28,7 @@
 #include "runtime/tuple-row.h"
 #include "runtime/tuple.h"
 #include "runtime/string-value.h"
+#include "runtime/timestamp-value.h"
 #include "util/bit-util.h"
 #include "util/decompress.h"
 #include "util/rle-encoding.h"
@@ -77,6 +79,8 @@ void HdfsParquetScanner::IssueInitialRanges(HdfsScanNode* scan_node,
 
 HdfsParquetScanner::HdfsParquetScanner(HdfsScanNode* scan_node, RuntimeState* state) 
     : HdfsScanner(scan_node, state),
+      row_group_idx_(0),
+      next_row_group_range_(NULL),
       assemble_rows_timer_(scan_node_->materialize_tuple_timer()) {
   assemble_rows_timer_.Stop();
 }
@@ -86,32 +90,43 @@ HdfsParquetScanner::~HdfsParquetScanner() {
 
 // Reader for a single column from the parquet file.  It's associated with a 
 // ScannerContext::Stream and is responsible for decoding the data.
+// Values are decoded a batch at a time: the definition levels of the batch are
+// unpacked first, then the values are written to the slots of consecutive tuples by a
+// loop that is specialized for the slot type and the page encoding (see
+// MaterializeValues()).  The loop is picked once per data page so there are no type or
+// encoding switches per value.
 class HdfsParquetScanner::ColumnReader {
  public:
   ColumnReader(HdfsParquetScanner* parent, const SlotDescriptor* desc) 
     : parent_(parent),
       desc_(desc),
       decompressed_data_pool_(new MemPool()),
-      num_buffered_values_(0) {
+      dictionary_pool_(new MemPool()),
+      num_buffered_values_(0),
+      data_(NULL),
+      data_end_(NULL),
+      has_dictionary_(false),
+      num_dict_values_(0),
+      materialize_fn_(NULL) {
   }
 
   void set_metadata(const parquet::ColumnMetaData* metadata) { metadata_ = metadata; }
   int64_t total_len() const { return metadata_->total_compressed_size; }
   const SlotDescriptor* slot_desc() const { return desc_; }
 
-  // Read the next value into tuple for this column.  Returns 
-  // false if there are no more values in the file.
-  // TODO: this is the function that needs to be codegen'd (e.g. CodegenReadValue())
-  // The codegened functions from all the materialized cols will then be combined
-  // into one function.
-  // TODO: another option is to materialize col by col for the entire row batch in
-  // one call.  e.g. MaterializeCol would write out 1024 values.  Our row batches
-  // are currently dense so we'll need to figure out something there.
-  bool ReadValue(MemPool* pool, Tuple* tuple);
+  // Materializes the next 'max_values' values of this column into the tuples starting
+  // at 'tuple_mem', which are 'tuple_size' bytes apart.  Returns the number of values
+  // read.  This is less than 'max_values' only if there are no more values in the
+  // file or there was an error, in which case parent_->parse_status_ is set.
+  int ReadValueBatch(MemPool* pool, int max_values, int tuple_size, uint8_t* tuple_mem);
  
  private:
   friend class HdfsParquetScanner;
 
+  // Signature of MaterializeValues()
+  typedef bool (ColumnReader::*MaterializeFn)(MemPool* pool, int num_values,
+      int tuple_size, uint8_t* tuple_mem);
+
   HdfsParquetScanner* parent_;
   const SlotDescriptor* desc_;
 
@@ -121,14 +136,20 @@ class HdfsParquetScanner::ColumnReader {
   // Pool to allocate decompression buffers from.
   boost::scoped_ptr<MemPool> decompressed_data_pool_;
 
+  // Pool for the dictionary page.  Tuples reference the dictionary strings until the
+  // end of the column chunk, so unlike decompressed_data_pool_ this is only passed to
+  // the row batch once the column chunk is complete.
+  boost::scoped_ptr<MemPool> dictionary_pool_;
+
   // Header for current data page.
   parquet::PageHeader current_page_header_;
 
   // Num values remaining in the current data page
   int num_buffered_values_;
 
-  // Pointer to start of next value in data page
+  // Pointer to start of next value in data page and to the end of the data page
   uint8_t* data_;
+  uint8_t* data_end_;
 
   // Decoder for bool values.  Only valid if type is TYPE_BOOLEAN
   BitReader bool_values_;
@@ -138,12 +159,58 @@ class HdfsParquetScanner::ColumnReader {
   RleDecoder rle_def_levels_;
   BitReader bit_packed_def_levels_;
 
-  // Read the next data page.
+  // Decoder for the dictionary indices.  Only valid if the current data page is
+  // dictionary encoded.
+  RleDecoder dict_indices_decoder_;
+
+  // The dictionary of the column chunk: num_dict_values_ values in the slot format.
+  bool has_dictionary_;
+  int num_dict_values_;
+  std::vector<uint8_t> dict_;
+
+  // Definition levels and dictionary indices of the values being materialized.
+  std::vector<uint8_t> def_levels_;
+  std::vector<uint32_t> dict_indices_;
+
+  // MaterializeValues() instantiation for the slot type and current page encoding.
+  MaterializeFn materialize_fn_;
+
+  // Read the next data page.  Dictionary pages before it are decoded into dict_.
   Status ReadDataPage();
 
-  // Returns the definition level for the next value
-  // Returns -1 if there was a error parsing it.
-  int ReadDefinitionLevel();
+  // Reads the page data at data_ and decompresses it into 'pool' if necessary.
+  // 'data_size' is the size of the page data and is updated to the uncompressed size.
+  Status DecompressPage(MemPool* pool, int* data_size);
+
+  // Decodes the current (dictionary) page of 'data_size' bytes at data_ into dict_.
+  Status ReadDictionaryPage(int data_size);
+
+  // Decodes 'num_values' PLAIN encoded values of type T at data_ into dict_.
+  template<typename T>
+  bool DecodeDictionary(int num_values);
+
+  // Returns the MaterializeValues() instantiation for the slot type.
+  template<bool IS_DICT>
+  MaterializeFn GetMaterializeFn();
+
+  // Decodes the definition levels of the next 'num_values' values into def_levels_.
+  // Returns false if the levels could not be read.
+  bool ReadDefinitionLevels(int num_values);
+
+  // Decodes the next PLAIN encoded value of type T at data_ into 'slot'.  Strings are
+  // copied into 'pool' if it is not NULL, otherwise they reference the page data.
+  // Returns false if the page data is corrupt.
+  template<typename T>
+  bool DecodePlainValue(MemPool* pool, T* slot);
+
+  // Materializes the next 'num_values' values of the current data page into the
+  // tuples at 'tuple_mem', 'tuple_size' bytes apart.  The definition levels must have
+  // been read into def_levels_.  T is the slot type and IS_DICT is true if the page is
+  // dictionary encoded, false if it is PLAIN encoded.
+  // Returns false if the page data is corrupt.
+  template<typename T, bool IS_DICT>
+  bool MaterializeValues(MemPool* pool, int num_values, int tuple_size,
+      uint8_t* tuple_mem);
 };
 
 Status HdfsParquetScanner::Prepare() {
@@ -164,9 +231,14 @@ Status HdfsParquetScanner::Prepare() {
 
 Status HdfsParquetScanner::Close() {
   context_->Close();
-  // TODO: this doesn't really work for parquet since the file is 
-  // not uniformly compressed.
-  scan_node_->RangeComplete(THdfsFileFormat::PARQUET, THdfsCompression::NONE);
+  if (next_row_group_range_ != NULL) {
+    // The file is not done yet, the range completes with the last row group.
+    scan_node_->AddDiskIoRange(next_row_group_range_);
+  } else {
+    // TODO: this doesn't really work for parquet since the file is 
+    // not uniformly compressed.
+    scan_node_->RangeComplete(THdfsFileFormat::PARQUET, THdfsCompression::NONE);
+  }
   assemble_rows_timer_.UpdateCounter();
   return Status::OK;
 }
@@ -190,6 +262,9 @@ Status HdfsParquetScanner::ColumnReader::ReadDataPage() {
     RETURN_IF_ERROR(stream_->GetRawBytes(&buffer, &num_bytes, &eos));
     if (num_bytes == 0) {
       DCHECK(eos);
+      // All the values of the column chunk have been materialized, the dictionary is
+      // no longer needed.
+      parent_->context_->AcquirePool(dictionary_pool_.get());
       break;
     }
 
@@ -221,6 +296,12 @@ Status HdfsParquetScanner::ColumnReader::ReadDataPage() {
     if (!stream_->SkipBytes(header_size, &status)) return status;
 
     int data_size = current_page_header_.compressed_page_size;
+    if (current_page_header_.type == parquet::PageType::DICTIONARY_PAGE) {
+      if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
+      RETURN_IF_ERROR(DecompressPage(dictionary_pool_.get(), &data_size));
+      RETURN_IF_ERROR(ReadDictionaryPage(data_size));
+      continue;
+    }
     if (current_page_header_.type != parquet::PageType::DATA_PAGE) {
       // We can safely skip non-data pages
       if (!stream_->SkipBytes(data_size, &status)) return status;
@@ -228,30 +309,9 @@ Status HdfsParquetScanner::ColumnReader::ReadDataPage() {
     }
 
     if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
+    RETURN_IF_ERROR(DecompressPage(decompressed_data_pool_.get(), &data_size));
 
     num_buffered_values_ = current_page_header_.data_page_header.num_values;
-
-    if (metadata_->codec == parquet::CompressionCodec::SNAPPY) {
-      SCOPED_TIMER(parent_->decompress_timer_);
-      size_t uncompressed_size;
-      bool success = snappy::GetUncompressedLength(reinterpret_cast<const char*>(data_),
-          current_page_header_.compressed_page_size, &uncompressed_size);
-      if (!success || uncompressed_size != current_page_header_.uncompressed_page_size) {
-        return Status("Corrupt data page");
-      }
-
-      uint8_t* decompressed_buffer = 
-          decompressed_data_pool_->Allocate(uncompressed_size);
-      success = snappy::RawUncompress(reinterpret_cast<const char*>(data_), 
-          current_page_header_.compressed_page_size, 
-          reinterpret_cast<char*>(decompressed_buffer));
-      if (!success) return Status("Corrupt data page");
-      data_ = decompressed_buffer;
-      data_size = current_page_header_.uncompressed_page_size;
-    } else {
-      // TODO: handle the other codecs.
-      DCHECK_EQ(metadata_->codec, parquet::CompressionCodec::UNCOMPRESSED);
-    }
     
     // Initialize the definition level data
     int32_t num_definition_bytes = 0;
@@ -274,125 +334,321 @@ Status HdfsParquetScanner::ColumnReader::ReadDataPage() {
       }
     }
     DCHECK_GT(num_definition_bytes, 0);
+    if (num_definition_bytes > data_size) return Status("Corrupt data page");
     data_ += num_definition_bytes;
     data_size -= num_definition_bytes;
+    data_end_ = data_ + data_size;
 
-    if (desc_->type() == TYPE_BOOLEAN) {
-      // Initialize bool decoder
-      bool_values_ = BitReader(data_, data_size);
+    parquet::Encoding::type encoding = current_page_header_.data_page_header.encoding;
+    if (encoding == parquet::Encoding::PLAIN_DICTIONARY) {
+      if (!has_dictionary_) {
+        stringstream ss;
+        ss << "File " << stream_->filename() << " has a dictionary encoded data page "
+           << "without a dictionary page for column " << metadata_->path_in_schema[0];
+        return Status(ss.str());
+      }
+      // The indices are prefixed with their bit width.
+      if (data_size == 0 || *data_ > 32) return Status("Corrupt data page");
+      int bit_width = *data_++;
+      dict_indices_decoder_ = RleDecoder(data_, data_end_ - data_, bit_width);
+      materialize_fn_ = GetMaterializeFn<true>();
+    } else if (encoding == parquet::Encoding::PLAIN) {
+      if (desc_->type() == TYPE_BOOLEAN) {
+        // Initialize bool decoder
+        bool_values_ = BitReader(data_, data_size);
+      }
+      materialize_fn_ = GetMaterializeFn<false>();
+    } else {
+      stringstream ss;
+      ss << "File " << stream_->filename() << " uses an unsupported encoding: "
+         << encoding << " for column " << metadata_->path_in_schema[0];
+      return Status(ss.str());
     }
+    DCHECK(materialize_fn_ != NULL);
 
     break;
   }
     
   return Status::OK;
 }
-  
-// TODO More codegen here as well.
-inline int HdfsParquetScanner::ColumnReader::ReadDefinitionLevel() {
-  uint8_t definition_level;
-  bool valid;
-  switch (current_page_header_.data_page_header.definition_level_encoding) {
-    case parquet::Encoding::RLE:
-      valid = rle_def_levels_.Get(&definition_level);
-      break;
-    case parquet::Encoding::BIT_PACKED: {
-      bool v;
-      valid = bit_packed_def_levels_.GetBool(&v);
-      definition_level = v;
-      break;
+
+Status HdfsParquetScanner::ColumnReader::DecompressPage(MemPool* pool, int* data_size) {
+  if (metadata_->codec == parquet::CompressionCodec::SNAPPY) {
+    SCOPED_TIMER(parent_->decompress_timer_);
+    size_t uncompressed_size;
+    bool success = snappy::GetUncompressedLength(reinterpret_cast<const char*>(data_),
+        current_page_header_.compressed_page_size, &uncompressed_size);
+    if (!success || uncompressed_size != current_page_header_.uncompressed_page_size) {
+      return Status("Corrupt data page");
     }
-    default:
-      DCHECK(false);
+
+    uint8_t* decompressed_buffer = pool->Allocate(uncompressed_size);
+    success = snappy::RawUncompress(reinterpret_cast<const char*>(data_), 
+        current_page_header_.compressed_page_size, 
+        reinterpret_cast<char*>(decompressed_buffer));
+    if (!success) return Status("Corrupt data page");
+    data_ = decompressed_buffer;
+    *data_size = current_page_header_.uncompressed_page_size;
+  } else {
+    // TODO: handle the other codecs.
+    DCHECK_EQ(metadata_->codec, parquet::CompressionCodec::UNCOMPRESSED);
   }
-  if (!valid) return -1;
-  return definition_level;
+  return Status::OK;
 }
-  
-inline bool HdfsParquetScanner::ColumnReader::ReadValue(MemPool* pool, Tuple* tuple) {
-  if (num_buffered_values_ == 0) {
-    parent_->assemble_rows_timer_.Stop();
-    parent_->parse_status_ = ReadDataPage();
-    if (num_buffered_values_ == 0) return false;
-    parent_->assemble_rows_timer_.Start();
+
+Status HdfsParquetScanner::ColumnReader::ReadDictionaryPage(int data_size) {
+  int num_values = current_page_header_.dictionary_page_header.num_values;
+  if (desc_->type() == TYPE_BOOLEAN) {
+    return Status("Dictionary encoded bool columns are not supported");
   }
-  
-  --num_buffered_values_;
-  int definition_level = ReadDefinitionLevel();
-  if (definition_level < 0) return false;
-
-  if (definition_level == 0) {
-    // Null value
-    tuple->SetNull(desc_->null_indicator_offset());
-    return true;
+  if (num_values < 0) return Status("Corrupt dictionary page");
+
+  if (desc_->type() == TYPE_STRING &&
+      metadata_->codec == parquet::CompressionCodec::UNCOMPRESSED) {
+    // The dictionary strings reference the page data.  Uncompressed pages are in the
+    // io buffers, which are recycled before the column chunk is complete.
+    uint8_t* page_copy = dictionary_pool_->Allocate(data_size);
+    memcpy(page_copy, data_, data_size);
+    data_ = page_copy;
   }
+  data_end_ = data_ + data_size;
 
-  DCHECK_EQ(definition_level, 1);
+  int slot_size = desc_->type() == TYPE_STRING ?
+      sizeof(StringValue) : GetByteSize(desc_->type());
+  dict_.assign(num_values * slot_size, 0);
+  num_dict_values_ = num_values;
+  has_dictionary_ = true;
+  if (num_values == 0) return Status::OK;
 
-  void* slot = tuple->GetSlot(desc_->tuple_offset());
+  bool success = false;
   switch (desc_->type()) {
-    case TYPE_BOOLEAN: {
-      bool valid;
-      valid = bool_values_.GetBool(reinterpret_cast<bool*>(slot));
-      if (!valid) {
-        parent_->parse_status_ = Status("Invalid bool column");
-        return false;
-      }
-      break;
-    }
     case TYPE_TINYINT:
-      *reinterpret_cast<int8_t*>(slot) = *reinterpret_cast<int32_t*>(data_);
-      data_ += 4;
+      success = DecodeDictionary<int8_t>(num_values);
       break;
     case TYPE_SMALLINT:
-      *reinterpret_cast<int16_t*>(slot) = *reinterpret_cast<int32_t*>(data_);
-      data_ += 4;
+      success = DecodeDictionary<int16_t>(num_values);
       break;
     case TYPE_INT:
-      *reinterpret_cast<int32_t*>(slot) = *reinterpret_cast<int32_t*>(data_);
-      data_ += 4;
+      success = DecodeDictionary<int32_t>(num_values);
       break;
     case TYPE_BIGINT:
-      *reinterpret_cast<int64_t*>(slot) = *reinterpret_cast<int64_t*>(data_);
-      data_ += 8;
+      success = DecodeDictionary<int64_t>(num_values);
       break;
     case TYPE_FLOAT:
-      *reinterpret_cast<float*>(slot) = *reinterpret_cast<float*>(data_);
-      data_ += 4;
+      success = DecodeDictionary<float>(num_values);
       break;
     case TYPE_DOUBLE:
-      *reinterpret_cast<double*>(slot) = *reinterpret_cast<double*>(data_);
-      data_ += 8;
+      success = DecodeDictionary<double>(num_values);
       break;
-    case TYPE_STRING: {
-      StringValue* sv = reinterpret_cast<StringValue*>(slot);
-      sv->len = *reinterpret_cast<int32_t*>(data_);
-      data_ += sizeof(int32_t);
-      if (stream_->compact_data() && sv->len > 0) {
-        sv->ptr = reinterpret_cast<char*>(pool->Allocate(sv->len));
-        memcpy(sv->ptr, data_, sv->len);
-      } else {
-        sv->ptr = reinterpret_cast<char*>(data_);
-      }
-      data_ += sv->len;
+    case TYPE_STRING:
+      success = DecodeDictionary<StringValue>(num_values);
       break;
-    }
-    case TYPE_TIMESTAMP: 
-      // timestamp type is a 12 byte value.
-      memcpy(slot, data_, 12);
-      data_ += 12;
+    case TYPE_TIMESTAMP:
+      success = DecodeDictionary<TimestampValue>(num_values);
       break;
     default:
       DCHECK(false);
   }
+  if (!success) return Status("Corrupt dictionary page");
+  return Status::OK;
+}
+
+template<typename T>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool, T* slot) {
+  if (UNLIKELY(data_ + sizeof(T) > data_end_)) return false;
+  memcpy(slot, data_, sizeof(T));
+  data_ += sizeof(T);
   return true;
 }
-  
+
+namespace impala {
+
+// TINYINT and SMALLINT values are stored as INT32.
+template<>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool,
+    int8_t* slot) {
+  int32_t value;
+  if (UNLIKELY(!DecodePlainValue(pool, &value))) return false;
+  *slot = value;
+  return true;
+}
+
+template<>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool,
+    int16_t* slot) {
+  int32_t value;
+  if (UNLIKELY(!DecodePlainValue(pool, &value))) return false;
+  *slot = value;
+  return true;
+}
+
+// Bools are bit packed.
+template<>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool,
+    bool* slot) {
+  return bool_values_.GetBool(slot);
+}
+
+template<>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool,
+    StringValue* sv) {
+  if (UNLIKELY(data_ + sizeof(int32_t) > data_end_)) return false;
+  int32_t len;
+  memcpy(&len, data_, sizeof(int32_t));
+  data_ += sizeof(int32_t);
+  if (UNLIKELY(len < 0 || data_ + len > data_end_)) return false;
+  sv->len = len;
+  if (pool != NULL && len > 0) {
+    sv->ptr = reinterpret_cast<char*>(pool->Allocate(len));
+    memcpy(sv->ptr, data_, len);
+  } else {
+    sv->ptr = reinterpret_cast<char*>(data_);
+  }
+  data_ += len;
+  return true;
+}
+
+// Timestamps are 12 byte values.
+template<>
+inline bool HdfsParquetScanner::ColumnReader::DecodePlainValue(MemPool* pool,
+    TimestampValue* slot) {
+  if (UNLIKELY(data_ + 12 > data_end_)) return false;
+  memcpy(slot, data_, 12);
+  data_ += 12;
+  return true;
+}
+
+}
+
+template<typename T>
+bool HdfsParquetScanner::ColumnReader::DecodeDictionary(int num_values) {
+  T* dict = reinterpret_cast<T*>(&dict_[0]);
+  for (int i = 0; i < num_values; ++i) {
+    if (UNLIKELY(!DecodePlainValue<T>(NULL, &dict[i]))) return false;
+  }
+  return true;
+}
+
+template<bool IS_DICT>
+HdfsParquetScanner::ColumnReader::MaterializeFn
+HdfsParquetScanner::ColumnReader::GetMaterializeFn() {
+  switch (desc_->type()) {
+    case TYPE_BOOLEAN:
+      return &ColumnReader::MaterializeValues<bool, IS_DICT>;
+    case TYPE_TINYINT:
+      return &ColumnReader::MaterializeValues<int8_t, IS_DICT>;
+    case TYPE_SMALLINT:
+      return &ColumnReader::MaterializeValues<int16_t, IS_DICT>;
+    case TYPE_INT:
+      return &ColumnReader::MaterializeValues<int32_t, IS_DICT>;
+    case TYPE_BIGINT:
+      return &ColumnReader::MaterializeValues<int64_t, IS_DICT>;
+    case TYPE_FLOAT:
+      return &ColumnReader::MaterializeValues<float, IS_DICT>;
+    case TYPE_DOUBLE:
+      return &ColumnReader::MaterializeValues<double, IS_DICT>;
+    case TYPE_STRING:
+      return &ColumnReader::MaterializeValues<StringValue, IS_DICT>;
+    case TYPE_TIMESTAMP:
+      return &ColumnReader::MaterializeValues<TimestampValue, IS_DICT>;
+    default:
+      DCHECK(false);
+      return NULL;
+  }
+}
+
+inline bool HdfsParquetScanner::ColumnReader::ReadDefinitionLevels(int num_values) {
+  switch (current_page_header_.data_page_header.definition_level_encoding) {
+    case parquet::Encoding::RLE:
+      return rle_def_levels_.GetBatch(&def_levels_[0], num_values) == num_values;
+    case parquet::Encoding::BIT_PACKED:
+      return bit_packed_def_levels_.GetBoolBatch(&def_levels_[0], num_values);
+    default:
+      DCHECK(false);
+      return false;
+  }
+}
+
+template<typename T, bool IS_DICT>
+bool HdfsParquetScanner::ColumnReader::MaterializeValues(MemPool* pool,
+    int num_values, int tuple_size, uint8_t* tuple_mem) {
+  const NullIndicatorOffset& null_offset = desc_->null_indicator_offset();
+  const int slot_offset = desc_->tuple_offset();
+  const uint8_t* def_levels = &def_levels_[0];
+
+  const T* dict = NULL;
+  const uint32_t* dict_indices = NULL;
+  if (IS_DICT) {
+    // Decode the indices of all the non-NULL values up front.
+    int num_non_null = 0;
+    for (int i = 0; i < num_values; ++i) {
+      num_non_null += def_levels[i];
+    }
+    if (num_non_null > 0) {
+      if (dict_indices_.size() < num_non_null) dict_indices_.resize(num_non_null);
+      int num_indices = dict_indices_decoder_.GetBatch(&dict_indices_[0], num_non_null);
+      if (UNLIKELY(num_indices != num_non_null)) return false;
+      if (UNLIKELY(num_dict_values_ == 0)) return false;
+      dict_indices = &dict_indices_[0];
+      dict = reinterpret_cast<const T*>(&dict_[0]);
+    }
+  }
+  // Strings that reference the io buffers must be copied if the stream recycles them.
+  MemPool* string_pool = stream_->compact_data() ? pool : NULL;
+
+  for (int i = 0; i < num_values; ++i, tuple_mem += tuple_size) {
+    DCHECK_LE(def_levels[i], 1);
+    if (def_levels[i] == 0) {
+      // Null value
+      reinterpret_cast<Tuple*>(tuple_mem)->SetNull(null_offset);
+      continue;
+    }
+    T* slot = reinterpret_cast<T*>(tuple_mem + slot_offset);
+    if (IS_DICT) {
+      uint32_t idx = *dict_indices++;
+      if (UNLIKELY(idx >= num_dict_values_)) return false;
+      *slot = dict[idx];
+    } else {
+      if (UNLIKELY(!DecodePlainValue(string_pool, slot))) return false;
+    }
+  }
+  return true;
+}
+
+int HdfsParquetScanner::ColumnReader::ReadValueBatch(MemPool* pool, int max_values,
+    int tuple_size, uint8_t* tuple_mem) {
+  if (def_levels_.size() < max_values) def_levels_.resize(max_values);
+  int num_values = 0;
+  while (num_values < max_values) {
+    if (num_buffered_values_ == 0) {
+      parent_->assemble_rows_timer_.Stop();
+      parent_->parse_status_ = ReadDataPage();
+      if (!parent_->parse_status_.ok() || num_buffered_values_ == 0) break;
+      parent_->assemble_rows_timer_.Start();
+    }
+
+    int n = min(max_values - num_values, num_buffered_values_);
+    if (UNLIKELY(!ReadDefinitionLevels(n) || !(this->*materialize_fn_)(
+        pool, n, tuple_size, tuple_mem + num_values * tuple_size))) {
+      stringstream ss;
+      ss << "File " << stream_->filename() << " has corrupt data for column "
+         << metadata_->path_in_schema[0];
+      parent_->parse_status_ = Status(ss.str());
+      break;
+    }
+    num_buffered_values_ -= n;
+    num_values += n;
+  }
+  return num_values;
+}
+
 Status HdfsParquetScanner::ProcessSplit(ScannerContext* context) {
   SetContext(context);
 
   HdfsFileDesc* file_desc = scan_node_->GetFileDesc(stream_->filename());
   DCHECK(file_desc != NULL);
+  row_group_idx_ = reinterpret_cast<ScanRangeMetadata*>(
+      stream_->scan_range()->meta_data())->row_group_idx;
   
   // First process the file metadata in the footer
   bool eosr;
@@ -407,8 +663,8 @@ Status HdfsParquetScanner::ProcessSplit(ScannerContext* context) {
   return Status::OK;
 }
 
-// TODO: this needs to be codegen'd.  The ReadValue function needs to be codegen'd,
-// specific to type and encoding and then inlined into AssembleRows().
+// The batch is materialized a column at a time: each column reader fills its slot in
+// all the tuples of the batch before the next column is read.
 Status HdfsParquetScanner::AssembleRows() {
   assemble_rows_timer_.Start();
   while (!scan_node_->ReachedLimit() && !context_->cancelled()) {
@@ -416,34 +672,42 @@ Status HdfsParquetScanner::AssembleRows() {
     Tuple* tuple;
     TupleRow* row;
     int num_rows = context_->GetMemory(&pool, &tuple, &row);
-    int num_to_commit = 0;
 
+    Tuple* current_tuple = tuple;
+    TupleRow* current_row = row;
     for (int i = 0; i < num_rows; ++i) {
-      InitTuple(context_->template_tuple(), tuple);
-      for (int c = 0; c < column_readers_.size(); ++c) {
-        if (!column_readers_[c]->ReadValue(pool, tuple)) {
-          assemble_rows_timer_.Stop();
-          // This column is complete and has no more data.  This indicates
-          // we are done with this row group.
-          // For correctly formed files, this should be the first column we
-          // are reading.
-          DCHECK(c == 0 || !parse_status_.ok()) << "c=" << c << " " 
-              << parse_status_.GetErrorMsg();;
-          context_->CommitRows(num_to_commit);
-          COUNTER_UPDATE(scan_node_->rows_read_counter(), i);
-          return parse_status_;
-        }
+      InitTuple(context_->template_tuple(), current_tuple);
+      current_row->SetTuple(scan_node_->tuple_idx(), current_tuple);
+      current_row = context_->next_row(current_row);
+      current_tuple = context_->next_tuple(current_tuple);
+    }
+
+    // The first column returns fewer values than requested when the row group is
+    // complete.  The other columns must have the same number of values.
+    int num_values = num_rows;
+    for (int c = 0; c < column_readers_.size(); ++c) {
+      int num_read = column_readers_[c]->ReadValueBatch(pool, num_values,
+          tuple_byte_size_, reinterpret_cast<uint8_t*>(tuple));
+      if (!parse_status_.ok()) {
+        assemble_rows_timer_.Stop();
+        return parse_status_;
+      }
+      if (c == 0) {
+        num_values = num_read;
+      } else if (num_read != num_values) {
+        assemble_rows_timer_.Stop();
+        stringstream ss;
+        ss << "File " << context_->GetStream(c)->filename() << " is invalid.  Column "
+           << column_readers_[c]->metadata_->path_in_schema[0] << " has fewer values "
+           << "than column " << column_readers_[0]->metadata_->path_in_schema[0];
+        return Status(ss.str());
       }
-    
-      row->SetTuple(scan_node_->tuple_idx(), tuple);
-      if (ExecNode::EvalConjuncts(conjuncts_, num_conjuncts_, row)) {
-        row = context_->next_row(row);
-        tuple = context_->next_tuple(tuple);
-        ++num_to_commit;
-      } 
     }
-    context_->CommitRows(num_to_commit);
-    COUNTER_UPDATE(scan_node_->rows_read_counter(), num_rows);
+
+    context_->CommitRows(EvalConjunctsBatch(tuple, row, num_values));
+    COUNTER_UPDATE(scan_node_->rows_read_counter(), num_values);
+    // This row group is complete.
+    if (num_values < num_rows) break;
   }
 
   assemble_rows_timer_.Stop();
@@ -529,9 +793,36 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
       return Status::OK;
     }
 
+    if (row_group_idx_ >= file_metadata_.row_groups.size()) {
+      // Files without row groups have no rows.
+      DCHECK_EQ(row_group_idx_, 0);
+      *eosr = true;
+      return Status::OK;
+    }
+
+    if (row_group_idx_ + 1 < file_metadata_.row_groups.size()) {
+      // Set up the scanner for the next row group.  It parses the footer again, which
+      // is cheap compared to reading the columns.
+      const DiskIoMgr::ScanRange* footer_range = stream_->scan_range();
+      ScanRangeMetadata* metadata =
+          reinterpret_cast<ScanRangeMetadata*>(footer_range->meta_data());
+      next_row_group_range_ = scan_node_->AllocateScanRange(footer_range->file(),
+          footer_range->len(), footer_range->offset(), metadata->partition_id,
+          footer_range->disk_id());
+      reinterpret_cast<ScanRangeMetadata*>(next_row_group_range_->meta_data())->
+          row_group_idx = row_group_idx_ + 1;
+    }
+
+    if (RowGroupRejectedByFilters(file_metadata_.row_groups[row_group_idx_])) {
+      // None of the rows can pass the runtime filters, skip reading the columns.
+      COUNTER_UPDATE(scan_node_->row_groups_filtered_counter(), 1);
+      *eosr = true;
+      return Status::OK;
+    }
+
     // Release the token for the metadata thread.  This thread will be reused to
     // assemble the cols.
-    scan_node_->runtime_state()->resource_pool()->ReleaseThreadToken(false);
+    scan_node_->thread_resource_pool()->ReleaseThreadToken(false);
 
     RETURN_IF_ERROR(InitColumns());
     break;
@@ -541,16 +832,8 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
 
 Status HdfsParquetScanner::InitColumns() {
   int num_partition_keys = scan_node_->num_partition_keys();
-  // TODO: We always generate files with 1 row group but we need to support other
-  // cases for GA.
-  if (file_metadata_.row_groups.size() != 1) {
-    stringstream ss;
-    ss << "File is currently unsupported.  Only parquet files with one row group is "
-       << "supported.  This file: " << stream_->filename() << " has "
-       << file_metadata_.row_groups.size() << " row groups.";
-    return Status(ss.str());
-  }
-  parquet::RowGroup& row_group = file_metadata_.row_groups[0];
+  DCHECK_LT(row_group_idx_, file_metadata_.row_groups.size());
+  parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx_];
 
   int64_t total_bytes = 0;
 
@@ -576,6 +859,11 @@ Status HdfsParquetScanner::InitColumns() {
     parquet::ColumnChunk& col_chunk = row_group.columns[col_idx];
     column_readers_[i]->set_metadata(&col_chunk.meta_data);
     int64_t col_start = col_chunk.meta_data.data_page_offset;
+    if (col_chunk.meta_data.__isset.dictionary_page_offset &&
+        col_chunk.meta_data.dictionary_page_offset > 0) {
+      // The dictionary page precedes the data pages.
+      col_start = min(col_start, col_chunk.meta_data.dictionary_page_offset);
+    }
     int64_t col_len = col_chunk.meta_data.total_compressed_size;
     total_bytes += col_len;
 
@@ -630,13 +918,67 @@ Status HdfsParquetScanner::ValidateFileMetadata() {
   return Status::OK;
 }
 
+// Decodes the PLAIN encoded integer statistics value 'value' of a column with 'type'.
+// Returns false if 'type' is not an integer type or 'value' is invalid.
+static bool DecodeIntStatistic(parquet::Type::type type, const string& value,
+    int64_t* result) {
+  switch (type) {
+    case parquet::Type::INT32: {
+      if (value.size() != sizeof(int32_t)) return false;
+      int32_t v;
+      memcpy(&v, value.data(), sizeof(int32_t));
+      *result = v;
+      return true;
+    }
+    case parquet::Type::INT64:
+      if (value.size() != sizeof(int64_t)) return false;
+      memcpy(result, value.data(), sizeof(int64_t));
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool HdfsParquetScanner::RowGroupRejectedByFilters(const parquet::RowGroup& row_group) {
+  scan_node_->GetRuntimeFilters(&runtime_filters_);
+  int num_partition_keys = scan_node_->num_partition_keys();
+  for (int i = 0; i < runtime_filters_.size(); ++i) {
+    const RuntimeFilter* filter = runtime_filters_[i];
+    if (!filter->has_range()) continue;
+    // Filters on partition keys are evaluated per row against the template tuple.
+    int col_idx = filter->slot()->col_pos() - num_partition_keys;
+    if (col_idx < 0 || col_idx >= row_group.columns.size()) continue;
+    const parquet::ColumnMetaData& col_metadata = row_group.columns[col_idx].meta_data;
+    if (!col_metadata.__isset.statistics) continue;
+    const parquet::Statistics& stats = col_metadata.statistics;
+    if (!stats.__isset.min || !stats.__isset.max) continue;
+    int64_t min_value;
+    int64_t max_value;
+    if (!DecodeIntStatistic(col_metadata.type, stats.min, &min_value)) continue;
+    if (!DecodeIntStatistic(col_metadata.type, stats.max, &max_value)) continue;
+    // NULLs never pass a filter, so the row group has no rows that can pass.
+    if (filter->RangeExcluded(min_value, max_value)) {
+      VLOG_FILE << "Skipping row group of " << stream_->filename() << ": "
+                << filter->DebugString() << " excludes [" << min_value << ", "
+                << max_value << "]";
+      return true;
+    }
+  }
+  return false;
+}
+
 Status HdfsParquetScanner::ValidateColumn(int slot_idx, int col_idx) {
-  parquet::ColumnChunk& file_data = file_metadata_.row_groups[0].columns[col_idx];
+  parquet::ColumnChunk& file_data =
+      file_metadata_.row_groups[row_group_idx_].columns[col_idx];
 
   // Check the encodings are supported
   vector<parquet::Encoding::type>& encodings = file_data.meta_data.encodings;
   for (int i = 0; i < encodings.size(); ++i) {
-    if (encodings[i] != parquet::Encoding::PLAIN) {
+    // RLE and BIT_PACKED are used for the definition levels and dictionary indices.
+    if (encodings[i] != parquet::Encoding::PLAIN &&
+        encodings[i] != parquet::Encoding::PLAIN_DICTIONARY &&
+        encodings[i] != parquet::Encoding::RLE &&
+        encodings[i] != parquet::Encoding::BIT_PACKED) {
       stringstream ss;
       ss << "File " << stream_->filename() << " uses an unsupported encoding: " 
          << encodings[i] << " for column " << col_idx;
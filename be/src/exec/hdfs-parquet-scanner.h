@@ -39,6 +39,10 @@ struct HdfsFileDesc;
 // each column.  When the HdfsParquetScanner object is created, it is passed the
 // ScannerContext has only 1 stream just for the metadata.  After parsing the
 // metadata, the ScannerContext will create one stream per column.
+// Each scanner reads a single row group (ScanRangeMetadata::row_group_idx).  Files
+// with multiple row groups are read by a chain of scanners: when a scanner is done,
+// it issues the footer range for the next row group of the file.  Only the scanner
+// for the last row group marks the file's range as complete.
 class HdfsParquetScanner : public HdfsScanner {
  public:
   HdfsParquetScanner(HdfsScanNode* scan_node, RuntimeState* state);
@@ -66,6 +70,13 @@ class HdfsParquetScanner : public HdfsScanner {
 
   // File metadata thrift object
   parquet::FileMetaData file_metadata_;
+
+  // Index of the row group in file_metadata_ that this scanner reads.
+  int row_group_idx_;
+
+  // Footer range for the next row group of the file, issued in Close().  NULL if
+  // this scanner reads the last row group.
+  DiskIoMgr::ScanRange* next_row_group_range_;
   
   // The scan range group for this scanner.
   DiskIoMgr::ScanRangeGroup scan_range_group_;
@@ -92,13 +103,18 @@ class HdfsParquetScanner : public HdfsScanner {
   // *eosr is a return value.  If true, the scan range is complete (e.g. select count(*))
   Status ProcessFooter(bool* eosr);
 
-  // Walks file_metadata_ and initiates reading the materialized columns.  This 
-  // initializes column_readers_ and issues the reads for the columns.
+  // Walks the metadata of row group row_group_idx_ and initiates reading the
+  // materialized columns.  This initializes column_readers_ and issues the reads
+  // for the columns.
   Status InitColumns();
 
   // Validates the file metadata
   Status ValidateFileMetadata();
 
+  // Returns true if one of the scan node's runtime filters rejects all rows of
+  // 'row_group', based on the min/max statistics of its columns.
+  bool RowGroupRejectedByFilters(const parquet::RowGroup& row_group);
+
   // Validates the column metadata at 'col_idx' to make sure this column is supported 
   // (e.g. encoding, type, etc) and matches the type for the slot at 'slot_idx'
   Status ValidateColumn(int slot_idx, int col_idx);
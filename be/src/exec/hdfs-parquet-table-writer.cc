@@ -27,6 +27,9 @@
 #include "util/thrift-util.h"
 
 #include <sstream>
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <boost/unordered_map.hpp>
+#include <gflags/gflags.h>
 #include <snappy.h>
 
 #include "gen-cpp/ImpalaService_types.h"
@@ -37,6 +40,18 @@ using namespace impala;
 using namespace parquet;
 using namespace apache::thrift;
 
+DEFINE_int64(parquet_row_group_size, 256 * 1024 * 1024, "Target size in bytes of the "
+    "row groups of parquet files written by inserts.  A file with more data is split "
+    "into multiple row groups, which also bounds the data the writer buffers.");
+DEFINE_int32(parquet_dictionary_max_size, 1024 * 1024, "Max (plain encoded) size in "
+    "bytes of the per column chunk dictionary of parquet files written by inserts.  "
+    "Columns switch to the plain encoding once their dictionary grows larger.  0 "
+    "disables dictionary encoding.");
+
+// Max length of string min/max statistics.  Longer values are not recorded so a few
+// long strings can't bloat the file metadata.
+static const int MAX_STRING_STATISTICS_LEN = 64;
+
 // Class that encapsulates all the state for writing a single column.  This contains 
 // all the buffered pages as well as the metadata (e.g. byte sizes, num values, etc).
 // This is intended to be created once per writer per column and reused across
@@ -48,6 +63,11 @@ using namespace apache::thrift;
 // decide to buffer a few pages for better HDFS write performance).
 // Pages are reused between flushes.  They are created on demand as necessary and
 // recycled after a flush.  
+// Columns (other than booleans) start out dictionary encoded: each distinct value is
+// stored once in the dictionary page of the column chunk and the data pages contain
+// the RLE encoded dictionary indices.  If the dictionary grows larger than
+// FLAGS_parquet_dictionary_max_size, the column switches to the plain encoding for the
+// rest of the row group.
 // TODO: For codegen, we would codegen the AppendRow() function for each column.
 // This codegen is specific to the column expr (and type) and encoding.  The
 // parent writer object would combine all the generated AppendRow from all 
@@ -61,21 +81,26 @@ class HdfsParquetTableWriter::ColumnWriter {
       codec_(CompressionCodec::SNAPPY),    // Default to snappy compressed
       num_data_pages_(0), current_page_(NULL),
       num_values_(0),
-      total_byte_size_(0) {
+      total_byte_size_(0),
+      dict_index_(0, DictHash(expr->type()), DictEq(expr->type())),
+      dict_encoded_size_(0),
+      dict_page_size_(0) {
+    Reset();
   }
 
-  // Append the row to this column.  This buffers the value into a data page.
-  // Returns the number of bytes added for this row.
-  // TODO: this needs to be batch based, instead of row based for better
-  // performance.  This is a bit trickier to handle the case where only a
-  // partial row batch can be output to the current file because it reaches
-  // the max file size.  Enabling codegen would also solve this problem.
-  int AppendRow(TupleRow* row);
+  // Appends the values of 'num_rows' rows of 'batch', starting at the 'start_idx'th
+  // row, to this column.  If 'row_indices' is not empty, the rows to append are
+  // batch->GetRow(row_indices[i]), otherwise batch->GetRow(i).
+  // Returns the number of bytes added for these rows.
+  int64_t AppendRows(RowBatch* batch, const vector<int32_t>& row_indices,
+      int start_idx, int num_rows);
 
-  // Flushes all buffered data pages to the file.  
+  // Flushes the dictionary page and all buffered data pages to the file.  
   // *file_pos is an output parameter and will be incremented by
-  // the number of bytes needed to write all the data pages for this column.
-  Status Flush(int64_t* file_pos);
+  // the number of bytes needed to write all the pages for this column.
+  // The offsets of the pages and the encodings and statistics of the column chunk
+  // are set in 'metadata'.
+  Status Flush(int64_t* file_pos, ColumnMetaData* metadata);
 
   // Resets all the data accumulated for this column.  Memory can now be reused for
   // the next row group
@@ -84,6 +109,16 @@ class HdfsParquetTableWriter::ColumnWriter {
     current_page_ = NULL;
     num_values_ = 0;
     total_byte_size_ = 0;
+    use_dictionary_ = expr_->type() != TYPE_BOOLEAN &&
+        FLAGS_parquet_dictionary_max_size > 0;
+    dict_index_.clear();
+    dict_values_.clear();
+    dict_indices_.clear();
+    dict_encoded_size_ = 0;
+    dict_page_size_ = 0;
+    has_plain_pages_ = false;
+    has_min_max_ = false;
+    null_count_ = 0;
   }
 
   uint64_t num_values() const { return num_values_; }
@@ -92,6 +127,27 @@ class HdfsParquetTableWriter::ColumnWriter {
  private:
   friend class HdfsParquetTableWriter;
 
+  // Hash and equality functions for the values in the dictionary.
+  struct DictHash {
+    PrimitiveType type;
+    DictHash(PrimitiveType type) : type(type) { }
+    size_t operator()(const void* v) const { return RawValue::GetHashValue(v, type); }
+  };
+  struct DictEq {
+    PrimitiveType type;
+    DictEq(PrimitiveType type) : type(type) { }
+    bool operator()(const void* v1, const void* v2) const {
+      return RawValue::Eq(v1, v2, type);
+    }
+  };
+
+  // Map from dictionary value to its index in the dictionary.
+  typedef boost::unordered_map<const void*, int, DictHash, DictEq> DictIndex;
+
+  // Append the row to this column.  This buffers the value into a data page.
+  // Returns the number of bytes added for this row.
+  int AppendRow(TupleRow* row);
+
   // Computes final byte size of the current page.  This includes figuring out
   // how many bytes the definition/repetition bits take and the header byte size.
   // Returns the on disk size of the finalized page.
@@ -107,6 +163,33 @@ class HdfsParquetTableWriter::ColumnWriter {
   // TODO: this would benefit quite a bit from codegen.
   int EncodePlain(void* value) const;
 
+  // Returns the number of bytes non-bool 'value' takes in the plain encoding.
+  int PlainEncodedLen(const void* value) const;
+
+  // Writes non-bool 'value' in the plain encoding to 'buffer', which must have
+  // PlainEncodedLen(value) bytes.
+  void WritePlain(const void* value, uint8_t* buffer) const;
+
+  // Adds value to the dictionary if it is not there yet and buffers its index for the
+  // current page.  Returns false if the current page does not have enough room left.
+  // The value is added to the dictionary in either case.
+  bool EncodeDict(void* value);
+
+  // Number of bits of the dictionary indices.
+  int DictBitWidth() const {
+    return std::max(1, BitUtil::NumRequiredBits(dict_values_.size() - 1));
+  }
+
+  // Writes the dictionary page to the file.
+  Status WriteDictPage(int64_t* file_pos);
+
+  // Updates the min/max statistics with non-NULL 'value'.
+  void UpdateStatistics(const void* value);
+
+  // Returns the encoding of the min/max statistics 'value'.  This is the plain encoding
+  // of the value, except that strings don't have a length prefix.
+  string EncodeStatistic(const void* value) const;
+
   struct DataPage {
     // Page header.  This is a union of all page types.  
     PageHeader header;
@@ -124,7 +207,8 @@ class HdfsParquetTableWriter::ColumnWriter {
       
     // Data for buffered values.  For non-bool columns, this is where the output
     // is accumulated.  For bool columns, this is a ptr into bool_values (no
-    // memory is allocated for it).
+    // memory is allocated for it).  Dictionary encoded pages buffer their indices
+    // in dict_indices_ and encode them here when the page is finalized.
     uint8_t* values_buffer;
 
     // This is the payload for the data page.  This includes the definition/repetition
@@ -152,7 +236,56 @@ class HdfsParquetTableWriter::ColumnWriter {
   DataPage* current_page_;
   int64_t num_values_; // Total number of values across all pages, including NULLs.
   int64_t total_byte_size_;
+
+  // If true, new values are dictionary encoded.  Once this is false, it stays false
+  // for the rest of the row group.
+  bool use_dictionary_;
+
+  // True if some data pages of the current row group are plain encoded.
+  bool has_plain_pages_;
+
+  // Dictionary of the current row group.  The values are copies (allocated from the
+  // parent's per_file_mem_pool_) in order of their index.
+  DictIndex dict_index_;
+  vector<const void*> dict_values_;
+
+  // Dictionary indices of the values of the current page.
+  vector<uint32_t> dict_indices_;
+
+  // Total size of the dictionary values in the plain encoding.
+  int64_t dict_encoded_size_;
+
+  // On disk size of the dictionary page, including its header.  Set in Flush().
+  int64_t dict_page_size_;
+
+  // Statistics of the current row group.  min_value_/max_value_ point to
+  // min_buffer_/max_buffer_, which are large enough for any slot type.  The data of
+  // string values is in min_str_/max_str_.
+  bool has_min_max_;
+  int64_t null_count_;
+  void* min_value_;
+  void* max_value_;
+  int64_t min_buffer_[2];
+  int64_t max_buffer_[2];
+  string min_str_;
+  string max_str_;
 };
+
+inline int64_t HdfsParquetTableWriter::ColumnWriter::AppendRows(RowBatch* batch,
+    const vector<int32_t>& row_indices, int start_idx, int num_rows) {
+  int64_t bytes_added = 0;
+  int end_idx = start_idx + num_rows;
+  if (row_indices.empty()) {
+    for (int i = start_idx; i < end_idx; ++i) {
+      bytes_added += AppendRow(batch->GetRow(i));
+    }
+  } else {
+    for (int i = start_idx; i < end_idx; ++i) {
+      bytes_added += AppendRow(batch->GetRow(row_indices[i]));
+    }
+  }
+  return bytes_added;
+}
   
 inline int HdfsParquetTableWriter::ColumnWriter::AppendRow(TupleRow* row) {
   int bytes_added = 0;
@@ -160,6 +293,7 @@ inline int HdfsParquetTableWriter::ColumnWriter::AppendRow(TupleRow* row) {
   void* value = expr_->GetValue(row);
   if (current_page_ == NULL) NewPage();
   int encoded_len = 0;
+  int64_t dict_encoded_size = dict_encoded_size_;
 
   // We might need to try again if this current page is not big enough
   while (true) {
@@ -173,8 +307,12 @@ inline int HdfsParquetTableWriter::ColumnWriter::AppendRow(TupleRow* row) {
     // Nulls don't get encoded. 
     if (value == NULL) break;
 
-    // TODO: support other encoding types.  Currently this only does PLAIN.
-    encoded_len = EncodePlain(value);
+    if (use_dictionary_) {
+      // The size of the indices is only known when the page is finalized.
+      encoded_len = EncodeDict(value) ? 0 : -1;
+    } else {
+      encoded_len = EncodePlain(value);
+    }
     // len < 0 indicates the data does not fit in the current data page, make
     // a new page and try again.
     if (encoded_len < 0) {
@@ -192,65 +330,214 @@ inline int HdfsParquetTableWriter::ColumnWriter::AppendRow(TupleRow* row) {
   bytes_added += encoded_len;
   ++current_page_->header.data_page_header.num_values;
   current_page_->header.uncompressed_page_size += encoded_len;
+
+  if (value == NULL) {
+    ++null_count_;
+  } else {
+    UpdateStatistics(value);
+  }
+
+  if (use_dictionary_) {
+    // New dictionary values are written to the dictionary page.
+    bytes_added += dict_encoded_size_ - dict_encoded_size;
+    if (dict_encoded_size_ > FLAGS_parquet_dictionary_max_size) {
+      // Too many distinct values for the dictionary to pay off.  The values encoded so
+      // far stay in the dictionary, new pages are plain encoded.
+      bytes_added += FinalizeCurrentPage();
+      use_dictionary_ = false;
+      NewPage();
+    }
+  }
   return bytes_added;
 }
-  
-inline int HdfsParquetTableWriter::ColumnWriter::EncodePlain(void* value) const {
-  int32_t int_val;
-  int len = 4;
-  void* ptr = &int_val;
-  uint8_t* dst_ptr = 
-      current_page_->values_buffer + current_page_->header.uncompressed_page_size;
-  
-  // Special case bool and string
+
+inline int HdfsParquetTableWriter::ColumnWriter::PlainEncodedLen(
+    const void* value) const {
   switch (expr_->type()) {
-    case TYPE_BOOLEAN:
-      if (!current_page_->bool_values->Put(*reinterpret_cast<bool*>(value))) {
-        return -1;
-      }
-      return 0;
-    case TYPE_STRING: {
-      StringValue* sv = reinterpret_cast<StringValue*>(value);
-      len = sv->len + sizeof(uint32_t);
-      if (current_page_->header.uncompressed_page_size + len > DATA_PAGE_SIZE) {
-        return -1;
-      }
-      uint32_t str_len = sv->len;
-      memcpy(dst_ptr, &str_len, sizeof(uint32_t));
-      dst_ptr += sizeof(uint32_t);
-      memcpy(dst_ptr, sv->ptr, sv->len);
-      return len;
-    }
+    case TYPE_STRING:
+      return reinterpret_cast<const StringValue*>(value)->len + sizeof(uint32_t);
     case TYPE_TIMESTAMP:
-      ptr = value;
-      len = 12;
-      break;
+      return 12;
     case TYPE_TINYINT:
-      int_val = *reinterpret_cast<uint8_t*>(value);
-      break;
     case TYPE_SMALLINT:
-      int_val = *reinterpret_cast<uint16_t*>(value);
-      break;
-    case TYPE_FLOAT:
     case TYPE_INT:
-      ptr = value;
-      break;
-    case TYPE_DOUBLE:
+    case TYPE_FLOAT:
+      return 4;
     case TYPE_BIGINT:
-      ptr = value;
-      len = 8;
-      break;
+    case TYPE_DOUBLE:
+      return 8;
     default:
       DCHECK(0);
+      return 0;
   }
+}
+
+inline void HdfsParquetTableWriter::ColumnWriter::WritePlain(const void* value,
+    uint8_t* buffer) const {
+  int32_t int_val;
+  switch (expr_->type()) {
+    case TYPE_STRING: {
+      const StringValue* sv = reinterpret_cast<const StringValue*>(value);
+      uint32_t str_len = sv->len;
+      memcpy(buffer, &str_len, sizeof(uint32_t));
+      memcpy(buffer + sizeof(uint32_t), sv->ptr, sv->len);
+      return;
+    }
+    case TYPE_TINYINT:
+      int_val = *reinterpret_cast<const int8_t*>(value);
+      memcpy(buffer, &int_val, sizeof(int32_t));
+      return;
+    case TYPE_SMALLINT:
+      int_val = *reinterpret_cast<const int16_t*>(value);
+      memcpy(buffer, &int_val, sizeof(int32_t));
+      return;
+    default:
+      memcpy(buffer, value, PlainEncodedLen(value));
+  }
+}
   
+inline int HdfsParquetTableWriter::ColumnWriter::EncodePlain(void* value) const {
+  if (expr_->type() == TYPE_BOOLEAN) {
+    // Bools are bit packed, their size is computed when the page is finalized.
+    if (!current_page_->bool_values->Put(*reinterpret_cast<bool*>(value))) return -1;
+    return 0;
+  }
+  int len = PlainEncodedLen(value);
   if (current_page_->header.uncompressed_page_size + len > DATA_PAGE_SIZE) return -1;
-  memcpy(dst_ptr, ptr, len);
+  WritePlain(value,
+      current_page_->values_buffer + current_page_->header.uncompressed_page_size);
   return len;
 }
+
+inline bool HdfsParquetTableWriter::ColumnWriter::EncodeDict(void* value) {
+  DictIndex::iterator it = dict_index_.find(value);
+  int index;
+  if (it != dict_index_.end()) {
+    index = it->second;
+  } else {
+    // Copy the value, the dictionary outlives the row batch.
+    PrimitiveType type = expr_->type();
+    void* copy = parent_->per_file_mem_pool_->Allocate(GetByteSize(type));
+    RawValue::Write(value, copy, type, parent_->per_file_mem_pool_.get());
+    index = dict_values_.size();
+    dict_values_.push_back(copy);
+    dict_index_[copy] = index;
+    dict_encoded_size_ += PlainEncodedLen(value);
+  }
+
+  // The page holds the bit width byte and the encoded indices.  Since the bit width
+  // can only grow, the bound holds for all the indices of the page.
+  if (RleEncoder::MaxBufferSize(DictBitWidth(), dict_indices_.size() + 1) + 1 >
+      DATA_PAGE_SIZE) {
+    return false;
+  }
+  dict_indices_.push_back(index);
+  return true;
+}
+
+inline void HdfsParquetTableWriter::ColumnWriter::UpdateStatistics(const void* value) {
+  PrimitiveType type = expr_->type();
+  // NaNs are not ordered, leave them out of the min/max.
+  if (type == TYPE_FLOAT && math::isnan(*reinterpret_cast<const float*>(value))) return;
+  if (type == TYPE_DOUBLE && math::isnan(*reinterpret_cast<const double*>(value))) return;
+  bool new_min = !has_min_max_ || RawValue::Compare(value, min_value_, type) < 0;
+  bool new_max = !has_min_max_ || RawValue::Compare(value, max_value_, type) > 0;
+  if (!new_min && !new_max) return;
+  has_min_max_ = true;
+  min_value_ = min_buffer_;
+  max_value_ = max_buffer_;
+  if (type == TYPE_STRING) {
+    // Copy the bytes, the row batch is reused.
+    const StringValue* sv = reinterpret_cast<const StringValue*>(value);
+    if (new_min) {
+      min_str_.assign(sv->ptr, sv->len);
+      *reinterpret_cast<StringValue*>(min_value_) =
+          StringValue(const_cast<char*>(min_str_.data()), min_str_.size());
+    }
+    if (new_max) {
+      max_str_.assign(sv->ptr, sv->len);
+      *reinterpret_cast<StringValue*>(max_value_) =
+          StringValue(const_cast<char*>(max_str_.data()), max_str_.size());
+    }
+  } else {
+    if (new_min) memcpy(min_value_, value, GetByteSize(type));
+    if (new_max) memcpy(max_value_, value, GetByteSize(type));
+  }
+}
+
+string HdfsParquetTableWriter::ColumnWriter::EncodeStatistic(const void* value) const {
+  switch (expr_->type()) {
+    case TYPE_BOOLEAN:
+      return string(1, *reinterpret_cast<const bool*>(value));
+    case TYPE_STRING: {
+      const StringValue* sv = reinterpret_cast<const StringValue*>(value);
+      return string(sv->ptr, sv->len);
+    }
+    default: {
+      string result(PlainEncodedLen(value), '\0');
+      WritePlain(value, reinterpret_cast<uint8_t*>(&result[0]));
+      return result;
+    }
+  }
+}
+
+Status HdfsParquetTableWriter::ColumnWriter::WriteDictPage(int64_t* file_pos) {
+  DCHECK(!dict_values_.empty());
+  PageHeader header;
+  header.type = PageType::DICTIONARY_PAGE;
+  header.uncompressed_page_size = dict_encoded_size_;
+  DictionaryPageHeader dict_header;
+  dict_header.num_values = dict_values_.size();
+  header.__set_dictionary_page_header(dict_header);
+
+  uint8_t* uncompressed_data;
+  if (codec_ == CompressionCodec::UNCOMPRESSED) {
+    uncompressed_data = parent_->per_file_mem_pool_->Allocate(dict_encoded_size_);
+  } else {
+    parent_->compression_staging_buffer_.resize(dict_encoded_size_);
+    uncompressed_data = &parent_->compression_staging_buffer_[0];
+  }
+  uint8_t* dst = uncompressed_data;
+  for (int i = 0; i < dict_values_.size(); ++i) {
+    WritePlain(dict_values_[i], dst);
+    dst += PlainEncodedLen(dict_values_[i]);
+  }
+  DCHECK_EQ(dst - uncompressed_data, dict_encoded_size_);
+
+  uint8_t* data = uncompressed_data;
+  if (codec_ != CompressionCodec::UNCOMPRESSED) {
+    DCHECK_EQ(codec_, CompressionCodec::SNAPPY);
+    data = parent_->per_file_mem_pool_->Allocate(
+        snappy::MaxCompressedLength(dict_encoded_size_));
+    size_t compressed_size;
+    snappy::RawCompress(reinterpret_cast<char*>(uncompressed_data), dict_encoded_size_,
+        reinterpret_cast<char*>(data), &compressed_size);
+    header.compressed_page_size = compressed_size;
+  } else {
+    header.compressed_page_size = dict_encoded_size_;
+  }
+
+  uint8_t* buffer;
+  uint32_t len;
+  RETURN_IF_ERROR(parent_->thrift_serializer_->Serialize(&header, &len, &buffer));
+  RETURN_IF_ERROR(parent_->Write(buffer, len));
+  RETURN_IF_ERROR(parent_->Write(data, header.compressed_page_size));
+  dict_page_size_ = len + header.compressed_page_size;
+  *file_pos += dict_page_size_;
+  return Status::OK;
+}
   
-Status HdfsParquetTableWriter::ColumnWriter::Flush(int64_t* file_pos) {
-  FinalizeCurrentPage();
+Status HdfsParquetTableWriter::ColumnWriter::Flush(int64_t* file_pos,
+    ColumnMetaData* metadata) {
+  if (current_page_ != NULL) FinalizeCurrentPage();
+
+  // The dictionary page goes first so it can be read before the data pages.
+  if (!dict_values_.empty()) {
+    metadata->__set_dictionary_page_offset(*file_pos);
+    RETURN_IF_ERROR(WriteDictPage(file_pos));
+    total_byte_size_ += dict_page_size_;
+  }
+  metadata->data_page_offset = *file_pos;
 
   for (int i = 0; i < num_data_pages_; ++i) {
     DataPage& page = pages_[i];
@@ -274,12 +561,41 @@ Status HdfsParquetTableWriter::ColumnWriter::Flush(int64_t* file_pos) {
     RETURN_IF_ERROR(parent_->Write(page.data, page.header.compressed_page_size));
     *file_pos += page.header.compressed_page_size;
   }
+
+  metadata->encodings.clear();
+  if (!dict_values_.empty()) metadata->encodings.push_back(Encoding::PLAIN_DICTIONARY);
+  if (has_plain_pages_) metadata->encodings.push_back(Encoding::PLAIN);
+  // Definition levels
+  metadata->encodings.push_back(Encoding::RLE);
+
+  Statistics stats;
+  stats.__set_null_count(null_count_);
+  if (has_min_max_ && (expr_->type() != TYPE_STRING ||
+      (min_str_.size() <= MAX_STRING_STATISTICS_LEN &&
+       max_str_.size() <= MAX_STRING_STATISTICS_LEN))) {
+    stats.__set_min(EncodeStatistic(min_value_));
+    stats.__set_max(EncodeStatistic(max_value_));
+  }
+  metadata->__set_statistics(stats);
   return Status::OK;
 }
   
 int64_t HdfsParquetTableWriter::ColumnWriter::FinalizeCurrentPage() {
   DCHECK(current_page_ != NULL);
   if (current_page_->finalized) return 0;
+  if (current_page_->header.data_page_header.num_values == 0) {
+    // Nothing to write, Flush() skips the page.
+    current_page_->finalized = true;
+    return 0;
+  }
+
+  DataPageHeader& data_page_header = current_page_->header.data_page_header;
+  if (data_page_header.encoding == Encoding::PLAIN_DICTIONARY &&
+      dict_indices_.empty()) {
+    // The page only has NULLs, which don't need a dictionary.
+    data_page_header.encoding = Encoding::PLAIN;
+  }
+  if (data_page_header.encoding == Encoding::PLAIN) has_plain_pages_ = true;
 
   int64_t bytes_added = 0;
   if (expr_->type() == TYPE_BOOLEAN) {
@@ -288,6 +604,19 @@ int64_t HdfsParquetTableWriter::ColumnWriter::FinalizeCurrentPage() {
     int num_bytes = BitUtil::Ceil(num_bools, 8);
     current_page_->header.uncompressed_page_size += num_bytes;
     bytes_added += num_bytes;
+  } else if (data_page_header.encoding == Encoding::PLAIN_DICTIONARY) {
+    // Encode the indices with the final bit width, preceded by the bit width.
+    int bit_width = DictBitWidth();
+    current_page_->values_buffer[0] = bit_width;
+    RleEncoder encoder(current_page_->values_buffer + 1, DATA_PAGE_SIZE - 1, bit_width);
+    for (int i = 0; i < dict_indices_.size(); ++i) {
+      bool ret = encoder.Put(dict_indices_[i]);
+      DCHECK(ret);
+    }
+    int num_bytes = 1 + encoder.Flush();
+    dict_indices_.clear();
+    current_page_->header.uncompressed_page_size += num_bytes;
+    bytes_added += num_bytes;
   }
     
   // Compute size of definition bits
@@ -364,7 +693,6 @@ void HdfsParquetTableWriter::ColumnWriter::NewPage() {
 
     DataPageHeader header;
     header.num_values = 0;
-    header.encoding = Encoding::PLAIN;
     header.definition_level_encoding = Encoding::RLE;
     header.repetition_level_encoding = Encoding::BIT_PACKED;
     current_page_->def_levels = parent_->state_->obj_pool()->Add(
@@ -382,6 +710,8 @@ void HdfsParquetTableWriter::ColumnWriter::NewPage() {
     }
     current_page_->header.__set_data_page_header(header);
   }
+  current_page_->header.data_page_header.encoding =
+      use_dictionary_ ? Encoding::PLAIN_DICTIONARY : Encoding::PLAIN;
   current_page_->finalized = false;
 }
 
@@ -393,6 +723,8 @@ HdfsParquetTableWriter::HdfsParquetTableWriter(HdfsTableSink* parent, RuntimeSta
       current_row_group_(NULL),
       row_count_(0),
       file_size_limit_(0),
+      row_group_size_estimate_(0),
+      bytes_appended_(0),
       reusable_col_mem_pool_(new MemPool),
       row_idx_(0) {
 }
@@ -443,7 +775,6 @@ Status HdfsParquetTableWriter::AddRowGroup() {
   for (int i = 0; i < columns_.size(); ++i) {
     ColumnMetaData metadata;
     metadata.type = IMPALA_TO_PARQUET_TYPES[columns_[i]->expr_->type()];
-    metadata.encodings.push_back(Encoding::PLAIN);
     metadata.path_in_schema.push_back(table_desc_->col_names()[i + num_clustering_cols]);
     metadata.codec = columns_[i]->codec_;
     current_row_group_->columns[i].__set_meta_data(metadata);
@@ -489,6 +820,8 @@ Status HdfsParquetTableWriter::InitNewFile() {
   file_pos_ = 0;
   row_count_ = 0;
   file_size_estimate_ = 0;
+  row_group_size_estimate_ = 0;
+  bytes_appended_ = 0;
   
   file_metadata_.row_groups.clear();
   RETURN_IF_ERROR(AddRowGroup());
@@ -497,6 +830,15 @@ Status HdfsParquetTableWriter::InitNewFile() {
   return Status::OK;
 }
 
+int64_t HdfsParquetTableWriter::NumRowsToAppend() const {
+  // Start with a single row to get an estimate of the row size.
+  if (row_count_ == 0) return 1;
+  int64_t bytes_per_row = max(bytes_appended_ / row_count_, 1L);
+  // Stay well short of the limit in case the next rows are bigger than average.  The
+  // chunks shrink to a single row as the file fills up.
+  return max((file_size_limit_ - file_size_estimate_) / (2 * bytes_per_row), 1L);
+}
+
 Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
                                              const vector<int32_t>& row_group_indices,
                                              bool* new_file) {
@@ -509,22 +851,31 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
     limit = row_group_indices.size();
   }
       
-  bool all_rows = row_group_indices.empty();
-  for (; row_idx_ < limit;) {
-    TupleRow* current_row = all_rows ?
-        batch->GetRow(row_idx_) : batch->GetRow(row_group_indices[row_idx_]);
+  // The rows are appended a column at a time, in chunks that are small enough to not
+  // go much over the file size limit.
+  while (row_idx_ < limit) {
+    int num_rows = min(static_cast<int64_t>(limit - row_idx_), NumRowsToAppend());
+    int64_t bytes_added = 0;
     for (int j = 0; j < columns_.size(); ++j) {
-      file_size_estimate_ += columns_[j]->AppendRow(current_row);
+      bytes_added +=
+          columns_[j]->AppendRows(batch, row_group_indices, row_idx_, num_rows);
     }
-    ++row_idx_;
-    ++row_count_;
-    ++output_->num_rows;
+    file_size_estimate_ += bytes_added;
+    row_group_size_estimate_ += bytes_added;
+    bytes_appended_ += bytes_added;
+    row_idx_ += num_rows;
+    row_count_ += num_rows;
+    output_->num_rows += num_rows;
       
     if (file_size_estimate_ > file_size_limit_) {
       // This file is full.  We need a new file.
       *new_file = true;
       return Status::OK;
     }
+    if (row_group_size_estimate_ > FLAGS_parquet_row_group_size) {
+      SCOPED_TIMER(parent_->hdfs_write_timer());
+      RETURN_IF_ERROR(AddRowGroup());
+    }
   }
 
   // Reset the row_idx_ when we exhaust the batch.  We can exit before exhausting 
@@ -564,10 +915,9 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
   if (current_row_group_ == NULL) return Status::OK;
   
   for (int i = 0; i < columns_.size(); ++i) {
-    current_row_group_->columns[i].meta_data.data_page_offset = file_pos_;
-
     // Flush this column.  This updates the final metadata sizes for this column.
-    RETURN_IF_ERROR(columns_[i]->Flush(&file_pos_));
+    RETURN_IF_ERROR(
+        columns_[i]->Flush(&file_pos_, &current_row_group_->columns[i].meta_data));
 
     current_row_group_->columns[i].meta_data.num_values = columns_[i]->num_values();
 
@@ -598,6 +948,10 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
   }
   
   current_row_group_ = NULL;
+  // The buffered data is written, all that is left of it is its compressed size.
+  file_size_estimate_ = file_pos_;
+  row_group_size_estimate_ = 0;
+  per_file_mem_pool_->Clear();
   return Status::OK;
 }
 
@@ -36,10 +36,12 @@ class TupleRow;
 
 // The writer consumes all rows passed to it and writes the evaluated output_exprs
 // as a parquet file in hdfs.
+// Column chunks are dictionary encoded while their dictionary stays small enough and
+// plain encoded otherwise.  Files are split into row groups of about
+// FLAGS_parquet_row_group_size bytes, each column chunk has min/max/null count
+// statistics.
 // TODO: (parts of the format that are not implemented)
 // - group var encoding
-// - compression
-// - multiple row groups per file
 // TODO: we need a mechanism to pass the equivalent of serde params to this class
 // from the FE.  This includes:
 // - compression & codec
@@ -75,9 +77,6 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // Default data page size.  In bytes.
   static const int DATA_PAGE_SIZE = 64 * 1024;
 
-  // Default row group size.  In bytes.
-  static const int ROW_GROUP_SIZE = 1024 * 1024 * 1024;
-
   // Default hdfs block size.  In Bytes.
   static const int HDFS_BLOCK_SIZE = 1024 * 1024 * 1024;
 
@@ -107,6 +106,10 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // new row group.  current_row_group_ will be flushed.
   Status AddRowGroup();
 
+  // Returns the number of rows that can be appended before file_size_limit_ needs to
+  // be checked again, based on the average row size so far.
+  int64_t NumRowsToAppend() const;
+
   // Thrift serializer utility object.  Reusing this object allows for
   // fewer memory allocations.
   boost::scoped_ptr<ThriftSerializer> thrift_serializer_;
@@ -131,6 +134,13 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // Limit on the total size of the file.
   int64_t file_size_limit_;
 
+  // Estimate of the size of the current row group.  If this is greater than
+  // FLAGS_parquet_row_group_size, the row group is flushed and a new one started.
+  int64_t row_group_size_estimate_;
+
+  // Number of (uncompressed) bytes appended to the current file.
+  int64_t bytes_appended_;
+
   // The file location in the current output file.  This is the number of bytes
   // that have been written to the file so far.  The metadata uses file offsets
   // in a few places.
@@ -140,8 +150,8 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // writer (i.e. reused across files).
   boost::scoped_ptr<MemPool> reusable_col_mem_pool_;
 
-  // Memory for column/block buffers that is allocated per file.  We need to
-  // reset this pool after flushing a file.
+  // Memory for column/block buffers and dictionaries that is allocated per row group.
+  // It is cleared after flushing a row group and freed after flushing a file.
   boost::scoped_ptr<MemPool> per_file_mem_pool_;
 
   // Current position in the batch being written.  This must be persistent across
@@ -477,7 +477,8 @@ Status HdfsRCFileScanner::ProcessRange() {
       continue;
     }
 
-    int num_to_commit = 0;
+    Tuple* first_tuple = tuple;
+    TupleRow* first_row = current_row;
     for (int i = 0; i < max_tuples; ++i) {
       RETURN_IF_ERROR(NextRow());
 
@@ -518,14 +519,11 @@ Status HdfsRCFileScanner::ProcessRange() {
       }
 
       current_row->SetTuple(scan_node_->tuple_idx(), tuple);
-      // Evaluate the conjuncts and add the row to the batch
-      if (ExecNode::EvalConjuncts(conjuncts_, num_conjuncts_, current_row)) {
-        ++num_to_commit;
-        current_row = context_->next_row(current_row);
-        tuple = context_->next_tuple(tuple);
-      }
+      current_row = context_->next_row(current_row);
+      tuple = context_->next_tuple(tuple);
     }
-    context_->CommitRows(num_to_commit);
+    // Evaluate the conjuncts and add the rows that passed to the batch
+    context_->CommitRows(EvalConjunctsBatch(first_tuple, first_row, max_tuples));
     COUNTER_UPDATE(scan_node_->rows_read_counter(), max_tuples);
     if (scan_node_->ReachedLimit()) break;
     if (context_->cancelled()) return Status::CANCELLED;
@@ -21,6 +21,7 @@
 #include "exec/hdfs-avro-scanner.h"
 #include "exec/hdfs-parquet-scanner.h"
 #include "exec/hdfs-hfile-scanner.h"
+#include "exec/runtime-filter.h"
 #include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
@@ -66,6 +67,7 @@ HdfsScanNode::HdfsScanNode(ObjectPool* pool, const TPlanNode& tnode,
       tuple_id_(tnode.hdfs_scan_node.tuple_id),
       compact_data_(tnode.compact_data),
       reader_context_(NULL),
+      thread_resource_pool_(NULL),
       tuple_desc_(NULL),
       unknown_disk_id_warned_(false),
       tuple_pool_(new MemPool()),
@@ -81,6 +83,12 @@ HdfsScanNode::HdfsScanNode(ObjectPool* pool, const TPlanNode& tnode,
       num_blocked_scanners_(0),
       partition_key_pool_(new MemPool()),
       counters_reported_(false),
+      num_runtime_filters_(0),
+      row_groups_filtered_counter_(NULL),
+      hfile_index_entries_skipped_counter_(NULL),
+      hfile_files_skipped_counter_(NULL),
+      hfile_block_cache_hits_counter_(NULL),
+      hfile_block_cache_misses_counter_(NULL),
       disks_accessed_bitmap_(TCounterType::UNIT, 0) {
   max_materialized_row_batches_ = FLAGS_max_row_batches;
   if (max_materialized_row_batches_ <= 0) {
@@ -192,6 +200,7 @@ Status HdfsScanNode::SetScanRanges(const vector<TScanRangeParams>& scan_range_pa
       desc = runtime_state_->obj_pool()->Add(new HdfsFileDesc(path));
       per_file_splits_[path] = desc;
       desc->file_length = split.file_length;
+      if (split.__isset.mtime) desc->mtime = split.mtime;
     } else {
       desc = desc_it->second;
     }
@@ -342,11 +351,22 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
   tuple_desc_ = state->desc_tbl().GetTupleDescriptor(tuple_id_);
   DCHECK(tuple_desc_ != NULL);
 
+  row_groups_filtered_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowGroupsRejectedByFilter", TCounterType::UNIT);
+  hfile_index_entries_skipped_counter_ =
+      ADD_COUNTER(runtime_profile(), "HFileIndexEntriesSkipped", TCounterType::UNIT);
+  hfile_files_skipped_counter_ =
+      ADD_COUNTER(runtime_profile(), "HFileFilesSkipped", TCounterType::UNIT);
+  hfile_block_cache_hits_counter_ =
+      ADD_COUNTER(runtime_profile(), "HFileBlockCacheHits", TCounterType::UNIT);
+  hfile_block_cache_misses_counter_ =
+      ADD_COUNTER(runtime_profile(), "HFileBlockCacheMisses", TCounterType::UNIT);
+
   // One-time initialisation of state that is constant across scan ranges
   DCHECK(tuple_desc_->table_desc() != NULL);
   hdfs_table_ = static_cast<const HdfsTableDescriptor*>(tuple_desc_->table_desc());
-  tuple_pool_->set_limits(*state->mem_limits());
-  partition_key_pool_->set_limits(*state->mem_limits());
+  tuple_pool_->set_limits(mem_trackers_);
+  partition_key_pool_->set_limits(mem_trackers_);
   compact_data_ |= tuple_desc_->string_slots().empty();
 
   // Create mapping from column index in table to slot index in output tuple.
@@ -391,12 +411,17 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
     return Status(ss.str());
   } 
 
+  // The scanner threads get their own share of the fragment's threads, separate from
+  // other scan nodes and the hash join build sides of the fragment.
+  thread_resource_pool_ = state->exec_env()->thread_mgr()->RegisterPool(
+      ThreadResourceMgr::SCANNER_POOL_WEIGHT, state->resource_pool());
+
   // Codegen scanner specific functions
   if (state->llvm_codegen() != NULL) {
     // If the codegen'd conjuncts are not thread safe, we will need to make copies of 
     // the exprs and codegen those as well.
     if (!codegend_conjuncts_thread_safe_) {
-      int num_copies = state->resource_pool()->num_available_threads();
+      int num_copies = thread_resource_pool_->num_available_threads();
       for (int i = 0; i < num_copies; ++i) {
         vector<Expr*> conjuncts_copy_text;
         RETURN_IF_ERROR(CreateConjuncts(&conjuncts_copy_text, false));
@@ -459,8 +484,8 @@ Status HdfsScanNode::Open(RuntimeState* state) {
   }
 
   RETURN_IF_ERROR(runtime_state_->io_mgr()->RegisterReader(
-      hdfs_connection_, runtime_state_->resource_pool(),
-      &reader_context_, state->fragment_mem_limit()));
+      hdfs_connection_, thread_resource_pool_,
+      &reader_context_, mem_tracker()));
   runtime_state_->io_mgr()->set_bytes_read_counter(reader_context_, bytes_read_counter());
   runtime_state_->io_mgr()->set_read_timer(reader_context_, read_timer());
   runtime_state_->io_mgr()->set_active_read_thread_counter(reader_context_,
@@ -596,6 +621,10 @@ Status HdfsScanNode::Close(RuntimeState* state) {
   if (reader_context_ != NULL) {
     runtime_state_->io_mgr()->UnregisterReader(reader_context_);
   }
+  if (thread_resource_pool_ != NULL) {
+    runtime_state_->exec_env()->thread_mgr()->UnregisterPool(thread_resource_pool_);
+    thread_resource_pool_ = NULL;
+  }
 
   // There should be no active scanner threads and hdfs read threads.
   DCHECK_EQ(active_scanner_thread_counter_.value(), 0);
@@ -693,7 +722,7 @@ void HdfsScanNode::DiskThread() {
       // thread (active_scanners_) created.  We don't want to actively be starting new
       // scanner threads if possible. 
       DCHECK_LE(num_blocked_scanners_, active_scanners_.size());
-      int num_started_ranges = runtime_state_->resource_pool()->num_optional_threads();
+      int num_started_ranges = thread_resource_pool_->num_optional_threads();
       while (num_blocked_scanners_ == 0 &&
              num_queued_io_buffers_ >= max_queued_io_buffers_ &&
              num_started_ranges == active_scanners_.size() &&
@@ -789,6 +818,27 @@ void HdfsScanNode::AddMaterializedRowBatch(RowBatch* row_batch) {
   row_batch_added_cv_.notify_one();
 }
 
+void HdfsScanNode::AddRuntimeFilter(RuntimeFilter* filter) {
+  DCHECK_EQ(filter->slot()->parent(), tuple_id_);
+  stringstream ss;
+  ss << "RowsRejectedByFilter(join node=" << filter->join_node_id()
+     << ", slot=" << filter->slot()->id() << ")";
+  filter->set_rows_rejected_counter(
+      ADD_COUNTER(runtime_profile(), ss.str(), TCounterType::UNIT));
+  VLOG_FILE << "Scan node (id=" << id() << ") added " << filter->DebugString();
+
+  unique_lock<mutex> l(runtime_filters_lock_);
+  runtime_filters_.push_back(filter);
+  __sync_synchronize();
+  ++num_runtime_filters_;
+}
+
+void HdfsScanNode::GetRuntimeFilters(vector<RuntimeFilter*>* filters) {
+  if (LIKELY(static_cast<int>(filters->size()) == num_runtime_filters_)) return;
+  unique_lock<mutex> l(runtime_filters_lock_);
+  *filters = runtime_filters_;
+}
+
 void HdfsScanNode::ScannerThread(HdfsScanner* scanner, ScannerContext* context) {
   // Call into the scanner to process the range.  From the scanner's perspective,
   // everything is single threaded.
@@ -801,7 +851,7 @@ void HdfsScanNode::ScannerThread(HdfsScanner* scanner, ScannerContext* context)
     if (context->num_buffers_added() != 0) {
       // This scanner saw at least one io buffer indicating the io mgr reserved
       // a thread for it.  Release that now.
-      runtime_state_->resource_pool()->ReleaseThreadToken(false);
+      thread_resource_pool_->ReleaseThreadToken(false);
     }
   }
 
@@ -43,6 +43,7 @@ namespace impala {
 class DescriptorTbl;
 class HdfsScanner;
 class RowBatch;
+class RuntimeFilter;
 class Status;
 class Tuple;
 class TPlanNode;
@@ -59,9 +60,12 @@ struct HdfsFileDesc {
   // assigned to this node.
   int64_t file_length;
 
+  // Last modification time of the file in ms since the epoch, or 0 if unknown.
+  int64_t mtime;
+
   // Splits (i.e. raw byte ranges) for this file, assigned to this scan node.
   std::vector<DiskIoMgr::ScanRange*> splits;
-  HdfsFileDesc(const std::string& filename) : filename(filename) {}
+  HdfsFileDesc(const std::string& filename) : filename(filename), mtime(0) {}
 };
 
 // Struct to map scan ranges to the ScannerContext/Stream that would be processing it.
@@ -77,8 +81,12 @@ struct ScanRangeMetadata {
   // this is where the buffer should be pushed to.
   ScannerContext::Stream* stream;
 
+  // For parquet footer ranges, the row group of the file that the scanner created for
+  // this range reads.  Each row group is read by a separate scanner.
+  int row_group_idx;
+
   ScanRangeMetadata(int64_t partition_id, ScannerContext::Stream* stream) 
-    : partition_id(partition_id), stream(stream) { }
+    : partition_id(partition_id), stream(stream), row_group_idx(0) { }
 };
 
 
@@ -132,6 +140,9 @@ class HdfsScanNode : public ScanNode {
   // Currently this is always 0.
   int tuple_idx() const { return 0; }
 
+  // Returns the id of the tuple this scan node materializes.
+  TupleId tuple_id() const { return tuple_id_; }
+
   // Returns number of partition keys in the schema, including non-materialized slots
   int num_partition_keys() const { return num_partition_keys_; }
 
@@ -148,6 +159,11 @@ class HdfsScanNode : public ScanNode {
  
   DiskIoMgr::ReaderContext* reader_context() { return reader_context_; }
 
+  // Sub pool of the fragment's thread resource pool for the scanner threads
+  ThreadResourceMgr::ResourcePool* thread_resource_pool() {
+    return thread_resource_pool_;
+  }
+
   // Returns index into materialized_slots with 'col_idx'.  Returns SKIP_COLUMN if
   // that column is not materialized.
   int GetMaterializedSlotIdx(int col_idx) const {
@@ -210,6 +226,44 @@ class HdfsScanNode : public ScanNode {
   // This is thread safe.
   void SetFileMetadata(const std::string& filename, void* metadata);
 
+  // Adds a runtime filter on one of this node's slots (see RuntimeFilter).  Scanners
+  // apply it to all rows they materialize from then on.  The filter is owned by the
+  // caller and must stay valid until this node is closed.  This is thread safe.
+  void AddRuntimeFilter(RuntimeFilter* filter);
+
+  // Replaces 'filters' with the runtime filters added so far, if there are more than
+  // 'filters' contains.  Scanners call this once per batch, so it only takes a lock
+  // when there are new filters.  This is thread safe.
+  void GetRuntimeFilters(std::vector<RuntimeFilter*>* filters);
+
+  // Number of parquet row groups that were skipped because their column statistics
+  // did not overlap with a runtime filter.
+  RuntimeProfile::Counter* row_groups_filtered_counter() {
+    return row_groups_filtered_counter_;
+  }
+
+  // Number of entries of hfile root data indexes whose data blocks were skipped because
+  // their row keys were outside the range allowed by the conjuncts, or did not include
+  // any of the rows the conjuncts allow.
+  RuntimeProfile::Counter* hfile_index_entries_skipped_counter() {
+    return hfile_index_entries_skipped_counter_;
+  }
+
+  // Number of hfiles whose data was not read at all, because their time range is
+  // outside the query's or their bloom filter has none of the rows the conjuncts allow.
+  RuntimeProfile::Counter* hfile_files_skipped_counter() {
+    return hfile_files_skipped_counter_;
+  }
+
+  // Number of hfile data blocks that were found in, or missing from the process-wide
+  // cache of decompressed blocks.  Only updated if the cache is enabled.
+  RuntimeProfile::Counter* hfile_block_cache_hits_counter() {
+    return hfile_block_cache_hits_counter_;
+  }
+  RuntimeProfile::Counter* hfile_block_cache_misses_counter() {
+    return hfile_block_cache_misses_counter_;
+  }
+
   // Called by the scanner when a range is complete.  Used to trigger done_ and
   // to log progress.  This *must* only be called after the scanner has completely
   // finished the scan range (i.e. context->Flush()).
@@ -262,6 +316,10 @@ class HdfsScanNode : public ScanNode {
   // ReaderContext object to use with the disk-io-mgr
   DiskIoMgr::ReaderContext* reader_context_;
 
+  // Registered in Prepare(), unregistered in Close().  The io mgr acquires the
+  // scanner threads' tokens from this pool.
+  ThreadResourceMgr::ResourcePool* thread_resource_pool_;
+
   // Descriptor for tuples this scan node constructs
   const TupleDescriptor* tuple_desc_;
 
@@ -420,6 +478,19 @@ class HdfsScanNode : public ScanNode {
   // If true, counters have already been reported in the runtime profile.
   bool counters_reported_;
 
+  // Runtime filters added with AddRuntimeFilter() and the lock protecting them.
+  // num_runtime_filters_ is only incremented after a filter was added, which lets
+  // GetRuntimeFilters() skip the lock if there are no new filters.
+  boost::mutex runtime_filters_lock_;
+  std::vector<RuntimeFilter*> runtime_filters_;
+  volatile int num_runtime_filters_;
+
+  RuntimeProfile::Counter* row_groups_filtered_counter_;
+  RuntimeProfile::Counter* hfile_index_entries_skipped_counter_;
+  RuntimeProfile::Counter* hfile_files_skipped_counter_;
+  RuntimeProfile::Counter* hfile_block_cache_hits_counter_;
+  RuntimeProfile::Counter* hfile_block_cache_misses_counter_;
+
   // Issue all queued ranges to the io mgr.
   Status IssueQueuedRanges();
 
@@ -23,6 +23,7 @@
 #include "exec/text-converter.h"
 #include "exec/hdfs-scan-node.h"
 #include "exec/read-write-util.h"
+#include "exec/runtime-filter.h"
 #include "exec/text-converter.inline.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
@@ -182,6 +183,64 @@ int HdfsScanner::WriteEmptyTuples(ScannerContext* context,
   return num_tuples;
 }
 
+int HdfsScanner::EvalConjunctsBatch(Tuple* tuple, TupleRow* row, int num_rows) {
+  return FilterRows(tuple, row, num_rows, true);
+}
+
+int HdfsScanner::EvalRuntimeFilters(Tuple* tuple, TupleRow* row, int num_rows) {
+  return FilterRows(tuple, row, num_rows, false);
+}
+
+int HdfsScanner::FilterRows(Tuple* tuple, TupleRow* row, int num_rows,
+    bool eval_conjuncts) {
+  scan_node_->GetRuntimeFilters(&runtime_filters_);
+  if (!eval_conjuncts || num_conjuncts_ == 0) {
+    if (runtime_filters_.empty()) return num_rows;
+    eval_conjuncts = false;
+  }
+  if (num_rows == 0) return 0;
+  if (static_cast<int>(batch_rows_.size()) < num_rows) {
+    batch_rows_.resize(num_rows);
+    batch_sel_.resize(num_rows);
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    batch_rows_[i] = row;
+    batch_sel_[i] = i;
+    row = context_->next_row(row);
+  }
+  int num_selected = num_rows;
+  if (eval_conjuncts) {
+    num_selected = ExecNode::EvalConjuncts(conjuncts_, num_conjuncts_,
+        &batch_rows_[0], &batch_sel_[0], num_rows);
+  }
+
+  // Row i has tuple i.
+  uint8_t* tuple_mem = reinterpret_cast<uint8_t*>(tuple);
+  for (int i = 0; i < runtime_filters_.size() && num_selected > 0; ++i) {
+    const RuntimeFilter* filter = runtime_filters_[i];
+    int num_passed = 0;
+    for (int j = 0; j < num_selected; ++j) {
+      int row_idx = batch_sel_[j];
+      batch_sel_[num_passed] = row_idx;
+      num_passed += filter->Find(
+          reinterpret_cast<Tuple*>(tuple_mem + row_idx * tuple_byte_size_));
+    }
+    COUNTER_UPDATE(filter->rows_rejected_counter(), num_selected - num_passed);
+    num_selected = num_passed;
+  }
+
+  // Since the selection is sorted, the selected tuples only move towards the front.
+  int tuple_idx = scan_node_->tuple_idx();
+  for (int i = 0; i < num_selected; ++i) {
+    int src_idx = batch_sel_[i];
+    if (src_idx == i) continue;
+    Tuple* dst = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size_);
+    memcpy(dst, tuple_mem + src_idx * tuple_byte_size_, tuple_byte_size_);
+    batch_rows_[i]->SetTuple(tuple_idx, dst);
+  }
+  return num_selected;
+}
+
 bool HdfsScanner::WriteCompleteTuple(MemPool* pool, FieldLocation* fields, 
     Tuple* tuple, TupleRow* tuple_row, Tuple* template_tuple,
     uint8_t* error_fields, uint8_t* error_in_row) {
@@ -35,6 +35,7 @@ class HdfsPartitionDescriptor;
 class HdfsScanNode;
 class MemPool;
 class RowBatch;
+class RuntimeFilter;
 class SlotDescriptor;
 class Status;
 class TextConverter;
@@ -147,6 +148,14 @@ class HdfsScanner {
   // Cache of conjuncts_mem_.size()
   int num_conjuncts_;
 
+  // Rows and selection vector for EvalConjunctsBatch()
+  std::vector<TupleRow*> batch_rows_;
+  std::vector<int> batch_sel_;
+
+  // Runtime filters of the scan node, refreshed for each batch (see
+  // HdfsScanNode::GetRuntimeFilters())
+  std::vector<RuntimeFilter*> runtime_filters_;
+
   // Fixed size of each tuple, in bytes
   int tuple_byte_size_;
 
@@ -208,6 +217,20 @@ class HdfsScanner {
   // Write empty tuples and commit them to the context object
   int WriteEmptyTuples(ScannerContext* context, TupleRow* tuple_row, int num_tuples);
 
+  // Evaluates the conjuncts a batch at a time (see Expr::EvalBatch()) and the
+  // runtime filters of the scan node over the 'num_rows' rows that were written, with
+  // one tuple each, to the memory returned by ScannerContext::GetMemory(), starting
+  // at 'tuple' and 'row'.  The rows that passed and their tuples are moved to the
+  // front.  Returns the number of rows that passed, which can then be committed.
+  int EvalConjunctsBatch(Tuple* tuple, TupleRow* row, int num_rows);
+
+  // Same as EvalConjunctsBatch() but only evaluates the runtime filters.  This is used
+  // by scanners whose rows already passed the conjuncts when they were written.
+  int EvalRuntimeFilters(Tuple* tuple, TupleRow* row, int num_rows);
+
+  // Implementation of EvalConjunctsBatch() and EvalRuntimeFilters()
+  int FilterRows(Tuple* tuple, TupleRow* row, int num_rows, bool eval_conjuncts);
+
   // Processes batches of fields and writes them out to tuple_row_mem.
   // - 'pool' mempool to allocate from for auxiliary tuple memory
   // - 'tuple_row_mem' preallocated tuple_row memory this function must use.
@@ -242,6 +242,7 @@ Status HdfsSequenceScanner::ProcessDecompressedBlock() {
   MemPool* pool;
   TupleRow* tuple_row;
   int64_t max_tuples = context_->GetMemory(&pool, &tuple_, &tuple_row);
+  Tuple* first_tuple = tuple_;
   int num_to_process = min(max_tuples, num_buffered_records_in_compressed_block_);
   num_buffered_records_in_compressed_block_ -= num_to_process;
 
@@ -309,6 +310,7 @@ Status HdfsSequenceScanner::ProcessDecompressedBlock() {
   }
 
   if (tuples_returned == -1) return parse_status_;
+  tuples_returned = EvalRuntimeFilters(first_tuple, tuple_row, tuples_returned);
   COUNTER_UPDATE(scan_node_->rows_read_counter(), num_to_process);
   context_->CommitRows(tuples_returned);
   return Status::OK;
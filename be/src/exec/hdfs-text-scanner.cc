@@ -201,6 +201,7 @@ Status HdfsTextScanner::ProcessRange(int* num_tuples, bool past_scan_range) {
     MemPool* pool;
     TupleRow* tuple_row_mem;
     int max_tuples = context_->GetMemory(&pool, &tuple_, &tuple_row_mem);
+    Tuple* first_tuple = tuple_;
     
     if (past_scan_range) {
       // byte_buffer_ptr_ is already set from FinishScanRange()
@@ -237,6 +238,8 @@ Status HdfsTextScanner::ProcessRange(int* num_tuples, bool past_scan_range) {
       num_tuples_materialized = WriteFields(pool, tuple_row_mem, num_fields, *num_tuples);
       DCHECK_GE(num_tuples_materialized, 0);
       RETURN_IF_ERROR(parse_status_);
+      num_tuples_materialized =
+          EvalRuntimeFilters(first_tuple, tuple_row_mem, num_tuples_materialized);
       if (*num_tuples > 0) {
         // If we saw any tuple delimiters, clear the boundary_row_.
         boundary_row_.Clear();
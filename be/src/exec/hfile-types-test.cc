@@ -0,0 +1,355 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "exec/hfile-types.h"
+#include "util/cpu-info.h"
+
+using namespace hfile;
+using namespace impala;
+using namespace std;
+
+namespace impala {
+
+// Appends 'value' to 'buffer' in big endian order, like java.io.DataOutput.
+static void AppendBigEndian(int64_t value, int num_bytes, string* buffer) {
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    buffer->push_back(static_cast<char>(value >> (i * 8)));
+  }
+}
+
+// Returns a serialized KeyValue key for 'row': the row length, the row, an empty
+// family and qualifier, the timestamp and the type.
+static string MakeKey(const string& row) {
+  string key;
+  AppendBigEndian(row.size(), 2, &key);
+  key += row;
+  key.push_back('\0');
+  AppendBigEndian(0, 8, &key);
+  key.push_back('\4');
+  return key;
+}
+
+// Appends a root index entry to 'buffer'.  Keys are shorter than 128 bytes, so their
+// vint length is one byte.
+static void AppendEntry(int64_t offset, int32_t size, const string& key,
+    string* buffer) {
+  AppendBigEndian(offset, 8, buffer);
+  AppendBigEndian(size, 4, buffer);
+  buffer->push_back(static_cast<char>(key.size()));
+  *buffer += key;
+}
+
+static string EncodeInt(int64_t value) {
+  string key;
+  EXPECT_TRUE(RowKeyRange::EncodeInt(TYPE_INT, value, &key));
+  return key;
+}
+
+static FixedFileTrailer MakeTrailer(int num_levels) {
+  FixedFileTrailer trailer;
+  trailer.major_version_ = 2;
+  trailer.minor_version_ = 0;
+  trailer.header_size_ = FixedFileTrailer::HEADER_SIZE_NO_CHECKSUM;
+  trailer.num_data_index_levels_ = num_levels;
+  trailer.data_index_count_ = 3;
+  trailer.first_data_block_offset_ = 0;
+  trailer.load_on_open_data_offset_ = 1000;
+  return trailer;
+}
+
+TEST(HFileTypesTest, BlockHeader) {
+  FixedFileTrailer trailer = MakeTrailer(1);
+  string buffer("DATABLK*");
+  AppendBigEndian(100, 4, &buffer);
+  AppendBigEndian(200, 4, &buffer);
+  AppendBigEndian(-1, 8, &buffer);
+  BlockHeader header;
+  EXPECT_TRUE(BlockHeader::Parse(reinterpret_cast<const uint8_t*>(buffer.data()),
+      trailer, &header).ok());
+  EXPECT_EQ(header.on_disk_size_without_header_, 100);
+  EXPECT_EQ(header.uncompressed_size_without_header_, 200);
+  EXPECT_EQ(header.on_disk_data_size_, 100);
+  EXPECT_EQ(header.checksum_size_, 0);
+
+  // With checksums, the data is followed by the checksum bytes.
+  trailer.minor_version_ = FixedFileTrailer::MINOR_VERSION_WITH_CHECKSUM;
+  trailer.header_size_ = FixedFileTrailer::HEADER_SIZE_WITH_CHECKSUMS;
+  buffer.push_back('\1');
+  AppendBigEndian(16 * 1024, 4, &buffer);
+  AppendBigEndian(92 + trailer.header_size_, 4, &buffer);
+  EXPECT_TRUE(BlockHeader::Parse(reinterpret_cast<const uint8_t*>(buffer.data()),
+      trailer, &header).ok());
+  EXPECT_EQ(header.on_disk_data_size_, 92);
+  EXPECT_EQ(header.checksum_size_, 8);
+}
+
+TEST(HFileTypesTest, Checksums) {
+  const uint8_t* check = reinterpret_cast<const uint8_t*>("123456789");
+  EXPECT_EQ(BlockHeader::ComputeChecksum(BlockHeader::CHECKSUM_CRC32, check, 9),
+      0xCBF43926);
+  EXPECT_EQ(BlockHeader::ComputeChecksum(BlockHeader::CHECKSUM_CRC32C, check, 9),
+      0xE3069283);
+
+  FixedFileTrailer trailer = MakeTrailer(1);
+  trailer.minor_version_ = FixedFileTrailer::MINOR_VERSION_WITH_CHECKSUM;
+  trailer.header_size_ = FixedFileTrailer::HEADER_SIZE_WITH_CHECKSUMS;
+  string data(50, 'x');
+  for (int checksum_type = BlockHeader::CHECKSUM_CRC32;
+       checksum_type <= BlockHeader::CHECKSUM_CRC32C; ++checksum_type) {
+    // The 83 bytes of header and data are covered by 4 checksums, of which the
+    // second spans the end of the header and the last one is shorter.
+    const int BYTES_PER_CHECKSUM = 25;
+    string block("DATABLK*");
+    AppendBigEndian(data.size() + 4 * sizeof(uint32_t), 4, &block);
+    AppendBigEndian(data.size(), 4, &block);
+    AppendBigEndian(-1, 8, &block);
+    block.push_back(static_cast<char>(checksum_type));
+    AppendBigEndian(BYTES_PER_CHECKSUM, 4, &block);
+    AppendBigEndian(trailer.header_size_ + data.size(), 4, &block);
+    block += data;
+    int num_bytes = block.size();
+    for (int offset = 0; offset < num_bytes; offset += BYTES_PER_CHECKSUM) {
+      AppendBigEndian(BlockHeader::ComputeChecksum(checksum_type,
+          reinterpret_cast<const uint8_t*>(block.data()) + offset,
+          min(BYTES_PER_CHECKSUM, num_bytes - offset)), 4, &block);
+    }
+
+    const uint8_t* header_data = reinterpret_cast<const uint8_t*>(block.data());
+    BlockHeader header;
+    EXPECT_TRUE(BlockHeader::Parse(header_data, trailer, &header).ok());
+    EXPECT_EQ(header.bytes_per_checksum_, BYTES_PER_CHECKSUM);
+    EXPECT_EQ(header.checksum_size_, 4 * sizeof(uint32_t));
+    // The header and data don't need to be next to each other.
+    string data_copy = block.substr(trailer.header_size_);
+    EXPECT_TRUE(header.VerifyChecksums(header_data,
+        reinterpret_cast<const uint8_t*>(data_copy.data())).ok());
+    data_copy[10] = 'y';
+    EXPECT_FALSE(header.VerifyChecksums(header_data,
+        reinterpret_cast<const uint8_t*>(data_copy.data())).ok());
+  }
+}
+
+TEST(HFileTypesTest, RootIndex) {
+  string buffer;
+  AppendEntry(0, 100, MakeKey(EncodeInt(1)), &buffer);
+  AppendEntry(150, 100, MakeKey(EncodeInt(10)), &buffer);
+  AppendEntry(250, 100, MakeKey(EncodeInt(20)), &buffer);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+  vector<BlockIndexEntry> entries;
+  EXPECT_TRUE(DataBlockIndex::ParseRootIndex(data, buffer.size(), 3, &entries).ok());
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[1].offset_, 150);
+  EXPECT_EQ(entries[1].on_disk_size_, 100);
+  string row;
+  EXPECT_TRUE(DataBlockIndex::GetRow(entries[1].first_key_, &row).ok());
+  EXPECT_EQ(row, EncodeInt(10));
+  EXPECT_FALSE(DataBlockIndex::ParseRootIndex(data, buffer.size() - 1, 3,
+      &entries).ok());
+
+  // Single-level index: segments end where the next data block starts.
+  FixedFileTrailer trailer = MakeTrailer(1);
+  EXPECT_TRUE(DataBlockIndex::ParseRootIndex(data, buffer.size(), 3, &entries).ok());
+  vector<DataSegment> segments;
+  EXPECT_TRUE(DataBlockIndex::GetDataSegments(trailer, entries, &segments).ok());
+  ASSERT_EQ(segments.size(), 3);
+  EXPECT_EQ(segments[0].offset_, 0);
+  EXPECT_EQ(segments[0].len_, 150);
+  EXPECT_EQ(segments[2].offset_, 250);
+  EXPECT_EQ(segments[2].len_, 100);
+  EXPECT_EQ(segments[2].first_row_, EncodeInt(20));
+
+  // Two-level index: segments end after the leaf index blocks.
+  trailer = MakeTrailer(2);
+  EXPECT_TRUE(DataBlockIndex::GetDataSegments(trailer, entries, &segments).ok());
+  EXPECT_EQ(segments[0].offset_, 0);
+  EXPECT_EQ(segments[0].len_, 100);
+  EXPECT_EQ(segments[1].offset_, 100);
+  EXPECT_EQ(segments[1].len_, 150);
+  EXPECT_EQ(segments[2].offset_, 250);
+
+  trailer.num_data_index_levels_ = 3;
+  EXPECT_FALSE(DataBlockIndex::CanSplit(trailer));
+}
+
+// Appends a byte array written with Bytes.writeByteArray(), shorter than 128 bytes.
+static void AppendByteArray(const string& value, string* buffer) {
+  buffer->push_back(static_cast<char>(value.size()));
+  *buffer += value;
+}
+
+TEST(HFileTypesTest, FileInfo) {
+  string time_range;
+  AppendBigEndian(100, 8, &time_range);
+  AppendBigEndian(200, 8, &time_range);
+  string buffer;
+  AppendBigEndian(2, 4, &buffer);
+  AppendByteArray(FileInfo::BLOOM_FILTER_TYPE_KEY, &buffer);
+  buffer.push_back('\1');
+  AppendByteArray("ROW", &buffer);
+  AppendByteArray(FileInfo::TIMERANGE_KEY, &buffer);
+  buffer.push_back('\1');
+  AppendByteArray(time_range, &buffer);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+  FileInfo file_info;
+  EXPECT_TRUE(file_info.Parse(data, buffer.size()).ok());
+  EXPECT_EQ(file_info.GetBloomFilterType(), "ROW");
+  int64_t min_timestamp, max_timestamp;
+  EXPECT_TRUE(file_info.GetTimeRange(&min_timestamp, &max_timestamp));
+  EXPECT_EQ(min_timestamp, 100);
+  EXPECT_EQ(max_timestamp, 200);
+  EXPECT_FALSE(file_info.Parse(data, buffer.size() - 1).ok());
+
+  // Files without the entries
+  string empty;
+  AppendBigEndian(0, 4, &empty);
+  EXPECT_TRUE(file_info.Parse(reinterpret_cast<const uint8_t*>(empty.data()),
+      empty.size()).ok());
+  EXPECT_EQ(file_info.GetBloomFilterType(), "NONE");
+  EXPECT_FALSE(file_info.GetTimeRange(&min_timestamp, &max_timestamp));
+}
+
+// Sets the bits of 'key' in 'bits', like ByteBloomFilter.add().
+static void AddToBloom(const string& key, int hash_count, string* bits) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(key.data());
+  int32_t hash1 = BloomFilter::MurmurHash(data, key.size(), 0);
+  int32_t hash2 = BloomFilter::MurmurHash(data, key.size(), hash1);
+  int32_t bit_size = bits->size() * 8;
+  uint32_t composite_hash = hash1;
+  for (int i = 0; i < hash_count; ++i) {
+    int32_t bit = abs(static_cast<int32_t>(composite_hash) % bit_size);
+    composite_hash += hash2;
+    (*bits)[bit >> 3] |= static_cast<char>(1 << (bit & 7));
+  }
+}
+
+TEST(HFileTypesTest, BloomFilter) {
+  EXPECT_EQ(BloomFilter::MurmurHash(NULL, 0, 0), 0);
+  // Different tails hash differently, including bytes with the sign bit set.
+  const uint8_t* data = reinterpret_cast<const uint8_t*>("abc\x80\x81\x82");
+  EXPECT_NE(BloomFilter::MurmurHash(data, 5, 0), BloomFilter::MurmurHash(data, 6, 0));
+  EXPECT_NE(BloomFilter::MurmurHash(data, 5, 0), BloomFilter::MurmurHash(data, 5, 1));
+
+  // Two chunks, the second one starts at row 100.
+  const int HASH_COUNT = 3;
+  string meta;
+  AppendBigEndian(3, 4, &meta);
+  AppendBigEndian(2000, 8, &meta);
+  AppendBigEndian(HASH_COUNT, 4, &meta);
+  AppendBigEndian(BloomFilter::MURMUR_HASH, 4, &meta);
+  AppendBigEndian(20, 8, &meta);
+  AppendBigEndian(1000, 8, &meta);
+  AppendBigEndian(2, 4, &meta);
+  AppendByteArray("org.apache.hadoop.hbase.util.Bytes$ByteArrayComparator", &meta);
+  AppendEntry(0, 1033, EncodeInt(0), &meta);
+  AppendEntry(5000, 1033, EncodeInt(100), &meta);
+
+  BloomFilter filter;
+  EXPECT_TRUE(filter.ParseMeta(reinterpret_cast<const uint8_t*>(meta.data()),
+      meta.size()).ok());
+  EXPECT_TRUE(filter.CanLookup());
+  ASSERT_EQ(filter.chunks().size(), 2);
+  EXPECT_EQ(filter.chunks()[1].offset_, 5000);
+  EXPECT_EQ(filter.GetChunkIdx(EncodeInt(-1)), -1);
+  EXPECT_EQ(filter.GetChunkIdx(EncodeInt(0)), 0);
+  EXPECT_EQ(filter.GetChunkIdx(EncodeInt(99)), 0);
+  EXPECT_EQ(filter.GetChunkIdx(EncodeInt(100)), 1);
+  EXPECT_EQ(filter.GetChunkIdx(EncodeInt(1000)), 1);
+
+  // Even rows are in the chunk.
+  string bits(1000, '\0');
+  for (int i = 0; i < 100; i += 2) {
+    AddToBloom(EncodeInt(i), HASH_COUNT, &bits);
+  }
+  const uint8_t* bits_data = reinterpret_cast<const uint8_t*>(bits.data());
+  int num_false_positives = 0;
+  for (int i = 0; i < 100; ++i) {
+    bool contains = filter.ChunkContains(bits_data, bits.size(), EncodeInt(i));
+    if (i % 2 == 0) {
+      EXPECT_TRUE(contains);
+    } else if (contains) {
+      ++num_false_positives;
+    }
+  }
+  EXPECT_LT(num_false_positives, 5);
+
+  EXPECT_FALSE(filter.ParseMeta(reinterpret_cast<const uint8_t*>(meta.data()),
+      meta.size() - 1).ok());
+  // Other hash functions can't be looked up.
+  meta[19] = BloomFilter::JENKINS_HASH;
+  EXPECT_TRUE(filter.ParseMeta(reinterpret_cast<const uint8_t*>(meta.data()),
+      meta.size()).ok());
+  EXPECT_FALSE(filter.CanLookup());
+}
+
+TEST(HFileTypesTest, EncodeRowKey) {
+  // The encoding sorts like the values.
+  EXPECT_LT(EncodeInt(-5), EncodeInt(-1));
+  EXPECT_LT(EncodeInt(-1), EncodeInt(0));
+  EXPECT_LT(EncodeInt(0), EncodeInt(300));
+  string key;
+  EXPECT_TRUE(RowKeyRange::EncodeInt(TYPE_SMALLINT, 1, &key));
+  EXPECT_EQ(key, string("\1\x80\1", 3));
+  EXPECT_FALSE(RowKeyRange::EncodeInt(TYPE_DOUBLE, 1, &key));
+
+  string a, ab, b;
+  RowKeyRange::EncodeString("a", 1, &a);
+  RowKeyRange::EncodeString("ab", 2, &ab);
+  RowKeyRange::EncodeString("b", 1, &b);
+  EXPECT_LT(a, ab);
+  EXPECT_LT(ab, b);
+  RowKeyRange::EncodeString("\0\1", 2, &key);
+  EXPECT_EQ(key, string("\1\1\1\1\2\0", 6));
+}
+
+TEST(HFileTypesTest, RowKeyRange) {
+  // Rows have a second key column after the first one.
+  string row_5 = EncodeInt(5) + EncodeInt(100);
+  string row_10 = EncodeInt(10) + EncodeInt(-100);
+  string row_20 = EncodeInt(20);
+
+  RowKeyRange range;
+  EXPECT_TRUE(range.MayContain(row_5, &row_10));
+  EXPECT_TRUE(range.MayContain(row_20, NULL));
+
+  // key = 10
+  range.SetLower(EncodeInt(10));
+  range.SetUpper(EncodeInt(10));
+  EXPECT_TRUE(range.MayContain(row_5, &row_10));
+  EXPECT_TRUE(range.MayContain(row_10, &row_20));
+  EXPECT_FALSE(range.MayContain(row_20, NULL));
+
+  // key >= 11 and key <= 30
+  RowKeyRange range2;
+  range2.SetLower(EncodeInt(11));
+  range2.SetLower(EncodeInt(3));
+  range2.SetUpper(EncodeInt(30));
+  EXPECT_FALSE(range2.MayContain(row_5, &row_10));
+  EXPECT_TRUE(range2.MayContain(row_10, &row_20));
+  EXPECT_TRUE(range2.MayContain(row_20, NULL));
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -6,10 +6,16 @@
  */
 
 #include "hfile-types.h"
+#include "common/logging.h"
 #include "exec/read-write-util.h"
+#include "util/cpu-info.h"
+#include "util/hash-util.h"
 
+#include <algorithm>
 #include <sstream>
+#include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
 
 using namespace impala;
 using namespace std;
@@ -21,6 +27,14 @@ static const uint32_t MAX_FORMAT_VERSION = 2;
 const uint8_t FixedFileTrailer::TRAILER_BLOCK_TYPE[] = { 'T', 'R', 'A', 'B', 'L', 'K', '"', '$' };
 const uint8_t FixedFileTrailer::DATA_BLOCK_TYPE[] = {'D','A','T','A','B','L','K','*'};
 const uint8_t FixedFileTrailer::ENCODED_DATA_BLOCK_TYPE[] = {'D','A','T','A','B','L','K','E'};
+const uint8_t FixedFileTrailer::ROOT_INDEX_BLOCK_TYPE[] =
+    {'I','D','X','R','O','O','T','2'};
+const uint8_t FixedFileTrailer::FILE_INFO_BLOCK_TYPE[] =
+    {'F','I','L','E','I','N','F','2'};
+const uint8_t FixedFileTrailer::BLOOM_META_BLOCK_TYPE[] =
+    {'B','L','M','F','M','E','T','2'};
+const uint8_t FixedFileTrailer::BLOOM_CHUNK_BLOCK_TYPE[] =
+    {'B','L','M','F','B','L','K','2'};
 //the first element is a placeholder.
 const int FixedFileTrailer::TRAILER_SIZE[]= {0,60,212};
 
@@ -158,5 +172,567 @@ Status FixedFileTrailer::SetDataFromBuffer(uint8_t* buffer, int len,
     return Status::OK;
 }
 
+Status BlockHeader::Parse(const uint8_t* buffer, const FixedFileTrailer& trailer,
+        BlockHeader* header)
+{
+    header->block_type_ = buffer;
+    header->header_size_ = trailer.header_size_;
+    buffer += 8;
+    header->on_disk_size_without_header_ = ReadWriteUtil::GetInt(buffer);
+    buffer += 4;
+    header->uncompressed_size_without_header_ = ReadWriteUtil::GetInt(buffer);
+    buffer += 4;
+    //skip previous block offset field
+    buffer += 8;
+
+    uint32_t on_disk_data_size_with_header;
+    if (trailer.minor_version_ >= FixedFileTrailer::MINOR_VERSION_WITH_CHECKSUM)
+    {
+        header->checksum_type_ = *buffer;
+        buffer++;
+        header->bytes_per_checksum_ = ReadWriteUtil::GetInt(buffer);
+        buffer += 4;
+        on_disk_data_size_with_header = ReadWriteUtil::GetInt(buffer);
+    }
+    else
+    {
+        header->checksum_type_ = CHECKSUM_NULL;
+        header->bytes_per_checksum_ = 0;
+        on_disk_data_size_with_header = header->on_disk_size_without_header_
+                                        + FixedFileTrailer::HEADER_SIZE_NO_CHECKSUM;
+    }
+
+    if (on_disk_data_size_with_header < trailer.header_size_ ||
+            on_disk_data_size_with_header - trailer.header_size_
+            > header->on_disk_size_without_header_)
+    {
+        stringstream ss;
+        ss << "Invalid HFile block header: on-disk size " << on_disk_data_size_with_header
+           << ", on-disk size without header " << header->on_disk_size_without_header_;
+        return Status(ss.str());
+    }
+    header->on_disk_data_size_ = on_disk_data_size_with_header - trailer.header_size_;
+    header->checksum_size_ =
+        header->on_disk_size_without_header_ - header->on_disk_data_size_;
+    return Status::OK;
+}
+
+//the software version of the crc32c HashUtil::CrcHash() computes with sse4.2, for
+//machines without it. Like CrcHash(), it doesn't invert the crc before and after.
+namespace
+{
+class Crc32cTable
+{
+public:
+    Crc32cTable()
+    {
+        //the reversed Castagnoli polynomial
+        const uint32_t POLY = 0x82F63B78;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc >> 1) ^ ((crc & 1) ? POLY : 0);
+            table_[i] = crc;
+        }
+    }
+
+    uint32_t Update(uint32_t crc, const uint8_t* data, int len) const
+    {
+        for (int i = 0; i < len; ++i)
+            crc = table_[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc;
+    }
+
+private:
+    uint32_t table_[256];
+};
+
+const Crc32cTable crc32c_table;
+}
+
+//the checksum functions below keep the crc in the form the checksum type updates it
+//in, so a checksum can be computed over several pieces of data.
+static uint32_t InitChecksum(uint8_t checksum_type)
+{
+    return checksum_type == BlockHeader::CHECKSUM_CRC32C ? 0xFFFFFFFF : crc32(0, NULL, 0);
+}
+
+static uint32_t UpdateChecksum(uint8_t checksum_type, uint32_t crc, const uint8_t* data,
+        int len)
+{
+    if (checksum_type == BlockHeader::CHECKSUM_CRC32)
+        return crc32(crc, data, len);
+#ifdef __SSE4_2__
+    if (LIKELY(CpuInfo::IsSupported(CpuInfo::SSE4_2)))
+        return HashUtil::CrcHash(data, len, crc);
+#endif
+    return crc32c_table.Update(crc, data, len);
+}
+
+static uint32_t FinishChecksum(uint8_t checksum_type, uint32_t crc)
+{
+    return checksum_type == BlockHeader::CHECKSUM_CRC32C ? ~crc : crc;
+}
+
+uint32_t BlockHeader::ComputeChecksum(uint8_t checksum_type, const uint8_t* data,
+        int len)
+{
+    uint32_t crc = UpdateChecksum(checksum_type, InitChecksum(checksum_type), data, len);
+    return FinishChecksum(checksum_type, crc);
+}
+
+Status BlockHeader::VerifyChecksums(const uint8_t* header, const uint8_t* data) const
+{
+    if (checksum_type_ == CHECKSUM_NULL)
+        return Status::OK;
+    if (checksum_type_ != CHECKSUM_CRC32 && checksum_type_ != CHECKSUM_CRC32C)
+    {
+        stringstream ss;
+        ss << "Invalid HFile block header: unknown checksum type "
+           << static_cast<int>(checksum_type_);
+        return Status(ss.str());
+    }
+    int64_t num_bytes = header_size_ + on_disk_data_size_;
+    if (bytes_per_checksum_ == 0 || (num_bytes + bytes_per_checksum_ - 1)
+            / bytes_per_checksum_ * sizeof(uint32_t) > checksum_size_)
+    {
+        stringstream ss;
+        ss << "Invalid HFile block header: " << checksum_size_ << " checksum bytes for "
+           << num_bytes << " bytes with " << bytes_per_checksum_ << " bytes per checksum";
+        return Status(ss.str());
+    }
+
+    //the chunks span the end of the header and the start of the data.
+    const uint8_t* pieces[] = { header, data };
+    const int piece_lens[] = { static_cast<int>(header_size_),
+                               static_cast<int>(on_disk_data_size_) };
+    const uint8_t* checksums = data + on_disk_data_size_;
+    uint32_t crc = InitChecksum(checksum_type_);
+    int64_t chunk_remaining = bytes_per_checksum_;
+    int64_t offset = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        const uint8_t* piece = pieces[i];
+        int len = piece_lens[i];
+        while (len > 0)
+        {
+            int n = min<int64_t>(len, chunk_remaining);
+            crc = UpdateChecksum(checksum_type_, crc, piece, n);
+            piece += n;
+            len -= n;
+            chunk_remaining -= n;
+            offset += n;
+            //the last chunk may be shorter
+            if (chunk_remaining > 0 && offset < num_bytes)
+                continue;
+
+            uint32_t expected = ReadWriteUtil::GetInt(checksums);
+            checksums += sizeof(uint32_t);
+            if (FinishChecksum(checksum_type_, crc) != expected)
+            {
+                stringstream ss;
+                ss << "HFile block checksum mismatch in the chunk ending at offset "
+                   << offset << " of the block";
+                return Status(ss.str());
+            }
+            crc = InitChecksum(checksum_type_);
+            chunk_remaining = bytes_per_checksum_;
+        }
+    }
+    return Status::OK;
+}
+
+Status DataBlockIndex::ParseRootIndex(const uint8_t* buffer, int len, int num_entries,
+        vector<BlockIndexEntry>* entries)
+{
+    const uint8_t* end = buffer + len;
+    entries->resize(num_entries);
+    for (int i = 0; i < num_entries; ++i)
+    {
+        BlockIndexEntry& entry = (*entries)[i];
+        if (end - buffer < static_cast<int>(sizeof(int64_t) + sizeof(int32_t)) + 1)
+        {
+            return Status("Invalid HFile root data index: truncated entry");
+        }
+        entry.offset_ = ReadWriteUtil::GetLongInt(buffer);
+        buffer += sizeof(int64_t);
+        entry.on_disk_size_ = ReadWriteUtil::GetInt(buffer);
+        buffer += sizeof(int32_t);
+        //the key is written with Bytes.writeByteArray(), i.e. prefixed by a vint
+        if (end - buffer < ReadWriteUtil::DecodeVIntSize(*buffer))
+        {
+            return Status("Invalid HFile root data index: truncated key length");
+        }
+        int32_t key_len;
+        buffer += ReadWriteUtil::GetVInt(const_cast<uint8_t*>(buffer), &key_len);
+        if (key_len < 0 || end - buffer < key_len)
+        {
+            return Status("Invalid HFile root data index: truncated key");
+        }
+        entry.first_key_.assign(reinterpret_cast<const char*>(buffer), key_len);
+        buffer += key_len;
+    }
+    return Status::OK;
+}
+
+bool DataBlockIndex::CanSplit(const FixedFileTrailer& trailer)
+{
+    //intermediate index levels are written after the data section, so the root
+    //entries of deeper indexes do not delimit parts of it.
+    return trailer.major_version_ >= 2 && trailer.data_index_count_ > 0
+           && trailer.num_data_index_levels_ >= 1 && trailer.num_data_index_levels_ <= 2;
+}
+
+Status DataBlockIndex::GetDataSegments(const FixedFileTrailer& trailer,
+        const vector<BlockIndexEntry>& entries, vector<DataSegment>* segments)
+{
+    DCHECK(CanSplit(trailer));
+    segments->resize(entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        DataSegment& segment = (*segments)[i];
+        RETURN_IF_ERROR(GetRow(entries[i].first_key_, &segment.first_row_));
+        int64_t end;
+        if (trailer.num_data_index_levels_ == 1)
+        {
+            //the entries point to the data blocks. Inline blocks (e.g. bloom chunks)
+            //between two data blocks belong to the first one's segment.
+            segment.offset_ = entries[i].offset_;
+            end = (i + 1 < entries.size()) ? entries[i + 1].offset_
+                  : entries[i].offset_ + entries[i].on_disk_size_;
+        }
+        else
+        {
+            //the entries point to leaf index blocks, which are written right after the
+            //data blocks they index.
+            segment.offset_ = (i == 0) ? trailer.first_data_block_offset_
+                              : (*segments)[i - 1].offset_ + (*segments)[i - 1].len_;
+            end = entries[i].offset_ + entries[i].on_disk_size_;
+        }
+        if (end <= segment.offset_
+                || end > static_cast<int64_t>(trailer.load_on_open_data_offset_))
+        {
+            stringstream ss;
+            ss << "Invalid HFile root data index: entry " << i << " at offset "
+               << entries[i].offset_ << " with size " << entries[i].on_disk_size_
+               << " is out of order";
+            return Status(ss.str());
+        }
+        segment.len_ = end - segment.offset_;
+    }
+    return Status::OK;
+}
+
+Status DataBlockIndex::GetRow(const string& key, string* row)
+{
+    if (key.size() < sizeof(int16_t))
+    {
+        return Status("Invalid HFile key: missing row length");
+    }
+    int row_len = static_cast<uint16_t>(
+        ReadWriteUtil::GetSmallInt(reinterpret_cast<const uint8_t*>(key.data())));
+    if (key.size() < sizeof(int16_t) + row_len)
+    {
+        return Status("Invalid HFile key: truncated row");
+    }
+    row->assign(key, sizeof(int16_t), row_len);
+    return Status::OK;
+}
+
+//reads a byte array written with Bytes.writeByteArray(), i.e. prefixed by a vint, and
+//advances '*buffer' past it. 'what' names the structure in error messages.
+static Status ReadByteArray(const uint8_t** buffer, const uint8_t* end, const char* what,
+        string* value)
+{
+    if (*buffer >= end || end - *buffer < ReadWriteUtil::DecodeVIntSize(**buffer))
+    {
+        stringstream ss;
+        ss << "Invalid HFile " << what << ": truncated length";
+        return Status(ss.str());
+    }
+    int32_t len;
+    *buffer += ReadWriteUtil::GetVInt(const_cast<uint8_t*>(*buffer), &len);
+    if (len < 0 || end - *buffer < len)
+    {
+        stringstream ss;
+        ss << "Invalid HFile " << what << ": truncated byte array";
+        return Status(ss.str());
+    }
+    value->assign(reinterpret_cast<const char*>(*buffer), len);
+    *buffer += len;
+    return Status::OK;
+}
+
+const char* const FileInfo::TIMERANGE_KEY = "TIMERANGE";
+const char* const FileInfo::BLOOM_FILTER_TYPE_KEY = "BLOOM_FILTER_TYPE";
+
+Status FileInfo::Parse(const uint8_t* buffer, int len)
+{
+    const uint8_t* end = buffer + len;
+    entries_.clear();
+    if (len < static_cast<int>(sizeof(int32_t)))
+    {
+        return Status("Invalid HFile file info: missing number of entries");
+    }
+    int32_t num_entries = ReadWriteUtil::GetInt(buffer);
+    buffer += sizeof(int32_t);
+    for (int i = 0; i < num_entries; ++i)
+    {
+        string key;
+        RETURN_IF_ERROR(ReadByteArray(&buffer, end, "file info", &key));
+        //the class code of the value, which is always a byte array
+        if (buffer >= end)
+        {
+            return Status("Invalid HFile file info: truncated entry");
+        }
+        ++buffer;
+        RETURN_IF_ERROR(ReadByteArray(&buffer, end, "file info", &entries_[key]));
+    }
+    return Status::OK;
+}
+
+bool FileInfo::Get(const string& key, string* value) const
+{
+    map<string, string>::const_iterator it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        return false;
+    }
+    *value = it->second;
+    return true;
+}
+
+bool FileInfo::GetTimeRange(int64_t* min_timestamp, int64_t* max_timestamp) const
+{
+    //a serialized TimeRangeTracker: the minimum and the maximum timestamp
+    string value;
+    if (!Get(TIMERANGE_KEY, &value) || value.size() != 2 * sizeof(int64_t))
+    {
+        return false;
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(value.data());
+    *min_timestamp = ReadWriteUtil::GetLongInt(data);
+    *max_timestamp = ReadWriteUtil::GetLongInt(data + sizeof(int64_t));
+    return true;
+}
+
+string FileInfo::GetBloomFilterType() const
+{
+    string value;
+    if (!Get(BLOOM_FILTER_TYPE_KEY, &value))
+    {
+        return "NONE";
+    }
+    return value;
+}
+
+//the version of the meta data written by CompoundBloomFilterWriter
+static const int32_t COMPOUND_BLOOM_FILTER_VERSION = 3;
+
+Status BloomFilter::ParseMeta(const uint8_t* buffer, int len)
+{
+    const uint8_t* end = buffer + len;
+    //version, total byte size, hash count, hash type, total key count, total max keys
+    //and number of chunks
+    const int FIXED_LEN = 4 + 8 + 4 + 4 + 8 + 8 + 4;
+    if (len < FIXED_LEN)
+    {
+        return Status("Invalid HFile bloom filter meta: truncated block");
+    }
+    int32_t version = ReadWriteUtil::GetInt(buffer);
+    if (version != COMPOUND_BLOOM_FILTER_VERSION)
+    {
+        stringstream ss;
+        ss << "Unsupported HFile bloom filter version " << version;
+        return Status(ss.str());
+    }
+    buffer += sizeof(int32_t) + sizeof(int64_t);
+    hash_count_ = ReadWriteUtil::GetInt(buffer);
+    buffer += sizeof(int32_t);
+    hash_type_ = ReadWriteUtil::GetInt(buffer);
+    buffer += sizeof(int32_t) + 2 * sizeof(int64_t);
+    int32_t num_chunks = ReadWriteUtil::GetInt(buffer);
+    buffer += sizeof(int32_t);
+    if (num_chunks < 0)
+    {
+        return Status("Invalid HFile bloom filter meta: negative number of chunks");
+    }
+    string comparator_class_name;
+    RETURN_IF_ERROR(ReadByteArray(&buffer, end, "bloom filter meta",
+                                  &comparator_class_name));
+    //the chunk index has the format of a root data index
+    return DataBlockIndex::ParseRootIndex(buffer, end - buffer, num_chunks, &chunks_);
+}
+
+int BloomFilter::GetChunkIdx(const string& key) const
+{
+    //the last chunk whose first key is <= key. Keys are compared as unsigned bytes.
+    int low = 0;
+    int high = chunks_.size();
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (chunks_[mid].first_key_ <= key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low - 1;
+}
+
+bool BloomFilter::ChunkContains(const uint8_t* bits, int len, const string& key) const
+{
+    DCHECK(CanLookup());
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(key.data());
+    int32_t hash1 = MurmurHash(data, key.size(), 0);
+    int32_t hash2 = MurmurHash(data, key.size(), hash1);
+    int32_t bit_size = len * 8;
+    if (bit_size <= 0)
+    {
+        return true;
+    }
+    //java int arithmetic, which wraps around
+    uint32_t composite_hash = hash1;
+    for (int i = 0; i < hash_count_; ++i)
+    {
+        int32_t bit = abs(static_cast<int32_t>(composite_hash) % bit_size);
+        composite_hash += hash2;
+        if ((bits[bit >> 3] & (1 << (bit & 7))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int32_t BloomFilter::MurmurHash(const uint8_t* data, int len, int32_t seed)
+{
+    const uint32_t m = 0x5bd1e995;
+    const int r = 24;
+    uint32_t h = seed ^ len;
+    int len_4 = len >> 2;
+    for (int i = 0; i < len_4; ++i)
+    {
+        //4 byte blocks are read in little endian order
+        const uint8_t* block = data + (i << 2);
+        uint32_t k = block[0] | (block[1] << 8) | (block[2] << 16)
+                     | (static_cast<uint32_t>(block[3]) << 24);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h *= m;
+        h ^= k;
+    }
+    //the remaining bytes are sign extended like java bytes
+    const int8_t* tail = reinterpret_cast<const int8_t*>(data + (len_4 << 2));
+    int left = len - (len_4 << 2);
+    if (left != 0)
+    {
+        if (left >= 3)
+        {
+            h ^= static_cast<uint32_t>(tail[2]) << 16;
+        }
+        if (left >= 2)
+        {
+            h ^= static_cast<uint32_t>(tail[1]) << 8;
+        }
+        h ^= static_cast<uint32_t>(tail[0]);
+        h *= m;
+    }
+    h ^= h >> 13;
+    h *= m;
+    h ^= h >> 15;
+    return static_cast<int32_t>(h);
 }
 
+void RowKeyRange::SetLower(const string& key)
+{
+    if (!has_lower_ || key > lower_)
+    {
+        lower_ = key;
+    }
+    has_lower_ = true;
+}
+
+void RowKeyRange::SetUpper(const string& key)
+{
+    if (!has_upper_ || key < upper_)
+    {
+        upper_ = key;
+    }
+    has_upper_ = true;
+}
+
+bool RowKeyRange::MayContain(const string& first_row, const string* next_first_row) const
+{
+    //all rows of the segment are >= first_row
+    if (has_upper_ && first_row.compare(0, upper_.size(), upper_) > 0)
+    {
+        return false;
+    }
+    //all rows of the segment are <= next_first_row
+    if (has_lower_ && next_first_row != NULL
+            && next_first_row->compare(0, lower_.size(), lower_) < 0)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool RowKeyRange::EncodeInt(PrimitiveType type, int64_t value, string* key)
+{
+    int num_bytes;
+    switch (type)
+    {
+    case TYPE_TINYINT:
+        num_bytes = 1;
+        break;
+    case TYPE_SMALLINT:
+        num_bytes = 2;
+        break;
+    case TYPE_INT:
+        num_bytes = 4;
+        break;
+    case TYPE_BIGINT:
+        num_bytes = 8;
+        break;
+    default:
+        return false;
+    }
+    //not null marker, followed by the big endian value with the sign bit flipped
+    key->assign(1, '\1');
+    for (int i = num_bytes - 1; i >= 0; --i)
+    {
+        uint8_t b = static_cast<uint8_t>(value >> (i * 8));
+        if (i == num_bytes - 1)
+        {
+            b ^= 0x80;
+        }
+        key->push_back(static_cast<char>(b));
+    }
+    return true;
+}
+
+void RowKeyRange::EncodeString(const char* ptr, int len, string* key)
+{
+    //not null marker, followed by the bytes with 0 and 1 escaped and a 0 terminator
+    key->assign(1, '\1');
+    for (int i = 0; i < len; ++i)
+    {
+        uint8_t b = static_cast<uint8_t>(ptr[i]);
+        if (b == 0 || b == 1)
+        {
+            key->push_back('\1');
+            b += 1;
+        }
+        key->push_back(static_cast<char>(b));
+    }
+    key->push_back('\0');
+}
+
+}
@@ -9,7 +9,10 @@
 #define HFILE_TYPES_H_
 
 #include "common/status.h"
+#include "runtime/primitive-type.h"
+#include <map>
 #include <string>
+#include <vector>
 
 
 namespace hfile
@@ -66,6 +69,10 @@ public:
 	static const uint8_t TRAILER_BLOCK_TYPE[] ;
 	static const uint8_t DATA_BLOCK_TYPE[];
 	static const uint8_t ENCODED_DATA_BLOCK_TYPE[];
+	static const uint8_t ROOT_INDEX_BLOCK_TYPE[];
+	static const uint8_t FILE_INFO_BLOCK_TYPE[];
+	static const uint8_t BLOOM_META_BLOCK_TYPE[];
+	static const uint8_t BLOOM_CHUNK_BLOCK_TYPE[];
 	static const int MAX_TRAILER_SIZE = 212;
 	static const int MINOR_VERSION_WITH_CHECKSUM=1;
 	static const int HEADER_SIZE_NO_CHECKSUM=24;
@@ -73,6 +80,190 @@ public:
 	
 };
 
+//the header in front of every block of a version 2 file, data and index blocks alike.
+struct BlockHeader
+{
+	//ordinals of the ChecksumType enum written in java
+	enum ChecksumType
+	{
+		CHECKSUM_NULL = 0,
+		CHECKSUM_CRC32 = 1,
+		CHECKSUM_CRC32C = 2
+	};
+
+	//the 8 byte block magic
+	const uint8_t* block_type_;
+	//size of the header itself
+	uint32_t header_size_;
+	//on-disk size of the block without the header, including checksums
+	uint32_t on_disk_size_without_header_;
+	uint32_t uncompressed_size_without_header_;
+	uint8_t checksum_type_;
+	//number of bytes of the header and data covered by each checksum
+	uint32_t bytes_per_checksum_;
+	//on-disk size of the (possibly compressed) data following the header
+	uint32_t on_disk_data_size_;
+	//number of checksum bytes following the data
+	uint32_t checksum_size_;
+
+	//parses the header in 'buffer', which holds trailer.header_size_ bytes.
+	static impala::Status Parse(const uint8_t* buffer, const FixedFileTrailer& trailer,
+			BlockHeader* header);
+
+	//verifies the checksums of the block. The checksums cover the header and the data
+	//together, in chunks of bytes_per_checksum_ bytes. 'header' and 'data' point to the
+	//header and to the on-disk data, which is followed by the checksums.
+	impala::Status VerifyChecksums(const uint8_t* header, const uint8_t* data) const;
+
+	//returns the checksum of the given type of 'len' bytes at 'data'.
+	static uint32_t ComputeChecksum(uint8_t checksum_type, const uint8_t* data, int len);
+};
+
+//an entry of the root data block index. In a single-level index it points to a
+//data block, in a two-level index to the leaf index block that follows the data
+//blocks it indexes.
+struct BlockIndexEntry
+{
+	int64_t offset_;
+	//on-disk size of the block, including the header
+	int32_t on_disk_size_;
+	//the first key of the (first) data block, a serialized KeyValue key
+	std::string first_key_;
+};
+
+//a block-aligned part of the data section that is covered by one root index entry.
+//Data ranges are made up of consecutive segments.
+struct DataSegment
+{
+	int64_t offset_;
+	int64_t len_;
+	//the row of the first key in the segment
+	std::string first_row_;
+};
+
+class DataBlockIndex
+{
+public:
+	//parses the 'num_entries' entries of the (uncompressed) root data index block.
+	static impala::Status ParseRootIndex(const uint8_t* buffer, int len, int num_entries,
+			std::vector<BlockIndexEntry>* entries);
+
+	//returns true if the data section can be split along the root data index, i.e.
+	//the index has one or two levels.
+	static bool CanSplit(const FixedFileTrailer& trailer);
+
+	//computes the segment covered by each entry of the root index.
+	static impala::Status GetDataSegments(const FixedFileTrailer& trailer,
+			const std::vector<BlockIndexEntry>& entries, std::vector<DataSegment>* segments);
+
+	//extracts the row from a serialized KeyValue key.
+	static impala::Status GetRow(const std::string& key, std::string* row);
+};
+
+//the file info block of a version 2 file, a map from names to byte arrays written as
+//a HbaseMapWritable. Among others it has the time range of the cells in the file and
+//the type of its general bloom filter.
+class FileInfo
+{
+public:
+	static const char* const TIMERANGE_KEY;
+	static const char* const BLOOM_FILTER_TYPE_KEY;
+
+	//parses the (uncompressed) file info block.
+	impala::Status Parse(const uint8_t* buffer, int len);
+
+	//returns false if there is no entry named 'key'.
+	bool Get(const std::string& key, std::string* value) const;
+
+	//returns the smallest and largest timestamp of the cells in the file, both
+	//inclusive. Returns false if the file does not record them.
+	bool GetTimeRange(int64_t* min_timestamp, int64_t* max_timestamp) const;
+
+	//returns the type of the general bloom filter, i.e. "ROW", "ROWCOL" or "NONE".
+	std::string GetBloomFilterType() const;
+
+private:
+	std::map<std::string, std::string> entries_;
+};
+
+//the general bloom filter of a file, a CompoundBloomFilter in java. Its bit array is
+//split into chunks that are written as inline blocks in the data section, and the meta
+//block in the load-on-open section holds the hash parameters and an index of the
+//chunks by the first key they were built from.
+class BloomFilter
+{
+public:
+	//ordinals of the hash types written in java
+	enum HashType
+	{
+		JENKINS_HASH = 0,
+		MURMUR_HASH = 1
+	};
+
+	BloomFilter(): hash_count_(0), hash_type_(-1) {}
+
+	//parses the (uncompressed) general bloom filter meta block.
+	impala::Status ParseMeta(const uint8_t* buffer, int len);
+
+	//returns true if keys can be looked up in the filter, i.e. it has chunks and
+	//uses a supported hash function.
+	bool CanLookup() const { return hash_type_ == MURMUR_HASH && !chunks_.empty(); }
+
+	//the chunks of the filter; the on-disk size of an entry includes the header.
+	const std::vector<BlockIndexEntry>& chunks() const { return chunks_; }
+
+	//returns the index of the chunk that holds 'key', or -1 if 'key' sorts before
+	//the first chunk and so is not in the file.
+	int GetChunkIdx(const std::string& key) const;
+
+	//returns false if 'key' is definitely not in the chunk whose (uncompressed) bit
+	//array is the 'len' bytes at 'bits'.
+	bool ChunkContains(const uint8_t* bits, int len, const std::string& key) const;
+
+	//the 32 bit hash computed by the MurmurHash class written in java.
+	static int32_t MurmurHash(const uint8_t* data, int len, int32_t seed);
+
+private:
+	int32_t hash_count_;
+	int32_t hash_type_;
+	std::vector<BlockIndexEntry> chunks_;
+};
+
+//range of rows a scan can match, derived from predicates on the first row key column.
+//Rows are encoded with BinarySortableSerDe, so they sort like the key columns. A bound
+//only holds the encoding of the first column and is compared to the prefix of a row
+//of the same length, so e.g. all rows whose first column equals the lower bound are
+//inside the range.
+class RowKeyRange
+{
+public:
+	RowKeyRange(): has_lower_(false), has_upper_(false) {}
+
+	//narrows the range to rows whose first column is >= (<=) the encoded value 'key'.
+	void SetLower(const std::string& key);
+	void SetUpper(const std::string& key);
+
+	bool has_lower() const { return has_lower_; }
+	bool has_upper() const { return has_upper_; }
+
+	//returns false if no row in [first_row, next_first_row) is in the range.
+	//'next_first_row' is NULL if there is no upper limit, e.g. for the last segment.
+	bool MayContain(const std::string& first_row, const std::string* next_first_row) const;
+
+	//BinarySortableSerDe encoding of a non-null integer value as first key column.
+	//Returns false if 'type' is not an integer type.
+	static bool EncodeInt(impala::PrimitiveType type, int64_t value, std::string* key);
+
+	//BinarySortableSerDe encoding of a non-null string value as first key column.
+	static void EncodeString(const char* ptr, int len, std::string* key);
+
+private:
+	bool has_lower_;
+	bool has_upper_;
+	std::string lower_;
+	std::string upper_;
+};
+
 }
 
 #endif /* HFILE_TYPES_H_ */
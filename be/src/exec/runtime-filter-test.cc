@@ -0,0 +1,135 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/object-pool.h"
+#include "exec/exec-node-test-util.h"
+#include "exec/runtime-filter.h"
+#include "runtime/descriptors.h"
+#include "runtime/string-value.h"
+
+using namespace std;
+
+namespace impala {
+
+class RuntimeFilterTest : public testing::Test {
+ protected:
+  ObjectPool pool_;
+  DescriptorTbl* desc_tbl_;
+
+  // Creates a tuple with a nullable bigint slot (id 0) at offset 8 and a nullable
+  // string slot (id 1) at offset 16.  The null indicators are in byte 0.
+  virtual void SetUp() {
+    vector<vector<TPrimitiveType::type> > tuple_slot_types(1);
+    tuple_slot_types[0].push_back(TPrimitiveType::BIGINT);
+    tuple_slot_types[0].push_back(TPrimitiveType::STRING);
+    CreateDescTbl(&pool_, tuple_slot_types, true, &desc_tbl_);
+  }
+};
+
+TEST_F(RuntimeFilterTest, IntFilter) {
+  const int NUM_VALUES = 10000;
+  RuntimeFilter filter(1, desc_tbl_->GetSlotDescriptor(0), NUM_VALUES);
+  EXPECT_TRUE(filter.has_range());
+
+  // An empty filter rejects everything
+  int64_t v = 10;
+  EXPECT_FALSE(filter.Find(&v));
+  EXPECT_TRUE(filter.RangeExcluded(0, 100));
+
+  // Insert the even numbers in [1000, 1000 + 2 * NUM_VALUES)
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    v = 1000 + 2 * i;
+    filter.Insert(&v);
+  }
+  filter.Insert(NULL);
+  EXPECT_EQ(filter.num_values(), NUM_VALUES);
+  EXPECT_EQ(filter.min_value(), 1000);
+  EXPECT_EQ(filter.max_value(), 1000 + 2 * (NUM_VALUES - 1));
+
+  // No false negatives
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    v = 1000 + 2 * i;
+    EXPECT_TRUE(filter.Find(&v)) << v;
+  }
+  EXPECT_FALSE(filter.Find(NULL));
+
+  // Values outside the range are always rejected, most odd values in the range are
+  // rejected by the bloom filter.
+  v = 999;
+  EXPECT_FALSE(filter.Find(&v));
+  v = 1000 + 2 * NUM_VALUES;
+  EXPECT_FALSE(filter.Find(&v));
+  int num_false_positives = 0;
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    v = 1001 + 2 * i;
+    if (filter.Find(&v)) ++num_false_positives;
+  }
+  EXPECT_LT(num_false_positives, NUM_VALUES / 10);
+
+  EXPECT_TRUE(filter.RangeExcluded(0, 999));
+  EXPECT_TRUE(filter.RangeExcluded(1000 + 2 * NUM_VALUES, 1000000));
+  EXPECT_FALSE(filter.RangeExcluded(0, 1000));
+  EXPECT_FALSE(filter.RangeExcluded(5000, 6000));
+}
+
+TEST_F(RuntimeFilterTest, StringFilter) {
+  RuntimeFilter filter(1, desc_tbl_->GetSlotDescriptor(1), 100);
+  EXPECT_FALSE(filter.has_range());
+
+  vector<string> strings;
+  for (int i = 0; i < 100; ++i) {
+    strings.push_back(string("value") + static_cast<char>('a' + i % 26) +
+        static_cast<char>('a' + i / 26));
+  }
+  for (int i = 0; i < strings.size(); ++i) {
+    StringValue sv(const_cast<char*>(strings[i].data()), strings[i].size());
+    filter.Insert(&sv);
+  }
+  for (int i = 0; i < strings.size(); ++i) {
+    string copy = strings[i];
+    StringValue sv(const_cast<char*>(copy.data()), copy.size());
+    EXPECT_TRUE(filter.Find(&sv)) << copy;
+  }
+}
+
+TEST_F(RuntimeFilterTest, TupleFilter) {
+  RuntimeFilter filter(1, desc_tbl_->GetSlotDescriptor(0), 1);
+  int64_t v = 42;
+  filter.Insert(&v);
+
+  uint8_t tuple_mem[16 + sizeof(StringValue)];
+  memset(tuple_mem, 0, sizeof(tuple_mem));
+  Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem);
+  *reinterpret_cast<int64_t*>(tuple_mem + 8) = 42;
+  EXPECT_TRUE(filter.Find(tuple));
+  *reinterpret_cast<int64_t*>(tuple_mem + 8) = 43;
+  EXPECT_FALSE(filter.Find(tuple));
+
+  // NULL slots are rejected
+  *reinterpret_cast<int64_t*>(tuple_mem + 8) = 42;
+  tuple->SetNull(desc_tbl_->GetSlotDescriptor(0)->null_indicator_offset());
+  EXPECT_FALSE(filter.Find(tuple));
+}
+
+}
+
+int main(int argc, char **argv) {
+  impala::InitExecNodeTest(&argc, &argv);
+  return RUN_ALL_TESTS();
+}
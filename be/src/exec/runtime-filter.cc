@@ -0,0 +1,102 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/runtime-filter.h"
+
+#include <limits>
+#include <sstream>
+
+#include "runtime/raw-value.h"
+
+using namespace impala;
+using namespace std;
+
+RuntimeFilter::RuntimeFilter(int join_node_id, const SlotDescriptor* slot,
+    int64_t expected_num_values)
+  : join_node_id_(join_node_id),
+    slot_(slot),
+    type_(slot->type()),
+    has_range_(type_ == TYPE_TINYINT || type_ == TYPE_SMALLINT ||
+        type_ == TYPE_INT || type_ == TYPE_BIGINT),
+    num_values_(0),
+    min_value_(numeric_limits<int64_t>::max()),
+    max_value_(numeric_limits<int64_t>::min()),
+    rows_rejected_counter_(NULL) {
+  int64_t num_bits = MIN_NUM_BITS;
+  while (num_bits < expected_num_values * BITS_PER_VALUE &&
+      num_bits < (1LL << 32)) {
+    num_bits *= 2;
+  }
+  bits_.resize(num_bits / 64, 0);
+  bit_mask_ = num_bits - 1;
+}
+
+int64_t RuntimeFilter::GetIntValue(const void* value) const {
+  switch (type_) {
+    case TYPE_TINYINT:
+      return *reinterpret_cast<const int8_t*>(value);
+    case TYPE_SMALLINT:
+      return *reinterpret_cast<const int16_t*>(value);
+    case TYPE_INT:
+      return *reinterpret_cast<const int32_t*>(value);
+    case TYPE_BIGINT:
+      return *reinterpret_cast<const int64_t*>(value);
+    default:
+      DCHECK(false) << "not an integer type: " << TypeToString(type_);
+      return 0;
+  }
+}
+
+void RuntimeFilter::Insert(const void* value) {
+  if (value == NULL) return;
+  ++num_values_;
+  if (has_range_) {
+    int64_t v = GetIntValue(value);
+    if (v < min_value_) min_value_ = v;
+    if (v > max_value_) max_value_ = v;
+  }
+  uint64_t bit_idx[NUM_HASHES];
+  GetBitIndexes(RawValue::GetHashValue(value, type_), bit_idx);
+  for (int i = 0; i < NUM_HASHES; ++i) {
+    bits_[bit_idx[i] >> 6] |= 1ULL << (bit_idx[i] & 63);
+  }
+}
+
+bool RuntimeFilter::Find(const void* value) const {
+  if (value == NULL || num_values_ == 0) return false;
+  if (has_range_) {
+    int64_t v = GetIntValue(value);
+    if (v < min_value_ || v > max_value_) return false;
+  }
+  uint64_t bit_idx[NUM_HASHES];
+  GetBitIndexes(RawValue::GetHashValue(value, type_), bit_idx);
+  for (int i = 0; i < NUM_HASHES; ++i) {
+    if ((bits_[bit_idx[i] >> 6] & (1ULL << (bit_idx[i] & 63))) == 0) return false;
+  }
+  return true;
+}
+
+string RuntimeFilter::DebugString() const {
+  stringstream out;
+  out << "RuntimeFilter(join_node_id=" << join_node_id_
+      << " slot_id=" << slot_->id()
+      << " type=" << TypeToString(type_)
+      << " num_values=" << num_values_
+      << " num_bits=" << (bit_mask_ + 1);
+  if (has_range_ && num_values_ > 0) {
+    out << " min=" << min_value_ << " max=" << max_value_;
+  }
+  out << ")";
+  return out.str();
+}
@@ -0,0 +1,124 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXEC_RUNTIME_FILTER_H
+#define IMPALA_EXEC_RUNTIME_FILTER_H
+
+#include <string>
+#include <vector>
+
+#include "runtime/descriptors.h"
+#include "runtime/tuple.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+// A filter over the values of one equi-join key, built from the build side of a hash
+// join and applied to the tuples produced by a scan on its probe side (see
+// HashJoinNode and HdfsScanNode::AddRuntimeFilter()).
+// The filter is a bloom filter over the hashes of the build values: Find() never
+// rejects a value that was inserted, but may accept values that were not.  For
+// integer keys, it also tracks the min and max build value so that scanners can skip
+// data whose column statistics lie outside that range.
+// NULL keys never match an equi-join, so they are not inserted and always rejected.
+// The filter must not be modified once it is handed to a scan node; after that it can
+// be read from multiple threads.
+class RuntimeFilter {
+ public:
+  // 'slot' is the probe side slot the filter is applied to.  'expected_num_values' is
+  // the (approximate) number of build values and is used to size the bloom filter.
+  RuntimeFilter(int join_node_id, const SlotDescriptor* slot,
+      int64_t expected_num_values);
+
+  // Adds a build side value of the slot's type.  NULL values are ignored.
+  void Insert(const void* value);
+
+  // Returns false if no inserted value can be equal to 'value'.  Always returns false
+  // for NULL.
+  bool Find(const void* value) const;
+
+  // Returns false if the slot value of 'tuple' is NULL or not in the filter.
+  bool Find(const Tuple* tuple) const {
+    if (tuple->IsNull(slot_->null_indicator_offset())) return false;
+    return Find(tuple->GetSlot(slot_->tuple_offset()));
+  }
+
+  // Returns true if the min/max range of the inserted values is known, i.e. the slot
+  // is an integer type.
+  bool has_range() const { return has_range_; }
+
+  // Returns true if none of the inserted values lie in ['min', 'max'].  Only valid if
+  // has_range().
+  bool RangeExcluded(int64_t min, int64_t max) const {
+    DCHECK(has_range_);
+    return num_values_ == 0 || max < min_value_ || min > max_value_;
+  }
+
+  int join_node_id() const { return join_node_id_; }
+  const SlotDescriptor* slot() const { return slot_; }
+  int64_t num_values() const { return num_values_; }
+  int64_t min_value() const { return min_value_; }
+  int64_t max_value() const { return max_value_; }
+
+  // Counter for the number of probe rows this filter rejected, set by the scan node
+  // the filter is applied to.  NULL if not set.
+  RuntimeProfile::Counter* rows_rejected_counter() const {
+    return rows_rejected_counter_;
+  }
+  void set_rows_rejected_counter(RuntimeProfile::Counter* counter) {
+    rows_rejected_counter_ = counter;
+  }
+
+  std::string DebugString() const;
+
+ private:
+  // Number of bits set per value.  With BITS_PER_VALUE bits per value this gives a
+  // false positive rate of about 3%.
+  static const int NUM_HASHES = 3;
+  static const int BITS_PER_VALUE = 8;
+  static const int MIN_NUM_BITS = 1024;
+
+  const int join_node_id_;
+  const SlotDescriptor* slot_;
+  const PrimitiveType type_;
+  const bool has_range_;
+
+  // The bloom filter.  The number of bits is a power of two.
+  std::vector<uint64_t> bits_;
+  uint64_t bit_mask_;
+
+  int64_t num_values_;
+  int64_t min_value_;
+  int64_t max_value_;
+
+  RuntimeProfile::Counter* rows_rejected_counter_;
+
+  // Returns the value of an integer slot as an int64_t.
+  int64_t GetIntValue(const void* value) const;
+
+  // Returns the NUM_HASHES bit positions of 'hash' in 'bit_idx'.  The positions are
+  // derived from 'hash' by double hashing.
+  void GetBitIndexes(uint32_t hash, uint64_t* bit_idx) const {
+    uint32_t delta = ((hash >> 17) | (hash << 15)) | 1;
+    for (int i = 0; i < NUM_HASHES; ++i) {
+      bit_idx[i] = hash & bit_mask_;
+      hash += delta;
+    }
+  }
+};
+
+}
+
+#endif
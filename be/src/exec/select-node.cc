@@ -27,6 +27,7 @@ SelectNode::SelectNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
     : ExecNode(pool, tnode, descs),
       child_row_batch_(NULL),
+      num_selected_rows_(0),
       child_row_idx_(0),
       child_eos_(false) {
 }
@@ -35,6 +36,8 @@ Status SelectNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   child_row_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size()));
+  child_rows_.resize(state->batch_size());
+  selected_rows_.resize(state->batch_size());
   return Status::OK;
 }
 
@@ -49,7 +52,7 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   RETURN_IF_CANCELLED(state);
   SCOPED_TIMER(runtime_profile_->total_time_counter());
 
-  if (ReachedLimit() || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_)) {
+  if (ReachedLimit() || (child_row_idx_ == num_selected_rows_ && child_eos_)) {
     // we're already done or we exhausted the last child batch and there won't be any
     // new ones
     *eos = true;
@@ -58,17 +61,17 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
 
   // start (or continue) consuming row batches from child
   while (true) {
-    if (child_row_idx_ == child_row_batch_->num_rows()) {
+    if (child_row_idx_ == num_selected_rows_) {
       // fetch next batch
       RETURN_IF_CANCELLED(state);
       child_row_batch_->Reset();
       RETURN_IF_ERROR(child(0)->GetNext(state, child_row_batch_.get(), &child_eos_));
-      child_row_idx_ = 0;
+      SelectChildRows();
     }
 
     if (CopyRows(row_batch)) {
       *eos = ReachedLimit()
-          || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_);
+          || (child_row_idx_ == num_selected_rows_ && child_eos_);
       return Status::OK;
     }
     if (child_eos_) {
@@ -80,24 +83,31 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   return Status::OK;
 }
 
-bool SelectNode::CopyRows(RowBatch* output_batch) {
-  Expr** conjuncts = &conjuncts_[0];
-  int num_conjuncts = conjuncts_.size();
+void SelectNode::SelectChildRows() {
+  int num_rows = child_row_batch_->num_rows();
+  DCHECK_LE(num_rows, static_cast<int>(child_rows_.size()));
+  for (int i = 0; i < num_rows; ++i) {
+    child_rows_[i] = child_row_batch_->GetRow(i);
+    selected_rows_[i] = i;
+  }
+  num_selected_rows_ = EvalConjuncts(&conjuncts_[0], conjuncts_.size(),
+      &child_rows_[0], &selected_rows_[0], num_rows);
+  child_row_idx_ = 0;
+}
 
-  for (; child_row_idx_ < child_row_batch_->num_rows(); ++child_row_idx_) {
+bool SelectNode::CopyRows(RowBatch* output_batch) {
+  for (; child_row_idx_ < num_selected_rows_; ++child_row_idx_) {
     // Add a new row to output_batch
     int dst_row_idx = output_batch->AddRow();
     if (dst_row_idx == RowBatch::INVALID_ROW_INDEX) return true;
     TupleRow* dst_row = output_batch->GetRow(dst_row_idx);
-    TupleRow* src_row = child_row_batch_->GetRow(child_row_idx_);
+    TupleRow* src_row = child_rows_[selected_rows_[child_row_idx_]];
 
-    if (EvalConjuncts(conjuncts, num_conjuncts, src_row)) {
-      output_batch->CopyRow(src_row, dst_row);
-      output_batch->CommitLastRow();
-      ++num_rows_returned_;
-      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
-      if (ReachedLimit()) return true;
-    }
+    output_batch->CopyRow(src_row, dst_row);
+    output_batch->CommitLastRow();
+    ++num_rows_returned_;
+    COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+    if (ReachedLimit()) return true;
   }
   return output_batch->IsFull() || output_batch->AtResourceLimit();
 }
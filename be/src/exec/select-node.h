@@ -42,14 +42,24 @@ class SelectNode : public ExecNode {
   // current row batch of child
   boost::scoped_ptr<RowBatch> child_row_batch_;
 
-  // index of current row in child_row_batch_
+  // Rows of child_row_batch_
+  std::vector<TupleRow*> child_rows_;
+
+  // Indices of the rows of child_row_batch_ that passed the conjuncts
+  std::vector<int> selected_rows_;
+  int num_selected_rows_;
+
+  // index of current row in selected_rows_
   int child_row_idx_;
 
   // true if last GetNext() call on child signalled eos
   bool child_eos_;
 
-  // Copy rows from child_row_batch_ for which conjuncts_ evaluate to true to
-  // output_batch, up to limit_.
+  // Evaluates conjuncts_ over child_row_batch_ a batch at a time and sets
+  // selected_rows_ to the rows that passed.
+  void SelectChildRows();
+
+  // Copy the selected rows from child_row_batch_ to output_batch, up to limit_.
   // Return true if limit was hit or output_batch should be returned, otherwise false.
   bool CopyRows(RowBatch* output_batch);
 };
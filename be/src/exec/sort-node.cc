@@ -0,0 +1,691 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/sort-node.h"
+
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <gflags/gflags.h>
+
+#include "codegen/llvm-codegen.h"
+#include "exprs/expr.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/mem-pool.h"
+#include "runtime/raw-value.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/spill-file.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple-row.h"
+#include "util/debug-util.h"
+#include "util/runtime-profile.h"
+
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+
+DEFINE_bool(enable_sort_spilling, true, "If true, sort nodes write sorted runs to "
+    "the --scratch_dirs when they exceed the memory limit and merge them afterwards.");
+
+using namespace impala;
+using namespace llvm;
+using namespace std;
+
+// Number of normalized key bytes for a string value
+static const int STRING_KEY_PREFIX_SIZE = 8;
+
+// Returns the number of normalized key bytes for a value of 'type', or 0 if values
+// of the type can't be part of the key.
+static int NormalizedValueSize(PrimitiveType type) {
+  switch (type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+      return 1;
+    case TYPE_SMALLINT:
+      return 2;
+    case TYPE_INT:
+    case TYPE_FLOAT:
+      return 4;
+    case TYPE_BIGINT:
+    case TYPE_DOUBLE:
+      return 8;
+    case TYPE_STRING:
+      return STRING_KEY_PREFIX_SIZE;
+    default:
+      return 0;
+  }
+}
+
+// Writes the 'len' low order bytes of 'value' to 'dst', most significant byte first.
+static inline void WriteBigEndian(uint64_t value, int len, uint8_t* dst) {
+  for (int i = len - 1; i >= 0; --i) {
+    dst[i] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static inline uint64_t ReadBigEndian(const uint8_t* src) {
+  uint64_t value = 0;
+  for (int i = 0; i < sizeof(uint64_t); ++i) {
+    value = (value << 8) | src[i];
+  }
+  return value;
+}
+
+SortNode::SortNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
+  : ExecNode(pool, tnode, descs),
+    key_size_(0),
+    num_key_exprs_(0),
+    key_exact_(false),
+    codegen_compare_fn_(NULL),
+    compare_fn_(NULL),
+    run_pool_(new MemPool()),
+    next_sorted_idx_(0),
+    offset_(0),
+    num_rows_skipped_(0),
+    sort_timer_(NULL),
+    merge_timer_(NULL),
+    spilled_bytes_counter_(NULL),
+    spilled_runs_counter_(NULL),
+    intermediate_merges_counter_(NULL) {
+  // TODO: log errors in runtime state
+  Status status = Init(pool, tnode);
+  DCHECK(status.ok()) << "SortNode c'tor:Init failed: \n" << status.GetErrorMsg();
+}
+
+Status SortNode::Init(ObjectPool* pool, const TPlanNode& tnode) {
+  RETURN_IF_ERROR(
+      Expr::CreateExprTrees(pool, tnode.sort_node.ordering_exprs, &lhs_ordering_exprs_));
+  RETURN_IF_ERROR(
+      Expr::CreateExprTrees(pool, tnode.sort_node.ordering_exprs, &rhs_ordering_exprs_));
+  is_asc_order_.insert(
+      is_asc_order_.begin(), tnode.sort_node.is_asc_order.begin(),
+      tnode.sort_node.is_asc_order.end());
+  if (tnode.sort_node.__isset.offset) offset_ = tnode.sort_node.offset;
+  DCHECK_EQ(conjuncts_.size(), 0) << "SortNode should never have predicates to evaluate.";
+  return Status::OK;
+}
+
+Status SortNode::Prepare(RuntimeState* state) {
+  RETURN_IF_ERROR(ExecNode::Prepare(state));
+  sort_timer_ = ADD_TIMER(runtime_profile(), "SortTime");
+  merge_timer_ = ADD_TIMER(runtime_profile(), "MergeTime");
+  spilled_bytes_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledBytes", TCounterType::BYTES);
+  spilled_runs_counter_ =
+      ADD_COUNTER(runtime_profile(), "SpilledRuns", TCounterType::UNIT);
+  intermediate_merges_counter_ =
+      ADD_COUNTER(runtime_profile(), "IntermediateMerges", TCounterType::UNIT);
+
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  tuple_descs_ = child(0)->row_desc().tuple_descriptors();
+  RETURN_IF_ERROR(Expr::Prepare(lhs_ordering_exprs_, state, child(0)->row_desc()));
+  RETURN_IF_ERROR(Expr::Prepare(rhs_ordering_exprs_, state, child(0)->row_desc()));
+  run_pool_->set_limits(mem_trackers_);
+  InitNormalizedKey();
+
+  LlvmCodeGen* codegen = state->llvm_codegen();
+  if (codegen != NULL) codegen_compare_fn_ = CodegenCompare(codegen);
+  return Status::OK;
+}
+
+Status SortNode::Open(RuntimeState* state) {
+  RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::OPEN));
+  RETURN_IF_CANCELLED(state);
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  RETURN_IF_ERROR(child(0)->Open(state));
+
+  if (codegen_compare_fn_ != NULL) {
+    compare_fn_ = reinterpret_cast<CompareFn>(
+        state->llvm_codegen()->JitFunction(codegen_compare_fn_));
+    AddRuntimeExecOption("Codegen Enabled");
+  }
+
+  // Limit of 0, no need to fetch anything from children.
+  if (limit_ != 0) {
+    RowBatch batch(child(0)->row_desc(), state->batch_size());
+    bool eos;
+    do {
+      RETURN_IF_CANCELLED(state);
+      batch.Reset();
+      RETURN_IF_ERROR(child(0)->GetNext(state, &batch, &eos));
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        AddToRun(batch.GetRow(i));
+      }
+      if (FLAGS_enable_sort_spilling && !sorted_run_.empty() &&
+          MemTracker::LimitExceeded(mem_trackers_)) {
+        RETURN_IF_ERROR(SpillRun(state));
+      }
+      RETURN_IF_LIMIT_EXCEEDED(state);
+    } while (!eos);
+  }
+
+  if (spilled_runs_.empty()) {
+    SortRun();
+    return Status::OK;
+  }
+
+  // Spill the last run as well if it can't be part of the final merge.  That also
+  // frees its memory for the intermediate merges.
+  if (spilled_runs_.size() >= MAX_MERGE_WIDTH && !sorted_run_.empty()) {
+    RETURN_IF_ERROR(SpillRun(state));
+  }
+  while (spilled_runs_.size() > MAX_MERGE_WIDTH) {
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(MergeIntermediateRuns(state));
+  }
+  SortRun();
+  vector<SpillFile*> runs(spilled_runs_.begin(), spilled_runs_.end());
+  spilled_runs_.clear();
+  return InitMerge(runs, !sorted_run_.empty());
+}
+
+Status SortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
+  RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT));
+  RETURN_IF_CANCELLED(state);
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  if (merge_inputs_.empty()) {
+    if (num_rows_skipped_ < offset_) {
+      int64_t num_skipped = min<int64_t>(offset_ - num_rows_skipped_,
+          sorted_run_.size() - next_sorted_idx_);
+      next_sorted_idx_ += num_skipped;
+      num_rows_skipped_ += num_skipped;
+    }
+    while (!row_batch->IsFull() && !ReachedLimit() &&
+        next_sorted_idx_ < sorted_run_.size()) {
+      int row_idx = row_batch->AddRow();
+      row_batch->CopyRow(sorted_run_[next_sorted_idx_].row, row_batch->GetRow(row_idx));
+      row_batch->CommitLastRow();
+      ++next_sorted_idx_;
+      ++num_rows_returned_;
+    }
+    *eos = ReachedLimit() || next_sorted_idx_ == sorted_run_.size();
+  } else {
+    SCOPED_TIMER(merge_timer_);
+    MergeInput* input = merge_inputs_[merge_tree_->winner()];
+    while (num_rows_skipped_ < offset_ && input->current != NULL) {
+      RETURN_IF_ERROR(AdvanceMergeInput(input, row_batch));
+      merge_tree_->Update();
+      input = merge_inputs_[merge_tree_->winner()];
+      ++num_rows_skipped_;
+      if (row_batch->AtResourceLimit()) {
+        *eos = input->current == NULL;
+        return Status::OK;
+      }
+    }
+    while (input->current != NULL && !row_batch->IsFull() && !ReachedLimit()) {
+      int row_idx = row_batch->AddRow();
+      row_batch->CopyRow(input->current, row_batch->GetRow(row_idx));
+      row_batch->CommitLastRow();
+      ++num_rows_returned_;
+      RETURN_IF_ERROR(AdvanceMergeInput(input, row_batch));
+      merge_tree_->Update();
+      input = merge_inputs_[merge_tree_->winner()];
+      if (row_batch->AtResourceLimit()) break;
+    }
+    *eos = ReachedLimit() || input->current == NULL;
+  }
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  return Status::OK;
+}
+
+Status SortNode::Close(RuntimeState* state) {
+  CloseMergeInputs();
+  for (int i = 0; i < spilled_runs_.size(); ++i) {
+    spilled_runs_[i]->Close();
+  }
+  spilled_runs_.clear();
+  if (memory_used_counter() != NULL) {
+    COUNTER_UPDATE(memory_used_counter(), run_pool_->peak_allocated_bytes());
+  }
+  return ExecNode::Close(state);
+}
+
+bool SortNode::SortEntryLessThan::operator()(const SortEntry& lhs, const SortEntry& rhs)
+    const {
+  if (lhs.key_prefix != rhs.key_prefix) return lhs.key_prefix < rhs.key_prefix;
+  int suffix_size = node_->key_size_ - sizeof(uint64_t);
+  if (suffix_size > 0) {
+    int result = memcmp(lhs.key_suffix, rhs.key_suffix, suffix_size);
+    if (result != 0) return result < 0;
+  }
+  if (node_->key_exact_) return false;
+  return node_->Compare(lhs.row, rhs.row) < 0;
+}
+
+bool SortNode::MergeInputLessThan::operator()(int lhs, int rhs) const {
+  TupleRow* lhs_row = node_->merge_inputs_[lhs]->current;
+  TupleRow* rhs_row = node_->merge_inputs_[rhs]->current;
+  // Exhausted inputs go last
+  if (lhs_row == NULL) return false;
+  if (rhs_row == NULL) return true;
+  return node_->Compare(lhs_row, rhs_row) < 0;
+}
+
+int SortNode::CompareInterpreted(TupleRow* lhs, TupleRow* rhs) {
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    void* lhs_value = lhs_ordering_exprs_[i]->GetValue(lhs);
+    void* rhs_value = rhs_ordering_exprs_[i]->GetValue(rhs);
+
+    // NULL's always go at the end regardless of asc/desc
+    if (lhs_value == NULL && rhs_value == NULL) continue;
+    if (lhs_value == NULL) return 1;
+    if (rhs_value == NULL) return -1;
+
+    int result = RawValue::Compare(lhs_value, rhs_value, lhs_ordering_exprs_[i]->type());
+    if (result != 0) return is_asc_order_[i] ? result : -result;
+    // Otherwise, try the next Expr
+  }
+  return 0;
+}
+
+// Returns an i1 that is true if lhs < rhs (less_than) or lhs > rhs (!less_than).
+static Value* CodegenCompareValues(LlvmCodeGen* codegen,
+    LlvmCodeGen::LlvmBuilder* builder, Value* lhs, Value* rhs, PrimitiveType type,
+    bool less_than) {
+  switch (type) {
+    case TYPE_BOOLEAN:
+      return less_than ? builder->CreateICmpULT(lhs, rhs, "tmp_lt") :
+          builder->CreateICmpUGT(lhs, rhs, "tmp_gt");
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+      return less_than ? builder->CreateICmpSLT(lhs, rhs, "tmp_lt") :
+          builder->CreateICmpSGT(lhs, rhs, "tmp_gt");
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      return less_than ? builder->CreateFCmpOLT(lhs, rhs, "tmp_lt") :
+          builder->CreateFCmpOGT(lhs, rhs, "tmp_gt");
+    case TYPE_STRING: {
+      Function* str_fn = codegen->GetFunction(
+          less_than ? IRFunction::STRING_VALUE_LT : IRFunction::STRING_VALUE_GT);
+      return builder->CreateCall2(str_fn, lhs, rhs, less_than ? "tmp_lt" : "tmp_gt");
+    }
+    default:
+      DCHECK(false);
+      return NULL;
+  }
+}
+
+// Codegen for CompareFn.  For an ordering on a single int column, the IR looks like:
+// define i32 @Compare(%"class.impala::TupleRow"* %lhs, %"class.impala::TupleRow"* %rhs) {
+// entry:
+//   %lhs_null_ptr = alloca i1
+//   %rhs_null_ptr = alloca i1
+//   %0 = bitcast %"class.impala::TupleRow"* %lhs to i8**
+//   %1 = bitcast %"class.impala::TupleRow"* %rhs to i8**
+//   %lhs_val = call i32 @SlotRef(i8** %0, i8* null, i1* %lhs_null_ptr)
+//   %lhs_is_null = load i1* %lhs_null_ptr
+//   %rhs_val = call i32 @SlotRef1(i8** %1, i8* null, i1* %rhs_null_ptr)
+//   %rhs_is_null = load i1* %rhs_null_ptr
+//   br i1 %lhs_is_null, label %lhs_null, label %lhs_not_null
+//
+// lhs_null:                                         ; preds = %entry
+//   br i1 %rhs_is_null, label %next, label %greater
+//
+// lhs_not_null:                                     ; preds = %entry
+//   br i1 %rhs_is_null, label %less, label %cmp
+//
+// cmp:                                              ; preds = %lhs_not_null
+//   %tmp_lt = icmp slt i32 %lhs_val, %rhs_val
+//   br i1 %tmp_lt, label %less, label %cmp_gt
+//
+// cmp_gt:                                           ; preds = %cmp
+//   %tmp_gt = icmp sgt i32 %lhs_val, %rhs_val
+//   br i1 %tmp_gt, label %greater, label %next
+//
+// next:                                             ; preds = %cmp_gt, %lhs_null
+//   ret i32 0
+//
+// less:                                             ; preds = %cmp, %lhs_not_null
+//   ret i32 -1
+//
+// greater:                                          ; preds = %cmp_gt, %lhs_null
+//   ret i32 1
+// }
+Function* SortNode::CodegenCompare(LlvmCodeGen* codegen) {
+  if (!Expr::IsCodegenAvailable(lhs_ordering_exprs_) ||
+      !Expr::IsCodegenAvailable(rhs_ordering_exprs_)) {
+    VLOG_QUERY << "Could not codegen Compare because one of the ordering exprs "
+               << "could not be codegen'd.";
+    return NULL;
+  }
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    if (lhs_ordering_exprs_[i]->type() == TYPE_TIMESTAMP) {
+      VLOG_QUERY << "Could not codegen Compare because timestamp codegen is NYI.";
+      return NULL;
+    }
+  }
+
+  // Get types to generate function prototype
+  Type* tuple_row_type = codegen->GetType(TupleRow::LLVM_CLASS_NAME);
+  DCHECK(tuple_row_type != NULL);
+  PointerType* tuple_row_ptr_type = PointerType::get(tuple_row_type, 0);
+
+  LlvmCodeGen::FnPrototype prototype(codegen, "Compare", codegen->GetType(TYPE_INT));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("lhs", tuple_row_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("rhs", tuple_row_ptr_type));
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Value* args[2];
+  Function* fn = prototype.GeneratePrototype(&builder, args);
+
+  LlvmCodeGen::NamedVariable lhs_null_var("lhs_null_ptr", codegen->boolean_type());
+  LlvmCodeGen::NamedVariable rhs_null_var("rhs_null_ptr", codegen->boolean_type());
+  Value* lhs_null_ptr = codegen->CreateEntryBlockAlloca(fn, lhs_null_var);
+  Value* rhs_null_ptr = codegen->CreateEntryBlockAlloca(fn, rhs_null_var);
+
+  Type* tuple_row_llvm_type = PointerType::get(codegen->ptr_type(), 0);
+  Value* lhs_row = builder.CreateBitCast(args[0], tuple_row_llvm_type);
+  Value* rhs_row = builder.CreateBitCast(args[1], tuple_row_llvm_type);
+
+  BasicBlock* less_block = BasicBlock::Create(context, "less", fn);
+  BasicBlock* greater_block = BasicBlock::Create(context, "greater", fn);
+
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    PrimitiveType type = lhs_ordering_exprs_[i]->type();
+    BasicBlock* lhs_null_block = BasicBlock::Create(context, "lhs_null", fn);
+    BasicBlock* lhs_not_null_block = BasicBlock::Create(context, "lhs_not_null", fn);
+    BasicBlock* cmp_block = BasicBlock::Create(context, "cmp", fn);
+    BasicBlock* cmp_gt_block = BasicBlock::Create(context, "cmp_gt", fn);
+    BasicBlock* next_block = BasicBlock::Create(context, "next", fn);
+
+    Value* lhs_args[] = { lhs_row, codegen->null_ptr_value(), lhs_null_ptr };
+    Value* lhs_val =
+        builder.CreateCall(lhs_ordering_exprs_[i]->codegen_fn(), lhs_args, "lhs_val");
+    Value* lhs_is_null = builder.CreateLoad(lhs_null_ptr, "lhs_is_null");
+    Value* rhs_args[] = { rhs_row, codegen->null_ptr_value(), rhs_null_ptr };
+    Value* rhs_val =
+        builder.CreateCall(rhs_ordering_exprs_[i]->codegen_fn(), rhs_args, "rhs_val");
+    Value* rhs_is_null = builder.CreateLoad(rhs_null_ptr, "rhs_is_null");
+    builder.CreateCondBr(lhs_is_null, lhs_null_block, lhs_not_null_block);
+
+    // NULL's always go at the end regardless of asc/desc
+    builder.SetInsertPoint(lhs_null_block);
+    builder.CreateCondBr(rhs_is_null, next_block, greater_block);
+    builder.SetInsertPoint(lhs_not_null_block);
+    builder.CreateCondBr(rhs_is_null, less_block, cmp_block);
+
+    BasicBlock* lt_block = is_asc_order_[i] ? less_block : greater_block;
+    BasicBlock* gt_block = is_asc_order_[i] ? greater_block : less_block;
+    builder.SetInsertPoint(cmp_block);
+    Value* is_lt = CodegenCompareValues(codegen, &builder, lhs_val, rhs_val, type, true);
+    builder.CreateCondBr(is_lt, lt_block, cmp_gt_block);
+    builder.SetInsertPoint(cmp_gt_block);
+    Value* is_gt = CodegenCompareValues(codegen, &builder, lhs_val, rhs_val, type, false);
+    builder.CreateCondBr(is_gt, gt_block, next_block);
+
+    builder.SetInsertPoint(next_block);
+  }
+  builder.CreateRet(codegen->GetIntConstant(TYPE_INT, 0));
+
+  builder.SetInsertPoint(less_block);
+  builder.CreateRet(codegen->GetIntConstant(TYPE_INT, -1));
+  builder.SetInsertPoint(greater_block);
+  builder.CreateRet(codegen->GetIntConstant(TYPE_INT, 1));
+
+  return codegen->FinalizeFunction(fn);
+}
+
+void SortNode::InitNormalizedKey() {
+  int size = 0;
+  num_key_exprs_ = 0;
+  key_exact_ = true;
+  for (int i = 0; i < lhs_ordering_exprs_.size(); ++i) {
+    PrimitiveType type = lhs_ordering_exprs_[i]->type();
+    int value_size = NormalizedValueSize(type);
+    if (value_size == 0 || size + 1 + value_size > MAX_KEY_SIZE) {
+      key_exact_ = false;
+      break;
+    }
+    size += 1 + value_size;
+    ++num_key_exprs_;
+    // Only a prefix of the string is part of the key, so the following exprs can't be.
+    if (type == TYPE_STRING) {
+      key_exact_ = false;
+      break;
+    }
+  }
+  key_size_ = max(size, static_cast<int>(sizeof(uint64_t)));
+  key_buffer_.resize(key_size_);
+}
+
+void SortNode::NormalizeKey(TupleRow* row, uint8_t* key) {
+  memset(key, 0, key_size_);
+  for (int i = 0; i < num_key_exprs_; ++i) {
+    Expr* expr = lhs_ordering_exprs_[i];
+    int value_size = NormalizedValueSize(expr->type());
+    void* value = expr->GetValue(row);
+    // NULLs sort last for both asc and desc, so the null byte is never inverted.
+    *key++ = value == NULL;
+    if (value == NULL) {
+      key += value_size;
+      continue;
+    }
+
+    switch (expr->type()) {
+      case TYPE_BOOLEAN:
+        *key = *reinterpret_cast<bool*>(value);
+        break;
+      case TYPE_TINYINT:
+        *key = static_cast<uint8_t>(*reinterpret_cast<int8_t*>(value)) ^ 0x80;
+        break;
+      case TYPE_SMALLINT:
+        WriteBigEndian(
+            static_cast<uint16_t>(*reinterpret_cast<int16_t*>(value)) ^ 0x8000, 2, key);
+        break;
+      case TYPE_INT:
+        WriteBigEndian(
+            static_cast<uint32_t>(*reinterpret_cast<int32_t*>(value)) ^ 0x80000000U,
+            4, key);
+        break;
+      case TYPE_BIGINT:
+        WriteBigEndian(
+            static_cast<uint64_t>(*reinterpret_cast<int64_t*>(value)) ^ (1ULL << 63),
+            8, key);
+        break;
+      case TYPE_FLOAT: {
+        // Negative values are ordered by their inverted bits, positive values by their
+        // bits with the sign bit set.
+        uint32_t bits;
+        memcpy(&bits, value, sizeof(bits));
+        bits = (bits & 0x80000000U) ? ~bits : bits | 0x80000000U;
+        WriteBigEndian(bits, 4, key);
+        break;
+      }
+      case TYPE_DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, value, sizeof(bits));
+        bits = (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+        WriteBigEndian(bits, 8, key);
+        break;
+      }
+      case TYPE_STRING: {
+        // Shorter strings are padded with 0 bytes; the key is not exact in that case.
+        StringValue* sv = reinterpret_cast<StringValue*>(value);
+        memcpy(key, sv->ptr, min(sv->len, value_size));
+        break;
+      }
+      default:
+        DCHECK(false) << "Invalid type for normalized key: " << expr->type();
+    }
+    if (!is_asc_order_[i]) {
+      for (int j = 0; j < value_size; ++j) key[j] = ~key[j];
+    }
+    key += value_size;
+  }
+}
+
+void SortNode::AddToRun(TupleRow* row) {
+  SortEntry entry;
+  entry.row = row->DeepCopy(tuple_descs_, run_pool_.get());
+  uint8_t* key = &key_buffer_[0];
+  NormalizeKey(entry.row, key);
+  entry.key_prefix = ReadBigEndian(key);
+  entry.key_suffix = NULL;
+  int suffix_size = key_size_ - sizeof(uint64_t);
+  if (suffix_size > 0) {
+    entry.key_suffix = run_pool_->Allocate(suffix_size);
+    memcpy(entry.key_suffix, key + sizeof(uint64_t), suffix_size);
+  }
+  sorted_run_.push_back(entry);
+}
+
+void SortNode::SortRun() {
+  SCOPED_TIMER(sort_timer_);
+  sort(sorted_run_.begin(), sorted_run_.end(), SortEntryLessThan(this));
+}
+
+Status SortNode::SpillRun(RuntimeState* state) {
+  DCHECK(!sorted_run_.empty());
+  SortRun();
+  SpillFile* run =
+      pool_->Add(new SpillFile(state, child(0)->row_desc(), spilled_bytes_counter_));
+  // The rows only need to be shallow copied, serializing the batch copies the tuples.
+  RowBatch batch(child(0)->row_desc(), state->batch_size());
+  for (int i = 0; i < sorted_run_.size(); ++i) {
+    if (batch.IsFull()) {
+      RETURN_IF_ERROR(run->AddBatch(&batch));
+      batch.Reset();
+    }
+    int row_idx = batch.AddRow();
+    batch.CopyRow(sorted_run_[i].row, batch.GetRow(row_idx));
+    batch.CommitLastRow();
+  }
+  RETURN_IF_ERROR(run->AddBatch(&batch));
+  RETURN_IF_ERROR(run->PrepareForRead());
+
+  if (spilled_runs_.empty()) AddRuntimeExecOption("Spilled");
+  spilled_runs_.push_back(run);
+  COUNTER_UPDATE(spilled_runs_counter_, 1);
+  VLOG_FILE << "SortNode(id=" << id() << ") spilled run of " << run->num_rows()
+            << " rows to " << run->path();
+  ResetRunPool(state);
+  return Status::OK;
+}
+
+Status SortNode::MergeIntermediateRuns(RuntimeState* state) {
+  SCOPED_TIMER(merge_timer_);
+  DCHECK_GT(spilled_runs_.size(), static_cast<size_t>(MAX_MERGE_WIDTH));
+  vector<SpillFile*> runs(
+      spilled_runs_.begin(), spilled_runs_.begin() + MAX_MERGE_WIDTH);
+  spilled_runs_.erase(spilled_runs_.begin(), spilled_runs_.begin() + MAX_MERGE_WIDTH);
+  RETURN_IF_ERROR(InitMerge(runs, false));
+
+  SpillFile* merged_run =
+      pool_->Add(new SpillFile(state, child(0)->row_desc(), spilled_bytes_counter_));
+  RowBatch batch(child(0)->row_desc(), state->batch_size());
+  MergeInput* input = merge_inputs_[merge_tree_->winner()];
+  while (input->current != NULL) {
+    if (batch.IsFull() || batch.AtResourceLimit()) {
+      RETURN_IF_CANCELLED(state);
+      RETURN_IF_ERROR(merged_run->AddBatch(&batch));
+      batch.Reset();
+    }
+    int row_idx = batch.AddRow();
+    batch.CopyRow(input->current, batch.GetRow(row_idx));
+    batch.CommitLastRow();
+    RETURN_IF_ERROR(AdvanceMergeInput(input, &batch));
+    merge_tree_->Update();
+    input = merge_inputs_[merge_tree_->winner()];
+  }
+  RETURN_IF_ERROR(merged_run->AddBatch(&batch));
+  RETURN_IF_ERROR(merged_run->PrepareForRead());
+  CloseMergeInputs();
+
+  spilled_runs_.push_back(merged_run);
+  COUNTER_UPDATE(intermediate_merges_counter_, 1);
+  return Status::OK;
+}
+
+Status SortNode::InitMerge(const vector<SpillFile*>& runs, bool include_sorted_run) {
+  DCHECK(merge_inputs_.empty());
+  for (int i = 0; i < runs.size(); ++i) {
+    merge_inputs_.push_back(new MergeInput(runs[i]));
+    RETURN_IF_ERROR(AdvanceMergeInput(merge_inputs_.back(), NULL));
+  }
+  if (include_sorted_run) {
+    merge_inputs_.push_back(new MergeInput(NULL));
+    RETURN_IF_ERROR(AdvanceMergeInput(merge_inputs_.back(), NULL));
+  }
+  DCHECK(!merge_inputs_.empty());
+  merge_tree_.reset(new LoserTree<MergeInputLessThan>(
+      merge_inputs_.size(), MergeInputLessThan(this)));
+  merge_tree_->Init();
+  return Status::OK;
+}
+
+Status SortNode::AdvanceMergeInput(MergeInput* input, RowBatch* batch) {
+  ++input->idx;
+  if (input->run == NULL) {
+    input->current =
+        input->idx < sorted_run_.size() ? sorted_run_[input->idx].row : NULL;
+    return Status::OK;
+  }
+  if (input->batch != NULL) {
+    if (input->idx < input->batch->num_rows()) {
+      input->current = input->batch->GetRow(input->idx);
+      return Status::OK;
+    }
+    // The rows of this batch were copied to 'batch' and reference its tuple data.
+    DCHECK(batch != NULL);
+    input->batch->TransferResourceOwnership(batch);
+    delete input->batch;
+    input->batch = NULL;
+  }
+  input->idx = 0;
+  input->current = NULL;
+  RETURN_IF_ERROR(input->run->GetNext(&input->batch));
+  if (input->batch != NULL) {
+    DCHECK_GT(input->batch->num_rows(), 0);
+    input->current = input->batch->GetRow(0);
+  } else {
+    // Delete the scratch file as soon as possible.
+    input->run->Close();
+  }
+  return Status::OK;
+}
+
+void SortNode::CloseMergeInputs() {
+  for (int i = 0; i < merge_inputs_.size(); ++i) {
+    if (merge_inputs_[i]->run != NULL) merge_inputs_[i]->run->Close();
+    delete merge_inputs_[i]->batch;
+    delete merge_inputs_[i];
+  }
+  merge_inputs_.clear();
+  merge_tree_.reset();
+}
+
+void SortNode::ResetRunPool(RuntimeState* state) {
+  sorted_run_.clear();
+  run_pool_.reset(new MemPool());
+  run_pool_->set_limits(mem_trackers_);
+}
+
+void SortNode::DebugString(int indentation_level, stringstream* out) const {
+  *out << string(indentation_level * 2, ' ');
+  *out << "SortNode("
+       << " ordering_exprs=" << Expr::DebugString(lhs_ordering_exprs_)
+       << " sort_order=[";
+  for (int i = 0; i < is_asc_order_.size(); ++i) {
+    *out << (i > 0 ? " " : "") << (is_asc_order_[i] ? "asc" : "desc");
+  }
+  *out << "]";
+  if (offset_ != 0) *out << " offset=" << offset_;
+  ExecNode::DebugString(indentation_level, out);
+  *out << ")";
+}
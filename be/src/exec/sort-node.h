@@ -0,0 +1,225 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXEC_SORT_NODE_H
+#define IMPALA_EXEC_SORT_NODE_H
+
+#include <deque>
+#include <boost/scoped_ptr.hpp>
+
+#include "exec/exec-node.h"
+#include "runtime/descriptors.h"
+#include "util/loser-tree.h"
+
+namespace llvm {
+  class Function;
+}
+
+namespace impala {
+
+class LlvmCodeGen;
+class MemPool;
+class RowBatch;
+class RuntimeState;
+class SpillFile;
+class TupleRow;
+
+// Node for ORDER BY without a LIMIT (ORDER BY ... LIMIT is handled by TopNNode).
+// The input is consumed in Open() and deep copied into the current run.  For every
+// row, the node also computes a normalized key from the ordering exprs: a byte string
+// that memcmp()s in the same order as the rows (see NormalizeKey()).  A run is sorted
+// by comparing the keys and only falls back to evaluating the ordering exprs for rows
+// with equal keys, if the key does not capture the ordering exactly (e.g. for strings).
+// That comparison is codegen'd if possible.
+//
+// When the mem limit is hit, the current run is sorted and spilled to a SpillFile and
+// a new run is started.  If nothing was spilled, the output is returned directly from
+// the sorted in-memory run.  Otherwise the runs are combined with a k-way merge using a
+// loser tree, with at most MAX_MERGE_WIDTH runs merged at once; if there are more runs
+// than that, they are first merged into longer runs.
+class SortNode : public ExecNode {
+ public:
+  SortNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
+
+  virtual Status Prepare(RuntimeState* state);
+  virtual Status Open(RuntimeState* state);
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos);
+  virtual Status Close(RuntimeState* state);
+
+ protected:
+  virtual void DebugString(int indentation_level, std::stringstream* out) const;
+
+ private:
+  // Maximum number of runs that are merged at once.  Each run being merged holds one
+  // of its batches in memory.
+  static const int MAX_MERGE_WIDTH = 16;
+
+  // Maximum size of the normalized key in bytes
+  static const int MAX_KEY_SIZE = 32;
+
+  // A row of the current run.  The first 8 bytes of the normalized key are stored as
+  // an integer so most comparisons need neither a memcmp() nor a pointer chase.
+  struct SortEntry {
+    // Bytes [0, 8) of the normalized key, read as a big endian integer
+    uint64_t key_prefix;
+    // Bytes [8, key_size_) of the normalized key.  Allocated from run_pool_.
+    uint8_t* key_suffix;
+    TupleRow* row;
+  };
+
+  class SortEntryLessThan {
+   public:
+    SortEntryLessThan(SortNode* node) : node_(node) {}
+    bool operator()(const SortEntry& lhs, const SortEntry& rhs) const;
+
+   private:
+    SortNode* node_;
+  };
+
+  // A run that is being merged
+  struct MergeInput {
+    // NULL for the in-memory run
+    SpillFile* run;
+    // Batch of 'run' that contains 'current'.  Owned.
+    RowBatch* batch;
+    // Index of 'current' in 'batch', or in sorted_run_ for the in-memory run.
+    int idx;
+    // Row of the input that is next in the merge order.  NULL if the input is
+    // exhausted.
+    TupleRow* current;
+
+    MergeInput(SpillFile* run) : run(run), batch(NULL), idx(-1), current(NULL) { }
+  };
+
+  // Orders the merge inputs by their current rows, for the loser tree.
+  class MergeInputLessThan {
+   public:
+    MergeInputLessThan(SortNode* node) : node_(node) {}
+    bool operator()(int lhs, int rhs) const;
+
+   private:
+    SortNode* node_;
+  };
+
+  // Compares two rows by evaluating the ordering exprs.  Returns a negative value if
+  // lhs sorts before rhs, 0 if they are equal and a positive value otherwise.
+  // NULLs sort after all other values, regardless of the sort order.
+  typedef int (*CompareFn)(TupleRow* lhs, TupleRow* rhs);
+
+  Status Init(ObjectPool* pool, const TPlanNode& tnode);
+
+  // Interpreted version of CompareFn
+  int CompareInterpreted(TupleRow* lhs, TupleRow* rhs);
+
+  // Calls the codegen'd comparison function if there is one.
+  int Compare(TupleRow* lhs, TupleRow* rhs) {
+    return compare_fn_ != NULL ? compare_fn_(lhs, rhs) : CompareInterpreted(lhs, rhs);
+  }
+
+  // Codegen for CompareFn.  Returns NULL if one of the ordering exprs could not be
+  // codegen'd.
+  llvm::Function* CodegenCompare(LlvmCodeGen* codegen);
+
+  // Decides how many ordering exprs the normalized key covers and sets key_size_ and
+  // key_exact_.
+  void InitNormalizedKey();
+
+  // Writes the key_size_ bytes of the normalized key of 'row' to 'key'.  For every
+  // ordering expr (in order), the key contains a byte that is 1 iff the value is NULL,
+  // followed by the big endian value bytes, with the sign bit flipped for signed types
+  // so that a byte-wise comparison gives the numeric order.  The value bytes are
+  // inverted for descending exprs.  Strings contribute an 8 byte prefix and end the key.
+  void NormalizeKey(TupleRow* row, uint8_t* key);
+
+  // Deep copies 'row' into the current run.
+  void AddToRun(TupleRow* row);
+
+  // Sorts the rows of the current run.
+  void SortRun();
+
+  // Sorts the current run, writes it to a new spill file and starts a new run.
+  Status SpillRun(RuntimeState* state);
+
+  // Merges the first MAX_MERGE_WIDTH spilled runs into one new run.
+  Status MergeIntermediateRuns(RuntimeState* state);
+
+  // Sets up merge_inputs_ and merge_tree_ to merge 'runs' and, if 'include_sorted_run'
+  // is true, the sorted in-memory run.
+  Status InitMerge(const std::vector<SpillFile*>& runs, bool include_sorted_run);
+
+  // Moves 'input' to its next row.  Ownership of the resources of batches of 'input'
+  // that were completely consumed is transferred to 'batch'.
+  Status AdvanceMergeInput(MergeInput* input, RowBatch* batch);
+
+  // Deletes the merge inputs and closes their spill files.
+  void CloseMergeInputs();
+
+  // Frees the memory of the current run.
+  void ResetRunPool(RuntimeState* state);
+
+  // Create two copies of the exprs for evaluating over the TupleRows.
+  // The result of the evaluation is stored in the Expr, so it's not efficient to use
+  // one set of Expr to compare TupleRows.
+  std::vector<Expr*> lhs_ordering_exprs_;
+  std::vector<Expr*> rhs_ordering_exprs_;
+  std::vector<bool> is_asc_order_;
+
+  std::vector<TupleDescriptor*> tuple_descs_;
+
+  // Size of the normalized keys; at least 8, see SortEntry.
+  int key_size_;
+
+  // Number of ordering exprs that are (at least partially) part of the normalized key
+  int num_key_exprs_;
+
+  // True if two rows with equal normalized keys compare equal.
+  bool key_exact_;
+
+  // Buffer NormalizeKey() writes to
+  std::vector<uint8_t> key_buffer_;
+
+  llvm::Function* codegen_compare_fn_;
+  CompareFn compare_fn_;
+
+  // Rows of the current run, sorted by SortRun()
+  std::vector<SortEntry> sorted_run_;
+
+  // Stores the rows and keys of the current run
+  boost::scoped_ptr<MemPool> run_pool_;
+
+  // Sorted runs that were spilled, oldest first.  The SpillFiles are owned by pool_.
+  std::deque<SpillFile*> spilled_runs_;
+
+  // The runs of the current merge.  Empty if nothing was spilled.
+  std::vector<MergeInput*> merge_inputs_;
+  boost::scoped_ptr<LoserTree<MergeInputLessThan> > merge_tree_;
+
+  // Index of the next row in sorted_run_ to return if nothing was spilled.
+  int next_sorted_idx_;
+
+  // Number of rows to skip before returning rows, and number skipped so far
+  int64_t offset_;
+  int64_t num_rows_skipped_;
+
+  RuntimeProfile::Counter* sort_timer_;
+  RuntimeProfile::Counter* merge_timer_;
+  RuntimeProfile::Counter* spilled_bytes_counter_;
+  RuntimeProfile::Counter* spilled_runs_counter_;
+  RuntimeProfile::Counter* intermediate_merges_counter_;
+};
+
+}
+
+#endif
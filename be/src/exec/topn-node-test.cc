@@ -0,0 +1,264 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "exec/exec-node-test-util.h"
+#include "exec/topn-node.h"
+#include "runtime/exec-env.h"
+#include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
+#include "util/runtime-profile.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Exec node that returns one row per string of 'values', in order, in batches of at
+// most 'max_batch_rows' rows.  The rows consist of a single tuple with a STRING slot
+// that points into 'values'.
+class StringRowSourceNode : public ExecNode {
+ public:
+  StringRowSourceNode(ObjectPool* pool, int node_id, TTupleId tuple_id,
+      const DescriptorTbl& descs, const vector<string>& values, int max_batch_rows)
+    : ExecNode(pool, CreatePlanNode(node_id, TPlanNodeType::EXCHANGE_NODE,
+          vector<TTupleId>(1, tuple_id)), descs),
+      values_(values),
+      max_batch_rows_(max_batch_rows),
+      next_idx_(0) {
+  }
+
+  virtual Status Open(RuntimeState* state) {
+    next_idx_ = 0;
+    return Status::OK;
+  }
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* batch, bool* eos) {
+    int num_rows = 0;
+    while (!batch->IsFull() && num_rows < max_batch_rows_ &&
+        next_idx_ < values_.size()) {
+      int row_idx = batch->AddRow();
+      Tuple* tuple = Tuple::Create(sizeof(StringValue), batch->tuple_data_pool());
+      string& value = values_[next_idx_++];
+      *reinterpret_cast<StringValue*>(tuple->GetSlot(0)) =
+          StringValue(const_cast<char*>(value.data()), value.size());
+      batch->GetRow(row_idx)->SetTuple(0, tuple);
+      batch->CommitLastRow();
+      ++num_rows;
+    }
+    num_rows_returned_ += num_rows;
+    *eos = next_idx_ == values_.size();
+    return Status::OK;
+  }
+
+ private:
+  vector<string> values_;
+  int max_batch_rows_;
+  int next_idx_;
+};
+
+class TopNNodeTest : public testing::Test {
+ protected:
+  ExecEnv exec_env_;
+  scoped_ptr<RuntimeState> state_;
+  // Declared after state_ so that the nodes, whose mem trackers are children of the
+  // state's, are destroyed first
+  ObjectPool pool_;
+  DescriptorTbl* desc_tbl_;
+
+  virtual void SetUp() {
+    CreateDescTbl(&pool_, 1, &desc_tbl_);
+    InitRuntimeState();
+  }
+
+  void InitRuntimeState() {
+    state_.reset(CreateRuntimeState(&exec_env_, desc_tbl_, TUniqueId(), -1));
+  }
+
+  // Returns a top-n node over 'child' that orders by the only slot of its rows.
+  TestNode<TopNNode>* CreateTopNNode(ExecNode* child, TPrimitiveType::type type,
+      int64_t limit, int64_t offset, bool is_asc) {
+    TPlanNode tnode = CreatePlanNode(0, TPlanNodeType::SORT_NODE,
+        vector<TTupleId>(1, 0));
+    tnode.limit = limit;
+    TExpr ordering_expr = CreateSlotRefExpr(0);
+    ordering_expr.nodes[0].type = type;
+    tnode.sort_node.ordering_exprs.push_back(ordering_expr);
+    tnode.sort_node.is_asc_order.push_back(is_asc);
+    tnode.sort_node.use_top_n = true;
+    tnode.sort_node.is_default_limit = false;
+    if (offset != 0) tnode.sort_node.__set_offset(offset);
+    tnode.__isset.sort_node = true;
+    TestNode<TopNNode>* node =
+        pool_.Add(new TestNode<TopNNode>(&pool_, tnode, *desc_tbl_));
+    node->AddChild(child);
+    return node;
+  }
+
+  // Returns the top-n of 'values' in '*result'.  The input is returned in batches of
+  // 'max_batch_rows' rows.
+  void RunTopN(const vector<int64_t>& values, int64_t limit, int64_t offset,
+      bool is_asc, int max_batch_rows, vector<int64_t>* result) {
+    ExecNode* child =
+        pool_.Add(new RowSourceNode(&pool_, 1, 0, *desc_tbl_, values, max_batch_rows));
+    TopNNode* node = CreateTopNNode(child, TPrimitiveType::BIGINT, limit, offset,
+        is_asc);
+    vector<RowBatch*> batches;
+    Status status = GetAllRows(state_.get(), node, &pool_, &batches);
+    ASSERT_TRUE(status.ok()) << status.GetErrorMsg();
+    result->clear();
+    for (int i = 0; i < batches.size(); ++i) {
+      for (int j = 0; j < batches[i]->num_rows(); ++j) {
+        result->push_back(GetBigIntValue(batches[i]->GetRow(j), 0));
+      }
+    }
+    ASSERT_TRUE(node->Close(state_.get()).ok());
+  }
+};
+
+// Returns the values [begin, end) in a scrambled order.
+static vector<int64_t> ScrambledValues(int64_t begin, int64_t end) {
+  vector<int64_t> values;
+  for (int64_t i = begin; i < end; ++i) {
+    values.push_back(i);
+  }
+  // A fixed permutation, so that failures are reproducible
+  for (int i = 0; i < values.size(); ++i) {
+    swap(values[i], values[(i * 7919) % values.size()]);
+  }
+  return values;
+}
+
+TEST_F(TopNNodeTest, LimitOffset) {
+  vector<int64_t> values = ScrambledValues(0, 10000);
+  vector<int64_t> result;
+
+  RunTopN(values, 10, 0, true, 100, &result);
+  ASSERT_EQ(result.size(), 10);
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], i);
+  }
+
+  RunTopN(values, 10, 5, true, 100, &result);
+  ASSERT_EQ(result.size(), 10);
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], 5 + i);
+  }
+
+  RunTopN(values, 10, 5, false, 100, &result);
+  ASSERT_EQ(result.size(), 10);
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], 9994 - i);
+  }
+
+  // The offset leaves fewer than 'limit' rows
+  RunTopN(values, 10, 9995, true, 100, &result);
+  ASSERT_EQ(result.size(), 5);
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], 9995 + i);
+  }
+
+  // The offset skips all rows
+  RunTopN(values, 10, 10000, true, 100, &result);
+  EXPECT_TRUE(result.empty());
+
+  // The heap holds all rows
+  RunTopN(values, 20000, 0, true, 100, &result);
+  ASSERT_EQ(result.size(), values.size());
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], i);
+  }
+}
+
+// Many input rows are equal to the top of the heap, and are dropped without being
+// compared with the ordering exprs.
+TEST_F(TopNNodeTest, Ties) {
+  vector<int64_t> values;
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(i % 10);
+  }
+  vector<int64_t> result;
+
+  // Rows [50, 200) of the sorted input: 50 0s and 100 1s
+  RunTopN(values, 150, 50, true, 64, &result);
+  ASSERT_EQ(result.size(), 150);
+  EXPECT_EQ(count(result.begin(), result.end(), 0), 50);
+  EXPECT_EQ(count(result.begin(), result.end(), 1), 100);
+  for (int i = 1; i < result.size(); ++i) {
+    EXPECT_LE(result[i - 1], result[i]);
+  }
+
+  RunTopN(values, 150, 50, false, 64, &result);
+  ASSERT_EQ(result.size(), 150);
+  EXPECT_EQ(count(result.begin(), result.end(), 9), 50);
+  EXPECT_EQ(count(result.begin(), result.end(), 8), 100);
+}
+
+// Returns 'value' zero-padded to 8 digits and followed by 92 bytes of padding, so that
+// the strings are large and their order is the order of the values.
+static string PaddedValue(int value) {
+  stringstream ss;
+  ss << setw(8) << setfill('0') << value << string(92, 'x');
+  return ss.str();
+}
+
+// Every input row replaces the top of the heap, leaving the string data of the
+// replaced rows in the tuple pool until it is compacted.
+TEST_F(TopNNodeTest, TuplePoolCompaction) {
+  CreateDescTbl(&pool_, 1, &desc_tbl_, TPrimitiveType::STRING);
+  InitRuntimeState();
+
+  // Descending input, about 5MB of string data
+  const int num_rows = 50000;
+  vector<string> values;
+  for (int i = num_rows - 1; i >= 0; --i) {
+    values.push_back(PaddedValue(i));
+  }
+  ExecNode* child = pool_.Add(
+      new StringRowSourceNode(&pool_, 1, 0, *desc_tbl_, values, 100));
+  TopNNode* node = CreateTopNNode(child, TPrimitiveType::STRING, 10, 5, true);
+  vector<RowBatch*> batches;
+  Status status = GetAllRows(state_.get(), node, &pool_, &batches);
+  ASSERT_TRUE(status.ok()) << status.GetErrorMsg();
+  EXPECT_GT(node->runtime_profile()->GetCounter("TuplePoolCompactions")->value(), 0);
+
+  vector<string> result;
+  for (int i = 0; i < batches.size(); ++i) {
+    for (int j = 0; j < batches[i]->num_rows(); ++j) {
+      StringValue* value = reinterpret_cast<StringValue*>(
+          batches[i]->GetRow(j)->GetTuple(0)->GetSlot(0));
+      result.push_back(string(value->ptr, value->len));
+    }
+  }
+  ASSERT_EQ(result.size(), 10);
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i], PaddedValue(5 + i));
+  }
+  ASSERT_TRUE(node->Close(state_.get()).ok());
+}
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitExecNodeTest(&argc, &argv);
+  return RUN_ALL_TESTS();
+}
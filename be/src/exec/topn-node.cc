@@ -14,6 +14,7 @@
 
 #include "exec/topn-node.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "exprs/expr.h"
@@ -22,6 +23,7 @@
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "util/debug-util.h"
@@ -33,11 +35,24 @@
 using namespace impala;
 using namespace std;
 
+// Key of NULL values, which go last regardless of asc/desc
+static const uint64_t NULL_KEY = ~0ULL;
+static const uint64_t SIGN_BIT = 1ULL << 63;
+
+// tuple_pool_ is compacted once it holds at least this many bytes and twice as much as
+// after the last compaction.
+static const int64_t MIN_COMPACTION_BYTES = 1024 * 1024;
+
 TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs) 
   : ExecNode(pool, tnode, descs),
-    tuple_row_less_than_(this),
-    priority_queue_(tuple_row_less_than_),
-    tuple_pool_(new MemPool) {
+    offset_(0),
+    key_is_exact_(false),
+    heap_entry_less_than_(this),
+    tuple_pool_(new MemPool),
+    compaction_threshold_(0),
+    tuple_pool_peak_bytes_(0),
+    rows_prefiltered_counter_(NULL),
+    compactions_counter_(NULL) {
   // TODO: log errors in runtime state
   Status status = Init(pool, tnode);
   DCHECK(status.ok()) << "TopNNode c'tor:Init failed: \n" << status.GetErrorMsg();
@@ -53,19 +68,16 @@ Status TopNNode::Init(ObjectPool* pool, const TPlanNode& tnode) {
       tnode.sort_node.is_asc_order.end());
   DCHECK_EQ(conjuncts_.size(), 0) << "TopNNode should never have predicates to evaluate.";
   abort_on_default_limit_exceeded_ = tnode.sort_node.is_default_limit;
+  if (tnode.sort_node.__isset.offset) offset_ = tnode.sort_node.offset;
   return Status::OK;
 }
 
-// The stl::priority_queue is a MAX heap.
-bool TopNNode::TupleRowLessThan::operator()(TupleRow* const& lhs, TupleRow* const& rhs)
-    const {
-  DCHECK(node_ != NULL);
+bool TopNNode::RowLessThan(TupleRow* lhs, TupleRow* rhs) {
+  vector<Expr*>::const_iterator lhs_expr_iter = lhs_ordering_exprs_.begin();
+  vector<Expr*>::const_iterator rhs_expr_iter = rhs_ordering_exprs_.begin();
+  vector<bool>::const_iterator is_asc_iter = is_asc_order_.begin();
 
-  vector<Expr*>::const_iterator lhs_expr_iter = node_->lhs_ordering_exprs_.begin();
-  vector<Expr*>::const_iterator rhs_expr_iter = node_->rhs_ordering_exprs_.begin();
-  vector<bool>::const_iterator is_asc_iter = node_->is_asc_order_.begin();
-
-  for (;lhs_expr_iter != node_->lhs_ordering_exprs_.end(); 
+  for (;lhs_expr_iter != lhs_ordering_exprs_.end(); 
       ++lhs_expr_iter,++rhs_expr_iter,++is_asc_iter) {
     Expr* lhs_expr = *lhs_expr_iter;
     Expr* rhs_expr = *rhs_expr_iter;
@@ -86,7 +98,99 @@ bool TopNNode::TupleRowLessThan::operator()(TupleRow* const& lhs, TupleRow* cons
     if (result < 0) return true;
     // Otherwise, try the next Expr
   }
-  return true;
+  return false;
+}
+
+bool TopNNode::HeapEntryLessThan::operator()(const HeapEntry& lhs,
+    const HeapEntry& rhs) const {
+  DCHECK(node_ != NULL);
+  if (lhs.key != rhs.key) return lhs.key < rhs.key;
+  if (node_->key_is_exact_ && lhs.key != NULL_KEY) return false;
+  return node_->RowLessThan(lhs.row, rhs.row);
+}
+
+// The keys of non-NULL values are encoded such that they compare as unsigned integers
+// like the values compare.  The caller inverts them for descending order.
+// Signed integers: flip the sign bit.
+template <typename T>
+static inline uint64_t ToKey(T value) {
+  return static_cast<uint64_t>(static_cast<int64_t>(value)) ^ SIGN_BIT;
+}
+
+template <>
+inline uint64_t ToKey(bool value) {
+  return value;
+}
+
+// Doubles: flip the sign bit of positive values and all bits of negative values.
+template <>
+inline uint64_t ToKey(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits & SIGN_BIT) ? ~bits : bits | SIGN_BIT;
+}
+
+template <>
+inline uint64_t ToKey(float value) {
+  return ToKey<double>(value);
+}
+
+// Strings: the first 8 bytes, big endian and padded with 0s.  Strings with equal keys
+// are compared with the exprs.
+template <>
+inline uint64_t ToKey(StringValue value) {
+  uint64_t key = 0;
+  int len = min(value.len, 8);
+  for (int i = 0; i < len; ++i) {
+    key |= static_cast<uint64_t>(static_cast<uint8_t>(value.ptr[i])) << (56 - 8 * i);
+  }
+  return key;
+}
+
+template <typename T>
+void TopNNode::ComputeKeys(const T* values, int num_rows) {
+  const uint8_t* nulls = lhs_ordering_exprs_[0]->batch_nulls();
+  uint64_t flip = is_asc_order_[0] ? 0 : ~0ULL;
+  for (int i = 0; i < num_rows; ++i) {
+    batch_keys_[i] = nulls[i] ? NULL_KEY : ToKey<T>(values[i]) ^ flip;
+  }
+}
+
+void TopNNode::ComputeKeys(int num_rows) {
+  Expr* expr = lhs_ordering_exprs_[0];
+  switch (expr->type()) {
+    case TYPE_BOOLEAN:
+      ComputeKeys(expr->batch_values<bool>(), num_rows);
+      break;
+    case TYPE_TINYINT:
+      ComputeKeys(expr->batch_values<int8_t>(), num_rows);
+      break;
+    case TYPE_SMALLINT:
+      ComputeKeys(expr->batch_values<int16_t>(), num_rows);
+      break;
+    case TYPE_INT:
+      ComputeKeys(expr->batch_values<int32_t>(), num_rows);
+      break;
+    case TYPE_BIGINT:
+      ComputeKeys(expr->batch_values<int64_t>(), num_rows);
+      break;
+    case TYPE_FLOAT:
+      ComputeKeys(expr->batch_values<float>(), num_rows);
+      break;
+    case TYPE_DOUBLE:
+      ComputeKeys(expr->batch_values<double>(), num_rows);
+      break;
+    case TYPE_STRING:
+      ComputeKeys(expr->batch_values<StringValue>(), num_rows);
+      break;
+    default: {
+      // No key, all non-NULL values are compared with the exprs
+      const uint8_t* nulls = expr->batch_nulls();
+      for (int i = 0; i < num_rows; ++i) {
+        batch_keys_[i] = nulls[i] ? NULL_KEY : 0;
+      }
+    }
+  }
 }
 
 Status TopNNode::Prepare(RuntimeState* state) {
@@ -94,9 +198,18 @@ Status TopNNode::Prepare(RuntimeState* state) {
   tuple_descs_ = child(0)->row_desc().tuple_descriptors();
   Expr::Prepare(lhs_ordering_exprs_, state, child(0)->row_desc());
   Expr::Prepare(rhs_ordering_exprs_, state, child(0)->row_desc());
-  tuple_pool_->set_limits(*state->mem_limits());
+  tuple_pool_->set_limits(mem_trackers_);
   abort_on_default_limit_exceeded_ = abort_on_default_limit_exceeded_ &&
       state->abort_on_default_limit_exceeded();
+  if (lhs_ordering_exprs_.size() == 1) {
+    PrimitiveType type = lhs_ordering_exprs_[0]->type();
+    key_is_exact_ = type == TYPE_BOOLEAN || type == TYPE_TINYINT ||
+        type == TYPE_SMALLINT || type == TYPE_INT || type == TYPE_BIGINT;
+  }
+  rows_prefiltered_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsPrefiltered", TCounterType::UNIT);
+  compactions_counter_ =
+      ADD_COUNTER(runtime_profile(), "TuplePoolCompactions", TCounterType::UNIT);
   return Status::OK;
 }
 
@@ -109,21 +222,27 @@ Status TopNNode::Open(RuntimeState* state) {
   // Limit of 0, no need to fetch anything from children.
   if (limit_ != 0) {
     RowBatch batch(child(0)->row_desc(), state->batch_size());
+    batch_rows_.resize(batch.capacity());
+    batch_sel_.resize(batch.capacity());
+    batch_keys_.resize(batch.capacity());
     bool eos;
     do {
       RETURN_IF_CANCELLED(state);
       batch.Reset();
       RETURN_IF_ERROR(child(0)->GetNext(state, &batch, &eos));
-      if (abort_on_default_limit_exceeded_ && child(0)->rows_returned() > limit_) {
+      if (abort_on_default_limit_exceeded_ &&
+          child(0)->rows_returned() > limit_ + offset_) {
         return Status("DEFAULT_ORDER_BY_LIMIT has been exceeded.");
       }
-      for (int i = 0; i < batch.num_rows(); ++i) {
-        InsertTupleRow(batch.GetRow(i));
+      InsertBatch(&batch);
+      if (compaction_threshold_ > 0 &&
+          tuple_pool_->total_allocated_bytes() > compaction_threshold_) {
+        CompactTuplePool(state);
       }
       RETURN_IF_LIMIT_EXCEEDED(state);
     } while (!eos);
   }
-  DCHECK_LE(priority_queue_.size(), limit_);
+  DCHECK_LE(heap_.size(), limit_ + offset_);
   PrepareForOutput();
   return Status::OK;
 }
@@ -148,47 +267,92 @@ Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
 
 Status TopNNode::Close(RuntimeState* state) {
   if (memory_used_counter() != NULL) {
-    COUNTER_UPDATE(memory_used_counter(), tuple_pool_->peak_allocated_bytes());
+    tuple_pool_peak_bytes_ =
+        max(tuple_pool_peak_bytes_, tuple_pool_->peak_allocated_bytes());
+    COUNTER_UPDATE(memory_used_counter(), tuple_pool_peak_bytes_);
   }
   return ExecNode::Close(state);
 }
 
-// Insert if either not at the limit or it's a new TopN tuple_row
-void TopNNode::InsertTupleRow(TupleRow* input_row) {
-  TupleRow* insert_tuple_row = NULL;
-  
-  if (priority_queue_.size() < limit_) {
-    insert_tuple_row = input_row->DeepCopy(tuple_descs_, tuple_pool_.get());
-  } else {
-    DCHECK(!priority_queue_.empty());
-    TupleRow* top_tuple_row = priority_queue_.top();
-    if (tuple_row_less_than_(input_row, top_tuple_row)) {
-      // TODO: DeepCopy will allocate new buffers for the string data.  This needs
-      // to be fixed to use a freelist
-      input_row->DeepCopy(top_tuple_row, tuple_descs_, tuple_pool_.get(), true);
-      insert_tuple_row = top_tuple_row;
-      priority_queue_.pop();
+// Insert the rows if either not at the limit or they are new TopN rows
+void TopNNode::InsertBatch(RowBatch* batch) {
+  int num_rows = batch->num_rows();
+  if (num_rows == 0) return;
+  for (int i = 0; i < num_rows; ++i) {
+    batch_rows_[i] = batch->GetRow(i);
+    batch_sel_[i] = i;
+  }
+  lhs_ordering_exprs_[0]->EvalBatch(&batch_rows_[0], &batch_sel_[0], num_rows);
+  ComputeKeys(num_rows);
+
+  int64_t capacity = limit_ + offset_;
+  int num_prefiltered = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* input_row = batch_rows_[i];
+    if (heap_.size() < capacity) {
+      HeapEntry entry;
+      entry.key = batch_keys_[i];
+      entry.row = input_row->DeepCopy(tuple_descs_, tuple_pool_.get());
+      heap_.push_back(entry);
+      push_heap(heap_.begin(), heap_.end(), heap_entry_less_than_);
+      if (heap_.size() == capacity) {
+        compaction_threshold_ =
+            max(MIN_COMPACTION_BYTES, 2 * tuple_pool_->total_allocated_bytes());
+      }
+      continue;
+    }
+
+    DCHECK(!heap_.empty());
+    // Most rows aren't in the TopN, which the key comparison usually decides.
+    HeapEntry& top = heap_.front();
+    if (batch_keys_[i] > top.key) {
+      ++num_prefiltered;
+      continue;
     }
+    HeapEntry input;
+    input.key = batch_keys_[i];
+    input.row = input_row;
+    if (!heap_entry_less_than_(input, top)) {
+      ++num_prefiltered;
+      continue;
+    }
+    // Replace the top, reusing its tuple memory.  The string data of the replaced row
+    // is reclaimed by CompactTuplePool().
+    pop_heap(heap_.begin(), heap_.end(), heap_entry_less_than_);
+    HeapEntry& last = heap_.back();
+    input_row->DeepCopy(last.row, tuple_descs_, tuple_pool_.get(), true);
+    last.key = input.key;
+    push_heap(heap_.begin(), heap_.end(), heap_entry_less_than_);
   }
+  COUNTER_UPDATE(rows_prefiltered_counter_, num_prefiltered);
+}
 
-  if (insert_tuple_row != NULL) {
-    priority_queue_.push(insert_tuple_row);
+void TopNNode::CompactTuplePool(RuntimeState* state) {
+  boost::scoped_ptr<MemPool> new_pool(new MemPool);
+  new_pool->set_limits(mem_trackers_);
+  for (int i = 0; i < heap_.size(); ++i) {
+    heap_[i].row = heap_[i].row->DeepCopy(tuple_descs_, new_pool.get());
   }
+  tuple_pool_peak_bytes_ =
+      max(tuple_pool_peak_bytes_, tuple_pool_->peak_allocated_bytes());
+  // Frees the old pool
+  tuple_pool_.swap(new_pool);
+  compaction_threshold_ =
+      max(MIN_COMPACTION_BYTES, 2 * tuple_pool_->total_allocated_bytes());
+  COUNTER_UPDATE(compactions_counter_, 1);
 }
 
-// Reverse the order of the tuples in the priority queue
+// Sort the heap in the order of the ORDER BY clause and skip the offset
 void TopNNode::PrepareForOutput() {
-  sorted_top_n_.resize(priority_queue_.size());
-  int index = sorted_top_n_.size() - 1;
-
-  while (priority_queue_.size() > 0) {
-    TupleRow* tuple_row = priority_queue_.top();
-    priority_queue_.pop();
-    sorted_top_n_[index] = tuple_row;
-    --index;
+  sort_heap(heap_.begin(), heap_.end(), heap_entry_less_than_);
+  sorted_top_n_.resize(heap_.size());
+  for (int i = 0; i < heap_.size(); ++i) {
+    sorted_top_n_[i] = heap_[i].row;
   }
+  heap_.clear();
 
   get_next_iter_ = sorted_top_n_.begin();
+  get_next_iter_ += min<int64_t>(offset_, sorted_top_n_.size());
 }
 
 void TopNNode::DebugString(int indentation_level, stringstream* out) const {
@@ -200,6 +364,7 @@ void TopNNode::DebugString(int indentation_level, stringstream* out) const {
     *out << (i > 0 ? " " : "") << (is_asc_order_[i] ? "asc" : "desc");
   }
   *out << "]";
+  if (offset_ != 0) *out << " offset=" << offset_;
   ExecNode::DebugString(indentation_level, out);
   *out << ")";
 }
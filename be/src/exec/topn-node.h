@@ -16,7 +16,7 @@
 #ifndef IMPALA_EXEC_TOPN_NODE_H
 #define IMPALA_EXEC_TOPN_NODE_H
 
-#include <queue>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/exec-node.h"
@@ -25,13 +25,24 @@
 namespace impala {
 
 class MemPool;
+class RowBatch;
 class RuntimeState;
 class Tuple;
 
-// Node for in-memory TopN (ORDER BY ... LIMIT)
+// Node for in-memory TopN (ORDER BY ... LIMIT [OFFSET])
 // This handles the case where the result fits in memory.  This node will do a deep
 // copy of the tuples that are necessary for the output.
-// This is implemented by storing rows in a priority queue.  
+// The limit + offset first rows are kept in a heap whose top is the last of them in
+// the sort order.  Each heap entry has a normalized key: a fixed-width prefix of the
+// value of the first ordering expr, encoded such that comparing keys as integers
+// orders rows like the ordering exprs (see ComputeKeys()).  Most comparisons are
+// decided by the keys; only rows with equal keys are compared with the ordering
+// exprs.
+// The first ordering expr is evaluated a batch at a time, and once the heap is full,
+// input rows are compared against its top before they are copied, so most rows of a
+// large input are dropped without being copied.  Rows that replace the top reuse its
+// tuple memory, but string data of replaced rows stays in tuple_pool_ until the pool
+// is compacted by copying the rows in the heap into a new pool.
 class TopNNode : public ExecNode {
  public:
   TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -47,28 +58,48 @@ class TopNNode : public ExecNode {
  private:
   Status Init(ObjectPool* pool, const TPlanNode& tnode);
 
-  class TupleRowLessThan {
+  struct HeapEntry {
+    // Normalized key of the row
+    uint64_t key;
+    TupleRow* row;
+  };
+
+  // Orders heap entries by their keys, and by the ordering exprs if the keys are equal.
+  class HeapEntryLessThan {
    public:
-    TupleRowLessThan() : node_(NULL) {}
-    TupleRowLessThan(TopNNode* node) : node_(node) {}
-    bool operator()(TupleRow* const& lhs, TupleRow* const& rhs) const;
+    HeapEntryLessThan() : node_(NULL) {}
+    HeapEntryLessThan(TopNNode* node) : node_(node) {}
+    bool operator()(const HeapEntry& lhs, const HeapEntry& rhs) const;
 
    private:
     TopNNode* node_;
   };
-    
-  friend class TupleLessThan;
 
-  // Inserts a tuple row into the priority queue if it's in the TopN.  Creates a deep 
-  // copy of tuple_row, which it stores in tuple_pool_.
-  void InsertTupleRow(TupleRow* tuple_row);
+  // Returns true if lhs comes before rhs in the sort order.
+  bool RowLessThan(TupleRow* lhs, TupleRow* rhs);
+
+  // Inserts the rows of 'batch' that are in the TopN into the heap.  Creates deep
+  // copies of them, which it stores in tuple_pool_.
+  void InsertBatch(RowBatch* batch);
+
+  // Computes batch_keys_ for the rows batch_rows_[0, num_rows) from the batch result
+  // of the first ordering expr.
+  void ComputeKeys(int num_rows);
+  template <typename T> void ComputeKeys(const T* values, int num_rows);
+
+  // Copies the rows in the heap into a new tuple_pool_, which frees the data of rows
+  // that were replaced.
+  void CompactTuplePool(RuntimeState* state);
 
-  // Flatten and reverse the priority queue.
+  // Sort the heap and skip the offset.
   void PrepareForOutput();
 
   std::vector<TupleDescriptor*> tuple_descs_;
   std::vector<bool> is_asc_order_;
 
+  // Number of rows to skip before returning rows
+  int64_t offset_;
+
   // True if the limit_ comes from DEFAULT_ORDER_BY_LIMIT and the query option
   // ABORT_ON_DEFAULT_LIMIT_EXCEEDED is set.
   bool abort_on_default_limit_exceeded_;
@@ -79,20 +110,36 @@ class TopNNode : public ExecNode {
   std::vector<Expr*> lhs_ordering_exprs_;
   std::vector<Expr*> rhs_ordering_exprs_;
 
-  TupleRowLessThan tuple_row_less_than_;
+  // True if rows with equal keys (other than NULL_KEY) are equal in the sort order,
+  // i.e. if there is a single ordering expr with an integer or boolean type.
+  bool key_is_exact_;
+
+  HeapEntryLessThan heap_entry_less_than_;
+
+  // Max heap (according to heap_entry_less_than_) of at most limit_ + offset_ rows, so
+  // that the top is the last row in the sort order.
+  std::vector<HeapEntry> heap_;
 
-  // The priority queue will never have more elements in it than the LIMIT.  The stl 
-  // priority queue doesn't support a max size, so to get that functionality, the order
-  // of the queue is the opposite of what the ORDER BY clause specifies, such that the top 
-  // of the queue is the last sorted element.
-  std::priority_queue<TupleRow*, std::vector<TupleRow*>, TupleRowLessThan> priority_queue_;
+  // Rows, selection and keys of the current input batch
+  std::vector<TupleRow*> batch_rows_;
+  std::vector<int> batch_sel_;
+  std::vector<uint64_t> batch_keys_;
 
-  // After computing the TopN in the priority_queue, pop them and put them in this vector
+  // After computing the TopN in the heap, sort it and put the rows in this vector
   std::vector<TupleRow*> sorted_top_n_;
   std::vector<TupleRow*>::iterator get_next_iter_;
     
-  // Stores everything referenced in priority_queue_
+  // Stores everything referenced in heap_
   boost::scoped_ptr<MemPool> tuple_pool_;
+
+  // tuple_pool_ is compacted when it exceeds this many bytes; 0 until the heap is full
+  int64_t compaction_threshold_;
+
+  // Max peak allocated bytes of all tuple pools
+  int64_t tuple_pool_peak_bytes_;
+
+  RuntimeProfile::Counter* rows_prefiltered_counter_;
+  RuntimeProfile::Counter* compactions_counter_;
 };
 
 };
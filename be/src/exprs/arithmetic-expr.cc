@@ -33,6 +33,155 @@ Status ArithmeticExpr::Prepare(RuntimeState* state, const RowDescriptor& desc) {
   return Expr::Prepare(state, desc);
 }
 
+// Operators for Expr::EvalBinaryOpBatch()
+struct AddOp {
+  template <typename T> static T Apply(T a, T b) { return a + b; }
+};
+struct SubtractOp {
+  template <typename T> static T Apply(T a, T b) { return a - b; }
+};
+struct MultiplyOp {
+  template <typename T> static T Apply(T a, T b) { return a * b; }
+};
+struct DivideOp {
+  template <typename T> static T Apply(T a, T b) { return a / b; }
+};
+struct ModOp {
+  template <typename T> static T Apply(T a, T b) { return a % b; }
+};
+struct BitAndOp {
+  template <typename T> static T Apply(T a, T b) { return a & b; }
+};
+struct BitOrOp {
+  template <typename T> static T Apply(T a, T b) { return a | b; }
+};
+struct BitXorOp {
+  template <typename T> static T Apply(T a, T b) { return a ^ b; }
+};
+
+template <typename T>
+void ArithmeticExpr::EvalBitNotBatch(const int* sel, int num_rows) {
+  const T* child_values = children_[0]->batch_values<T>();
+  const uint8_t* child_nulls = children_[0]->batch_nulls();
+  T* values = mutable_batch_values<T>();
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    batch_nulls_[row_idx] = child_nulls[row_idx];
+    values[row_idx] = ~child_values[row_idx];
+  }
+}
+
+// Integer division and modulo are only evaluated for non-NULL rows so the undefined
+// values of NULL rows can't cause a division by zero.
+void ArithmeticExpr::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  EvalChildrenBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  switch (op()) {
+    case TExprOpcode::ADD_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, AddOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::ADD_DOUBLE_DOUBLE:
+      EvalBinaryOpBatch<double, double, AddOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::SUBTRACT_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, SubtractOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::SUBTRACT_DOUBLE_DOUBLE:
+      EvalBinaryOpBatch<double, double, SubtractOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::MULTIPLY_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, MultiplyOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::MULTIPLY_DOUBLE_DOUBLE:
+      EvalBinaryOpBatch<double, double, MultiplyOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::DIVIDE:
+      EvalBinaryOpBatch<double, double, DivideOp, false>(sel, num_rows);
+      break;
+
+    case TExprOpcode::INT_DIVIDE_CHAR_CHAR:
+      EvalBinaryOpBatch<int8_t, int8_t, DivideOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::INT_DIVIDE_SHORT_SHORT:
+      EvalBinaryOpBatch<int16_t, int16_t, DivideOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::INT_DIVIDE_INT_INT:
+      EvalBinaryOpBatch<int32_t, int32_t, DivideOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::INT_DIVIDE_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, DivideOp, true>(sel, num_rows);
+      break;
+
+    case TExprOpcode::MOD_CHAR_CHAR:
+      EvalBinaryOpBatch<int8_t, int8_t, ModOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::MOD_SHORT_SHORT:
+      EvalBinaryOpBatch<int16_t, int16_t, ModOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::MOD_INT_INT:
+      EvalBinaryOpBatch<int32_t, int32_t, ModOp, true>(sel, num_rows);
+      break;
+    case TExprOpcode::MOD_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, ModOp, true>(sel, num_rows);
+      break;
+
+    case TExprOpcode::BITAND_CHAR_CHAR:
+      EvalBinaryOpBatch<int8_t, int8_t, BitAndOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITAND_SHORT_SHORT:
+      EvalBinaryOpBatch<int16_t, int16_t, BitAndOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITAND_INT_INT:
+      EvalBinaryOpBatch<int32_t, int32_t, BitAndOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITAND_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, BitAndOp, false>(sel, num_rows);
+      break;
+
+    case TExprOpcode::BITOR_CHAR_CHAR:
+      EvalBinaryOpBatch<int8_t, int8_t, BitOrOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITOR_SHORT_SHORT:
+      EvalBinaryOpBatch<int16_t, int16_t, BitOrOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITOR_INT_INT:
+      EvalBinaryOpBatch<int32_t, int32_t, BitOrOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITOR_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, BitOrOp, false>(sel, num_rows);
+      break;
+
+    case TExprOpcode::BITXOR_CHAR_CHAR:
+      EvalBinaryOpBatch<int8_t, int8_t, BitXorOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITXOR_SHORT_SHORT:
+      EvalBinaryOpBatch<int16_t, int16_t, BitXorOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITXOR_INT_INT:
+      EvalBinaryOpBatch<int32_t, int32_t, BitXorOp, false>(sel, num_rows);
+      break;
+    case TExprOpcode::BITXOR_LONG_LONG:
+      EvalBinaryOpBatch<int64_t, int64_t, BitXorOp, false>(sel, num_rows);
+      break;
+
+    case TExprOpcode::BITNOT_CHAR:
+      EvalBitNotBatch<int8_t>(sel, num_rows);
+      break;
+    case TExprOpcode::BITNOT_SHORT:
+      EvalBitNotBatch<int16_t>(sel, num_rows);
+      break;
+    case TExprOpcode::BITNOT_INT:
+      EvalBitNotBatch<int32_t>(sel, num_rows);
+      break;
+    case TExprOpcode::BITNOT_LONG:
+      EvalBitNotBatch<int64_t>(sel, num_rows);
+      break;
+
+    default:
+      Expr::EvalBatch(rows, sel, num_rows);
+  }
+}
+
 string ArithmeticExpr::DebugString() const {
   stringstream out;
   out << "ArithmeticExpr(" << Expr::DebugString() << ")";
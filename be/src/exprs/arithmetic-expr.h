@@ -27,6 +27,7 @@ class TExprNode;
 class ArithmeticExpr: public Expr {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* code_gen);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
 
  protected:
   friend class Expr;
@@ -35,6 +36,10 @@ class ArithmeticExpr: public Expr {
   ArithmeticExpr(const TExprNode& node);
 
   virtual std::string DebugString() const;
+
+ private:
+  // EvalBatch() for the BITNOT_* opcodes
+  template <typename T> void EvalBitNotBatch(const int* sel, int num_rows);
 };
 
 }
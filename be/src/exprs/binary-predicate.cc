@@ -16,6 +16,7 @@
 
 #include "codegen/llvm-codegen.h"
 #include "exprs/binary-predicate.h"
+#include "runtime/string-value.inline.h"
 #include "util/debug-util.h"
 #include "gen-cpp/Exprs_types.h"
 
@@ -33,6 +34,78 @@ Status BinaryPredicate::Prepare(RuntimeState* state, const RowDescriptor& desc)
   return Expr::Prepare(state, desc);
 }
 
+// Operators for Expr::EvalBinaryOpBatch()
+struct EqOp {
+  template <typename T> static bool Apply(T a, T b) { return a == b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Eq(b); }
+};
+struct NeOp {
+  template <typename T> static bool Apply(T a, T b) { return a != b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Ne(b); }
+};
+struct LtOp {
+  template <typename T> static bool Apply(T a, T b) { return a < b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Lt(b); }
+};
+struct LeOp {
+  template <typename T> static bool Apply(T a, T b) { return a <= b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Le(b); }
+};
+struct GtOp {
+  template <typename T> static bool Apply(T a, T b) { return a > b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Gt(b); }
+};
+struct GeOp {
+  template <typename T> static bool Apply(T a, T b) { return a >= b; }
+  static bool Apply(const StringValue& a, const StringValue& b) { return a.Ge(b); }
+};
+
+// The cases of BinaryPredicate::EvalBatch() for comparison 'OP' with operator 'FN'.
+// String comparisons dereference the values, so they skip NULL rows.
+#define BINARY_PRED_BATCH_CASES(OP, FN) \
+  case TExprOpcode::OP##_BOOL_BOOL: \
+    EvalBinaryOpBatch<bool, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_CHAR_CHAR: \
+    EvalBinaryOpBatch<int8_t, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_SHORT_SHORT: \
+    EvalBinaryOpBatch<int16_t, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_INT_INT: \
+    EvalBinaryOpBatch<int32_t, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_LONG_LONG: \
+    EvalBinaryOpBatch<int64_t, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_FLOAT_FLOAT: \
+    EvalBinaryOpBatch<float, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_DOUBLE_DOUBLE: \
+    EvalBinaryOpBatch<double, bool, FN, false>(sel, num_rows); \
+    break; \
+  case TExprOpcode::OP##_STRINGVALUE_STRINGVALUE: \
+    EvalBinaryOpBatch<StringValue, bool, FN, true>(sel, num_rows); \
+    break;
+
+void BinaryPredicate::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  EvalChildrenBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  switch (op()) {
+    BINARY_PRED_BATCH_CASES(EQ, EqOp)
+    BINARY_PRED_BATCH_CASES(NE, NeOp)
+    BINARY_PRED_BATCH_CASES(LT, LtOp)
+    BINARY_PRED_BATCH_CASES(LE, LeOp)
+    BINARY_PRED_BATCH_CASES(GT, GtOp)
+    BINARY_PRED_BATCH_CASES(GE, GeOp)
+    default:
+      // e.g. timestamp comparisons
+      Expr::EvalBatch(rows, sel, num_rows);
+  }
+}
+
+#undef BINARY_PRED_BATCH_CASES
+
 string BinaryPredicate::DebugString() const {
   stringstream out;
   out << "BinaryPredicate(" << Expr::DebugString() << ")";
@@ -26,6 +26,7 @@ namespace impala {
 class BinaryPredicate : public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* code_gen);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
  
  protected:
   friend class Expr;
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <sstream>
 
 #include "codegen/llvm-codegen.h"
@@ -85,6 +86,70 @@ void* CompoundPredicate::NotComputeFn(Expr* e, TupleRow* row) {
   return &p->result_.bool_val;
 }
 
+// The lhs is evaluated for all rows.  For AND, rows with a false lhs are false and
+// for OR, rows with a true lhs are true, regardless of the rhs, so the rhs is only
+// evaluated for the remaining rows.
+void CompoundPredicate::EvalBatch(TupleRow* const* rows, const int* sel,
+    int num_rows) {
+  bool* values;
+  if (op() == TExprOpcode::COMPOUND_NOT) {
+    DCHECK_EQ(children_.size(), 1);
+    Expr* child = children_[0];
+    child->EvalBatch(rows, sel, num_rows);
+    InitBatchResult(sel, num_rows);
+    const bool* child_values = child->batch_values<bool>();
+    const uint8_t* child_nulls = child->batch_nulls();
+    values = mutable_batch_values<bool>();
+    for (int i = 0; i < num_rows; ++i) {
+      int row_idx = sel[i];
+      batch_nulls_[row_idx] = child_nulls[row_idx];
+      values[row_idx] = !child_values[row_idx];
+    }
+    return;
+  }
+
+  DCHECK_EQ(children_.size(), 2);
+  DCHECK(op() == TExprOpcode::COMPOUND_AND || op() == TExprOpcode::COMPOUND_OR);
+  // The value that decides the result: false for AND, true for OR
+  bool short_circuit_value = op() == TExprOpcode::COMPOUND_OR;
+  Expr* lhs = children_[0];
+  Expr* rhs = children_[1];
+  lhs->EvalBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  const bool* lhs_values = lhs->batch_values<bool>();
+  const uint8_t* lhs_nulls = lhs->batch_nulls();
+  values = mutable_batch_values<bool>();
+
+  batch_sel_.resize(max(num_rows, 1));
+  int num_rhs_rows = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    if (!lhs_nulls[row_idx] && lhs_values[row_idx] == short_circuit_value) {
+      values[row_idx] = short_circuit_value;
+      batch_nulls_[row_idx] = false;
+    } else {
+      batch_sel_[num_rhs_rows++] = row_idx;
+    }
+  }
+
+  rhs->EvalBatch(rows, &batch_sel_[0], num_rhs_rows);
+  const bool* rhs_values = rhs->batch_values<bool>();
+  const uint8_t* rhs_nulls = rhs->batch_nulls();
+  for (int i = 0; i < num_rhs_rows; ++i) {
+    int row_idx = batch_sel_[i];
+    if (!rhs_nulls[row_idx] && rhs_values[row_idx] == short_circuit_value) {
+      values[row_idx] = short_circuit_value;
+      batch_nulls_[row_idx] = false;
+    } else if (lhs_nulls[row_idx] || rhs_nulls[row_idx]) {
+      // true && NULL and false || NULL are NULL
+      batch_nulls_[row_idx] = true;
+    } else {
+      values[row_idx] = !short_circuit_value;
+      batch_nulls_[row_idx] = false;
+    }
+  }
+}
+
 string CompoundPredicate::DebugString() const {
   stringstream out;
   out << "CompoundPredicate(" << Expr::DebugString() << ")";
@@ -17,6 +17,7 @@
 #define IMPALA_EXPRS_COMPOUND_PREDICATE_H_
 
 #include <string>
+#include <vector>
 #include "exprs/predicate.h"
 #include "gen-cpp/Exprs_types.h"
 
@@ -25,6 +26,7 @@ namespace impala {
 class CompoundPredicate: public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
 
  protected:
   friend class Expr;
@@ -43,6 +45,9 @@ class CompoundPredicate: public Predicate {
   static void* AndComputeFn(Expr* e, TupleRow* row);
   static void* OrComputeFn(Expr* e, TupleRow* row);
   static void* NotComputeFn(Expr* e, TupleRow* row);
+
+  // Rows for which the rhs is evaluated in EvalBatch()
+  std::vector<int> batch_sel_;
 };
 
 }
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 
 #include <jni.h>
 #include <thrift/Thrift.h>
@@ -170,6 +171,26 @@ Benchmark* BenchmarkLike() {
   BENCHMARK("strncmp2", "'abcdefghijklmnopqrstuvwxyz' LIKE 'abc%'");
   BENCHMARK("strncmp3", "'abcdefghijklmnopqrstuvwxyz' LIKE 'abc'");
   BENCHMARK("regex", "'abcdefghijklmnopqrstuvwxyz' LIKE 'abc%z'");
+  BENCHMARK("regex-alternation",
+      "'abcdefghijklmnopqrstuvwxyz' RLIKE '(abc|xyz)[a-w]*(z|zz)'");
+  // Exponential time with a backtracking matcher
+  BENCHMARK("regex-nested-star", "'aaaaaaaaaaaaaaaaaaaaaaaaa' RLIKE '(a*)*b'");
+  return suite;
+}
+
+// Substring search in a log line with short and long needles, as in LIKE '%...%',
+// instr() and locate().
+#define LOG_LINE "'2013-06-12 14:22:07,315 INFO org.apache.hadoop.hdfs.server.datanode." \
+    "DataNode: Receiving block blk_4829384712 src: /10.20.30.40:50010 dest: " \
+    "/10.20.30.41:50010 of size 67108864'"
+Benchmark* BenchmarkStringSearch() {
+  Benchmark* suite = new Benchmark("StringSearch");
+  BENCHMARK("like-short", LOG_LINE " LIKE '%size%'");
+  BENCHMARK("like-long", LOG_LINE " LIKE '%dest: /10.20.30.41:50010 of%'");
+  BENCHMARK("like-miss", LOG_LINE " LIKE '%WARN%'");
+  BENCHMARK("instr-short", "instr(" LOG_LINE ", 'size')");
+  BENCHMARK("instr-long", "instr(" LOG_LINE ", 'dest: /10.20.30.41:50010 of')");
+  BENCHMARK("locate-miss", "locate('ERROR', " LOG_LINE ")");
   return suite;
 }
 
@@ -247,6 +268,36 @@ Benchmark* BenchmarkConditionalFunctions() {
   return suite;
 }
 
+// Returns "<value> in (<list>)" with 'num_values' in-list values.
+static string InListQuery(bool is_string, int num_values) {
+  stringstream ss;
+  ss << (is_string ? "'v2' in (" : "2 in (");
+  for (int i = 0; i < num_values; ++i) {
+    // Only the last value matches, i.e. the linear search has to look at all of them
+    int value = (i == num_values - 1) ? 2 : 2 * i + 3;
+    if (i > 0) ss << ", ";
+    if (is_string) {
+      ss << "'v" << value << "'";
+    } else {
+      ss << value;
+    }
+  }
+  ss << ")";
+  return ss.str();
+}
+
+// Constant in-lists of 10/100/10000 values, looked up in the in-list value set.
+Benchmark* BenchmarkInPredicate() {
+  Benchmark* suite = new Benchmark("InPredicate");
+  BENCHMARK("int_in_10", InListQuery(false, 10));
+  BENCHMARK("int_in_100", InListQuery(false, 100));
+  BENCHMARK("int_in_10000", InListQuery(false, 10000));
+  BENCHMARK("string_in_10", InListQuery(true, 10));
+  BENCHMARK("string_in_100", InListQuery(true, 100));
+  BENCHMARK("string_in_10000", InListQuery(true, 10000));
+  return suite;
+}
+
 // StringFunctions:      Function                Rate          Comparison
 // ----------------------------------------------------------------------
 //                         length               823.5                  1X
@@ -494,6 +545,68 @@ Benchmark* BenchmarkTimestampFunctions() {
   return suite;
 }
 
+// Number of rows in each batch for the batch benchmarks
+const int BATCH_ROWS = 1024;
+
+struct BatchTestData {
+  Expr* root;
+  vector<TupleRow*> rows;
+  vector<int> sel;
+  int64_t dummy_result;
+};
+
+static BatchTestData* GenerateBatchBenchmarkExprs(const string& query) {
+  TestData* test_data = GenerateBenchmarkExprs(query, false);
+  BatchTestData* data = new BatchTestData;
+  data->root = test_data->root;
+  data->rows.resize(BATCH_ROWS, NULL);
+  for (int i = 0; i < BATCH_ROWS; ++i) {
+    data->sel.push_back(i);
+  }
+  data->dummy_result = 0;
+  return data;
+}
+
+// Evaluates the expr over BATCH_ROWS rows with GetValue().
+void BenchmarkRowFn(int batch_size, void* d) {
+  BatchTestData* data = reinterpret_cast<BatchTestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int n = 0; n < BATCH_ROWS; ++n) {
+      void* value = data->root->GetValue(data->rows[n]);
+      data->dummy_result += reinterpret_cast<int64_t>(value);
+    }
+  }
+}
+
+// Evaluates the expr over BATCH_ROWS rows with one EvalBatch() call.
+void BenchmarkBatchFn(int batch_size, void* d) {
+  BatchTestData* data = reinterpret_cast<BatchTestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    data->root->EvalBatch(&data->rows[0], &data->sel[0], BATCH_ROWS);
+    data->dummy_result += data->root->batch_nulls()[BATCH_ROWS - 1];
+  }
+}
+
+#define BATCH_BENCHMARK(name, stmt)\
+  do {\
+    BatchTestData* data = GenerateBatchBenchmarkExprs(stmt);\
+    suite->AddBenchmark(name " (row)", BenchmarkRowFn, data);\
+    suite->AddBenchmark(name " (batch)", BenchmarkBatchFn, data);\
+  } while (false)
+
+// Row-at-a-time vs. batch evaluation.  The rate is batches of BATCH_ROWS rows per ms,
+// i.e. the number of million rows evaluated per second is rate * 1.024.
+Benchmark* BenchmarkBatch() {
+  Benchmark* suite = new Benchmark("Batch");
+  BATCH_BENCHMARK("int-add", "1 + 2");
+  BATCH_BENCHMARK("double-mul", "1.1 * 2.2");
+  BATCH_BENCHMARK("int-lt", "1 < 2");
+  BATCH_BENCHMARK("and", "1 < 2 and 3 > 2");
+  BATCH_BENCHMARK("is-null", "1 is null");
+  BATCH_BENCHMARK("in", "1 in (1, 2, 3)");
+  return suite;
+}
+
 int main(int argc, char** argv) {
   CpuInfo::Init();
 
@@ -501,23 +614,29 @@ int main(int argc, char** argv) {
   Benchmark* literals = BenchmarkLiterals();
   Benchmark* arithmetics = BenchmarkArithmetic();
   Benchmark* like = BenchmarkLike();
+  Benchmark* string_search = BenchmarkStringSearch();
   Benchmark* cast = BenchmarkCast();
   Benchmark* conditional_fns = BenchmarkConditionalFunctions();
+  Benchmark* in_predicate = BenchmarkInPredicate();
   Benchmark* string_fns = BenchmarkStringFunctions();
   Benchmark* url_fns = BenchmarkUrlFunctions();
   Benchmark* math_fns = BenchmarkMathFunctions();
   Benchmark* timestamp_fns = BenchmarkTimestampFunctions();
+  Benchmark* batch = BenchmarkBatch();
 
   cout << Benchmark::GetMachineInfo() << endl;
   cout << literals->Measure() << endl;
   cout << arithmetics->Measure() << endl;
   cout << like->Measure() << endl;
+  cout << string_search->Measure() << endl;
   cout << cast->Measure() << endl;
   cout << conditional_fns->Measure() << endl;
+  cout << in_predicate->Measure() << endl;
   cout << string_fns->Measure() << endl;
   cout << url_fns->Measure() << endl;
   cout << math_fns->Measure() << endl;
   cout << timestamp_fns->Measure() << endl;
+  cout << batch->Measure() << endl;
 
   return 0;
 }
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "exprs/expr.h"
+#include "exprs/in-predicate.h"
 
 #ifdef IR_COMPILE
 
@@ -23,6 +24,13 @@ void* IrExprGetValue(Expr* expr, TupleRow* row) {
   return expr->GetValue(row);
 }
 
+// Looks up 'value' in the constant in-list of an InPredicate.  Called by the codegen'd
+// compute function of the InPredicate.
+extern "C"
+bool IrInPredicateSetContains(Expr* expr, const void* value) {
+  return static_cast<InPredicate*>(expr)->SetContains(value);
+}
+
 #else
 #error "This file should only be compiled by clang."
 #endif
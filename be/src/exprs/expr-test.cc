@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <sstream>
 #include <string>
 #include <math.h>
 #include <gtest/gtest.h>
@@ -588,6 +589,57 @@ class ExprTest : public testing::Test {
     TestStringValue("cast(" + stmt + " as string)",
         lexical_cast<string>(val));
   }
+
+  // Creates an expr for 'node' with 'children'.  This is used to build exprs over
+  // SlotRefs into test rows, which can't be planned.
+  Expr* CreateExpr(ObjectPool* pool, TExprNode node, const vector<Expr*>& children) {
+    node.num_children = children.size();
+    Expr* expr;
+    Status status = Expr::CreateExpr(pool, node, &expr);
+    EXPECT_TRUE(status.ok()) << status.GetErrorMsg();
+    for (int i = 0; i < children.size(); ++i) {
+      expr->AddChild(children[i]);
+    }
+    return expr;
+  }
+
+  Expr* CreateExpr(ObjectPool* pool, TExprNodeType::type node_type,
+      TPrimitiveType::type type, TExprOpcode::type opcode, Expr* child1,
+      Expr* child2 = NULL) {
+    TExprNode node;
+    node.node_type = node_type;
+    node.type = type;
+    node.__set_opcode(opcode);
+    vector<Expr*> children;
+    children.push_back(child1);
+    if (child2 != NULL) children.push_back(child2);
+    return CreateExpr(pool, node, children);
+  }
+
+  // Evaluates 'expr' over 'rows' a row at a time and a batch at a time, with all rows
+  // and with every third row selected, and checks that the results are the same.
+  template <typename T>
+  void TestEvalBatch(Expr* expr, const vector<TupleRow*>& rows) {
+    Status status = Expr::Prepare(expr, NULL, RowDescriptor());
+    ASSERT_TRUE(status.ok()) << status.GetErrorMsg();
+    for (int step = 1; step <= 3; step += 2) {
+      vector<int> sel;
+      for (int i = 0; i < rows.size(); i += step) {
+        sel.push_back(i);
+      }
+      expr->EvalBatch(&rows[0], &sel[0], sel.size());
+      for (int i = 0; i < sel.size(); ++i) {
+        int row_idx = sel[i];
+        void* value = expr->GetValue(rows[row_idx]);
+        bool batch_is_null = expr->batch_nulls()[row_idx];
+        ASSERT_EQ(value == NULL, batch_is_null) << expr->DebugString() << " row "
+            << row_idx;
+        if (value == NULL) continue;
+        EXPECT_EQ(*reinterpret_cast<T*>(value), expr->batch_values<T>()[row_idx])
+            << expr->DebugString() << " row " << row_idx;
+      }
+    }
+  }
 };
 
 // TODO: Remove this specialization once the parser supports
@@ -1147,6 +1199,25 @@ TEST_F(ExprTest, InPredicate) {
   // Test operator precedence.
   TestValue("5+1 in (3, 6, 10)", TYPE_BOOLEAN, true);
   TestValue("5+1 not in (3, 6, 10)", TYPE_BOOLEAN, false);
+
+  // Test long lists, which are searched with a binary search resp. a hash set, and
+  // NULL and non-literal constant values in the list.
+  stringstream int_list;
+  stringstream string_list;
+  for (int i = 0; i < 1000; ++i) {
+    int_list << (i == 0 ? "" : ", ") << 3 * i;
+    string_list << (i == 0 ? "" : ", ") << "concat('v', '" << 3 * i << "')";
+  }
+  TestValue("1500 in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("1501 in (" + int_list.str() + ")", TYPE_BOOLEAN, false);
+  TestValue("1501 not in (" + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("1500 in (NULL, " + int_list.str() + ")", TYPE_BOOLEAN, true);
+  TestIsNull("1501 in (" + int_list.str() + ", NULL)", TYPE_BOOLEAN);
+  TestIsNull("1501 not in (" + int_list.str() + ", NULL)", TYPE_BOOLEAN);
+  TestValue("'v1500' in (" + string_list.str() + ")", TYPE_BOOLEAN, true);
+  TestValue("'v1501' in (" + string_list.str() + ")", TYPE_BOOLEAN, false);
+  TestIsNull("'v1501' in (NULL, " + string_list.str() + ")", TYPE_BOOLEAN);
+  TestIsNull("NULL in (" + int_list.str() + ")", TYPE_BOOLEAN);
 }
 
 TEST_F(ExprTest, StringFunctions) {
@@ -2478,6 +2549,105 @@ TEST_F(ExprTest, ResultsLayoutTest) {
 
 }
 
+TEST_F(ExprTest, EvalBatch) {
+  ObjectPool pool;
+
+  // Rows with one tuple of a bigint at offset 0 and a double at offset 8.  Every
+  // seventh row has a NULL tuple, which makes the slots NULL.
+  const int num_rows = 1000;
+  vector<uint8_t> tuple_mem(num_rows * 16);
+  vector<Tuple*> row_mem(num_rows);
+  vector<TupleRow*> rows;
+  for (int i = 0; i < num_rows; ++i) {
+    uint8_t* tuple = &tuple_mem[i * 16];
+    *reinterpret_cast<int64_t*>(tuple) = i;
+    *reinterpret_cast<double*>(tuple + 8) = i * 0.5;
+    row_mem[i] = i % 7 == 0 ? NULL : reinterpret_cast<Tuple*>(tuple);
+    rows.push_back(reinterpret_cast<TupleRow*>(&row_mem[i]));
+  }
+
+  TestEvalBatch<int64_t>(pool.Add(new SlotRef(TYPE_BIGINT, 0)), rows);
+  TestEvalBatch<double>(pool.Add(new SlotRef(TYPE_DOUBLE, 8)), rows);
+
+  // Arithmetic
+  TestEvalBatch<int64_t>(CreateExpr(&pool, TExprNodeType::ARITHMETIC_EXPR,
+      TPrimitiveType::BIGINT, TExprOpcode::ADD_LONG_LONG,
+      pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+      Expr::CreateLiteral(&pool, TYPE_BIGINT, "10")), rows);
+  TestEvalBatch<double>(CreateExpr(&pool, TExprNodeType::ARITHMETIC_EXPR,
+      TPrimitiveType::DOUBLE, TExprOpcode::MULTIPLY_DOUBLE_DOUBLE,
+      pool.Add(new SlotRef(TYPE_DOUBLE, 8)),
+      Expr::CreateLiteral(&pool, TYPE_DOUBLE, "2.5")), rows);
+  TestEvalBatch<int64_t>(CreateExpr(&pool, TExprNodeType::ARITHMETIC_EXPR,
+      TPrimitiveType::BIGINT, TExprOpcode::MOD_LONG_LONG,
+      pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+      Expr::CreateLiteral(&pool, TYPE_BIGINT, "7")), rows);
+  TestEvalBatch<int64_t>(CreateExpr(&pool, TExprNodeType::ARITHMETIC_EXPR,
+      TPrimitiveType::BIGINT, TExprOpcode::BITNOT_LONG,
+      pool.Add(new SlotRef(TYPE_BIGINT, 0))), rows);
+
+  // Binary predicates
+  TestEvalBatch<bool>(CreateExpr(&pool, TExprNodeType::BINARY_PRED,
+      TPrimitiveType::BOOLEAN, TExprOpcode::LT_LONG_LONG,
+      pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+      Expr::CreateLiteral(&pool, TYPE_BIGINT, "500")), rows);
+  TestEvalBatch<bool>(CreateExpr(&pool, TExprNodeType::BINARY_PRED,
+      TPrimitiveType::BOOLEAN, TExprOpcode::EQ_DOUBLE_DOUBLE,
+      pool.Add(new SlotRef(TYPE_DOUBLE, 8)),
+      Expr::CreateLiteral(&pool, TYPE_DOUBLE, "100")), rows);
+
+  // Compound predicates: (bigint < 500) AND (double > 100),
+  // (bigint < 100) OR (bigint IS NULL) and NOT (bigint >= 300)
+  TestEvalBatch<bool>(CreateExpr(&pool, TExprNodeType::COMPOUND_PRED,
+      TPrimitiveType::BOOLEAN, TExprOpcode::COMPOUND_AND,
+      CreateExpr(&pool, TExprNodeType::BINARY_PRED, TPrimitiveType::BOOLEAN,
+          TExprOpcode::LT_LONG_LONG, pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+          Expr::CreateLiteral(&pool, TYPE_BIGINT, "500")),
+      CreateExpr(&pool, TExprNodeType::BINARY_PRED, TPrimitiveType::BOOLEAN,
+          TExprOpcode::GT_DOUBLE_DOUBLE, pool.Add(new SlotRef(TYPE_DOUBLE, 8)),
+          Expr::CreateLiteral(&pool, TYPE_DOUBLE, "100"))), rows);
+  TExprNode is_null_node;
+  is_null_node.node_type = TExprNodeType::IS_NULL_PRED;
+  is_null_node.type = TPrimitiveType::BOOLEAN;
+  is_null_node.__set_is_null_pred(TIsNullPredicate());
+  is_null_node.is_null_pred.is_not_null = false;
+  TestEvalBatch<bool>(CreateExpr(&pool, TExprNodeType::COMPOUND_PRED,
+      TPrimitiveType::BOOLEAN, TExprOpcode::COMPOUND_OR,
+      CreateExpr(&pool, TExprNodeType::BINARY_PRED, TPrimitiveType::BOOLEAN,
+          TExprOpcode::LT_LONG_LONG, pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+          Expr::CreateLiteral(&pool, TYPE_BIGINT, "100")),
+      CreateExpr(&pool, is_null_node,
+          list_of<Expr*>(pool.Add(new SlotRef(TYPE_BIGINT, 0))))), rows);
+  TestEvalBatch<bool>(CreateExpr(&pool, TExprNodeType::COMPOUND_PRED,
+      TPrimitiveType::BOOLEAN, TExprOpcode::COMPOUND_NOT,
+      CreateExpr(&pool, TExprNodeType::BINARY_PRED, TPrimitiveType::BOOLEAN,
+          TExprOpcode::GE_LONG_LONG, pool.Add(new SlotRef(TYPE_BIGINT, 0)),
+          Expr::CreateLiteral(&pool, TYPE_BIGINT, "300"))), rows);
+
+  // IS NOT NULL
+  is_null_node.is_null_pred.is_not_null = true;
+  TestEvalBatch<bool>(CreateExpr(&pool, is_null_node,
+      list_of<Expr*>(pool.Add(new SlotRef(TYPE_BIGINT, 0)))), rows);
+
+  // bigint IN (1, 5, NULL, 700) and bigint NOT IN (2, 3)
+  TExprNode in_node;
+  in_node.node_type = TExprNodeType::IN_PRED;
+  in_node.type = TPrimitiveType::BOOLEAN;
+  in_node.__set_in_predicate(TInPredicate());
+  in_node.in_predicate.is_not_in = false;
+  TestEvalBatch<bool>(CreateExpr(&pool, in_node,
+      list_of<Expr*>(pool.Add(new SlotRef(TYPE_BIGINT, 0)))
+          (Expr::CreateLiteral(&pool, TYPE_BIGINT, "1"))
+          (Expr::CreateLiteral(&pool, TYPE_BIGINT, "5"))
+          (Expr::CreateLiteral(&pool, TYPE_NULL, ""))
+          (Expr::CreateLiteral(&pool, TYPE_BIGINT, "700"))), rows);
+  in_node.in_predicate.is_not_in = true;
+  TestEvalBatch<bool>(CreateExpr(&pool, in_node,
+      list_of<Expr*>(pool.Add(new SlotRef(TYPE_BIGINT, 0)))
+          (Expr::CreateLiteral(&pool, TYPE_BIGINT, "2"))
+          (Expr::CreateLiteral(&pool, TYPE_BIGINT, "3"))), rows);
+}
+
 int main(int argc, char **argv) {
   google::InitGoogleLogging(argv[0]);
   ::testing::InitGoogleTest(&argc, argv);
@@ -556,6 +556,71 @@ Status Expr::Prepare(const vector<Expr*>& exprs, RuntimeState* state,
   return Status::OK;
 }
 
+int Expr::BatchValueSize(PrimitiveType type) {
+  switch (type) {
+    case TYPE_STRING:
+      return sizeof(StringValue);
+    case TYPE_TIMESTAMP:
+      return sizeof(TimestampValue);
+    default:
+      return GetByteSize(type);
+  }
+}
+
+void Expr::InitBatchResult(const int* sel, int num_rows) {
+  // The selection is sorted, the last row has the largest index.  Always allocate
+  // at least one entry so the buffers can be dereferenced.
+  int num_entries = num_rows == 0 ? 1 : sel[num_rows - 1] + 1;
+  if (static_cast<int>(batch_nulls_.size()) < num_entries) {
+    batch_nulls_.resize(num_entries);
+    batch_values_.resize(num_entries * BatchValueSize(type_));
+  }
+}
+
+void Expr::EvalChildrenBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  for (int i = 0; i < children_.size(); ++i) {
+    children_[i]->EvalBatch(rows, sel, num_rows);
+  }
+}
+
+void Expr::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  InitBatchResult(sel, num_rows);
+  int value_size = BatchValueSize(type_);
+  uint8_t* values = &batch_values_[0];
+  uint8_t* nulls = &batch_nulls_[0];
+  batch_string_data_.clear();
+
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    void* value = GetValue(rows[row_idx]);
+    nulls[row_idx] = (value == NULL);
+    if (value == NULL) continue;
+    uint8_t* dst = values + row_idx * value_size;
+    if (type_ == TYPE_STRING) {
+      // The string may be in result_ and be overwritten by the next GetValue() call,
+      // so the data is copied.  Since batch_string_data_ can be reallocated while
+      // appending, only the offset is stored here and fixed up below.
+      const StringValue* src = reinterpret_cast<const StringValue*>(value);
+      StringValue* str = reinterpret_cast<StringValue*>(dst);
+      str->ptr = reinterpret_cast<char*>(batch_string_data_.size());
+      str->len = src->len;
+      batch_string_data_.append(src->ptr, src->len);
+    } else {
+      memcpy(dst, value, value_size);
+    }
+  }
+
+  if (type_ == TYPE_STRING) {
+    char* data = const_cast<char*>(batch_string_data_.data());
+    StringValue* strs = mutable_batch_values<StringValue>();
+    for (int i = 0; i < num_rows; ++i) {
+      int row_idx = sel[i];
+      if (nulls[row_idx]) continue;
+      strs[row_idx].ptr = data + reinterpret_cast<size_t>(strs[row_idx].ptr);
+    }
+  }
+}
+
 bool Expr::IsCodegenAvailable(const vector<Expr*>& exprs) {
   for (int i = 0; i < exprs.size(); ++i) {
     if (exprs[i]->codegen_fn() == NULL) return false;
@@ -241,6 +241,22 @@ class Expr {
   // requires timestamp in a string format.
   void GetValue(TupleRow* row, bool as_ascii, TColumnValue* col_val);
 
+  // Evaluates the expr over the rows rows[sel[0]], ..., rows[sel[num_rows - 1]] and
+  // stores the results in batch_values()/batch_nulls(), which are indexed by row:
+  // the result for rows[sel[i]] is at position sel[i].  The entries of rows that
+  // are not selected are undefined.  'sel' must be in ascending order.
+  // The default implementation calls GetValue() for every row; subclasses override
+  // this with loops over the batch results of their children.  The results are
+  // valid until the next EvalBatch() call and as long as 'rows' doesn't change.
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
+
+  // Results of the last EvalBatch() call.  T must match type().
+  template <typename T> const T* batch_values() const {
+    return reinterpret_cast<const T*>(&batch_values_[0]);
+  }
+  // 1 if the result of the row is NULL.
+  const uint8_t* batch_nulls() const { return &batch_nulls_[0]; }
+
   // Convenience functions: print value into 'str' or 'stream'.
   // NULL turns into "NULL".
   void PrintValue(TupleRow* row, std::string* str);
@@ -260,6 +276,7 @@ class Expr {
 
   PrimitiveType type() const { return type_; }
   const std::vector<Expr*>& children() const { return children_; }
+  bool is_slotref() const { return is_slotref_; }
 
   TExprOpcode::type op() const { return opcode_; }
 
@@ -420,6 +437,37 @@ class Expr {
   // TODO: not implemented, always 0
   int scratch_buffer_size_;
 
+  // Results of EvalBatch(), indexed by row.  batch_values_ holds BatchValueSize()
+  // bytes per row.
+  std::vector<uint8_t> batch_values_;
+  std::vector<uint8_t> batch_nulls_;
+
+  // Copies of the string results of the default EvalBatch()
+  std::string batch_string_data_;
+
+  // Number of bytes per row in batch_values_ for 'type'
+  static int BatchValueSize(PrimitiveType type);
+
+  // Resizes batch_values_ and batch_nulls_ to hold the results for the rows
+  // selected by sel[0, num_rows).
+  void InitBatchResult(const int* sel, int num_rows);
+
+  template <typename T> T* mutable_batch_values() {
+    return reinterpret_cast<T*>(&batch_values_[0]);
+  }
+
+  // Calls EvalBatch() on all children.
+  void EvalChildrenBatch(TupleRow* const* rows, const int* sel, int num_rows);
+
+  // Helper for EvalBatch() of binary operators with operands of type T and results
+  // of type R.  For every selected row, the result is Op::Apply(lhs, rhs) of the
+  // batch results of the two children, or NULL if one of them is NULL.
+  // If SKIP_NULLS is false, Op is also applied to the undefined values of NULL
+  // rows, which keeps the loop branch free; that is only valid for an Op that
+  // can't fail on any input (e.g. not for integer division or string comparisons).
+  template <typename T, typename R, typename Op, bool SKIP_NULLS>
+  void EvalBinaryOpBatch(const int* sel, int num_rows);
+
   // Create a compute function prototype.
   // The signature is:
   // <expr ret type> ComputeFn(TupleRow* row, char* state_data, bool* is_null)
@@ -504,13 +552,20 @@ class SlotRef : public Expr {
 
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
   static void* ComputeFn(Expr* expr, TupleRow* row);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
   virtual std::string DebugString() const;
   virtual bool IsConstant() const { return false; }
   virtual int GetSlotIds(std::vector<SlotId>* slot_ids) const;
 
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
 
+  SlotId slot_id() const { return slot_id_; }
+
  protected:
+  // Copies the slot values of the selected rows into batch_values_.
+  template <typename T>
+  void CopySlotsBatch(TupleRow* const* rows, const int* sel, int num_rows);
+
   int tuple_idx_;  // within row
   int slot_offset_;  // within tuple
   NullIndicatorOffset null_indicator_offset_;  // within tuple
@@ -534,6 +589,33 @@ inline void* Expr::GetValue(TupleRow* row) {
   }
 }
 
+template <typename T, typename R, typename Op, bool SKIP_NULLS>
+inline void Expr::EvalBinaryOpBatch(const int* sel, int num_rows) {
+  DCHECK_EQ(children_.size(), 2);
+  if (num_rows == 0) return;
+  const T* lhs = children_[0]->batch_values<T>();
+  const T* rhs = children_[1]->batch_values<T>();
+  const uint8_t* lhs_nulls = children_[0]->batch_nulls();
+  const uint8_t* rhs_nulls = children_[1]->batch_nulls();
+  R* values = mutable_batch_values<R>();
+  uint8_t* nulls = &batch_nulls_[0];
+  if (sel[num_rows - 1] == num_rows - 1) {
+    // All rows in [0, num_rows) are selected, loop over them directly.
+    for (int row_idx = 0; row_idx < num_rows; ++row_idx) {
+      nulls[row_idx] = lhs_nulls[row_idx] | rhs_nulls[row_idx];
+      if (SKIP_NULLS && nulls[row_idx]) continue;
+      values[row_idx] = Op::Apply(lhs[row_idx], rhs[row_idx]);
+    }
+  } else {
+    for (int i = 0; i < num_rows; ++i) {
+      int row_idx = sel[i];
+      nulls[row_idx] = lhs_nulls[row_idx] | rhs_nulls[row_idx];
+      if (SKIP_NULLS && nulls[row_idx]) continue;
+      values[row_idx] = Op::Apply(lhs[row_idx], rhs[row_idx]);
+    }
+  }
+}
+
 }
 
 #endif
@@ -47,12 +47,16 @@ string FunctionCall::DebugString() const {
   return out.str();
 }
 
-bool FunctionCall::SetRegex(const string& pattern) {
+bool FunctionCall::SetRegex(const string& pattern, bool is_constant) {
   try {
     regex_.reset(new regex(pattern, regex_constants::extended));
   } catch(bad_expression& e) {
     return false;
   }
+  if (is_constant) {
+    dfa_regex_.reset(new DfaRegex());
+    if (!dfa_regex_->Init(pattern).ok()) dfa_regex_.reset();
+  }
   return true;
 }
 
@@ -21,6 +21,7 @@
 #include <boost/regex.hpp>
 
 #include "exprs/expr.h"
+#include "util/dfa-regex.h"
 
 namespace impala {
 
@@ -36,10 +37,15 @@ class FunctionCall: public Expr {
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
   virtual std::string DebugString() const;
 
-  // Returns false if the pattern is invalid, true otherwise.
-  bool SetRegex(const std::string& pattern);
+  // Returns false if the pattern is invalid, true otherwise.  If the pattern is
+  // constant, also builds a DfaRegex for it if it's supported.
+  bool SetRegex(const std::string& pattern, bool is_constant);
   const boost::regex* GetRegex() const { return regex_.get(); }
 
+  // Returns NULL if there is none.  Used to rule out matches in linear time before
+  // extracting submatches with GetRegex().
+  DfaRegex* GetDfaRegex() { return dfa_regex_.get(); }
+
   void SetReplaceStr(const StringValue* str_val);
   const std::string* GetReplaceStr() const { return replace_str_.get(); }
 
@@ -47,6 +53,7 @@ class FunctionCall: public Expr {
   // Used in regexp string functions to avoid re-compiling
   // a constant regexp for every function invocation.
   boost::scoped_ptr<boost::regex> regex_;
+  boost::scoped_ptr<DfaRegex> dfa_regex_;
   // To avoid copying constant replace strings in regexp_replace.
   boost::scoped_ptr<std::string> replace_str_;
 };
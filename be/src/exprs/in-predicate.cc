@@ -12,27 +12,140 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <sstream>
+#include <boost/unordered_set.hpp>
 
 #include "exprs/in-predicate.h"
 #include "codegen/llvm-codegen.h"
+#include "runtime/mem-pool.h"
 #include "runtime/raw-value.h"
 #include "runtime/string-value.inline.h"
+#include "util/hash-util.h"
 
 using namespace llvm;
 using namespace std;
 
 namespace impala {
 
+// ValueSet for fixed-width types, stored in a sorted array.
+template <typename T>
+class SortedValueSet : public InPredicate::ValueSet {
+ public:
+  virtual void Insert(const void* value) {
+    const T& v = *reinterpret_cast<const T*>(value);
+    // NaN doesn't equal anything (and would break the sort order)
+    if (v != v) return;
+    values_.push_back(v);
+  }
+
+  virtual void Finalize() {
+    sort(values_.begin(), values_.end());
+    values_.erase(unique(values_.begin(), values_.end()), values_.end());
+  }
+
+  virtual bool Contains(const void* value) const {
+    const T& v = *reinterpret_cast<const T*>(value);
+    if (values_.size() <= MAX_LINEAR_SEARCH_SIZE) {
+      // No early exit, so the compiler can turn this into vector compares
+      bool found = false;
+      for (int i = 0; i < values_.size(); ++i) {
+        found |= (values_[i] == v);
+      }
+      return found;
+    }
+    return binary_search(values_.begin(), values_.end(), v);
+  }
+
+  virtual int size() const { return values_.size(); }
+
+ private:
+  // Lists up to this size are searched linearly
+  static const int MAX_LINEAR_SEARCH_SIZE = 16;
+
+  vector<T> values_;
+};
+
+// ValueSet for strings.  The string data is copied since the values returned by
+// (non-literal) constant exprs are only valid until they are evaluated again.
+class StringValueSet : public InPredicate::ValueSet {
+ public:
+  virtual void Insert(const void* value) {
+    StringValue copy;
+    RawValue::Write(value, &copy, TYPE_STRING, &pool_);
+    values_.insert(copy);
+  }
+
+  virtual bool Contains(const void* value) const {
+    return values_.find(*reinterpret_cast<const StringValue*>(value)) != values_.end();
+  }
+
+  virtual int size() const { return values_.size(); }
+
+ private:
+  struct Hash {
+    size_t operator()(const StringValue& v) const {
+      return HashUtil::Hash(v.ptr, v.len, 0);
+    }
+  };
+
+  MemPool pool_;
+  boost::unordered_set<StringValue, Hash> values_;
+};
+
 InPredicate::InPredicate(const TExprNode& node)
   : Predicate(node),
-    is_not_in_(node.in_predicate.is_not_in) {
+    is_not_in_(node.in_predicate.is_not_in),
+    value_set_has_null_(false) {
+}
+
+InPredicate::ValueSet* InPredicate::CreateValueSet(PrimitiveType type) {
+  switch (type) {
+    case TYPE_BOOLEAN:
+      return new SortedValueSet<bool>();
+    case TYPE_TINYINT:
+      return new SortedValueSet<int8_t>();
+    case TYPE_SMALLINT:
+      return new SortedValueSet<int16_t>();
+    case TYPE_INT:
+      return new SortedValueSet<int32_t>();
+    case TYPE_BIGINT:
+      return new SortedValueSet<int64_t>();
+    case TYPE_FLOAT:
+      return new SortedValueSet<float>();
+    case TYPE_DOUBLE:
+      return new SortedValueSet<double>();
+    case TYPE_STRING:
+      return new StringValueSet();
+    case TYPE_TIMESTAMP:
+      return new SortedValueSet<TimestampValue>();
+    default:
+      return NULL;
+  }
 }
 
 Status InPredicate::Prepare(RuntimeState* state, const RowDescriptor& desc) {
   DCHECK_GE(children_.size(), 2);
   Expr::PrepareChildren(state, desc);
   compute_fn_ = ComputeFn;
+
+  for (int i = 1; i < children_.size(); ++i) {
+    if (!children_[i]->IsConstant()) return Status::OK;
+  }
+  value_set_.reset(CreateValueSet(children_[0]->type()));
+  if (value_set_.get() == NULL) return Status::OK;
+  for (int i = 1; i < children_.size(); ++i) {
+    DCHECK(children_[0]->type() == children_[i]->type()
+        || children_[i]->type() == TYPE_NULL);
+    void* value = children_[i]->GetValue(NULL);
+    if (value == NULL) {
+      value_set_has_null_ = true;
+    } else {
+      value_set_->Insert(value);
+    }
+  }
+  value_set_->Finalize();
+  compute_fn_ = SetComputeFn;
   return Status::OK;
 }
 
@@ -72,6 +185,160 @@ void* InPredicate::ComputeFn(Expr* e, TupleRow* row) {
   return &e->result_.bool_val;
 }
 
+void* InPredicate::SetComputeFn(Expr* e, TupleRow* row) {
+  void* cmp_val = e->children()[0]->GetValue(row);
+  if (cmp_val == NULL) return NULL;
+  InPredicate* in_pred = static_cast<InPredicate*>(e);
+  if (in_pred->value_set_->Contains(cmp_val)) {
+    e->result_.bool_val = !in_pred->is_not_in_;
+    return &e->result_.bool_val;
+  }
+  if (in_pred->value_set_has_null_) return NULL;
+  e->result_.bool_val = in_pred->is_not_in_;
+  return &e->result_.bool_val;
+}
+
+template <typename T>
+int InPredicate::MatchBatch(Expr* child, int* sel, int num_rows) {
+  const T* cmp_values = children_[0]->batch_values<T>();
+  const T* child_values = child->batch_values<T>();
+  const uint8_t* child_nulls = child->batch_nulls();
+  bool* values = mutable_batch_values<bool>();
+  int num_remaining = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    if (child_nulls[row_idx]) {
+      batch_found_null_[row_idx] = true;
+    } else if (cmp_values[row_idx] == child_values[row_idx]) {
+      values[row_idx] = !is_not_in_;
+      batch_nulls_[row_idx] = false;
+      continue;
+    }
+    sel[num_remaining++] = row_idx;
+  }
+  return num_remaining;
+}
+
+template <typename T>
+void InPredicate::LookupBatch(const int* sel, int num_rows) {
+  const T* cmp_values = children_[0]->batch_values<T>();
+  bool* values = mutable_batch_values<bool>();
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    if (value_set_->Contains(&cmp_values[row_idx])) {
+      values[row_idx] = !is_not_in_;
+      batch_nulls_[row_idx] = false;
+    } else {
+      values[row_idx] = is_not_in_;
+      batch_nulls_[row_idx] = value_set_has_null_;
+    }
+  }
+}
+
+// The in-list exprs are evaluated one at a time, each only for the rows that didn't
+// match any of the previous values.  With a value_set_, each row is looked up once.
+void InPredicate::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  Expr* cmp_expr = children_[0];
+  cmp_expr->EvalBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  if (batch_found_null_.size() < batch_nulls_.size()) {
+    batch_found_null_.resize(batch_nulls_.size());
+  }
+  const uint8_t* cmp_nulls = cmp_expr->batch_nulls();
+  batch_sel_.resize(max(num_rows, 1));
+  int num_remaining = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    if (cmp_nulls[row_idx]) {
+      batch_nulls_[row_idx] = true;
+    } else {
+      batch_found_null_[row_idx] = false;
+      batch_sel_[num_remaining++] = row_idx;
+    }
+  }
+
+  if (value_set_.get() != NULL) {
+    int* remaining = &batch_sel_[0];
+    switch (cmp_expr->type()) {
+      case TYPE_BOOLEAN:
+        LookupBatch<bool>(remaining, num_remaining);
+        break;
+      case TYPE_TINYINT:
+        LookupBatch<int8_t>(remaining, num_remaining);
+        break;
+      case TYPE_SMALLINT:
+        LookupBatch<int16_t>(remaining, num_remaining);
+        break;
+      case TYPE_INT:
+        LookupBatch<int32_t>(remaining, num_remaining);
+        break;
+      case TYPE_BIGINT:
+        LookupBatch<int64_t>(remaining, num_remaining);
+        break;
+      case TYPE_FLOAT:
+        LookupBatch<float>(remaining, num_remaining);
+        break;
+      case TYPE_DOUBLE:
+        LookupBatch<double>(remaining, num_remaining);
+        break;
+      case TYPE_STRING:
+        LookupBatch<StringValue>(remaining, num_remaining);
+        break;
+      case TYPE_TIMESTAMP:
+        LookupBatch<TimestampValue>(remaining, num_remaining);
+        break;
+      default:
+        DCHECK(false) << "Invalid type: " << TypeToString(cmp_expr->type());
+    }
+    return;
+  }
+
+  for (int i = 1; i < children_.size() && num_remaining > 0; ++i) {
+    Expr* child = children_[i];
+    int* remaining = &batch_sel_[0];
+    child->EvalBatch(rows, remaining, num_remaining);
+    switch (cmp_expr->type()) {
+      case TYPE_BOOLEAN:
+        num_remaining = MatchBatch<bool>(child, remaining, num_remaining);
+        break;
+      case TYPE_TINYINT:
+        num_remaining = MatchBatch<int8_t>(child, remaining, num_remaining);
+        break;
+      case TYPE_SMALLINT:
+        num_remaining = MatchBatch<int16_t>(child, remaining, num_remaining);
+        break;
+      case TYPE_INT:
+        num_remaining = MatchBatch<int32_t>(child, remaining, num_remaining);
+        break;
+      case TYPE_BIGINT:
+        num_remaining = MatchBatch<int64_t>(child, remaining, num_remaining);
+        break;
+      case TYPE_FLOAT:
+        num_remaining = MatchBatch<float>(child, remaining, num_remaining);
+        break;
+      case TYPE_DOUBLE:
+        num_remaining = MatchBatch<double>(child, remaining, num_remaining);
+        break;
+      case TYPE_STRING:
+        num_remaining = MatchBatch<StringValue>(child, remaining, num_remaining);
+        break;
+      case TYPE_TIMESTAMP:
+        num_remaining = MatchBatch<TimestampValue>(child, remaining, num_remaining);
+        break;
+      default:
+        DCHECK(false) << "Invalid type: " << TypeToString(cmp_expr->type());
+    }
+  }
+
+  // The remaining rows didn't match any value
+  bool* values = mutable_batch_values<bool>();
+  for (int i = 0; i < num_remaining; ++i) {
+    int row_idx = batch_sel_[i];
+    batch_nulls_[row_idx] = batch_found_null_[row_idx];
+    values[row_idx] = is_not_in_;
+  }
+}
+
 // LLVM IR generation for InPredicate. Resulting IR looks like:
 //
 // define i1 @InPredicate(i8** %row, i8* %state_data, i1* %is_null) {
@@ -123,6 +390,7 @@ void* InPredicate::ComputeFn(Expr* e, TupleRow* row) {
 // i.e. if (cmp_val == 1 || cmp_val == 3 || cmp_val == 5) return true
 Function* InPredicate::Codegen(LlvmCodeGen* codegen) {
   DCHECK_GE(GetNumChildren(), 1);
+  if (value_set_.get() != NULL) return CodegenSetLookup(codegen);
   for (int i = 0; i < GetNumChildren(); ++i) {
     // Codegen the child exprs
     if (children()[i]->Codegen(codegen) == NULL) return NULL;
@@ -198,4 +466,89 @@ Function* InPredicate::Codegen(LlvmCodeGen* codegen) {
   return codegen->FinalizeFunction(function);
 }
 
+// LLVM IR generation for InPredicate with a value set.  The IR for int_col in (...) is:
+//
+// define i1 @InPredicate(i8** %row, i8* %state_data, i1* %is_null) {
+// entry:
+//   %cmp_value_ptr = alloca i32
+//   %cmp_value = call i32 @SlotRef(i8** %row, i8* %state_data, i1* %is_null)
+//   %child_null = load i1* %is_null
+//   br i1 %child_null, label %null_found, label %lookup
+//
+// lookup:                                           ; preds = %entry
+//   store i32 %cmp_value, i32* %cmp_value_ptr
+//   %0 = bitcast i32* %cmp_value_ptr to i8*
+//   %found = call i1 @IrInPredicateSetContains(%"class.impala::Expr"* inttoptr
+//       (i64 69012864 to %"class.impala::Expr"*), i8* %0)
+//   br i1 %found, label %is_equal, label %not_found
+//
+// is_equal:                                         ; preds = %lookup
+//   store i1 false, i1* %is_null
+//   ret i1 true
+//
+// not_found:                                        ; preds = %lookup
+//   store i1 false, i1* %is_null
+//   ret i1 false
+//
+// null_found:                                       ; preds = %entry
+//   store i1 true, i1* %is_null
+//   ret i1 false
+// }
+// If the in-list contains NULL, not_found branches to null_found.
+Function* InPredicate::CodegenSetLookup(LlvmCodeGen* codegen) {
+  DCHECK(value_set_.get() != NULL);
+  Expr* cmp_expr = children()[0];
+  if (cmp_expr->Codegen(codegen) == NULL) return NULL;
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Type* expr_type = codegen->GetType(Expr::LLVM_CLASS_NAME);
+  DCHECK(expr_type != NULL);
+  Function* contains_fn = codegen->GetFunction(IRFunction::IN_PREDICATE_SET_CONTAINS);
+  DCHECK(contains_fn != NULL);
+
+  Function* function = CreateComputeFnPrototype(codegen, "InPredicate");
+  BasicBlock* entry_block = BasicBlock::Create(context, "entry", function);
+  BasicBlock* lookup_block = BasicBlock::Create(context, "lookup", function);
+  BasicBlock* is_equal_block = BasicBlock::Create(context, "is_equal", function);
+  BasicBlock* not_found_block = BasicBlock::Create(context, "not_found", function);
+  BasicBlock* null_found_block = BasicBlock::Create(context, "null_found", function);
+
+  builder.SetInsertPoint(entry_block);
+  // Strings are returned as pointers, other values need to be passed by reference
+  Value* cmp_value_ptr = NULL;
+  if (cmp_expr->type() != TYPE_STRING) {
+    cmp_value_ptr = codegen->CreateEntryBlockAlloca(function,
+        LlvmCodeGen::NamedVariable("cmp_value_ptr", codegen->GetType(cmp_expr->type())));
+  }
+  Value* cmp_value = cmp_expr->CodegenGetValue(codegen, entry_block,
+      null_found_block, lookup_block, "cmp_value");
+
+  builder.SetInsertPoint(lookup_block);
+  if (cmp_value_ptr != NULL) {
+    builder.CreateStore(cmp_value, cmp_value_ptr);
+  } else {
+    cmp_value_ptr = cmp_value;
+  }
+  Value* this_llvm = codegen->CastPtrToLlvmPtr(PointerType::get(expr_type, 0), this);
+  Value* found = builder.CreateCall2(contains_fn, this_llvm,
+      builder.CreateBitCast(cmp_value_ptr, codegen->ptr_type()), "found");
+  builder.CreateCondBr(found, is_equal_block,
+      value_set_has_null_ ? null_found_block : not_found_block);
+
+  builder.SetInsertPoint(is_equal_block);
+  CodegenSetIsNullArg(codegen, is_equal_block, false);
+  builder.CreateRet(is_not_in_ ? codegen->false_value() : codegen->true_value());
+
+  builder.SetInsertPoint(not_found_block);
+  CodegenSetIsNullArg(codegen, not_found_block, false);
+  builder.CreateRet(is_not_in_ ? codegen->true_value() : codegen->false_value());
+
+  builder.SetInsertPoint(null_found_block);
+  CodegenSetIsNullArg(codegen, null_found_block, true);
+  builder.CreateRet(GetNullReturnValue(codegen));
+
+  return codegen->FinalizeFunction(function);
+}
+
 }
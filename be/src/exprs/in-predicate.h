@@ -17,13 +17,44 @@
 #define IMPALA_EXPRS_IN_PREDICATE_H_
 
 #include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
 #include "exprs/predicate.h"
 
 namespace impala {
 
+// If all in-list values are constant, they are evaluated once in Prepare() and stored
+// in a ValueSet: a sorted array for fixed-width types (searched linearly for short
+// lists, with a binary search otherwise) or a hash set for strings.  Each row then only
+// costs a single lookup instead of evaluating and comparing every in-list value.
 class InPredicate : public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* codegen);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
+
+  // Set of the non-NULL values of a constant in-list.  Values are passed as pointers
+  // to the type of the compared expr.
+  class ValueSet {
+   public:
+    virtual ~ValueSet() { }
+
+    // Adds a copy of 'value'
+    virtual void Insert(const void* value) = 0;
+
+    // Must be called after all values have been inserted, before Contains()
+    virtual void Finalize() { }
+
+    virtual bool Contains(const void* value) const = 0;
+
+    virtual int size() const = 0;
+  };
+
+  // Returns true if 'value' is in value_set_.  Called by the codegen'd compute
+  // function.
+  bool SetContains(const void* value) const { return value_set_->Contains(value); }
+
+  // True for NOT IN.  Children are the compared expr followed by the in-list values.
+  bool is_not_in() const { return is_not_in_; }
 
  protected:
   friend class Expr;
@@ -35,7 +66,40 @@ class InPredicate : public Predicate {
 
  private:
    const bool is_not_in_;
+
+   // Constant in-list values, NULL if some of them aren't constant
+   boost::scoped_ptr<ValueSet> value_set_;
+
+   // True if one of the constant in-list values is NULL
+   bool value_set_has_null_;
+
+   // Creates an empty ValueSet for values of 'type'
+   static ValueSet* CreateValueSet(PrimitiveType type);
+
    static void* ComputeFn(Expr* e, TupleRow* row);
+
+   // Compute function used if value_set_ is set
+   static void* SetComputeFn(Expr* e, TupleRow* row);
+
+   // Codegen for the value_set_ case: calls SetContains() instead of comparing
+   // the in-list values.
+   llvm::Function* CodegenSetLookup(LlvmCodeGen* codegen);
+
+   // Looks up the batch results of the compared expr for the rows in 'sel' in
+   // value_set_ and sets the result of those rows.
+   template <typename T> void LookupBatch(const int* sel, int num_rows);
+
+   // Compares the batch results of the in-list expr 'child' to the values of the
+   // rows in 'sel'.  Sets the result of the rows that match and removes them from
+   // 'sel'; rows for which 'child' is NULL are recorded in batch_found_null_.
+   // Returns the number of rows left in 'sel'.
+   template <typename T> int MatchBatch(Expr* child, int* sel, int num_rows);
+
+   // Rows that didn't match any of the in-list values so far in EvalBatch()
+   std::vector<int> batch_sel_;
+
+   // Indexed by row, true if one of the in-list values was NULL
+   std::vector<uint8_t> batch_found_null_;
 };
 
 }
@@ -33,6 +33,19 @@ void* IsNullPredicate::ComputeFn(Expr* e, TupleRow* row) {
   return &p->result_.bool_val;
 }
 
+void IsNullPredicate::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  Expr* child = children_[0];
+  child->EvalBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  const uint8_t* child_nulls = child->batch_nulls();
+  bool* values = mutable_batch_values<bool>();
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    values[row_idx] = child_nulls[row_idx] != is_not_null_;
+    batch_nulls_[row_idx] = false;
+  }
+}
+
 IsNullPredicate::IsNullPredicate(const TExprNode& node)
   : Predicate(node),
     is_not_null_(node.is_null_pred.is_not_null) {
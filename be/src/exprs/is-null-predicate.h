@@ -26,6 +26,7 @@ class TExprNode;
 class IsNullPredicate: public Predicate {
  public:
   virtual llvm::Function* Codegen(LlvmCodeGen* code_gen);
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
 
  protected:
   friend class Expr;
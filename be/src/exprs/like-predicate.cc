@@ -14,6 +14,7 @@
 
 #include "exprs/like-predicate.h"
 
+#include <algorithm>
 #include <sstream>
 #include <boost/regex.hpp>
 #include <string.h>
@@ -90,6 +91,35 @@ void* LikePredicate::ConstantRegexFn(Expr* e, TupleRow* row) {
   return &p->result_.bool_val;
 }
 
+void* LikePredicate::ConstantDfaRegexFn(Expr* e, TupleRow* row) {
+  LikePredicate* p = static_cast<LikePredicate*>(e);
+  DCHECK_EQ(p->GetNumChildren(), 2);
+  StringValue* operand_val = static_cast<StringValue*>(e->GetChild(0)->GetValue(row));
+  if (operand_val == NULL) return NULL;
+  p->result_.bool_val = p->dfa_regex_->FullMatch(operand_val->ptr, operand_val->len);
+  return &p->result_.bool_val;
+}
+
+void LikePredicate::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  if (dfa_regex_.get() == NULL) {
+    Expr::EvalBatch(rows, sel, num_rows);
+    return;
+  }
+  Expr* operand = children_[0];
+  operand->EvalBatch(rows, sel, num_rows);
+  InitBatchResult(sel, num_rows);
+  const uint8_t* operand_nulls = operand->batch_nulls();
+  batch_sel_.resize(max(num_rows, 1));
+  int num_not_null = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    batch_nulls_[row_idx] = operand_nulls[row_idx];
+    if (!operand_nulls[row_idx]) batch_sel_[num_not_null++] = row_idx;
+  }
+  dfa_regex_->FullMatchBatch(operand->batch_values<StringValue>(), &batch_sel_[0],
+      num_not_null, mutable_batch_values<bool>());
+}
+
 void* LikePredicate::RegexMatch(Expr* e, TupleRow* row, bool is_like_pattern) {
   LikePredicate* p = static_cast<LikePredicate*>(e);
   StringValue* operand_value = static_cast<StringValue*>(e->GetChild(0)->GetValue(row));
@@ -194,6 +224,13 @@ Status LikePredicate::Prepare(RuntimeState* state, const RowDescriptor& row_desc
       return Status("Invalid regular expression: " + pattern_str);
     }
     compute_fn_ = ConstantRegexFn;
+    // boost::regex backtracks, use the linear time matcher if it supports the pattern
+    dfa_regex_.reset(new DfaRegex());
+    if (dfa_regex_->Init(re_pattern).ok()) {
+      compute_fn_ = ConstantDfaRegexFn;
+    } else {
+      dfa_regex_.reset();
+    }
   }
   return Status::OK;
 }
@@ -17,16 +17,24 @@
 #define IMPALA_EXPRS_LIKE_PREDICATE_H_
 
 #include <string>
+#include <vector>
 #include <boost/scoped_ptr.hpp> 
 #include <boost/regex.hpp> 
 
 #include "exprs/predicate.h"
 #include "gen-cpp/Exprs_types.h"
 #include "runtime/string-search.h"
+#include "util/dfa-regex.h"
 
 namespace impala {
 
+// Constant patterns that aren't simple substring/prefix/suffix/equality checks are
+// matched with a DfaRegex, which runs in linear time, if it supports the pattern, and
+// with boost::regex otherwise.
 class LikePredicate: public Predicate {
+ public:
+  virtual void EvalBatch(TupleRow* const* rows, const int* sel, int num_rows);
+
  protected:
   friend class Expr;
   virtual Status Prepare(RuntimeState* state, const RowDescriptor& row_desc);
@@ -41,6 +49,12 @@ class LikePredicate: public Predicate {
   StringSearch substring_pattern_;
   boost::scoped_ptr<boost::regex> regex_;
 
+  // Set if the pattern is constant and supported by DfaRegex
+  boost::scoped_ptr<DfaRegex> dfa_regex_;
+
+  // Rows with a non-NULL operand in EvalBatch()
+  std::vector<int> batch_sel_;
+
   // Convert a LIKE pattern (with embedded % and _) into the corresponding
   // regular expression pattern. Escaped chars are copied verbatim.
   void ConvertLikePattern(const StringValue* pattern, std::string* re_pattern) const;
@@ -58,6 +72,7 @@ class LikePredicate: public Predicate {
   static void* ConstantEqualsFn(Expr* e, TupleRow* row);
 
   static void* ConstantRegexFn(Expr* e, TupleRow* row);
+  static void* ConstantDfaRegexFn(Expr* e, TupleRow* row);
   static void* LikeFn(Expr* e, TupleRow* row);
   static void* RegexFn(Expr* e, TupleRow* row);
   static void* RegexMatch(Expr* e, TupleRow* row, bool is_like_pattern);
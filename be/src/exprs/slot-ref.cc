@@ -74,6 +74,55 @@ Status SlotRef::Prepare(RuntimeState* state, const RowDescriptor& row_desc) {
   return Status::OK;
 }
 
+template <typename T>
+void SlotRef::CopySlotsBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  T* values = mutable_batch_values<T>();
+  uint8_t* nulls = &batch_nulls_[0];
+  for (int i = 0; i < num_rows; ++i) {
+    int row_idx = sel[i];
+    Tuple* t = rows[row_idx]->GetTuple(tuple_idx_);
+    bool is_null = t == NULL || t->IsNull(null_indicator_offset_);
+    nulls[row_idx] = is_null;
+    if (!is_null) values[row_idx] = *reinterpret_cast<T*>(t->GetSlot(slot_offset_));
+  }
+}
+
+void SlotRef::EvalBatch(TupleRow* const* rows, const int* sel, int num_rows) {
+  InitBatchResult(sel, num_rows);
+  switch (type_) {
+    case TYPE_BOOLEAN:
+      CopySlotsBatch<bool>(rows, sel, num_rows);
+      break;
+    case TYPE_TINYINT:
+      CopySlotsBatch<int8_t>(rows, sel, num_rows);
+      break;
+    case TYPE_SMALLINT:
+      CopySlotsBatch<int16_t>(rows, sel, num_rows);
+      break;
+    case TYPE_INT:
+      CopySlotsBatch<int32_t>(rows, sel, num_rows);
+      break;
+    case TYPE_BIGINT:
+      CopySlotsBatch<int64_t>(rows, sel, num_rows);
+      break;
+    case TYPE_FLOAT:
+      CopySlotsBatch<float>(rows, sel, num_rows);
+      break;
+    case TYPE_DOUBLE:
+      CopySlotsBatch<double>(rows, sel, num_rows);
+      break;
+    case TYPE_TIMESTAMP:
+      CopySlotsBatch<TimestampValue>(rows, sel, num_rows);
+      break;
+    case TYPE_STRING:
+      // The string data stays in the tuples, only the StringValues are copied.
+      CopySlotsBatch<StringValue>(rows, sel, num_rows);
+      break;
+    default:
+      Expr::EvalBatch(rows, sel, num_rows);
+  }
+}
+
 int SlotRef::GetSlotIds(vector<SlotId>* slot_ids) const {
   slot_ids->push_back(slot_id_);
   return 1;
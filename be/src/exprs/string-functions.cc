@@ -381,13 +381,19 @@ void* StringFunctions::RegexpExtract(Expr* e, TupleRow* row) {
   if ((!e->children()[1]->IsConstant()) ||
       (e->children()[1]->IsConstant() && func_expr->GetRegex() == NULL)) {
     string pattern_str(pattern->ptr, pattern->len);
-    bool valid_pattern = func_expr->SetRegex(pattern_str);
+    bool valid_pattern =
+        func_expr->SetRegex(pattern_str, e->children()[1]->IsConstant());
     // Hive throws an exception for invalid patterns.
     if (!valid_pattern) {
       return NULL;
     }
   }
   DCHECK(func_expr->GetRegex() != NULL);
+  DfaRegex* dfa_regex = func_expr->GetDfaRegex();
+  if (dfa_regex != NULL && !dfa_regex->PartialMatch(str->ptr, str->len)) {
+    e->result_.SetStringVal("");
+    return &e->result_.string_val;
+  }
   cmatch matches;
   // cast's are necessary to make boost understand which function we want.
   // use match_posix to return the leftmost maximal match (and not the first match)
@@ -415,7 +421,8 @@ void* StringFunctions::RegexpReplace(Expr* e, TupleRow* row) {
   if ((!e->children()[1]->IsConstant()) ||
       (e->children()[1]->IsConstant() && func_expr->GetRegex() == NULL)) {
     string pattern_str(pattern->ptr, pattern->len);
-    bool valid_pattern = func_expr->SetRegex(pattern_str);
+    bool valid_pattern =
+        func_expr->SetRegex(pattern_str, e->children()[1]->IsConstant());
     // Hive throws an exception for invalid patterns.
     if (!valid_pattern) {
       return NULL;
@@ -429,6 +436,12 @@ void* StringFunctions::RegexpReplace(Expr* e, TupleRow* row) {
     func_expr->SetReplaceStr(replace);
   }
   DCHECK(func_expr->GetReplaceStr() != NULL);
+  DfaRegex* dfa_regex = func_expr->GetDfaRegex();
+  if (dfa_regex != NULL && !dfa_regex->PartialMatch(str->ptr, str->len)) {
+    // Nothing to replace
+    e->result_.string_val = *str;
+    return &e->result_.string_val;
+  }
   e->result_.string_data.clear();
   // cast's are necessary to make boost understand which function we want.
   re_detail::string_out_iterator<basic_string<char> >
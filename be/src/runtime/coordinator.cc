@@ -306,6 +306,10 @@ Status Coordinator::Exec(
   // execution at backends where it hasn't even started
   lock_guard<mutex> l(lock_);
 
+  // time to prepare the coordinator fragment and start the fragment instances
+  MonotonicStopWatch startup_watch;
+  startup_watch.Start();
+
   // we run the root fragment ourselves if it is unpartitioned
   bool has_coordinator_fragment =
       request->fragments[0].partition.type == TPartitionType::UNPARTITIONED;
@@ -418,6 +422,9 @@ Status Coordinator::Exec(
     }
   }
 
+  COUNTER_SET(ADD_TIMER(query_profile_, "FragmentStartupTime"),
+      static_cast<int64_t>(startup_watch.ElapsedTime()));
+
   // If we have a coordinator fragment and remote fragments (the common case),
   // release the thread token on the coordinator fragment.  This fragment
   // spends most of the time waiting and doing very little work.  Holding on to
@@ -1178,6 +1185,13 @@ void Coordinator::ComputeFragmentExecParams(const TQueryExecRequest& exec_reques
   fragment_exec_params_.resize(exec_request.fragments.size());
   ComputeFragmentHosts(exec_request);
 
+  if (query_options_.num_instances_per_host > 1) {
+    for (int i = 0; i < exec_request.fragments.size(); ++i) {
+      if (!CanRunMultipleInstances(exec_request, i)) continue;
+      ComputeFragmentInstances(i, query_options_.num_instances_per_host);
+    }
+  }
+
   // assign instance ids
   BOOST_FOREACH(FragmentExecParams& params, fragment_exec_params_) {
     for (int j = 0; j < params.hosts.size(); ++j) {
@@ -1257,6 +1271,18 @@ void Coordinator::ComputeFragmentHosts(const TQueryExecRequest& exec_request) {
       DCHECK_GE(input_fragment_idx, 0);
       DCHECK_LT(input_fragment_idx, fragment_exec_params_.size());
       params.hosts = fragment_exec_params_[input_fragment_idx].hosts;
+      // a partitioned join also receives its build side from another fragment;
+      // add that fragment's hosts so that the build (which might be the larger
+      // input) is spread across all hosts that produce data for the join
+      boost::unordered_set<TNetworkAddress> hosts(
+          params.hosts.begin(), params.hosts.end());
+      for (int j = 0; j < exec_request.dest_fragment_idx.size(); ++j) {
+        if (exec_request.dest_fragment_idx[j] != i) continue;
+        const vector<TNetworkAddress>& input_hosts = fragment_exec_params_[j + 1].hosts;
+        for (int k = 0; k < input_hosts.size(); ++k) {
+          if (hosts.insert(input_hosts[k]).second) params.hosts.push_back(input_hosts[k]);
+        }
+      }
       // TODO: switch to unpartitioned/coord execution if our input fragment
       // is executed that way (could have been downgraded from distributed)
       continue;
@@ -1282,6 +1308,69 @@ void Coordinator::ComputeFragmentHosts(const TQueryExecRequest& exec_request) {
   }
 }
 
+int64_t GetScanRangeLength(const TScanRange& scan_range) {
+  if (scan_range.__isset.hdfs_file_split) {
+    return scan_range.hdfs_file_split.length;
+  } else {
+    return 0;
+  }
+}
+
+bool Coordinator::CanRunMultipleInstances(const TQueryExecRequest& exec_request,
+    int fragment_idx) {
+  const TPlanFragment& fragment = exec_request.fragments[fragment_idx];
+  if (fragment.partition.type == TPartitionType::UNPARTITIONED) return false;
+  vector<TPlanNodeType::type> scan_node_types;
+  scan_node_types.push_back(TPlanNodeType::HDFS_SCAN_NODE);
+  scan_node_types.push_back(TPlanNodeType::HBASE_SCAN_NODE);
+  PlanNodeId leftmost_scan_id = FindLeftmostNode(fragment.plan, scan_node_types);
+  BOOST_FOREACH(const TPlanNode& node, fragment.plan.nodes) {
+    if (node.node_type != TPlanNodeType::HDFS_SCAN_NODE &&
+        node.node_type != TPlanNodeType::HBASE_SCAN_NODE) {
+      continue;
+    }
+    // Any other scan would have to be read in full by every instance (e.g. the build
+    // side of a join), splitting it would produce wrong results.
+    if (node.node_id != leftmost_scan_id) return false;
+  }
+  // A scan without ranges runs on the coordinator, it has nothing to split.
+  return leftmost_scan_id == g_ImpalaInternalService_constants.INVALID_PLAN_NODE_ID ||
+      !scan_range_assignment_[fragment_idx].empty();
+}
+
+void Coordinator::ComputeFragmentInstances(int fragment_idx, int num_instances) {
+  FragmentExecParams& params = fragment_exec_params_[fragment_idx];
+  const FragmentScanRangeAssignment& assignment = scan_range_assignment_[fragment_idx];
+  SimpleScheduler::HostList hosts;
+  hosts.swap(params.hosts);
+  if (!assignment.empty()) {
+    params.per_instance_scan_ranges.resize(hosts.size() * num_instances);
+  }
+  vector<int64_t> assigned_bytes(num_instances);
+  for (int i = 0; i < hosts.size(); ++i) {
+    int first_instance = params.hosts.size();
+    params.hosts.insert(params.hosts.end(), num_instances, hosts[i]);
+    FragmentScanRangeAssignment::const_iterator host_ranges = assignment.find(hosts[i]);
+    if (host_ranges == assignment.end()) continue;
+    BOOST_FOREACH(const PerNodeScanRanges::value_type& entry, host_ranges->second) {
+      // Give each range to the instance with the fewest bytes so far.  Ranges of the
+      // same node are of similar size so this is close to an even split.
+      fill(assigned_bytes.begin(), assigned_bytes.end(), 0);
+      BOOST_FOREACH(const TScanRangeParams& scan_range_params, entry.second) {
+        int instance = min_element(assigned_bytes.begin(), assigned_bytes.end()) -
+            assigned_bytes.begin();
+        // Ranges without a length (e.g. hbase) are assigned round robin.
+        assigned_bytes[instance] +=
+            max(GetScanRangeLength(scan_range_params.scan_range), 1L);
+        params.per_instance_scan_ranges[first_instance + instance][entry.first]
+            .push_back(scan_range_params);
+      }
+    }
+  }
+  VLOG_QUERY << "running " << num_instances << " instances per host of fragment "
+             << fragment_idx;
+}
+
 PlanNodeId Coordinator::FindLeftmostNode(
     const TPlan& plan, const std::vector<TPlanNodeType::type>& types) {
   // the first node with num_children == 0 is the leftmost node
@@ -1353,14 +1442,6 @@ Status Coordinator::ComputeScanRangeAssignment(const TQueryExecRequest& exec_req
   return Status::OK;
 }
 
-int64_t GetScanRangeLength(const TScanRange& scan_range) {
-  if (scan_range.__isset.hdfs_file_split) {
-    return scan_range.hdfs_file_split.length;
-  } else {
-    return 0;
-  }
-}
-
 Status Coordinator::ComputeScanRangeAssignment(
     PlanNodeId node_id, const vector<TScanRangeLocations>& locations, bool exec_at_coord,
     const FragmentExecParams& params, FragmentScanRangeAssignment* assignment) {
@@ -1458,9 +1539,14 @@ void Coordinator::SetExecPlanFragmentParams(
   rpc_params->__set_desc_tbl(desc_tbl_);
   rpc_params->params.__set_query_id(query_id_);
   rpc_params->params.__set_fragment_instance_id(params.instance_ids[instance_idx]);
-  TNetworkAddress exec_host = params.hosts[instance_idx];;
-  PerNodeScanRanges& scan_ranges = scan_range_assignment_[fragment_idx][exec_host];
-  rpc_params->params.__set_per_node_scan_ranges(scan_ranges);
+  if (params.per_instance_scan_ranges.empty()) {
+    TNetworkAddress exec_host = params.hosts[instance_idx];
+    PerNodeScanRanges& scan_ranges = scan_range_assignment_[fragment_idx][exec_host];
+    rpc_params->params.__set_per_node_scan_ranges(scan_ranges);
+  } else {
+    rpc_params->params.__set_per_node_scan_ranges(
+        params.per_instance_scan_ranges[instance_idx]);
+  }
   rpc_params->params.__set_per_exch_num_senders(params.per_exch_num_senders);
   rpc_params->params.__set_destinations(params.destinations);
   rpc_params->__isset.params = true;
@@ -198,20 +198,26 @@ class Coordinator {
     CounterMap scan_ranges_complete_counters;
   };
 
+  // map from scan node id to a list of scan ranges
+  typedef std::map<TPlanNodeId, std::vector<TScanRangeParams> > PerNodeScanRanges;
+
   // execution parameters for a single fragment; used to assemble the
   // per-fragment instance TPlanFragmentExecParams;
   // hosts.size() == instance_ids.size()
+  // A host appears once for every instance of the fragment that runs on it.
   struct FragmentExecParams {
     SimpleScheduler::HostList hosts; // execution backends
     std::vector<TUniqueId> instance_ids;
     std::vector<TPlanFragmentDestination> destinations;
     std::map<PlanNodeId, int> per_exch_num_senders;
+    // Scan ranges of each instance if the scan ranges of a host are split between
+    // multiple instances; empty otherwise, in which case each instance reads all
+    // ranges assigned to its host in scan_range_assignment_.
+    std::vector<PerNodeScanRanges> per_instance_scan_ranges;
   };
   // populated in ComputeFragmentExecParams()
   std::vector<FragmentExecParams> fragment_exec_params_;
 
-  // map from scan node id to a list of scan ranges
-  typedef std::map<TPlanNodeId, std::vector<TScanRangeParams> > PerNodeScanRanges;
   // map from an impalad host address to the per-node assigned scan ranges;
   // records scan range assignment for a single fragment
   typedef boost::unordered_map<TNetworkAddress, PerNodeScanRanges>
@@ -350,6 +356,17 @@ class Coordinator {
   // and stores result in fragment_exec_params_.hosts.
   void ComputeFragmentHosts(const TQueryExecRequest& exec_request);
 
+  // Returns true if exec_request.fragments[fragment_idx] can run multiple instances
+  // per host.  This is the case for partitioned fragments whose only scan node (if
+  // any) is the leftmost node: the scan ranges of that node can be split between
+  // the instances, and exchange inputs are partitioned across (or broadcast to) all
+  // instances.
+  bool CanRunMultipleInstances(const TQueryExecRequest& exec_request, int fragment_idx);
+
+  // Runs 'num_instances' instances of fragment 'fragment_idx' on each of its hosts,
+  // splitting the scan ranges of each host between its instances by size.
+  void ComputeFragmentInstances(int fragment_idx, int num_instances);
+
   // Returns the id of the leftmost node of any of the gives types in 'plan_root',
   // or INVALID_PLAN_NODE_ID if no such node present.
   PlanNodeId FindLeftmostNode(
@@ -21,6 +21,7 @@
 
 #include "runtime/row-batch.h"
 #include "runtime/data-stream-recvr.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
 #include "util/debug-util.h"
 
@@ -38,13 +39,14 @@ namespace impala {
 DataStreamMgr::StreamControlBlock::StreamControlBlock(
     const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
     PlanNodeId dest_node_id, int num_senders, int buffer_size,
-    RuntimeProfile* profile)
+    RuntimeProfile* profile, MemTracker* mem_tracker)
   : fragment_instance_id_(fragment_instance_id),
     dest_node_id_(dest_node_id),
     row_desc_(row_desc),
     is_cancelled_(false),
     buffer_limit_(buffer_size),
     num_buffered_bytes_(0),
+    mem_tracker_(mem_tracker),
     num_remaining_senders_(num_senders) {
   bytes_received_counter_ =
       ADD_COUNTER(profile, "BytesReceived", TCounterType::BYTES);
@@ -81,22 +83,24 @@ RowBatch* DataStreamMgr::StreamControlBlock::GetBatch(bool* is_cancelled) {
   DCHECK(!batch_queue_.empty());
   RowBatch* result = batch_queue_.front().second;
   num_buffered_bytes_ -= batch_queue_.front().first;
+  if (mem_tracker_ != NULL) mem_tracker_->Release(batch_queue_.front().first);
   VLOG_ROW << "fetched #rows=" << result->num_rows();
   batch_queue_.pop_front();
   data_removal_.notify_one();
   return result;
 }
 
-void DataStreamMgr::StreamControlBlock::AddBatch(const TRowBatch& thrift_batch) {
-  unique_lock<mutex> l(lock_);
-  if (is_cancelled_) return;
-  int batch_size = RowBatch::GetBatchSize(thrift_batch);
+void DataStreamMgr::StreamControlBlock::AddBatch(TRowBatch* thrift_batch) {
+  int batch_size = RowBatch::GetBatchSize(*thrift_batch);
   auto_ptr<RowBatch> batch;
   {
     SCOPED_TIMER(deserialize_row_batch_timer_);
     batch.reset(new RowBatch(row_desc_, thrift_batch));
   }
   COUNTER_UPDATE(bytes_received_counter_, batch_size);
+
+  unique_lock<mutex> l(lock_);
+  if (is_cancelled_) return;
   DCHECK_GT(num_remaining_senders_, 0);
 
   // if there's something in the queue and this batch will push us over the
@@ -149,6 +153,7 @@ void DataStreamMgr::StreamControlBlock::AddBatch(const TRowBatch& thrift_batch)
            << " batch_size=" << batch_size << "\n";
   batch_queue_.push_back(make_pair(batch_size, batch.release()));
   num_buffered_bytes_ += batch_size;
+  if (mem_tracker_ != NULL) mem_tracker_->Consume(batch_size);
   data_arrival_.notify_one();
 }
 
@@ -169,17 +174,20 @@ void DataStreamMgr::StreamControlBlock::CancelStream() {
     is_cancelled_ = true;
     VLOG_QUERY << "cancelled stream: fragment_instance_id_=" << fragment_instance_id_
               << " node_id=" << dest_node_id_;
+
+    // Delete any batches queued in batch_queue_
+    for (RowBatchQueue::iterator it = batch_queue_.begin();
+        it != batch_queue_.end(); ++it) {
+      delete it->second;
+    }
+    batch_queue_.clear();
+    if (mem_tracker_ != NULL) mem_tracker_->Release(num_buffered_bytes_);
+    num_buffered_bytes_ = 0;
   }
   // Wake up all threads waiting to produce/consume batches.  They will all
   // notice that the stream is cancelled and handle it.
   data_arrival_.notify_all();
   data_removal_.notify_all();
-
-  // Delete any batches queued in batch_queue_
-  for (RowBatchQueue::iterator it = batch_queue_.begin();
-      it != batch_queue_.end(); ++it) {
-    delete it->second;
-  }
 }
 
 inline uint32_t DataStreamMgr::GetHashValue(
@@ -192,13 +200,14 @@ inline uint32_t DataStreamMgr::GetHashValue(
 
 DataStreamRecvr* DataStreamMgr::CreateRecvr(
     const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
-    PlanNodeId dest_node_id, int num_senders, int buffer_size, RuntimeProfile* profile) {
+    PlanNodeId dest_node_id, int num_senders, int buffer_size, RuntimeProfile* profile,
+    MemTracker* mem_tracker) {
   DCHECK(profile != NULL);
   VLOG_FILE << "creating receiver for fragment="
             << fragment_instance_id << ", node=" << dest_node_id;
   shared_ptr<StreamControlBlock> cb(
       new StreamControlBlock(row_desc, fragment_instance_id, dest_node_id, num_senders,
-                             buffer_size, profile));
+                             buffer_size, profile, mem_tracker));
   size_t hash_value = GetHashValue(fragment_instance_id, dest_node_id);
   lock_guard<mutex> l(lock_);
   fragment_stream_set_.insert(make_pair(fragment_instance_id, dest_node_id));
@@ -229,10 +238,10 @@ shared_ptr<DataStreamMgr::StreamControlBlock> DataStreamMgr::FindControlBlock(
 
 Status DataStreamMgr::AddData(
     const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
-    const TRowBatch& thrift_batch) {
+    TRowBatch* thrift_batch) {
   VLOG_ROW << "AddData(): fragment_instance_id=" << fragment_instance_id
            << " node=" << dest_node_id
-           << " size=" << RowBatch::GetBatchSize(thrift_batch);
+           << " size=" << RowBatch::GetBatchSize(*thrift_batch);
   shared_ptr<StreamControlBlock> cb =
       FindControlBlock(fragment_instance_id, dest_node_id);
   if (cb == NULL) {
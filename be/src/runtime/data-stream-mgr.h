@@ -33,6 +33,7 @@ namespace impala {
 
 class DescriptorTbl;
 class DataStreamRecvr;
+class MemTracker;
 class RowBatch;
 class TRowBatch;
 
@@ -48,22 +49,25 @@ class TRowBatch;
 // which unblocks all DataStreamRecvr::GetBatch() calls that are made on behalf
 // of the cancelled fragment id.
 //
-// TODO: The recv buffers used in DataStreamRecvr should count against
-// per-query memory limits.
+// The row batches buffered by a stream count against the mem tracker passed to
+// CreateRecvr() until they are handed to the receiver.
 class DataStreamMgr {
  public:
   DataStreamMgr() {}
 
   // Create a receiver for a specific fragment_instance_id/node_id destination; desc_tbl
   // is the query's descriptor table and is needed to decode incoming TRowBatches.
+  // If mem_tracker is non-NULL, buffered batches are counted against it; it must
+  // outlive the receiver.
   // The caller is responsible for deleting the returned DataStreamRecvr.
   DataStreamRecvr* CreateRecvr(
       const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
       PlanNodeId dest_node_id, int num_senders, int buffer_size,
-      RuntimeProfile* profile);
+      RuntimeProfile* profile, MemTracker* mem_tracker = NULL);
 
   // Adds a row batch to the stream identified by fragment_instance_id/dest_node_id
-  // if the stream has not been cancelled.
+  // if the stream has not been cancelled.  The stream may take over
+  // thrift_batch->tuple_data (see RowBatch(const RowDescriptor&, TRowBatch*)).
   // The call blocks if this ends up pushing the stream over its buffering limit;
   // it unblocks when the stream consumer removed enough data to make space for
   // row_batch.
@@ -71,7 +75,7 @@ class DataStreamMgr {
   // so that a single sender can't flood the buffer and stall everybody else.
   // Returns OK if successful, error status otherwise.
   Status AddData(const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
-                 const TRowBatch& thrift_batch);
+                 TRowBatch* thrift_batch);
 
   // Decreases the #remaining_senders count for the stream identified by
   // fragment_instance_id/dest_node_id.
@@ -89,7 +93,7 @@ class DataStreamMgr {
     StreamControlBlock(
         const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
         PlanNodeId dest_node_id, int num_senders, int buffer_size,
-        RuntimeProfile* profile);
+        RuntimeProfile* profile, MemTracker* mem_tracker);
 
     // Returns next available batch or NULL if end-of-stream or stream got
     // cancelled (sets 'is_cancelled' accordingly).
@@ -102,6 +106,8 @@ class DataStreamMgr {
 
     // Adds a row batch to this stream's queue if this stream has not been cancelled;
     // blocks if this will make the stream exceed its buffer limit.
+    // The batch is deserialized before lock_ is acquired, so that concurrent senders
+    // don't serialize on the conversion.
     //
     // For example, for an NxN broadcast, there will be N threads on N
     // clients talking to up-to N threads on N servers. Those server
@@ -110,14 +116,14 @@ class DataStreamMgr {
     // typically you'll have N threads contending to write to a single
     // buffer. If there is no space in the buffer, they will block the
     // sender until space is available.
-    void AddBatch(const TRowBatch& batch);
+    void AddBatch(TRowBatch* batch);
 
     // Decrement the number of remaining senders and signal eos ("new data")
     // if the count drops to 0.
     void DecrementSenders();
 
     // Set cancellation flag and signal cancellation to receiver and sender. Subsequent
-    // incoming batches will be dropped.
+    // incoming batches will be dropped, as are the batches in batch_queue_.
     void CancelStream();
 
     const TUniqueId& fragment_instance_id() const { return fragment_instance_id_; }
@@ -142,6 +148,9 @@ class DataStreamMgr {
     // total number of bytes held in batch_queue_
     int num_buffered_bytes_;
 
+    // if non-NULL, num_buffered_bytes_ is counted against this tracker
+    MemTracker* mem_tracker_;
+
     // number of senders which haven't closed the channel yet
     // (if it drops to 0, end-of-stream is true)
     int num_remaining_senders_;
@@ -30,6 +30,9 @@ class DataStreamRecvr {
  public:
   // deregister from mgr_
   ~DataStreamRecvr() {
+    // Drop batches that arrive from now on; senders may still hold on to cb_, and the
+    // mem tracker of the stream may go away with us.
+    cb_->CancelStream();
     // TODO: log error msg
     mgr_->DeregisterRecvr(cb_->fragment_instance_id(), cb_->dest_node_id());
   }
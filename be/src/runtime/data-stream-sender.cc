@@ -14,20 +14,26 @@
 
 #include "runtime/data-stream-sender.h"
 
+#include <deque>
 #include <iostream>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <gflags/gflags.h>
 #include <thrift/protocol/TDebugProtocol.h>
 
 #include "common/logging.h"
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/tuple-row.h"
 #include "runtime/row-batch.h"
 #include "runtime/raw-value.h"
 #include "runtime/runtime-state.h"
 #include "runtime/client-cache.h"
 #include "util/debug-util.h"
+#include "util/heavy-hitters.h"
 #include "util/network-util.h"
 #include "util/thrift-client.h"
 #include "util/thrift-util.h"
@@ -36,6 +42,16 @@
 #include "gen-cpp/ImpalaInternalService.h"
 #include "gen-cpp/ImpalaInternalService_types.h"
 
+DEFINE_int32(data_stream_sender_max_in_flight_batches, 2, "(Advanced) Maximum number "
+    "of serialized row batches a data stream sender queues per destination before "
+    "it blocks.");
+DEFINE_int32(data_stream_skew_sample_rate, 16, "Hash-partitioning data stream senders "
+    "sample one in this many rows to detect skewed partitioning keys. 0 disables "
+    "sampling.");
+DEFINE_double(data_stream_skew_threshold, 1.0, "A partitioning key is reported as "
+    "skewed if its rows exceed this fraction of the average number of rows per "
+    "channel.");
+
 using namespace std;
 using namespace boost;
 using namespace apache::thrift;
@@ -48,9 +64,14 @@ namespace impala {
 // to a single destination ipaddress/node.
 // It has a fixed-capacity buffer and allows the caller either to add rows to
 // that buffer individually (AddRow()), or circumvent the buffer altogether and send
-// TRowBatches directly (SendBatch()). Either way, there can only be one in-flight RPC
-// at any one time (ie, sending will block if the most recent rpc hasn't finished,
-// which allows the receiver node to throttle the sender by withholding acks).
+// TRowBatches directly (SendBatch()). Either way, batches are queued and sent in order
+// by a sender thread that is dedicated to the channel, so that the caller can
+// produce the next batch while earlier ones are in flight.  The caller blocks once
+// FLAGS_data_stream_sender_max_in_flight_batches batches are queued (which allows the
+// receiver node to throttle the sender by withholding acks).
+// Rows added via AddRow() are serialized into a small pool of TTransmitDataParams that
+// are sent as is; batches passed to SendBatch() are shared with other channels and
+// are copied into the rpc params by the sender thread.
 // *Not* thread-safe.
 class DataStreamSender::Channel {
  public:
@@ -68,13 +89,22 @@ class DataStreamSender::Channel {
       fragment_instance_id_(fragment_instance_id),
       dest_node_id_(dest_node_id),
       num_data_bytes_sent_(0),
-      in_flight_batch_(NULL) {
+      num_rows_sent_(0),
+      num_batches_queued_(0),
+      num_batches_sent_(0),
+      shutdown_(false) {
       // TODO: figure out how to size batch_
     int capacity = max(1, buffer_size / max(row_desc.GetRowSize(), 1));
     batch_.reset(new RowBatch(row_desc, capacity));
+    params_.resize(max(1, FLAGS_data_stream_sender_max_in_flight_batches));
+    params_batch_sizes_.resize(params_.size(), 0);
+    for (int i = 0; i < params_.size(); ++i) InitParams(&params_[i]);
   }
 
-  // Initialize channel.
+  // Stops the sender thread; batches that haven't been sent yet are dropped.
+  ~Channel();
+
+  // Initialize channel and start the sender thread.
   // Returns OK if successful, error indication otherwise.
   Status Init(RuntimeState* state);
 
@@ -83,11 +113,16 @@ class DataStreamSender::Channel {
   // Returns error status if any of the preceding rpcs failed, OK otherwise.
   Status AddRow(TupleRow* row);
 
-  // Asynchronously sends a row batch.
+  // Asynchronously sends a row batch.  The batch must not be modified until
+  // WaitForBatches() returns for it.
   // Returns the status of the most recently finished TransmitData
   // rpc (or OK if there wasn't one that hasn't been reported yet).
   Status SendBatch(TRowBatch* batch);
 
+  // Blocks until the first 'num_batches' batches passed to the sender thread have
+  // been sent or an rpc failed, and returns the status of the rpcs.
+  Status WaitForBatches(int64_t num_batches);
+
   // Return status of last TransmitData rpc (initiated by the most recent call
   // to either SendBatch() or SendCurrentBatch()).
   Status GetSendStatus();
@@ -97,6 +132,8 @@ class DataStreamSender::Channel {
   Status Close();
 
   int64_t num_data_bytes_sent() const { return num_data_bytes_sent_; }
+  int64_t num_rows_sent() const { return num_rows_sent_; }
+  const TNetworkAddress& address() const { return address_; }
 
  private:
   DataStreamSender* parent_;
@@ -111,58 +148,173 @@ class DataStreamSender::Channel {
   // the number of TRowBatch.data bytes sent successfully
   int64_t num_data_bytes_sent_;
 
+  // the number of rows passed to AddRow() or SendBatch()
+  int64_t num_rows_sent_;
+
   // we're accumulating rows into this batch
   scoped_ptr<RowBatch> batch_;
-  TRowBatch thrift_batch_;
 
-  // accessed by rpc_thread_ and by channel only if there is no in-flight rpc
-  TRowBatch* in_flight_batch_;
-  thread rpc_thread_;  // sender thread
-  Status rpc_status_;  // status of most recently finished TransmitData rpc
+  // Rpc params that rows from batch_ are serialized into.  The n-th batch queued by
+  // the channel uses params_[n % params_.size()], which can be reused once that
+  // entry's previous batch has been sent.
+  vector<TTransmitDataParams> params_;
+  // serialized size of the row batch of each entry of params_
+  vector<int64_t> params_batch_sizes_;
+
+  // Rpc params for batches passed to SendBatch(); only used by sender_thread_.
+  TTransmitDataParams shared_batch_params_;
+
+  // An entry of queue_: either ready-to-send params from params_ or a batch passed to
+  // SendBatch().
+  struct QueuedBatch {
+    TTransmitDataParams* params;
+    TRowBatch* shared_batch;
+
+    QueuedBatch(TTransmitDataParams* params, TRowBatch* shared_batch)
+      : params(params), shared_batch(shared_batch) {}
+  };
+
+  // protects all subsequent data
+  mutex lock_;
+
+  // batches waiting to be sent; the front entry is in flight
+  deque<QueuedBatch> queue_;
+
+  // total number of batches added to queue_ and the number of those that have been
+  // sent (or dropped because an rpc failed)
+  int64_t num_batches_queued_;
+  int64_t num_batches_sent_;
+
+  // if true, sender_thread_ exits once queue_ is empty
+  bool shutdown_;
 
-  // Synchronously call TransmitData() on a client from client_cache_ and update
-  // rpc_status_ based on return value (or set to error if RPC failed).
-  // Should only run in rpc_thread_.
-  void TransmitData();
+  // signalled when a batch is added to queue_ or shutdown_ is set
+  condition_variable batch_queued_cv_;
 
-  // Serialize batch_ into thrift_batch_ and send via SendBatch().
+  // signalled when a batch has been sent
+  condition_variable batch_sent_cv_;
+
+  // status of the first failed TransmitData rpc, OK otherwise
+  Status rpc_status_;
+
+  scoped_ptr<thread> sender_thread_;
+
+  void InitParams(TTransmitDataParams* params) {
+    params->protocol_version = ImpalaInternalServiceVersion::V1;
+    params->__set_dest_fragment_instance_id(fragment_instance_id_);
+    params->__set_dest_node_id(dest_node_id_);
+    params->__set_eos(false);
+  }
+
+  // Adds a batch to queue_.
+  Status EnqueueBatch(const QueuedBatch& batch);
+
+  // Sends the batches in queue_ in order until shutdown_ is set and the queue is
+  // empty.  Runs in sender_thread_.
+  void SenderThread();
+
+  // Synchronously call TransmitData() on a client from client_cache_.
+  // Should only run in sender_thread_.
+  Status TransmitData(const TTransmitDataParams& params);
+
+  // Serialize batch_ into the next entry of params_ and queue it.
   // Returns SendBatch() status.
   Status SendCurrentBatch();
 };
 
+DataStreamSender::Channel::~Channel() {
+  if (sender_thread_ == NULL) return;
+  {
+    lock_guard<mutex> l(lock_);
+    shutdown_ = true;
+    // only the front entry is in flight, the others can be dropped
+    if (!queue_.empty()) queue_.erase(queue_.begin() + 1, queue_.end());
+  }
+  batch_queued_cv_.notify_one();
+  sender_thread_->join();
+}
+
 Status DataStreamSender::Channel::Init(RuntimeState* state) {
   client_cache_ = state->client_cache();
+  InitParams(&shared_batch_params_);
+  sender_thread_.reset(new thread(&DataStreamSender::Channel::SenderThread, this));
   return Status::OK;
 }
 
 Status DataStreamSender::Channel::SendBatch(TRowBatch* batch) {
   VLOG_ROW << "Channel::SendBatch() instance_id=" << fragment_instance_id_
            << " dest_node=" << dest_node_id_ << " #rows=" << batch->num_rows;
-  // return if the previous batch saw an error
-  RETURN_IF_ERROR(GetSendStatus());
-  DCHECK(in_flight_batch_ == NULL);
-  in_flight_batch_ = batch;
-  rpc_thread_ = thread(&DataStreamSender::Channel::TransmitData, this);
+  num_rows_sent_ += batch->num_rows;
+  return EnqueueBatch(QueuedBatch(NULL, batch));
+}
+
+Status DataStreamSender::Channel::EnqueueBatch(const QueuedBatch& batch) {
+  {
+    lock_guard<mutex> l(lock_);
+    // return if a previous batch saw an error
+    if (!rpc_status_.ok()) return rpc_status_;
+    queue_.push_back(batch);
+    ++num_batches_queued_;
+  }
+  batch_queued_cv_.notify_one();
   return Status::OK;
 }
 
-void DataStreamSender::Channel::TransmitData() {
-  DCHECK(in_flight_batch_ != NULL);
+Status DataStreamSender::Channel::WaitForBatches(int64_t num_batches) {
+  unique_lock<mutex> l(lock_);
+  // after a failed rpc, batches are no longer queued and we can't wait for them
+  if (num_batches_sent_ < num_batches && rpc_status_.ok()) {
+    SCOPED_TIMER(parent_->send_queue_wait_timer_);
+    while (num_batches_sent_ < num_batches && rpc_status_.ok()) batch_sent_cv_.wait(l);
+  }
+  if (!rpc_status_.ok()) {
+    LOG(ERROR) << "channel send status: " << rpc_status_.GetErrorMsg();
+  }
+  return rpc_status_;
+}
+
+void DataStreamSender::Channel::SenderThread() {
+  while (true) {
+    QueuedBatch batch(NULL, NULL);
+    bool send;
+    {
+      unique_lock<mutex> l(lock_);
+      while (queue_.empty() && !shutdown_) batch_queued_cv_.wait(l);
+      if (queue_.empty()) return;
+      batch = queue_.front();
+      // once an rpc failed, the remaining batches are dropped
+      send = rpc_status_.ok();
+    }
+
+    Status status;
+    if (send) {
+      if (batch.params != NULL) {
+        status = TransmitData(*batch.params);
+      } else {
+        // the batch may be shared with other channels, so it has to be copied
+        shared_batch_params_.__set_row_batch(*batch.shared_batch);
+        status = TransmitData(shared_batch_params_);
+      }
+    }
+
+    {
+      lock_guard<mutex> l(lock_);
+      queue_.pop_front();
+      ++num_batches_sent_;
+      if (!status.ok() && rpc_status_.ok()) rpc_status_ = status;
+    }
+    batch_sent_cv_.notify_all();
+  }
+}
+
+Status DataStreamSender::Channel::TransmitData(const TTransmitDataParams& params) {
   try {
     VLOG_ROW << "Channel::TransmitData() instance_id=" << fragment_instance_id_
              << " dest_node=" << dest_node_id_
-             << " #rows=" << in_flight_batch_->num_rows;
-    TTransmitDataParams params;
-    params.protocol_version = ImpalaInternalServiceVersion::V1;
-    params.__set_dest_fragment_instance_id(fragment_instance_id_);
-    params.__set_dest_node_id(dest_node_id_);
-    params.__set_row_batch(*in_flight_batch_);  // yet another copy
-    params.__set_eos(false);
-
-    ImpalaInternalServiceConnection client(client_cache_, address_, &rpc_status_);
-    if (!rpc_status_.ok()) {
-      return;
-    }
+             << " #rows=" << params.row_batch.num_rows;
+    Status status;
+    ImpalaInternalServiceConnection client(client_cache_, address_, &status);
+    if (!status.ok()) return status;
 
     TTransmitDataResult res;
     {
@@ -171,40 +323,32 @@ void DataStreamSender::Channel::TransmitData() {
         client->TransmitData(res, params);
       } catch (TTransportException& e) {
         VLOG_RPC << "Retrying TransmitData: " << e.what();
-        rpc_status_ = client.Reopen();
-        if (!rpc_status_.ok()) {
-          return;
-        }
+        RETURN_IF_ERROR(client.Reopen());
         client->TransmitData(res, params);
       }
     }
 
-    if (res.status.status_code != TStatusCode::OK) {
-      rpc_status_ = res.status;
-    } else {
-      num_data_bytes_sent_ += RowBatch::GetBatchSize(*in_flight_batch_);
-      VLOG_ROW << "incremented #data_bytes_sent="
-               << num_data_bytes_sent_;
-    }
+    if (res.status.status_code != TStatusCode::OK) return res.status;
+    num_data_bytes_sent_ += RowBatch::GetBatchSize(params.row_batch);
+    VLOG_ROW << "incremented #data_bytes_sent=" << num_data_bytes_sent_;
   } catch (TException& e) {
     stringstream msg;
     msg << "TransmitData() to " << address_ << " failed:\n" << e.what();
-    rpc_status_ = Status(msg.str());
-    return;
+    return Status(msg.str());
   }
-  in_flight_batch_ = NULL;
+  return Status::OK;
 }
 
 Status DataStreamSender::Channel::AddRow(TupleRow* row) {
   int row_num = batch_->AddRow();
   if (row_num == RowBatch::INVALID_ROW_INDEX) {
-    // batch_ is full, let's send it; but first wait for an ongoing
-    // transmission to finish before modifying thrift_batch_
+    // batch_ is full, let's send it
     RETURN_IF_ERROR(SendCurrentBatch());
     row_num = batch_->AddRow();
     DCHECK_NE(row_num, RowBatch::INVALID_ROW_INDEX);
   }
 
+  ++num_rows_sent_;
   TupleRow* dest = batch_->GetRow(row_num);
   batch_->CopyRow(row, dest);
   const vector<TupleDescriptor*>& descs = row_desc_.tuple_descriptors();
@@ -221,26 +365,28 @@ Status DataStreamSender::Channel::AddRow(TupleRow* row) {
 }
 
 Status DataStreamSender::Channel::SendCurrentBatch() {
-  // make sure there's no in-flight TransmitData() call that might still want to
-  // access thrift_batch_
-  rpc_thread_.join();
+  // wait for the batch that last used the params to be sent before overwriting them
+  int num_params = params_.size();
+  int params_idx = num_batches_queued_ % num_params;
+  TTransmitDataParams* params = &params_[params_idx];
+  RETURN_IF_ERROR(WaitForBatches(num_batches_queued_ - num_params + 1));
   {
     SCOPED_TIMER(parent_->serialize_batch_timer_);
-    int uncompressed_bytes = batch_->Serialize(&thrift_batch_);
-    COUNTER_UPDATE(parent_->bytes_sent_counter_, RowBatch::GetBatchSize(thrift_batch_));
+    int uncompressed_bytes = batch_->Serialize(&params->row_batch);
+    // row_batch is optional, thrift leaves it out of the rpc unless it is marked set
+    params->__isset.row_batch = true;
+    parent_->UpdateSerializedBatchSize(params->row_batch,
+        &params_batch_sizes_[params_idx]);
+    COUNTER_UPDATE(parent_->bytes_sent_counter_,
+        RowBatch::GetBatchSize(params->row_batch));
     COUNTER_UPDATE(parent_->uncompressed_bytes_counter_, uncompressed_bytes);
   }
   batch_->Reset();
-  RETURN_IF_ERROR(SendBatch(&thrift_batch_));
-  return Status::OK;
+  return EnqueueBatch(QueuedBatch(params, NULL));
 }
 
 Status DataStreamSender::Channel::GetSendStatus() {
-  rpc_thread_.join();
-  if (!rpc_status_.ok()) {
-    LOG(ERROR) << "channel send status: " << rpc_status_.GetErrorMsg();
-  }
-  return rpc_status_;
+  return WaitForBatches(num_batches_queued_);
 }
 
 Status DataStreamSender::Channel::Close() {
@@ -271,10 +417,7 @@ Status DataStreamSender::Channel::Close() {
       client->TransmitData(res, params);
     } catch (TTransportException& e) {
       VLOG_RPC << "Retrying TransmitData: " << e.what();
-      rpc_status_ = client.Reopen();
-      if (!rpc_status_.ok()) {
-        return rpc_status_;
-      }
+      RETURN_IF_ERROR(client.Reopen());
       client->TransmitData(res, params);
     }
     return Status(res.status);
@@ -292,12 +435,22 @@ DataStreamSender::DataStreamSender(ObjectPool* pool,
     int per_channel_buffer_size)
   : pool_(pool),
     row_desc_(row_desc),
-    current_thrift_batch_(&thrift_batch1_),
+    thrift_batches_(max(1, FLAGS_data_stream_sender_max_in_flight_batches)),
+    thrift_batch_sizes_(thrift_batches_.size(), 0),
+    num_broadcast_batches_(0),
+    mem_tracker_(NULL),
+    serialized_batch_bytes_(0),
     profile_(NULL),
     serialize_batch_timer_(NULL),
     thrift_transmit_timer_(NULL),
     bytes_sent_counter_(NULL),
-    dest_node_id_(sink.dest_node_id) {
+    send_queue_wait_timer_(NULL),
+    dest_node_id_(sink.dest_node_id),
+    channels_profile_(NULL),
+    channel_row_skew_counter_(NULL),
+    skewed_keys_counter_(NULL),
+    skewed_rows_counter_(NULL),
+    num_rows_partitioned_(0) {
   DCHECK_GT(destinations.size(), 0);
   DCHECK(sink.output_partition.type == TPartitionType::UNPARTITIONED
       || sink.output_partition.type == TPartitionType::HASH_PARTITIONED);
@@ -322,6 +475,11 @@ DataStreamSender::DataStreamSender(ObjectPool* pool,
         Expr::CreateExprTrees(
           pool, sink.output_partition.partition_exprs, &partition_exprs_);
     DCHECK(status.ok());
+    if (FLAGS_data_stream_skew_sample_rate > 0 && channels_.size() > 1) {
+      // Any key with more than 1/capacity of the sampled rows is tracked, which is
+      // well below the share of a single channel.
+      heavy_hitters_.reset(new HeavyHitters(4 * channels_.size()));
+    }
   }
 }
 
@@ -339,6 +497,11 @@ Status DataStreamSender::Init(RuntimeState* state) {
   title << "DataStreamSender (dst_id=" << dest_node_id_ << ")";
   profile_ = pool_->Add(new RuntimeProfile(pool_, title.str()));
   SCOPED_TIMER(profile_->total_time_counter());
+  mem_tracker_ = state->instance_mem_tracker();
+  // the channels' sender threads use the timers
+  serialize_batch_timer_ = ADD_TIMER(profile(), "SerializeBatchTime");
+  thrift_transmit_timer_ = ADD_TIMER(profile(), "ThriftTransmitTime(*)");
+  send_queue_wait_timer_ = ADD_TIMER(profile(), "SendQueueWaitTime");
 
   for (int i = 0; i < channels_.size(); ++i) {
     RETURN_IF_ERROR(channels_[i]->Init(state));
@@ -349,9 +512,6 @@ Status DataStreamSender::Init(RuntimeState* state) {
       ADD_COUNTER(profile(), "BytesSent", TCounterType::BYTES);
   uncompressed_bytes_counter_ =
       ADD_COUNTER(profile(), "UncompressedRowBatchSize", TCounterType::BYTES);
-  serialize_batch_timer_ =
-      ADD_TIMER(profile(), "SerializeBatchTime");
-  thrift_transmit_timer_ = ADD_TIMER(profile(), "ThriftTransmitTime(*)");
   network_throughput_ =
       profile()->AddDerivedCounter("NetworkThroughput(*)", TCounterType::BYTES_PER_SECOND,
           bind<int64_t>(&RuntimeProfile::UnitsPerSecond, bytes_sent_counter_,
@@ -360,29 +520,50 @@ Status DataStreamSender::Init(RuntimeState* state) {
       profile()->AddDerivedCounter("OverallThroughput", TCounterType::BYTES_PER_SECOND,
            bind<int64_t>(&RuntimeProfile::UnitsPerSecond, bytes_sent_counter_,
                          profile()->total_time_counter()));
+
+  channels_profile_ = pool_->Add(new RuntimeProfile(pool_, "Channels"));
+  profile_->AddChild(channels_profile_);
+  for (int i = 0; i < channels_.size(); ++i) {
+    stringstream prefix;
+    prefix << i << ": " << channels_[i]->address();
+    channel_rows_counters_.push_back(
+        ADD_COUNTER(channels_profile_, prefix.str() + " Rows", TCounterType::UNIT));
+    channel_bytes_counters_.push_back(
+        ADD_COUNTER(channels_profile_, prefix.str() + " Bytes", TCounterType::BYTES));
+  }
+  channel_row_skew_counter_ =
+      ADD_COUNTER(profile(), "ChannelRowSkew", TCounterType::DOUBLE_VALUE);
+  if (heavy_hitters_ != NULL) {
+    skewed_keys_counter_ = ADD_COUNTER(profile(), "SkewedKeys", TCounterType::UNIT);
+    skewed_rows_counter_ = ADD_COUNTER(profile(), "SkewedRows", TCounterType::UNIT);
+  }
   return Status::OK;
 }
 
 Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
   SCOPED_TIMER(profile_->total_time_counter());
   if (broadcast_ || channels_.size() == 1) {
-    // current_thrift_batch_ is *not* the one that was written by the last call
-    // to Serialize()
+    // wait until no channel references the thrift batch we're about to overwrite;
+    // all of the channels' batches come from thrift_batches_
+    int num_thrift_batches = thrift_batches_.size();
+    int thrift_batch_idx = num_broadcast_batches_ % num_thrift_batches;
+    TRowBatch* thrift_batch = &thrift_batches_[thrift_batch_idx];
+    for (int i = 0; i < channels_.size(); ++i) {
+      RETURN_IF_ERROR(channels_[i]->WaitForBatches(
+          num_broadcast_batches_ - num_thrift_batches + 1));
+    }
     VLOG_ROW << "serializing " << batch->num_rows() << " rows";
     {
       SCOPED_TIMER(serialize_batch_timer_);
-      int uncompressed_bytes = batch->Serialize(current_thrift_batch_);
-      COUNTER_UPDATE(bytes_sent_counter_, RowBatch::GetBatchSize(*current_thrift_batch_));
+      int uncompressed_bytes = batch->Serialize(thrift_batch);
+      UpdateSerializedBatchSize(*thrift_batch, &thrift_batch_sizes_[thrift_batch_idx]);
+      COUNTER_UPDATE(bytes_sent_counter_, RowBatch::GetBatchSize(*thrift_batch));
       COUNTER_UPDATE(uncompressed_bytes_counter_, uncompressed_bytes);
     }
-
-    // SendBatch() will block if there are still in-flight rpcs (and those will
-    // reference the previously written thrift batch)
     for (int i = 0; i < channels_.size(); ++i) {
-      RETURN_IF_ERROR(channels_[i]->SendBatch(current_thrift_batch_));
+      RETURN_IF_ERROR(channels_[i]->SendBatch(thrift_batch));
     }
-    current_thrift_batch_ =
-        (current_thrift_batch_ == &thrift_batch1_ ? &thrift_batch2_ : &thrift_batch1_);
+    ++num_broadcast_batches_;
   } else {
     // hash-partition batch's rows across channels
     int num_channels = channels_.size();
@@ -399,6 +580,10 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
         hash_val =
             RawValue::GetHashValueFvn(partition_val, (*expr)->type(), hash_val);
       }
+      if (heavy_hitters_ != NULL &&
+          ++num_rows_partitioned_ % FLAGS_data_stream_skew_sample_rate == 0) {
+        heavy_hitters_->Add(hash_val);
+      }
       RETURN_IF_ERROR(channels_[hash_val % num_channels]->AddRow(row));
     }
   }
@@ -407,12 +592,68 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
 
 Status DataStreamSender::Close(RuntimeState* state) {
   // TODO: only close channels that didn't have any errors
-  for (int i = 0; i < channels_.size(); ++i) {
-    RETURN_IF_ERROR(channels_[i]->Close());
+  Status status;
+  for (int i = 0; i < channels_.size() && status.ok(); ++i) {
+    status = channels_[i]->Close();
   }
+  // Close() may be called again after an error, but nothing is serialized after the
+  // first call
+  if (mem_tracker_ != NULL) mem_tracker_->Release(serialized_batch_bytes_);
+  serialized_batch_bytes_ = 0;
+  RETURN_IF_ERROR(status);
+  UpdateChannelStats();
   return Status::OK;
 }
 
+void DataStreamSender::UpdateSerializedBatchSize(const TRowBatch& batch,
+    int64_t* size) {
+  int64_t new_size = RowBatch::GetBatchSize(batch);
+  if (mem_tracker_ != NULL) {
+    if (new_size > *size) {
+      mem_tracker_->Consume(new_size - *size);
+    } else {
+      mem_tracker_->Release(*size - new_size);
+    }
+  }
+  serialized_batch_bytes_ += new_size - *size;
+  *size = new_size;
+}
+
+void DataStreamSender::UpdateChannelStats() {
+  int num_channels = channels_.size();
+  int64_t total_rows = 0;
+  int64_t max_rows = 0;
+  for (int i = 0; i < num_channels; ++i) {
+    int64_t num_rows = channels_[i]->num_rows_sent();
+    COUNTER_SET(channel_rows_counters_[i], num_rows);
+    COUNTER_SET(channel_bytes_counters_[i], channels_[i]->num_data_bytes_sent());
+    total_rows += num_rows;
+    max_rows = max(max_rows, num_rows);
+  }
+  if (total_rows == 0) return;
+  double avg_rows = static_cast<double>(total_rows) / num_channels;
+  COUNTER_SET(channel_row_skew_counter_, max_rows / avg_rows);
+
+  if (heavy_hitters_ == NULL || heavy_hitters_->num_added() == 0) return;
+  // Keys are compared against the average channel in terms of sampled rows
+  int64_t min_sampled_rows = max(static_cast<int64_t>(1), static_cast<int64_t>(
+      FLAGS_data_stream_skew_threshold * heavy_hitters_->num_added() / num_channels));
+  vector<pair<uint32_t, int64_t> > skewed_keys;
+  heavy_hitters_->GetHeavyHitters(min_sampled_rows, &skewed_keys);
+  int64_t skewed_rows = 0;
+  for (int i = 0; i < skewed_keys.size(); ++i) {
+    int64_t est_rows = skewed_keys[i].second * FLAGS_data_stream_skew_sample_rate;
+    skewed_rows += est_rows;
+    VLOG_QUERY << "DataStreamSender (dst_id=" << dest_node_id_ << "): partitioning "
+               << "key with hash " << skewed_keys[i].first << " sent ~" << est_rows
+               << " of " << total_rows << " rows to channel "
+               << skewed_keys[i].first % num_channels << " ("
+               << channels_[skewed_keys[i].first % num_channels]->address() << ")";
+  }
+  COUNTER_SET(skewed_keys_counter_, static_cast<int64_t>(skewed_keys.size()));
+  COUNTER_SET(skewed_rows_counter_, skewed_rows);
+}
+
 int64_t DataStreamSender::GetNumDataBytesSent() const {
   // TODO: do we need synchronization here or are reads & writes to 8-byte ints
   // atomic?
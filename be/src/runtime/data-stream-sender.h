@@ -18,6 +18,7 @@
 
 #include <vector>
 #include <string>
+#include <boost/scoped_ptr.hpp>
 
 #include "exec/data-sink.h"
 #include "common/global-types.h"
@@ -29,6 +30,8 @@
 namespace impala {
 
 class Expr;
+class HeavyHitters;
+class MemTracker;
 class RowBatch;
 class RowDescriptor;
 class TDataStreamSink;
@@ -40,8 +43,13 @@ class TPlanFragmentDestination;
 // partitioning specification.
 // *Not* thread-safe.
 //
-// TODO: capture stats that describe distribution of rows/data volume
-// across channels.
+// The number of rows and bytes sent to each channel is reported in the "Channels"
+// child profile.  For hash-partitioned output, the sender also samples the hashes of
+// the partitioning values to find keys that account for a disproportionate share of
+// the rows (see HeavyHitters).  Such keys can't be spread across channels, since the
+// receiver relies on all rows with the same key arriving at the same instance, but
+// they are reported in the profile and log so that skewed joins and aggregations can
+// be diagnosed.
 class DataStreamSender : public DataSink {
  public:
   // Construct a sender according to the output specification (sink),
@@ -62,8 +70,8 @@ class DataStreamSender : public DataSink {
   // Send data in 'batch' to destination nodes according to partitioning
   // specification provided in c'tor.
   // Blocks until all rows in batch are placed in their appropriate outgoing
-  // buffers (ie, blocks if there are still in-flight rpcs from the last
-  // Send() call).
+  // buffers (ie, blocks if a channel already has the maximum number of batches
+  // in flight).
   virtual Status Send(RuntimeState* state, RowBatch* batch);
 
   // Flush all buffered data and close all existing channels to destination
@@ -83,11 +91,19 @@ class DataStreamSender : public DataSink {
   const RowDescriptor& row_desc_;
   bool broadcast_;  // if true, send all rows on all channels
 
-  // serialized batches for broadcasting; we need two so we can write
-  // one while the other one is still being sent
-  TRowBatch thrift_batch1_;
-  TRowBatch thrift_batch2_;
-  TRowBatch* current_thrift_batch_;  // the next one to fill in Send()
+  // serialized batches for broadcasting; the n-th batch is serialized into
+  // thrift_batches_[n % thrift_batches_.size()], so that we can write one while the
+  // others are still being sent
+  std::vector<TRowBatch> thrift_batches_;
+  // serialized size of each entry of thrift_batches_
+  std::vector<int64_t> thrift_batch_sizes_;
+  int64_t num_broadcast_batches_;
+
+  // The serialized batches of the sender and its channels are charged to the fragment
+  // instance's tracker; serialized_batch_bytes_ is the amount currently charged.  It is
+  // released in Close().
+  MemTracker* mem_tracker_;
+  int64_t serialized_batch_bytes_;
 
   std::vector<Expr*> partition_exprs_;  // compute per-row partition values
   std::vector<Channel*> channels_;
@@ -98,6 +114,9 @@ class DataStreamSender : public DataSink {
   RuntimeProfile::Counter* bytes_sent_counter_;
   RuntimeProfile::Counter* uncompressed_bytes_counter_;
 
+  // Time spent waiting for a channel's in-flight batches to be sent
+  RuntimeProfile::Counter* send_queue_wait_timer_;
+
   // Throughput per time spent in TransmitData
   RuntimeProfile::Counter* network_throughput_;
 
@@ -106,6 +125,33 @@ class DataStreamSender : public DataSink {
 
   // Identifier of the destination plan node.
   PlanNodeId dest_node_id_;
+
+  // Rows/bytes sent per channel, set in Close()
+  RuntimeProfile* channels_profile_;
+  std::vector<RuntimeProfile::Counter*> channel_rows_counters_;
+  std::vector<RuntimeProfile::Counter*> channel_bytes_counters_;
+
+  // Rows sent to the channel with the most rows, relative to the average
+  RuntimeProfile::Counter* channel_row_skew_counter_;
+
+  // Number of skewed partitioning keys and the estimated number of rows they account
+  // for.
+  RuntimeProfile::Counter* skewed_keys_counter_;
+  RuntimeProfile::Counter* skewed_rows_counter_;
+
+  // Sample of the partitioning hashes of hash-partitioned output.  NULL if the output
+  // is not hash-partitioned or sampling is disabled.
+  boost::scoped_ptr<HeavyHitters> heavy_hitters_;
+
+  // Number of rows that were hash-partitioned
+  int64_t num_rows_partitioned_;
+
+  // Sets the per-channel counters and reports skewed partitioning keys.
+  void UpdateChannelStats();
+
+  // Charges the change of a serialized batch buffer's size from *size to the size of
+  // 'batch' to mem_tracker_ and updates *size.
+  void UpdateSerializedBatchSize(const TRowBatch& batch, int64_t* size);
 };
 
 }
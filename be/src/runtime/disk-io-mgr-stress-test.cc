@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <gflags/gflags.h>
+
 #include "runtime/disk-io-mgr-stress.h"
 #include "util/cpu-info.h"
 #include "util/string-parser.h"
@@ -20,7 +22,8 @@ using namespace impala;
 using namespace std;
 
 // Simple utility to run the disk io stress test.  A optional second parameter
-// can be passed to control how long to run this test (0 for forever).
+// can be passed to control how long to run this test (0 for forever).  Io mgr flags
+// can be passed before it.
 
 // TODO: make these configurable once we decide how to run BE tests with args
 const int DEFAULT_DURATION_SEC = 1;
@@ -31,6 +34,9 @@ const bool TEST_CANCELLATION = true;
 
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
+  // Allows comparing e.g. --num_io_buffer_free_lists=1 (a single locked free list)
+  // with the default.
+  google::ParseCommandLineFlags(&argc, &argv, true);
   CpuInfo::Init();
   int duration_sec = DEFAULT_DURATION_SEC;
 
@@ -14,6 +14,9 @@
 
 #include "runtime/disk-io-mgr-stress.h"
 
+#include "util/debug-util.h"
+#include "util/stopwatch.h"
+
 using namespace boost;
 using namespace impala;
 using namespace std;
@@ -62,7 +65,8 @@ struct DiskIoMgrStress::Client {
 DiskIoMgrStress::DiskIoMgrStress(int num_disks, int num_threads_per_disk,
      int num_clients, bool includes_cancellation) :
     num_clients_(num_clients),
-    includes_cancellation_(includes_cancellation) {
+    includes_cancellation_(includes_cancellation),
+    num_buffers_read_(0) {
   
   time_t rand_seed = time(NULL);
   LOG(INFO) << "Running with rand seed: " << rand_seed;
@@ -125,6 +129,7 @@ void DiskIoMgrStress::ClientThread(int client_id) {
       // Copy the bytes from this read into the result buffer.  
       memcpy(read_buffer + file_offset, buffer->buffer(), buffer->len());
       buffer->Return();
+      __sync_add_and_fetch(&num_buffers_read_, 1);
       if (buffer->eosr()) client->resource_pool->ReleaseThreadToken(false);
       buffer = NULL;
       bytes_read += len;
@@ -175,13 +180,24 @@ void DiskIoMgrStress::Run(int sec) {
   }
   
   // Sleep and let the clients do their thing for 'sec'
+  MonotonicStopWatch total_time;
+  total_time.Start();
   for (int loop_count = 1; sec == 0 || loop_count <= sec; ++loop_count) {
+    MonotonicStopWatch iteration_time;
+    iteration_time.Start();
+    int64_t num_buffers = num_buffers_read_;
+    int64_t num_lock_waits = io_mgr_->num_lock_waits();
+    int64_t lock_wait_time = io_mgr_->lock_wait_time_ns();
     int iter = (1000) / CANCEL_READER_PERIOD_MS;
     for (int i = 0; i < iter; ++i) {
       usleep(CANCEL_READER_PERIOD_MS * 1000);
       CancelRandomReader();
     }
-    LOG(ERROR) << "Finished iteration: " << loop_count;
+    LOG(ERROR) << "Finished iteration: " << loop_count << " "
+               << StatsString(num_buffers_read_ - num_buffers,
+                      io_mgr_->num_lock_waits() - num_lock_waits,
+                      io_mgr_->lock_wait_time_ns() - lock_wait_time,
+                      iteration_time.ElapsedTime());
   }
   
   // Signal shutdown for the client threads
@@ -193,6 +209,19 @@ void DiskIoMgrStress::Run(int sec) {
   }
 
   readers_.join_all();
+  LOG(ERROR) << "Total: " << StatsString(num_buffers_read_, io_mgr_->num_lock_waits(),
+      io_mgr_->lock_wait_time_ns(), total_time.ElapsedTime());
+}
+
+string DiskIoMgrStress::StatsString(int64_t num_buffers, int64_t num_lock_waits,
+    int64_t lock_wait_time_ns, int64_t elapsed_ns) {
+  stringstream ss;
+  double elapsed_sec = max<int64_t>(elapsed_ns, 1) / 1000000000.;
+  ss << "buffers/sec=" << static_cast<int64_t>(num_buffers / elapsed_sec)
+     << " lock waits=" << num_lock_waits
+     << " lock wait time="
+     << PrettyPrinter::Print(lock_wait_time_ns, TCounterType::TIME_NS);
+  return ss.str();
 }
 
 // Initialize a client to read one of the files at random.  The scan ranges are
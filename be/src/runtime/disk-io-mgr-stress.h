@@ -37,7 +37,9 @@ class DiskIoMgrStress {
   DiskIoMgrStress(int num_disks, int num_threads_per_disk, int num_clients, 
       bool includes_cancellation);
 
-  // Run the test for 'sec'.  If 0, run forever
+  // Run the test for 'sec'.  If 0, run forever.  Logs the number of buffers the
+  // clients read per second and the time the io mgr's threads waited for locks after
+  // each second and at the end.
   void Run(int sec);
 
  private:
@@ -70,6 +72,9 @@ class DiskIoMgrStress {
 
   // Flag to signal that client reader threads should exit
   volatile bool shutdown_;
+
+  // Number of buffers the clients got from the io mgr
+  int64_t num_buffers_read_;
   
   // Helper to initialize a new reader client, registering a new reader with the
   // io mgr and initializing the scan ranges
@@ -81,6 +86,10 @@ class DiskIoMgrStress {
 
   // Possibly cancels a random reader.
   void CancelRandomReader();
+
+  // Returns the throughput and lock wait stats for a period of 'elapsed_ns'.
+  static std::string StatsString(int64_t num_buffers, int64_t num_lock_waits,
+      int64_t lock_wait_time_ns, int64_t elapsed_ns);
 };
 
 }
@@ -19,7 +19,7 @@
 #include "codegen/llvm-codegen.h"
 #include "runtime/disk-io-mgr.h"
 #include "runtime/disk-io-mgr-stress.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/thread-resource-mgr.h"
 #include "util/cpu-info.h"
 
@@ -89,7 +89,7 @@ class DiskIoMgrTest : public testing::Test {
 // number of buffers.
 TEST_F(DiskIoMgrTest, SingleReader) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcdefghjijklm";
   CreateTempFile(tmp_file, data);
@@ -133,7 +133,7 @@ TEST_F(DiskIoMgrTest, SingleReader) {
 // Tests a single reader cancelling half way through scan ranges.  
 TEST_F(DiskIoMgrTest, SingleReaderCancel) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcdefghjijklm";
   CreateTempFile(tmp_file, data);
@@ -190,7 +190,7 @@ TEST_F(DiskIoMgrTest, SingleReaderCancel) {
 // This test issues adding additional scan ranges while there are some still in flight.
 TEST_F(DiskIoMgrTest, AddScanRangeTest) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcdefghijklm";
   CreateTempFile(tmp_file, data);
@@ -274,7 +274,7 @@ TEST_F(DiskIoMgrTest, AddScanRangeTest) {
 // number of scan ranges.
 TEST_F(DiskIoMgrTest, SyncReadTest) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcde";
   CreateTempFile(tmp_file, data);
@@ -365,7 +365,7 @@ TEST_F(DiskIoMgrTest, SyncReadTest) {
 // This test will test multiple concurrent reads each reading a different file.
 TEST_F(DiskIoMgrTest, MultipleReader) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   const int NUM_THREADS = 5;
   const int DATA_LEN = 50;
   const int ITERATIONS = 25;
@@ -446,7 +446,7 @@ TEST_F(DiskIoMgrTest, MultipleReader) {
 // a reader.
 TEST_F(DiskIoMgrTest, UpdateBufferQuotaTest) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   int MAX_BUFFERS = 7;
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcdefghijklmnopqrstuvwxyz";
@@ -517,7 +517,7 @@ TEST_F(DiskIoMgrTest, UpdateBufferQuotaTest) {
 // This tests exercises the grouped scan range functionality.
 TEST_F(DiskIoMgrTest, ScanRangeGroupTest) {
   ThreadResourceMgr thread_mgr;
-  MemLimit mem_limit(LARGE_MEM_LIMIT);
+  MemTracker mem_limit(LARGE_MEM_LIMIT);
   int64_t return_buffer_idx = 0;
   const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
   const char* data = "abcdefghijklmnopqrstuvwxyz";
@@ -653,7 +653,7 @@ TEST_F(DiskIoMgrTest, MemLimits) {
   const int num_buffers = 25;
   // Give the reader more buffers than the limit
   const int mem_limit_num_buffers = 10;
-  MemLimit mem_limit(mem_limit_num_buffers * BUFFER_SIZE);
+  MemTracker mem_limit(mem_limit_num_buffers * BUFFER_SIZE);
   
   int64_t iters = 0;
   {
@@ -20,7 +20,7 @@
 #include <boost/thread/locks.hpp>
 
 #include "common/logging.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/thread-resource-mgr.h"
 #include "util/cpu-info.h"
 #include "util/debug-util.h"
@@ -39,6 +39,9 @@ DEFINE_int32(num_disks, 0, "Number of disks on data node.");
 // io and sequential io perform similarly.
 DEFINE_int32(num_threads_per_disk, 1, "number of threads per disk");
 DEFINE_int32(read_size, 8 * 1024 * 1024, "Read Size (in bytes)");
+// The free io buffers are split into this many lists with their own locks.
+DEFINE_int32(num_io_buffer_free_lists, 0,
+    "Number of shards of the io mgr's free buffer lists. 0 uses one per core.");
 
 // Defaults to constrain the queue size.  These constants don't matter much since
 // the io mgr will dynamically find the optimal number.
@@ -149,9 +152,9 @@ struct DiskIoMgr::ReaderContext {
   // Status of this reader.  Set to non-ok if cancelled.
   Status status_;
 
-  // Memory limit for this reader.  This is unowned by this object.  If NULL,
-  // this reader does not have a (per-reader) limit.
-  MemLimit* mem_limit_;
+  // Memory tracker for this reader.  This is unowned by this object.  If NULL,
+  // this reader's buffers are only counted against the process tracker.
+  MemTracker* mem_tracker_;
 
   // The number of disks with scan ranges remaining (always equal to the sum of
   // non-empty ranges in per disk states).
@@ -186,11 +189,10 @@ struct DiskIoMgr::ReaderContext {
   
   // this is just ready_buffers_.size() except ready_buffers_.size() is not thread safe
   // and we want to avoid grabbing the lock for a simple size accessor.
-  // TODO: switch to lock free list.
   int num_ready_buffers_; 
   
   // The number of buffers currently owned by the reader.  Only included for debugging
-  // and diagnostics
+  // and diagnostics.  Updated atomically, ReturnBuffer() doesn't take the lock.
   int num_buffers_in_reader_;
   
   // The number of scan ranges that have been completed for this reader
@@ -338,7 +340,7 @@ struct DiskIoMgr::ReaderContext {
 
   // Resets this object for a new reader
   void Reset(hdfsFS hdfs_connection, ThreadResourceMgr::ResourcePool* pool, 
-      MemLimit* limit) {
+      MemTracker* tracker) {
     DCHECK_EQ(state_, Inactive);
     status_ = Status::OK;
 
@@ -350,7 +352,7 @@ struct DiskIoMgr::ReaderContext {
     state_ = Active;
     sync_reader_ = false;
     hdfs_connection_ = hdfs_connection;
-    mem_limit_ = limit;
+    mem_tracker_ = tracker;
     resource_pool_ = pool;
 
     min_num_buffers_ = MIN_QUEUE_CAPACITY;
@@ -568,12 +570,17 @@ static void CheckSseSupport() {
 }
 
 DiskIoMgr::DiskIoMgr() :
+    process_mem_tracker_(NULL),
     num_threads_per_disk_(FLAGS_num_threads_per_disk),
     max_read_size_(FLAGS_read_size),
     shut_down_(false),
     total_bytes_read_counter_(TCounterType::BYTES),
     read_timer_(TCounterType::TIME_NS),
+    free_buffers_(FLAGS_num_io_buffer_free_lists),
+    free_buffer_descs_(FLAGS_num_io_buffer_free_lists),
     num_allocated_buffers_(0),
+    num_reader_lock_waits_(0),
+    reader_lock_wait_time_ns_(0),
     num_buffers_in_readers_(0) {
   int num_disks = FLAGS_num_disks;
   if (num_disks == 0) num_disks = DiskInfo::num_disks();
@@ -582,12 +589,17 @@ DiskIoMgr::DiskIoMgr() :
 }
 
 DiskIoMgr::DiskIoMgr(int num_disks, int threads_per_disk, int max_read_size) :
+    process_mem_tracker_(NULL),
     num_threads_per_disk_(threads_per_disk),
     max_read_size_(max_read_size),
     shut_down_(false),
     total_bytes_read_counter_(TCounterType::BYTES),
     read_timer_(TCounterType::TIME_NS),
+    free_buffers_(FLAGS_num_io_buffer_free_lists),
+    free_buffer_descs_(FLAGS_num_io_buffer_free_lists),
     num_allocated_buffers_(0),
+    num_reader_lock_waits_(0),
+    reader_lock_wait_time_ns_(0),
     num_buffers_in_readers_(0) {
   if (num_disks == 0) num_disks = DiskInfo::num_disks();
   disk_queues_.resize(num_disks);
@@ -629,9 +641,9 @@ DiskIoMgr::~DiskIoMgr() {
   }
 }
 
-Status DiskIoMgr::Init(ThreadResourceMgr* thread_mgr, MemLimit* process_mem_limit) {
+Status DiskIoMgr::Init(ThreadResourceMgr* thread_mgr, MemTracker* process_mem_tracker) {
   thread_mgr_ = thread_mgr;
-  process_mem_limit_ = process_mem_limit;
+  SetProcessMemTracker(process_mem_tracker);
 
   for (int i = 0; i < disk_queues_.size(); ++i) {
     disk_queues_[i] = new DiskQueue(i);
@@ -644,16 +656,20 @@ Status DiskIoMgr::Init(ThreadResourceMgr* thread_mgr, MemLimit* process_mem_limi
   return Status::OK;
 }
 
-void DiskIoMgr::SetProcessMemLimit(MemLimit* process_mem_limit) {
-  process_mem_limit_ = process_mem_limit;
+void DiskIoMgr::SetProcessMemTracker(MemTracker* process_mem_tracker) {
+  process_mem_tracker_ = process_mem_tracker;
+  // Move the charge for the free buffers over to the new tracker
+  free_buffer_mem_tracker_.reset(
+      new MemTracker(-1, "Free Disk IO Buffers", process_mem_tracker));
+  free_buffer_mem_tracker_->Consume(free_buffers_.size() * max_read_size_);
 }
 
 Status DiskIoMgr::RegisterReader(hdfsFS hdfs, ThreadResourceMgr::ResourcePool* pool,
-    ReaderContext** reader, MemLimit* mem_limit,
+    ReaderContext** reader, MemTracker* mem_tracker,
     int max_io_buffers) {
   DCHECK(reader_cache_.get() != NULL) << "Must call Init() first.";
   *reader = reader_cache_->GetNewReader();
-  (*reader)->Reset(hdfs, pool, mem_limit);
+  (*reader)->Reset(hdfs, pool, mem_tracker);
   SetMaxIoBuffers(*reader, max_io_buffers);
   return Status::OK;
 }
@@ -738,7 +754,7 @@ void DiskIoMgr::CancelReaderInternal(ReaderContext* reader, Status status) {
     
     ready_buffers_copy.swap(reader->ready_buffers_);
     reader->num_ready_buffers_ = 0;
-    reader->num_buffers_in_reader_ += ready_buffers_copy.size();
+    __sync_add_and_fetch(&reader->num_buffers_in_reader_, ready_buffers_copy.size());
     reader->num_used_buffers_ -= ready_buffers_copy.size();
     __sync_add_and_fetch(&num_buffers_in_readers_, ready_buffers_copy.size());
 
@@ -943,7 +959,15 @@ Status DiskIoMgr::Read(hdfsFS hdfs, ScanRange* range, BufferDescriptor** buffer)
 }
 
 Status DiskIoMgr::GetNext(ReaderContext* reader, BufferDescriptor** buffer, bool* eos) {
-  unique_lock<mutex> lock(reader->lock_);
+  unique_lock<mutex> lock(reader->lock_, try_to_lock);
+  if (!lock.owns_lock()) {
+    // All the scanner threads of a scan node call this with the same reader
+    MonotonicStopWatch lock_wait;
+    lock_wait.Start();
+    lock.lock();
+    __sync_add_and_fetch(&num_reader_lock_waits_, 1);
+    __sync_add_and_fetch(&reader_lock_wait_time_ns_, lock_wait.ElapsedTime());
+  }
   DCHECK(reader->Validate()) << endl << reader->DebugString();
   
   *buffer = NULL;
@@ -997,7 +1021,7 @@ Status DiskIoMgr::GetNext(ReaderContext* reader, BufferDescriptor** buffer, bool
   // the buffer is counted as a resource owned by the reader and not the io mgr.
   __sync_add_and_fetch(&num_buffers_in_readers_, 1);
   --reader->num_used_buffers_;
-  ++reader->num_buffers_in_reader_;
+  __sync_add_and_fetch(&reader->num_buffers_in_reader_, 1);
   DCHECK((*buffer)->buffer_ != NULL);
     
   ScanRange* range = (*buffer)->scan_range_;
@@ -1076,76 +1100,85 @@ void DiskIoMgr::ReturnBuffer(BufferDescriptor* buffer_desc) {
   // to be done for this reader.
   if (reader == NULL) return;
 
-  {
-    unique_lock<mutex> reader_lock(reader->lock_);
-    DCHECK(reader->Validate()) << endl << reader->DebugString();
-    --reader->num_buffers_in_reader_;
-  }
+  // The count is only read for validation, so this doesn't need the reader lock.
+  __sync_add_and_fetch(&reader->num_buffers_in_reader_, -1);
 }
 
 void DiskIoMgr::ReturnBufferDesc(BufferDescriptor* desc) {
   DCHECK(desc != NULL);
-  unique_lock<mutex> lock(free_buffers_lock_);
-  free_buffer_descs_.push_back(desc);
+  free_buffer_descs_.Push(desc);
 }
 
 DiskIoMgr::BufferDescriptor* DiskIoMgr::GetBufferDesc(
     ReaderContext* reader, ScanRange* range, char* buffer) {
   BufferDescriptor* buffer_desc;
-  {
-    unique_lock<mutex> lock(free_buffers_lock_);
-    if (free_buffer_descs_.empty()) {
-      buffer_desc = pool_.Add(new BufferDescriptor(this));
-    } else {
-      buffer_desc = free_buffer_descs_.front();
-      free_buffer_descs_.pop_front();
-    }
+  if (!free_buffer_descs_.Pop(&buffer_desc)) {
+    buffer_desc = pool_.Add(new BufferDescriptor(this));
   }
   buffer_desc->Reset(reader, range, buffer);
   return buffer_desc;
 }
 
+MemTracker* DiskIoMgr::ReaderMemTracker(ReaderContext* reader) {
+  if (reader != NULL && reader->mem_tracker_ != NULL) return reader->mem_tracker_;
+  return process_mem_tracker_;
+}
+
 char* DiskIoMgr::GetFreeBuffer(ReaderContext* reader) {
-  unique_lock<mutex> lock(free_buffers_lock_);
   char* buffer = NULL;
-  if (free_buffers_.empty()) {
-    ++num_allocated_buffers_;
+  if (!free_buffers_.Pop(&buffer)) {
+    __sync_add_and_fetch(&num_allocated_buffers_, 1);
     if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
       ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(1L);
     }
-    // Update the process mem usage.  This is checked the next time we start
-    // a read for the next reader (DiskIoMgr::GetNextScanRange)
-    if (process_mem_limit_ != NULL) process_mem_limit_->Consume(max_read_size_);
     buffer = new char[max_read_size_];
   } else {
     if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
       ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-1L);
     }
-    buffer = free_buffers_.front();
-    free_buffers_.pop_front();
+    free_buffer_mem_tracker_->Release(max_read_size_);
   }
   DCHECK(buffer != NULL);
-  if (reader->mem_limit_ != NULL) reader->mem_limit_->Consume(max_read_size_);
+  // Update the mem usage.  This is checked the next time we start a read for the
+  // reader (DiskIoMgr::GetNextScanRange)
+  MemTracker* tracker = ReaderMemTracker(reader);
+  if (tracker != NULL) tracker->Consume(max_read_size_);
   return buffer;
 }
 
 void DiskIoMgr::GcIoBuffers() {
-  unique_lock<mutex> lock(free_buffers_lock_);
-  for (list<char*>::iterator iter = free_buffers_.begin();
-      iter != free_buffers_.end(); ++iter) {
-    if (process_mem_limit_ != NULL) process_mem_limit_->Release(max_read_size_);
-    delete *iter;
+  vector<char*> buffers;
+  free_buffers_.PopAll(&buffers);
+  for (int i = 0; i < buffers.size(); ++i) {
+    free_buffer_mem_tracker_->Release(max_read_size_);
+    delete[] buffers[i];
   }
-  free_buffers_.clear();
+  int num_buffers = buffers.size();
+  __sync_add_and_fetch(&num_allocated_buffers_, -num_buffers);
+  if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
+    ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-num_buffers);
+  }
+  if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
+    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-num_buffers);
+  }
+}
+
+int64_t DiskIoMgr::num_lock_waits() const {
+  return free_buffers_.num_lock_waits() + free_buffer_descs_.num_lock_waits() +
+      num_reader_lock_waits_;
+}
+
+int64_t DiskIoMgr::lock_wait_time_ns() const {
+  return free_buffers_.lock_wait_time_ns() + free_buffer_descs_.lock_wait_time_ns() +
+      reader_lock_wait_time_ns_;
 }
 
 void DiskIoMgr::ReturnFreeBuffer(ReaderContext* reader, char* buffer) {
   DCHECK(buffer != NULL);
-  if (reader != NULL && reader->mem_limit_ != NULL) {
-    reader->mem_limit_->Release(max_read_size_);
-  }
-  unique_lock<mutex> lock(free_buffers_lock_);
-  free_buffers_.push_back(buffer);
+  MemTracker* tracker = ReaderMemTracker(reader);
+  if (tracker != NULL) tracker->Release(max_read_size_);
+  free_buffer_mem_tracker_->Consume(max_read_size_);
+  free_buffers_.Push(buffer);
   if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
     ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(1L);
   }
@@ -1582,19 +1615,10 @@ bool DiskIoMgr::GetNextScanRange(DiskQueue* disk_queue, ScanRange** range,
     // We just picked a reader, check the mem limits.
     // TODO: we can do a lot better here.  The reader can likely make progress
     // with fewer io buffers.
-    bool process_limit_exceeded = 
-        (process_mem_limit_ != NULL) && process_mem_limit_->LimitExceeded();
-    bool reader_limit_exceeded = 
-        ((*reader)->mem_limit_ != NULL) && (*reader)->mem_limit_->LimitExceeded();
-
-    if (process_limit_exceeded && !reader_limit_exceeded) {
-      // We hit the process limit but not the reader one.  See if we can reclaim
-      // some memory by removing previously allocated (but unused) io buffers.
-      GcIoBuffers();
-      process_limit_exceeded = process_mem_limit_->LimitExceeded();
-    }
-
-    if (process_limit_exceeded || reader_limit_exceeded) {
+    // If the process limit is hit, the process tracker's GcFunctions (GcIoBuffers())
+    // try to reclaim memory first.
+    MemTracker* tracker = ReaderMemTracker(*reader);
+    if (tracker != NULL && tracker->LimitExceeded()) {
       CancelReaderInternal(*reader, Status::MEM_LIMIT_EXCEEDED);
     }
 
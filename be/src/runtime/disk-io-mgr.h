@@ -29,10 +29,11 @@
 #include "common/status.h"
 #include "runtime/thread-resource-mgr.h"
 #include "util/runtime-profile.h"
+#include "util/sharded-free-list.h"
 
 namespace impala {
 
-class MemLimit;
+class MemTracker;
 
 // Manager object that schedules IO for all queries on all disks.  Each query maps
 // to one or more readers, each of which has its own queue of scan ranges.  The
@@ -90,9 +91,14 @@ class MemLimit;
 // to the scan node.  Once a range has started, it requires a dedicated scanner thread
 // to process.  The IoMgr checks with the thread mgr before starting new ranges.
 //
+// Free io buffers and buffer descriptors are kept in ShardedFreeLists, so the
+// scanner threads returning buffers and the disk threads taking them don't all
+// contend on one lock.  Returning a buffer doesn't take the reader lock.
+//
 // TODO: IoMgr should be able to request additional scan ranges from the coordinator
 // to help deal with stragglers.
-// TODO: look into using a lock free queue
+// TODO: the ready buffer queues are still protected by the reader lock; they are
+// updated together with the reader's range bookkeeping.
 class DiskIoMgr {
  public:
   struct ReaderContext;
@@ -233,11 +239,13 @@ class DiskIoMgr {
   ~DiskIoMgr();
 
   // Initialize the IoMgr.  Must be called once before any of the other APIs.
-  Status Init(ThreadResourceMgr* thread_mgr, MemLimit* process_mem_limit = NULL);
+  Status Init(ThreadResourceMgr* thread_mgr, MemTracker* process_mem_tracker = NULL);
 
-  // Sets the process wide mem limit for.  If this is exceeded, io requests will 
-  // fail until we are under the limit again.
-  void SetProcessMemLimit(MemLimit* process_mem_limit);
+  // Sets the process wide mem tracker.  Unused io buffers are counted against it, as
+  // are the buffers of readers without a tracker.  If its limit is exceeded, io
+  // requests will fail until we are under the limit again.  Must not be called while
+  // there are reads in flight.
+  void SetProcessMemTracker(MemTracker* process_mem_tracker);
 
   // Allocates tracking structure for this reader. Register a new reader which is
   // returned in *reader.
@@ -247,16 +255,16 @@ class DiskIoMgr {
   //    scan ranges are on the local file system
   // thread_pool: The thread (token) pool for this reader used to control how many
   //    scan ranges should be started in parallel.
-  // reader_mem_limit: If non-null, the memory limit for this reader.  IO buffers
-  //    used for this reader will count against this limit.  If the limit is exceeded
-  //    the reader will be cancelled and MEM_LIMIT_EXCEEDED will be returned via
-  //    GetNext().
+  // reader_mem_tracker: If non-null, the mem tracker for this reader.  IO buffers
+  //    used for this reader will count against it (and its ancestors), otherwise
+  //    against the process tracker.  If the limit is exceeded the reader will be
+  //    cancelled and MEM_LIMIT_EXCEEDED will be returned via GetNext().
   // max_io_buffers: The maximum number of io buffers for this reader.
   //    Reads will not happen if there are no available io buffers.  This limits
   //    the memory usage for this reader.  This is exposed for testing.  Passing
   //    in 0 allows the io mgr to pick.
   Status RegisterReader(hdfsFS hdfs, ThreadResourceMgr::ResourcePool* thread_pool,
-      ReaderContext** reader, MemLimit* reader_mem_limit = NULL, 
+      ReaderContext** reader, MemTracker* reader_mem_tracker = NULL,
       int max_io_buffers = 0);
 
   // Unregisters reader from the disk io mgr.  This must be called for every 
@@ -353,6 +361,15 @@ class DiskIoMgr {
   // Returns the number of buffers currently owned by all readers.
   int num_buffers_in_readers() const { return num_buffers_in_readers_; }
 
+  // Returns the number of times threads waited for a lock on the buffer hand-off path
+  // (the free lists and the reader lock in GetNext()) and the total wait time.
+  int64_t num_lock_waits() const;
+  int64_t lock_wait_time_ns() const;
+
+  // Frees all unused io buffers.  Registered as a GcFunction of the process mem
+  // tracker, so this runs when the process limit is hit.
+  void GcIoBuffers();
+
   // Dumps the disk io mgr queues (for readers and disks)
   std::string DebugString();
 
@@ -374,8 +391,11 @@ class DiskIoMgr {
   // Thread mgr for the process. Not owned by this object.
   ThreadResourceMgr* thread_mgr_;
 
-  // Process memory limit that tracks io buffers.
-  MemLimit* process_mem_limit_;
+  // Process memory tracker that tracks io buffers.
+  MemTracker* process_mem_tracker_;
+
+  // Tracks the buffers in free_buffers_; a child of process_mem_tracker_.
+  boost::scoped_ptr<MemTracker> free_buffer_mem_tracker_;
 
   // Number of worker(read) threads per disk.  Also the max depth of queued
   // work to the disk.
@@ -403,18 +423,19 @@ class DiskIoMgr {
   // contention.
   boost::scoped_ptr<ReaderCache> reader_cache_;
 
-  // Protects free_buffers_ and free_buffer_descs_
-  boost::mutex free_buffers_lock_;
-  
-  // List of free buffer descs that can be handed out to clients.
-  std::list<char*> free_buffers_;
+  // Free buffers that can be handed out to readers.
+  ShardedFreeList<char*> free_buffers_;
 
-  // List of free buffer desc objects that can be handed out to clients
-  std::list<BufferDescriptor*> free_buffer_descs_;
+  // Free buffer desc objects that can be handed out to clients
+  ShardedFreeList<BufferDescriptor*> free_buffer_descs_;
 
   // Total number of allocated buffers, used for debugging.
   int num_allocated_buffers_;
 
+  // Number of times and total time GetNext() waited for a reader lock
+  int64_t num_reader_lock_waits_;
+  int64_t reader_lock_wait_time_ns_;
+
   // Total number of buffers in readers
   int num_buffers_in_readers_;
 
@@ -438,16 +459,14 @@ class DiskIoMgr {
   void ReturnBuffer(BufferDescriptor* buffer);
 
   // Returns a buffer to read into that is the size of max_read_size_.  If there is a
-  // free buffer in the 'free_buffers_', that is returned, otherwise a new one is 
+  // free buffer in 'free_buffers_', that is returned, otherwise a new one is 
   // allocated.
-  // Updates mem limits for reader
+  // Updates mem trackers for reader
   char* GetFreeBuffer(ReaderContext* reader);
 
-  // Garbage collect all unused io buffers.  This is currently only triggered when the
-  // process wide limit is hit.  This is not good enough.  While it is sufficient for
-  // the io mgr, other components do not trigger this GC.  
-  // TODO: make this run periodically?
-  void GcIoBuffers();
+  // Returns the tracker that the buffers of 'reader' are counted against, NULL if
+  // there is none.
+  MemTracker* ReaderMemTracker(ReaderContext* reader);
 
   // Returns a buffer to the free list and updates mem usage for 'reader' 
   void ReturnFreeBuffer(ReaderContext* reader, char* buffer);
@@ -17,6 +17,7 @@
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <gflags/gflags.h>
 
 #include "common/logging.h"
@@ -25,7 +26,9 @@
 #include "runtime/disk-io-mgr.h"
 #include "runtime/hbase-table-factory.h"
 #include "runtime/hdfs-fs-cache.h"
-#include "runtime/mem-limit.h"
+#include "runtime/hfile-block-cache.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/plan-fragment-cache.h"
 #include "runtime/thread-resource-mgr.h"
 #include "statestore/simple-scheduler.h"
 #include "statestore/state-store-subscriber.h"
@@ -46,6 +49,12 @@ DEFINE_bool(use_statestore, true,
 DEFINE_bool(enable_webserver, true, "If true, debug webserver is enabled");
 DECLARE_int32(be_port);
 DECLARE_string(mem_limit);
+DEFINE_string(hfile_block_cache_size, "0",
+    "Size of the process-wide cache of decompressed hfile data blocks, specified like "
+    "--mem_limit. 0 disables the cache.");
+DEFINE_int32(plan_fragment_cache_size, 1024,
+    "Maximum number of plans whose codegen use is remembered, so that the fragments of "
+    "plans that don't jit anything skip codegen. 0 disables the cache.");
 
 DEFINE_string(state_store_host, "localhost",
               "hostname where StateStoreService is running");
@@ -56,14 +65,14 @@ DECLARE_int32(state_store_port);
 namespace impala {
 
 ExecEnv::ExecEnv()
-  : stream_mgr_(new DataStreamMgr()),
+  : mem_tracker_(NULL),
+    stream_mgr_(new DataStreamMgr()),
     client_cache_(new ImpalaInternalServiceClientCache()),
     fs_cache_(new HdfsFsCache()),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
     webserver_(new Webserver()),
     metrics_(new Metrics()),
-    mem_limit_(NULL),
     thread_mgr_(new ThreadResourceMgr),
     enable_webserver_(FLAGS_enable_webserver),
     tz_database_(TimezoneDatabase()) {
@@ -99,14 +108,14 @@ ExecEnv::ExecEnv()
 
 ExecEnv::ExecEnv(const string& hostname, int backend_port, int subscriber_port,
                  int webserver_port, const string& statestore_host, int statestore_port)
-  : stream_mgr_(new DataStreamMgr()),
+  : mem_tracker_(NULL),
+    stream_mgr_(new DataStreamMgr()),
     client_cache_(new ImpalaInternalServiceClientCache()),
     fs_cache_(new HdfsFsCache()),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
     webserver_(new Webserver(webserver_port)),
     metrics_(new Metrics()),
-    mem_limit_(NULL),
     thread_mgr_(new ThreadResourceMgr),
     enable_webserver_(FLAGS_enable_webserver && webserver_port > 0),
     tz_database_(TimezoneDatabase()) {
@@ -154,9 +163,7 @@ Status ExecEnv::StartServices() {
     return Status("Failed to parse mem limit from '" + FLAGS_mem_limit + "'.");
   }
   // Limit of 0 means no memory limit.
-  if (bytes_limit > 0) {
-    mem_limit_.reset(new MemLimit(bytes_limit));
-  }
+  mem_tracker_.reset(new MemTracker(bytes_limit > 0 ? bytes_limit : -1, "Process"));
   if (bytes_limit > MemInfo::physical_mem()) {
     LOG(WARNING) << "Memory limit "
                  << PrettyPrinter::Print(bytes_limit, TCounterType::BYTES)
@@ -167,11 +174,32 @@ Status ExecEnv::StartServices() {
   LOG(INFO) << "Using global memory limit: "
             << PrettyPrinter::Print(bytes_limit, TCounterType::BYTES);
   
-  disk_io_mgr_->SetProcessMemLimit(mem_limit_.get());
+  disk_io_mgr_->SetProcessMemTracker(mem_tracker_.get());
+  // Unused io buffers are the first thing to go if the process is over its limit
+  mem_tracker_->AddGcFunction(bind(&DiskIoMgr::GcIoBuffers, disk_io_mgr_.get()));
+
+  int64_t block_cache_size =
+      ParseUtil::ParseMemSpec(FLAGS_hfile_block_cache_size, &is_percent);
+  if (block_cache_size < 0) {
+    return Status("Failed to parse hfile block cache size from '" +
+        FLAGS_hfile_block_cache_size + "'.");
+  }
+  if (block_cache_size > 0) {
+    hfile_block_cache_.reset(new HFileBlockCache(block_cache_size, mem_tracker_.get()));
+    // Cached blocks can be read again, so they go as well
+    mem_tracker_->AddGcFunction(
+        bind(&HFileBlockCache::Clear, hfile_block_cache_.get()));
+    LOG(INFO) << "Using hfile block cache of "
+              << PrettyPrinter::Print(block_cache_size, TCounterType::BYTES);
+  }
+
+  if (FLAGS_plan_fragment_cache_size > 0) {
+    plan_fragment_cache_.reset(new PlanFragmentCache(FLAGS_plan_fragment_cache_size));
+  }
 
   // Start services in order to ensure that dependencies between them are met
   if (enable_webserver_) {
-    AddDefaultPathHandlers(webserver_.get(), mem_limit_.get());
+    AddDefaultPathHandlers(webserver_.get(), mem_tracker_.get());
     RETURN_IF_ERROR(webserver_->Start());
   } else {
     LOG(INFO) << "Not starting webserver";
@@ -30,12 +30,14 @@ class DataStreamMgr;
 class DiskIoMgr;
 class HBaseTableFactory;
 class HdfsFsCache;
+class HFileBlockCache;
+class PlanFragmentCache;
 class Scheduler;
 class StateStoreSubscriber;
 class TestExecEnv;
 class Webserver;
 class Metrics;
-class MemLimit;
+class MemTracker;
 class ThreadResourceMgr;
 
 // Execution environment for queries/plan fragments.
@@ -65,8 +67,15 @@ class ExecEnv {
   DiskIoMgr* disk_io_mgr() { return disk_io_mgr_.get(); }
   Webserver* webserver() { return webserver_.get(); }
   Metrics* metrics() { return metrics_.get(); }
-  MemLimit* mem_limit() { return mem_limit_.get(); }
+  // Root of the memory tracker tree, NULL until StartServices() is called
+  MemTracker* mem_tracker() { return mem_tracker_.get(); }
   ThreadResourceMgr* thread_mgr() { return thread_mgr_.get(); }
+  // Cache of decompressed hfile data blocks, NULL if it is disabled or until
+  // StartServices() is called
+  HFileBlockCache* hfile_block_cache() { return hfile_block_cache_.get(); }
+  // Cache of what was learned from running the fragments of each plan, NULL if it is
+  // disabled or until StartServices() is called
+  PlanFragmentCache* plan_fragment_cache() { return plan_fragment_cache_.get(); }
 
   void set_enable_webserver(bool enable) { enable_webserver_ = enable; }
 
@@ -78,6 +87,11 @@ class ExecEnv {
 
  protected:
   // Leave protected so that subclasses can override
+  // Process memory tracker.  Declared first, since the trackers of other members are
+  // its children and need to be destroyed before it.
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+  boost::scoped_ptr<HFileBlockCache> hfile_block_cache_;
+  boost::scoped_ptr<PlanFragmentCache> plan_fragment_cache_;
   boost::scoped_ptr<DataStreamMgr> stream_mgr_;
   boost::scoped_ptr<Scheduler> scheduler_;
   boost::scoped_ptr<StateStoreSubscriber> state_store_subscriber_;
@@ -87,7 +101,6 @@ class ExecEnv {
   boost::scoped_ptr<DiskIoMgr> disk_io_mgr_;
   boost::scoped_ptr<Webserver> webserver_;
   boost::scoped_ptr<Metrics> metrics_;
-  boost::scoped_ptr<MemLimit> mem_limit_;
   boost::scoped_ptr<ThreadResourceMgr> thread_mgr_;
 
   bool enable_webserver_;
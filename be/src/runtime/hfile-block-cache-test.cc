@@ -0,0 +1,80 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <gtest/gtest.h>
+
+#include "runtime/hfile-block-cache.h"
+#include "runtime/mem-tracker.h"
+
+using namespace std;
+
+namespace impala {
+
+static const uint8_t* Data(const string& s) {
+  return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+TEST(HFileBlockCacheTest, Basic) {
+  MemTracker process_tracker;
+  HFileBlockCache cache(100, &process_tracker);
+  string block(40, 'a');
+  uint8_t buffer[100];
+  EXPECT_FALSE(cache.Lookup("file", 1, 0, 40, buffer));
+
+  cache.Insert("file", 1, 0, Data(block), 40);
+  EXPECT_EQ(cache.size(), 40);
+  EXPECT_EQ(process_tracker.consumption(), 40);
+  EXPECT_TRUE(cache.Lookup("file", 1, 0, 40, buffer));
+  EXPECT_EQ(memcmp(buffer, block.data(), 40), 0);
+
+  // Other offsets, files, modification times and lengths are different blocks.
+  EXPECT_FALSE(cache.Lookup("file", 1, 40, 40, buffer));
+  EXPECT_FALSE(cache.Lookup("file2", 1, 0, 40, buffer));
+  EXPECT_FALSE(cache.Lookup("file", 2, 0, 40, buffer));
+  EXPECT_FALSE(cache.Lookup("file", 1, 0, 30, buffer));
+
+  // Blocks bigger than the cache are not added.
+  string big_block(101, 'b');
+  cache.Insert("file", 1, 100, Data(big_block), 101);
+  EXPECT_EQ(cache.size(), 40);
+
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(process_tracker.consumption(), 0);
+  EXPECT_FALSE(cache.Lookup("file", 1, 0, 40, buffer));
+}
+
+TEST(HFileBlockCacheTest, Lru) {
+  HFileBlockCache cache(100);
+  string block(40, 'a');
+  uint8_t buffer[40];
+  cache.Insert("file", 1, 0, Data(block), 40);
+  cache.Insert("file", 1, 40, Data(block), 40);
+  // Makes the block at offset 40 the least recently used one.
+  EXPECT_TRUE(cache.Lookup("file", 1, 0, 40, buffer));
+  cache.Insert("file", 1, 80, Data(block), 40);
+  EXPECT_EQ(cache.size(), 80);
+  EXPECT_TRUE(cache.Lookup("file", 1, 0, 40, buffer));
+  EXPECT_FALSE(cache.Lookup("file", 1, 40, 40, buffer));
+  EXPECT_TRUE(cache.Lookup("file", 1, 80, 40, buffer));
+  EXPECT_EQ(cache.mem_tracker()->consumption(), 80);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,99 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/hfile-block-cache.h"
+
+#include <string.h>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "common/logging.h"
+#include "runtime/mem-tracker.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+size_t hash_value(const HFileBlockCache::BlockKey& key) {
+  size_t seed = boost::hash<string>()(key.file);
+  hash_combine(seed, key.mtime);
+  hash_combine(seed, key.offset);
+  return seed;
+}
+
+HFileBlockCache::HFileBlockCache(int64_t capacity, MemTracker* process_mem_tracker)
+  : capacity_(capacity),
+    mem_tracker_(new MemTracker(-1, "HFile Block Cache", process_mem_tracker)),
+    size_(0) {
+  DCHECK_GT(capacity, 0);
+}
+
+HFileBlockCache::~HFileBlockCache() {
+  Clear();
+}
+
+bool HFileBlockCache::Lookup(const string& file, int64_t mtime, int64_t offset,
+    int64_t len, uint8_t* buffer) {
+  boost::shared_ptr<string> data;
+  {
+    boost::lock_guard<boost::mutex> l(lock_);
+    BlockMap::iterator it = block_map_.find(BlockKey(file, mtime, offset));
+    if (it == block_map_.end()) return false;
+    // Move the block to the front of the list, this doesn't invalidate 'it'
+    blocks_.splice(blocks_.begin(), blocks_, it->second);
+    data = it->second->second;
+  }
+  if (data->size() != static_cast<size_t>(len)) return false;
+  memcpy(buffer, data->data(), len);
+  return true;
+}
+
+void HFileBlockCache::Insert(const string& file, int64_t mtime, int64_t offset,
+    const uint8_t* data, int64_t len) {
+  if (len > capacity_) return;
+  // Copy the block before taking the lock
+  boost::shared_ptr<string> block(new string(reinterpret_cast<const char*>(data), len));
+  BlockKey key(file, mtime, offset);
+
+  boost::lock_guard<boost::mutex> l(lock_);
+  // Another thread may have read and added the same block
+  if (block_map_.find(key) != block_map_.end()) return;
+  while (size_ + len > capacity_) {
+    EvictLru();
+  }
+  blocks_.push_front(make_pair(key, block));
+  block_map_[key] = blocks_.begin();
+  size_ += len;
+  mem_tracker_->Consume(len);
+}
+
+void HFileBlockCache::Clear() {
+  boost::lock_guard<boost::mutex> l(lock_);
+  while (!blocks_.empty()) {
+    EvictLru();
+  }
+}
+
+void HFileBlockCache::EvictLru() {
+  DCHECK(!blocks_.empty());
+  const Block& block = blocks_.back();
+  int64_t len = block.second->size();
+  block_map_.erase(block.first);
+  blocks_.pop_back();
+  size_ -= len;
+  mem_tracker_->Release(len);
+}
+
+}
@@ -0,0 +1,105 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_RUNTIME_HFILE_BLOCK_CACHE_H
+#define IMPALA_RUNTIME_HFILE_BLOCK_CACHE_H
+
+#include <list>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace impala {
+
+class MemTracker;
+
+// A process-wide LRU cache of decompressed hfile data blocks.  Hot regions of hbase
+// tables are often read by many queries in a row, which then skip decompressing and
+// verifying the blocks of those regions.
+// Blocks are identified by their file, the modification time of the file and their
+// offset in it, so a file that was rewritten never returns stale blocks.
+// The memory of the cached blocks is counted against a child of the process
+// MemTracker, and the cache is emptied if the process goes over its limit.
+// Thread-safe.
+class HFileBlockCache {
+ public:
+  // 'capacity' is the maximum number of bytes of cached blocks.  If
+  // 'process_mem_tracker' is non-NULL, the cache's tracker is created as its child.
+  HFileBlockCache(int64_t capacity, MemTracker* process_mem_tracker = NULL);
+  ~HFileBlockCache();
+
+  // Copies the block at 'offset' of 'file' into 'buffer' if it is cached and is
+  // 'len' bytes long, and marks it as the most recently used block.  Returns false
+  // if it is not cached.
+  bool Lookup(const std::string& file, int64_t mtime, int64_t offset, int64_t len,
+      uint8_t* buffer);
+
+  // Adds a copy of the 'len' bytes at 'data' as the block at 'offset' of 'file',
+  // evicting the least recently used blocks to make room for it.  Blocks that are
+  // bigger than the capacity are not cached.
+  void Insert(const std::string& file, int64_t mtime, int64_t offset,
+      const uint8_t* data, int64_t len);
+
+  // Evicts all blocks.
+  void Clear();
+
+  int64_t capacity() const { return capacity_; }
+
+  // Number of bytes of cached blocks
+  int64_t size() const { return size_; }
+
+  MemTracker* mem_tracker() { return mem_tracker_.get(); }
+
+ private:
+  struct BlockKey {
+    std::string file;
+    int64_t mtime;
+    int64_t offset;
+
+    BlockKey(const std::string& file, int64_t mtime, int64_t offset)
+      : file(file), mtime(mtime), offset(offset) { }
+
+    bool operator==(const BlockKey& other) const {
+      return offset == other.offset && mtime == other.mtime && file == other.file;
+    }
+  };
+
+  friend std::size_t hash_value(const BlockKey& key);
+
+  // The data is shared so that Lookup() can copy it without holding lock_, while
+  // another thread evicts the block.
+  typedef std::pair<BlockKey, boost::shared_ptr<std::string> > Block;
+
+  // Cached blocks, most recently used first
+  typedef std::list<Block> BlockList;
+  typedef boost::unordered_map<BlockKey, BlockList::iterator> BlockMap;
+
+  // Evicts the least recently used block.  lock_ must be held.
+  void EvictLru();
+
+  const int64_t capacity_;
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+
+  // Protects all members below
+  boost::mutex lock_;
+  BlockList blocks_;
+  BlockMap block_map_;
+  int64_t size_;
+};
+
+}
+
+#endif
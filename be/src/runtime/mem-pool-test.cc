@@ -16,7 +16,7 @@
 #include <gtest/gtest.h>
 
 #include "runtime/mem-pool.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 
 using namespace std;
 
@@ -141,12 +141,12 @@ TEST(MemPoolTest, Keep) {
 }
 
 TEST(MemPoolTest, Limits) {
-  MemLimit limit1(160);
-  MemLimit limit2(240);
-  MemLimit limit3(320);
+  MemTracker limit1(160);
+  MemTracker limit2(240);
+  MemTracker limit3(320);
 
   MemPool* p1 = new MemPool(80);
-  vector<MemLimit*> limits;
+  vector<MemTracker*> limits;
   limits.push_back(&limit1);
   limits.push_back(&limit3);
   p1->set_limits(limits);
@@ -13,7 +13,7 @@
 // limitations under the License.
 
 #include "runtime/mem-pool.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "util/impalad-metrics.h"
 
 #include <algorithm>
@@ -59,7 +59,7 @@ MemPool::~MemPool() {
     total_bytes_released += chunks_[i].size;
     delete [] chunks_[i].data;
   }
-  MemLimit::UpdateLimits(-1 * total_bytes_released, &limits_);
+  MemTracker::UpdateLimits(-1 * total_bytes_released, &limits_);
   if (ImpaladMetrics::MEM_POOL_TOTAL_BYTES != NULL) {
     ImpaladMetrics::MEM_POOL_TOTAL_BYTES->Increment(-total_bytes_released);
   }
@@ -108,8 +108,8 @@ void MemPool::FindChunk(int min_size) {
     }
 
     // update and check limits
-    MemLimit::UpdateLimits(chunk_size, &limits_);
-    exceeded_limit_ = MemLimit::LimitExceeded(limits_);
+    MemTracker::UpdateLimits(chunk_size, &limits_);
+    exceeded_limit_ = MemTracker::LimitExceeded(limits_);
   }
 
   if (current_chunk_idx_ > 0) {
@@ -141,8 +141,8 @@ void MemPool::AcquireData(MemPool* src, bool keep_current) {
   for (vector<ChunkInfo>::iterator i = src->chunks_.begin(); i != end_chunk; ++i) {
     total_transfered_bytes += i->size;
   }
-  MemLimit::UpdateLimits(-1 * total_transfered_bytes, &src->limits_);
-  MemLimit::UpdateLimits(total_transfered_bytes, &limits_);
+  MemTracker::UpdateLimits(-1 * total_transfered_bytes, &src->limits_);
+  MemTracker::UpdateLimits(total_transfered_bytes, &limits_);
 
   // insert new chunks after current_chunk_idx_
   vector<ChunkInfo>::iterator insert_chunk = chunks_.begin() + current_chunk_idx_ + 1;
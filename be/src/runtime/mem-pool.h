@@ -25,16 +25,16 @@
 
 namespace impala {
 
-class MemLimit;
+class MemTracker;
 
 // A MemPool maintains a list of memory chunks from which it allocates memory in
 // response to Allocate() calls;
 // Chunks stay around for the lifetime of the mempool or until they are passed on to
 // another mempool.
 //
-// The caller can register a set of MemLimits with the pool, in which case chunk
+// The caller can register a set of MemTrackers with the pool, in which case chunk
 // allocations are counted against those limits. If chunks get moved between pools
-// during AcquireData() calls, the respective MemLimits are updated accordingly.
+// during AcquireData() calls, the respective MemTrackers are updated accordingly.
 // Chunks freed up in the d'tor are subtracted from the registered limits.
 //
 // An Allocate() call will attempt to allocate memory from the chunk that was most
@@ -136,7 +136,7 @@ class MemPool {
 
   int64_t total_allocated_bytes() const { return total_allocated_bytes_; }
   int64_t peak_allocated_bytes() const { return peak_allocated_bytes_; }
-  void set_limits(const std::vector<MemLimit*>& limits) { limits_ = limits; }
+  void set_limits(const std::vector<MemTracker*>& limits) { limits_ = limits; }
   bool exceeded_limit() const { return exceeded_limit_; }
 
   // Return sum of chunk_sizes_.
@@ -213,7 +213,7 @@ class MemPool {
 
   std::vector<ChunkInfo> chunks_;
 
-  std::vector<MemLimit*> limits_;
+  std::vector<MemTracker*> limits_;
 
   // true if one of the registered limits was exceeded during an Allocate()
   // call
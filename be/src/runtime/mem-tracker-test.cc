@@ -0,0 +1,200 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <boost/bind.hpp>
+#include <gtest/gtest.h>
+
+#include "runtime/mem-tracker.h"
+
+using namespace std;
+
+namespace impala {
+
+TEST(MemTrackerTest, SingleTrackerNoLimit) {
+  MemTracker t;
+  EXPECT_FALSE(t.has_limit());
+  t.Consume(10);
+  EXPECT_EQ(t.consumption(), 10);
+  t.Consume(10);
+  EXPECT_EQ(t.consumption(), 20);
+  t.Release(15);
+  EXPECT_EQ(t.consumption(), 5);
+  EXPECT_EQ(t.peak_consumption(), 20);
+  EXPECT_FALSE(t.LimitExceeded());
+}
+
+TEST(MemTrackerTest, SingleTrackerWithLimit) {
+  MemTracker t(11);
+  EXPECT_TRUE(t.has_limit());
+  t.Consume(10);
+  EXPECT_EQ(t.consumption(), 10);
+  EXPECT_EQ(t.SpareCapacity(), 1);
+  EXPECT_FALSE(t.LimitExceeded());
+  t.Consume(10);
+  EXPECT_EQ(t.consumption(), 20);
+  EXPECT_TRUE(t.LimitExceeded());
+  t.Release(15);
+  EXPECT_EQ(t.consumption(), 5);
+  EXPECT_FALSE(t.LimitExceeded());
+}
+
+TEST(MemTrackerTest, TrackerHierarchy) {
+  MemTracker p(100);
+  MemTracker c1(80, "", &p);
+  MemTracker c2(50, "", &p);
+
+  // everything below limits
+  c1.Consume(60);
+  EXPECT_EQ(c1.consumption(), 60);
+  EXPECT_FALSE(c1.LimitExceeded());
+  EXPECT_EQ(c2.consumption(), 0);
+  EXPECT_FALSE(c2.LimitExceeded());
+  EXPECT_EQ(p.consumption(), 60);
+  EXPECT_FALSE(p.LimitExceeded());
+  EXPECT_EQ(c1.SpareCapacity(), 20);
+  EXPECT_EQ(c2.SpareCapacity(), 40);
+
+  // p goes over limit
+  c2.Consume(50);
+  EXPECT_EQ(c1.consumption(), 60);
+  EXPECT_TRUE(c1.LimitExceeded());
+  EXPECT_EQ(c2.consumption(), 50);
+  EXPECT_TRUE(c2.LimitExceeded());
+  EXPECT_EQ(p.consumption(), 110);
+  EXPECT_TRUE(p.LimitExceeded());
+
+  // c2 goes over limit, p drops below limit
+  c1.Release(20);
+  c2.Consume(10);
+  EXPECT_EQ(c1.consumption(), 40);
+  EXPECT_FALSE(c1.LimitExceeded());
+  EXPECT_EQ(c2.consumption(), 60);
+  EXPECT_TRUE(c2.LimitExceeded());
+  EXPECT_EQ(p.consumption(), 100);
+  EXPECT_FALSE(p.LimitExceeded());
+  EXPECT_EQ(p.peak_consumption(), 110);
+  c1.Release(40);
+  c2.Release(60);
+}
+
+TEST(MemTrackerTest, TrackerVector) {
+  MemTracker t1(10);
+  MemTracker t2(20);
+  vector<MemTracker*> trackers;
+  trackers.push_back(&t1);
+  trackers.push_back(&t2);
+  EXPECT_EQ(MemTracker::SpareCapacity(trackers), 10);
+  MemTracker::UpdateLimits(15, &trackers);
+  EXPECT_EQ(t1.consumption(), 15);
+  EXPECT_EQ(t2.consumption(), 15);
+  EXPECT_TRUE(MemTracker::LimitExceeded(trackers));
+  MemTracker::UpdateLimits(-10, &trackers);
+  EXPECT_EQ(t1.consumption(), 5);
+  EXPECT_EQ(t2.consumption(), 5);
+  EXPECT_FALSE(MemTracker::LimitExceeded(trackers));
+}
+
+// Releases up to 'bytes' of 'tracker's consumption
+static void FreeMemory(MemTracker* tracker, int64_t bytes) {
+  tracker->Release(min(bytes, tracker->consumption()));
+}
+
+TEST(MemTrackerTest, GcFunctions) {
+  MemTracker p(100);
+  MemTracker c(-1, "", &p);
+  c.AddGcFunction(boost::bind(&FreeMemory, &c, 30));
+
+  c.Consume(120);
+  EXPECT_EQ(p.consumption(), 120);
+  // the child's gc function is called by the parent and frees enough memory
+  EXPECT_FALSE(c.LimitExceeded());
+  EXPECT_EQ(c.consumption(), 90);
+  EXPECT_EQ(p.consumption(), 90);
+
+  // one gc run isn't enough
+  c.Consume(50);
+  EXPECT_TRUE(c.LimitExceeded());
+  EXPECT_EQ(p.consumption(), 110);
+  c.Release(110);
+
+  // trackers without a limit don't call their gc functions
+  MemTracker t;
+  t.AddGcFunction(boost::bind(&FreeMemory, &t, 30));
+  t.Consume(50);
+  EXPECT_FALSE(t.GcMemory());
+  EXPECT_EQ(t.consumption(), 50);
+}
+
+TEST(MemTrackerTest, QueryMemTracker) {
+  MemTracker process;
+  TUniqueId id;
+  id.hi = 1;
+  id.lo = 2;
+  {
+    boost::shared_ptr<MemTracker> t1 = MemTracker::GetQueryMemTracker(id, 100, &process);
+    boost::shared_ptr<MemTracker> t2 = MemTracker::GetQueryMemTracker(id, 100, &process);
+    EXPECT_EQ(t1.get(), t2.get());
+    EXPECT_EQ(t1->limit(), 100);
+    EXPECT_EQ(t1->parent(), &process);
+
+    t1->Consume(10);
+    EXPECT_EQ(process.consumption(), 10);
+    t1->Release(10);
+  }
+  // the tracker expired when the last reference was dropped, a new one is created
+  boost::shared_ptr<MemTracker> t3 = MemTracker::GetQueryMemTracker(id, 50, &process);
+  EXPECT_EQ(t3->limit(), 50);
+  EXPECT_EQ(t3->consumption(), 0);
+}
+
+// Several impalads in one process (e.g. an in-process test cluster) each have their
+// own tracker for the same query
+TEST(MemTrackerTest, QueryMemTrackerPerParent) {
+  MemTracker process1;
+  MemTracker process2;
+  TUniqueId id;
+  id.hi = 3;
+  id.lo = 4;
+  boost::shared_ptr<MemTracker> t1 = MemTracker::GetQueryMemTracker(id, 100, &process1);
+  boost::shared_ptr<MemTracker> t2 = MemTracker::GetQueryMemTracker(id, 100, &process2);
+  EXPECT_NE(t1.get(), t2.get());
+  EXPECT_EQ(t1->parent(), &process1);
+  EXPECT_EQ(t2->parent(), &process2);
+  EXPECT_EQ(MemTracker::GetQueryMemTracker(id, 100, &process1).get(), t1.get());
+
+  t2->Consume(10);
+  EXPECT_EQ(process1.consumption(), 0);
+  EXPECT_EQ(process2.consumption(), 10);
+  t2->Release(10);
+}
+
+TEST(MemTrackerTest, LogUsage) {
+  MemTracker p(100, "Parent");
+  MemTracker c1(-1, "Child1", &p);
+  MemTracker c2(-1, "Child2", &p);
+  c1.Consume(10);
+  string usage = p.LogUsage();
+  EXPECT_NE(usage.find("Parent: Limit="), string::npos) << usage;
+  EXPECT_NE(usage.find("\n  Child1: Consumption="), string::npos) << usage;
+  EXPECT_NE(usage.find("\n  Child2: Consumption="), string::npos) << usage;
+  c1.Release(10);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
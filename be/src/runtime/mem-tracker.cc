@@ -0,0 +1,140 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/mem-tracker.h"
+
+#include <sstream>
+#include <boost/thread/locks.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "util/debug-util.h"
+#include "util/uid-util.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Trackers created by GetQueryMemTracker(), by query id and parent.  The trackers are
+// owned by the fragment instances of the query, an entry expires when the last one is
+// done.  The parent is part of the key because in-process test clusters run several
+// impalads, each with its own process tracker, and a query runs fragments on all of
+// them.
+typedef pair<TUniqueId, MemTracker*> QueryTrackerKey;
+struct QueryTrackerKeyHash {
+  size_t operator()(const QueryTrackerKey& key) const {
+    size_t seed = hash<TUniqueId>()(key.first);
+    hash_combine(seed, key.second);
+    return seed;
+  }
+};
+typedef unordered_map<QueryTrackerKey, weak_ptr<MemTracker>, QueryTrackerKeyHash>
+    QueryTrackerMap;
+static mutex query_trackers_lock;
+static QueryTrackerMap query_trackers;
+
+MemTracker::MemTracker(int64_t byte_limit, const string& label, MemTracker* parent)
+  : limit_(byte_limit),
+    consumption_(0),
+    peak_consumption_(0),
+    label_(label),
+    parent_(parent),
+    is_query_tracker_(false) {
+  for (MemTracker* tracker = this; tracker != NULL; tracker = tracker->parent_) {
+    all_trackers_.push_back(tracker);
+    if (tracker->has_limit()) limit_trackers_.push_back(tracker);
+  }
+  if (parent_ != NULL) {
+    lock_guard<mutex> l(parent_->lock_);
+    child_tracker_it_ =
+        parent_->child_trackers_.insert(parent_->child_trackers_.end(), this);
+  }
+}
+
+MemTracker::~MemTracker() {
+  if (parent_ != NULL) {
+    lock_guard<mutex> l(parent_->lock_);
+    parent_->child_trackers_.erase(child_tracker_it_);
+  }
+  if (is_query_tracker_) {
+    lock_guard<mutex> l(query_trackers_lock);
+    QueryTrackerMap::iterator it = query_trackers.find(make_pair(query_id_, parent_));
+    // A new tracker for the same query may have been created since ours expired
+    if (it != query_trackers.end() && it->second.expired()) query_trackers.erase(it);
+  }
+}
+
+shared_ptr<MemTracker> MemTracker::GetQueryMemTracker(const TUniqueId& id,
+    int64_t byte_limit, MemTracker* parent) {
+  lock_guard<mutex> l(query_trackers_lock);
+  QueryTrackerKey key(id, parent);
+  QueryTrackerMap::iterator it = query_trackers.find(key);
+  if (it != query_trackers.end()) {
+    shared_ptr<MemTracker> tracker = it->second.lock();
+    if (tracker != NULL) {
+      DCHECK_EQ(tracker->limit(), byte_limit);
+      return tracker;
+    }
+  }
+  stringstream label;
+  label << "Query " << PrintId(id);
+  shared_ptr<MemTracker> tracker(new MemTracker(byte_limit, label.str(), parent));
+  tracker->is_query_tracker_ = true;
+  tracker->query_id_ = id;
+  query_trackers[key] = tracker;
+  return tracker;
+}
+
+void MemTracker::AddGcFunction(const GcFunction& f) {
+  lock_guard<mutex> l(lock_);
+  gc_functions_.push_back(f);
+}
+
+bool MemTracker::GcMemory() {
+  if (!has_limit()) return false;
+  lock_guard<mutex> l(gc_lock_);
+  // Another thread may have freed up memory while we were waiting for gc_lock_
+  if (consumption_ <= limit_) return false;
+  RunGcFunctions();
+  return consumption_ > limit_;
+}
+
+void MemTracker::RunGcFunctions() {
+  lock_guard<mutex> l(lock_);
+  for (int i = 0; i < gc_functions_.size(); ++i) {
+    gc_functions_[i]();
+  }
+  for (list<MemTracker*>::iterator it = child_trackers_.begin();
+       it != child_trackers_.end(); ++it) {
+    (*it)->RunGcFunctions();
+  }
+}
+
+string MemTracker::LogUsage(const string& prefix) const {
+  stringstream ss;
+  ss << prefix << label_ << ":";
+  if (has_limit()) ss << " Limit=" << PrettyPrinter::Print(limit_, TCounterType::BYTES);
+  ss << " Consumption=" << PrettyPrinter::Print(consumption_, TCounterType::BYTES)
+     << " Peak=" << PrettyPrinter::Print(peak_consumption_, TCounterType::BYTES);
+  lock_guard<mutex> l(lock_);
+  string child_prefix = prefix + "  ";
+  for (list<MemTracker*>::const_iterator it = child_trackers_.begin();
+       it != child_trackers_.end(); ++it) {
+    ss << endl << (*it)->LogUsage(child_prefix);
+  }
+  return ss.str();
+}
+
+}
@@ -0,0 +1,210 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_MEM_TRACKER_H
+#define IMPALA_RUNTIME_MEM_TRACKER_H
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+#include "gen-cpp/Types_types.h"  // for TUniqueId
+
+namespace impala {
+
+// A MemTracker tracks memory consumption and optionally enforces a limit on it.
+// MemTrackers form a tree: the consumption of a tracker is also counted against all
+// of its ancestors, and a tracker's limit is exceeded if the consumption of the tracker
+// or of any of its ancestors exceeds their respective limit.  An impalad has a tree
+// like this:
+//   process -> query -> fragment instance -> exec node
+// The query level tracker is shared by all fragment instances of the query that run
+// in the same impalad (see GetQueryMemTracker()) and enforces the mem_limit query
+// option.
+// Components that hold memory that they can give back when asked (e.g. free lists)
+// can register a GcFunction with a tracker.  When a limit is found to be exceeded,
+// the GcFunctions of that tracker and of all of its descendants are called before
+// the limit is reported as exceeded (which usually cancels the query).
+// Consumption is updated with atomic operations, so trackers can be shared by threads.
+class MemTracker {
+ public:
+  // Frees up memory that is counted against a tracker.  Must not create or destroy
+  // MemTrackers.
+  typedef boost::function<void ()> GcFunction;
+
+  // byte_limit < 0 means no limit.  'label' identifies the tracker in LogUsage().
+  // If 'parent' is non-NULL, the tracker is added to its children and needs to be
+  // destroyed before it.
+  MemTracker(int64_t byte_limit = -1, const std::string& label = "",
+      MemTracker* parent = NULL);
+
+  ~MemTracker();
+
+  // Returns the tracker of the query 'id' under 'parent', which is created with the
+  // given limit if no fragment instance of the query currently holds on to it.
+  static boost::shared_ptr<MemTracker> GetQueryMemTracker(const TUniqueId& id,
+      int64_t byte_limit, MemTracker* parent);
+
+  // Increases consumption of this tracker and its ancestors by 'bytes'.
+  void Consume(int64_t bytes) {
+    if (bytes == 0) return;
+    for (std::vector<MemTracker*>::iterator i = all_trackers_.begin();
+         i != all_trackers_.end(); ++i) {
+      int64_t consumption = __sync_add_and_fetch(&(*i)->consumption_, bytes);
+      DCHECK_GE(consumption, 0);
+      (*i)->UpdatePeak(consumption);
+    }
+  }
+
+  // Decreases consumption of this tracker and its ancestors by 'bytes'.
+  void Release(int64_t bytes) {
+    if (bytes == 0) return;
+    for (std::vector<MemTracker*>::iterator i = all_trackers_.begin();
+         i != all_trackers_.end(); ++i) {
+      int64_t consumption = __sync_add_and_fetch(&(*i)->consumption_, -bytes);
+      DCHECK_GE(consumption, 0);
+    }
+  }
+
+  // Returns true if a limit of this tracker or of one of its ancestors is exceeded,
+  // after trying to get back under the limit with GcMemory().
+  bool LimitExceeded() {
+    for (std::vector<MemTracker*>::iterator i = limit_trackers_.begin();
+         i != limit_trackers_.end(); ++i) {
+      if (UNLIKELY((*i)->consumption_ > (*i)->limit_) && (*i)->GcMemory()) return true;
+    }
+    return false;
+  }
+
+  // Returns the number of bytes that can still be consumed before a limit of this
+  // tracker or one of its ancestors is exceeded.  Returns the max int64 value if there
+  // are no limits.
+  int64_t SpareCapacity() const {
+    int64_t result = std::numeric_limits<int64_t>::max();
+    for (std::vector<MemTracker*>::const_iterator i = limit_trackers_.begin();
+         i != limit_trackers_.end(); ++i) {
+      result = std::min(result, (*i)->limit_ - (*i)->consumption_);
+    }
+    return result;
+  }
+
+  // Registers 'f' to be called by GcMemory() of this tracker or of an ancestor.
+  void AddGcFunction(const GcFunction& f);
+
+  // Calls the GcFunctions of this tracker and of its descendants if consumption is
+  // over the limit.  Returns true if consumption is still over the limit afterwards.
+  bool GcMemory();
+
+  // Returns a human readable report of the consumption of this tracker and its
+  // descendants, one tracker per line, each line starting with 'prefix'.
+  std::string LogUsage(const std::string& prefix = "") const;
+
+  int64_t limit() const { return limit_; }
+  bool has_limit() const { return limit_ >= 0; }
+  int64_t consumption() const { return consumption_; }
+  // Highest consumption seen so far
+  int64_t peak_consumption() const { return peak_consumption_; }
+  const std::string& label() const { return label_; }
+  MemTracker* parent() const { return parent_; }
+
+  // Helpers for components that charge memory to a set of trackers.  The trackers
+  // must not be ancestors of each other, otherwise memory is counted twice.
+  static void UpdateLimits(int64_t bytes, std::vector<MemTracker*>* trackers) {
+    for (std::vector<MemTracker*>::iterator i = trackers->begin();
+         i != trackers->end(); ++i) {
+      if (bytes > 0) {
+        (*i)->Consume(bytes);
+      } else {
+        (*i)->Release(-bytes);
+      }
+    }
+  }
+
+  static bool LimitExceeded(const std::vector<MemTracker*>& trackers) {
+    for (std::vector<MemTracker*>::const_iterator i = trackers.begin();
+         i != trackers.end(); ++i) {
+      if ((*i)->LimitExceeded()) {
+        // TODO: remove logging
+        LOG(INFO) << "exceeded limit: tracker=" << (*i)->label()
+                  << " limit=" << (*i)->limit()
+                  << " consumption=" << (*i)->consumption();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static int64_t SpareCapacity(const std::vector<MemTracker*>& trackers) {
+    int64_t result = std::numeric_limits<int64_t>::max();
+    for (std::vector<MemTracker*>::const_iterator i = trackers.begin();
+         i != trackers.end(); ++i) {
+      result = std::min(result, (*i)->SpareCapacity());
+    }
+    return result;
+  }
+
+ private:
+  void UpdatePeak(int64_t consumption) {
+    int64_t peak = peak_consumption_;
+    while (consumption > peak) {
+      int64_t old_peak =
+          __sync_val_compare_and_swap(&peak_consumption_, peak, consumption);
+      if (old_peak == peak) break;
+      peak = old_peak;
+    }
+  }
+
+  // Calls the GcFunctions of this tracker and its descendants
+  void RunGcFunctions();
+
+  int64_t limit_;  // in bytes, < 0 if there is no limit
+  int64_t consumption_;  // in bytes
+  int64_t peak_consumption_;  // in bytes
+  std::string label_;
+  MemTracker* parent_;
+
+  // This tracker and all of its ancestors
+  std::vector<MemTracker*> all_trackers_;
+  // The trackers in all_trackers_ that have a limit
+  std::vector<MemTracker*> limit_trackers_;
+
+  // Protects child_trackers_ and gc_functions_
+  mutable boost::mutex lock_;
+  std::list<MemTracker*> child_trackers_;
+  // Our entry in parent_->child_trackers_
+  std::list<MemTracker*>::iterator child_tracker_it_;
+  std::vector<GcFunction> gc_functions_;
+
+  // Only one thread runs GcMemory() on a tracker at a time
+  boost::mutex gc_lock_;
+
+  // Set for trackers created by GetQueryMemTracker()
+  bool is_query_tracker_;
+  TUniqueId query_id_;
+
+  // prohibit copies
+  MemTracker(const MemTracker&);
+};
+
+}
+
+#endif
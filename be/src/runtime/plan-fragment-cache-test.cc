@@ -0,0 +1,115 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "runtime/plan-fragment-cache.h"
+#include "util/cpu-info.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace std;
+
+namespace impala {
+
+TEST(PlanFragmentCacheTest, Fingerprint) {
+  TExecPlanFragmentParams params;
+  TPlanNode node;
+  node.node_id = 1;
+  node.node_type = TPlanNodeType::HDFS_SCAN_NODE;
+  TPlan plan;
+  plan.nodes.push_back(node);
+  params.fragment.__set_plan(plan);
+  TTupleDescriptor tuple_desc;
+  tuple_desc.id = 0;
+  tuple_desc.byteSize = 8;
+  params.desc_tbl.tupleDescriptors.push_back(tuple_desc);
+  uint64_t fingerprint = PlanFragmentCache::GetFingerprint(params);
+
+  // The parameters of the fragment instance are not part of the fingerprint
+  params.params.fragment_instance_id.lo = 1;
+  params.backend_num = 2;
+  EXPECT_EQ(PlanFragmentCache::GetFingerprint(params), fingerprint);
+
+  params.fragment.plan.nodes[0].node_id = 2;
+  uint64_t other_fingerprint = PlanFragmentCache::GetFingerprint(params);
+  EXPECT_NE(other_fingerprint, fingerprint);
+  params.desc_tbl.tupleDescriptors[0].byteSize = 16;
+  EXPECT_NE(PlanFragmentCache::GetFingerprint(params), other_fingerprint);
+}
+
+TEST(PlanFragmentCacheTest, SkipCodegen) {
+  PlanFragmentCache cache(10);
+  bool hit;
+  EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(cache.num_misses(), 1);
+
+  // Plans that jit functions never skip codegen
+  cache.RecordCodegenUse(1, true);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+    EXPECT_TRUE(hit);
+    cache.RecordCodegenUse(1, true);
+  }
+  EXPECT_EQ(cache.num_hits(), 10);
+
+  // Plans that don't skip it after a few fragments in a row
+  for (int i = 0; i < PlanFragmentCache::NUM_RUNS_TO_SKIP_CODEGEN; ++i) {
+    EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+    cache.RecordCodegenUse(1, false);
+  }
+  for (int i = 1; i < PlanFragmentCache::CODEGEN_RECHECK_INTERVAL; ++i) {
+    EXPECT_TRUE(cache.SkipCodegen(1, &hit));
+  }
+  // The plan is checked again, and keeps skipping codegen if nothing was jitted
+  EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+  cache.RecordCodegenUse(1, false);
+  EXPECT_TRUE(cache.SkipCodegen(1, &hit));
+
+  for (int i = 2; i < PlanFragmentCache::CODEGEN_RECHECK_INTERVAL; ++i) {
+    EXPECT_TRUE(cache.SkipCodegen(1, &hit));
+  }
+  EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+  // A check that jits functions makes the plan use codegen again
+  cache.RecordCodegenUse(1, true);
+  EXPECT_FALSE(cache.SkipCodegen(1, &hit));
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(PlanFragmentCacheTest, Evict) {
+  PlanFragmentCache cache(2);
+  bool hit;
+  cache.RecordCodegenUse(1, false);
+  cache.RecordCodegenUse(2, false);
+  EXPECT_EQ(cache.size(), 2);
+  // Plan 1 is now the most recently used one
+  cache.SkipCodegen(1, &hit);
+  EXPECT_TRUE(hit);
+  cache.RecordCodegenUse(3, false);
+  EXPECT_EQ(cache.size(), 2);
+  cache.SkipCodegen(2, &hit);
+  EXPECT_FALSE(hit);
+  cache.SkipCodegen(1, &hit);
+  EXPECT_TRUE(hit);
+  cache.SkipCodegen(3, &hit);
+  EXPECT_TRUE(hit);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
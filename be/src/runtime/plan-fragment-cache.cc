@@ -0,0 +1,93 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/plan-fragment-cache.h"
+
+#include <boost/thread/locks.hpp>
+
+#include "common/logging.h"
+#include "util/hash-util.h"
+#include "util/thrift-util.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Returns the hash of the compact serialization of 'obj', or 0 if it can't be
+// serialized.
+template <typename T>
+static uint32_t HashThrift(ThriftSerializer* serializer, const T& obj) {
+  uint8_t* buffer;
+  uint32_t len;
+  Status status = serializer->Serialize(const_cast<T*>(&obj), &len, &buffer);
+  if (!status.ok()) return 0;
+  return HashUtil::Hash(buffer, len, 0);
+}
+
+PlanFragmentCache::PlanFragmentCache(int capacity)
+  : capacity_(capacity),
+    num_hits_(0),
+    num_misses_(0) {
+  DCHECK_GT(capacity, 0);
+}
+
+uint64_t PlanFragmentCache::GetFingerprint(const TExecPlanFragmentParams& params) {
+  ThriftSerializer serializer(true);
+  uint64_t fragment_hash = HashThrift(&serializer, params.fragment);
+  uint64_t desc_tbl_hash = HashThrift(&serializer, params.desc_tbl);
+  return (fragment_hash << 32) | desc_tbl_hash;
+}
+
+bool PlanFragmentCache::SkipCodegen(uint64_t fingerprint, bool* hit) {
+  lock_guard<mutex> l(lock_);
+  PlanMap::iterator it = plan_map_.find(fingerprint);
+  *hit = it != plan_map_.end();
+  if (!*hit) {
+    ++num_misses_;
+    return false;
+  }
+  ++num_hits_;
+  plans_.splice(plans_.begin(), plans_, it->second);
+  PlanInfo* plan = &*it->second;
+  if (plan->num_runs_without_jit < NUM_RUNS_TO_SKIP_CODEGEN) return false;
+  if (++plan->num_skipped % CODEGEN_RECHECK_INTERVAL == 0) {
+    VLOG_QUERY << "Checking codegen use of plan " << fingerprint;
+    return false;
+  }
+  return true;
+}
+
+void PlanFragmentCache::RecordCodegenUse(uint64_t fingerprint, bool jitted) {
+  lock_guard<mutex> l(lock_);
+  PlanMap::iterator it = plan_map_.find(fingerprint);
+  if (it == plan_map_.end()) {
+    if (plan_map_.size() >= capacity_) {
+      plan_map_.erase(plans_.back().fingerprint);
+      plans_.pop_back();
+    }
+    plans_.push_front(PlanInfo(fingerprint));
+    it = plan_map_.insert(make_pair(fingerprint, plans_.begin())).first;
+  }
+  PlanInfo* plan = &*it->second;
+  if (jitted) {
+    plan->num_runs_without_jit = 0;
+    plan->num_skipped = 0;
+  } else {
+    ++plan->num_runs_without_jit;
+  }
+}
+
+}
@@ -0,0 +1,103 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_PLAN_FRAGMENT_CACHE_H
+#define IMPALA_RUNTIME_PLAN_FRAGMENT_CACHE_H
+
+#include <list>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace impala {
+
+class TExecPlanFragmentParams;
+
+// A process-wide LRU cache of what was learned from running the fragments of a plan,
+// by plan fingerprint.  Small queries, e.g. lookups by row key, are run over and over
+// with the same plans and only differ in their scan ranges.  Most of their startup
+// time goes into loading and optimizing the codegen module, even though their plans
+// have nothing to jit.  The cache remembers the plans whose fragments didn't jit any
+// function, and their later fragments skip codegen.
+// The descriptor table and exec node tree of a fragment are not cached: they keep
+// per-fragment state, like prepared exprs and the llvm types of the fragment's module.
+// Thread-safe.
+class PlanFragmentCache {
+ public:
+  // Number of fragments of a plan in a row that have to run without jitting any
+  // function before the plan skips codegen
+  static const int NUM_RUNS_TO_SKIP_CODEGEN = 2;
+
+  // One in this many fragments of a plan that skips codegen still uses it.  Whether a
+  // fragment jits functions can depend on its scan ranges (scanners are only jitted
+  // for the file formats they read), so a plan is checked again now and then.
+  static const int CODEGEN_RECHECK_INTERVAL = 64;
+
+  // 'capacity' is the maximum number of plans in the cache.
+  PlanFragmentCache(int capacity);
+
+  // Returns the fingerprint of the plan fragment and the descriptor table of
+  // 'params'.  The parameters of the fragment instance (scan ranges, destinations,
+  // etc.) are not part of it.
+  static uint64_t GetFingerprint(const TExecPlanFragmentParams& params);
+
+  // Returns true if the fragment of the plan with 'fingerprint' should skip codegen.
+  // Sets '*hit' to true if the plan is in the cache, and marks it as the most
+  // recently used one.
+  bool SkipCodegen(uint64_t fingerprint, bool* hit);
+
+  // Records whether a fragment of the plan with 'fingerprint' that used codegen and
+  // ran to completion jitted any function.  Adds the plan to the cache, evicting the
+  // least recently used one if it is full.
+  void RecordCodegenUse(uint64_t fingerprint, bool jitted);
+
+  int capacity() const { return capacity_; }
+
+  // Number of plans in the cache
+  int size() const { return plan_map_.size(); }
+
+  int64_t num_hits() const { return num_hits_; }
+  int64_t num_misses() const { return num_misses_; }
+
+ private:
+  struct PlanInfo {
+    uint64_t fingerprint;
+
+    // Number of the plan's last fragments that ran without jitting any function
+    int num_runs_without_jit;
+
+    // Number of fragments that skipped codegen since the plan was last checked
+    int num_skipped;
+
+    PlanInfo(uint64_t fingerprint)
+      : fingerprint(fingerprint), num_runs_without_jit(0), num_skipped(0) { }
+  };
+
+  // Plans, most recently used first
+  typedef std::list<PlanInfo> PlanList;
+  typedef boost::unordered_map<uint64_t, PlanList::iterator> PlanMap;
+
+  const int capacity_;
+
+  // Protects all members below
+  boost::mutex lock_;
+  PlanList plans_;
+  PlanMap plan_map_;
+  int64_t num_hits_;
+  int64_t num_misses_;
+};
+
+}
+
+#endif
@@ -32,12 +32,14 @@
 #include "runtime/descriptors.h"
 #include "runtime/data-stream-mgr.h"
 #include "runtime/row-batch.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/plan-fragment-cache.h"
 #include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/container-util.h"
 #include "util/parse-util.h"
 #include "util/mem-info.h"
+#include "util/stopwatch.h"
 #include "gen-cpp/ImpalaPlanService_types.h"
 
 DEFINE_bool(serialize_batch, false, "serialize and deserialize each returned row batch");
@@ -59,7 +61,9 @@ PlanFragmentExecutor::PlanFragmentExecutor(
     done_(false),
     prepared_(false),
     closed_(false),
-    has_thread_token_(false) {
+    has_thread_token_(false),
+    plan_fingerprint_(0),
+    record_codegen_use_(false) {
 }
 
 PlanFragmentExecutor::~PlanFragmentExecutor() {
@@ -76,27 +80,49 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
              << " instance_id=" << PrintId(params.fragment_instance_id);
   VLOG(2) << "params:\n" << ThriftDebugString(params);
 
+  MonotonicStopWatch prepare_watch;
+  prepare_watch.Start();
+
+  // Fragments of plans that don't jit anything skip loading and optimizing the
+  // codegen module
+  TQueryOptions query_options = request.query_options;
+  PlanFragmentCache* plan_cache = exec_env_->plan_fragment_cache();
+  bool plan_cache_hit = false;
+  bool codegen_skipped = false;
+  if (plan_cache != NULL && !query_options.disable_codegen) {
+    plan_fingerprint_ = PlanFragmentCache::GetFingerprint(request);
+    codegen_skipped = plan_cache->SkipCodegen(plan_fingerprint_, &plan_cache_hit);
+    if (codegen_skipped) {
+      query_options.disable_codegen = true;
+    } else {
+      record_codegen_use_ = true;
+    }
+  }
+
   runtime_state_.reset(
-      new RuntimeState(params.fragment_instance_id, request.query_options,
+      new RuntimeState(params.fragment_instance_id, query_options,
         request.query_globals.now_string, exec_env_));
 
   // Reserve one main thread from the pool
   runtime_state_->resource_pool()->AcquireThreadToken();
   has_thread_token_ = true;
 
+  prepare_timer_ = ADD_TIMER(profile(), "PrepareTime");
+  if (plan_cache != NULL) {
+    COUNTER_SET(ADD_COUNTER(profile(), "PlanCacheHits", TCounterType::UNIT),
+        plan_cache_hit ? 1L : 0L);
+    COUNTER_SET(ADD_COUNTER(profile(), "CodegenSkipped", TCounterType::UNIT),
+        codegen_skipped ? 1L : 0L);
+  }
+
   average_thread_tokens_ = profile()->AddSamplingCounter("AverageThreadTokens",
       bind<int64_t>(mem_fn(&ThreadResourceMgr::ResourcePool::num_threads), 
           runtime_state_->resource_pool()));
 
-  if (exec_env_->mem_limit() != NULL) {
-    // we have a global limit
-    runtime_state_->mem_limits()->push_back(exec_env_->mem_limit());
-  }
+  int64_t bytes_limit = -1;
   if (request.query_options.mem_limit > 0) {
     // we have a per-query limit
-    int64_t bytes_limit = request.query_options.mem_limit;
-    mem_limit_.reset(new MemLimit(bytes_limit));
-    runtime_state_->SetFragmentMemLimit(mem_limit_.get());
+    bytes_limit = request.query_options.mem_limit;
     if (bytes_limit > MemInfo::physical_mem()) {
       LOG(WARNING) << "Memory limit "
                    << PrettyPrinter::Print(bytes_limit, TCounterType::BYTES)
@@ -106,6 +132,7 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
     VLOG_QUERY << "Using query memory limit: "
                << PrettyPrinter::Print(bytes_limit, TCounterType::BYTES);
   }
+  runtime_state_->InitMemTrackers(query_id_, bytes_limit);
 
   // set up desc tbl
   DescriptorTbl* desc_tbl = NULL;
@@ -185,8 +212,9 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
   }
 
   row_batch_.reset(new RowBatch(plan_->row_desc(), runtime_state_->batch_size()));
-  row_batch_->tuple_data_pool()->set_limits(*runtime_state_->mem_limits());
+  row_batch_->tuple_data_pool()->set_limits(*runtime_state_->mem_trackers());
   VLOG(3) << "plan_root=\n" << plan_->DebugString();
+  COUNTER_SET(prepare_timer_, static_cast<int64_t>(prepare_watch.ElapsedTime()));
   prepared_ = true;
   return Status::OK;
 }
@@ -429,6 +457,17 @@ void PlanFragmentExecutor::ReleaseThreadToken() {
   }
 }
 
+void PlanFragmentExecutor::RecordCodegenUse() {
+  if (!record_codegen_use_ || runtime_state_->llvm_codegen() == NULL) return;
+  {
+    // Fragments that were cancelled or failed may not have jitted what they would have
+    lock_guard<mutex> l(status_lock_);
+    if (!done_ || !status_.ok()) return;
+  }
+  exec_env_->plan_fragment_cache()->RecordCodegenUse(plan_fingerprint_,
+      runtime_state_->llvm_codegen()->num_jitted_functions() > 0);
+}
+
 void PlanFragmentExecutor::Close() {
   if (closed_) return;
   row_batch_.reset(NULL);
@@ -439,6 +478,7 @@ void PlanFragmentExecutor::Close() {
       sink_->Close(runtime_state());
     }
     exec_env_->thread_mgr()->UnregisterPool(runtime_state_->resource_pool());
+    RecordCodegenUse();
   }
   closed_ = true;
 }
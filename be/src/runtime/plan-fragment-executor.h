@@ -86,7 +86,8 @@ class PlanFragmentExecutor {
   // This call won't block.
   // runtime_state() and row_desc() will not be valid until Prepare() is called.
   // If request.query_options.mem_limit > 0, it is used as an approximate limit on the
-  // number of bytes this query can consume at runtime.
+  // number of bytes all fragment instances of this query in this process can consume
+  // at runtime.
   // The query will be aborted (MEM_LIMIT_EXCEEDED) if it goes over that limit.
   Status Prepare(const TExecPlanFragmentParams& request);
 
@@ -132,7 +133,6 @@ class PlanFragmentExecutor {
   ExecEnv* exec_env_;  // not owned
   ExecNode* plan_;  // lives in runtime_state_->obj_pool()
   TUniqueId query_id_;
-  boost::scoped_ptr<MemLimit> mem_limit_;
 
   // profile reporting-related
   ReportStatusCallback report_status_cb_;
@@ -181,6 +181,14 @@ class PlanFragmentExecutor {
   // Number of rows returned by this fragment
   RuntimeProfile::Counter* rows_produced_counter_;
 
+  // Time spent in Prepare(), including setting up codegen
+  RuntimeProfile::Counter* prepare_timer_;
+
+  // Fingerprint of the plan in the exec env's PlanFragmentCache, and whether to
+  // record in it if this fragment jitted any function
+  uint64_t plan_fingerprint_;
+  bool record_codegen_use_;
+
   // Average number of thread tokens for the duration of the plan fragment execution.
   // Fragments that do a lot of cpu work (non-coordinator fragment) will have at
   // least 1 token.  Fragments that contain a hdfs scan node will have 1+ tokens
@@ -195,6 +203,10 @@ class PlanFragmentExecutor {
   // typedef for TPlanFragmentExecParams.per_node_scan_ranges
   typedef std::map<TPlanNodeId, std::vector<TScanRangeParams> > PerNodeScanRanges;
 
+  // Records in the exec env's PlanFragmentCache whether this fragment jitted any
+  // function, if it used codegen and ran to completion.
+  void RecordCodegenUse();
+
   // Main loop of profile reporting thread.
   // Exits when notified on done_cv_.
   // On exit, *no report is sent*, ie, this will not send the final report.
@@ -17,6 +17,7 @@
 #include <stdint.h>  // for intptr_t
 #include <snappy.h>
 
+#include "runtime/mem-tracker.h"
 #include "runtime/string-value.h"
 #include "runtime/tuple-row.h"
 #include "gen-cpp/Data_types.h"
@@ -35,6 +36,36 @@ RowBatch::~RowBatch() {
   }
 }
 
+void TupleDataBuffers::Add(string* buffer) {
+  buffers_.push_back(buffer);
+  total_bytes_ += buffer->size();
+  MemTracker::UpdateLimits(buffer->size(), &limits_);
+}
+
+void TupleDataBuffers::TransferTo(TupleDataBuffers* dest) {
+  dest->buffers_.insert(dest->buffers_.end(), buffers_.begin(), buffers_.end());
+  dest->total_bytes_ += total_bytes_;
+  MemTracker::UpdateLimits(-total_bytes_, &limits_);
+  MemTracker::UpdateLimits(total_bytes_, &dest->limits_);
+  buffers_.clear();
+  total_bytes_ = 0;
+}
+
+void TupleDataBuffers::Clear() {
+  for (int i = 0; i < buffers_.size(); ++i) {
+    delete buffers_[i];
+  }
+  buffers_.clear();
+  MemTracker::UpdateLimits(-total_bytes_, &limits_);
+  total_bytes_ = 0;
+}
+
+void TupleDataBuffers::Swap(TupleDataBuffers* other) {
+  DCHECK(limits_ == other->limits_);
+  std::swap(buffers_, other->buffers_);
+  std::swap(total_bytes_, other->total_bytes_);
+}
+
 int RowBatch::Serialize(TRowBatch* output_batch) {
   // why does Thrift not generate a Clear() function?
   output_batch->row_tuples.clear();
@@ -94,46 +125,43 @@ int RowBatch::Serialize(TRowBatch* output_batch) {
   return GetBatchSize(*output_batch) - output_batch->tuple_data.size() + size;
 }
 
-// TODO: we want our input_batch's tuple_data to come from our (not yet implemented)
-// global runtime memory segment; how do we get thrift to allocate it from there?
-// maybe change line (in Data_types.cc generated from Data.thrift)
-//              xfer += iprot->readString(this->tuple_data[_i9]);
-// to allocated string data in special mempool
-// (change via python script that runs over Data_types.cc)
-RowBatch::RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch)
+RowBatch::RowBatch(const RowDescriptor& row_desc, TRowBatch* input_batch)
   : has_in_flight_row_(false),
-    num_rows_(input_batch.num_rows),
+    num_rows_(input_batch->num_rows),
     capacity_(num_rows_),
-    num_tuples_per_row_(input_batch.row_tuples.size()),
+    num_tuples_per_row_(input_batch->row_tuples.size()),
     row_desc_(row_desc),
-    tuple_ptrs_(new Tuple*[num_rows_ * input_batch.row_tuples.size()]),
+    tuple_ptrs_(new Tuple*[num_rows_ * input_batch->row_tuples.size()]),
     tuple_data_pool_(new MemPool()) {
-  if (input_batch.is_compressed) {
+  tuple_ptrs_size_ = num_rows_ * num_tuples_per_row_ * sizeof(Tuple*);
+  char* data;
+  if (input_batch->is_compressed) {
     // Decompress tuple data into data pool
-    const char* compressed_data = input_batch.tuple_data.c_str();
-    size_t compressed_size = input_batch.tuple_data.size();
+    const char* compressed_data = input_batch->tuple_data.c_str();
+    size_t compressed_size = input_batch->tuple_data.size();
     size_t uncompressed_size;
     bool success = snappy::GetUncompressedLength(compressed_data, compressed_size,
                                                  &uncompressed_size);
     DCHECK(success) << "snappy::GetUncompressedLength failed";
-    char* data = reinterpret_cast<char*>(tuple_data_pool_->Allocate(uncompressed_size));
+    data = reinterpret_cast<char*>(tuple_data_pool_->Allocate(uncompressed_size));
     success = snappy::RawUncompress(compressed_data, compressed_size, data);
     DCHECK(success) << "snappy::RawUncompress failed";
   } else {
-    // Tuple data uncompressed, copy directly into data pool
-    uint8_t* data = tuple_data_pool_->Allocate(input_batch.tuple_data.size());
-    memcpy(data, input_batch.tuple_data.c_str(), input_batch.tuple_data.size());
+    // Take over the uncompressed tuple data and reference it in place
+    string* buffer = new string();
+    buffer->swap(input_batch->tuple_data);
+    tuple_data_buffers_.Add(buffer);
+    data = const_cast<char*>(buffer->data());
   }
 
   // convert input_batch.tuple_offsets into pointers
   int tuple_idx = 0;
-  for (vector<int32_t>::const_iterator offset = input_batch.tuple_offsets.begin();
-       offset != input_batch.tuple_offsets.end(); ++offset) {
+  for (vector<int32_t>::const_iterator offset = input_batch->tuple_offsets.begin();
+       offset != input_batch->tuple_offsets.end(); ++offset) {
     if (*offset == -1) {
       tuple_ptrs_[tuple_idx++] = NULL;
     } else {
-      tuple_ptrs_[tuple_idx++] =
-          reinterpret_cast<Tuple*>(tuple_data_pool_->GetDataPtr(*offset));
+      tuple_ptrs_[tuple_idx++] = reinterpret_cast<Tuple*>(data + *offset);
     }
   }
 
@@ -162,8 +190,7 @@ RowBatch::RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch)
       for (; slot != (*desc)->string_slots().end(); ++slot) {
         DCHECK_EQ((*slot)->type(), TYPE_STRING);
         StringValue* string_val = t->GetStringSlot((*slot)->tuple_offset());
-        string_val->ptr = reinterpret_cast<char*>(
-            tuple_data_pool_->GetDataPtr(reinterpret_cast<intptr_t>(string_val->ptr)));
+        string_val->ptr = data + reinterpret_cast<intptr_t>(string_val->ptr);
       }
     }
   }
@@ -184,6 +211,7 @@ void RowBatch::Swap(RowBatch* other) {
   // The destination row batch should be empty.  
   DCHECK(!has_in_flight_row_);
   DCHECK(io_buffers_.empty());
+  DCHECK(tuple_data_buffers_.empty());
   DCHECK_EQ(tuple_data_pool_->GetTotalChunkSizes(), 0);
 
   std::swap(has_in_flight_row_, other->has_in_flight_row_);
@@ -191,6 +219,7 @@ void RowBatch::Swap(RowBatch* other) {
   std::swap(capacity_, other->capacity_);
   std::swap(tuple_ptrs_, other->tuple_ptrs_);
   std::swap(io_buffers_, other->io_buffers_);
+  tuple_data_buffers_.Swap(&other->tuple_data_buffers_);
   tuple_data_pool_.swap(other->tuple_data_pool_);
 }
 
@@ -16,6 +16,7 @@
 #ifndef IMPALA_RUNTIME_ROW_BATCH_H
 #define IMPALA_RUNTIME_ROW_BATCH_H
 
+#include <string>
 #include <vector>
 #include <cstring>
 #include <boost/scoped_ptr.hpp>
@@ -27,11 +28,45 @@
 
 namespace impala {
 
+class MemTracker;
 class TRowBatch;
 class Tuple;
 class TupleRow;
 class TupleDescriptor;
 
+// Owns serialized tuple data that was taken over from TRowBatches and that rows
+// reference in place (see RowBatch(const RowDescriptor&, TRowBatch*)).  Like the data
+// of a MemPool, the buffers are counted against the mem trackers passed to set_limits()
+// and can be transferred to another TupleDataBuffers.
+class TupleDataBuffers {
+ public:
+  TupleDataBuffers() : total_bytes_(0) {}
+  ~TupleDataBuffers() { Clear(); }
+
+  // Takes ownership of 'buffer'.
+  void Add(std::string* buffer);
+
+  // Moves all buffers to 'dest', updating the mem trackers of both.
+  void TransferTo(TupleDataBuffers* dest);
+
+  // Frees all buffers.
+  void Clear();
+
+  void Swap(TupleDataBuffers* other);
+
+  void set_limits(const std::vector<MemTracker*>& limits) { limits_ = limits; }
+  bool empty() const { return buffers_.empty(); }
+  int64_t total_bytes() const { return total_bytes_; }
+
+ private:
+  std::vector<std::string*> buffers_;
+
+  // Total size of buffers_
+  int64_t total_bytes_;
+
+  std::vector<MemTracker*> limits_;
+};
+
 // A RowBatch encapsulates a batch of rows, each composed of a number of tuples.
 // The maximum number of rows is fixed at the time of construction, and the caller
 // can add rows up to that capacity.
@@ -43,6 +78,8 @@ class TupleDescriptor;
 //      the data is in an io buffer that may not be attached to this row batch.  The
 //      creator of that row batch has to make sure that the io buffer is not recycled
 //      until all batches that reference the memory have been consumed.
+//   4. Deserialized tuple data - a row batch created from an uncompressed TRowBatch
+//      takes over the TRowBatch's tuple_data and references it in place.
 // In order to minimize memory allocations, RowBatches and TRowBatches that have been
 // serialized and sent over the wire should be reused (this prevents compression_scratch_
 // from being needlessly reallocated).
@@ -63,12 +100,11 @@ class RowBatch {
     DCHECK_GT(capacity, 0);
   }
 
-  // Populate a row batch from input_batch by copying input_batch's
-  // tuple_data into the row batch's mempool and converting all offsets
-  // in the data back into pointers.
-  // TODO: figure out how to transfer the data from input_batch to this RowBatch
-  // (so that we don't need to make yet another copy)
-  RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch);
+  // Populate a row batch from input_batch and convert all offsets in the data back
+  // into pointers.  If input_batch's tuple_data is uncompressed, the row batch takes
+  // it over and converts the offsets in place; input_batch->tuple_data is left empty.
+  // Compressed tuple data is decompressed into the row batch's mempool.
+  RowBatch(const RowDescriptor& row_desc, TRowBatch* input_batch);
 
   // Releases all resources accumulated at this row batch.  This includes
   //  - tuple_ptrs
@@ -116,7 +152,8 @@ class RowBatch {
   // the memory in some way.
   bool AtResourceLimit() {
     return io_buffers_.size() > MAX_IO_BUFFERS || 
-           tuple_data_pool()->total_allocated_bytes() > MAX_MEM_POOL_SIZE;
+           tuple_data_pool()->total_allocated_bytes() +
+             tuple_data_buffers_.total_bytes() > MAX_MEM_POOL_SIZE;
   }
 
   int row_byte_size() {
@@ -142,12 +179,25 @@ class RowBatch {
       io_buffers_[i]->Return();
     }
     io_buffers_.clear();
+    tuple_data_buffers_.Clear();
   }
 
   MemPool* tuple_data_pool() {
     return tuple_data_pool_.get();
   }
 
+  TupleDataBuffers* tuple_data_buffers() {
+    return &tuple_data_buffers_;
+  }
+
+  // Transfers the tuple data, i.e. the data in the tuple pool and the deserialized
+  // tuple data, to 'pool' and 'buffers'.  Used by nodes that keep referencing the rows
+  // after the batch has been reset.  Io buffers are not transferred.
+  void TransferTupleData(MemPool* pool, TupleDataBuffers* buffers) {
+    pool->AcquireData(tuple_data_pool_.get(), false);
+    tuple_data_buffers_.TransferTo(buffers);
+  }
+
   void AddIoBuffer(DiskIoMgr::BufferDescriptor* buffer) {
     io_buffers_.push_back(buffer);
   }
@@ -157,12 +207,13 @@ class RowBatch {
   }
 
   // Transfer ownership of resources to dest.  This includes tuple data in mem
-  // pool and io buffers.
+  // pool, deserialized tuple data and io buffers.
   void TransferResourceOwnership(RowBatch* dest) {
     dest->tuple_data_pool_->AcquireData(tuple_data_pool_.get(), false);
     dest->io_buffers_.insert(dest->io_buffers_.begin(), 
         io_buffers_.begin(), io_buffers_.end());
     io_buffers_.clear();
+    tuple_data_buffers_.TransferTo(&dest->tuple_data_buffers_);
     // make sure we can't access our tuples after we gave up the pools holding the
     // tuple data
     Reset();
@@ -232,6 +283,10 @@ class RowBatch {
 
   std::vector<DiskIoMgr::BufferDescriptor*> io_buffers_;
 
+  // Serialized tuple data taken over from TRowBatches, which the rows reference in
+  // place.
+  TupleDataBuffers tuple_data_buffers_;
+
   // String to write compressed tuple data to in Serialize().
   // This is a string so we can swap() with the string in the TRowBatch we're serializing
   // to (we don't compress directly into the TRowBatch in case the compressed data is
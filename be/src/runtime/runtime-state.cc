@@ -17,6 +17,7 @@
 
 #include "common/logging.h"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/bind.hpp>
 
 #include "codegen/llvm-codegen.h"
 #include "common/object-pool.h"
@@ -24,6 +25,7 @@
 #include "exprs/expr.h"
 #include "runtime/descriptors.h"
 #include "runtime/disk-io-mgr.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/runtime-state.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/data-stream-recvr.h"
@@ -51,7 +53,6 @@ RuntimeState::RuntimeState(
     data_stream_recvrs_pool_(new ObjectPool()),
     unreported_error_idx_(0),
     profile_(obj_pool_.get(), "Fragment " + PrintId(fragment_instance_id)),
-    fragment_mem_limit_(NULL),
     is_cancelled_(false) {
   Status status = Init(fragment_instance_id, query_options, now, exec_env);
   DCHECK(status.ok());
@@ -61,8 +62,7 @@ RuntimeState::RuntimeState(const std::string& now)
   : obj_pool_(new ObjectPool()),
     data_stream_recvrs_pool_(new ObjectPool()),
     unreported_error_idx_(0),
-    profile_(obj_pool_.get(), "<unnamed>"),
-    fragment_mem_limit_(NULL) {
+    profile_(obj_pool_.get(), "<unnamed>") {
   query_options_.batch_size = DEFAULT_BATCH_SIZE;
   now_.reset(new TimestampValue(now.c_str(), now.size()));
 }
@@ -98,9 +98,14 @@ Status RuntimeState::Init(
     query_options_.num_scanner_threads = DiskIoMgr::default_parallel_scan_ranges();
   }
 
-  // Register with the thread mgr 
+  if (query_options_.query_priority < 1) {
+    query_options_.query_priority = 1;
+  }
+
+  // Register with the thread mgr, the query's priority is the weight of its pool
   if (exec_env != NULL) {
-    resource_pool_ = exec_env->thread_mgr()->RegisterPool();
+    resource_pool_ =
+        exec_env->thread_mgr()->RegisterPool(query_options_.query_priority);
     DCHECK(resource_pool_ != NULL);
   }
   
@@ -109,11 +114,24 @@ Status RuntimeState::Init(
   return Status::OK;
 }
 
+void RuntimeState::InitMemTrackers(const TUniqueId& query_id, int64_t query_bytes_limit) {
+  DCHECK(instance_mem_tracker_ == NULL);
+  MemTracker* process_tracker = exec_env_ != NULL ? exec_env_->mem_tracker() : NULL;
+  query_mem_tracker_ =
+      MemTracker::GetQueryMemTracker(query_id, query_bytes_limit, process_tracker);
+  instance_mem_tracker_.reset(new MemTracker(-1, profile_.name(),
+      query_mem_tracker_.get()));
+  mem_trackers_.push_back(instance_mem_tracker_.get());
+  profile_.AddDerivedCounter("PeakMemoryUsage", TCounterType::BYTES,
+      bind<int64_t>(&MemTracker::peak_consumption, instance_mem_tracker_.get()));
+}
+
 DataStreamRecvr* RuntimeState::CreateRecvr(
     const RowDescriptor& row_desc, PlanNodeId dest_node_id, int num_senders,
-    int buffer_size, RuntimeProfile* profile) {
+    int buffer_size, RuntimeProfile* profile, MemTracker* mem_tracker) {
   DataStreamRecvr* recvr = exec_env_->stream_mgr()->CreateRecvr(row_desc,
-      fragment_instance_id_, dest_node_id, num_senders, buffer_size, profile);
+      fragment_instance_id_, dest_node_id, num_senders, buffer_size, profile,
+      mem_tracker);
   lock_guard<mutex> l(data_stream_recvrs_lock_);
   data_stream_recvrs_pool_->Add(recvr);
   return recvr;
@@ -20,6 +20,7 @@
 #include "common/object-pool.h"
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <vector>
@@ -44,7 +45,7 @@ class ExecEnv;
 class Expr;
 class LlvmCodeGen;
 class TimestampValue;
-class MemLimit;
+class MemTracker;
 class DataStreamRecvr;
 
 // Counts how many rows an INSERT query has added to a particular partition
@@ -88,6 +89,8 @@ class RuntimeState {
   int max_errors() const { return query_options_.max_errors; }
   int max_io_buffers() const { return query_options_.max_io_buffers; }
   int num_scanner_threads() const { return query_options_.num_scanner_threads; }
+  int64_t hfile_min_timestamp() const { return query_options_.hfile_min_timestamp; }
+  int64_t hfile_max_timestamp() const { return query_options_.hfile_max_timestamp; }
   const TimestampValue* now() const { return now_.get(); }
   void set_now(const TimestampValue* now);
   const std::vector<std::string>& error_log() const { return error_log_; }
@@ -101,8 +104,11 @@ class RuntimeState {
   HBaseTableFactory* htable_factory() { return exec_env_->htable_factory(); }
   ImpalaInternalServiceClientCache* client_cache() { return exec_env_->client_cache(); }
   DiskIoMgr* io_mgr() { return exec_env_->disk_io_mgr(); }
-  std::vector<MemLimit*>* mem_limits() { return &mem_limits_; }
-  MemLimit* fragment_mem_limit() { return fragment_mem_limit_; }
+  // The trackers that MemPools and HashTables of this fragment instance are charged
+  // to; empty or instance_mem_tracker().
+  std::vector<MemTracker*>* mem_trackers() { return &mem_trackers_; }
+  MemTracker* instance_mem_tracker() { return instance_mem_tracker_.get(); }
+  MemTracker* query_mem_tracker() { return query_mem_tracker_.get(); }
   ThreadResourceMgr::ResourcePool* resource_pool() { return resource_pool_; }
 
   FileMoveMap* hdfs_files_to_move() { return &hdfs_files_to_move_; }
@@ -116,16 +122,16 @@ class RuntimeState {
 
   // Create and return a stream receiver for fragment_instance_id_
   // from the data stream manager. The receiver is added to data_stream_recvrs_pool_.
+  // Batches buffered by the receiver are counted against 'mem_tracker', if non-NULL.
   DataStreamRecvr* CreateRecvr(
       const RowDescriptor& row_desc, PlanNodeId dest_node_id, int num_senders,
-      int buffer_size, RuntimeProfile* profile);
+      int buffer_size, RuntimeProfile* profile, MemTracker* mem_tracker);
 
-  // Sets the fragment memory limit and adds it to mem_limits_
-  void SetFragmentMemLimit(MemLimit* limit) {
-    DCHECK(fragment_mem_limit_ == NULL);
-    fragment_mem_limit_ = limit;
-    mem_limits_.push_back(limit);
-  }
+  // Creates the memory tracker of this fragment instance, as a child of the tracker of
+  // query 'query_id' (which is created if this is the first fragment instance of the
+  // query in this process), which is a child of the process tracker.
+  // query_bytes_limit < 0 means no limit.  Adds the instance tracker to mem_trackers_.
+  void InitMemTrackers(const TUniqueId& query_id, int64_t query_bytes_limit);
 
   // Appends error to the error_log_ if there is space
   void LogError(const std::string& error);
@@ -162,6 +168,13 @@ class RuntimeState {
   static const int DEFAULT_BATCH_SIZE = 1024;
 
   DescriptorTbl* desc_tbl_;
+
+  // Memory trackers of the query and of this fragment instance.  Declared before
+  // obj_pool_ since the exec nodes' trackers and MemPools, which live in obj_pool_,
+  // reference them in their d'tors.
+  boost::shared_ptr<MemTracker> query_mem_tracker_;
+  boost::scoped_ptr<MemTracker> instance_mem_tracker_;
+
   boost::scoped_ptr<ObjectPool> obj_pool_;
 
   // Protects data_stream_recvrs_pool_
@@ -211,11 +224,8 @@ class RuntimeState {
 
   RuntimeProfile profile_;
 
-  // all mem limits that apply to this query
-  std::vector<MemLimit*> mem_limits_;
-
-  // Fragment memory limit.  Also contained in mem_limits_
-  MemLimit* fragment_mem_limit_;
+  // instance_mem_tracker_, if set
+  std::vector<MemTracker*> mem_trackers_;
 
   // if true, execution should stop with a CANCELLED status
   bool is_cancelled_;
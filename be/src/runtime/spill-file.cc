@@ -0,0 +1,210 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/spill-file.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <gflags/gflags.h>
+
+#include "runtime/disk-io-mgr.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/tuple-row.h"
+#include "util/debug-util.h"
+#include "util/disk-info.h"
+#include "util/thrift-util.h"
+
+#include "gen-cpp/Data_types.h"
+
+DEFINE_string(scratch_dirs, "/tmp", "Comma-separated list of local directories that "
+    "exec nodes write intermediate results to when they exceed their memory limit.");
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Used to generate unique file names and to round-robin files over the scratch dirs.
+static int64_t next_spill_file_id = 0;
+
+SpillFile::SpillFile(RuntimeState* state, const RowDescriptor& row_desc,
+    RuntimeProfile::Counter* bytes_written_counter)
+  : state_(state),
+    row_desc_(row_desc),
+    bytes_written_counter_(bytes_written_counter),
+    disk_id_(0),
+    file_(NULL),
+    write_done_(false),
+    next_batch_idx_(0),
+    num_rows_(0),
+    bytes_written_(0),
+    uncompressed_bytes_(0),
+    thrift_batch_(new TRowBatch()),
+    serializer_(new ThriftSerializer(true)) {
+}
+
+SpillFile::~SpillFile() {
+  Close();
+}
+
+Status SpillFile::Open() {
+  DCHECK(path_.empty());
+  vector<string> tokens;
+  vector<string> dirs;
+  split(tokens, FLAGS_scratch_dirs, is_any_of(","), token_compress_on);
+  for (int i = 0; i < tokens.size(); ++i) {
+    trim(tokens[i]);
+    if (!tokens[i].empty()) dirs.push_back(tokens[i]);
+  }
+  if (dirs.empty()) return Status("No scratch directories specified in --scratch_dirs");
+
+  int64_t file_id = __sync_fetch_and_add(&next_spill_file_id, 1);
+  const string& dir = dirs[file_id % dirs.size()];
+  stringstream path;
+  path << dir << "/impala-scratch-" << PrintId(state_->fragment_instance_id())
+       << "-" << file_id;
+  file_ = fopen(path.str().c_str(), "w");
+  if (file_ == NULL) {
+    stringstream ss;
+    ss << "Could not create scratch file " << path.str() << ": " << strerror(errno);
+    return Status(ss.str());
+  }
+  path_ = path.str();
+
+  // If the scratch dir is not on a disk we know about, just spread the files over
+  // the disk queues.
+  disk_id_ = DiskInfo::disk_id(path_.c_str());
+  if (disk_id_ < 0) disk_id_ = file_id;
+  disk_id_ %= state_->io_mgr()->num_disks();
+  VLOG_FILE << "Created scratch file " << path_;
+  return Status::OK;
+}
+
+Status SpillFile::AddBatch(RowBatch* batch) {
+  DCHECK(!write_done_);
+  if (batch->num_rows() == 0) return Status::OK;
+  if (file_ == NULL) RETURN_IF_ERROR(Open());
+
+  uncompressed_bytes_ += batch->Serialize(thrift_batch_.get());
+  uint32_t len = 0;
+  uint8_t* buffer = NULL;
+  RETURN_IF_ERROR(serializer_->Serialize(thrift_batch_.get(), &len, &buffer));
+  if (fwrite(buffer, 1, len, file_) != len) {
+    stringstream ss;
+    ss << "Could not write to scratch file " << path_ << ": " << strerror(errno);
+    return Status(ss.str());
+  }
+
+  batches_.push_back(make_pair(bytes_written_, static_cast<int64_t>(len)));
+  bytes_written_ += len;
+  num_rows_ += batch->num_rows();
+  if (bytes_written_counter_ != NULL) COUNTER_UPDATE(bytes_written_counter_, len);
+  return Status::OK;
+}
+
+Status SpillFile::AddRow(RowBatch* batch, TupleRow* row) {
+  if (batch->IsFull() || batch->AtResourceLimit()) {
+    RETURN_IF_ERROR(AddBatch(batch));
+    batch->Reset();
+  }
+  int row_idx = batch->AddRow();
+  row->DeepCopy(batch->GetRow(row_idx), batch->row_desc().tuple_descriptors(),
+      batch->tuple_data_pool(), false);
+  batch->CommitLastRow();
+  return Status::OK;
+}
+
+Status SpillFile::PrepareForRead() {
+  if (file_ != NULL) {
+    int ret = fclose(file_);
+    file_ = NULL;
+    if (ret != 0) {
+      stringstream ss;
+      ss << "Could not flush scratch file " << path_ << ": " << strerror(errno);
+      return Status(ss.str());
+    }
+  }
+  write_done_ = true;
+  next_batch_idx_ = 0;
+  return Status::OK;
+}
+
+Status SpillFile::GetNext(RowBatch** batch) {
+  DCHECK(write_done_);
+  *batch = NULL;
+  if (next_batch_idx_ == batches_.size()) return Status::OK;
+
+  int64_t offset = batches_[next_batch_idx_].first;
+  int64_t len = batches_[next_batch_idx_].second;
+  read_buffer_.resize(len);
+
+  // Each io mgr read returns at most one io buffer worth of data.
+  DiskIoMgr* io_mgr = state_->io_mgr();
+  int64_t bytes_read = 0;
+  while (bytes_read < len) {
+    DiskIoMgr::ScanRange range;
+    int64_t read_len =
+        min(len - bytes_read, static_cast<int64_t>(io_mgr->read_buffer_size()));
+    range.Reset(path_.c_str(), read_len, offset + bytes_read, disk_id_);
+
+    DiskIoMgr::BufferDescriptor* buffer_desc = NULL;
+    Status status = io_mgr->Read(NULL, &range, &buffer_desc);
+    if (!status.ok()) {
+      if (buffer_desc != NULL) buffer_desc->Return();
+      return status;
+    }
+    int64_t buffer_len = buffer_desc->len();
+    if (buffer_len > 0) {
+      memcpy(&read_buffer_[bytes_read], buffer_desc->buffer(), buffer_len);
+    }
+    buffer_desc->Return();
+    if (buffer_len == 0) {
+      stringstream ss;
+      ss << "Unexpected end of scratch file " << path_ << " at offset "
+         << offset + bytes_read;
+      return Status(ss.str());
+    }
+    bytes_read += buffer_len;
+  }
+
+  uint32_t deserialized_len = len;
+  RETURN_IF_ERROR(DeserializeThriftMsg(
+      &read_buffer_[0], &deserialized_len, true, thrift_batch_.get()));
+  *batch = new RowBatch(row_desc_, thrift_batch_.get());
+  ++next_batch_idx_;
+  return Status::OK;
+}
+
+void SpillFile::Close() {
+  if (file_ != NULL) {
+    fclose(file_);
+    file_ = NULL;
+  }
+  if (!path_.empty()) {
+    if (unlink(path_.c_str()) != 0) {
+      LOG(WARNING) << "Could not remove scratch file " << path_ << ": "
+                   << strerror(errno);
+    }
+    path_.clear();
+  }
+  write_done_ = true;
+  batches_.clear();
+  next_batch_idx_ = 0;
+}
+
+}
@@ -0,0 +1,129 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_SPILL_FILE_H
+#define IMPALA_RUNTIME_SPILL_FILE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/status.h"
+#include "runtime/descriptors.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+class RowBatch;
+class RuntimeState;
+class ThriftSerializer;
+class TRowBatch;
+class TupleRow;
+
+// A SpillFile is a local scratch file that exec nodes write rows to when their
+// in-memory state does not fit in the memory limit anymore.  Rows are appended one
+// RowBatch at a time and are read back as RowBatches, in the order they were appended.
+// Batches are stored as serialized TRowBatches (see RowBatch::Serialize()), i.e. the
+// tuple data is compressed the same way it is for the data stream.
+//
+// The DiskIoMgr does not support writes, so appends go directly to the local file
+// system.  Reads are issued through the DiskIoMgr so they are scheduled on the
+// scratch disk's queue along with all other io to that disk.
+//
+// The file is created in one of the --scratch_dirs on the first append and deleted
+// in Close() (or the d'tor).
+// This class is not thread safe.
+class SpillFile {
+ public:
+  // Rows appended to the file are laid out according to 'row_desc'.
+  // If non-NULL, 'bytes_written_counter' is incremented with the number of bytes
+  // written to disk.
+  SpillFile(RuntimeState* state, const RowDescriptor& row_desc,
+      RuntimeProfile::Counter* bytes_written_counter = NULL);
+
+  ~SpillFile();
+
+  // Appends all rows in 'batch' to the file.  Does not Reset() 'batch'.
+  // Must not be called after PrepareForRead().
+  Status AddBatch(RowBatch* batch);
+
+  // Deep copies 'row' into 'batch', which is used to stage rows for this file.  If
+  // 'batch' is full, it is appended to the file and Reset() first.  The caller
+  // appends the last, partially filled batch with AddBatch().
+  Status AddRow(RowBatch* batch, TupleRow* row);
+
+  // Finishes writing the file and positions the read cursor at the first batch.
+  // Can be called again to read the file another time.
+  Status PrepareForRead();
+
+  // Reads the next batch from the file.  *batch is set to a newly allocated RowBatch
+  // owned by the caller, or to NULL if all batches have been returned.
+  Status GetNext(RowBatch** batch);
+
+  // Deletes the file.  The object can't be used after this.  Idempotent.
+  void Close();
+
+  int64_t num_rows() const { return num_rows_; }
+  int num_batches() const { return batches_.size(); }
+
+  // Number of bytes that were written to disk
+  int64_t bytes_written() const { return bytes_written_; }
+
+  // Sum of the uncompressed sizes of all appended batches.  This is an estimate of
+  // the memory needed to hold all rows of the file.
+  int64_t uncompressed_bytes() const { return uncompressed_bytes_; }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  // Creates the file in one of the scratch dirs.
+  Status Open();
+
+  RuntimeState* state_;
+  RowDescriptor row_desc_;
+  RuntimeProfile::Counter* bytes_written_counter_;
+
+  // Path of the file.  Empty until the first batch is appended.
+  std::string path_;
+
+  // Io mgr disk queue that reads for this file are issued to
+  int disk_id_;
+
+  // Handle used for appending.  Closed in PrepareForRead().
+  FILE* file_;
+
+  // True once PrepareForRead() has been called
+  bool write_done_;
+
+  // File offset and length of each appended batch.
+  std::vector<std::pair<int64_t, int64_t> > batches_;
+
+  // Index into batches_ of the batch returned by the next GetNext() call
+  int next_batch_idx_;
+
+  int64_t num_rows_;
+  int64_t bytes_written_;
+  int64_t uncompressed_bytes_;
+
+  // Reused across appends/reads to avoid reallocating the serialization buffers
+  boost::scoped_ptr<TRowBatch> thrift_batch_;
+  boost::scoped_ptr<ThriftSerializer> serializer_;
+  std::vector<uint8_t> read_buffer_;
+};
+
+}
+
+#endif
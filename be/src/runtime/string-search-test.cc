@@ -0,0 +1,122 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string>
+#include <gtest/gtest.h>
+
+#include "runtime/string-search.h"
+#include "util/cpu-info.h"
+
+using namespace std;
+
+namespace impala {
+
+// Reference implementation
+static int NaiveSearch(const string& str, const string& pattern, bool case_insensitive) {
+  if (pattern.empty()) return -1;
+  for (int i = 0; i + pattern.size() <= str.size(); ++i) {
+    int j = 0;
+    for (; j < pattern.size(); ++j) {
+      char c1 = str[i + j];
+      char c2 = pattern[j];
+      if (case_insensitive) {
+        c1 = tolower(c1);
+        c2 = tolower(c2);
+      }
+      if (c1 != c2) break;
+    }
+    if (j == pattern.size()) return i;
+  }
+  return -1;
+}
+
+static int Search(const string& str, const string& pattern, bool case_insensitive) {
+  StringValue pattern_sv(const_cast<char*>(pattern.data()), pattern.size());
+  StringValue str_sv(const_cast<char*>(str.data()), str.size());
+  StringSearch search(&pattern_sv, case_insensitive);
+  return search.Search(&str_sv);
+}
+
+// Runs 'test' with SSE4.2 if the cpu supports it and again without it
+static void TestWithAndWithoutSse(void (*test)()) {
+  bool sse_supported = CpuInfo::IsSupported(CpuInfo::SSE4_2);
+  if (sse_supported) {
+    SCOPED_TRACE("SSE4.2");
+    test();
+    CpuInfo::EnableFeature(CpuInfo::SSE4_2, false);
+  }
+  {
+    SCOPED_TRACE("No SSE4.2");
+    test();
+  }
+  CpuInfo::EnableFeature(CpuInfo::SSE4_2, sse_supported);
+}
+
+static void TestBasic() {
+  EXPECT_EQ(Search("abcdef", "cd", false), 2);
+  EXPECT_EQ(Search("abcdef", "abcdef", false), 0);
+  EXPECT_EQ(Search("abcdef", "abcdefg", false), -1);
+  EXPECT_EQ(Search("abcdef", "", false), -1);
+  EXPECT_EQ(Search("", "a", false), -1);
+  EXPECT_EQ(Search("abcdef", "f", false), 5);
+  EXPECT_EQ(Search("abcdef", "CD", false), -1);
+  EXPECT_EQ(Search("abcdef", "CD", true), 2);
+  EXPECT_EQ(Search("ABCDEF", "cd", true), 2);
+  EXPECT_EQ(Search("ABCDEF", "F", true), 5);
+
+  // Matches that cross 16 byte boundaries, and patterns longer than 16 bytes
+  string str = "0123456789abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  EXPECT_EQ(Search(str, "def", false), 13);
+  EXPECT_EQ(Search(str, "nopqrstuvwxyz0123456", false), 23);
+  EXPECT_EQ(Search(str, "NOPQRSTUVWXYZ0123456", true), 23);
+  EXPECT_EQ(Search(str, "WXYZ", false), 68);
+  EXPECT_EQ(Search(str, "wxyz", true), 32);
+  EXPECT_EQ(Search(str, "XYZ!", false), -1);
+  // The first 16 bytes match often, the rest doesn't
+  EXPECT_EQ(Search(string(100, 'a'), string(16, 'a') + "b", false), -1);
+  EXPECT_EQ(Search(string(100, 'a') + "b", string(16, 'a') + "b", false), 84);
+}
+
+static void TestRandom() {
+  srand(0);
+  for (int i = 0; i < 10000; ++i) {
+    // Small alphabets to get many partial matches
+    string str;
+    int str_len = rand() % 80;
+    for (int j = 0; j < str_len; ++j) str += "aAbB"[rand() % 4];
+    string pattern;
+    int pattern_len = rand() % 20 + 1;
+    for (int j = 0; j < pattern_len; ++j) pattern += "aAbB"[rand() % 4];
+    bool case_insensitive = rand() % 2;
+    EXPECT_EQ(Search(str, pattern, case_insensitive),
+        NaiveSearch(str, pattern, case_insensitive)) << str << " " << pattern;
+  }
+}
+
+TEST(StringSearchTest, Basic) {
+  TestWithAndWithoutSse(TestBasic);
+}
+
+TEST(StringSearchTest, Random) {
+  TestWithAndWithoutSse(TestRandom);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -16,17 +16,22 @@
 #ifndef IMPALA_RUNTIME_STRING_SEARCH_H
 #define IMPALA_RUNTIME_STRING_SEARCH_H
 
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <cstring>
 #include <boost/cstdint.hpp>
 
 #include "common/logging.h"
 #include "runtime/string-value.h"
+#include "util/cpu-info.h"
+#include "util/sse-util.h"
 
 namespace impala {
 
-// TODO: This can be sped up with SIDD_CMP_EQUAL_ORDERED or at the very least rewritten
-// from published algorithms.
+// Substring search.  With SSE4.2, candidate positions are found 16 bytes at a time
+// with SIDD_CMP_EQUAL_ORDERED (see SearchSSE()).  Otherwise, and for the last < 16
+// bytes of a string, the search uses the algorithm below.
 //
 // This is taken from the python search string function doing string search (substring)
 // using an optimized boyer-moore-horspool algorithm.
@@ -83,25 +88,35 @@ namespace impala {
 class StringSearch {
 
  public:
-  StringSearch() : pattern_(NULL), mask_(0) {}
+  StringSearch() : pattern_(NULL), case_insensitive_(false), mask_(0), skip_(0) {}
+
+  // Initialize/Precompute a StringSearch object from the pattern.  If
+  // 'case_insensitive', ASCII letters match regardless of their case.
+  StringSearch(const StringValue* pattern, bool case_insensitive = false)
+    : pattern_(pattern), case_insensitive_(case_insensitive), mask_(0), skip_(0) {
+    if (case_insensitive_) {
+      lower_pattern_.resize(pattern_->len);
+      for (int i = 0; i < pattern_->len; ++i) {
+        lower_pattern_[i] = ToLower(pattern_->ptr[i]);
+      }
+    }
 
-  // Initialize/Precompute a StringSearch object from the pattern
-  StringSearch(const StringValue* pattern) : pattern_(pattern), mask_(0), skip_(0) {
     // Special cases
     if (pattern_->len <= 1) {
       return;
     }
 
     // Build compressed lookup table
+    const char* p = pattern_ptr();
     int mlast = pattern_->len - 1;
     skip_ = mlast - 1;
 
     for (int i = 0; i < mlast; ++i) {
-      BloomAdd(pattern_->ptr[i]);
-      if (pattern_->ptr[i] == pattern_->ptr[mlast])
+      BloomAdd(p[i]);
+      if (p[i] == p[mlast])
         skip_ = mlast - i - 1;
     }
-    BloomAdd(pattern_->ptr[mlast]);
+    BloomAdd(p[mlast]);
   }
   
   // Search for this pattern in str.  
@@ -112,18 +127,109 @@ class StringSearch {
     if (!str || !pattern_ || pattern_->len == 0) {
       return -1;
     }
-    
+    if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
+      return case_insensitive_ ? SearchSSE<true>(str) : SearchSSE<false>(str);
+    }
+    return case_insensitive_ ? SearchHorspool<true>(str) : SearchHorspool<false>(str);
+  }
+
+ private:
+  static const int BLOOM_WIDTH = 64;
+
+  void BloomAdd(char c) {
+    mask_ |= (1UL << (c & (BLOOM_WIDTH - 1)));
+  } 
+
+  bool BloomQuery(char c) const {
+    return mask_ & (1UL << (c & (BLOOM_WIDTH - 1)));
+  }
+
+  static char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+  }
+
+  // Lower cases the ASCII letters in 'chunk'
+  static __m128i ToLower(__m128i chunk) {
+    __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('A' - 1)),
+        _mm_cmplt_epi8(chunk, _mm_set1_epi8('Z' + 1)));
+    return _mm_add_epi8(chunk, _mm_and_si128(is_upper, _mm_set1_epi8('a' - 'A')));
+  }
+
+  template <bool CASE_INSENSITIVE>
+  static char Normalize(char c) { return CASE_INSENSITIVE ? ToLower(c) : c; }
+
+  // The pattern to compare against, lower cased if case_insensitive_
+  const char* pattern_ptr() const {
+    return case_insensitive_ ? lower_pattern_.data() : pattern_->ptr;
+  }
+
+  // Returns true if the pattern occurs at 's'
+  template <bool CASE_INSENSITIVE>
+  bool MatchesAt(const char* s) const {
+    const char* p = pattern_ptr();
+    if (!CASE_INSENSITIVE) return memcmp(s, p, pattern_->len) == 0;
+    for (int j = 0; j < pattern_->len; ++j) {
+      if (ToLower(s[j]) != p[j]) return false;
+    }
+    return true;
+  }
+
+  // Finds candidate positions 16 bytes at a time with PCMPESTRI, which compares the
+  // first (up to) 16 bytes of the pattern against every offset of the 16 bytes of
+  // 'str' in one instruction, and reports the first offset where they match, which
+  // includes a prefix of the pattern that matches at the end of the 16 bytes.
+  // Candidates are verified against the whole pattern.  The last < 16 bytes are
+  // searched with SearchHorspool().
+  template <bool CASE_INSENSITIVE>
+  int SearchSSE(const StringValue* str) const {
+    int n = str->len;
+    int m = pattern_->len;
+    const char* s = str->ptr;
+    int needle_len = std::min(m, SSEUtil::CHARS_PER_128_BIT_REGISTER);
+    char needle_buf[SSEUtil::CHARS_PER_128_BIT_REGISTER];
+    memcpy(needle_buf, pattern_ptr(), needle_len);
+    __m128i needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needle_buf));
+
+    int i = 0;
+    while (i + SSEUtil::CHARS_PER_128_BIT_REGISTER <= n) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+      if (CASE_INSENSITIVE) chunk = ToLower(chunk);
+      int idx = _mm_cmpestri(needle, needle_len,
+          chunk, SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRSTR_MODE);
+      if (idx == SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+        i += SSEUtil::CHARS_PER_128_BIT_REGISTER;
+        continue;
+      }
+      // Candidates only get later, so if the pattern doesn't fit here it never will
+      if (i + idx + m > n) return -1;
+      if (MatchesAt<CASE_INSENSITIVE>(s + i + idx)) return i + idx;
+      i += idx + 1;
+    }
+    if (n - i < m) return -1;
+    StringValue tail(const_cast<char*>(s + i), n - i);
+    int result = SearchHorspool<CASE_INSENSITIVE>(&tail);
+    return result == -1 ? -1 : i + result;
+  }
+
+  template <bool CASE_INSENSITIVE>
+  int SearchHorspool(const StringValue* str) const {
     int mlast = pattern_->len - 1;
     int w = str->len - pattern_->len;
     int n = str->len;
     int m = pattern_->len;
     const char* s = str->ptr;
-    const char* p = pattern_->ptr;
+    const char* p = pattern_ptr();
 
     // Special case if pattern->len == 1
     if (m == 1) {
-      const char* result = reinterpret_cast<const char*>(memchr(s, p[0], n));
-      if (result != NULL) return result - s;
+      if (!CASE_INSENSITIVE) {
+        const char* result = reinterpret_cast<const char*>(memchr(s, p[0], n));
+        if (result != NULL) return result - s;
+        return -1;
+      }
+      for (int i = 0; i < n; ++i) {
+        if (ToLower(s[i]) == p[0]) return i;
+      }
       return -1;
     }
 
@@ -131,40 +237,33 @@ class StringSearch {
     int j;
     for (int i = 0; i <= w; i++) {
       // note: using mlast in the skip path slows things down on x86 
-      if (s[i+m-1] == p[m-1]) {
+      if (Normalize<CASE_INSENSITIVE>(s[i+m-1]) == p[m-1]) {
         // candidate match 
         for (j = 0; j < mlast; j++)
-          if (s[i+j] != p[j]) break;
+          if (Normalize<CASE_INSENSITIVE>(s[i+j]) != p[j]) break;
         if (j == mlast) {
           return i;
         }
-        // miss: check if next character is part of pattern 
-        if (!BloomQuery(s[i+m]))
+        // miss: check if next character is part of pattern.  s[i+m] is past the
+        // end of str if i == w.
+        if (i == w || !BloomQuery(Normalize<CASE_INSENSITIVE>(s[i+m])))
           i = i + m;
         else
           i = i + skip_;
       } else {
         // skip: check if next character is part of pattern 
-        if (!BloomQuery(s[i+m])) {
+        if (i == w || !BloomQuery(Normalize<CASE_INSENSITIVE>(s[i+m]))) {
           i = i + m;
         }
       }
     }
     return -1;
   }
-
- private:
-  static const int BLOOM_WIDTH = 64;
-
-  void BloomAdd(char c) {
-    mask_ |= (1UL << (c & (BLOOM_WIDTH - 1)));
-  } 
-
-  bool BloomQuery(char c) const {
-    return mask_ & (1UL << (c & (BLOOM_WIDTH - 1)));
-  }
   
   const StringValue* pattern_;
+  bool case_insensitive_;
+  // Lower cased copy of the pattern if case_insensitive_
+  std::string lower_pattern_;
   int64_t mask_;
   int64_t skip_;
 };
@@ -13,7 +13,9 @@
 // limitations under the License.
 
 #include <string>
+#include <unistd.h>
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include <gtest/gtest.h>
 
 #include "runtime/thread-resource-mgr.h"
@@ -86,6 +88,213 @@ TEST(ThreadResourceMgr, BasicTest) {
   EXPECT_EQ(counter2.counter(), 1);
 }
 
+TEST(ThreadResourceMgr, WeightedQuotas) {
+  ThreadResourceMgr mgr(12);
+  NotifiedCounter counter1;
+
+  ThreadResourceMgr::ResourcePool* c1 = mgr.RegisterPool(1);
+  c1->SetThreadAvailableCb(bind<void>(mem_fn(&NotifiedCounter::Notify), &counter1, _1));
+  EXPECT_EQ(c1->quota(), 12);
+  for (int i = 0; i < 12; ++i) {
+    EXPECT_TRUE(c1->TryAcquireThreadToken());
+  }
+  EXPECT_FALSE(c1->TryAcquireThreadToken());
+
+  // A pool with twice the weight gets twice the share
+  ThreadResourceMgr::ResourcePool* c2 = mgr.RegisterPool(2);
+  EXPECT_EQ(c1->quota(), 4);
+  EXPECT_EQ(c2->quota(), 8);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(c2->TryAcquireThreadToken());
+  }
+  EXPECT_FALSE(c2->TryAcquireThreadToken());
+
+  // c1 is over its quota until it has released 8 of its threads
+  for (int i = 0; i < 8; ++i) {
+    c1->ReleaseThreadToken(false);
+  }
+  EXPECT_EQ(counter1.counter(), 0);
+  EXPECT_FALSE(c1->TryAcquireThreadToken());
+  for (int i = 0; i < 8; ++i) {
+    c2->ReleaseThreadToken(false);
+  }
+
+  // c1 gets the threads back when c2 is gone
+  mgr.UnregisterPool(c2);
+  EXPECT_EQ(c1->quota(), 12);
+  EXPECT_EQ(counter1.counter(), 1);
+  for (int i = 0; i < 4; ++i) {
+    c1->ReleaseThreadToken(false);
+  }
+  mgr.UnregisterPool(c1);
+}
+
+TEST(ThreadResourceMgr, SubPools) {
+  ThreadResourceMgr mgr(10);
+  NotifiedCounter scan_counter, build_counter;
+
+  ThreadResourceMgr::ResourcePool* query = mgr.RegisterPool();
+  query->AcquireThreadToken();
+  ThreadResourceMgr::ResourcePool* scan = mgr.RegisterPool(4, query);
+  scan->SetThreadAvailableCb(
+      bind<void>(mem_fn(&NotifiedCounter::Notify), &scan_counter, _1));
+  EXPECT_EQ(scan->parent(), query);
+  EXPECT_EQ(scan->quota(), 10);
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_TRUE(scan->TryAcquireThreadToken());
+  }
+  // The tokens of the sub pool count towards its parent
+  EXPECT_EQ(query->num_threads(), 10);
+  EXPECT_EQ(query->num_required_threads(), 1);
+  EXPECT_EQ(query->num_optional_threads(), 9);
+  EXPECT_FALSE(query->TryAcquireThreadToken());
+
+  // The second sub pool gets its share of the query's quota even though the scanners
+  // use all of it
+  ThreadResourceMgr::ResourcePool* build = mgr.RegisterPool(1, query);
+  build->SetThreadAvailableCb(
+      bind<void>(mem_fn(&NotifiedCounter::Notify), &build_counter, _1));
+  EXPECT_EQ(scan->quota(), 8);
+  EXPECT_EQ(build->quota(), 2);
+  EXPECT_FALSE(scan->TryAcquireThreadToken());
+  EXPECT_TRUE(build->TryAcquireThreadToken());
+  EXPECT_EQ(query->num_threads(), 11);
+
+  // Releasing a token only notifies the pool it came from
+  build->ReleaseThreadToken(false);
+  EXPECT_EQ(build_counter.counter(), 1);
+  EXPECT_EQ(scan_counter.counter(), 0);
+  scan->ReleaseThreadToken(false);
+  EXPECT_EQ(scan_counter.counter(), 0);
+  EXPECT_EQ(build_counter.counter(), 1);
+
+  // The scanners get the build side's share back
+  mgr.UnregisterPool(build);
+  EXPECT_EQ(scan->quota(), 10);
+  EXPECT_EQ(scan_counter.counter(), 1);
+  EXPECT_TRUE(scan->TryAcquireThreadToken());
+
+  // Tokens that a sub pool still holds are dropped from its parent
+  mgr.UnregisterPool(scan);
+  EXPECT_EQ(query->num_threads(), 1);
+  query->ReleaseThreadToken(true);
+  mgr.UnregisterPool(query);
+}
+
+// Takes optional tokens from a pool in many threads, like scanner threads that each
+// process a short scan range.
+class TokenConsumer {
+ public:
+  TokenConsumer(ThreadResourceMgr::ResourcePool* pool)
+    : pool_(pool), num_acquired_(0), done_(false) {
+  }
+
+  void Run() {
+    while (!done_) {
+      if (pool_->TryAcquireThreadToken()) {
+        __sync_fetch_and_add(&num_acquired_, 1);
+        usleep(100);
+        pool_->ReleaseThreadToken(false);
+      } else {
+        usleep(10);
+      }
+    }
+  }
+
+  void Start(int num_threads, thread_group* threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads->add_thread(new thread(bind(&TokenConsumer::Run, this)));
+    }
+  }
+
+  void Stop() { done_ = true; }
+
+  int64_t num_acquired() const { return num_acquired_; }
+
+ private:
+  ThreadResourceMgr::ResourcePool* pool_;
+  int64_t num_acquired_;
+  volatile bool done_;
+};
+
+// Waits for up to 10 seconds until 'pool' uses 'num' threads, or at most 'num' threads
+// if 'at_most' is true.
+static bool WaitForNumThreads(ThreadResourceMgr::ResourcePool* pool, int num,
+    bool at_most) {
+  for (int i = 0; i < 10000; ++i) {
+    int64_t num_threads = pool->num_threads();
+    if (num_threads == num || (at_most && num_threads < num)) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+// A long running query that holds all threads and an interactive query with twice
+// its priority share the system.  The interactive query must get its share as soon
+// as the long running query's threads finish, and neither may be starved.
+TEST(ThreadResourceMgr, FairnessStressTest) {
+  const int NUM_THREADS = 12;
+  const int NUM_CONSUMER_THREADS = 2 * NUM_THREADS;
+  ThreadResourceMgr mgr(NUM_THREADS);
+  thread_group threads;
+
+  ThreadResourceMgr::ResourcePool* etl = mgr.RegisterPool(1);
+  ThreadResourceMgr::ResourcePool* etl_scan =
+      mgr.RegisterPool(ThreadResourceMgr::SCANNER_POOL_WEIGHT, etl);
+  TokenConsumer etl_consumer(etl_scan);
+  etl_consumer.Start(NUM_CONSUMER_THREADS, &threads);
+  ASSERT_TRUE(WaitForNumThreads(etl, NUM_THREADS, false));
+
+  ThreadResourceMgr::ResourcePool* interactive = mgr.RegisterPool(2);
+  ThreadResourceMgr::ResourcePool* interactive_scan =
+      mgr.RegisterPool(ThreadResourceMgr::SCANNER_POOL_WEIGHT, interactive);
+  ThreadResourceMgr::ResourcePool* interactive_build =
+      mgr.RegisterPool(ThreadResourceMgr::HASH_JOIN_BUILD_POOL_WEIGHT, interactive);
+  EXPECT_EQ(etl->quota(), 4);
+  EXPECT_EQ(etl_scan->quota(), 4);
+  EXPECT_EQ(interactive->quota(), 8);
+  EXPECT_EQ(interactive_scan->quota(), 7);
+  EXPECT_EQ(interactive_build->quota(), 2);
+
+  // The build side gets a thread while the scanners are busy
+  EXPECT_TRUE(interactive_build->TryAcquireThreadToken());
+  TokenConsumer interactive_consumer(interactive_scan);
+  interactive_consumer.Start(NUM_CONSUMER_THREADS, &threads);
+
+  // The long running query gives up the threads over its quota
+  EXPECT_TRUE(WaitForNumThreads(etl_scan, etl_scan->quota(), true));
+  int64_t etl_acquired = etl_consumer.num_acquired();
+  int64_t interactive_acquired = interactive_consumer.num_acquired();
+  int max_etl_threads = 0;
+  int max_interactive_scan_threads = 0;
+  for (int i = 0; i < 200; ++i) {
+    max_etl_threads = max<int>(max_etl_threads, etl_scan->num_threads());
+    max_interactive_scan_threads =
+        max<int>(max_interactive_scan_threads, interactive_scan->num_threads());
+    usleep(1000);
+  }
+  etl_acquired = etl_consumer.num_acquired() - etl_acquired;
+  interactive_acquired = interactive_consumer.num_acquired() - interactive_acquired;
+
+  etl_consumer.Stop();
+  interactive_consumer.Stop();
+  threads.join_all();
+
+  EXPECT_LE(max_etl_threads, etl_scan->quota());
+  EXPECT_LE(max_interactive_scan_threads, interactive_scan->quota());
+  EXPECT_GT(etl_acquired, 0);
+  EXPECT_GT(interactive_acquired, etl_acquired);
+
+  interactive_build->ReleaseThreadToken(false);
+  EXPECT_EQ(etl->num_threads(), 0);
+  EXPECT_EQ(interactive->num_threads(), 0);
+  mgr.UnregisterPool(interactive_build);
+  mgr.UnregisterPool(interactive_scan);
+  mgr.UnregisterPool(etl_scan);
+  mgr.UnregisterPool(interactive);
+  mgr.UnregisterPool(etl);
+}
+
 }
 
 int main(int argc, char **argv) {
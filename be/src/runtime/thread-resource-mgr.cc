@@ -14,6 +14,7 @@
 
 #include "runtime/thread-resource-mgr.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
@@ -38,14 +39,19 @@ ThreadResourceMgr::ThreadResourceMgr(int threads_quota) {
   } else {
     system_threads_quota_ = threads_quota;
   }
-  per_pool_quota_ = 0;
+  pools_weight_ = 0;
 }
 
-ThreadResourceMgr::ResourcePool::ResourcePool(ThreadResourceMgr* parent) 
-  : parent_(parent) {
+ThreadResourceMgr::ResourcePool::ResourcePool(ThreadResourceMgr* mgr) 
+  : mgr_(mgr) {
 }
 
-void ThreadResourceMgr::ResourcePool::Reset() {
+void ThreadResourceMgr::ResourcePool::Reset(ResourcePool* parent, int weight) {
+  parent_ = parent;
+  weight_ = weight;
+  DCHECK(children_.empty());
+  children_weight_ = 0;
+  quota_ = 0;
   num_threads_ = 0;
   num_reserved_optional_threads_ = 0;
   thread_available_fn_ = NULL;
@@ -57,7 +63,9 @@ void ThreadResourceMgr::ResourcePool::ReserveOptionalTokens(int num) {
   num_reserved_optional_threads_ = num;
 }
 
-ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
+ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool(int weight,
+    ResourcePool* parent) {
+  DCHECK_GT(weight, 0);
   unique_lock<mutex> l(lock_);
   ResourcePool* pool = NULL;
   if (free_pool_objs_.empty()) {
@@ -69,8 +77,15 @@ ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
 
   DCHECK(pool != NULL);
   DCHECK(pools_.find(pool) == pools_.end());
-  pools_.insert(pool);
-  pool->Reset();
+  pool->Reset(parent, weight);
+  if (parent == NULL) {
+    pools_.insert(pool);
+    pools_weight_ += weight;
+  } else {
+    DCHECK(parent->mgr_ == this);
+    parent->children_.push_back(pool);
+    parent->children_weight_ += weight;
+  }
 
   // Added a new pool, update the quotas for each pool.
   UpdatePoolQuotas(pool);
@@ -80,8 +95,23 @@ ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
 void ThreadResourceMgr::UnregisterPool(ResourcePool* pool) {
   DCHECK(pool != NULL);
   unique_lock<mutex> l(lock_);
-  DCHECK(pools_.find(pool) != pools_.end());
-  pools_.erase(pool);
+  DCHECK(pool->children_.empty());
+  if (pool->parent_ == NULL) {
+    DCHECK(pools_.find(pool) != pools_.end());
+    pools_.erase(pool);
+    pools_weight_ -= pool->weight_;
+  } else {
+    // Tokens the sub pool still holds (e.g. the ones the io mgr acquired for ranges
+    // of a cancelled scan) no longer count towards its ancestors.
+    int64_t num_threads = pool->num_threads_;
+    for (ResourcePool* p = pool->parent_; p != NULL; p = p->parent_) {
+      __sync_fetch_and_add(&p->num_threads_, -num_threads);
+    }
+    list<ResourcePool*>& siblings = pool->parent_->children_;
+    DCHECK(find(siblings.begin(), siblings.end(), pool) != siblings.end());
+    siblings.remove(pool);
+    pool->parent_->children_weight_ -= pool->weight_;
+  }
   free_pool_objs_.push_back(pool);
   UpdatePoolQuotas();
 }
@@ -92,17 +122,32 @@ void ThreadResourceMgr::ResourcePool::SetThreadAvailableCb(ThreadAvailableCb fn)
   thread_available_fn_ = fn;
 }
 
+// Returns ceil(quota * weight / total_weight)
+static int WeightedShare(int quota, int weight, int total_weight) {
+  DCHECK_GT(total_weight, 0);
+  return (static_cast<int64_t>(quota) * weight + total_weight - 1) / total_weight;
+}
+
 void ThreadResourceMgr::UpdatePoolQuotas(ResourcePool* new_pool) {
-  if (pools_.empty()) return;
-  per_pool_quota_ = 
-      ceil(static_cast<double>(system_threads_quota_) / pools_.size());
   for (Pools::iterator it = pools_.begin(); it != pools_.end(); ++it) {
     ResourcePool* pool = *it;
-    if (pool == new_pool) continue;
-    unique_lock<mutex> l(pool->lock_);
-    if (pool->num_available_threads() > 0 && pool->thread_available_fn_ != NULL) {
-      pool->thread_available_fn_(pool);
-    }
+    UpdatePoolQuota(pool,
+        WeightedShare(system_threads_quota_, pool->weight_, pools_weight_), new_pool);
   }
 }
 
+void ThreadResourceMgr::UpdatePoolQuota(ResourcePool* pool, int quota,
+    ResourcePool* new_pool) {
+  pool->quota_ = quota;
+  for (list<ResourcePool*>::iterator it = pool->children_.begin();
+       it != pool->children_.end(); ++it) {
+    ResourcePool* child = *it;
+    UpdatePoolQuota(child,
+        WeightedShare(pool->quota(), child->weight_, pool->children_weight_), new_pool);
+  }
+  if (pool == new_pool) return;
+  unique_lock<mutex> l(pool->lock_);
+  if (pool->num_available_threads() > 0 && pool->thread_available_fn_ != NULL) {
+    pool->thread_available_fn_(pool);
+  }
+}
@@ -24,6 +24,7 @@
 #include <boost/thread/thread.hpp>
 
 #include <list>
+#include <set>
 
 #include "common/status.h"
 
@@ -34,9 +35,15 @@ namespace impala {
 // query fragments.  If there is only one fragment running, it can use the
 // entire pool, spinning up the maximum number of threads to saturate the
 // hardware.  If there are multiple fragments, the CPU pool must be shared
-// between them.  Currently, the total system pool is split evenly between
-// all consumers.  Each consumer gets ceil(total_system_threads / num_consumers).
-// 
+// between them.  The total system pool is split between all consumers in proportion
+// to their weights (the QUERY_PRIORITY of the fragment's query).  Each consumer gets
+// ceil(total_system_threads * weight / sum_of_weights).
+// Pools form a hierarchy: a fragment's pool can have sub pools for the components
+// that use threads (e.g. the scanners of a scan node or the build side of a hash
+// join).  The sub pools split the quota of their parent the same way, so one
+// component can't take all of the fragment's optional threads from another.
+// Tokens taken from a sub pool also count towards its ancestors.
+//
 // Each fragment must register with the ThreadResourceMgr to request threads 
 // (in the form of tokens).  The fragment has required threads (it can't run 
 // with fewer threads) and optional threads.  If the fragment is running on its
@@ -51,13 +58,11 @@ namespace impala {
 // system, the first pool's quota is then cut by half (16 total) and will
 // over time drop the optional threads.
 // This class is thread safe.
+// The number of queries that run concurrently is limited by the AdmissionController.
 // TODO: this is an initial simple version to improve the behavior with 
 // concurrency.  This will need to be expanded post GA.  These include:
-//  - More places where threads are optional (e.g. hash table build side,
-//    data stream threads, etc).
-//  - Admission control
+//  - More places where threads are optional (e.g. data stream threads, etc).
 //  - Integration with other nodes/statestore
-//  - Priorities for different pools
 // If both the mgr and pool locks need to be taken, the mgr lock must
 // be taken first.
 class ThreadResourceMgr {
@@ -76,12 +81,16 @@ class ThreadResourceMgr {
   // mgr.  What's the best model for something more general.
   typedef boost::function<void (ResourcePool*)> ThreadAvailableCb;
 
-  // Pool abstraction for a single resource pool.
-  // TODO: this is not quite sufficient going forward.  We need a hierarchy of pools,
-  // one for the entire query, and a sub pool for each component that needs threads,
-  // all of which share a quota.  Currently, the way state is tracked here, it would
-  // be impossible to have two components both want optional threads (e.g. two things
-  // that have 1+ thread usage).
+  // Weights of the sub pools that exec nodes register under their fragment's pool.
+  // Scanners can use as many threads as they get, the hash join build side only uses
+  // one while the table is built.
+  static const int SCANNER_POOL_WEIGHT = 4;
+  static const int HASH_JOIN_BUILD_POOL_WEIGHT = 1;
+
+  // Pool abstraction for a single resource pool.  This is either the pool of an
+  // entire fragment or a sub pool for one of its components.  Each component that
+  // wants optional threads should use its own sub pool, since a pool only has a
+  // single ThreadAvailableCb.
   class ResourcePool {
    public:
     // Acquire a thread for the pool.  This will always succeed; the
@@ -117,12 +126,13 @@ class ThreadResourceMgr {
     // Add a callback to be notified when a thread is available.
     // 'arg' is opaque and passed directly to the callback.
     // The previous callback is no longer notified.
-    // TODO: rethink this.  How we do coordinate when we have multiple places in
-    // the execution that all need threads (e.g. do we use that thread for
-    // the scanner or for the join).
+    // Components that compete for threads should each use their own sub pool
+    // (see ThreadResourceMgr::RegisterPool()).
     void SetThreadAvailableCb(ThreadAvailableCb fn);
 
     // Returns the number of threads that are from AcquireThreadToken.
+    // The counts of a pool include the threads of its sub pools (they are updated
+    // right after the sub pool's counts, so they can be off for a moment).
     int num_required_threads() const { return num_threads_ & 0xFFFFFFFF; }
 
     // Returns the number of thread resources returned by successful calls
@@ -144,7 +154,13 @@ class ThreadResourceMgr {
 
     // Returns the quota for this pool.  Note this changes dynamically
     // based on system load.
-    int quota() const { return std::min(max_quota_, parent_->per_pool_quota_); }
+    int quota() const { return std::min(max_quota_, quota_); }
+
+    // Returns the weight the pool was registered with.
+    int weight() const { return weight_; }
+
+    // Returns the pool this is a sub pool of, or NULL for a fragment's pool.
+    ResourcePool* parent() const { return parent_; }
 
     // Sets the max thread quota for this pool.  This is only used for testing since
     // the dynamic values should be used normally.  The actual quota is the min of this
@@ -154,12 +170,27 @@ class ThreadResourceMgr {
    private:
     friend class ThreadResourceMgr;
 
-    ResourcePool(ThreadResourceMgr* parent);
+    ResourcePool(ThreadResourceMgr* mgr);
 
     // Resets internal state.
-    void Reset();
+    void Reset(ResourcePool* parent, int weight);
+
+    // Calls thread_available_fn_ if a thread is available.
+    void NotifyThreadAvailable();
+
+    ThreadResourceMgr* mgr_;
+
+    // The remaining fields up to num_reserved_optional_threads_ are protected by
+    // mgr_->lock_.
+    ResourcePool* parent_;
+    int weight_;
+
+    // Sub pools and the sum of their weights
+    std::list<ResourcePool*> children_;
+    int children_weight_;
 
-    ThreadResourceMgr* parent_;
+    // Share of the parent's (or the system's) quota, updated in UpdatePoolQuotas()
+    int quota_;
   
     int max_quota_;
     int num_reserved_optional_threads_;
@@ -187,10 +218,14 @@ class ThreadResourceMgr {
 
   // Register a new pool with the thread mgr.  Registering a pool
   // will update the quotas for all existing pools.
-  ResourcePool* RegisterPool();
+  // If 'parent' is non-NULL, the new pool is a sub pool of 'parent' and gets a share
+  // of its quota, otherwise it gets a share of the system's quota.  The shares are
+  // proportional to 'weight', which must be > 0.
+  ResourcePool* RegisterPool(int weight = 1, ResourcePool* parent = NULL);
 
   // Unregisters the pool.  'pool' is no longer valid after this.
-  // This updates the quotas for the remaining pools.
+  // This updates the quotas for the remaining pools.  The sub pools of 'pool' must
+  // have been unregistered.
   void UnregisterPool(ResourcePool* pool);
 
  private:
@@ -200,25 +235,29 @@ class ThreadResourceMgr {
   // Lock for the entire object.  Protects all fields below.
   boost::mutex lock_;
 
-  // Pools currently being managed
+  // Pools currently being managed, without sub pools
   typedef std::set<ResourcePool*> Pools;
   Pools pools_;
 
-  // Each pool currently gets the same share.  This is the ceil of the
-  // system quota divided by the number of pools.
-  int per_pool_quota_;
+  // Sum of the weights of pools_
+  int pools_weight_;
 
   // Recycled list of pool objects
   std::list<ResourcePool*> free_pool_objs_;
 
-  // Updates the per pool quota and notifies any pools that now have
+  // Updates the quota of every pool and notifies any pools that now have
   // more threads they can use.  Must be called with lock_ taken.
   // If new_pool is non-null, new_pool will *not* be notified.
   void UpdatePoolQuotas(ResourcePool* new_pool = NULL);
+
+  // Sets the quota of 'pool' and the quotas of its sub pools, then notifies them.
+  void UpdatePoolQuota(ResourcePool* pool, int quota, ResourcePool* new_pool);
 };
 
 inline void ThreadResourceMgr::ResourcePool::AcquireThreadToken() {
-  __sync_fetch_and_add(&num_threads_, 1);
+  for (ResourcePool* pool = this; pool != NULL; pool = pool->parent_) {
+    __sync_fetch_and_add(&pool->num_threads_, 1);
+  }
 }
 
 inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken() {
@@ -234,6 +273,10 @@ inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken() {
     // Atomically swap the new value if no one updated num_threads_.  We do not
     // not care about the ABA problem here.
     if (__sync_bool_compare_and_swap(&num_threads_, previous_num_threads, new_value)) {
+      // The token counts as an optional thread of the ancestors, whatever their quota
+      for (ResourcePool* pool = parent_; pool != NULL; pool = pool->parent_) {
+        __sync_fetch_and_add(&pool->num_threads_, 1LL << 32);
+      }
       return true;
     }
   }
@@ -255,7 +298,19 @@ inline void ThreadResourceMgr::ResourcePool::ReleaseThreadToken(bool required) {
       }
     }
   }
+  int64_t delta = required ? -1 : -(1LL << 32);
+  for (ResourcePool* pool = parent_; pool != NULL; pool = pool->parent_) {
+    __sync_fetch_and_add(&pool->num_threads_, delta);
+  }
+
+  // The quotas of the sibling pools don't depend on this pool's threads, only this
+  // pool and its ancestors can have a thread available now.
+  for (ResourcePool* pool = this; pool != NULL; pool = pool->parent_) {
+    pool->NotifyThreadAvailable();
+  }
+}
 
+inline void ThreadResourceMgr::ResourcePool::NotifyThreadAvailable() {
   // We need to grab a lock before issuing the callback to prevent the
   // callback from being removed while it is happening.
   // Note: this is unlikely to be a big deal for performance currently
@@ -53,7 +53,9 @@
 #include "util/jni-util.h"
 #include "util/network-util.h"
 #include "util/parse-util.h"
+#include "util/stopwatch.h"
 #include "util/string-parser.h"
+#include "util/thread-pool.h"
 #include "util/thrift-util.h"
 #include "util/thrift-server.h"
 #include "util/url-coding.h"
@@ -108,6 +110,8 @@ DEFINE_string(heap_profile_dir, "", "if non-empty, enable heap profiling and out
     " to specified directory.");
 
 DEFINE_bool(abort_on_config_error, true, "Abort Impala if there are improper configs.");
+DEFINE_int32(fragment_exec_max_idle_threads, 64, "Maximum number of plan fragment "
+    "execution threads that wait for the next fragment after theirs finished.");
 
 namespace impala {
 
@@ -160,6 +164,13 @@ Status ImpalaServer::QueryExecState::Exec(TExecRequest* exec_request) {
         return Status::OK;
       }
 
+      // Wait until the query's request pool has room for it
+      int64_t mem_estimate = AdmissionController::EstimateQueryMem(
+          query_exec_request, exec_request->query_options);
+      RETURN_IF_ERROR(impala_server_->admission_controller_->AdmitQuery(query_id_,
+          exec_request->query_options.request_pool, mem_estimate, &summary_profile_));
+      query_events_->MarkEvent("Admitted");
+
       coord_.reset(new Coordinator(exec_env_));
       RETURN_IF_ERROR(coord_->Exec(
           exec_request->request_id, &query_exec_request, exec_request->query_options));
@@ -197,6 +208,7 @@ Status ImpalaServer::QueryExecState::Exec(TExecRequest* exec_request) {
 }
 
 void ImpalaServer::QueryExecState::Done() {
+  impala_server_->admission_controller_->ReleaseQuery(query_id_);
   end_time_ = TimestampValue::local_time();
   summary_profile_.AddInfoString("End Time", end_time().DebugString());
   summary_profile_.AddInfoString("Query State", PrintQueryState(query_state_));
@@ -329,6 +341,7 @@ void ImpalaServer::QueryExecState::Cancel() {
   // Coordinator::Cancel() multiple times
   if (query_state_ == QueryState::EXCEPTION) return;
   query_state_ = QueryState::EXCEPTION;
+  impala_server_->admission_controller_->CancelQueuedQuery(query_id_);
   if (coord_.get() != NULL) coord_->Cancel();
 }
 
@@ -429,7 +442,6 @@ class ImpalaServer::FragmentExecState {
   const TUniqueId& query_id() const { return query_id_; }
   const TUniqueId& fragment_instance_id() const { return fragment_instance_id_; }
 
-  void set_exec_thread(thread* exec_thread) { exec_thread_.reset(exec_thread); }
 
  private:
   TUniqueId query_id_;
@@ -443,8 +455,9 @@ class ImpalaServer::FragmentExecState {
   // (it's exported ImpalaInternalService)
   const TNetworkAddress coord_hostport_;
 
-  // the thread executing this plan fragment
-  scoped_ptr<thread> exec_thread_;
+  // time from the end of Prepare() until Exec() is called by a thread of the
+  // fragment exec thread pool
+  MonotonicStopWatch exec_wait_watch_;
 
   // protects exec_status_
   mutex status_lock_;
@@ -479,10 +492,13 @@ Status ImpalaServer::FragmentExecState::Prepare(
     const TExecPlanFragmentParams& exec_params) {
   exec_params_ = exec_params;
   RETURN_IF_ERROR(executor_.Prepare(exec_params));
+  exec_wait_watch_.Start();
   return Status::OK;
 }
 
 void ImpalaServer::FragmentExecState::Exec() {
+  COUNTER_SET(ADD_TIMER(executor_.profile(), "ExecThreadWaitTime"),
+      static_cast<int64_t>(exec_wait_watch_.ElapsedTime()));
   // Open() does the full execution, because all plan fragments have sinks
   executor_.Open();
   executor_.Close();
@@ -580,6 +596,8 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
   // Initialize default config
   InitializeConfigVariables();
 
+  fragment_exec_thread_pool_.reset(new ThreadPool(FLAGS_fragment_exec_max_idle_threads));
+
 #ifndef ADDRESS_SANITIZER
   // tcmalloc and address sanitizer can not be used together
   if (!FLAGS_heap_profile_dir.empty()) {
@@ -705,6 +723,13 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
   ImpaladMetrics::IMPALA_SERVER_START_TIME->Update(
       TimestampValue::local_time().DebugString());
 
+  admission_controller_.reset(new AdmissionController(exec_env->metrics()));
+  EXIT_IF_ERROR(admission_controller_->Init());
+  Webserver::PathHandlerCallback admission_callback =
+      bind<void>(mem_fn(&AdmissionController::PoolsPathHandler),
+                 admission_controller_.get(), _1, _2);
+  exec_env->webserver()->RegisterPathHandler("/admission", admission_callback);
+
   // Register the membership callback if required
   if (exec_env->subscriber() != NULL) {
     StateStoreSubscriber::UpdateCallback cb =
@@ -1633,6 +1658,21 @@ Status ImpalaServer::SetQueryOptions(const string& key, const string& value,
         query_options->__set_abort_on_default_limit_exceeded(
             iequals(value, "true") || iequals(value, "1"));
         break;
+      case TImpalaQueryOptions::NUM_INSTANCES_PER_HOST:
+        query_options->__set_num_instances_per_host(atoi(value.c_str()));
+        break;
+      case TImpalaQueryOptions::REQUEST_POOL:
+        query_options->__set_request_pool(value);
+        break;
+      case TImpalaQueryOptions::QUERY_PRIORITY:
+        query_options->__set_query_priority(atoi(value.c_str()));
+        break;
+      case TImpalaQueryOptions::HFILE_MIN_TIMESTAMP:
+        query_options->__set_hfile_min_timestamp(atol(value.c_str()));
+        break;
+      case TImpalaQueryOptions::HFILE_MAX_TIMESTAMP:
+        query_options->__set_hfile_max_timestamp(atol(value.c_str()));
+        break;
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
@@ -1698,7 +1738,7 @@ void ImpalaServer::CancelPlanFragment(
   }
   // we only initiate cancellation here, the map entry as well as the exec state
   // are removed when fragment execution terminates (which is at present still
-  // running in exec_state->exec_thread_)
+  // running in a thread of fragment_exec_thread_pool_)
   exec_state->Cancel().SetTStatus(&return_val);
 }
 
@@ -1708,11 +1748,12 @@ void ImpalaServer::TransmitData(
            << " node_id=" << params.dest_node_id
            << " #rows=" << params.row_batch.num_rows
            << " eos=" << (params.eos ? "true" : "false");
-  // TODO: fix Thrift so we can simply take ownership of thrift_batch instead
-  // of having to copy its data
+  // The processor discards 'params' after this call, so the stream can take over the
+  // batch's tuple data instead of copying it.
   if (params.row_batch.num_rows > 0) {
     Status status = exec_env_->stream_mgr()->AddData(
-        params.dest_fragment_instance_id, params.dest_node_id, params.row_batch);
+        params.dest_fragment_instance_id, params.dest_node_id,
+        const_cast<TRowBatch*>(&params.row_batch));
     status.SetTStatus(&return_val);
     if (!status.ok()) {
       // should we close the channel here as well?
@@ -1749,10 +1790,8 @@ Status ImpalaServer::StartPlanFragmentExecution(
     fragment_exec_state_map_.insert(make_pair(params.fragment_instance_id, exec_state));
   }
 
-  // execute plan fragment in new thread
-  // TODO: manage threads via global thread pool
-  exec_state->set_exec_thread(
-      new thread(&ImpalaServer::RunExecPlanFragment, this, exec_state.get()));
+  fragment_exec_thread_pool_->Offer(
+      bind<void>(mem_fn(&ImpalaServer::RunExecPlanFragment), this, exec_state.get()));
   return Status::OK;
 }
 
@@ -1891,6 +1930,21 @@ void ImpalaServer::TQueryOptionsToMap(const TQueryOptions& query_option,
       case TImpalaQueryOptions::ABORT_ON_DEFAULT_LIMIT_EXCEEDED:
         val << query_option.abort_on_default_limit_exceeded;
         break;
+      case TImpalaQueryOptions::NUM_INSTANCES_PER_HOST:
+        val << query_option.num_instances_per_host;
+        break;
+      case TImpalaQueryOptions::REQUEST_POOL:
+        val << query_option.request_pool;
+        break;
+      case TImpalaQueryOptions::QUERY_PRIORITY:
+        val << query_option.query_priority;
+        break;
+      case TImpalaQueryOptions::HFILE_MIN_TIMESTAMP:
+        val << query_option.hfile_min_timestamp;
+        break;
+      case TImpalaQueryOptions::HFILE_MAX_TIMESTAMP:
+        val << query_option.hfile_max_timestamp;
+        break;
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
@@ -40,6 +40,7 @@
 #include "runtime/primitive-type.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/runtime-state.h"
+#include "statestore/admission-controller.h"
 
 namespace impala {
 
@@ -59,6 +60,7 @@ class TCancelPlanFragmentArgs;
 class TCancelPlanFragmentResult;
 class TTransmitDataArgs;
 class TTransmitDataResult;
+class ThreadPool;
 class TNetworkAddress;
 class TClientRequest;
 class TExecRequest;
@@ -309,7 +311,7 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
     // Initiates execution of plan fragments, if there are any, and sets
     // up the output exprs for subsequent calls to FetchRows().
     // Also sets up profile and pre-execution counters.
-    // Non-blocking.
+    // Blocks while the query is queued by admission control, otherwise non-blocking.
     Status Exec(TExecRequest* exec_request);
 
     // Execute a HiveServer2 metadata operation
@@ -331,12 +333,14 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
 
     void SetErrorStatus(const Status& status);
 
-    // Sets state to EXCEPTION and cancels coordinator.
+    // Sets state to EXCEPTION and cancels coordinator, or stops waiting for admission
+    // if the query is queued.
     // Caller needs to hold lock().
     // Does nothing if the query has reached EOS.
     void Cancel();
 
     // This is called when the query is done (finished, cancelled, or failed).
+    // Returns the query's resources to admission control.
     void Done();
 
     SessionState* parent_session() { return parent_session_.get(); }
@@ -444,13 +448,13 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   // Ascii output precision for double/float
   static const int ASCII_PRECISION;
 
-  // Initiate execution of plan fragment in newly created thread.
+  // Initiate execution of plan fragment in a thread of fragment_exec_thread_pool_.
   // Creates new FragmentExecState and registers it in fragment_exec_state_map_.
   Status StartPlanFragmentExecution(const TExecPlanFragmentParams& exec_params);
 
   // Top-level loop for synchronously executing plan fragment, which runs in
-  // exec_state's thread. Repeatedly calls GetNext() on the executor
-  // and feeds the result into the data sink.
+  // a thread of fragment_exec_thread_pool_. Repeatedly calls GetNext() on the
+  // executor and feeds the result into the data sink.
   // Returns exec status.
   Status ExecPlanFragment(FragmentExecState* exec_state);
 
@@ -801,6 +805,9 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   jmethodID drop_table_id_; // JniFrontend.dropTable
   ExecEnv* exec_env_;  // not owned
 
+  // Decides when queries may start executing, see QueryExecState::Exec()
+  boost::scoped_ptr<AdmissionController> admission_controller_;
+
   // If true, codegen exprs for queries without from clause
   bool select_exprs_codegen_enabled_;
 
@@ -825,6 +832,10 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   FragmentExecStateMap fragment_exec_state_map_;
   boost::mutex fragment_exec_state_map_lock_;  // protects fragment_exec_state_map_
 
+  // Threads that execute plan fragments.  Fragments reuse the threads of finished
+  // ones instead of starting a thread each.
+  boost::scoped_ptr<ThreadPool> fragment_exec_thread_pool_;
+
   // Default query options in the form of TQueryOptions and beeswax::ConfigVariable
   TQueryOptions default_query_options_;
   std::vector<beeswax::ConfigVariable> default_configs_;
@@ -0,0 +1,242 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "common/logging.h"
+#include "statestore/admission-controller.h"
+
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+DECLARE_string(admission_pools);
+DECLARE_int64(queue_wait_timeout_ms);
+DECLARE_string(admission_scan_mem_estimate);
+DECLARE_string(admission_blocking_node_mem_estimate);
+
+using namespace std;
+using namespace boost;
+
+namespace impala {
+
+class AdmissionControllerTest : public testing::Test {
+ protected:
+  AdmissionControllerTest() : controller_(NULL) {
+    EXPECT_TRUE(controller_.Init().ok());
+  }
+
+  static TUniqueId QueryId(int64_t n) {
+    TUniqueId id;
+    id.hi = 0;
+    id.lo = n;
+    return id;
+  }
+
+  // Runs AdmitQuery() in a thread, the result is stored in *status
+  void AdmitAsync(int64_t n, const string& pool, int64_t mem_estimate, Status* status,
+      thread_group* threads) {
+    threads->add_thread(new thread(bind(&AdmissionControllerTest::Admit, this, n,
+        pool, mem_estimate, status)));
+  }
+
+  void Admit(int64_t n, const string& pool, int64_t mem_estimate, Status* status) {
+    *status = controller_.AdmitQuery(QueryId(n), pool, mem_estimate, NULL);
+  }
+
+  // Waits until 'pool' has 'num_queued' queued queries
+  void WaitForQueued(const string& pool, int64_t num_queued) {
+    int64_t running, queued, mem;
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_TRUE(controller_.GetPoolStats(pool, &running, &queued, &mem));
+      if (queued == num_queued) return;
+      usleep(1000);
+    }
+    FAIL() << "timed out waiting for " << num_queued << " queued queries";
+  }
+
+  void ExpectStats(const string& pool, int64_t num_running, int64_t num_queued,
+      int64_t mem_admitted) {
+    int64_t running, queued, mem;
+    ASSERT_TRUE(controller_.GetPoolStats(pool, &running, &queued, &mem));
+    EXPECT_EQ(running, num_running);
+    EXPECT_EQ(queued, num_queued);
+    EXPECT_EQ(mem, mem_admitted);
+  }
+
+  AdmissionController controller_;
+};
+
+TEST_F(AdmissionControllerTest, NoLimits) {
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(controller_.AdmitQuery(QueryId(i), "", 1L << 40, NULL).ok());
+  }
+  ExpectStats(AdmissionController::DEFAULT_POOL, 10, 0, 10 * (1L << 40));
+  for (int i = 0; i < 10; ++i) {
+    controller_.ReleaseQuery(QueryId(i));
+  }
+  ExpectStats(AdmissionController::DEFAULT_POOL, 0, 0, 0);
+  // releasing twice is a no-op
+  controller_.ReleaseQuery(QueryId(0));
+  ExpectStats(AdmissionController::DEFAULT_POOL, 0, 0, 0);
+  EXPECT_FALSE(controller_.AdmitQuery(QueryId(0), "unknown", 0, NULL).ok());
+}
+
+TEST_F(AdmissionControllerTest, MaxRequests) {
+  AdmissionController::PoolConfig config;
+  config.max_requests = 2;
+  controller_.SetPoolConfig("p", config);
+  EXPECT_TRUE(controller_.AdmitQuery(QueryId(0), "p", 0, NULL).ok());
+  EXPECT_TRUE(controller_.AdmitQuery(QueryId(1), "p", 0, NULL).ok());
+
+  thread_group threads;
+  Status status2, status3;
+  AdmitAsync(2, "p", 0, &status2, &threads);
+  WaitForQueued("p", 1);
+  AdmitAsync(3, "p", 0, &status3, &threads);
+  WaitForQueued("p", 2);
+  ExpectStats("p", 2, 2, 0);
+
+  // queries are admitted in order
+  controller_.ReleaseQuery(QueryId(1));
+  WaitForQueued("p", 1);
+  ExpectStats("p", 2, 1, 0);
+  controller_.ReleaseQuery(QueryId(2));
+  threads.join_all();
+  EXPECT_TRUE(status2.ok());
+  EXPECT_TRUE(status3.ok());
+  ExpectStats("p", 2, 0, 0);
+  controller_.ReleaseQuery(QueryId(0));
+  controller_.ReleaseQuery(QueryId(3));
+  ExpectStats("p", 0, 0, 0);
+}
+
+TEST_F(AdmissionControllerTest, MaxMem) {
+  AdmissionController::PoolConfig config;
+  config.max_mem = 100;
+  controller_.SetPoolConfig("p", config);
+  // a query that is larger than the limit runs if it's alone
+  EXPECT_TRUE(controller_.AdmitQuery(QueryId(0), "p", 150, NULL).ok());
+  controller_.ReleaseQuery(QueryId(0));
+
+  EXPECT_TRUE(controller_.AdmitQuery(QueryId(1), "p", 60, NULL).ok());
+  thread_group threads;
+  Status status;
+  AdmitAsync(2, "p", 60, &status, &threads);
+  WaitForQueued("p", 1);
+  ExpectStats("p", 1, 1, 60);
+  controller_.ReleaseQuery(QueryId(1));
+  threads.join_all();
+  EXPECT_TRUE(status.ok());
+  ExpectStats("p", 1, 0, 60);
+
+  // raising the limit admits queued queries
+  AdmitAsync(3, "p", 60, &status, &threads);
+  WaitForQueued("p", 1);
+  config.max_mem = 120;
+  controller_.SetPoolConfig("p", config);
+  threads.join_all();
+  EXPECT_TRUE(status.ok());
+  ExpectStats("p", 2, 0, 120);
+  controller_.ReleaseQuery(QueryId(2));
+  controller_.ReleaseQuery(QueryId(3));
+}
+
+TEST_F(AdmissionControllerTest, QueueFull) {
+  AdmissionController::PoolConfig config;
+  config.max_requests = 0;
+  config.max_queued = 1;
+  controller_.SetPoolConfig("p", config);
+  thread_group threads;
+  Status status;
+  AdmitAsync(0, "p", 0, &status, &threads);
+  WaitForQueued("p", 1);
+  EXPECT_FALSE(controller_.AdmitQuery(QueryId(1), "p", 0, NULL).ok());
+  controller_.CancelQueuedQuery(QueryId(0));
+  threads.join_all();
+  EXPECT_TRUE(status.IsCancelled());
+  ExpectStats("p", 0, 0, 0);
+}
+
+TEST_F(AdmissionControllerTest, Timeout) {
+  int64_t old_timeout = FLAGS_queue_wait_timeout_ms;
+  FLAGS_queue_wait_timeout_ms = 50;
+  AdmissionController::PoolConfig config;
+  config.max_requests = 1;
+  controller_.SetPoolConfig("p", config);
+  EXPECT_TRUE(controller_.AdmitQuery(QueryId(0), "p", 0, NULL).ok());
+  Status status = controller_.AdmitQuery(QueryId(1), "p", 0, NULL);
+  EXPECT_FALSE(status.ok());
+  EXPECT_FALSE(status.IsCancelled());
+  ExpectStats("p", 1, 0, 0);
+  controller_.ReleaseQuery(QueryId(0));
+  FLAGS_queue_wait_timeout_ms = old_timeout;
+}
+
+TEST_F(AdmissionControllerTest, ParsePools) {
+  FLAGS_admission_pools = "small:2:1M, large:-1:1G:5";
+  AdmissionController controller(NULL);
+  EXPECT_TRUE(controller.Init().ok());
+  int64_t running, queued, mem;
+  EXPECT_TRUE(controller.GetPoolStats("small", &running, &queued, &mem));
+  EXPECT_TRUE(controller.GetPoolStats("large", &running, &queued, &mem));
+  EXPECT_TRUE(controller.GetPoolStats(AdmissionController::DEFAULT_POOL,
+      &running, &queued, &mem));
+
+  FLAGS_admission_pools = "bad:2";
+  AdmissionController bad_controller(NULL);
+  EXPECT_FALSE(bad_controller.Init().ok());
+  FLAGS_admission_pools = "";
+}
+
+static TPlanNode MakeNode(TPlanNodeType::type type) {
+  TPlanNode node;
+  node.node_type = type;
+  return node;
+}
+
+TEST_F(AdmissionControllerTest, EstimateQueryMem) {
+  FLAGS_admission_scan_mem_estimate = "10";
+  FLAGS_admission_blocking_node_mem_estimate = "100";
+  TQueryExecRequest request;
+  // coordinator fragment: aggregation over an exchange
+  request.fragments.resize(2);
+  request.fragments[0].__isset.plan = true;
+  request.fragments[0].partition.type = TPartitionType::UNPARTITIONED;
+  request.fragments[0].plan.nodes.push_back(MakeNode(TPlanNodeType::AGGREGATION_NODE));
+  request.fragments[0].plan.nodes.push_back(MakeNode(TPlanNodeType::EXCHANGE_NODE));
+  // join of two scans
+  request.fragments[1].__isset.plan = true;
+  request.fragments[1].partition.type = TPartitionType::RANDOM;
+  request.fragments[1].plan.nodes.push_back(MakeNode(TPlanNodeType::HASH_JOIN_NODE));
+  request.fragments[1].plan.nodes.push_back(MakeNode(TPlanNodeType::HDFS_SCAN_NODE));
+  request.fragments[1].plan.nodes.push_back(MakeNode(TPlanNodeType::HDFS_SCAN_NODE));
+
+  TQueryOptions options;
+  EXPECT_EQ(AdmissionController::EstimateQueryMem(request, options), 100 + 120);
+  options.num_instances_per_host = 3;
+  EXPECT_EQ(AdmissionController::EstimateQueryMem(request, options), 100 + 3 * 120);
+  options.mem_limit = 5000;
+  EXPECT_EQ(AdmissionController::EstimateQueryMem(request, options), 5000);
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,453 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "statestore/admission-controller.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "util/debug-util.h"
+#include "util/impalad-metrics.h"
+#include "util/parse-util.h"
+#include "util/runtime-profile.h"
+#include "util/stopwatch.h"
+#include "util/string-parser.h"
+
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace boost;
+using namespace std;
+
+DEFINE_string(admission_pools, "", "Comma-separated list of request pools that queries "
+    "can be submitted to with the REQUEST_POOL query option, each given as "
+    "<name>:<max requests>:<max mem>[:<max queued>]. <max requests> limits the number "
+    "of queries of the pool that run at the same time, <max mem> the sum of their "
+    "memory estimates (e.g. '10G'; per host) and <max queued> the number of queries "
+    "that wait for admission. -1 means no limit.");
+DEFINE_int64(default_pool_max_requests, -1, "Max number of queries of the default "
+    "request pool that run at the same time. -1 means no limit.");
+DEFINE_string(default_pool_mem_limit, "-1", "Max sum of the per host memory estimates "
+    "of the running queries of the default request pool. -1 means no limit.");
+DEFINE_int64(default_pool_max_queued, 200, "Max number of queries of the default "
+    "request pool that wait for admission. -1 means no limit.");
+DEFINE_int64(queue_wait_timeout_ms, 60 * 1000, "Time after which a query that waits "
+    "for admission fails.");
+DEFINE_string(admission_scan_mem_estimate, "64M", "Memory per scan node and host that "
+    "admission control assumes for queries without MEM_LIMIT.");
+DEFINE_string(admission_blocking_node_mem_estimate, "256M", "Memory per hash join, "
+    "aggregation and sort node and host that admission control assumes for queries "
+    "without MEM_LIMIT.");
+
+namespace impala {
+
+const string AdmissionController::DEFAULT_POOL("default");
+
+// Parses a limit that is given as a memory spec.  -1 (or nothing) means no limit.
+static Status ParseMemLimit(const string& spec, int64_t* limit) {
+  string trimmed = trim_copy(spec);
+  if (trimmed.empty() || trimmed == "-1") {
+    *limit = -1;
+    return Status::OK;
+  }
+  bool is_percent;
+  *limit = ParseUtil::ParseMemSpec(trimmed, &is_percent);
+  if (*limit < 0) return Status("Failed to parse memory limit from '" + spec + "'.");
+  return Status::OK;
+}
+
+// Adds the outcome of AdmitQuery() to 'profile' if it is non-NULL
+static void SetAdmissionResult(RuntimeProfile* profile, const string& result) {
+  if (profile != NULL) profile->AddInfoString("Admission result", result);
+}
+
+AdmissionController::Pool::Pool(const string& name)
+  : name(name),
+    num_running(0),
+    mem_admitted(0),
+    total_admitted(0),
+    total_queued(0),
+    total_rejected(0),
+    total_timed_out(0),
+    total_queue_wait_ms(0),
+    num_running_metric(NULL),
+    num_queued_metric(NULL),
+    mem_admitted_metric(NULL),
+    total_admitted_metric(NULL),
+    total_rejected_metric(NULL),
+    total_timed_out_metric(NULL) {
+}
+
+AdmissionController::AdmissionController(Metrics* metrics)
+  : metrics_(metrics) {
+}
+
+AdmissionController::~AdmissionController() {
+  DCHECK(queued_queries_.empty());
+}
+
+Status AdmissionController::Init() {
+  PoolConfig default_config;
+  default_config.max_requests = FLAGS_default_pool_max_requests;
+  RETURN_IF_ERROR(ParseMemLimit(FLAGS_default_pool_mem_limit, &default_config.max_mem));
+  default_config.max_queued = FLAGS_default_pool_max_queued;
+  SetPoolConfig(DEFAULT_POOL, default_config);
+
+  vector<string> pool_specs;
+  split(pool_specs, FLAGS_admission_pools, is_any_of(","), token_compress_on);
+  BOOST_FOREACH(const string& pool_spec, pool_specs) {
+    if (trim_copy(pool_spec).empty()) continue;
+    vector<string> fields;
+    split(fields, pool_spec, is_any_of(":"));
+    if (fields.size() < 3 || fields.size() > 4 || trim_copy(fields[0]).empty()) {
+      return Status("Invalid request pool '" + pool_spec + "' in --admission_pools, "
+          "expected <name>:<max requests>:<max mem>[:<max queued>].");
+    }
+    PoolConfig config;
+    StringParser::ParseResult result;
+    config.max_requests = StringParser::StringToInt<int64_t>(
+        fields[1].c_str(), fields[1].size(), &result);
+    if (result != StringParser::PARSE_SUCCESS) {
+      return Status("Invalid max requests in request pool '" + pool_spec + "'.");
+    }
+    RETURN_IF_ERROR(ParseMemLimit(fields[2], &config.max_mem));
+    if (fields.size() == 4) {
+      config.max_queued = StringParser::StringToInt<int64_t>(
+          fields[3].c_str(), fields[3].size(), &result);
+      if (result != StringParser::PARSE_SUCCESS) {
+        return Status("Invalid max queued in request pool '" + pool_spec + "'.");
+      }
+    } else {
+      config.max_queued = FLAGS_default_pool_max_queued;
+    }
+    SetPoolConfig(trim_copy(fields[0]), config);
+  }
+  return Status::OK;
+}
+
+void AdmissionController::SetPoolConfig(const string& name, const PoolConfig& config) {
+  lock_guard<mutex> l(lock_);
+  PoolMap::iterator it = pools_.find(name);
+  Pool* pool;
+  if (it == pools_.end()) {
+    pool = obj_pool_.Add(new Pool(name));
+    pools_[name] = pool;
+    if (metrics_ != NULL) {
+      string prefix = "admission-controller." + name + ".";
+      pool->num_running_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "num-running", 0L);
+      pool->num_queued_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "num-queued", 0L);
+      pool->mem_admitted_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "mem-admitted", 0L);
+      pool->total_admitted_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "total-admitted", 0L);
+      pool->total_rejected_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "total-rejected", 0L);
+      pool->total_timed_out_metric =
+          metrics_->CreateAndRegisterPrimitiveMetric(prefix + "total-timed-out", 0L);
+    }
+  } else {
+    pool = it->second;
+  }
+  pool->config = config;
+  LOG(INFO) << "Request pool " << name << ": max requests=" << config.max_requests
+            << " max mem=" << config.max_mem << " max queued=" << config.max_queued;
+  DequeueQueries(pool);
+}
+
+bool AdmissionController::CanAdmit(const Pool& pool, int64_t mem_estimate) {
+  if (pool.config.max_requests >= 0 && pool.num_running >= pool.config.max_requests) {
+    return false;
+  }
+  if (pool.config.max_mem >= 0 && pool.num_running > 0 &&
+      pool.mem_admitted + mem_estimate > pool.config.max_mem) {
+    return false;
+  }
+  return true;
+}
+
+void AdmissionController::Admit(Pool* pool, const TUniqueId& query_id,
+    int64_t mem_estimate) {
+  ++pool->num_running;
+  pool->mem_admitted += mem_estimate;
+  ++pool->total_admitted;
+  if (pool->total_admitted_metric != NULL) pool->total_admitted_metric->Increment(1L);
+  admitted_queries_[query_id] = make_pair(pool, mem_estimate);
+  UpdatePoolMetrics(pool);
+}
+
+void AdmissionController::RemoveQueuedQuery(Pool* pool, QueuedQuery* query) {
+  pool->queue.remove(query);
+  queued_queries_.erase(query->query_id);
+  if (ImpaladMetrics::NUM_QUEUED_QUERIES != NULL) {
+    ImpaladMetrics::NUM_QUEUED_QUERIES->Increment(-1L);
+  }
+}
+
+void AdmissionController::DequeueQueries(Pool* pool) {
+  while (!pool->queue.empty() && CanAdmit(*pool, pool->queue.front()->mem_estimate)) {
+    QueuedQuery* query = pool->queue.front();
+    RemoveQueuedQuery(pool, query);
+    Admit(pool, query->query_id, query->mem_estimate);
+    query->admitted = true;
+    query->cv.notify_one();
+  }
+  UpdatePoolMetrics(pool);
+}
+
+void AdmissionController::UpdatePoolMetrics(Pool* pool) {
+  if (pool->num_running_metric == NULL) return;
+  pool->num_running_metric->Update(pool->num_running);
+  pool->num_queued_metric->Update(pool->queue.size());
+  pool->mem_admitted_metric->Update(pool->mem_admitted);
+}
+
+Status AdmissionController::AdmitQuery(const TUniqueId& query_id,
+    const string& pool_name, int64_t mem_estimate, RuntimeProfile* profile) {
+  const string& name = pool_name.empty() ? DEFAULT_POOL : pool_name;
+  if (profile != NULL) {
+    profile->AddInfoString("Request Pool", name);
+    profile->AddInfoString("Estimated Per-Host Mem",
+        PrettyPrinter::Print(mem_estimate, TCounterType::BYTES));
+  }
+
+  unique_lock<mutex> l(lock_);
+  PoolMap::iterator it = pools_.find(name);
+  if (it == pools_.end()) {
+    return Status("Unknown request pool '" + name + "'.");
+  }
+  Pool* pool = it->second;
+
+  // Queries that are already waiting go first
+  if (pool->queue.empty() && CanAdmit(*pool, mem_estimate)) {
+    Admit(pool, query_id, mem_estimate);
+    SetAdmissionResult(profile, "Admitted immediately");
+    return Status::OK;
+  }
+
+  if (pool->config.max_queued >= 0 && pool->queue.size() >= pool->config.max_queued) {
+    ++pool->total_rejected;
+    if (pool->total_rejected_metric != NULL) pool->total_rejected_metric->Increment(1L);
+    if (ImpaladMetrics::NUM_REJECTED_QUERIES != NULL) {
+      ImpaladMetrics::NUM_REJECTED_QUERIES->Increment(1L);
+    }
+    SetAdmissionResult(profile, "Rejected");
+    stringstream ss;
+    ss << "Rejected query from pool " << name << ": queue full, limit="
+       << pool->config.max_queued << ", num_queued=" << pool->queue.size();
+    return Status(ss.str());
+  }
+
+  VLOG_QUERY << "Queuing query " << PrintId(query_id) << " in pool " << name
+             << ": num_running=" << pool->num_running
+             << " mem_admitted=" << pool->mem_admitted
+             << " mem_estimate=" << mem_estimate;
+  QueuedQuery query(query_id, mem_estimate);
+  pool->queue.push_back(&query);
+  queued_queries_[query_id] = make_pair(pool, &query);
+  ++pool->total_queued;
+  if (ImpaladMetrics::NUM_QUEUED_QUERIES != NULL) {
+    ImpaladMetrics::NUM_QUEUED_QUERIES->Increment(1L);
+  }
+  UpdatePoolMetrics(pool);
+
+  MonotonicStopWatch queue_timer;
+  queue_timer.Start();
+  system_time deadline =
+      get_system_time() + posix_time::milliseconds(FLAGS_queue_wait_timeout_ms);
+  while (!query.admitted && !query.cancelled) {
+    // timed_wait() may return early or be signalled after the deadline, so the
+    // deadline is checked separately
+    if (!query.cv.timed_wait(l, deadline) && get_system_time() >= deadline) break;
+  }
+  int64_t wait_ms = queue_timer.ElapsedTime() / 1000000;
+  pool->total_queue_wait_ms += wait_ms;
+  if (ImpaladMetrics::QUERY_QUEUE_WAIT_MS != NULL) {
+    ImpaladMetrics::QUERY_QUEUE_WAIT_MS->Increment(wait_ms);
+  }
+  if (profile != NULL) {
+    profile->AddInfoString("Admission wait",
+        PrettyPrinter::Print(wait_ms * 1000000L, TCounterType::TIME_NS));
+  }
+  if (query.admitted) {
+    SetAdmissionResult(profile, "Admitted (queued)");
+    return Status::OK;
+  }
+  if (query.cancelled) {
+    SetAdmissionResult(profile, "Cancelled (queued)");
+    return Status::CANCELLED;
+  }
+
+  // Timed out, the query is still queued.  The queries behind it may fit now.
+  RemoveQueuedQuery(pool, &query);
+  DequeueQueries(pool);
+  ++pool->total_timed_out;
+  if (pool->total_timed_out_metric != NULL) pool->total_timed_out_metric->Increment(1L);
+  SetAdmissionResult(profile, "Timed out (queued)");
+  stringstream ss;
+  ss << "Query " << PrintId(query_id) << " timed out after waiting "
+     << FLAGS_queue_wait_timeout_ms << "ms for admission to pool " << name;
+  return Status(ss.str());
+}
+
+void AdmissionController::ReleaseQuery(const TUniqueId& query_id) {
+  lock_guard<mutex> l(lock_);
+  AdmittedQueryMap::iterator it = admitted_queries_.find(query_id);
+  if (it == admitted_queries_.end()) return;
+  Pool* pool = it->second.first;
+  --pool->num_running;
+  pool->mem_admitted -= it->second.second;
+  admitted_queries_.erase(it);
+  DequeueQueries(pool);
+}
+
+void AdmissionController::CancelQueuedQuery(const TUniqueId& query_id) {
+  lock_guard<mutex> l(lock_);
+  QueuedQueryMap::iterator it = queued_queries_.find(query_id);
+  if (it == queued_queries_.end()) return;
+  Pool* pool = it->second.first;
+  QueuedQuery* query = it->second.second;
+  RemoveQueuedQuery(pool, query);
+  query->cancelled = true;
+  query->cv.notify_one();
+  // The queries behind it may fit now
+  DequeueQueries(pool);
+}
+
+bool AdmissionController::GetPoolStats(const string& name, int64_t* num_running,
+    int64_t* num_queued, int64_t* mem_admitted) {
+  lock_guard<mutex> l(lock_);
+  PoolMap::iterator it = pools_.find(name);
+  if (it == pools_.end()) return false;
+  *num_running = it->second->num_running;
+  *num_queued = it->second->queue.size();
+  *mem_admitted = it->second->mem_admitted;
+  return true;
+}
+
+int64_t AdmissionController::EstimateQueryMem(const TQueryExecRequest& request,
+    const TQueryOptions& query_options) {
+  if (query_options.mem_limit > 0) return query_options.mem_limit;
+  int64_t scan_mem;
+  int64_t blocking_node_mem;
+  // The flags are checked when the pools are set up, bad values count as 0 here
+  if (!ParseMemLimit(FLAGS_admission_scan_mem_estimate, &scan_mem).ok()) scan_mem = 0;
+  if (!ParseMemLimit(FLAGS_admission_blocking_node_mem_estimate,
+          &blocking_node_mem).ok()) {
+    blocking_node_mem = 0;
+  }
+  if (scan_mem < 0) scan_mem = 0;
+  if (blocking_node_mem < 0) blocking_node_mem = 0;
+
+  int64_t result = 0;
+  for (int i = 0; i < request.fragments.size(); ++i) {
+    const TPlanFragment& fragment = request.fragments[i];
+    if (!fragment.__isset.plan) continue;
+    int64_t fragment_mem = 0;
+    for (int j = 0; j < fragment.plan.nodes.size(); ++j) {
+      switch (fragment.plan.nodes[j].node_type) {
+        case TPlanNodeType::HDFS_SCAN_NODE:
+        case TPlanNodeType::HBASE_SCAN_NODE:
+          fragment_mem += scan_mem;
+          break;
+        case TPlanNodeType::HASH_JOIN_NODE:
+        case TPlanNodeType::AGGREGATION_NODE:
+        case TPlanNodeType::SORT_NODE:
+          fragment_mem += blocking_node_mem;
+          break;
+        default:
+          break;
+      }
+    }
+    // Partitioned fragments may run several instances per host
+    if (fragment.partition.type != TPartitionType::UNPARTITIONED) {
+      fragment_mem *= max(1, query_options.num_instances_per_host);
+    }
+    result += fragment_mem;
+  }
+  return result;
+}
+
+void AdmissionController::PoolsPathHandler(const Webserver::ArgumentMap& args,
+    stringstream* output) {
+  lock_guard<mutex> l(lock_);
+  (*output) << "<h2>Request Pools</h2>" << endl
+            << "<table class='table table-bordered table-hover'>"
+            << "<tr><th>Pool</th>"
+            << "<th>Max Requests</th>"
+            << "<th>Max Mem</th>"
+            << "<th>Max Queued</th>"
+            << "<th>Running</th>"
+            << "<th>Admitted Mem</th>"
+            << "<th>Queued</th>"
+            << "<th>Total Admitted</th>"
+            << "<th>Total Queued</th>"
+            << "<th>Total Rejected</th>"
+            << "<th>Total Timed Out</th>"
+            << "<th>Avg Queue Wait</th></tr>" << endl;
+  BOOST_FOREACH(const PoolMap::value_type& entry, pools_) {
+    const Pool& pool = *entry.second;
+    (*output) << "<tr><td>" << pool.name << "</td><td>";
+    if (pool.config.max_requests >= 0) {
+      (*output) << pool.config.max_requests;
+    } else {
+      (*output) << "unlimited";
+    }
+    (*output) << "</td><td>";
+    if (pool.config.max_mem >= 0) {
+      (*output) << PrettyPrinter::Print(pool.config.max_mem, TCounterType::BYTES);
+    } else {
+      (*output) << "unlimited";
+    }
+    (*output) << "</td><td>";
+    if (pool.config.max_queued >= 0) {
+      (*output) << pool.config.max_queued;
+    } else {
+      (*output) << "unlimited";
+    }
+    int64_t avg_wait_ms =
+        pool.total_queued == 0 ? 0 : pool.total_queue_wait_ms / pool.total_queued;
+    (*output) << "</td><td>" << pool.num_running
+              << "</td><td>"
+              << PrettyPrinter::Print(pool.mem_admitted, TCounterType::BYTES)
+              << "</td><td>" << pool.queue.size()
+              << "</td><td>" << pool.total_admitted
+              << "</td><td>" << pool.total_queued
+              << "</td><td>" << pool.total_rejected
+              << "</td><td>" << pool.total_timed_out
+              << "</td><td>"
+              << PrettyPrinter::Print(avg_wait_ms * 1000000L, TCounterType::TIME_NS)
+              << "</td></tr>" << endl;
+  }
+  (*output) << "</table>" << endl;
+
+  (*output) << "<h2>Queued Queries</h2>" << endl
+            << "<table class='table table-bordered table-hover'>"
+            << "<tr><th>Pool</th><th>Query Id</th><th>Mem Estimate</th></tr>" << endl;
+  BOOST_FOREACH(const PoolMap::value_type& entry, pools_) {
+    BOOST_FOREACH(const QueuedQuery* query, entry.second->queue) {
+      (*output) << "<tr><td>" << entry.first << "</td><td>" << PrintId(query->query_id)
+                << "</td><td>"
+                << PrettyPrinter::Print(query->mem_estimate, TCounterType::BYTES)
+                << "</td></tr>" << endl;
+    }
+  }
+  (*output) << "</table>" << endl;
+}
+
+}
@@ -0,0 +1,201 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_STATESTORE_ADMISSION_CONTROLLER_H
+#define IMPALA_STATESTORE_ADMISSION_CONTROLLER_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <sstream>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "common/object-pool.h"
+#include "common/status.h"
+#include "util/metrics.h"
+#include "util/uid-util.h"
+#include "util/webserver.h"
+#include "gen-cpp/Types_types.h"  // for TUniqueId
+
+namespace impala {
+
+class RuntimeProfile;
+class TQueryExecRequest;
+class TQueryOptions;
+
+// Decides whether queries submitted to this impalad may start executing.  Queries are
+// submitted to a named request pool (the REQUEST_POOL query option, or DEFAULT_POOL).
+// Each pool can limit the number of its queries that run concurrently and the sum of
+// their memory estimates (see EstimateQueryMem()).  A query that doesn't fit is queued
+// until enough of the pool's running queries finish; queued queries are admitted in
+// FIFO order.  A query is rejected right away if the pool's queue is full, and fails if
+// it stays queued for longer than --queue_wait_timeout_ms.
+// Pools are configured with --admission_pools; the default pool with the
+// --default_pool_* flags.  By default no pool has any limits.
+// The limits only apply to the queries coordinated by this impalad; the memory
+// estimates are per host, i.e. they are compared against what the queries would use on
+// each impalad they run on.
+// Thread-safe.
+class AdmissionController {
+ public:
+  // Pool that queries are submitted to if they don't specify one
+  static const std::string DEFAULT_POOL;
+
+  // Limits of a pool; values < 0 mean no limit.
+  struct PoolConfig {
+    // Max number of queries running at the same time
+    int64_t max_requests;
+    // Max sum of the memory estimates of the running queries
+    int64_t max_mem;
+    // Max number of queued queries
+    int64_t max_queued;
+
+    PoolConfig() : max_requests(-1), max_mem(-1), max_queued(-1) { }
+  };
+
+  // If 'metrics' is non-NULL, per-pool metrics are registered with it.
+  AdmissionController(Metrics* metrics);
+
+  ~AdmissionController();
+
+  // Creates the pools configured with flags.  Returns an error if --admission_pools
+  // can't be parsed.
+  Status Init();
+
+  // Creates pool 'name' or changes its limits.  Queued queries that fit into the new
+  // limits are admitted.
+  void SetPoolConfig(const std::string& name, const PoolConfig& config);
+
+  // Blocks until query 'query_id' can run in pool 'pool_name' given its memory estimate
+  // (per host).  Returns an error if the pool doesn't exist, the pool's queue is full,
+  // the query timed out in the queue or it was cancelled with CancelQueuedQuery().
+  // If the query is admitted, ReleaseQuery() must be called when it is done.
+  // If 'profile' is non-NULL, the pool and the outcome are added to it as info strings.
+  // A query that is larger than the pool's memory limit is admitted when no other
+  // query of the pool is running, since it would never fit otherwise.
+  Status AdmitQuery(const TUniqueId& query_id, const std::string& pool_name,
+      int64_t mem_estimate, RuntimeProfile* profile);
+
+  // Returns the resources of an admitted query to its pool and admits queued queries
+  // that fit now.  Does nothing if the query wasn't admitted.
+  void ReleaseQuery(const TUniqueId& query_id);
+
+  // Makes AdmitQuery() return an error for 'query_id' if it is queued.  Does nothing
+  // otherwise.
+  void CancelQueuedQuery(const TUniqueId& query_id);
+
+  // Returns an estimate of the memory the query needs on each host it runs on: its
+  // MEM_LIMIT if that is set, otherwise a fixed amount per scan and per join,
+  // aggregation and sort (see the --admission_*_mem_estimate flags), summed over all
+  // fragment instances that can run on one host.
+  static int64_t EstimateQueryMem(const TQueryExecRequest& request,
+      const TQueryOptions& query_options);
+
+  // Webserver callback that lists the pools with their limits, usage and queues
+  void PoolsPathHandler(const Webserver::ArgumentMap& args, std::stringstream* output);
+
+  // Returns the number of running and queued queries of pool 'name' and the sum of the
+  // memory estimates of the running ones, for tests.  Returns false if the pool
+  // doesn't exist.
+  bool GetPoolStats(const std::string& name, int64_t* num_running, int64_t* num_queued,
+      int64_t* mem_admitted);
+
+ private:
+  // A query waiting in a pool's queue
+  struct QueuedQuery {
+    TUniqueId query_id;
+    int64_t mem_estimate;
+    // Set when the query is admitted resp. cancelled while queued
+    bool admitted;
+    bool cancelled;
+    // Signalled when admitted or cancelled is set
+    boost::condition_variable cv;
+
+    QueuedQuery(const TUniqueId& query_id, int64_t mem_estimate)
+      : query_id(query_id), mem_estimate(mem_estimate), admitted(false),
+        cancelled(false) {
+    }
+  };
+
+  struct Pool {
+    std::string name;
+    PoolConfig config;
+
+    // Number and summed memory estimates of the running queries
+    int64_t num_running;
+    int64_t mem_admitted;
+
+    // In the order of submission
+    std::list<QueuedQuery*> queue;
+
+    // Totals since startup
+    int64_t total_admitted;
+    int64_t total_queued;
+    int64_t total_rejected;
+    int64_t total_timed_out;
+    int64_t total_queue_wait_ms;
+
+    // NULL if metrics_ is NULL
+    Metrics::IntMetric* num_running_metric;
+    Metrics::IntMetric* num_queued_metric;
+    Metrics::IntMetric* mem_admitted_metric;
+    Metrics::IntMetric* total_admitted_metric;
+    Metrics::IntMetric* total_rejected_metric;
+    Metrics::IntMetric* total_timed_out_metric;
+
+    Pool(const std::string& name);
+  };
+
+  // Returns true if a query with the given memory estimate can run in 'pool' now
+  static bool CanAdmit(const Pool& pool, int64_t mem_estimate);
+
+  // Adds a query to the running queries of 'pool'.  Caller must hold lock_.
+  void Admit(Pool* pool, const TUniqueId& query_id, int64_t mem_estimate);
+
+  // Removes 'query' from the queue of 'pool'.  Caller must hold lock_.
+  void RemoveQueuedQuery(Pool* pool, QueuedQuery* query);
+
+  // Admits queries from the front of the queue of 'pool' as long as they fit.  Caller
+  // must hold lock_.
+  void DequeueQueries(Pool* pool);
+
+  // Sets the gauge metrics of 'pool'.  Caller must hold lock_.
+  void UpdatePoolMetrics(Pool* pool);
+
+  Metrics* metrics_;
+
+  // Protects all following fields
+  boost::mutex lock_;
+
+  // Pools by name, owned by obj_pool_
+  typedef std::map<std::string, Pool*> PoolMap;
+  PoolMap pools_;
+  ObjectPool obj_pool_;
+
+  // Pool and memory estimate of the admitted queries
+  typedef boost::unordered_map<TUniqueId, std::pair<Pool*, int64_t> > AdmittedQueryMap;
+  AdmittedQueryMap admitted_queries_;
+
+  // Queued queries and their pool
+  typedef boost::unordered_map<TUniqueId, std::pair<Pool*, QueuedQuery*> >
+      QueuedQueryMap;
+  QueuedQueryMap queued_queries_;
+};
+
+}
+
+#endif
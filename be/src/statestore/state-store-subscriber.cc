@@ -56,7 +56,10 @@ class StateStoreSubscriberThriftIf : public StateStoreSubscriberIf {
       : subscriber_(subscriber) { DCHECK(subscriber != NULL); }
   virtual void UpdateState(TUpdateStateResponse& response,
                            const TUpdateStateRequest& params) {
-    subscriber_->UpdateState(params.topic_deltas, &response.topic_updates);
+    map<StateStore::TopicId, int64_t> topic_versions;
+    subscriber_->UpdateState(params.topic_deltas, &response.topic_updates,
+                             &topic_versions);
+    if (!topic_versions.empty()) response.__set_topic_versions(topic_versions);
     Status::OK.ToThrift(&response.status);
   }
 
@@ -86,6 +89,8 @@ StateStoreSubscriber::StateStoreSubscriber(const std::string& subscriber_id,
   heartbeat_duration_metric_ =
       metrics->RegisterMetric(
           new StatsMetric<double>("statestore-subscriber.heartbeat-duration", 0.0));
+  topic_resyncs_metric_ = metrics->CreateAndRegisterPrimitiveMetric(
+      "statestore-subscriber.topic-resyncs", 0L);
   client_cache_->InitMetrics(metrics, "statestore-subscriber.statestore");
 }
 
@@ -199,8 +204,37 @@ void StateStoreSubscriber::RecoveryModeChecker() {
   }
 }
 
+bool StateStoreSubscriber::ApplyTopicDelta(const TTopicDelta& delta) {
+  Topic& topic = topics_[delta.topic_name];
+  if (!delta.is_delta) {
+    topic.entries.clear();
+  } else if (!delta.__isset.from_version || delta.from_version > topic.version) {
+    // Some changes are missing, e.g. because an update was ignored in recovery mode.
+    // A delta from an older version (e.g. because our last response to the
+    // state-store was lost) is fine: it repeats changes we already have, with the
+    // latest value of each entry.
+    VLOG(1) << "Topic " << delta.topic_name << " is at version " << topic.version
+            << ", can't apply delta from version " << delta.from_version;
+    // Keep the last consistent copy until the entire topic is sent again
+    topic.version = 0L;
+    topic_resyncs_metric_->Increment(1L);
+    return false;
+  }
+
+  BOOST_FOREACH(const TTopicItem& item, delta.topic_entries) {
+    topic.entries[item.key] = item.value;
+  }
+  BOOST_FOREACH(const string& key, delta.topic_deletions) {
+    topic.entries.erase(key);
+  }
+  // A state-store that doesn't send versions sends the entire topic every time
+  topic.version = delta.__isset.to_version ? delta.to_version : 0L;
+  return true;
+}
+
 void StateStoreSubscriber::UpdateState(const TopicDeltaMap& topic_deltas,
-    vector<TTopicUpdate>* topic_updates) {
+    vector<TTopicUpdate>* topic_updates,
+    map<StateStore::TopicId, int64_t>* topic_versions) {
   failure_detector_->UpdateHeartbeat(STATE_STORE_ID, true);
 
   // We don't want to block here because this is an RPC, and delaying
@@ -215,10 +249,29 @@ void StateStoreSubscriber::UpdateState(const TopicDeltaMap& topic_deltas,
         heartbeat_interval_timer_.Reset() / (1000.0 * 1000.0 * 1000.0));
     MonotonicStopWatch sw;
     sw.Start();
+    // The entire contents of each topic. A topic that could not be updated is
+    // passed as it was before this heartbeat.
+    TopicDeltaMap topic_state;
+    BOOST_FOREACH(const TopicDeltaMap::value_type& delta, topic_deltas) {
+      ApplyTopicDelta(delta.second);
+      const Topic& topic = topics_[delta.first];
+      (*topic_versions)[delta.first] = topic.version;
+
+      TTopicDelta& state = topic_state[delta.first];
+      state.topic_name = delta.first;
+      state.is_delta = false;
+      state.topic_entries.reserve(topic.entries.size());
+      typedef map<string, string> Entries;
+      BOOST_FOREACH(const Entries::value_type& entry, topic.entries) {
+        state.topic_entries.push_back(TTopicItem());
+        state.topic_entries.back().key = entry.first;
+        state.topic_entries.back().value = entry.second;
+      }
+    }
     BOOST_FOREACH(const UpdateCallbacks::value_type& callbacks, update_callbacks_) {
       BOOST_FOREACH(const UpdateCallback& callback, callbacks.second) {
         // TODO: Consider filtering the topics to only send registered topics to callbacks
-        callback(topic_deltas, topic_updates);
+        callback(topic_state, topic_updates);
       }
     }
     sw.Stop();
@@ -91,6 +91,14 @@ class StateStoreSubscriber {
   // state-store failure, and usually clients will need to republish
   // any local state that is missing.
   //
+  // The state-store sends only the changes to each topic, but the
+  // subscriber applies them to its own copy of the topic and passes
+  // the entire topic to callbacks, so callbacks currently always
+  // receive deltas without the 'is_delta' flag. If the copy of a topic
+  // could not be updated (e.g. because an update was missed), the
+  // last copy that could be is passed until the state-store has sent
+  // the topic again in its entirety.
+  //
   // Callbacks may publish new updates to any topic via the
   // topic_updates parameter, although updates for unknown topics
   // (i.e. those with no subscribers) will be ignored.
@@ -179,6 +187,27 @@ class StateStoreSubscriber {
   // Tracks the time between heartbeats
   MonotonicStopWatch heartbeat_interval_timer_;
 
+  // The subscriber's copy of a topic, updated with the deltas sent
+  // by the state-store.
+  struct Topic {
+    // The version of the topic the entries are at. 0 if the entire
+    // topic has to be sent again, in which case the entries are the
+    // last consistent copy of the topic.
+    int64_t version;
+
+    // Map from topic entry key to value
+    std::map<std::string, std::string> entries;
+
+    Topic() : version(0L) { }
+  };
+
+  // Copies of all topics that updates have been received for
+  boost::unordered_map<StateStore::TopicId, Topic> topics_;
+
+  // Number of deltas that could not be applied to the copy of their
+  // topic, after which the state-store is asked for the entire topic
+  Metrics::IntMetric* topic_resyncs_metric_;
+
   // Accumulated statistics on the time taken to process each
   // heartbeat from the state-store (that is, to call all
   // callbacks)
@@ -186,14 +215,25 @@ class StateStoreSubscriber {
 
   // Subscriber thrift implementation, needs to access UpdateState
   friend class StateStoreSubscriberThriftIf;
+  friend class StateStoreSubscriberTest;
 
-  // Called when the state-store sends a heartbeat. Each registered
-  // callback is called in turn with the given list of topic deltas,
-  // and any updates are aggregated in topic_updates.
+  // Called when the state-store sends a heartbeat. The topic deltas
+  // are applied to topics_, then each registered callback is called
+  // in turn with the entire topics, and any updates are aggregated
+  // in topic_updates. The version of each topic after the update is
+  // returned in topic_versions.
   // If the subscriber is in recovery mode, this method returns
   // immediately.
   void UpdateState(const TopicDeltaMap& topic_deltas,
-      std::vector<TTopicUpdate>* topic_updates);
+      std::vector<TTopicUpdate>* topic_updates,
+      std::map<StateStore::TopicId, int64_t>* topic_versions);
+
+  // Applies 'delta' to the copy of its topic. Returns false if it
+  // can't be applied because the copy is older than the version the
+  // delta starts from, in which case the copy is left as it is and
+  // its version is reset to 0.
+  // Must be called holding lock_.
+  bool ApplyTopicDelta(const TTopicDelta& delta);
 
   // Run in a separate thread. In a loop, check failure_detector_ to see if the
   // state-store is still sending heartbeats. If not, enter 'recovery mode'
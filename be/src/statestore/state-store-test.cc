@@ -0,0 +1,295 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/logging.h"
+#include "statestore/state-store.h"
+#include "statestore/state-store-subscriber.h"
+#include "util/metrics.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+class StateStoreTest : public testing::Test {
+ protected:
+  typedef StateStore::Topic Topic;
+};
+
+// Tests of the subscriber's copies of the topics, with deltas built by a StateStore
+// topic
+class StateStoreSubscriberTest : public StateStoreTest {
+ protected:
+  Metrics metrics_;
+  scoped_ptr<StateStoreSubscriber> subscriber_;
+
+  virtual void SetUp() {
+    subscriber_.reset(new StateStoreSubscriber("test-subscriber", TNetworkAddress(),
+        TNetworkAddress(), &metrics_));
+  }
+
+  bool ApplyTopicDelta(const TTopicDelta& delta) {
+    return subscriber_->ApplyTopicDelta(delta);
+  }
+
+  // The subscriber's copy of 'topic_id'
+  const map<string, string>& TopicEntries(const string& topic_id) {
+    return subscriber_->topics_[topic_id].entries;
+  }
+
+  int64_t TopicVersion(const string& topic_id) {
+    return subscriber_->topics_[topic_id].version;
+  }
+
+  int64_t NumTopicResyncs() { return subscriber_->topic_resyncs_metric_->value(); }
+
+  // Sends 'topic_deltas' to the subscriber as a heartbeat would, and returns the
+  // versions the subscriber reports.
+  map<StateStore::TopicId, int64_t> UpdateState(
+      const StateStoreSubscriber::TopicDeltaMap& topic_deltas) {
+    vector<TTopicUpdate> topic_updates;
+    map<StateStore::TopicId, int64_t> topic_versions;
+    subscriber_->UpdateState(topic_deltas, &topic_updates, &topic_versions);
+    return topic_versions;
+  }
+
+  // The topics passed to the last call of RecordState()
+  StateStoreSubscriber::TopicDeltaMap callback_state_;
+
+  // Update callback that records the topics it is passed
+  void RecordState(const StateStoreSubscriber::TopicDeltaMap& state,
+      vector<TTopicUpdate>* topic_updates) {
+    callback_state_ = state;
+  }
+};
+
+// Returns the entries of 'delta' by key
+static map<string, string> GetEntries(const TTopicDelta& delta) {
+  map<string, string> entries;
+  for (int i = 0; i < delta.topic_entries.size(); ++i) {
+    entries[delta.topic_entries[i].key] = delta.topic_entries[i].value;
+  }
+  return entries;
+}
+
+TEST_F(StateStoreTest, BuildDelta) {
+  Topic topic("topic");
+  EXPECT_EQ(topic.Put("a", "1"), 1);
+  EXPECT_EQ(topic.Put("b", "2"), 2);
+  EXPECT_EQ(topic.Put("c", "3"), 3);
+
+  TTopicDelta full;
+  EXPECT_EQ(topic.BuildDelta(0L, &full), 6);
+  EXPECT_FALSE(full.is_delta);
+  EXPECT_EQ(full.to_version, 3);
+  EXPECT_EQ(full.topic_entries.size(), 3);
+  EXPECT_TRUE(full.topic_deletions.empty());
+
+  // Update one entry and delete another
+  topic.Put("b", "22");
+  topic.DeleteIfVersionsMatch(3, "c");
+  EXPECT_EQ(topic.last_version(), 5);
+
+  TTopicDelta delta;
+  EXPECT_EQ(topic.BuildDelta(3L, &delta), 4);
+  EXPECT_TRUE(delta.is_delta);
+  EXPECT_EQ(delta.from_version, 3);
+  EXPECT_EQ(delta.to_version, 5);
+  map<string, string> entries = GetEntries(delta);
+  EXPECT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries["b"], "22");
+  ASSERT_EQ(delta.topic_deletions.size(), 1);
+  EXPECT_EQ(delta.topic_deletions[0], "c");
+
+  // Deleted entries are left out of the entire topic
+  TTopicDelta full_after_delete;
+  topic.BuildDelta(0L, &full_after_delete);
+  EXPECT_FALSE(full_after_delete.is_delta);
+  entries = GetEntries(full_after_delete);
+  EXPECT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries["a"], "1");
+  EXPECT_EQ(entries["b"], "22");
+  EXPECT_TRUE(full_after_delete.topic_deletions.empty());
+
+  // Nothing changed after the last version
+  TTopicDelta empty_delta;
+  EXPECT_EQ(topic.BuildDelta(5L, &empty_delta), 0);
+  EXPECT_TRUE(empty_delta.is_delta);
+  EXPECT_TRUE(empty_delta.topic_entries.empty());
+  EXPECT_TRUE(empty_delta.topic_deletions.empty());
+}
+
+// The version index only holds the latest version of each entry.  A subscriber whose
+// version is older than all of them still gets every entry that changed since.
+TEST_F(StateStoreTest, BuildDeltaFromOldVersion) {
+  Topic topic("topic");
+  topic.Put("a", "1");
+  topic.Put("b", "2");
+  topic.Put("a", "11");
+  topic.Put("b", "22");
+  topic.Put("c", "3");
+
+  TTopicDelta delta;
+  topic.BuildDelta(1L, &delta);
+  EXPECT_TRUE(delta.is_delta);
+  map<string, string> entries = GetEntries(delta);
+  EXPECT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries["a"], "11");
+  EXPECT_EQ(entries["b"], "22");
+  EXPECT_EQ(entries["c"], "3");
+}
+
+// A subscriber that is ahead of the topic (the state-store restarted since it
+// registered) gets the entire topic
+TEST_F(StateStoreTest, BuildDeltaFromFutureVersion) {
+  Topic topic("topic");
+  topic.Put("a", "1");
+  topic.Put("b", "2");
+
+  TTopicDelta delta;
+  EXPECT_EQ(topic.BuildDelta(10L, &delta), 4);
+  EXPECT_FALSE(delta.is_delta);
+  EXPECT_EQ(delta.from_version, 0);
+  EXPECT_EQ(delta.to_version, 2);
+  EXPECT_EQ(delta.topic_entries.size(), 2);
+}
+
+TEST_F(StateStoreSubscriberTest, ApplyTopicDelta) {
+  Topic topic("topic");
+  topic.Put("a", "1");
+  topic.Put("b", "2");
+  TTopicDelta full;
+  topic.BuildDelta(0L, &full);
+  EXPECT_TRUE(ApplyTopicDelta(full));
+  EXPECT_EQ(TopicVersion("topic"), 2);
+  EXPECT_EQ(TopicEntries("topic").size(), 2);
+
+  topic.Put("c", "3");
+  topic.DeleteIfVersionsMatch(1, "a");
+  TTopicDelta delta;
+  topic.BuildDelta(TopicVersion("topic"), &delta);
+  EXPECT_TRUE(ApplyTopicDelta(delta));
+  EXPECT_EQ(TopicVersion("topic"), 4);
+  map<string, string> entries = TopicEntries("topic");
+  EXPECT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries["b"], "2");
+  EXPECT_EQ(entries["c"], "3");
+}
+
+// A delta that starts after the subscriber's version can't be applied.  The subscriber
+// keeps its copy and reports version 0, so that the state-store sends the entire topic
+// next.
+TEST_F(StateStoreSubscriberTest, VersionGap) {
+  Topic topic("topic");
+  topic.Put("a", "1");
+  TTopicDelta full;
+  topic.BuildDelta(0L, &full);
+  EXPECT_TRUE(ApplyTopicDelta(full));
+  EXPECT_EQ(TopicVersion("topic"), 1);
+
+  // The update from version 1 to 2 is missed
+  topic.Put("b", "2");
+  topic.Put("c", "3");
+  TTopicDelta delta;
+  topic.BuildDelta(2L, &delta);
+  EXPECT_FALSE(ApplyTopicDelta(delta));
+  EXPECT_EQ(TopicVersion("topic"), 0);
+  EXPECT_EQ(TopicEntries("topic").size(), 1);
+  EXPECT_EQ(NumTopicResyncs(), 1);
+
+  TTopicDelta resync;
+  topic.BuildDelta(TopicVersion("topic"), &resync);
+  EXPECT_FALSE(resync.is_delta);
+  EXPECT_TRUE(ApplyTopicDelta(resync));
+  EXPECT_EQ(TopicVersion("topic"), 3);
+  EXPECT_EQ(TopicEntries("topic").size(), 3);
+}
+
+// The state-store sends a delta from an older version than the subscriber's if it
+// missed the subscriber's response to the last heartbeat.  The delta repeats changes
+// that were already applied, and can be applied again.
+TEST_F(StateStoreSubscriberTest, OlderFromVersion) {
+  Topic topic("topic");
+  topic.Put("a", "1");
+  topic.Put("b", "2");
+  TTopicDelta full;
+  topic.BuildDelta(0L, &full);
+  EXPECT_TRUE(ApplyTopicDelta(full));
+  EXPECT_EQ(TopicVersion("topic"), 2);
+
+  topic.Put("c", "3");
+  TTopicDelta delta;
+  topic.BuildDelta(2L, &delta);
+  EXPECT_TRUE(ApplyTopicDelta(delta));
+  EXPECT_EQ(TopicVersion("topic"), 3);
+
+  // The response with version 3 is lost
+  topic.Put("a", "4");
+  topic.DeleteIfVersionsMatch(2, "b");
+  TTopicDelta older_delta;
+  topic.BuildDelta(2L, &older_delta);
+  EXPECT_TRUE(older_delta.is_delta);
+  EXPECT_TRUE(ApplyTopicDelta(older_delta));
+  EXPECT_EQ(TopicVersion("topic"), 5);
+  EXPECT_EQ(NumTopicResyncs(), 0);
+  map<string, string> entries = TopicEntries("topic");
+  EXPECT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries["a"], "4");
+  EXPECT_EQ(entries["c"], "3");
+}
+
+// Callbacks are passed the last consistent copy of a topic whose delta can't be
+// applied, rather than no topic at all.
+TEST_F(StateStoreSubscriberTest, VersionGapCallback) {
+  ASSERT_TRUE(subscriber_->AddTopic("topic", false,
+      bind(&StateStoreSubscriberTest::RecordState, this, _1, _2)).ok());
+  Topic topic("topic");
+  topic.Put("a", "1");
+  StateStoreSubscriber::TopicDeltaMap topic_deltas;
+  topic.BuildDelta(0L, &topic_deltas["topic"]);
+  EXPECT_EQ(UpdateState(topic_deltas)["topic"], 1);
+  EXPECT_EQ(GetEntries(callback_state_["topic"]).size(), 1);
+
+  // The update from version 1 to 2 is missed
+  topic.Put("b", "2");
+  topic.Put("c", "3");
+  topic_deltas.clear();
+  topic.BuildDelta(2L, &topic_deltas["topic"]);
+  EXPECT_EQ(UpdateState(topic_deltas)["topic"], 0);
+  ASSERT_EQ(callback_state_.count("topic"), 1);
+  EXPECT_FALSE(callback_state_["topic"].is_delta);
+  map<string, string> entries = GetEntries(callback_state_["topic"]);
+  EXPECT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries["a"], "1");
+
+  topic_deltas.clear();
+  topic.BuildDelta(0L, &topic_deltas["topic"]);
+  EXPECT_EQ(UpdateState(topic_deltas)["topic"], 3);
+  EXPECT_EQ(GetEntries(callback_state_["topic"]).size(), 3);
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
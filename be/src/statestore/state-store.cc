@@ -45,6 +45,9 @@ const string STATESTORE_LIVE_SUBSCRIBERS = "statestore.live-backends";
 const string STATESTORE_LIVE_SUBSCRIBERS_LIST = "statestore.live-backends.list";
 const string STATESTORE_LAST_UPDATE_LOOP_TIME =
     "statestore.last-update-loop-time.seconds";
+const string STATESTORE_UPDATE_LOOP_BYTES = "statestore.update-loop-topic-bytes";
+const string STATESTORE_DELTA_UPDATES = "statestore.topic-updates.delta";
+const string STATESTORE_FULL_UPDATES = "statestore.topic-updates.full";
 
 const StateStore::TopicEntry::Value StateStore::TopicEntry::NULL_VALUE = "";
 
@@ -79,19 +82,64 @@ StateStore::TopicEntry::Version StateStore::Topic::Put(const string& key,
   TopicEntryMap::iterator entry_it = entries_.find(key);
   if (entry_it == entries_.end()) {
     entry_it = entries_.insert(make_pair(key, TopicEntry())).first;
+  } else {
+    version_index_.erase(entry_it->second.version());
   }
-  entry_it->second.SetValue(bytes, last_version_++);
+  entry_it->second.SetValue(bytes, ++last_version_);
+  version_index_[last_version_] = key;
   return entry_it->second.version();
 }
 
 void StateStore::Topic::DeleteIfVersionsMatch(TopicEntry::Version version,
     const StateStore::TopicEntryKey& key) {
-  TopicEntryMap::iterator entry_it = entries_.find(key);
+  TopicEntryMap::const_iterator entry_it = entries_.find(key);
   if (entry_it != entries_.end() && entry_it->second.version() == version) {
-    entry_it->second.SetValue(StateStore::TopicEntry::NULL_VALUE, last_version_++);
+    Put(key, StateStore::TopicEntry::NULL_VALUE);
   }
 }
 
+int64_t StateStore::Topic::BuildDelta(TopicEntry::Version from_version,
+    TTopicDelta* delta) const {
+  // A subscriber can't be ahead of the topic, unless the state-store restarted after
+  // it registered
+  if (from_version > last_version_) from_version = 0L;
+  delta->topic_name = topic_id_;
+  delta->is_delta = from_version > 0;
+  delta->__set_from_version(from_version);
+  delta->__set_to_version(last_version_);
+  int64_t num_bytes = 0;
+  if (!delta->is_delta) {
+    // Deleted entries are left out of the entire topic
+    BOOST_FOREACH(const TopicEntryMap::value_type& entry, entries_) {
+      if (entry.second.value() == StateStore::TopicEntry::NULL_VALUE) continue;
+      delta->topic_entries.push_back(TTopicItem());
+      TTopicItem& topic_item = delta->topic_entries.back();
+      topic_item.key = entry.first;
+      topic_item.value = entry.second.value();
+      num_bytes += entry.first.size() + entry.second.length();
+    }
+    return num_bytes;
+  }
+
+  for (VersionIndex::const_iterator it = version_index_.upper_bound(from_version);
+       it != version_index_.end(); ++it) {
+    TopicEntryMap::const_iterator entry_it = entries_.find(it->second);
+    DCHECK(entry_it != entries_.end());
+    if (entry_it->second.value() == StateStore::TopicEntry::NULL_VALUE) {
+      // NULL -> deletion
+      delta->topic_deletions.push_back(entry_it->first);
+      num_bytes += entry_it->first.size();
+    } else {
+      delta->topic_entries.push_back(TTopicItem());
+      TTopicItem& topic_item = delta->topic_entries.back();
+      topic_item.key = entry_it->first;
+      topic_item.value = entry_it->second.value();
+      num_bytes += entry_it->first.size() + entry_it->second.length();
+    }
+  }
+  return num_bytes;
+}
+
 StateStore::Subscriber::Subscriber(const SubscriberId& subscriber_id,
     const TNetworkAddress& network_address,
     const vector<TTopicRegistration>& subscribed_topics)
@@ -101,6 +149,13 @@ StateStore::Subscriber::Subscriber(const SubscriberId& subscriber_id,
   }
 }
 
+StateStore::TopicEntry::Version StateStore::Subscriber::GetTopicVersion(
+    const TopicId& topic_id) const {
+  boost::unordered_map<TopicId, TopicEntry::Version>::const_iterator it =
+      topic_versions_.find(topic_id);
+  return it == topic_versions_.end() ? 0L : it->second;
+}
+
 void StateStore::Subscriber::AddTransientUpdate(const TopicId& topic_id,
     const TopicEntryKey& topic_key, TopicEntry::Version version) {
   // Only record the update if the topic is transient
@@ -113,6 +168,7 @@ void StateStore::Subscriber::AddTransientUpdate(const TopicId& topic_id,
 
 StateStore::StateStore(Metrics* metrics)
   : exit_flag_(false),
+    heartbeat_loop_bytes_(0L),
     client_cache_(new ClientCache<StateStoreSubscriberClient>()),
     thrift_iface_(new StateStoreThriftIf(this)),
     failure_detector_(
@@ -126,6 +182,12 @@ StateStore::StateStore(Metrics* metrics)
                                                     set<string>()));
   last_heartbeat_loop_time_metric_ = metrics->RegisterMetric(
       new StatsMetric<double>(STATESTORE_LAST_UPDATE_LOOP_TIME, 0.0));
+  heartbeat_loop_bytes_metric_ = metrics->RegisterMetric(
+      new StatsMetric<double>(STATESTORE_UPDATE_LOOP_BYTES, 0.0));
+  num_delta_updates_metric_ =
+      metrics->CreateAndRegisterPrimitiveMetric(STATESTORE_DELTA_UPDATES, 0L);
+  num_full_updates_metric_ =
+      metrics->CreateAndRegisterPrimitiveMetric(STATESTORE_FULL_UPDATES, 0L);
   client_cache_->InitMetrics(metrics, "subscriber");
 }
 
@@ -143,12 +205,13 @@ void StateStore::TopicsHandler(const Webserver::ArgumentMap& args,
                                 stringstream* output) {
   (*output) << "<h2>Topics</h2>";
   (*output) << "<table class='table table-striped'>"
-            << "<tr><th>Topic Id</th><th>Number of entries</th></tr>";
+            << "<tr><th>Topic Id</th><th>Number of entries</th><th>Version</th></tr>";
 
   lock_guard<mutex> l(topic_lock_);
   BOOST_FOREACH(const TopicMap::value_type& topic, topics_) {
     (*output) << "<tr><td>" << topic.second.id() << "</td>";
-    (*output) << "<td>" << topic.second.entries().size() << "</td></tr>";
+    (*output) << "<td>" << topic.second.entries().size() << "</td>";
+    (*output) << "<td>" << topic.second.last_version() << "</td></tr>";
   }
   (*output) << "</table>";
 }
@@ -208,33 +271,28 @@ Status StateStore::RegisterSubscriber(const SubscriberId& subscriber_id,
 }
 
 Status StateStore::ProcessOneSubscriber(Subscriber* subscriber) {
-  // First thing: make a list of updates to send
+  // First thing: make a list of updates to send, with the changes
+  // since the version of each topic the subscriber holds
   TUpdateStateRequest update_state_request;
   {
     lock_guard<mutex> l(topic_lock_);
 
+    int64_t num_bytes = 0;
     BOOST_FOREACH(const Subscriber::Topics::value_type& topic,
         subscriber->subscribed_topics()) {
       TopicMap::const_iterator topic_it = topics_.find(topic.first);
       DCHECK(topic_it != topics_.end());
 
+      TopicEntry::Version from_version = subscriber->GetTopicVersion(topic.first);
       TTopicDelta& topic_delta = update_state_request.topic_deltas[topic.first];
-      topic_delta.topic_name = topic.first;
-      BOOST_FOREACH(const TopicEntryMap::value_type& entry, topic_it->second.entries()) {
-        if (entry.second.value() == StateStore::TopicEntry::NULL_VALUE) {
-          // NULL -> deletion
-          topic_delta.topic_deletions.push_back(entry.first);
-        } else {
-          topic_delta.topic_entries.push_back(TTopicItem());
-          TTopicItem& topic_item = topic_delta.topic_entries.back();
-          topic_item.key = entry.first;
-          // TODO: Does this do a needless copy?
-          topic_item.value = entry.second.value();
-        }
+      num_bytes += topic_it->second.BuildDelta(from_version, &topic_delta);
+      if (topic_delta.is_delta) {
+        num_delta_updates_metric_->Increment(1L);
+      } else {
+        num_full_updates_metric_->Increment(1L);
       }
-      // TODO: Compute deltas
-      topic_delta.is_delta = false;
     }
+    __sync_fetch_and_add(&heartbeat_loop_bytes_, num_bytes);
   }
 
   // Second: try and send it
@@ -259,7 +317,19 @@ Status StateStore::ProcessOneSubscriber(Subscriber* subscriber) {
   }
   RETURN_IF_ERROR(Status(response.status));
 
-  // Thirdly: perform any / all updates returned by the subscriber
+  // Thirdly: record the topic versions the subscriber now holds. Topics
+  // it doesn't report are sent in their entirety next time.
+  typedef map<string, TTopicDelta> TopicDeltas;
+  BOOST_FOREACH(const TopicDeltas::value_type& delta, update_state_request.topic_deltas) {
+    TopicEntry::Version version = 0L;
+    if (response.__isset.topic_versions) {
+      map<string, int64_t>::const_iterator it = response.topic_versions.find(delta.first);
+      if (it != response.topic_versions.end() && it->second > 0) version = it->second;
+    }
+    subscriber->SetTopicVersion(delta.first, version);
+  }
+
+  // Fourthly: perform any / all updates returned by the subscriber
   {
     lock_guard<mutex> l(topic_lock_);
     BOOST_FOREACH(const TTopicUpdate& update, response.topic_updates) {
@@ -415,6 +485,9 @@ Status StateStore::MainLoop() {
     loop_timer.Stop();
     last_heartbeat_loop_time_metric_->Update(
         loop_timer.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
+    // All workers are idle until the queue is re-filled
+    heartbeat_loop_bytes_metric_->Update(heartbeat_loop_bytes_);
+    heartbeat_loop_bytes_ = 0L;
     // TODO: configure this
     usleep(500 * 1000);
   }
@@ -68,8 +68,12 @@ class Status;
 // different subscribers may treat the same topic differently wrt to
 // the transience of their updates.
 //
-// TODO: Compute deltas based on subscriber last-seen version numbers
-// and only send the changes.
+// Every change to a topic is tagged with a new version of the
+// topic. The state-store remembers the version of each topic that
+// each subscriber reported holding in its last heartbeat response,
+// and only sends the changes made since then. A subscriber that has
+// no version of a topic (e.g. one that has just registered) or that
+// could not apply a delta is sent the entire topic instead.
 class StateStore {
  public:
   // A SubscriberId uniquely identifies a single subscriber, and is
@@ -114,6 +118,8 @@ class StateStore {
   void SetExitFlag();
 
  private:
+  friend class StateStoreTest;
+
   // A TopicEntry is a single entry in a topic, and logically is a
   // <string, byte string> pair. If the byte string is NULL, the entry
   // has been deleted, but may be retained to track changes to send to
@@ -169,7 +175,7 @@ class StateStore {
   // delta of changes on every update.
   class Topic {
    public:
-    Topic(const TopicId& topic_id) : topic_id_(topic_id) { }
+    Topic(const TopicId& topic_id) : topic_id_(topic_id), last_version_(0L) { }
 
     // Adds an entry with the given key. If bytes == NULL_VALUE, the entry
     // is considered deleted, and may be garbage collected in the
@@ -191,18 +197,35 @@ class StateStore {
     // Must be called holding the topic lock
     void DeleteIfVersionsMatch(TopicEntry::Version version, const TopicEntryKey& key);
 
+    // Fills in 'delta' with the changes made after 'from_version',
+    // or with all entries of the topic if 'from_version' is 0 or
+    // later than the topic's last version, and returns the number of
+    // bytes of keys and values it holds.
+    //
+    // Must be called holding the topic lock
+    int64_t BuildDelta(TopicEntry::Version from_version, TTopicDelta* delta) const;
+
     const TopicId& id() const { return topic_id_; }
     const TopicEntryMap& entries() const { return entries_; }
 
+    // The version of the most recent update, 0 if there has been none.
+    TopicEntry::Version last_version() const { return last_version_; }
+
    private:
     // Map from topic entry key to topic entry.
     TopicEntryMap entries_;
 
+    // Map from version to the key of the entry that has it, used to
+    // find the entries changed after a given version without looking
+    // at the whole topic.
+    typedef std::map<TopicEntry::Version, TopicEntryKey> VersionIndex;
+    VersionIndex version_index_;
+
     // Unique identifier for this topic. Should be human-readable.
     const TopicId topic_id_;
 
     // Incremented on every Put(..), and each TopicEntry is tagged
-    // with the current version.
+    // with the new version, so versions start at 1.
     TopicEntry::Version last_version_;
   };
 
@@ -259,6 +282,15 @@ class StateStore {
 
     const TransientEntryMap& transient_entries() const { return transient_entries_; }
 
+    // Returns the version of a topic that this subscriber reported
+    // holding, 0 if it holds none.
+    TopicEntry::Version GetTopicVersion(const TopicId& topic_id) const;
+
+    // Records the version of a topic that this subscriber holds.
+    void SetTopicVersion(const TopicId& topic_id, TopicEntry::Version version) {
+      topic_versions_[topic_id] = version;
+    }
+
    private:
     // Unique human-readable identifier for this subscriber, set by
     // the subscriber itself on a Register call
@@ -275,6 +307,11 @@ class StateStore {
     // List of updates made by this subscriber so that transient
     // entries may be deleted on failure
     TransientEntryMap transient_entries_;
+
+    // The version of each subscribed topic that the subscriber
+    // holds, from which the next delta is computed. Only accessed by
+    // the worker thread that is sending this subscriber a heartbeat.
+    boost::unordered_map<TopicId, TopicEntry::Version> topic_versions_;
   };
 
   // Protects access to subscribers_
@@ -306,6 +343,19 @@ class StateStore {
   // Metric to track time spent performing a full set of heartbeats to all subscribers
   StatsMetric<double>* last_heartbeat_loop_time_metric_;
 
+  // Metric to track the bytes of topic keys and values sent to all
+  // subscribers in a full set of heartbeats
+  StatsMetric<double>* heartbeat_loop_bytes_metric_;
+
+  // Metrics that count the topic updates sent as deltas, and those
+  // sent with the entire topic
+  Metrics::IntMetric* num_delta_updates_metric_;
+  Metrics::IntMetric* num_full_updates_metric_;
+
+  // Bytes of topic keys and values sent during the current set of
+  // heartbeats. Updated atomically by the worker threads.
+  int64_t heartbeat_loop_bytes_;
+
   // Shared mutex that protects all subsequent members, which are used
   // to coordinate work between the master thread and the worker
   // threads that send heartbeats to subscribers.
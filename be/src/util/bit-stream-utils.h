@@ -49,14 +49,18 @@ class BitWriter {
   // there was not enough space.
   bool PutBool(bool b);
 
-#if 0
-  // TODO: when we support nested schemas, we will need to write multi-bit values.
-  bool PutValue(int v, int num_bits);
-#endif
+  // Writes the 'num_bits' least significant bits of v to the buffer.  This is bit
+  // packed, least significant bit first.  num_bits must be at most 32 and v must fit
+  // in num_bits.  Returns false if there was not enough space.
+  bool PutValue(uint64_t v, int num_bits);
 
   // Writes v to the next aligned byte.  
   template<typename T>
   bool PutAligned(T v);
+
+  // Writes the 'num_bytes' least significant bytes of v to the next aligned byte.
+  template<typename T>
+  bool PutAligned(T v, int num_bytes);
   
   // Write a Vlq encoded int to the buffer.  Returns false if there was not enough
   // room.  The value is written byte aligned.
@@ -89,16 +93,22 @@ class BitReader {
       bit_offset_(0) {
   }
 
-  BitReader() : buffer_(NULL), num_bytes_(0) {}
+  BitReader() : buffer_(NULL), num_bytes_(0), byte_offset_(0), bit_offset_(0) {}
 
   // Gets the next bool from the buffers.  
   // Returns true if 'v' could be read or false if there are not enough bytes left.
   bool GetBool(bool* b);
 
-#if 0
-  // TODO: when we support nested schemas, we will need to read multi-bit values.
-  bool GetValue(int num_bits, int* v);
-#endif
+  // Gets the next 'num_bits' bit value from the buffer, in the format written by
+  // BitWriter::PutValue().  num_bits must be at most 32.
+  // Returns true if 'v' could be read or false if there are not enough bytes left.
+  template<typename T>
+  bool GetValue(int num_bits, T* v);
+
+  // Unpacks the next 'num_values' bools into 'values', one byte (0 or 1) per value.
+  // Returns false if there are not enough bytes left, in which case nothing is read.
+  // Once the stream is byte aligned, values are unpacked 16 at a time with SSE.
+  bool GetBoolBatch(uint8_t* values, int num_values);
 
   // Reads a T sized value from the buffer.  T needs to be a native type and little
   // endian.  The value is assumed to be byte aligned so the stream will be advance
@@ -106,6 +116,11 @@ class BitReader {
   template<typename T>
   bool GetAligned(T* v);
 
+  // Same as above but only reads the 'num_bytes' least significant bytes of v.  The
+  // remaining bytes of v are set to 0.
+  template<typename T>
+  bool GetAligned(int num_bytes, T* v);
+
   // Reads a vlq encoded int from the stream.  The encoded int must start at the
   // beginning of a byte. Return false if there were not enough bytes in the buffer.
   bool GetVlqInt(int32_t* v);
@@ -17,6 +17,9 @@
 #define IMPALA_UTIL_BIT_STREAM_UTILS_INLINE_H
 
 #include "util/bit-stream-utils.h"
+#include "util/bit-util.h"
+#include "util/cpu-info.h"
+#include "util/sse-util.h"
 
 namespace impala {
 
@@ -37,6 +40,25 @@ inline bool BitWriter::PutBool(bool b) {
   return true;
 }
 
+inline bool BitWriter::PutValue(uint64_t v, int num_bits) {
+  DCHECK_LE(num_bits, 32);
+  DCHECK_EQ(v >> num_bits, 0);
+  int end_bit = bit_offset_ + num_bits;
+  if (UNLIKELY(byte_offset_ * 8 + end_bit > num_bytes_ * 8)) return false;
+
+  // Read-modify-write the (at most 5) bytes the value spans.
+  int num_bytes = BitUtil::Ceil(end_bit, 8);
+  uint64_t word = 0;
+  memcpy(&word, buffer_ + byte_offset_, num_bytes);
+  word &= ~(((1ULL << num_bits) - 1) << bit_offset_);
+  word |= v << bit_offset_;
+  memcpy(buffer_ + byte_offset_, &word, num_bytes);
+
+  byte_offset_ += end_bit >> 3;
+  bit_offset_ = end_bit & 7;
+  return true;
+}
+
 inline uint8_t* BitWriter::GetNextBytePtr(int num_bytes) {
   if (UNLIKELY(bit_offset_ != 0)) {
     // Advance to next aligned byte
@@ -57,6 +79,15 @@ inline bool BitWriter::PutAligned(T val) {
   return true;
 }
 
+template<typename T>
+inline bool BitWriter::PutAligned(T val, int num_bytes) {
+  DCHECK_LE(num_bytes, sizeof(T));
+  uint8_t* byte_ptr = GetNextBytePtr(num_bytes);
+  if (UNLIKELY(byte_ptr == NULL)) return false;
+  memcpy(byte_ptr, &val, num_bytes);
+  return true;
+}
+
 inline bool BitWriter::PutVlqInt(int32_t v) {
   bool result = true;
   while ((v & 0xFFFFFF80) != 0L) {
@@ -77,6 +108,66 @@ inline bool BitReader::GetBool(bool* b) {
   return true;
 }
 
+template<typename T>
+inline bool BitReader::GetValue(int num_bits, T* v) {
+  DCHECK_LE(num_bits, 32);
+  int end_bit = bit_offset_ + num_bits;
+  if (UNLIKELY(byte_offset_ * 8 + end_bit > num_bytes_ * 8)) return false;
+
+  int num_bytes = BitUtil::Ceil(end_bit, 8);
+  uint64_t word = 0;
+  memcpy(&word, buffer_ + byte_offset_, num_bytes);
+  *v = static_cast<T>((word >> bit_offset_) & ((1ULL << num_bits) - 1));
+
+  byte_offset_ += end_bit >> 3;
+  bit_offset_ = end_bit & 7;
+  return true;
+}
+
+inline bool BitReader::GetBoolBatch(uint8_t* values, int num_values) {
+  if (UNLIKELY(byte_offset_ * 8 + bit_offset_ + num_values > num_bytes_ * 8)) {
+    return false;
+  }
+  int i = 0;
+  // Unpack single bits until the stream is byte aligned.
+  for (; i < num_values && bit_offset_ != 0; ++i) {
+    values[i] = (buffer_[byte_offset_] >> bit_offset_) & 1;
+    if (++bit_offset_ == 8) {
+      bit_offset_ = 0;
+      ++byte_offset_;
+    }
+  }
+
+  if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
+    // Spread two bytes over the 16 bytes of a register (the first byte over the low
+    // 8 bytes), isolate bit j of the byte in lane j and turn the lanes into 0 or 1.
+    const __m128i shuffle = _mm_set_epi8(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i bit_mask = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1,
+        -128, 64, 32, 16, 8, 4, 2, 1);
+    const __m128i ones = _mm_set1_epi8(1);
+    for (; i + 16 <= num_values; i += 16) {
+      uint16_t bits;
+      memcpy(&bits, buffer_ + byte_offset_, sizeof(bits));
+      __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(bits), shuffle);
+      v = _mm_cmpeq_epi8(_mm_and_si128(v, bit_mask), bit_mask);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_and_si128(v, ones));
+      byte_offset_ += 2;
+    }
+  }
+
+  for (; i + 8 <= num_values; i += 8) {
+    uint8_t byte = buffer_[byte_offset_++];
+    for (int j = 0; j < 8; ++j) {
+      values[i + j] = (byte >> j) & 1;
+    }
+  }
+  for (; i < num_values; ++i) {
+    values[i] = (buffer_[byte_offset_] >> bit_offset_) & 1;
+    ++bit_offset_;
+  }
+  return true;
+}
+
 template<typename T>
 inline bool BitReader::GetAligned(T* v) {
   if (bit_offset_ != 0) {
@@ -91,6 +182,20 @@ inline bool BitReader::GetAligned(T* v) {
   return true;
 }
 
+template<typename T>
+inline bool BitReader::GetAligned(int num_bytes, T* v) {
+  DCHECK_LE(num_bytes, sizeof(T));
+  if (bit_offset_ != 0) {
+    bit_offset_ = 0;
+    ++byte_offset_;
+  }
+  if (UNLIKELY(byte_offset_ + num_bytes > num_bytes_)) return false;
+  *v = 0;
+  memcpy(v, buffer_ + byte_offset_, num_bytes);
+  byte_offset_ += num_bytes;
+  return true;
+}
+
 inline bool BitReader::GetVlqInt(int32_t* v) {
   *v = 0;
   int shift = 0;
@@ -30,6 +30,11 @@ class BitUtil {
     return value / divisor + (value % divisor != 0);
   }
 
+  // Returns the number of bits needed to represent values up to 'max_value'.
+  static inline int NumRequiredBits(uint64_t max_value) {
+    return max_value == 0 ? 0 : 64 - __builtin_clzll(max_value);
+  }
+
   // Non hw accelerated pop count.
   // TODO: we don't use this in any perf sensitive code paths currently.  There
   // might be a much faster way to implement this.
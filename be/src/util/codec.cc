@@ -38,6 +38,9 @@ const char* const Codec::BZIP2_COMPRESSION =
 const char* const Codec::SNAPPY_COMPRESSION =
     "org.apache.hadoop.io.compress.SnappyCodec";
 
+const char* const Codec::LZ4_COMPRESSION =
+    "org.apache.hadoop.io.compress.Lz4Codec";
+
 const char* const UNKNOWN_CODEC_ERROR =
     "This compression codec is currently unsupported: ";
 
@@ -46,7 +49,8 @@ const Codec::CodecMap Codec::CODEC_MAP = map_list_of
   (Codec::DEFAULT_COMPRESSION, THdfsCompression::DEFAULT)
   (Codec::GZIP_COMPRESSION, THdfsCompression::GZIP)
   (Codec::BZIP2_COMPRESSION, THdfsCompression::BZIP2)
-  (Codec::SNAPPY_COMPRESSION, THdfsCompression::SNAPPY_BLOCKED);
+  (Codec::SNAPPY_COMPRESSION, THdfsCompression::SNAPPY_BLOCKED)
+  (Codec::LZ4_COMPRESSION, THdfsCompression::LZ4_BLOCKED);
 
 string Codec::GetCodecName(THdfsCompression::type type) {
   map<const string, THdfsCompression::type>::const_iterator im;
@@ -111,6 +115,9 @@ Status Codec::CreateCompressor(RuntimeState* runtime_state, MemPool* mem_pool,
     case THdfsCompression::SNAPPY:
       *compressor = new SnappyCompressor(mem_pool, reuse);
       break;
+    case THdfsCompression::LZ4_BLOCKED:
+      // Only reading lz4 data is supported.
+      return Status("LZ4 compression is not supported");
   }
 
   return (*compressor)->Init();
@@ -167,6 +174,9 @@ Status Codec::CreateDecompressor(RuntimeState* runtime_state, MemPool* mem_pool,
     case THdfsCompression::SNAPPY:
       *decompressor = new SnappyDecompressor(mem_pool, reuse);
       break;
+    case THdfsCompression::LZ4_BLOCKED:
+      *decompressor = new Lz4BlockDecompressor(mem_pool, reuse);
+      break;
   }
 
   return (*decompressor)->Init();
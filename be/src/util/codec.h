@@ -41,6 +41,7 @@ class Codec {
   static const char* const GZIP_COMPRESSION;
   static const char* const BZIP2_COMPRESSION;
   static const char* const SNAPPY_COMPRESSION;
+  static const char* const LZ4_COMPRESSION;
 
   // Map from codec string to compression format
   typedef std::map<const std::string, const THdfsCompression::type> CodecMap;
@@ -98,6 +98,46 @@ TEST_F(DecompressorTest, SnappyBlocked) {
   RunTest(THdfsCompression::SNAPPY_BLOCKED);
 }
 
+// There is no lz4 compressor, so this decompresses data written by hadoop's Lz4Codec.
+TEST_F(DecompressorTest, Lz4Blocked) {
+  uint8_t compressed[] = {
+    // Uncompressed length of the outer block: 19 + 20 bytes
+    0, 0, 0, 39,
+    // A raw lz4 block of 13 bytes: 4 literals, then a match of 10 bytes at offset 4,
+    // then 5 literals
+    0, 0, 0, 13,
+    0x46, 'a', 'b', 'c', 'd', 4, 0, 0x50, 'c', 'd', 'x', 'y', 'z',
+    // A raw lz4 block of 22 bytes: 15 + 5 literals
+    0, 0, 0, 22,
+    0xf0, 5, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't'
+  };
+  const char* expected = "abcdabcdabcdabcdxyzabcdefghijklmnopqrst";
+
+  scoped_ptr<Codec> decompressor;
+  MemPool mem_pool;
+  EXPECT_TRUE(Codec::CreateDecompressor(NULL, &mem_pool, true,
+      THdfsCompression::LZ4_BLOCKED, &decompressor).ok());
+  uint8_t* output;
+  int out_len = 0;
+  EXPECT_TRUE(decompressor->ProcessBlock(sizeof(compressed), compressed, &out_len,
+      &output).ok());
+  EXPECT_EQ(out_len, strlen(expected));
+  EXPECT_TRUE(memcmp(expected, output, out_len) == 0);
+
+  // Try again specifying the output buffer and length.
+  output = mem_pool.Allocate(out_len);
+  EXPECT_TRUE(decompressor->ProcessBlock(sizeof(compressed), compressed, &out_len,
+      &output).ok());
+  EXPECT_TRUE(memcmp(expected, output, out_len) == 0);
+
+  // A match before the start of the output is corrupt.
+  compressed[13] = 5;
+  out_len = 0;
+  EXPECT_FALSE(decompressor->ProcessBlock(sizeof(compressed), compressed, &out_len,
+      &output).ok());
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -331,3 +331,148 @@ Status SnappyBlockDecompressor::ProcessBlock(int input_len, uint8_t* input,
   RETURN_IF_ERROR(SnappyBlockDecompress(input_len, input, false, output_len, out_ptr));
   return Status::OK;
 }
+
+Lz4BlockDecompressor::Lz4BlockDecompressor(MemPool* mem_pool, bool reuse_buffer)
+  : Codec(mem_pool, reuse_buffer) {
+}
+
+// Reads the length extension of a literal or match length of 15 or more, the sum of
+// the bytes up to and including the first one that is not 255.  Returns false if the
+// input ends before that byte.
+static bool Lz4ReadLength(const uint8_t** input, const uint8_t* input_end, int* len) {
+  uint8_t b;
+  do {
+    if (*input == input_end) return false;
+    b = *(*input)++;
+    *len += b;
+  } while (b == 255);
+  return true;
+}
+
+// Decompresses the raw lz4 block of 'input_len' bytes at 'input', which must decompress
+// to at most 'max_output_len' bytes.  A raw block is a sequence of
+//   - a token byte, with the literal length in the upper and the match length minus 4
+//     in the lower 4 bits.  Lengths of 15 are followed by more length bytes.
+//   - the literals
+//   - the 2-byte little endian offset of the match, counted back from the end of the
+//     output so far.  The last sequence of the block has only literals.
+// If output is NULL, this only computes the decompressed size, which is cheap since it
+// does not copy any bytes.
+// Returns the decompressed size, or -1 if the block is corrupt.
+static int Lz4RawDecompress(int input_len, const uint8_t* input, int max_output_len,
+    uint8_t* output) {
+  const uint8_t* input_end = input + input_len;
+  int output_len = 0;
+  while (input < input_end) {
+    uint8_t token = *input++;
+    int literal_len = token >> 4;
+    if (literal_len == 15 && !Lz4ReadLength(&input, input_end, &literal_len)) return -1;
+    if (literal_len > input_end - input || literal_len > max_output_len - output_len) {
+      return -1;
+    }
+    if (output != NULL) memcpy(output + output_len, input, literal_len);
+    input += literal_len;
+    output_len += literal_len;
+    if (input == input_end) break;
+
+    if (input_end - input < 2) return -1;
+    int offset = input[0] | (input[1] << 8);
+    input += 2;
+    if (offset == 0 || offset > output_len) return -1;
+    int match_len = token & 0xf;
+    if (match_len == 15 && !Lz4ReadLength(&input, input_end, &match_len)) return -1;
+    match_len += 4;
+    if (match_len > max_output_len - output_len) return -1;
+    if (output != NULL) {
+      // The match may overlap the bytes it produces, so copy byte by byte.
+      uint8_t* out = output + output_len;
+      const uint8_t* match = out - offset;
+      for (int i = 0; i < match_len; ++i) {
+        out[i] = match[i];
+      }
+    }
+    output_len += match_len;
+  }
+  return output_len;
+}
+
+// Utility function to decompress lz4 block compressed data, see SnappyBlockDecompress
+// for the layout.  Unlike snappy, raw lz4 blocks don't store their uncompressed length,
+// so each one is bounded by what is left of the uncompressed size of its outer block.
+// If size_only is true, this function does not decompress but only computes the output
+// size and writes the result to *output_len.
+// If size_only is false, output must be preallocated to output_len and this needs to
+// be exactly big enough to hold the decompressed output.
+static Status Lz4BlockDecompress(int input_len, uint8_t* input, bool size_only,
+    int* output_len, uint8_t* output) {
+  int uncompressed_total_len = 0;
+  while (input_len > 0) {
+    if (input_len < static_cast<int>(sizeof(int32_t))) {
+      return Status("Lz4: truncated block.  Data is likely corrupt.");
+    }
+    int uncompressed_block_len = ReadWriteUtil::GetInt(input);
+    input += sizeof(int32_t);
+    input_len -= sizeof(int32_t);
+
+    if (uncompressed_block_len > Codec::MAX_BLOCK_SIZE || uncompressed_block_len < 0 ||
+        (!size_only && uncompressed_block_len > *output_len - uncompressed_total_len)) {
+      stringstream ss;
+      ss << "Decompressor: block size is too big.  Data is likely corrupt. "
+         << "Size: " << uncompressed_block_len;
+      return Status(ss.str());
+    }
+
+    while (uncompressed_block_len > 0) {
+      // Read the length of the next lz4 compressed block.
+      if (input_len < static_cast<int>(sizeof(int32_t))) {
+        return Status("Lz4: truncated block.  Data is likely corrupt.");
+      }
+      int compressed_len = ReadWriteUtil::GetInt(input);
+      input += sizeof(int32_t);
+      input_len -= sizeof(int32_t);
+      if (compressed_len <= 0 || compressed_len > input_len) {
+        return Status(
+            "Decompressor: invalid compressed length.  Data is likely corrupt.");
+      }
+
+      int uncompressed_len = Lz4RawDecompress(compressed_len, input,
+          uncompressed_block_len, size_only ? NULL : output + uncompressed_total_len);
+      if (uncompressed_len <= 0) return Status("Lz4: decompression failed");
+
+      input += compressed_len;
+      input_len -= compressed_len;
+      uncompressed_block_len -= uncompressed_len;
+      uncompressed_total_len += uncompressed_len;
+    }
+  }
+
+  if (size_only) {
+    *output_len = uncompressed_total_len;
+  } else if (*output_len != uncompressed_total_len) {
+    return Status("Lz4: Decompressed size is not correct.");
+  }
+  return Status::OK;
+}
+
+Status Lz4BlockDecompressor::ProcessBlock(int input_len, uint8_t* input,
+    int* output_len, uint8_t** output) {
+  if (*output_len == 0) {
+    // If we don't know the size beforehand, compute it.
+    RETURN_IF_ERROR(Lz4BlockDecompress(input_len, input, true, output_len, NULL));
+    if (*output_len > MAX_BLOCK_SIZE) {
+      stringstream ss;
+      ss << "Decompressor: block size is too big.  Data is likely corrupt. "
+         << "Size: " << *output_len;
+      return Status(ss.str());
+    }
+
+    if (!reuse_buffer_ || out_buffer_ == NULL || buffer_length_ < *output_len) {
+      // Need to allocate a new buffer
+      buffer_length_ = *output_len;
+      out_buffer_ = memory_pool_->Allocate(buffer_length_);
+    }
+    *output = out_buffer_;
+  }
+  DCHECK(*output != NULL);
+  return Lz4BlockDecompress(input_len, input, false, output_len, *output);
+}
@@ -91,5 +91,21 @@ class SnappyBlockDecompressor : public Codec {
   virtual Status Init() { return Status::OK; }
 };
 
+// Decompressor for lz4 data written by hadoop's Lz4Codec, which uses the same block
+// framing as the SnappyCodec around raw lz4 blocks.
+class Lz4BlockDecompressor : public Codec {
+ public:
+  Lz4BlockDecompressor(MemPool* mem_pool, bool reuse_buffer);
+  virtual ~Lz4BlockDecompressor() { }
+
+  // Process a block of data.
+  virtual Status ProcessBlock(int input_length, uint8_t* input,
+                              int* output_length, uint8_t** output);
+
+ protected:
+  // Lz4 does not need initialization
+  virtual Status Init() { return Status::OK; }
+};
+
 }
 #endif
@@ -22,7 +22,7 @@
 #include <google/malloc_extension.h>
 
 #include "common/logging.h"
-#include "runtime/mem-limit.h"
+#include "runtime/mem-tracker.h"
 #include "util/debug-util.h"
 #include "util/logging.h"
 #include "util/webserver.h"
@@ -69,17 +69,23 @@ void FlagsHandler(const Webserver::ArgumentMap& args, stringstream* output) {
 }
 
 // Registered to handle "/memz", and prints out memory allocation statistics.
-void MemUsageHandler(MemLimit* mem_limit, const Webserver::ArgumentMap& args, 
+void MemUsageHandler(MemTracker* mem_tracker, const Webserver::ArgumentMap& args,
     stringstream* output) {
-  if (mem_limit != NULL) {
-    (*output) << "<pre>"
-              << "Mem Limit: " 
-              << PrettyPrinter::Print(mem_limit->limit(), TCounterType::BYTES) 
-              << endl
-              << "Mem Consumption: " 
-              << PrettyPrinter::Print(mem_limit->consumption(), TCounterType::BYTES) 
+  if (mem_tracker != NULL) {
+    (*output) << "<pre>";
+    if (mem_tracker->has_limit()) {
+      (*output) << "Mem Limit: "
+                << PrettyPrinter::Print(mem_tracker->limit(), TCounterType::BYTES)
+                << endl;
+    } else {
+      (*output) << "No process memory limit set." << endl;
+    }
+    (*output) << "Mem Consumption: "
+              << PrettyPrinter::Print(mem_tracker->consumption(), TCounterType::BYTES)
               << endl
               << "</pre>";
+    (*output) << "<h2>Memory Trackers</h2>"
+              << "<pre>" << mem_tracker->LogUsage() << "</pre>";
   } else {
     (*output) << "<pre>"
               << "No process memory limit set."
@@ -99,9 +105,10 @@ void MemUsageHandler(MemLimit* mem_limit, const Webserver::ArgumentMap& args,
   (*output) << tmp << "</pre>";
 }
 
-void impala::AddDefaultPathHandlers(Webserver* webserver, MemLimit* process_mem_limit) {
+void impala::AddDefaultPathHandlers(Webserver* webserver,
+    MemTracker* process_mem_tracker) {
   webserver->RegisterPathHandler("/logs", LogsHandler);
   webserver->RegisterPathHandler("/varz", FlagsHandler);
   webserver->RegisterPathHandler("/memz",
-      bind<void>(&MemUsageHandler, process_mem_limit, _1, _2));
+      bind<void>(&MemUsageHandler, process_mem_tracker, _1, _2));
 }
@@ -0,0 +1,214 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "util/cpu-info.h"
+#include "util/dfa-regex.h"
+
+using namespace std;
+
+namespace impala {
+
+static bool FullMatch(const string& pattern, const string& str) {
+  DfaRegex regex;
+  Status status = regex.Init(pattern);
+  EXPECT_TRUE(status.ok()) << pattern;
+  return regex.FullMatch(str.data(), str.size());
+}
+
+static bool PartialMatch(const string& pattern, const string& str) {
+  DfaRegex regex;
+  Status status = regex.Init(pattern);
+  EXPECT_TRUE(status.ok()) << pattern;
+  return regex.PartialMatch(str.data(), str.size());
+}
+
+static bool IsSupported(const string& pattern) {
+  DfaRegex regex;
+  return regex.Init(pattern).ok();
+}
+
+TEST(DfaRegexTest, Basic) {
+  EXPECT_TRUE(FullMatch("abc", "abc"));
+  EXPECT_FALSE(FullMatch("abc", "abcd"));
+  EXPECT_FALSE(FullMatch("abc", "ab"));
+  EXPECT_TRUE(FullMatch("", ""));
+  EXPECT_FALSE(FullMatch("", "a"));
+  EXPECT_TRUE(FullMatch("a.c", "a\nc"));
+  EXPECT_TRUE(FullMatch("a|bc|", "bc"));
+  EXPECT_TRUE(FullMatch("a|bc|", ""));
+  EXPECT_FALSE(FullMatch("a|bc|", "b"));
+  EXPECT_TRUE(FullMatch("(ab|cd)*e", "abcdabe"));
+  EXPECT_FALSE(FullMatch("(ab|cd)*e", "abce"));
+  EXPECT_TRUE(FullMatch("a\\.b\\*", "a.b*"));
+  EXPECT_FALSE(FullMatch("a\\.b", "axb"));
+}
+
+TEST(DfaRegexTest, Repetition) {
+  EXPECT_TRUE(FullMatch("a*", ""));
+  EXPECT_TRUE(FullMatch("a*", "aaaa"));
+  EXPECT_FALSE(FullMatch("a+", ""));
+  EXPECT_TRUE(FullMatch("a+b?", "aab"));
+  EXPECT_FALSE(FullMatch("a+b?", "abb"));
+  EXPECT_TRUE(FullMatch("a{3}", "aaa"));
+  EXPECT_FALSE(FullMatch("a{3}", "aaaa"));
+  EXPECT_TRUE(FullMatch("a{2,}", "aaaaa"));
+  EXPECT_FALSE(FullMatch("a{2,}", "a"));
+  EXPECT_TRUE(FullMatch("(ab){1,3}", "abab"));
+  EXPECT_FALSE(FullMatch("(ab){1,3}", "abababab"));
+  EXPECT_TRUE(FullMatch("x(a|b){0,2}y", "xy"));
+  EXPECT_TRUE(FullMatch("x(a|b){0,2}y", "xbay"));
+}
+
+TEST(DfaRegexTest, Classes) {
+  EXPECT_TRUE(FullMatch("[a-c]+", "abcba"));
+  EXPECT_FALSE(FullMatch("[a-c]+", "abd"));
+  EXPECT_TRUE(FullMatch("[^a-c]+", "xyz"));
+  EXPECT_FALSE(FullMatch("[^a-c]+", "xaz"));
+  EXPECT_TRUE(FullMatch("[]a]+", "]a]"));
+  EXPECT_TRUE(FullMatch("[a-]+", "-a"));
+  EXPECT_TRUE(FullMatch("[[:digit:]]{3}-[[:alpha:]]+", "123-abc"));
+  EXPECT_FALSE(FullMatch("[[:digit:]]{3}", "12a"));
+  EXPECT_TRUE(FullMatch("\\d+\\s\\w+", "42 foo_bar"));
+  EXPECT_FALSE(FullMatch("\\d+", "4x"));
+  EXPECT_TRUE(FullMatch("\\D\\W\\S", "a-b"));
+}
+
+TEST(DfaRegexTest, PartialMatch) {
+  EXPECT_TRUE(PartialMatch("b+c", "aabbbcd"));
+  EXPECT_FALSE(PartialMatch("b+c", "aabbbd"));
+  EXPECT_TRUE(PartialMatch("", "abc"));
+  EXPECT_TRUE(PartialMatch("^ab", "abc"));
+  EXPECT_FALSE(PartialMatch("^ab", "cab"));
+  EXPECT_TRUE(PartialMatch("bc$", "abc"));
+  EXPECT_FALSE(PartialMatch("bc$", "abcd"));
+  EXPECT_TRUE(PartialMatch("^a.*c$", "abbbc"));
+  EXPECT_FALSE(PartialMatch("^a.*c$", "abbbcd"));
+  EXPECT_TRUE(PartialMatch("b\\$", "ab$c"));
+  EXPECT_TRUE(PartialMatch("^(a|b)", "bc"));
+  EXPECT_FALSE(PartialMatch("^(a|b)", "cb"));
+  EXPECT_TRUE(PartialMatch("(a|b)$", "cb"));
+  EXPECT_FALSE(PartialMatch("^(ab|c)$", "abc"));
+}
+
+TEST(DfaRegexTest, Unsupported) {
+  EXPECT_FALSE(IsSupported("(a)\\1"));
+  EXPECT_FALSE(IsSupported("(?i)abc"));
+  EXPECT_FALSE(IsSupported("a*?"));
+  EXPECT_FALSE(IsSupported("a**"));
+  EXPECT_FALSE(IsSupported("*a"));
+  EXPECT_FALSE(IsSupported("a^b"));
+  EXPECT_FALSE(IsSupported("a$b"));
+  // The anchors apply to one alternative only, e.g. "a|b$" matches "ax"
+  EXPECT_FALSE(IsSupported("a|b$"));
+  EXPECT_FALSE(IsSupported("^a|b"));
+  EXPECT_FALSE(IsSupported("^a|b$"));
+  EXPECT_FALSE(IsSupported("a)"));
+  EXPECT_FALSE(IsSupported("(a"));
+  EXPECT_FALSE(IsSupported("[a"));
+  EXPECT_FALSE(IsSupported("[\\d]"));
+  EXPECT_FALSE(IsSupported("[[:foo:]]"));
+  EXPECT_FALSE(IsSupported("a{2,1}"));
+  EXPECT_FALSE(IsSupported("a{1001}"));
+  EXPECT_FALSE(IsSupported("\\bfoo"));
+  EXPECT_FALSE(IsSupported("(a{1000}){1000}"));
+}
+
+TEST(DfaRegexTest, RequiredLiteral) {
+  DfaRegex regex;
+  ASSERT_TRUE(regex.Init(".*hello.*world\\d+").ok());
+  EXPECT_EQ(regex.required_literal(), "hello");
+  DfaRegex alternation;
+  ASSERT_TRUE(alternation.Init("foo|bar").ok());
+  EXPECT_EQ(alternation.required_literal(), "");
+  DfaRegex optional;
+  ASSERT_TRUE(optional.Init("a(bcd)?e+").ok());
+  EXPECT_EQ(optional.required_literal(), "a");
+
+  // The prefilter must not reject matches anywhere in long strings
+  string str(100, 'x');
+  for (int i = 0; i + 5 <= str.size(); ++i) {
+    string s = str;
+    s.replace(i, 5, "hello");
+    s += "world1";
+    EXPECT_TRUE(regex.FullMatch(s.data(), s.size())) << i;
+    s.replace(i, 5, "hellx");
+    EXPECT_FALSE(regex.FullMatch(s.data(), s.size())) << i;
+  }
+}
+
+TEST(DfaRegexTest, Pathological) {
+  // Takes exponential time with a backtracking matcher
+  DfaRegex regex;
+  ASSERT_TRUE(regex.Init("(a*)*b").ok());
+  string str(100000, 'a');
+  EXPECT_FALSE(regex.FullMatch(str.data(), str.size()));
+  EXPECT_FALSE(regex.PartialMatch(str.data(), str.size()));
+  str += "b";
+  EXPECT_TRUE(regex.FullMatch(str.data(), str.size()));
+}
+
+TEST(DfaRegexTest, CacheFlush) {
+  // The DFA for 'the 13th last char is an a' has 2^13 states
+  DfaRegex regex;
+  ASSERT_TRUE(regex.Init("(a|b)*a(a|b){12}").ok());
+  string str;
+  uint32_t x = 1;
+  for (int i = 0; i < 20000; ++i) {
+    x = x * 1103515245 + 12345;
+    str += (x >> 16) & 1 ? 'a' : 'b';
+  }
+  for (int i = 0; i < 5; ++i) {
+    int end = str.size() - i;
+    bool expected = str[end - 13] == 'a';
+    EXPECT_EQ(regex.FullMatch(str.data(), end), expected) << i;
+  }
+  EXPECT_GT(regex.num_cache_flushes(), 0);
+  EXPECT_LE(regex.num_dfa_states(), DfaRegex::MAX_DFA_STATES);
+}
+
+TEST(DfaRegexTest, Batch) {
+  DfaRegex regex;
+  ASSERT_TRUE(regex.Init("%?a[0-9]+").ok());
+  vector<string> strs;
+  strs.push_back("a1");
+  strs.push_back("a");
+  strs.push_back("%a123");
+  strs.push_back("b12");
+  strs.push_back("a99");
+  vector<StringValue> values;
+  for (int i = 0; i < strs.size(); ++i) {
+    values.push_back(StringValue(const_cast<char*>(strs[i].data()), strs[i].size()));
+  }
+  // Skip row 4
+  int sel[] = { 0, 1, 2, 3 };
+  bool results[] = { false, true, false, true, false };
+  regex.FullMatchBatch(&values[0], sel, 4, results);
+  EXPECT_TRUE(results[0]);
+  EXPECT_FALSE(results[1]);
+  EXPECT_TRUE(results[2]);
+  EXPECT_FALSE(results[3]);
+  EXPECT_FALSE(results[4]);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
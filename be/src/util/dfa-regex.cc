@@ -0,0 +1,595 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/dfa-regex.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <sstream>
+
+#include "common/object-pool.h"
+
+using namespace std;
+
+namespace impala {
+
+// Max value of the counts in {n,m}
+static const int MAX_REPEAT = 1000;
+
+const int DfaRegex::MAX_DFA_STATES;
+const int DfaRegex::MAX_PROGRAM_SIZE;
+
+int DfaRegex::ByteSet::Count(uint8_t* c) const {
+  int count = 0;
+  for (int i = 0; i < 256; ++i) {
+    if (Contains(i)) {
+      *c = i;
+      ++count;
+    }
+  }
+  return count;
+}
+
+DfaRegex::DfaRegex()
+  : pos_(0),
+    anchored_start_(false),
+    anchored_end_(false),
+    start_pc_(-1),
+    num_byte_classes_(0),
+    visit_id_(0),
+    num_cache_flushes_(0) {
+  unanchored_dfa_.unanchored = true;
+}
+
+Status DfaRegex::Init(const string& pattern) {
+  pattern_ = pattern;
+  pos_ = 0;
+  int end = pattern_.size();
+  if (!pattern_.empty() && pattern_[0] == '^') {
+    anchored_start_ = true;
+    pos_ = 1;
+  }
+  if (end > pos_ && pattern_[end - 1] == '$') {
+    // The '$' is escaped if it's preceded by an odd number of backslashes
+    int num_backslashes = 0;
+    for (int i = end - 2; i >= pos_ && pattern_[i] == '\\'; --i) ++num_backslashes;
+    if (num_backslashes % 2 == 0) {
+      anchored_end_ = true;
+      pattern_.resize(end - 1);
+    }
+  }
+
+  // The parse tree is only needed until the pattern is compiled
+  ObjectPool pool;
+  Node* root;
+  bool is_alternation;
+  RETURN_IF_ERROR(ParseAlternation(&pool, &root, &is_alternation));
+  if (pos_ < pattern_.size()) return ParseError("unmatched ')'");
+  // The anchors only apply to the first resp. last alternative, which the matcher
+  // can't express
+  if (is_alternation && (anchored_start_ || anchored_end_)) {
+    return ParseError("'^' or '$' in a top-level alternation");
+  }
+
+  program_.push_back(Inst(Inst::MATCH, -1, 0));
+  start_pc_ = Compile(root, 0);
+  if (start_pc_ < 0) return ParseError("pattern is too large");
+  visited_.resize(program_.size(), 0);
+  ComputeByteClasses();
+
+  required_literal_ = RequiredLiteral(root);
+  required_literal_sv_ =
+      StringValue(const_cast<char*>(required_literal_.data()), required_literal_.size());
+  required_literal_search_ = StringSearch(&required_literal_sv_);
+  return Status::OK;
+}
+
+Status DfaRegex::ParseError(const string& msg) const {
+  stringstream ss;
+  ss << "Unsupported regular expression '" << pattern_ << "' at position " << pos_
+     << ": " << msg;
+  return Status(ss.str());
+}
+
+Status DfaRegex::ParseAlternation(ObjectPool* pool, Node** node,
+    bool* is_alternation) {
+  Node* first;
+  RETURN_IF_ERROR(ParseConcatenation(pool, &first));
+  bool has_alternatives = pos_ < pattern_.size() && pattern_[pos_] == '|';
+  if (is_alternation != NULL) *is_alternation = has_alternatives;
+  if (!has_alternatives) {
+    *node = first;
+    return Status::OK;
+  }
+  Node* alternation = pool->Add(new Node(Node::ALTERNATE));
+  alternation->children.push_back(first);
+  while (pos_ < pattern_.size() && pattern_[pos_] == '|') {
+    ++pos_;
+    Node* next;
+    RETURN_IF_ERROR(ParseConcatenation(pool, &next));
+    alternation->children.push_back(next);
+  }
+  *node = alternation;
+  return Status::OK;
+}
+
+Status DfaRegex::ParseConcatenation(ObjectPool* pool, Node** node) {
+  Node* concatenation = pool->Add(new Node(Node::CONCAT));
+  while (pos_ < pattern_.size() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+    Node* next;
+    RETURN_IF_ERROR(ParseRepetition(pool, &next));
+    concatenation->children.push_back(next);
+  }
+  if (concatenation->children.empty()) {
+    *node = pool->Add(new Node(Node::EMPTY));
+  } else if (concatenation->children.size() == 1) {
+    *node = concatenation->children[0];
+  } else {
+    *node = concatenation;
+  }
+  return Status::OK;
+}
+
+Status DfaRegex::ParseInt(int* value) {
+  int start = pos_;
+  *value = 0;
+  while (pos_ < pattern_.size() && isdigit(pattern_[pos_])) {
+    *value = *value * 10 + (pattern_[pos_] - '0');
+    if (*value > MAX_REPEAT) return ParseError("repeat count is too large");
+    ++pos_;
+  }
+  if (pos_ == start) return ParseError("expected a number");
+  return Status::OK;
+}
+
+Status DfaRegex::ParseRepetition(ObjectPool* pool, Node** node) {
+  RETURN_IF_ERROR(ParseAtom(pool, node));
+  bool repeated = false;
+  while (pos_ < pattern_.size()) {
+    int min, max;
+    char c = pattern_[pos_];
+    if (c == '*') {
+      min = 0;
+      max = -1;
+      ++pos_;
+    } else if (c == '+') {
+      min = 1;
+      max = -1;
+      ++pos_;
+    } else if (c == '?') {
+      min = 0;
+      max = 1;
+      ++pos_;
+    } else if (c == '{') {
+      ++pos_;
+      RETURN_IF_ERROR(ParseInt(&min));
+      max = min;
+      if (pos_ < pattern_.size() && pattern_[pos_] == ',') {
+        ++pos_;
+        max = -1;
+        if (pos_ < pattern_.size() && pattern_[pos_] != '}') {
+          RETURN_IF_ERROR(ParseInt(&max));
+          if (max < min) return ParseError("invalid repeat range");
+        }
+      }
+      if (pos_ == pattern_.size() || pattern_[pos_] != '}') {
+        return ParseError("expected '}'");
+      }
+      ++pos_;
+    } else {
+      break;
+    }
+    // Stacked quantifiers (e.g. non-greedy ones) are left to boost::regex
+    if (repeated) return ParseError("repeated quantifier");
+    repeated = true;
+    Node* repeat = pool->Add(new Node(Node::REPEAT));
+    repeat->children.push_back(*node);
+    repeat->min = min;
+    repeat->max = max;
+    *node = repeat;
+  }
+  return Status::OK;
+}
+
+Status DfaRegex::ParseAtom(ObjectPool* pool, Node** node) {
+  DCHECK_LT(pos_, pattern_.size());
+  char c = pattern_[pos_];
+  switch (c) {
+    case '(': {
+      ++pos_;
+      if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+        return ParseError("unsupported group");
+      }
+      RETURN_IF_ERROR(ParseAlternation(pool, node));
+      if (pos_ == pattern_.size() || pattern_[pos_] != ')') {
+        return ParseError("expected ')'");
+      }
+      ++pos_;
+      return Status::OK;
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      return ParseError("quantifier without operand");
+    case '^':
+    case '$':
+      return ParseError("anchors are only supported at the start resp. end");
+    default:
+      break;
+  }
+
+  Node* bytes = pool->Add(new Node(Node::BYTES));
+  if (c == '.') {
+    bytes->bytes.Negate();
+    ++pos_;
+  } else if (c == '[') {
+    ++pos_;
+    RETURN_IF_ERROR(ParseBracket(&bytes->bytes));
+  } else if (c == '\\') {
+    ++pos_;
+    RETURN_IF_ERROR(ParseEscape(&bytes->bytes));
+  } else {
+    bytes->bytes.Add(c);
+    ++pos_;
+  }
+  *node = bytes;
+  return Status::OK;
+}
+
+Status DfaRegex::ParseEscape(ByteSet* bytes) {
+  if (pos_ == pattern_.size()) return ParseError("trailing '\\'");
+  char c = pattern_[pos_++];
+  switch (c) {
+    case 'd':
+    case 'D':
+      bytes->AddRange('0', '9');
+      if (c == 'D') bytes->Negate();
+      return Status::OK;
+    case 'w':
+    case 'W':
+      for (int i = 0; i < 128; ++i) {
+        if (isalnum(i)) bytes->Add(i);
+      }
+      bytes->Add('_');
+      if (c == 'W') bytes->Negate();
+      return Status::OK;
+    case 's':
+    case 'S':
+      for (int i = 0; i < 128; ++i) {
+        if (isspace(i)) bytes->Add(i);
+      }
+      if (c == 'S') bytes->Negate();
+      return Status::OK;
+    case 'n':
+      bytes->Add('\n');
+      return Status::OK;
+    case 't':
+      bytes->Add('\t');
+      return Status::OK;
+    case 'r':
+      bytes->Add('\r');
+      return Status::OK;
+    default:
+      // Back references, word boundaries etc. aren't supported
+      if (isalnum(c)) return ParseError("unsupported escape sequence");
+      bytes->Add(c);
+      return Status::OK;
+  }
+}
+
+Status DfaRegex::ParseBracket(ByteSet* bytes) {
+  bool negate = false;
+  if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+    negate = true;
+    ++pos_;
+  }
+  bool first = true;
+  while (true) {
+    if (pos_ == pattern_.size()) return ParseError("expected ']'");
+    char c = pattern_[pos_];
+    if (c == ']' && !first) {
+      ++pos_;
+      break;
+    }
+    first = false;
+    if (c == '\\') {
+      // Whether this is an escape depends on the regex flags, leave it to boost
+      return ParseError("'\\' in bracket expression");
+    }
+    if (c == '[' && pos_ + 1 < pattern_.size()) {
+      char next = pattern_[pos_ + 1];
+      if (next == '=' || next == '.') return ParseError("unsupported bracket element");
+      if (next == ':') {
+        size_t end = pattern_.find(":]", pos_ + 2);
+        if (end == string::npos) return ParseError("expected ':]'");
+        string name = pattern_.substr(pos_ + 2, end - pos_ - 2);
+        for (int i = 0; i < 128; ++i) {
+          bool in_class;
+          if (name == "alpha") {
+            in_class = isalpha(i);
+          } else if (name == "digit") {
+            in_class = isdigit(i);
+          } else if (name == "alnum") {
+            in_class = isalnum(i);
+          } else if (name == "upper") {
+            in_class = isupper(i);
+          } else if (name == "lower") {
+            in_class = islower(i);
+          } else if (name == "space") {
+            in_class = isspace(i);
+          } else if (name == "blank") {
+            in_class = (i == ' ' || i == '\t');
+          } else if (name == "punct") {
+            in_class = ispunct(i);
+          } else if (name == "xdigit") {
+            in_class = isxdigit(i);
+          } else if (name == "cntrl") {
+            in_class = iscntrl(i);
+          } else if (name == "print") {
+            in_class = isprint(i);
+          } else if (name == "graph") {
+            in_class = isgraph(i);
+          } else {
+            return ParseError("unknown character class");
+          }
+          if (in_class) bytes->Add(i);
+        }
+        pos_ = end + 2;
+        continue;
+      }
+    }
+    ++pos_;
+    if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' &&
+        pattern_[pos_ + 1] != ']') {
+      char to = pattern_[pos_ + 1];
+      if (to == '[' || to == '\\') return ParseError("unsupported range");
+      if (static_cast<uint8_t>(to) < static_cast<uint8_t>(c)) {
+        return ParseError("invalid range");
+      }
+      bytes->AddRange(c, to);
+      pos_ += 2;
+    } else {
+      bytes->Add(c);
+    }
+  }
+  if (negate) bytes->Negate();
+  return Status::OK;
+}
+
+string DfaRegex::RequiredLiteral(const Node* node) {
+  uint8_t c;
+  switch (node->type) {
+    case Node::BYTES:
+      if (node->bytes.Count(&c) == 1) return string(1, c);
+      return "";
+    case Node::REPEAT:
+      if (node->min > 0) return RequiredLiteral(node->children[0]);
+      return "";
+    case Node::CONCAT: {
+      // Consecutive single bytes form a literal, otherwise use the longest literal
+      // of a child.
+      string longest;
+      string current;
+      for (int i = 0; i < node->children.size(); ++i) {
+        const Node* child = node->children[i];
+        if (child->type == Node::BYTES && child->bytes.Count(&c) == 1) {
+          current.append(1, c);
+          continue;
+        }
+        if (current.size() > longest.size()) longest = current;
+        current.clear();
+        string child_literal = RequiredLiteral(child);
+        if (child_literal.size() > longest.size()) longest = child_literal;
+      }
+      if (current.size() > longest.size()) longest = current;
+      return longest;
+    }
+    default:
+      return "";
+  }
+}
+
+int DfaRegex::Compile(const Node* node, int next) {
+  if (next < 0 || program_.size() > MAX_PROGRAM_SIZE) return -1;
+  switch (node->type) {
+    case Node::EMPTY:
+      return next;
+    case Node::BYTES:
+      byte_sets_.push_back(node->bytes);
+      program_.push_back(Inst(Inst::BYTES, next, byte_sets_.size() - 1));
+      return program_.size() - 1;
+    case Node::CONCAT:
+      for (int i = node->children.size() - 1; i >= 0; --i) {
+        next = Compile(node->children[i], next);
+        if (next < 0) return -1;
+      }
+      return next;
+    case Node::ALTERNATE: {
+      int pc = Compile(node->children.back(), next);
+      for (int i = node->children.size() - 2; i >= 0 && pc >= 0; --i) {
+        int child_pc = Compile(node->children[i], next);
+        if (child_pc < 0) return -1;
+        program_.push_back(Inst(Inst::SPLIT, child_pc, pc));
+        pc = program_.size() - 1;
+      }
+      return pc;
+    }
+    case Node::REPEAT: {
+      const Node* child = node->children[0];
+      int pc = next;
+      if (node->max == -1) {
+        // The loop: a split that either runs the child and comes back or continues
+        program_.push_back(Inst(Inst::SPLIT, -1, next));
+        int loop_pc = program_.size() - 1;
+        int child_pc = Compile(child, loop_pc);
+        if (child_pc < 0) return -1;
+        program_[loop_pc].out = child_pc;
+        pc = loop_pc;
+      } else {
+        // Optional copies for the repetitions beyond min
+        for (int i = node->min; i < node->max && pc >= 0; ++i) {
+          int child_pc = Compile(child, pc);
+          if (child_pc < 0) return -1;
+          program_.push_back(Inst(Inst::SPLIT, child_pc, next));
+          pc = program_.size() - 1;
+        }
+      }
+      for (int i = 0; i < node->min && pc >= 0; ++i) {
+        pc = Compile(child, pc);
+      }
+      return pc;
+    }
+  }
+  return -1;
+}
+
+void DfaRegex::ComputeByteClasses() {
+  // Start with one class and split classes by membership in each byte set
+  for (int c = 0; c < 256; ++c) byte_classes_[c] = 0;
+  num_byte_classes_ = 1;
+  for (int i = 0; i < byte_sets_.size(); ++i) {
+    // new_class[old class * 2 + in set]
+    vector<int> new_class(num_byte_classes_ * 2, -1);
+    int num_new_classes = 0;
+    for (int c = 0; c < 256; ++c) {
+      int key = byte_classes_[c] * 2 + byte_sets_[i].Contains(c);
+      if (new_class[key] == -1) new_class[key] = num_new_classes++;
+      byte_classes_[c] = new_class[key];
+    }
+    num_byte_classes_ = num_new_classes;
+  }
+  class_bytes_.resize(num_byte_classes_);
+  for (int c = 255; c >= 0; --c) class_bytes_[byte_classes_[c]] = c;
+}
+
+void DfaRegex::AddClosure(int pc, vector<int>* insts) {
+  // Explicit stack, the program can be deeply nested
+  vector<int> stack(1, pc);
+  while (!stack.empty()) {
+    pc = stack.back();
+    stack.pop_back();
+    if (visited_[pc] == visit_id_) continue;
+    visited_[pc] = visit_id_;
+    const Inst& inst = program_[pc];
+    if (inst.op == Inst::SPLIT) {
+      stack.push_back(inst.arg);
+      stack.push_back(inst.out);
+    } else {
+      insts->push_back(pc);
+    }
+  }
+}
+
+int DfaRegex::AddState(Dfa* dfa, const vector<int>& insts) {
+  map<vector<int>, int>::iterator it = dfa->state_ids.find(insts);
+  if (it != dfa->state_ids.end()) return it->second;
+  if (dfa->state_insts.size() >= MAX_DFA_STATES) {
+    // Start over.  Each step still takes time linear in the size of the program.
+    dfa->state_insts.clear();
+    dfa->state_is_match.clear();
+    dfa->state_ids.clear();
+    dfa->transitions.clear();
+    dfa->start = -1;
+    ++num_cache_flushes_;
+  }
+  int id = dfa->state_insts.size();
+  dfa->state_insts.push_back(insts);
+  bool is_match = false;
+  for (int i = 0; i < insts.size(); ++i) {
+    if (program_[insts[i]].op == Inst::MATCH) is_match = true;
+  }
+  dfa->state_is_match.push_back(is_match);
+  dfa->state_ids[insts] = id;
+  dfa->transitions.resize(dfa->transitions.size() + num_byte_classes_, -1);
+  return id;
+}
+
+int DfaRegex::StartState(Dfa* dfa) {
+  if (dfa->start == -1) {
+    vector<int> insts;
+    ++visit_id_;
+    AddClosure(start_pc_, &insts);
+    sort(insts.begin(), insts.end());
+    dfa->start = AddState(dfa, insts);
+  }
+  return dfa->start;
+}
+
+int DfaRegex::Step(Dfa* dfa, int state, int byte_class) {
+  uint8_t c = class_bytes_[byte_class];
+  vector<int> insts;
+  ++visit_id_;
+  const vector<int>& from = dfa->state_insts[state];
+  for (int i = 0; i < from.size(); ++i) {
+    const Inst& inst = program_[from[i]];
+    if (inst.op == Inst::BYTES && byte_sets_[inst.arg].Contains(c)) {
+      AddClosure(inst.out, &insts);
+    }
+  }
+  if (dfa->unanchored) AddClosure(start_pc_, &insts);
+  sort(insts.begin(), insts.end());
+  int num_flushes = num_cache_flushes_;
+  int next = AddState(dfa, insts);
+  // If the cache was flushed, 'state' doesn't exist anymore
+  if (num_cache_flushes_ == num_flushes) {
+    dfa->transitions[state * num_byte_classes_ + byte_class] = next;
+  }
+  return next;
+}
+
+bool DfaRegex::Run(Dfa* dfa, const char* str, int len, bool stop_at_match) {
+  int state = StartState(dfa);
+  for (int i = 0; i < len; ++i) {
+    if (stop_at_match && dfa->state_is_match[state]) return true;
+    // An empty state can't reach a match anymore
+    if (dfa->state_insts[state].empty()) return false;
+    int byte_class = byte_classes_[static_cast<uint8_t>(str[i])];
+    int next = dfa->transitions[state * num_byte_classes_ + byte_class];
+    if (next < 0) next = Step(dfa, state, byte_class);
+    state = next;
+  }
+  return dfa->state_is_match[state];
+}
+
+bool DfaRegex::ContainsRequiredLiteral(const char* str, int len) const {
+  if (required_literal_.empty()) return true;
+  StringValue str_sv(const_cast<char*>(str), len);
+  return required_literal_search_.Search(&str_sv) != -1;
+}
+
+bool DfaRegex::FullMatch(const char* str, int len) {
+  if (!ContainsRequiredLiteral(str, len)) return false;
+  return Run(&anchored_dfa_, str, len, false);
+}
+
+bool DfaRegex::PartialMatch(const char* str, int len) {
+  if (!ContainsRequiredLiteral(str, len)) return false;
+  Dfa* dfa = anchored_start_ ? &anchored_dfa_ : &unanchored_dfa_;
+  return Run(dfa, str, len, !anchored_end_);
+}
+
+void DfaRegex::FullMatchBatch(const StringValue* values, const int* sel, int num_rows,
+    bool* results) {
+  for (int i = 0; i < num_rows; ++i) {
+    const StringValue& value = values[sel[i]];
+    results[sel[i]] = FullMatch(value.ptr, value.len);
+  }
+}
+
+int DfaRegex::num_dfa_states() const {
+  return anchored_dfa_.state_insts.size() + unanchored_dfa_.state_insts.size();
+}
+
+}
@@ -0,0 +1,242 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_DFA_REGEX_H
+#define IMPALA_UTIL_DFA_REGEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "common/status.h"
+#include "runtime/string-search.h"
+#include "runtime/string-value.h"
+
+namespace impala {
+
+class ObjectPool;
+
+// Regular expression matcher that runs in time linear in the length of the input,
+// for any pattern and input.  boost::regex backtracks, which is slow in general and
+// exponential for some patterns.
+// The pattern is compiled into an NFA (Thompson's construction), which is turned into
+// a DFA lazily while matching: DFA states (sets of NFA states) and their transitions
+// are only computed when the input first reaches them and are cached after that.  The
+// cache is bounded; if it fills up, it is flushed and rebuilt on the fly.  Input bytes
+// are mapped to equivalence classes (bytes that no part of the pattern distinguishes),
+// which keeps the transition tables small.
+// If the pattern contains a literal that every match must contain, strings that don't
+// contain it are rejected up front with a (SSE4.2) substring search.
+//
+// Only matching is supported, not submatch extraction.  The pattern syntax is the
+// subset of POSIX extended regular expressions (as accepted by boost::regex with
+// regex_constants::extended) that doesn't need backtracking: literals, '.', bracket
+// expressions (including [:class:] names), \d \w \s and their negations, escaped
+// special chars, grouping, alternation and the *, +, ?, {n}, {n,} and {n,m}
+// quantifiers.  '^' and '$' are only supported at the beginning resp. end of a
+// pattern without top-level alternation ('^a|b' anchors only 'a').  Init() returns
+// an error for anything else (e.g. back references), callers fall back to
+// boost::regex then.
+// A DfaRegex is not thread safe, since matching updates the DFA cache.
+class DfaRegex {
+ public:
+  DfaRegex();
+
+  // Compiles 'pattern'.  Returns an error if the pattern isn't supported (see above);
+  // the DfaRegex must not be used then.
+  Status Init(const std::string& pattern);
+
+  // Returns true if the whole string matches the pattern (like boost::regex_match())
+  bool FullMatch(const char* str, int len);
+
+  // Returns true if a substring matches the pattern (like boost::regex_search())
+  bool PartialMatch(const char* str, int len);
+
+  // Batch version of FullMatch() for the strings values[sel[i]], 0 <= i < num_rows.
+  // The results are stored in results[sel[i]].
+  void FullMatchBatch(const StringValue* values, const int* sel, int num_rows,
+      bool* results);
+
+  // A literal that is part of every match, empty if there is none
+  const std::string& required_literal() const { return required_literal_; }
+
+  // Number of DFA states built since the cache was last flushed, and number of times
+  // it has been flushed.  Exposed for tests.
+  int num_dfa_states() const;
+  int num_cache_flushes() const { return num_cache_flushes_; }
+
+  // Max number of DFA states (per DFA) before the cache is flushed
+  static const int MAX_DFA_STATES = 2048;
+
+  // Max number of NFA instructions, larger patterns (e.g. with large repeat counts)
+  // are rejected
+  static const int MAX_PROGRAM_SIZE = 10000;
+
+ private:
+  // Set of byte values
+  struct ByteSet {
+    uint64_t bits[4];
+
+    ByteSet() { Clear(); }
+    void Clear() { bits[0] = bits[1] = bits[2] = bits[3] = 0; }
+    void Add(uint8_t c) { bits[c >> 6] |= 1ULL << (c & 63); }
+    void AddRange(uint8_t from, uint8_t to) {
+      for (int c = from; c <= to; ++c) Add(c);
+    }
+    void AddSet(const ByteSet& other) {
+      for (int i = 0; i < 4; ++i) bits[i] |= other.bits[i];
+    }
+    void Negate() {
+      for (int i = 0; i < 4; ++i) bits[i] = ~bits[i];
+    }
+    bool Contains(uint8_t c) const { return bits[c >> 6] & (1ULL << (c & 63)); }
+    // Returns the number of bytes in the set and one of them in *c
+    int Count(uint8_t* c) const;
+  };
+
+  // Parse tree node
+  struct Node {
+    enum Type { EMPTY, BYTES, CONCAT, ALTERNATE, REPEAT };
+    Type type;
+    // For BYTES
+    ByteSet bytes;
+    // For CONCAT and ALTERNATE (all children) and REPEAT (one child)
+    std::vector<Node*> children;
+    // For REPEAT: min and max number of repetitions, max is -1 if unbounded
+    int min;
+    int max;
+
+    explicit Node(Type type) : type(type), min(0), max(0) { }
+  };
+
+  // Recursive descent parser over pattern_, creates nodes in 'pool'.  Each function
+  // parses the construct at pos_ and sets *node, or returns an error.
+  // ParseAlternation() sets '*is_alternation' (if non-NULL) to whether it parsed more
+  // than one alternative.
+  Status ParseAlternation(ObjectPool* pool, Node** node, bool* is_alternation = NULL);
+  Status ParseConcatenation(ObjectPool* pool, Node** node);
+  Status ParseRepetition(ObjectPool* pool, Node** node);
+  Status ParseAtom(ObjectPool* pool, Node** node);
+  Status ParseBracket(ByteSet* bytes);
+  Status ParseEscape(ByteSet* bytes);
+  Status ParseInt(int* value);
+  Status ParseError(const std::string& msg) const;
+
+  // Returns the longest literal every match of 'node' contains
+  static std::string RequiredLiteral(const Node* node);
+
+  // NFA instruction
+  struct Inst {
+    enum Op {
+      BYTES,  // consumes a byte in byte_sets_[arg] and continues at 'out'
+      SPLIT,  // continues at both 'out' and 'arg'
+      MATCH,
+    };
+    Op op;
+    int out;
+    int arg;
+
+    Inst(Op op, int out, int arg) : op(op), out(out), arg(arg) { }
+  };
+
+  // Compiles 'node' into program_ so that it continues at 'next' after matching.
+  // Returns the first instruction, or -1 if the program gets too large.
+  int Compile(const Node* node, int next);
+
+  // Computes byte_classes_ from byte_sets_
+  void ComputeByteClasses();
+
+  // Lazily built DFA over the NFA in program_
+  struct Dfa {
+    // If true, the NFA start state is added to every DFA state, i.e. a match can
+    // start anywhere in the input.
+    bool unanchored;
+
+    // The NFA instructions (BYTES and MATCH only) of each DFA state, and whether they
+    // include MATCH
+    std::vector<std::vector<int> > state_insts;
+    std::vector<bool> state_is_match;
+    std::map<std::vector<int>, int> state_ids;
+
+    // Transitions, indexed by state * num_byte_classes_ + byte class.  -1 if they
+    // haven't been computed yet.
+    std::vector<int> transitions;
+
+    // Start state, -1 if it hasn't been built since the last flush
+    int start;
+
+    Dfa() : unanchored(false), start(-1) { }
+  };
+
+  // Returns the start state of 'dfa', building it if necessary
+  int StartState(Dfa* dfa);
+
+  // Computes the transition of 'state' on bytes of 'byte_class', adds the target state
+  // if it's new and returns it.  Flushes the cache if it's full.
+  int Step(Dfa* dfa, int state, int byte_class);
+
+  // Returns the id of the state for 'insts', adding it if it's new
+  int AddState(Dfa* dfa, const std::vector<int>& insts);
+
+  // Adds the instructions reachable from 'pc' without consuming input to 'insts',
+  // in the order in which they are reached.  Uses and updates visited_.
+  void AddClosure(int pc, std::vector<int>* insts);
+
+  // Runs 'dfa' over the input.  If 'stop_at_match', returns true as soon as a match
+  // state is reached, otherwise only if the last state is a match state.
+  bool Run(Dfa* dfa, const char* str, int len, bool stop_at_match);
+
+  // Returns false if the string can't match since it doesn't contain
+  // required_literal_
+  bool ContainsRequiredLiteral(const char* str, int len) const;
+
+  std::string pattern_;
+  // Parse position in pattern_
+  int pos_;
+
+  bool anchored_start_;
+  bool anchored_end_;
+
+  std::vector<Inst> program_;
+  std::vector<ByteSet> byte_sets_;
+  int start_pc_;
+
+  // Byte class of each byte value and the number of classes
+  int byte_classes_[256];
+  int num_byte_classes_;
+  // A byte of each class
+  std::vector<uint8_t> class_bytes_;
+
+  // For FullMatch() and PartialMatch() of patterns that start with '^'
+  Dfa anchored_dfa_;
+  // For PartialMatch() of other patterns
+  Dfa unanchored_dfa_;
+
+  // Per NFA instruction, the value of visit_id_ when it was last visited by
+  // AddClosure()
+  std::vector<int> visited_;
+  int visit_id_;
+
+  int num_cache_flushes_;
+
+  std::string required_literal_;
+  StringValue required_literal_sv_;
+  StringSearch required_literal_search_;
+};
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "util/heavy-hitters.h"
+
+using namespace std;
+
+namespace impala {
+
+TEST(HeavyHittersTest, Exact) {
+  // Fewer distinct keys than the capacity: the counts are exact
+  HeavyHitters hh(10);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      hh.Add(i);
+    }
+  }
+  EXPECT_EQ(hh.num_added(), 15);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(hh.EstimateCount(i), i + 1);
+  }
+  EXPECT_EQ(hh.EstimateCount(100), 0);
+
+  vector<pair<uint32_t, int64_t> > result;
+  hh.GetHeavyHitters(4, &result);
+  map<uint32_t, int64_t> heavy(result.begin(), result.end());
+  EXPECT_EQ(heavy.size(), 2);
+  EXPECT_EQ(heavy[3], 4);
+  EXPECT_EQ(heavy[4], 5);
+}
+
+TEST(HeavyHittersTest, Skewed) {
+  // Two keys make up 20% and 10% of the stream, the rest is spread over many keys.
+  HeavyHitters hh(20);
+  const int NUM_VALUES = 100000;
+  map<uint32_t, int64_t> counts;
+  srand(0);
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    uint32_t key;
+    if (i % 10 < 2) {
+      key = 1000000;
+    } else if (i % 10 == 2) {
+      key = 2000000;
+    } else {
+      key = rand() % 10000;
+    }
+    ++counts[key];
+    hh.Add(key);
+  }
+
+  // The heavy keys are tracked and never underestimated
+  EXPECT_GE(hh.EstimateCount(1000000), counts[1000000]);
+  EXPECT_GE(hh.EstimateCount(2000000), counts[2000000]);
+
+  // Only the heavy keys are guaranteed to occur more than 5% of the time, with
+  // lower bounds that are below the true counts.
+  vector<pair<uint32_t, int64_t> > result;
+  hh.GetHeavyHitters(NUM_VALUES / 20, &result);
+  map<uint32_t, int64_t> heavy(result.begin(), result.end());
+  EXPECT_EQ(heavy.size(), 2);
+  ASSERT_TRUE(heavy.find(1000000) != heavy.end());
+  ASSERT_TRUE(heavy.find(2000000) != heavy.end());
+  EXPECT_LE(heavy[1000000], counts[1000000]);
+  EXPECT_LE(heavy[2000000], counts[2000000]);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
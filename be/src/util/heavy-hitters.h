@@ -0,0 +1,107 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_HEAVY_HITTERS_H
+#define IMPALA_UTIL_HEAVY_HITTERS_H
+
+#include <utility>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <glog/logging.h>
+
+namespace impala {
+
+// Finds the most frequent keys of a stream in constant space, using the Space-Saving
+// algorithm (Metwally et al., "Efficient Computation of Frequent and Top-k Elements
+// in Data Streams").
+// Up to 'capacity' keys are tracked with a count.  A key that is not tracked replaces
+// the tracked key with the smallest count and inherits that count as its error.  Every
+// key that occurs more than num_added() / capacity times is guaranteed to be tracked,
+// and its count overestimates the true count by at most its error.
+// Keys are typically hashes of the actual values.
+// This class is not thread safe.
+class HeavyHitters {
+ public:
+  explicit HeavyHitters(int capacity) : capacity_(capacity), num_added_(0) {
+    DCHECK_GT(capacity, 0);
+    entries_.reserve(capacity);
+  }
+
+  void Add(uint32_t key) {
+    ++num_added_;
+    boost::unordered_map<uint32_t, int>::iterator it = key_to_entry_.find(key);
+    if (it != key_to_entry_.end()) {
+      ++entries_[it->second].count;
+      return;
+    }
+    if (static_cast<int>(entries_.size()) < capacity_) {
+      key_to_entry_[key] = entries_.size();
+      entries_.push_back(Entry(key, 1, 0));
+      return;
+    }
+    // Replace the entry with the smallest count.  The capacity is small, so a linear
+    // scan is cheaper than maintaining a heap on every increment.
+    int min_idx = 0;
+    for (int i = 1; i < entries_.size(); ++i) {
+      if (entries_[i].count < entries_[min_idx].count) min_idx = i;
+    }
+    Entry* entry = &entries_[min_idx];
+    key_to_entry_.erase(entry->key);
+    key_to_entry_[key] = min_idx;
+    *entry = Entry(key, entry->count + 1, entry->count);
+  }
+
+  // Number of keys added so far.
+  int64_t num_added() const { return num_added_; }
+
+  // Returns the keys that occurred at least 'min_count' times for certain, with their
+  // guaranteed (i.e. lower bound) count.
+  void GetHeavyHitters(int64_t min_count,
+      std::vector<std::pair<uint32_t, int64_t> >* result) const {
+    result->clear();
+    for (int i = 0; i < entries_.size(); ++i) {
+      int64_t guaranteed_count = entries_[i].count - entries_[i].error;
+      if (guaranteed_count >= min_count) {
+        result->push_back(std::make_pair(entries_[i].key, guaranteed_count));
+      }
+    }
+  }
+
+  // Returns the (over)estimated count of 'key', or 0 if it's not tracked.
+  int64_t EstimateCount(uint32_t key) const {
+    boost::unordered_map<uint32_t, int>::const_iterator it = key_to_entry_.find(key);
+    return it == key_to_entry_.end() ? 0 : entries_[it->second].count;
+  }
+
+ private:
+  struct Entry {
+    uint32_t key;
+    int64_t count;
+    // Max number of times 'count' overestimates the occurrences of 'key'
+    int64_t error;
+
+    Entry(uint32_t key, int64_t count, int64_t error)
+      : key(key), count(count), error(error) { }
+  };
+
+  const int capacity_;
+  int64_t num_added_;
+  std::vector<Entry> entries_;
+  boost::unordered_map<uint32_t, int> key_to_entry_;
+};
+
+}
+
+#endif
@@ -48,6 +48,12 @@ const char* ImpaladMetricKeys::IO_MGR_NUM_BUFFERS =
     "impala-server.io-mgr.num-buffers";
 const char* ImpaladMetricKeys::IO_MGR_NUM_UNUSED_BUFFERS = 
     "impala-server.io-mgr.num-unused-buffers";
+const char* ImpaladMetricKeys::NUM_QUEUED_QUERIES =
+    "impala-server.admission.num-queued";
+const char* ImpaladMetricKeys::NUM_REJECTED_QUERIES =
+    "impala-server.admission.num-rejected";
+const char* ImpaladMetricKeys::QUERY_QUEUE_WAIT_MS =
+    "impala-server.admission.total-queue-wait-ms";
 
 // These are created by impala-server during startup.
 Metrics::StringMetric* ImpaladMetrics::IMPALA_SERVER_START_TIME = NULL;
@@ -63,6 +69,9 @@ Metrics::IntMetric* ImpaladMetrics::HASH_TABLE_TOTAL_BYTES = NULL;
 Metrics::IntMetric* ImpaladMetrics::IO_MGR_NUM_OPEN_FILES = NULL;
 Metrics::IntMetric* ImpaladMetrics::IO_MGR_NUM_BUFFERS = NULL;
 Metrics::IntMetric* ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS = NULL;
+Metrics::IntMetric* ImpaladMetrics::NUM_QUEUED_QUERIES = NULL;
+Metrics::IntMetric* ImpaladMetrics::NUM_REJECTED_QUERIES = NULL;
+Metrics::IntMetric* ImpaladMetrics::QUERY_QUEUE_WAIT_MS = NULL;
 
 void ImpaladMetrics::CreateMetrics(Metrics* m) {
   // Initialize impalad metrics
@@ -98,6 +107,14 @@ void ImpaladMetrics::CreateMetrics(Metrics* m) {
       ImpaladMetricKeys::IO_MGR_NUM_BUFFERS, 0L);
   IO_MGR_NUM_UNUSED_BUFFERS = m->CreateAndRegisterPrimitiveMetric(
       ImpaladMetricKeys::IO_MGR_NUM_UNUSED_BUFFERS, 0L);
+
+  // Initialize admission control metrics
+  NUM_QUEUED_QUERIES = m->CreateAndRegisterPrimitiveMetric(
+      ImpaladMetricKeys::NUM_QUEUED_QUERIES, 0L);
+  NUM_REJECTED_QUERIES = m->CreateAndRegisterPrimitiveMetric(
+      ImpaladMetricKeys::NUM_REJECTED_QUERIES, 0L);
+  QUERY_QUEUE_WAIT_MS = m->CreateAndRegisterPrimitiveMetric(
+      ImpaladMetricKeys::QUERY_QUEUE_WAIT_MS, 0L);
 }
 
 }
@@ -64,6 +64,15 @@ class ImpaladMetricKeys {
   
   // Number of IO buffers that are currently unused (and can be GC'ed)
   static const char* IO_MGR_NUM_UNUSED_BUFFERS;
+
+  // Number of queries currently waiting for admission, across all request pools
+  static const char* NUM_QUEUED_QUERIES;
+
+  // Number of queries rejected by admission control because a queue was full
+  static const char* NUM_REJECTED_QUERIES;
+
+  // Total time queries spent waiting for admission, in ms
+  static const char* QUERY_QUEUE_WAIT_MS;
 };
 
 // Global impalad-wide metrics.  This is useful for objects that want to update metrics
@@ -85,6 +94,9 @@ class ImpaladMetrics {
   static Metrics::IntMetric* IO_MGR_NUM_OPEN_FILES;
   static Metrics::IntMetric* IO_MGR_NUM_BUFFERS;
   static Metrics::IntMetric* IO_MGR_NUM_UNUSED_BUFFERS;
+  static Metrics::IntMetric* NUM_QUEUED_QUERIES;
+  static Metrics::IntMetric* NUM_REJECTED_QUERIES;
+  static Metrics::IntMetric* QUERY_QUEUE_WAIT_MS;
 
   // Creates and initializes all metrics above in 'm'.
   static void CreateMetrics(Metrics* m);
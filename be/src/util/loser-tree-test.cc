@@ -0,0 +1,121 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "util/loser-tree.h"
+
+using namespace std;
+
+namespace impala {
+
+// Sorted inputs with a read cursor each.
+struct Inputs {
+  vector<vector<int> > values;
+  vector<int> pos;
+
+  bool done(int i) const { return pos[i] == values[i].size(); }
+  int head(int i) const { return values[i][pos[i]]; }
+};
+
+class InputLessThan {
+ public:
+  InputLessThan(const Inputs* inputs) : inputs_(inputs) {}
+  bool operator()(int lhs, int rhs) const {
+    if (inputs_->done(lhs)) return false;
+    if (inputs_->done(rhs)) return true;
+    return inputs_->head(lhs) < inputs_->head(rhs);
+  }
+
+ private:
+  const Inputs* inputs_;
+};
+
+// Merges 'inputs' with a loser tree and verifies the result is the sorted union.
+static void TestMerge(Inputs* inputs) {
+  vector<int> expected;
+  for (int i = 0; i < inputs->values.size(); ++i) {
+    sort(inputs->values[i].begin(), inputs->values[i].end());
+    expected.insert(expected.end(), inputs->values[i].begin(), inputs->values[i].end());
+  }
+  sort(expected.begin(), expected.end());
+  inputs->pos.assign(inputs->values.size(), 0);
+
+  LoserTree<InputLessThan> tree(inputs->values.size(), InputLessThan(inputs));
+  tree.Init();
+  vector<int> result;
+  while (!inputs->done(tree.winner())) {
+    result.push_back(inputs->head(tree.winner()));
+    ++inputs->pos[tree.winner()];
+    tree.Update();
+  }
+  EXPECT_EQ(result, expected);
+  for (int i = 0; i < inputs->values.size(); ++i) {
+    EXPECT_TRUE(inputs->done(i));
+  }
+}
+
+TEST(LoserTreeTest, SingleInput) {
+  Inputs inputs;
+  inputs.values.resize(1);
+  TestMerge(&inputs);
+  inputs.values[0].push_back(3);
+  inputs.values[0].push_back(1);
+  inputs.values[0].push_back(2);
+  TestMerge(&inputs);
+}
+
+TEST(LoserTreeTest, EmptyInputs) {
+  Inputs inputs;
+  inputs.values.resize(5);
+  inputs.values[2].push_back(1);
+  inputs.values[4].push_back(0);
+  TestMerge(&inputs);
+}
+
+TEST(LoserTreeTest, Duplicates) {
+  Inputs inputs;
+  inputs.values.resize(4);
+  for (int i = 0; i < 4; ++i) {
+    inputs.values[i].assign(10, 7);
+  }
+  TestMerge(&inputs);
+}
+
+// Tests all tree shapes up to 33 inputs, i.e. both powers of 2 and uneven trees.
+TEST(LoserTreeTest, Random) {
+  srand(0);
+  for (int num_inputs = 1; num_inputs <= 33; ++num_inputs) {
+    Inputs inputs;
+    inputs.values.resize(num_inputs);
+    for (int i = 0; i < num_inputs; ++i) {
+      int num_values = rand() % 100;
+      for (int j = 0; j < num_values; ++j) {
+        inputs.values[i].push_back(rand() % 1000);
+      }
+    }
+    TestMerge(&inputs);
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
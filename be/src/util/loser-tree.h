@@ -0,0 +1,96 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_LOSER_TREE_H
+#define IMPALA_UTIL_LOSER_TREE_H
+
+#include <algorithm>
+#include <vector>
+#include <glog/logging.h>
+
+namespace impala {
+
+// Tournament tree of losers for k-way merging of sorted inputs.
+// The tree only deals with input indices; the caller keeps track of the current
+// (head) value of each input and supplies 'Less', a functor where less(i, j) returns
+// true if the head of input i sorts before the head of input j.  Exhausted inputs
+// must sort after all other inputs.
+// Each internal node stores the input that lost the match at that node, so replacing
+// the winner only needs to replay the matches on the path from its leaf to the root,
+// i.e. log2(k) comparisons, compared to ~2 * log2(k) for a binary heap.
+//
+// Usage:
+//   LoserTree<Less> tree(num_inputs, less);
+//   tree.Init();
+//   while (!exhausted(tree.winner())) {
+//     consume and advance input tree.winner();
+//     tree.Update();
+//   }
+template <typename Less>
+class LoserTree {
+ public:
+  LoserTree(int num_inputs, const Less& less)
+    : num_inputs_(num_inputs), less_(less), tree_(num_inputs) {
+    DCHECK_GT(num_inputs, 0);
+  }
+
+  // (Re)plays all matches.  Must be called before winner() and after the heads of
+  // more than one input changed.
+  void Init() {
+    tree_[0] = InitNode(1);
+  }
+
+  // Returns the index of the input with the smallest head.
+  int winner() const { return tree_[0]; }
+
+  // Must be called after the head of winner() changed (it was advanced or it became
+  // exhausted).
+  void Update() {
+    int winner = tree_[0];
+    for (int node = (winner + num_inputs_) / 2; node > 0; node /= 2) {
+      if (less_(tree_[node], winner)) std::swap(tree_[node], winner);
+    }
+    tree_[0] = winner;
+  }
+
+  int num_inputs() const { return num_inputs_; }
+
+ private:
+  // The tree is stored like a binary heap: the children of node n are 2n and 2n + 1.
+  // Nodes [1, num_inputs_) are the internal nodes and node num_inputs_ + i is the
+  // (implicit) leaf for input i.  Returns the winner of the subtree rooted at 'node'.
+  int InitNode(int node) {
+    if (node >= num_inputs_) return node - num_inputs_;
+    int left = InitNode(2 * node);
+    int right = InitNode(2 * node + 1);
+    if (less_(right, left)) {
+      tree_[node] = left;
+      return right;
+    }
+    tree_[node] = right;
+    return left;
+  }
+
+  const int num_inputs_;
+  Less less_;
+
+  // tree_[0] is the overall winner, tree_[1, num_inputs_) the losers of the internal
+  // nodes.
+  std::vector<int> tree_;
+};
+
+}
+
+#endif
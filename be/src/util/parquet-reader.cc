@@ -29,6 +29,8 @@
 #define ARITHMETIC_RIGHT_SHIFT 1
 #include <thrift/protocol/TCompactProtocol.h>
 
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
 #include "util/rle-encoding.h"
 
 DEFINE_string(file, "", "File to read");
@@ -36,6 +38,9 @@ DEFINE_int32(values_per_data_page, -1, "Number of values to output per datapage.
 DEFINE_bool(output_page_header, false, "If true, output page headers to stderr.");
 DEFINE_bool(output_to_csv, false, 
     "If true, output csv to stdout.  This can be very slow");
+DEFINE_bool(benchmark, false, "If true, benchmark decoding the definition levels and "
+    "dictionary indices of the file a value at a time against decoding them in batches. "
+    "Use with --values_per_data_page=0 to not output the values.");
 
 using namespace boost;
 using namespace parquet;
@@ -160,6 +165,139 @@ void OutputDataPage<string>(impala::RleDecoder* definition_data,
   }
 }
 
+// Outputs the values of a dictionary encoded data page.  'dict' contains the string
+// representation of the dictionary values.
+void OutputDictDataPage(impala::RleDecoder* definition_data,
+    impala::RleDecoder* dict_indices, const vector<string>& dict, int num_values) {
+  for (int n = 0; n < num_values; ++n) {
+    uint8_t definition_level;
+    bool valid = definition_data->Get(&definition_level);
+    assert(valid);
+    if (!definition_level) {
+      if (FLAGS_output_to_csv) {
+        rows_csv[base_row_idx + n].push_back("");
+      } else {
+        cerr << "Value: NULL" << endl;
+      }
+    } else {
+      uint32_t idx;
+      valid = dict_indices->Get(&idx);
+      assert(valid);
+      assert(idx < dict.size());
+      if (FLAGS_output_to_csv) {
+        rows_csv[base_row_idx + n].push_back(dict[idx]);
+      } else {
+        cerr << "Value: " << dict[idx] << endl;
+      }
+    }
+  }
+}
+
+// Decodes the 'num_values' PLAIN encoded values of a dictionary page into their
+// string representation.
+void DecodeDictionary(Type::type type, uint8_t* data, int num_values,
+    vector<string>* dict) {
+  dict->clear();
+  for (int i = 0; i < num_values; ++i) {
+    stringstream ss;
+    switch (type) {
+      case Type::INT32:
+        ss << *reinterpret_cast<int32_t*>(data);
+        data += sizeof(int32_t);
+        break;
+      case Type::INT64:
+        ss << *reinterpret_cast<int64_t*>(data);
+        data += sizeof(int64_t);
+        break;
+      case Type::FLOAT:
+        ss << *reinterpret_cast<float*>(data);
+        data += sizeof(float);
+        break;
+      case Type::DOUBLE:
+        ss << *reinterpret_cast<double*>(data);
+        data += sizeof(double);
+        break;
+      case Type::BYTE_ARRAY: {
+        int32_t len = *reinterpret_cast<int32_t*>(data);
+        data += sizeof(int32_t);
+        ss << string(reinterpret_cast<char*>(data), len);
+        data += len;
+        break;
+      }
+      default:
+        // TODO: INT96
+        assert(0);
+    }
+    dict->push_back(ss.str());
+  }
+}
+
+// RLE encoded values (definition levels or dictionary indices) of a data page, copied
+// out of the file for benchmarking.
+struct RleValues {
+  vector<uint8_t> data;
+  int bit_width;
+  int num_values;
+};
+
+// Input to the decoding benchmarks.
+struct RleBenchmarkData {
+  vector<RleValues> pages;
+  // Output buffer, large enough for the values of any page.
+  vector<uint32_t> output;
+
+  void AddPage(uint8_t* data, int len, int bit_width, int num_values) {
+    if (len == 0 || num_values == 0) return;
+    RleValues page;
+    page.data.assign(data, data + len);
+    page.bit_width = bit_width;
+    page.num_values = num_values;
+    pages.push_back(page);
+    if (output.size() < num_values) output.resize(num_values);
+  }
+};
+
+// Decodes all the pages a value at a time, like the scanner used to.
+template<typename T>
+void DecodeValueAtATime(int iters, void* d) {
+  RleBenchmarkData* data = reinterpret_cast<RleBenchmarkData*>(d);
+  T* output = reinterpret_cast<T*>(&data->output[0]);
+  for (int iter = 0; iter < iters; ++iter) {
+    for (int p = 0; p < data->pages.size(); ++p) {
+      RleValues& page = data->pages[p];
+      impala::RleDecoder decoder(&page.data[0], page.data.size(), page.bit_width);
+      for (int i = 0; i < page.num_values; ++i) {
+        decoder.Get(&output[i]);
+      }
+    }
+  }
+}
+
+// Decodes all the pages with RleDecoder::GetBatch().
+template<typename T>
+void DecodeBatch(int iters, void* d) {
+  RleBenchmarkData* data = reinterpret_cast<RleBenchmarkData*>(d);
+  T* output = reinterpret_cast<T*>(&data->output[0]);
+  for (int iter = 0; iter < iters; ++iter) {
+    for (int p = 0; p < data->pages.size(); ++p) {
+      RleValues& page = data->pages[p];
+      impala::RleDecoder decoder(&page.data[0], page.data.size(), page.bit_width);
+      decoder.GetBatch(output, page.num_values);
+    }
+  }
+}
+
+// Benchmarks decoding 'data' a value at a time and in batches.  T is the type the
+// values are decoded to.
+template<typename T>
+void RunRleBenchmark(const string& name, RleBenchmarkData* data) {
+  if (data->pages.empty()) return;
+  impala::Benchmark suite(name);
+  suite.AddBenchmark("ValueAtATime", DecodeValueAtATime<T>, data);
+  suite.AddBenchmark("Batch", DecodeBatch<T>, data);
+  cerr << suite.Measure() << endl;
+}
+
 // Simple utility to read parquet files on local disk.  This utility validates the
 // file is correctly formed and can output values from each data page.  The
 // entire file is buffered in memory so this is not suitable for very large files.
@@ -169,6 +307,7 @@ void OutputDataPage<string>(impala::RleDecoder* definition_data,
 // cout is used to output converted data (in csv)
 int main(int argc, char** argv) {
   google::ParseCommandLineFlags(&argc, &argv, true);
+  impala::CpuInfo::Init();
 
   if (FLAGS_file.size() == 0) {
     cout << "Must specify input file." << endl;
@@ -222,6 +361,12 @@ int main(int argc, char** argv) {
   // Buffer to decompress data into.  Reused across pages.
   vector<char> decompression_buffer;
 
+  // String representation of the dictionary of the current column.
+  vector<string> dict;
+
+  RleBenchmarkData def_levels_benchmark;
+  RleBenchmarkData dict_indices_benchmark;
+
   for (int i = 0; i < file_metadata.row_groups.size(); ++i) {
     cerr << "Reading row group " << i << endl;
     RowGroup& rg = file_metadata.row_groups[i];
@@ -233,9 +378,14 @@ int main(int argc, char** argv) {
       base_row_idx = rg_base_index;
       cerr << "  Reading column " << c << endl;
       ColumnChunk& col = rg.columns[c];
+      dict.clear();
       
       uint8_t* col_end = buffer + col.file_offset;
       uint8_t* data = buffer + col.meta_data.data_page_offset;
+      if (col.meta_data.__isset.dictionary_page_offset &&
+          col.meta_data.dictionary_page_offset > 0) {
+        data = min(data, buffer + col.meta_data.dictionary_page_offset);
+      }
 
       CompressionCodec::type codec = col.meta_data.codec;
       if (codec != CompressionCodec::UNCOMPRESSED &&
@@ -259,18 +409,18 @@ int main(int argc, char** argv) {
         total_compressed_data_size += header.compressed_page_size;
         total_uncompressed_data_size += header.uncompressed_page_size;
 
-        // Skip non-data or non-plain encoding
-        if (header.type != PageType::DATA_PAGE || 
-            header.data_page_header.encoding != Encoding::PLAIN) {
+        // Skip pages other than data and dictionary pages, and encodings we don't
+        // support.
+        bool is_dict_page = header.type == PageType::DICTIONARY_PAGE;
+        Encoding::type encoding = header.data_page_header.encoding;
+        if (!is_dict_page && (header.type != PageType::DATA_PAGE ||
+            (encoding != Encoding::PLAIN && encoding != Encoding::PLAIN_DICTIONARY))) {
           ++pages_skipped;
           data += header.compressed_page_size;
           continue;
         }
         ++pages_read;
 
-        int num_values = header.data_page_header.num_values;
-        if (c == 0) num_rows += num_values;
-        
         uint8_t* data_page_data = data;
 
         // Decompress if necessary
@@ -287,6 +437,16 @@ int main(int argc, char** argv) {
           data_page_data = reinterpret_cast<uint8_t*>(&decompression_buffer[0]);
         }
 
+        if (is_dict_page) {
+          DecodeDictionary(col.meta_data.type, data_page_data,
+              header.dictionary_page_header.num_values, &dict);
+          data += header.compressed_page_size;
+          continue;
+        }
+
+        int num_values = header.data_page_header.num_values;
+        if (c == 0) num_rows += num_values;
+
         int32_t num_definition_bytes = *reinterpret_cast<int32_t*>(data_page_data);
         uint8_t* definition_data = data_page_data + sizeof(int32_t);
         uint8_t* values = data_page_data + num_definition_bytes + sizeof(int32_t);
@@ -301,6 +461,33 @@ int main(int argc, char** argv) {
 
         impala::RleDecoder definition_levels(definition_data, num_definition_bytes);
 
+        if (FLAGS_benchmark) {
+          def_levels_benchmark.AddPage(definition_data, num_definition_bytes, 1,
+              num_values);
+        }
+
+        if (encoding == Encoding::PLAIN_DICTIONARY) {
+          // The dictionary indices are prefixed with their bit width.
+          int bit_width = *values;
+          int indices_len = header.uncompressed_page_size - sizeof(int32_t) -
+              num_definition_bytes - 1;
+          impala::RleDecoder dict_indices(values + 1, indices_len, bit_width);
+          if (FLAGS_benchmark) {
+            // Only the non-NULL values have an index.
+            impala::RleDecoder levels(definition_data, num_definition_bytes);
+            vector<uint8_t> levels_buffer(num_values);
+            levels.GetBatch(&levels_buffer[0], num_values);
+            int num_non_null = 0;
+            for (int i = 0; i < num_values; ++i) num_non_null += levels_buffer[i];
+            dict_indices_benchmark.AddPage(values + 1, indices_len, bit_width,
+                num_non_null);
+          }
+          OutputDictDataPage(&definition_levels, &dict_indices, dict, num_output_values);
+          data += header.compressed_page_size;
+          base_row_idx += num_output_values;
+          continue;
+        }
+
         switch (col.meta_data.type) {
           case Type::BOOLEAN:
             OutputDataPage<bool>(&definition_levels, values, num_output_values);
@@ -352,6 +539,12 @@ int main(int argc, char** argv) {
   }
   cerr << ss.str() << endl;
 
+  if (FLAGS_benchmark) {
+    cerr << impala::Benchmark::GetMachineInfo() << endl;
+    RunRleBenchmark<uint8_t>("Definition levels", &def_levels_benchmark);
+    RunRleBenchmark<uint32_t>("Dictionary indices", &dict_indices_benchmark);
+  }
+
   // Join all rows and output to csv
   for (int i = 0; i < rows_csv.size(); ++i) {
     stringstream ss;
@@ -15,6 +15,8 @@
 #ifndef IMPALA_RLE_ENCODING_H
 #define IMPALA_RLE_ENCODING_H
 
+#include <algorithm>
+
 #include "common/compiler-util.h"
 #include "util/bit-stream-utils.inline.h"
 #include "util/bit-util.h"
@@ -65,36 +67,50 @@ namespace impala {
 // <varint((25 << 1) | 1)> <25 bytes of values, bitpacked>  
 // (total 26 bytes, 1 byte overhead)
 //
-// TODO: this implementation is tailored to bit-width 1 and will need more work to
-// make it general.
+// Bit widths up to 32 are supported.  Literal values are bit packed least significant
+// bit first and repeated values are stored in the fewest bytes that fit bit-width
+// bits.  This is the hybrid RLE/bit-packing encoding Parquet uses for definition
+// levels and dictionary indices.
 
 // Decoder class for RLE encoded data.
 class RleDecoder {
  public:
   // Create a decoder object. buffer/buffer_len is the decoded data.
   // bit_width is the width of each value (before encoding).
-  // TODO: support bit_width.  Only 1 is implemented.
   RleDecoder(uint8_t* buffer, int buffer_len, int bit_width = 1) 
     : bit_reader_(buffer, buffer_len),
       bit_width_(bit_width), 
       current_value_(0),
       repeat_count_(0),
       literal_count_(0) {
-    DCHECK_EQ(bit_width_, 1);
+    DCHECK_GE(bit_width_, 1);
+    DCHECK_LE(bit_width_, 32);
   }
   
-  RleDecoder() {}
+  RleDecoder() : bit_width_(1), current_value_(0), repeat_count_(0), literal_count_(0) {}
 
   // Gets the next value.  Returns false if there are no more.
   template<typename T>
   bool Get(T* val);
 
+  // Gets the next 'num_values' values into 'values'.  Returns the number of values
+  // read, which is less than 'num_values' only if the data is exhausted or corrupt.
+  // Repeated runs are expanded with a fill and bit-width 1 literal runs are unpacked
+  // with BitReader::GetBoolBatch(), so this is much faster than calling Get() in a
+  // loop.
+  template<typename T>
+  int GetBatch(T* values, int num_values);
+
  private:
   BitReader bit_reader_;
   int bit_width_;
-  uint8_t current_value_;
+  uint64_t current_value_;
   uint32_t repeat_count_;
   uint32_t literal_count_;
+
+  // Reads the indicator of the next run and, for repeated runs, its value.  Returns
+  // false if there are no more runs.
+  bool NextCounts();
 };
 
 // Class to incrementally build the rle data.   This class does not allocate any memory.
@@ -114,10 +130,20 @@ class RleEncoder {
   RleEncoder(uint8_t* buffer, int buffer_len, int bit_width = 1) 
     : bit_width_(bit_width),
       bit_writer_(buffer, buffer_len) {
-    DCHECK_EQ(bit_width_, 1);
+    DCHECK_GE(bit_width_, 1);
+    DCHECK_LE(bit_width_, 32);
     Clear();
   }
 
+  // Returns an upper bound on the number of bytes needed to encode 'num_values'
+  // values of 'bit_width' bits, whatever the runs are.  Every group of 8 values
+  // takes at most bit_width bytes (bit packed or a repeated value) plus one byte for
+  // the indicator of its run.
+  static int MaxBufferSize(int bit_width, int num_values) {
+    return (BitUtil::Ceil(num_values, 8) + 1) * (bit_width + 1) +
+        BitReader::MAX_VLQ_BYTE_LEN;
+  }
+
   // Encode value.  Returns true if the value fits in buffer, false otherwise.
   // This value must be representable with bit_width_ bits.
   bool Put(int64_t value);
@@ -186,24 +212,29 @@ class RleEncoder {
   uint8_t* literal_indicator_byte_;
 };
    
+inline bool RleDecoder::NextCounts() {
+  // Read the next run's indicator int, it could be a literal or repeated run
+  // The int is encoded as a vlq-encoded value.
+  int32_t indicator_value = 0;
+  if (!bit_reader_.GetVlqInt(&indicator_value)) return false;
+
+  // lsb indicates if it is a literal run or repeated run
+  bool is_literal = indicator_value & 1;
+  if (is_literal) {
+    literal_count_ = (indicator_value >> 1) * 8;
+  } else {
+    repeat_count_ = indicator_value >> 1;
+    bool result =
+        bit_reader_.GetAligned(BitUtil::Ceil(bit_width_, 8), &current_value_);
+    if (UNLIKELY(!result)) return false;
+  }
+  return literal_count_ > 0 || repeat_count_ > 0;
+}
+
 template<typename T>
 inline bool RleDecoder::Get(T* val) {
   if (UNLIKELY(literal_count_ == 0 && repeat_count_ == 0)) {
-    // Read the next run's indicator int, it could be a literal or repeated run
-    // The int is encoded as a vlq-encoded value.
-    int32_t indicator_value = 0;
-    bool result = bit_reader_.GetVlqInt(&indicator_value);
-    DCHECK(result);
-
-    // lsb indicates if it is a literal run or repeated run
-    bool is_literal = indicator_value & 1;
-    if (is_literal) {
-      literal_count_ = (indicator_value >> 1) * 8;
-    } else {
-      repeat_count_ = indicator_value >> 1;
-      bool result = bit_reader_.GetAligned<T>(&current_value_);
-      DCHECK(result);
-    }
+    if (!NextCounts()) return false;
   }
 
   if (LIKELY(repeat_count_ > 0)) {
@@ -211,21 +242,51 @@ inline bool RleDecoder::Get(T* val) {
     --repeat_count_;
   } else {
     DCHECK(literal_count_ > 0);
-    DCHECK_EQ(bit_width_, 1);
-    bool value;
-    bool result = bit_reader_.GetBool(&value);
-    DCHECK(result);
-    *val = value;
+    if (!bit_reader_.GetValue(bit_width_, val)) return false;
     --literal_count_;
   }
 
   return true;
 }
 
+template<typename T>
+inline int RleDecoder::GetBatch(T* values, int num_values) {
+  int num_read = 0;
+  while (num_read < num_values) {
+    if (literal_count_ == 0 && repeat_count_ == 0) {
+      if (!NextCounts()) break;
+    }
+    int remaining = num_values - num_read;
+    if (repeat_count_ > 0) {
+      int n = std::min(remaining, static_cast<int>(repeat_count_));
+      std::fill(values + num_read, values + num_read + n,
+          static_cast<T>(current_value_));
+      repeat_count_ -= n;
+      num_read += n;
+    } else {
+      int n = std::min(remaining, static_cast<int>(literal_count_));
+      if (bit_width_ == 1 && sizeof(T) == 1) {
+        uint8_t* out = reinterpret_cast<uint8_t*>(values + num_read);
+        if (!bit_reader_.GetBoolBatch(out, n)) break;
+      } else {
+        for (int i = 0; i < n; ++i) {
+          if (!bit_reader_.GetValue(bit_width_, &values[num_read + i])) {
+            return num_read + i;
+          }
+        }
+      }
+      literal_count_ -= n;
+      num_read += n;
+    }
+  }
+  return num_read;
+}
+
 // This function buffers input values 8 at a time.  After seeing all 8 values,
 // it decides whether they should be encoded as a literal or repeated run.
 inline bool RleEncoder::Put(int64_t value) {
-  DCHECK_LT(value, 1 << bit_width_);
+  DCHECK_GE(value, 0);
+  DCHECK_LT(value, 1LL << bit_width_);
   if (UNLIKELY(buffer_full_)) return false;
 
   if (LIKELY(current_value_ == value)) {
@@ -263,10 +324,9 @@ inline void RleEncoder::FlushLiteralRun(bool update_indicator_byte) {
   }
   
   // Write all the buffered values as bit packed literals
-  DCHECK_EQ(bit_width_, 1);
   bool result = true;
   for (int i = 0; i < num_buffered_values_; ++i) {
-    result &= bit_writer_.PutBool(buffered_values_[i]);
+    result &= bit_writer_.PutValue(buffered_values_[i], bit_width_);
   }
   DCHECK(result);
   num_buffered_values_ = 0;
@@ -291,7 +351,7 @@ inline void RleEncoder::FlushRepeatedRun() {
   // The lsb of 0 indicates this is a repeated run
   int32_t indicator_value = repeat_count_ << 1 | 0;
   result &= bit_writer_.PutVlqInt(indicator_value);
-  result &= bit_writer_.PutAligned<uint8_t>(current_value_);
+  result &= bit_writer_.PutAligned(current_value_, BitUtil::Ceil(bit_width_, 8));
   DCHECK(result);
   num_buffered_values_ = 0;
   repeat_count_ = 0;
@@ -329,8 +389,6 @@ inline void RleEncoder::FlushBufferedValues(bool done) {
 }
 
 inline int RleEncoder::Flush() {
-  DCHECK_EQ(bit_width_, 1);
-
   if (literal_count_ > 0 || repeat_count_ > 0 || num_buffered_values_ > 0) {
     bool all_repeat = literal_count_ == 0 && 
         (repeat_count_ == num_buffered_values_ || num_buffered_values_ == 0);
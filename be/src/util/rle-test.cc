@@ -22,6 +22,7 @@
 
 #include "util/rle-encoding.h"
 #include "util/bit-stream-utils.h"
+#include "util/cpu-info.h"
 
 using namespace std;
 
@@ -88,27 +89,27 @@ TEST(BitArray, TestBool) {
   }
 }
 
-#if 0
-Re-enable these tests when we have support for multiple bit, bit packed
-encoding implemented.
 // Tests writing all bytes
 TEST(BitArray, TestByte) {
   const int len = 256;
   uint8_t buffer[len];
   BitWriter writer(buffer, len);
   for (int i = 0; i < len; ++i) {
-    bool result = writer.Put<uint8_t>(i);
+    bool result = writer.PutValue(i, 8);
     EXPECT_TRUE(result);
     EXPECT_EQ(buffer[i], i);
   }
+  EXPECT_FALSE(writer.PutValue(1, 1));
 
   BitReader reader(buffer, len);
-  for (int i = 0; i < 8; ++i) {
+  for (int i = 0; i < len; ++i) {
     uint8_t val;
-    bool result = reader.Get<uint8_t>(&val);
+    bool result = reader.GetValue(8, &val);
     EXPECT_TRUE(result);
     EXPECT_EQ(val, i);
   }
+  uint8_t val;
+  EXPECT_FALSE(reader.GetValue(1, &val));
 }
 
 // Test some mixed values
@@ -121,10 +122,10 @@ TEST(BitArray, TestMixed) {
   for (int i = 0; i < len; ++i) {
     bool result;
     if (i % 2 == 0) {
-      result = writer.Put<bool>(parity);
+      result = writer.PutBool(parity);
       parity = !parity;
     } else {
-      result = writer.Put<uint8_t>(i);
+      result = writer.PutValue(i, 10);
     }
     EXPECT_TRUE(result);
   }
@@ -135,35 +136,88 @@ TEST(BitArray, TestMixed) {
     bool result;
     if (i % 2 == 0) {
       bool val;
-      result = reader.Get<bool>(&val);
+      result = reader.GetBool(&val);
       EXPECT_EQ(val, parity);
       parity = !parity;
     } else {
-      uint8_t val;
-      result = reader.Get<uint8_t>(&val);
-      EXPECT_EQ(val, static_cast<uint8_t>(i));
+      int val;
+      result = reader.GetValue(10, &val);
+      EXPECT_EQ(val, i);
     }
     EXPECT_TRUE(result);
   }
 }
-#endif
+
+// Tests values of every bit width, including values that span 5 bytes.
+TEST(BitArray, TestValues) {
+  const int len = 1024;
+  uint8_t buffer[len];
+  for (int num_bits = 1; num_bits <= 32; ++num_bits) {
+    uint64_t mask = (1ULL << num_bits) - 1;
+    int num_values = len * 8 / num_bits;
+    BitWriter writer(buffer, len);
+    for (int i = 0; i < num_values; ++i) {
+      EXPECT_TRUE(writer.PutValue((i * 2654435761ULL) & mask, num_bits));
+    }
+    BitReader reader(buffer, len);
+    for (int i = 0; i < num_values; ++i) {
+      uint32_t val;
+      EXPECT_TRUE(reader.GetValue(num_bits, &val));
+      EXPECT_EQ(val, (i * 2654435761ULL) & mask) << "num_bits=" << num_bits;
+    }
+  }
+}
+
+// Tests unpacking bools in batches, starting at every bit offset.
+TEST(BitArray, TestBoolBatch) {
+  const int len = 128;
+  uint8_t buffer[len];
+  BitWriter writer(buffer, len);
+  for (int i = 0; i < len * 8; ++i) {
+    EXPECT_TRUE(writer.PutBool(i % 3 == 0 || i % 7 == 0));
+  }
+
+  uint8_t values[len * 8];
+  for (int offset = 0; offset < 8; ++offset) {
+    for (int num_values = 0; num_values < 100; num_values += 7) {
+      BitReader reader(buffer, len);
+      bool b;
+      for (int i = 0; i < offset; ++i) reader.GetBool(&b);
+      EXPECT_TRUE(reader.GetBoolBatch(values, num_values));
+      for (int i = 0; i < num_values; ++i) {
+        int idx = offset + i;
+        EXPECT_EQ(values[i], idx % 3 == 0 || idx % 7 == 0) << idx;
+      }
+      // The reader continues where the batch ended.
+      EXPECT_TRUE(reader.GetBool(&b));
+      int idx = offset + num_values;
+      EXPECT_EQ(b, idx % 3 == 0 || idx % 7 == 0);
+    }
+  }
+
+  BitReader reader(buffer, len);
+  EXPECT_FALSE(reader.GetBoolBatch(values, len * 8 + 1));
+  EXPECT_TRUE(reader.GetBoolBatch(values, len * 8));
+}
 
 // Validates encoding of values by encoding and decoding them.  If 
 // expected_encoding != NULL, also validates that the encoded buffer is 
 // exactly 'expected_encoding'.
 // if expected_len is not -1, it will validate the encoded size is correct.
+// The values are decoded both one at a time and in batches.
 void ValidateRle(const vector<int>& values, 
-    uint8_t* expected_encoding, int expected_len) {
+    uint8_t* expected_encoding, int expected_len, int bit_width = 1) {
   const int len = 64 * 1024;
   uint8_t buffer[len];
   EXPECT_LE(expected_len, len);
 
-  RleEncoder encoder(buffer, len);
+  RleEncoder encoder(buffer, len, bit_width);
   for (int i = 0; i < values.size(); ++i) {
     bool result = encoder.Put(values[i]);
     EXPECT_TRUE(result);
   }
   int encoded_len = encoder.Flush();
+  EXPECT_LE(encoded_len, RleEncoder::MaxBufferSize(bit_width, values.size()));
 
   if (expected_len != -1) {
     EXPECT_EQ(encoded_len, expected_len);
@@ -173,13 +227,38 @@ void ValidateRle(const vector<int>& values,
   }
 
   // Verify read
-  RleDecoder decoder(buffer, encoded_len);
+  RleDecoder decoder(buffer, encoded_len, bit_width);
   for (int i = 0; i < values.size(); ++i) {
-    uint8_t val;
+    uint32_t val;
     bool result = decoder.Get(&val);
     EXPECT_TRUE(result);
     EXPECT_EQ(values[i], val);
   }
+
+  // Verify batch read, using batch sizes that don't line up with the runs.
+  RleDecoder batch_decoder(buffer, encoded_len, bit_width);
+  vector<uint32_t> decoded(values.size());
+  int num_decoded = 0;
+  int batch_size = 1;
+  while (num_decoded < values.size()) {
+    int n = min<int>(batch_size, values.size() - num_decoded);
+    EXPECT_EQ(batch_decoder.GetBatch(&decoded[num_decoded], n), n);
+    num_decoded += n;
+    batch_size = batch_size * 2 + 1;
+  }
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], decoded[i]) << i;
+  }
+
+  if (bit_width == 1) {
+    // Bit width 1 byte sized values take the SIMD path for literal runs.
+    RleDecoder byte_decoder(buffer, encoded_len, bit_width);
+    vector<uint8_t> bytes(values.size());
+    EXPECT_EQ(byte_decoder.GetBatch(&bytes[0], values.size()), values.size());
+    for (int i = 0; i < values.size(); ++i) {
+      EXPECT_EQ(values[i], bytes[i]) << i;
+    }
+  }
 }
 
 TEST(Rle, SpecificSequences) {
@@ -302,6 +381,36 @@ TEST(BitRle, RepeatedPattern) {
   ValidateRle(values, NULL, -1);
 }
 
+// Tests runs of values for all bit widths that fit the (int) test values.
+TEST(Rle, BitWidths) {
+  for (int bit_width = 1; bit_width <= 31; ++bit_width) {
+    int64_t max_value = (1LL << bit_width) - 1;
+    vector<int> values;
+    srand(bit_width);
+    for (int i = 0; i < 200; ++i) {
+      int run_length = rand() % 2 == 0 ? 1 : rand() % 40 + 1;
+      int v = (static_cast<int64_t>(rand()) * rand()) & max_value;
+      for (int j = 0; j < run_length; ++j) values.push_back(v);
+    }
+    // Also include the extreme values.
+    values.push_back(0);
+    values.push_back(max_value);
+    ValidateRle(values, NULL, -1, bit_width);
+  }
+
+  // Repeated runs of 9-bit values are padded to 2 bytes.
+  uint8_t expected_buffer[6];
+  vector<int> values(50, 200);
+  values.resize(100, 300);
+  expected_buffer[0] = (50 << 1);
+  expected_buffer[1] = 200;
+  expected_buffer[2] = 0;
+  expected_buffer[3] = (50 << 1);
+  expected_buffer[4] = 300 & 0xff;
+  expected_buffer[5] = 300 >> 8;
+  ValidateRle(values, expected_buffer, 6, 9);
+}
+
 TEST(BitRle, Overflow) {
   return;
   const int len = 16;
@@ -337,6 +446,7 @@ TEST(BitRle, Overflow) {
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
   return RUN_ALL_TESTS();
 }
 
@@ -0,0 +1,122 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+
+#include "util/cpu-info.h"
+#include "util/sharded-free-list.h"
+
+using namespace std;
+
+namespace impala {
+
+TEST(ShardedFreeListTest, Basic) {
+  ShardedFreeList<int> list(4);
+  EXPECT_EQ(list.num_shards(), 4);
+  int value;
+  EXPECT_FALSE(list.Pop(&value));
+  list.Push(1);
+  list.Push(2);
+  EXPECT_EQ(list.size(), 2);
+  // Objects come back from the thread's own shard, most recently pushed first
+  EXPECT_TRUE(list.Pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_TRUE(list.Pop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(list.Pop(&value));
+  EXPECT_EQ(list.size(), 0);
+
+  for (int i = 0; i < 10; ++i) {
+    list.Push(i);
+  }
+  vector<int> values;
+  list.PopAll(&values);
+  EXPECT_EQ(values.size(), 10);
+  EXPECT_EQ(list.size(), 0);
+  EXPECT_FALSE(list.Pop(&value));
+}
+
+// Pushes 'num' values starting at 'start' from its own thread
+static void PushValues(ShardedFreeList<int>* list, int start, int num) {
+  for (int i = 0; i < num; ++i) {
+    list->Push(start + i);
+  }
+}
+
+TEST(ShardedFreeListTest, PopFromOtherShards) {
+  ShardedFreeList<int> list(4);
+  // The values end up in the shards of other threads
+  boost::thread_group threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.add_thread(new boost::thread(boost::bind(&PushValues, &list, i * 10, 10)));
+  }
+  threads.join_all();
+  EXPECT_EQ(list.size(), 40);
+  vector<int> values;
+  int value;
+  while (list.Pop(&value)) {
+    values.push_back(value);
+  }
+  EXPECT_EQ(values.size(), 40);
+  sort(values.begin(), values.end());
+  for (int i = 0; i < 40; ++i) {
+    EXPECT_EQ(values[i], i);
+  }
+}
+
+// Repeatedly takes a value from the list, or makes up a new one if it is empty, and
+// gives it back, like the io mgr does with its buffers.
+static void CycleValues(ShardedFreeList<int>* list, int num_iters, int* num_created) {
+  for (int i = 0; i < num_iters; ++i) {
+    int value;
+    if (!list->Pop(&value)) value = __sync_fetch_and_add(num_created, 1);
+    list->Push(value);
+  }
+}
+
+TEST(ShardedFreeListTest, Stress) {
+  const int NUM_THREADS = 8;
+  for (int num_shards = 1; num_shards <= NUM_THREADS; num_shards *= 2) {
+    ShardedFreeList<int> list(num_shards);
+    int num_created = 0;
+    boost::thread_group threads;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+      threads.add_thread(new boost::thread(
+          boost::bind(&CycleValues, &list, 10000, &num_created)));
+    }
+    threads.join_all();
+    // No value was lost or handed out twice
+    EXPECT_EQ(list.size(), num_created);
+    vector<int> values;
+    list.PopAll(&values);
+    sort(values.begin(), values.end());
+    EXPECT_EQ(values.size(), num_created);
+    for (int i = 0; i < values.size(); ++i) {
+      EXPECT_EQ(values[i], i);
+    }
+    EXPECT_GE(list.lock_wait_time_ns(), 0);
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_SHARDED_FREE_LIST_H
+#define IMPALA_UTIL_SHARDED_FREE_LIST_H
+
+#include <vector>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <glog/logging.h>
+
+#include "util/cpu-info.h"
+#include "util/stopwatch.h"
+
+namespace impala {
+
+// Returns a small number that identifies the calling thread, assigned on its first
+// call.  Used to spread threads over the shards of a ShardedFreeList.
+inline int ShardedFreeListThreadIdx() {
+  static int next_idx = 0;
+  static __thread int thread_idx = -1;
+  if (thread_idx < 0) thread_idx = __sync_fetch_and_add(&next_idx, 1);
+  return thread_idx;
+}
+
+// Unordered list of free objects (e.g. io buffers) that many threads take objects
+// from and give them back to.  The list is split into shards with their own lock.
+// Each thread uses the shard picked by its ShardedFreeListThreadIdx(), so threads
+// only contend if they share a shard, or if their shard is empty and they take
+// an object from another one.
+// Threads never block on an empty list; Pop() returns false and the caller
+// allocates a new object.
+// The time threads spend waiting for a shard's lock is recorded, since that is what
+// the sharding is meant to reduce.
+// Thread-safe.
+template <typename T>
+class ShardedFreeList {
+ public:
+  // Creates a list with 'num_shards' shards, or one per core if 'num_shards' <= 0.
+  // One shard behaves like a single list protected by a single lock.
+  ShardedFreeList(int num_shards = 0)
+    : size_(0), num_lock_waits_(0), lock_wait_time_ns_(0) {
+    if (num_shards <= 0) num_shards = CpuInfo::num_cores();
+    DCHECK_GT(num_shards, 0);
+    for (int i = 0; i < num_shards; ++i) {
+      shards_.push_back(new Shard());
+    }
+  }
+
+  ~ShardedFreeList() {
+    for (int i = 0; i < shards_.size(); ++i) {
+      delete shards_[i];
+    }
+  }
+
+  // Adds 'value' to the calling thread's shard.
+  void Push(const T& value) {
+    Shard* shard = shards_[ShardedFreeListThreadIdx() % shards_.size()];
+    boost::unique_lock<boost::mutex> l(shard->lock, boost::try_to_lock);
+    if (!l.owns_lock()) Wait(&l);
+    shard->values.push_back(value);
+    shard->size = shard->values.size();
+    __sync_fetch_and_add(&size_, 1);
+  }
+
+  // Takes an object from the calling thread's shard, or from the next non-empty
+  // shard if that is empty.  Returns false if all shards are empty.
+  bool Pop(T* value) {
+    if (size_ == 0) return false;
+    int idx = ShardedFreeListThreadIdx();
+    for (int i = 0; i < shards_.size(); ++i) {
+      Shard* shard = shards_[(idx + i) % shards_.size()];
+      // Unlocked read, a shard that just received an object may be skipped
+      if (shard->size == 0) continue;
+      boost::unique_lock<boost::mutex> l(shard->lock, boost::try_to_lock);
+      if (!l.owns_lock()) Wait(&l);
+      if (shard->values.empty()) continue;
+      *value = shard->values.back();
+      shard->values.pop_back();
+      shard->size = shard->values.size();
+      __sync_fetch_and_add(&size_, -1);
+      return true;
+    }
+    return false;
+  }
+
+  // Removes all objects from the list and appends them to 'values'.
+  void PopAll(std::vector<T>* values) {
+    for (int i = 0; i < shards_.size(); ++i) {
+      Shard* shard = shards_[i];
+      boost::lock_guard<boost::mutex> l(shard->lock);
+      values->insert(values->end(), shard->values.begin(), shard->values.end());
+      __sync_fetch_and_add(&size_, -static_cast<int64_t>(shard->values.size()));
+      shard->values.clear();
+      shard->size = 0;
+    }
+  }
+
+  // Returns the number of objects in the list.  Not synchronized with Push()/Pop()
+  // calls that are in progress.
+  int64_t size() const { return size_; }
+
+  int num_shards() const { return shards_.size(); }
+
+  // Returns the number of times a thread had to wait for a shard's lock and the total
+  // time it waited.
+  int64_t num_lock_waits() const { return num_lock_waits_; }
+  int64_t lock_wait_time_ns() const { return lock_wait_time_ns_; }
+
+ private:
+  struct Shard {
+    boost::mutex lock;
+    std::vector<T> values;
+    // values.size(), readable without holding lock
+    volatile int size;
+    // Keeps shards that are allocated next to each other on separate cache lines
+    char padding[64];
+
+    Shard() : size(0) { }
+  };
+
+  // Locks 'l', which another thread holds, and records the wait.
+  void Wait(boost::unique_lock<boost::mutex>* l) {
+    MonotonicStopWatch watch;
+    watch.Start();
+    l->lock();
+    __sync_fetch_and_add(&num_lock_waits_, 1);
+    __sync_fetch_and_add(&lock_wait_time_ns_, watch.ElapsedTime());
+  }
+
+  std::vector<Shard*> shards_;
+
+  // Total number of objects over all shards
+  int64_t size_;
+
+  int64_t num_lock_waits_;
+  int64_t lock_wait_time_ns_;
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <gtest/gtest.h>
+
+#include "util/thread-pool.h"
+
+using namespace std;
+
+namespace impala {
+
+static void Count(int* count) {
+  __sync_fetch_and_add(count, 1);
+}
+
+// Waits until 'num_waiting' work items are waiting, which requires them to run on
+// separate threads.
+static void WaitForAll(boost::mutex* lock, boost::condition_variable* cv,
+    int* num_waiting, int num_items) {
+  boost::unique_lock<boost::mutex> l(*lock);
+  ++*num_waiting;
+  cv->notify_all();
+  while (*num_waiting < num_items) {
+    cv->wait(l);
+  }
+}
+
+// Waits until 'count' reaches 'num' and the pool has 'num_idle' idle threads.
+static void WaitForWork(ThreadPool* pool, int* count, int num, int num_idle) {
+  while (*count < num || pool->num_idle_threads() != num_idle) {
+    usleep(1000);
+  }
+}
+
+TEST(ThreadPoolTest, Basic) {
+  ThreadPool pool(2);
+  int count = 0;
+  for (int i = 0; i < 100; ++i) {
+    pool.Offer(boost::bind(&Count, &count));
+  }
+  pool.Shutdown();
+  EXPECT_EQ(count, 100);
+  EXPECT_EQ(pool.num_threads(), 0);
+  EXPECT_EQ(pool.num_threads_created() + pool.num_threads_reused(), 100);
+}
+
+TEST(ThreadPoolTest, ReuseIdleThreads) {
+  ThreadPool pool(2);
+  int count = 0;
+  pool.Offer(boost::bind(&Count, &count));
+  WaitForWork(&pool, &count, 1, 1);
+  EXPECT_EQ(pool.num_threads_created(), 1);
+  for (int i = 0; i < 10; ++i) {
+    pool.Offer(boost::bind(&Count, &count));
+    WaitForWork(&pool, &count, i + 2, 1);
+  }
+  // All work items ran on the first thread
+  EXPECT_EQ(pool.num_threads_created(), 1);
+  EXPECT_EQ(pool.num_threads_reused(), 10);
+  EXPECT_EQ(pool.num_threads(), 1);
+  pool.Shutdown();
+  EXPECT_EQ(count, 11);
+}
+
+// Work items that block on each other get their own threads
+TEST(ThreadPoolTest, BlockingWork) {
+  const int NUM_ITEMS = 8;
+  ThreadPool pool(2);
+  boost::mutex lock;
+  boost::condition_variable cv;
+  int num_waiting = 0;
+  for (int i = 0; i < NUM_ITEMS; ++i) {
+    pool.Offer(boost::bind(&WaitForAll, &lock, &cv, &num_waiting, NUM_ITEMS));
+  }
+  pool.Shutdown();
+  EXPECT_EQ(num_waiting, NUM_ITEMS);
+  EXPECT_EQ(pool.num_threads_created(), NUM_ITEMS);
+}
+
+// Only 'max_idle_threads' threads wait for work, the others exit
+TEST(ThreadPoolTest, MaxIdleThreads) {
+  const int NUM_ITEMS = 8;
+  ThreadPool pool(2);
+  boost::mutex lock;
+  boost::condition_variable cv;
+  int num_waiting = 0;
+  for (int i = 0; i < NUM_ITEMS; ++i) {
+    pool.Offer(boost::bind(&WaitForAll, &lock, &cv, &num_waiting, NUM_ITEMS));
+  }
+  while (pool.num_threads() != 2 || pool.num_idle_threads() != 2) {
+    usleep(1000);
+  }
+  pool.Shutdown();
+  EXPECT_EQ(pool.num_threads(), 0);
+  EXPECT_EQ(pool.num_idle_threads(), 0);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/thread-pool.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "common/logging.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+ThreadPool::ThreadPool(int max_idle_threads)
+  : max_idle_threads_(max_idle_threads),
+    num_threads_(0),
+    num_idle_threads_(0),
+    num_threads_created_(0),
+    num_threads_reused_(0),
+    shutdown_(false) {
+  DCHECK_GE(max_idle_threads, 0);
+}
+
+ThreadPool::~ThreadPool() {
+  Shutdown();
+}
+
+void ThreadPool::Offer(const WorkFunction& work) {
+  lock_guard<mutex> l(lock_);
+  DCHECK(!shutdown_);
+  if (work_queue_.size() < num_idle_threads_) {
+    work_queue_.push_back(work);
+    ++num_threads_reused_;
+    work_cv_.notify_one();
+    return;
+  }
+  ++num_threads_;
+  ++num_threads_created_;
+  thread worker(bind(&ThreadPool::WorkerThread, this, work));
+  // The pool keeps track of its threads by num_threads_ only
+  worker.detach();
+}
+
+void ThreadPool::Shutdown() {
+  unique_lock<mutex> l(lock_);
+  shutdown_ = true;
+  work_cv_.notify_all();
+  while (num_threads_ > 0) {
+    exit_cv_.wait(l);
+  }
+}
+
+void ThreadPool::WorkerThread(WorkFunction work) {
+  while (true) {
+    work();
+    work.clear();
+
+    unique_lock<mutex> l(lock_);
+    if (!shutdown_ && num_idle_threads_ < max_idle_threads_) {
+      ++num_idle_threads_;
+      while (work_queue_.empty() && !shutdown_) {
+        work_cv_.wait(l);
+      }
+      --num_idle_threads_;
+      // Work that was handed to this thread still runs after a shutdown
+      if (!work_queue_.empty()) {
+        work = work_queue_.front();
+        work_queue_.pop_front();
+        continue;
+      }
+    }
+    if (--num_threads_ == 0) exit_cv_.notify_all();
+    return;
+  }
+}
+
+}
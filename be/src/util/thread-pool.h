@@ -0,0 +1,87 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_THREAD_POOL_H
+#define IMPALA_UTIL_THREAD_POOL_H
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace impala {
+
+// Pool of threads that run work items, so that short work items don't pay for
+// starting a thread each.  Threads that finish a work item wait for the next one,
+// up to 'max_idle_threads' of them; the others exit.
+// A work item that finds no idle thread gets a new one rather than waiting for a
+// running item to finish, so work items may block on each other (e.g. plan fragments
+// waiting for the fragments that send them data) without deadlocking the pool.
+// Thread-safe.
+class ThreadPool {
+ public:
+  typedef boost::function<void ()> WorkFunction;
+
+  ThreadPool(int max_idle_threads);
+
+  // Waits for all work items to finish.
+  ~ThreadPool();
+
+  // Runs 'work' on an idle thread, or on a new one if there is none.  Returns
+  // immediately.  Must not be called after Shutdown().
+  void Offer(const WorkFunction& work);
+
+  // Makes the idle threads exit and waits for all threads, and the work items they
+  // are running, to finish.
+  void Shutdown();
+
+  // Number of threads, including the idle ones
+  int num_threads() const { return num_threads_; }
+  int num_idle_threads() const { return num_idle_threads_; }
+
+  // Number of threads started since the pool was created, and number of work items
+  // that were run on an idle thread instead.
+  int64_t num_threads_created() const { return num_threads_created_; }
+  int64_t num_threads_reused() const { return num_threads_reused_; }
+
+ private:
+  // Runs 'work', and then the work items handed to the thread while it is idle.
+  void WorkerThread(WorkFunction work);
+
+  const int max_idle_threads_;
+
+  // Protects all members below
+  boost::mutex lock_;
+
+  // Work items handed to idle threads that haven't picked them up yet.  Never longer
+  // than the number of idle threads.
+  std::deque<WorkFunction> work_queue_;
+
+  // Signalled when work is queued and on shutdown
+  boost::condition_variable work_cv_;
+
+  // Signalled when the last thread exits
+  boost::condition_variable exit_cv_;
+
+  int num_threads_;
+  int num_idle_threads_;
+  int64_t num_threads_created_;
+  int64_t num_threads_reused_;
+  bool shutdown_;
+};
+
+}
+
+#endif
@@ -52,7 +52,8 @@ enum THdfsCompression {
   DEFLATE,
   BZIP2,
   SNAPPY,
-  SNAPPY_BLOCKED // Used by sequence and rc files but not stored in the metadata.
+  SNAPPY_BLOCKED, // Used by sequence and rc files but not stored in the metadata.
+  LZ4_BLOCKED // Used by hfiles but not stored in the metadata.
 }
 
 // Mapping from names defined by Avro to the enum.
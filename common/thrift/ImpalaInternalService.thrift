@@ -55,6 +55,11 @@ struct TQueryOptions {
   11: optional string debug_action = ""
   12: optional i64 mem_limit = 0
   13: optional bool abort_on_default_limit_exceeded = 0
+  14: optional i32 num_instances_per_host = 1
+  15: optional string request_pool = ""
+  16: optional i32 query_priority = 1
+  17: optional i64 hfile_min_timestamp = 0
+  18: optional i64 hfile_max_timestamp = -1
 }
 
 // A scan range plus the parameters needed to execute that scan.
@@ -91,6 +91,25 @@ enum TImpalaQueryOptions {
   
   // If true, raise an error when the DEFAULT_ORDER_BY_LIMIT has been reached.
   ABORT_ON_DEFAULT_LIMIT_EXCEEDED,
+
+  // Number of instances of each partitioned plan fragment to run on each host, so
+  // that joins and aggregations above the scans use multiple cores.  Values < 2 run
+  // one instance per host.
+  NUM_INSTANCES_PER_HOST,
+
+  // Request pool the query is submitted to for admission control.  Empty means the
+  // default pool.
+  REQUEST_POOL,
+
+  // Relative share of the threads on each host that the query's fragments get when
+  // they run concurrently with other queries' fragments.  Values < 1 are treated as 1.
+  QUERY_PRIORITY,
+
+  // Time range [HFILE_MIN_TIMESTAMP, HFILE_MAX_TIMESTAMP) of the cells read from
+  // HFiles, like the time range of an HBase scan.  HFiles whose TIMERANGE is outside of
+  // it are not read.  A negative HFILE_MAX_TIMESTAMP means there is no upper bound.
+  HFILE_MIN_TIMESTAMP,
+  HFILE_MAX_TIMESTAMP,
 }
 
 // Default values for each query option in ImpalaService.TImpalaQueryOptions
@@ -107,6 +126,11 @@ const map<TImpalaQueryOptions, string> DEFAULT_QUERY_OPTIONS = {
   TImpalaQueryOptions.DEFAULT_ORDER_BY_LIMIT : "-1"
   TImpalaQueryOptions.DEBUG_ACTION : ""
   TImpalaQueryOptions.MEM_LIMIT : "0"
+  TImpalaQueryOptions.NUM_INSTANCES_PER_HOST : "1"
+  TImpalaQueryOptions.REQUEST_POOL : ""
+  TImpalaQueryOptions.QUERY_PRIORITY : "1"
+  TImpalaQueryOptions.HFILE_MIN_TIMESTAMP : "0"
+  TImpalaQueryOptions.HFILE_MAX_TIMESTAMP : "-1"
 }
 
 // The summary of an insert.
@@ -74,6 +74,9 @@ struct THdfsFileSplit {
   
   // total size of the hdfs file
   5: required i64 file_length
+
+  // last modification time of the hdfs file, in ms since the epoch
+  6: optional i64 mtime
 }
 
 // key range for single THBaseScanNode
@@ -152,6 +155,11 @@ struct TAggregationNode {
   // Set to true if this aggregation function requires finalization to complete after all
   // rows have been aggregated, and this node is not an intermediate node.
   4: required bool need_finalize
+
+  // Set to true if this is the first phase of a 2-phase aggregation, i.e. its output is
+  // sent to a merge aggregation.  A pre-aggregation may pass input rows through
+  // unaggregated if aggregating them doesn't reduce the number of rows sufficiently.
+  5: optional bool is_preaggregation
 }
 
 struct TSortNode {
@@ -161,6 +169,9 @@ struct TSortNode {
   3: required bool use_top_n;
   // Indicates whether the imposed limit comes DEFAULT_ORDER_BY_LIMIT.
   4: required bool is_default_limit
+  // Number of rows to skip before returning rows (OFFSET clause); the limit applies
+  // to the rows after the offset.
+  5: optional i64 offset
 }
 
 struct TMergeNode {
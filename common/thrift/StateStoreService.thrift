@@ -72,6 +72,12 @@ struct TTopicDelta {
   // True if entries / deletions are to be applied to in-memory state,
   // otherwise topic_entries contains entire topic state.
   4: required bool is_delta;
+
+  // Topic versions the delta goes from and to. A delta holds the changes made after
+  // from_version, up to and including to_version, and can only be applied to the topic
+  // at from_version.  Not set by subscriber callbacks.
+  5: optional i64 from_version;
+  6: optional i64 to_version;
 }
 
 // Description of a topic to subscribe to as part of a RegisterSubscriber call
@@ -123,6 +129,11 @@ struct TUpdateStateResponse {
 
   // List of updates published by the subscriber to be made centrally by the state-store
   2: required list<TTopicUpdate> topic_updates;
+
+  // Version of each topic the subscriber holds after the update, from which the next
+  // delta is computed.  0 asks for the entire topic, e.g. if the subscriber could not
+  // apply a delta.  If not set, the entire topics are sent in the next update.
+  3: optional map<string, i64> topic_versions;
 }
 
 service StateStoreSubscriber {
@@ -212,6 +212,20 @@ struct PageHeader {
   2: optional string value
 }
 
+/**
+ * Statistics per row group and per page
+ * All fields are optional.
+ */
+struct Statistics {
+   /** min and max value of the column, encoded in PLAIN encoding */
+   1: optional binary max;
+   2: optional binary min;
+   /** count of null value in the column */
+   3: optional i64 null_count;
+   /** count of distinct values occurring */
+   4: optional i64 distinct_count;
+}
+
 /**
  * Description for column metadata
  */
@@ -249,6 +263,9 @@ struct ColumnMetaData {
 
   /** Byte offset from the beginning of file to first (only) dictionary page **/
   11: optional i64 dictionary_page_offset
+
+  /** optional statistics for this column chunk */
+  12: optional Statistics statistics;
 }
 
 struct ColumnChunk {
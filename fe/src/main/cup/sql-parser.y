@@ -172,7 +172,8 @@ terminal KW_ADD, KW_AND, KW_ALL, KW_ALTER, KW_AS, KW_ASC, KW_AVG, KW_BETWEEN, KW
   KW_DOUBLE, KW_DROP, KW_ELSE, KW_END, KW_ESCAPED, KW_EXISTS, KW_EXTERNAL, KW_FALSE,
   KW_FIELDS, KW_FILEFORMAT, KW_FLOAT, KW_FORMAT, KW_FROM, KW_FULL, KW_GROUP, KW_HAVING,
   KW_IF, KW_IS, KW_IN, KW_INNER, KW_JOIN, KW_INT, KW_LEFT, KW_LIKE, KW_LIMIT, KW_LINES,
-  KW_LOCATION, KW_MIN, KW_MAX, KW_NOT, KW_NULL, KW_ON, KW_OR, KW_ORDER, KW_OUTER,
+  KW_LOCATION, KW_MIN, KW_MAX, KW_NOT, KW_NULL, KW_OFFSET, KW_ON, KW_OR, KW_ORDER,
+  KW_OUTER,
   KW_PARQUETFILE, KW_PARTITIONED, KW_RCFILE, KW_REGEXP, KW_RENAME, KW_REPLACE, KW_RLIKE,
   KW_RIGHT, KW_ROW, KW_SCHEMA, KW_SCHEMAS, KW_SELECT, KW_SET, KW_SEQUENCEFILE, KW_SHOW,
   KW_SEMI, KW_SMALLINT, KW_STORED, KW_STRING, KW_SUM, KW_TABLES, KW_TERMINATED,
@@ -225,6 +226,7 @@ nonterminal Expr having_clause;
 nonterminal ArrayList<OrderByElement> order_by_elements, order_by_clause;
 nonterminal OrderByElement order_by_element;
 nonterminal Number limit_clause;
+nonterminal Number offset_clause;
 nonterminal Expr cast_expr, case_else_clause, aggregate_expr;
 nonterminal LiteralExpr literal;
 nonterminal CaseExpr case_expr;
@@ -757,10 +759,13 @@ select_stmt ::=
     having_clause:havingPredicate
     order_by_clause:orderByClause
     limit_clause:limitClause
+    offset_clause:offsetClause
   {:
-    RESULT = new SelectStmt(selectList, tableRefList, wherePredicate,
-                            groupingExprs, havingPredicate, orderByClause,
-                            (limitClause == null ? -1 : limitClause.longValue()));
+    SelectStmt stmt = new SelectStmt(selectList, tableRefList, wherePredicate,
+                                     groupingExprs, havingPredicate, orderByClause,
+                                     (limitClause == null ? -1 : limitClause.longValue()));
+    if (offsetClause != null) stmt.setOffset(offsetClause.longValue());
+    RESULT = stmt;
   :}
   ;
 
@@ -1003,6 +1008,13 @@ limit_clause ::=
   {: RESULT = null; :}
   ;
 
+offset_clause ::=
+  KW_OFFSET INTEGER_LITERAL:o
+  {: RESULT = o; :}
+  | /* empty */
+  {: RESULT = null; :}
+  ;
+
 cast_expr ::=
   KW_CAST LPAREN expr:e KW_AS primitive_type:targetType RPAREN
   {: RESULT = new CastExpr((PrimitiveType) targetType, e, false); :}
@@ -33,6 +33,8 @@ import com.google.common.collect.Lists;
 public abstract class QueryStmt extends ParseNodeBase {
   protected ArrayList<OrderByElement> orderByElements;
   protected final long limit;
+  // Number of rows to skip before returning rows; only valid with an ORDER BY clause
+  protected long offset = 0;
 
   /**
    * For a select statment:
@@ -151,6 +153,18 @@ public abstract class QueryStmt extends ParseNodeBase {
     return limit != -1;
   }
 
+  public long getOffset() {
+    return offset;
+  }
+
+  public void setOffset(long offset) {
+    this.offset = offset;
+  }
+
+  public boolean hasOffsetClause() {
+    return offset != 0;
+  }
+
   public SortInfo getSortInfo() {
     return sortInfo;
   }
@@ -153,6 +153,9 @@ public class SelectStmt extends QueryStmt {
     }
 
     createSortInfo(analyzer);
+    if (hasOffsetClause() && sortInfo == null) {
+      throw new AnalysisException("OFFSET requires an ORDER BY clause");
+    }
     analyzeAggregation(analyzer);
 
     // Substitute expressions to the underlying inline view expressions
@@ -548,6 +551,11 @@ public class SelectStmt extends QueryStmt {
       strBuilder.append(" LIMIT ");
       strBuilder.append(limit);
     }
+    // Offset clause.
+    if (hasOffsetClause()) {
+      strBuilder.append(" OFFSET ");
+      strBuilder.append(offset);
+    }
     return strBuilder.toString();
   }
 
@@ -40,23 +40,28 @@ public class HdfsPartition {
   static public class FileDescriptor {
     private final String filePath;
     private final long fileLength;
+    // last modification time of the file, in ms since the epoch
+    private final long modificationTime;
     private HdfsCompression fileCompression;
 
     public String getFilePath() { return filePath; }
     public long getFileLength() { return fileLength; }
+    public long getModificationTime() { return modificationTime; }
     public HdfsCompression getFileCompression() { return fileCompression; }
 
-    public FileDescriptor(String filePath, long fileLength) {
+    public FileDescriptor(String filePath, long fileLength, long modificationTime) {
       Preconditions.checkNotNull(filePath);
       Preconditions.checkArgument(fileLength >= 0);
       this.filePath = filePath;
       this.fileLength = fileLength;
+      this.modificationTime = modificationTime;
     }
 
     @Override
     public String toString() {
       return Objects.toStringHelper(this).add("Path", filePath)
-          .add("Length", fileLength).toString();
+          .add("Length", fileLength).add("ModificationTime", modificationTime)
+          .toString();
     }
 
     public void setCompression(HdfsCompression compression) {
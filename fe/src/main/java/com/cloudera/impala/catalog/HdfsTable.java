@@ -91,6 +91,8 @@ public class HdfsTable extends Table {
   public static class BlockMetadata {
     private final String fileName;
     private final long fileSize; // total size of the file holding the block, in bytes
+    // last modification time of the file holding the block, in ms since the epoch
+    private final long fileModificationTime;
     private final long offset;
     private final long length;
 
@@ -103,11 +105,12 @@ public class HdfsTable extends Table {
     // schedule scan ranges
     private int[] diskIds;
 
-    public BlockMetadata(String fileName, long fileSize, BlockLocation blockLocation,
-                         String[] hostPorts) {
+    public BlockMetadata(String fileName, long fileSize, long fileModificationTime,
+                         BlockLocation blockLocation, String[] hostPorts) {
       Preconditions.checkNotNull(blockLocation);
       this.fileName = fileName;
       this.fileSize = fileSize;
+      this.fileModificationTime = fileModificationTime;
       this.offset = blockLocation.getOffset();
       this.length = blockLocation.getLength();
       this.hostPorts = hostPorts;
@@ -115,6 +118,7 @@ public class HdfsTable extends Table {
 
     public String getFileName() { return fileName; }
     public long getFileSize() { return fileSize; }
+    public long getFileModificationTime() { return fileModificationTime; }
     public long getOffset() { return offset; }
     public long getLength() { return length; }
     public String[] getHostPorts() { return hostPorts; }
@@ -172,8 +176,8 @@ public class HdfsTable extends Table {
     /**
      * Add metadata for a single block and update uniqueHostPorts/-FileNames.
      */
-    public void addBlock(String fileName, long fileSize, BlockLocation location,
-        HashMap<String, String> uniqueHostPorts) {
+    public void addBlock(String fileName, long fileSize, long fileModificationTime,
+        BlockLocation location, HashMap<String, String> uniqueHostPorts) {
       // update uniqueFileNames
       String recordedFileName = uniqueFileNames.get(fileName);
       if (recordedFileName == null) {
@@ -202,8 +206,8 @@ public class HdfsTable extends Table {
         }
       }
 
-      blockMetadata.add(new BlockMetadata(recordedFileName, fileSize, location,
-          recordedHostPorts));
+      blockMetadata.add(new BlockMetadata(recordedFileName, fileSize,
+          fileModificationTime, location, recordedHostPorts));
     }
 
     /**
@@ -363,8 +367,8 @@ public class HdfsTable extends Table {
             blockLocations.addAll(Arrays.asList(locations));
             for (int i = 0; i < locations.length; ++i) {
               partitionBlockMd.addBlock(fileDescriptor.getFilePath(),
-                  fileDescriptor.getFileLength(), locations[i],
-                  partition.getTable().uniqueHostPorts);
+                  fileDescriptor.getFileLength(), fileDescriptor.getModificationTime(),
+                  locations[i], partition.getTable().uniqueHostPorts);
             }
           }
         } catch (IOException e) {
@@ -713,7 +717,7 @@ List<org.apache.hadoop.hive.metastore.api.Partition> msPartitions,
           continue;
         }
         FileDescriptor fd = new FileDescriptor(fileStatus.getPath().toString(),
-            fileStatus.getLen());
+            fileStatus.getLen(), fileStatus.getModificationTime());
         fileDescriptors.add(fd);
       }
 
@@ -735,7 +739,8 @@ List<org.apache.hadoop.hive.metastore.api.Partition> msPartitions,
 
                 for (FileStatus status : splits)
                 {
-                    fileDescriptors.add(new FileDescriptor(status.getPath().toString(), status.getLen()));
+                    fileDescriptors.add(new FileDescriptor(status.getPath().toString(),
+                            status.getLen(), status.getModificationTime()));
                 }
             }
 
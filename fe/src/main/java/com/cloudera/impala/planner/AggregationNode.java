@@ -42,6 +42,10 @@ public class AggregationNode extends PlanNode {
   // finalization after all rows have been aggregated.
   private boolean needsFinalize;
 
+  // Set to true if this is the first phase of a 2-phase aggregation whose output is
+  // merged by an AggregationNode in a parent fragment.
+  private boolean isPreaggregation = false;
+
   /**
    * Create an agg node that is not an intermediate node.
    * isIntermediate is true if it is a slave node in a 2-part agg plan.
@@ -74,6 +78,10 @@ public class AggregationNode extends PlanNode {
     return aggInfo;
   }
 
+  public void setIsPreaggregation() {
+    isPreaggregation = true;
+  }
+
   @Override
   public void setCompactData(boolean on) {
     this.compactData = on;
@@ -130,6 +138,7 @@ public class AggregationNode extends PlanNode {
     msg.agg_node = new TAggregationNode(
         Expr.treesToThrift(aggInfo.getAggregateExprs()),
         aggInfo.getAggTupleId().asInt(), needsFinalize);
+    msg.agg_node.setIs_preaggregation(isPreaggregation);
     List<Expr> groupingExprs = aggInfo.getGroupingExprs();
     if (groupingExprs != null) {
       msg.agg_node.setGrouping_exprs(Expr.treesToThrift(groupingExprs));
@@ -191,9 +191,11 @@ public class HdfsScanNode extends ScanNode {
             currentLength = maxScanRangeLength;
           }
           TScanRange scanRange = new TScanRange();
-          scanRange.setHdfs_file_split(
-              new THdfsFileSplit(block.getFileName(), currentOffset,
-                currentLength, partition.getPartition().getId(), block.getFileSize()));
+          THdfsFileSplit fileSplit = new THdfsFileSplit(block.getFileName(),
+              currentOffset, currentLength, partition.getPartition().getId(),
+              block.getFileSize());
+          fileSplit.setMtime(block.getFileModificationTime());
+          scanRange.setHdfs_file_split(fileSplit);
           TScanRangeLocations scanRangeLocations = new TScanRangeLocations();
           scanRangeLocations.scan_range = scanRange;
           scanRangeLocations.locations = locations;
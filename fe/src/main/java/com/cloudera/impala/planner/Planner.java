@@ -611,6 +611,7 @@ public class Planner {
       // the original aggregation goes into the child fragment,
       // merge aggregation into a parent fragment
       childFragment.addPlanRoot(node);
+      node.setIsPreaggregation();
       // if there is a limit, we need to transfer it from the pre-aggregation
       // node in the child fragment to the merge aggregation node in the parent
       long limit = node.getLimit();
@@ -651,6 +652,7 @@ public class Planner {
     Preconditions.checkState(isDistinct);
     // The first-phase aggregation node is already in the child fragment.
     Preconditions.checkState(node.getChild(0) == childFragment.getPlanRoot());
+    ((AggregationNode)(node.getChild(0))).setIsPreaggregation();
 
     DataPartition mergePartition = null;
     if (hasGrouping) {
@@ -734,13 +736,23 @@ public class Planner {
     // insert sort node that repeats the child's sort
     SortNode childSortNode = (SortNode) childFragment.getPlanRoot();
     LOG.info("childsortnode limit: " + Long.toString(childSortNode.getLimit()));
-    Preconditions.checkState(childSortNode.hasLimit());
+    Preconditions.checkState(childSortNode.hasLimit() || !childSortNode.useTopN());
     PlanNode exchNode = mergeFragment.getPlanRoot();
     // the merging exchange node must not apply the limit (that's done by the merging
     // top-n)
     exchNode.unsetLimit();
     PlanNode mergeNode =
         new SortNode(new PlanNodeId(nodeIdGenerator), childSortNode, exchNode);
+    // the merging top-n skips the offset rows, so each child top-n needs to return
+    // limit + offset rows
+    if (childSortNode.getOffset() != 0) {
+      if (childSortNode.hasLimit()) {
+        long childLimit = childSortNode.getLimit() + childSortNode.getOffset();
+        childSortNode.unsetLimit();
+        childSortNode.setLimit(childLimit);
+      }
+      childSortNode.setOffset(0);
+    }
     mergeNode.computeStats(analyzer);
     Preconditions.checkState(mergeNode.hasValidStats());
     mergeFragment.setPlanRoot(mergeNode);
@@ -783,8 +795,6 @@ public class Planner {
   /**
    * Create tree of PlanNodes that implements the Select/Project/Join/Group by/Having
    * of the selectStmt query block.
-   * @throws NotImplementedException if selectStmt contains Order By clause w/o Limit
-   *   and the query options don't contain a default limit
    */
   private PlanNode createSelectPlan(
       SelectStmt selectStmt, Analyzer analyzer, long defaultOrderByLimit)
@@ -812,14 +822,6 @@ public class Planner {
       assignConjuncts(root, analyzer);
     }
 
-    if (selectStmt.getSortInfo() != null
-        && selectStmt.getLimit() == -1 && defaultOrderByLimit == -1) {
-      // TODO: only use topN if the memory footprint is expected to be low;
-      // how to account for strings?
-      throw new NotImplementedException(
-          "ORDER BY without LIMIT currently not supported");
-    }
-
     if (root != null) {
       // add unassigned conjuncts before aggregation
       // (scenario: agg input comes from an inline view which wasn't able to
@@ -849,10 +851,13 @@ public class Planner {
     // add order by and limit
     SortInfo sortInfo = selectStmt.getSortInfo();
     if (sortInfo != null) {
-      Preconditions.checkState(selectStmt.getLimit() != -1 || defaultOrderByLimit != -1);
-      boolean isDefaultLimit = (selectStmt.getLimit() == -1);
-      root = new SortNode(new PlanNodeId(nodeIdGenerator), root, sortInfo, true,
-          isDefaultLimit);
+      // without any limit, all rows are sorted by the backend's full sort
+      boolean hasLimit = selectStmt.getLimit() != -1 || defaultOrderByLimit != -1;
+      boolean isDefaultLimit = (selectStmt.getLimit() == -1 && hasLimit);
+      SortNode sortNode = new SortNode(new PlanNodeId(nodeIdGenerator), root, sortInfo,
+          hasLimit, isDefaultLimit);
+      sortNode.setOffset(selectStmt.getOffset());
+      root = sortNode;
       root.computeStats(analyzer);
       Preconditions.checkState(root.hasValidStats());
       // Don't assign conjuncts here. If this is the tree for an inline view, and
@@ -1284,12 +1289,8 @@ public class Planner {
     // Add order by and limit if present.
     SortInfo sortInfo = unionStmt.getSortInfo();
     if (sortInfo != null) {
-      if (unionStmt.getLimit() == -1) {
-        throw new NotImplementedException(
-            "ORDER BY without LIMIT currently not supported");
-      }
-      result = new SortNode(new PlanNodeId(nodeIdGenerator), result, sortInfo, true,
-          false);
+      result = new SortNode(new PlanNodeId(nodeIdGenerator), result, sortInfo,
+          unionStmt.getLimit() != -1, false);
     }
     result.setLimit(unionStmt.getLimit());
 
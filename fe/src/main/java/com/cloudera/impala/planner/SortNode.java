@@ -42,10 +42,12 @@ public class SortNode extends PlanNode {
   private final SortInfo info;
   private final boolean useTopN;
   private final boolean isDefaultLimit;
+  // Number of rows to skip before returning rows, applied before the limit
+  private long offset;
 
   public SortNode(PlanNodeId id, PlanNode input, SortInfo info, boolean useTopN,
       boolean isDefaultLimit) {
-    super(id, "TOP-N");
+    super(id, useTopN ? "TOP-N" : "SORT");
     this.info = info;
     this.useTopN = useTopN;
     this.isDefaultLimit = isDefaultLimit;
@@ -60,13 +62,18 @@ public class SortNode extends PlanNode {
    * Clone 'inputSortNode' for distributed Top-N
    */
   public SortNode(PlanNodeId id, SortNode inputSortNode, PlanNode child) {
-    super(id, inputSortNode, "TOP-N");
+    super(id, inputSortNode, inputSortNode.useTopN ? "TOP-N" : "SORT");
     this.info = inputSortNode.info;
     this.useTopN = inputSortNode.useTopN;
     this.isDefaultLimit = inputSortNode.isDefaultLimit;
+    this.offset = inputSortNode.offset;
     this.children.add(child);
   }
 
+  public boolean useTopN() { return useTopN; }
+  public long getOffset() { return offset; }
+  public void setOffset(long offset) { this.offset = offset; }
+
   @Override
   public void getMaterializedIds(Analyzer analyzer, List<SlotId> ids) {
     super.getMaterializedIds(analyzer, ids);
@@ -101,6 +108,7 @@ public class SortNode extends PlanNode {
     return Objects.toStringHelper(this)
         .add("ordering_exprs", Expr.debugString(info.getOrderingExprs()))
         .add("is_asc", "[" + Joiner.on(" ").join(strings) + "]")
+        .add("offset", offset)
         .addValue(super.debugString())
         .toString();
   }
@@ -111,6 +119,7 @@ public class SortNode extends PlanNode {
     msg.sort_node = new TSortNode(
         Expr.treesToThrift(info.getOrderingExprs()), info.getIsAscOrder(), useTopN,
         isDefaultLimit);
+    msg.sort_node.setOffset(offset);
   }
 
   @Override
@@ -131,6 +140,7 @@ public class SortNode extends PlanNode {
       output.append(isAsc.next() ? "ASC" : "DESC");
     }
     output.append("\n");
+    if (offset != 0) output.append(detailPrefix + "offset: " + offset + "\n");
     return output.toString();
   }
 }